@@ -20,13 +20,29 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// normal_p_value
+Rcpp::NumericVector normal_p_value(const Rcpp::NumericVector s, const Rcpp::NumericVector v, const double v_opt, const double alpha_opt, const bool is_one_sided, const bool running_min);
+RcppExport SEXP _confseq_normal_p_value(SEXP sSEXP, SEXP vSEXP, SEXP v_optSEXP, SEXP alpha_optSEXP, SEXP is_one_sidedSEXP, SEXP running_minSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type s(sSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
+    Rcpp::traits::input_parameter< const bool >::type is_one_sided(is_one_sidedSEXP);
+    Rcpp::traits::input_parameter< const bool >::type running_min(running_minSEXP);
+    rcpp_result_gen = Rcpp::wrap(normal_p_value(s, v, v_opt, alpha_opt, is_one_sided, running_min));
+    return rcpp_result_gen;
+END_RCPP
+}
 // normal_mixture_bound
-Rcpp::NumericVector normal_mixture_bound(const Rcpp::NumericVector v, const Rcpp::NumericVector alpha, const double v_opt, const double alpha_opt, const bool is_one_sided);
+SEXP normal_mixture_bound(SEXP v, const Rcpp::NumericVector alpha, const double v_opt, const double alpha_opt, const bool is_one_sided);
 RcppExport SEXP _confseq_normal_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP alpha_optSEXP, SEXP is_one_sidedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type v(vSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type alpha(alphaSEXP);
     Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
@@ -50,18 +66,35 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// gamma_exponential_mixture_bound
-Rcpp::NumericVector gamma_exponential_mixture_bound(const Rcpp::NumericVector v, const Rcpp::NumericVector alpha, const double v_opt, const double c, const double alpha_opt);
-RcppExport SEXP _confseq_gamma_exponential_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP cSEXP, SEXP alpha_optSEXP) {
+// gamma_exponential_p_value
+Rcpp::NumericVector gamma_exponential_p_value(const Rcpp::NumericVector s, const Rcpp::NumericVector v, const double v_opt, const double c, const double alpha_opt, const bool running_min);
+RcppExport SEXP _confseq_gamma_exponential_p_value(SEXP sSEXP, SEXP vSEXP, SEXP v_optSEXP, SEXP cSEXP, SEXP alpha_optSEXP, SEXP running_minSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type s(sSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
+    Rcpp::traits::input_parameter< const double >::type c(cSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
+    Rcpp::traits::input_parameter< const bool >::type running_min(running_minSEXP);
+    rcpp_result_gen = Rcpp::wrap(gamma_exponential_p_value(s, v, v_opt, c, alpha_opt, running_min));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gamma_exponential_mixture_bound
+SEXP gamma_exponential_mixture_bound(SEXP v, const Rcpp::NumericVector alpha, const double v_opt, const double c, const double alpha_opt, const std::string precision);
+RcppExport SEXP _confseq_gamma_exponential_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP cSEXP, SEXP alpha_optSEXP, SEXP precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type v(vSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type alpha(alphaSEXP);
     Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
     Rcpp::traits::input_parameter< const double >::type c(cSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
-    rcpp_result_gen = Rcpp::wrap(gamma_exponential_mixture_bound(v, alpha, v_opt, c, alpha_opt));
+    Rcpp::traits::input_parameter< const std::string >::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(gamma_exponential_mixture_bound(v, alpha, v_opt, c, alpha_opt, precision));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -80,18 +113,35 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// gamma_poisson_mixture_bound
-Rcpp::NumericVector gamma_poisson_mixture_bound(const Rcpp::NumericVector v, const Rcpp::NumericVector alpha, const double v_opt, const double c, const double alpha_opt);
-RcppExport SEXP _confseq_gamma_poisson_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP cSEXP, SEXP alpha_optSEXP) {
+// gamma_poisson_p_value
+Rcpp::NumericVector gamma_poisson_p_value(const Rcpp::NumericVector s, const Rcpp::NumericVector v, const double v_opt, const double c, const double alpha_opt, const bool running_min);
+RcppExport SEXP _confseq_gamma_poisson_p_value(SEXP sSEXP, SEXP vSEXP, SEXP v_optSEXP, SEXP cSEXP, SEXP alpha_optSEXP, SEXP running_minSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type s(sSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
+    Rcpp::traits::input_parameter< const double >::type c(cSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
+    Rcpp::traits::input_parameter< const bool >::type running_min(running_minSEXP);
+    rcpp_result_gen = Rcpp::wrap(gamma_poisson_p_value(s, v, v_opt, c, alpha_opt, running_min));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gamma_poisson_mixture_bound
+SEXP gamma_poisson_mixture_bound(SEXP v, const Rcpp::NumericVector alpha, const double v_opt, const double c, const double alpha_opt, const std::string precision);
+RcppExport SEXP _confseq_gamma_poisson_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP cSEXP, SEXP alpha_optSEXP, SEXP precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type v(vSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type alpha(alphaSEXP);
     Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
     Rcpp::traits::input_parameter< const double >::type c(cSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
-    rcpp_result_gen = Rcpp::wrap(gamma_poisson_mixture_bound(v, alpha, v_opt, c, alpha_opt));
+    Rcpp::traits::input_parameter< const std::string >::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(gamma_poisson_mixture_bound(v, alpha, v_opt, c, alpha_opt, precision));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -112,20 +162,39 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// beta_binomial_mixture_bound
-Rcpp::NumericVector beta_binomial_mixture_bound(const Rcpp::NumericVector v, const Rcpp::NumericVector alpha, const double v_opt, const double g, const double h, const double alpha_opt, const bool is_one_sided);
-RcppExport SEXP _confseq_beta_binomial_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP gSEXP, SEXP hSEXP, SEXP alpha_optSEXP, SEXP is_one_sidedSEXP) {
+// beta_binomial_p_value
+Rcpp::NumericVector beta_binomial_p_value(const Rcpp::NumericVector s, const Rcpp::NumericVector v, const double v_opt, const double g, const double h, const double alpha_opt, const bool is_one_sided, const bool running_min);
+RcppExport SEXP _confseq_beta_binomial_p_value(SEXP sSEXP, SEXP vSEXP, SEXP v_optSEXP, SEXP gSEXP, SEXP hSEXP, SEXP alpha_optSEXP, SEXP is_one_sidedSEXP, SEXP running_minSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type s(sSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
+    Rcpp::traits::input_parameter< const double >::type g(gSEXP);
+    Rcpp::traits::input_parameter< const double >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
+    Rcpp::traits::input_parameter< const bool >::type is_one_sided(is_one_sidedSEXP);
+    Rcpp::traits::input_parameter< const bool >::type running_min(running_minSEXP);
+    rcpp_result_gen = Rcpp::wrap(beta_binomial_p_value(s, v, v_opt, g, h, alpha_opt, is_one_sided, running_min));
+    return rcpp_result_gen;
+END_RCPP
+}
+// beta_binomial_mixture_bound
+SEXP beta_binomial_mixture_bound(SEXP v, const Rcpp::NumericVector alpha, const double v_opt, const double g, const double h, const double alpha_opt, const bool is_one_sided, const std::string precision);
+RcppExport SEXP _confseq_beta_binomial_mixture_bound(SEXP vSEXP, SEXP alphaSEXP, SEXP v_optSEXP, SEXP gSEXP, SEXP hSEXP, SEXP alpha_optSEXP, SEXP is_one_sidedSEXP, SEXP precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type v(vSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type alpha(alphaSEXP);
     Rcpp::traits::input_parameter< const double >::type v_opt(v_optSEXP);
     Rcpp::traits::input_parameter< const double >::type g(gSEXP);
     Rcpp::traits::input_parameter< const double >::type h(hSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
     Rcpp::traits::input_parameter< const bool >::type is_one_sided(is_one_sidedSEXP);
-    rcpp_result_gen = Rcpp::wrap(beta_binomial_mixture_bound(v, alpha, v_opt, g, h, alpha_opt, is_one_sided));
+    Rcpp::traits::input_parameter< const std::string >::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(beta_binomial_mixture_bound(v, alpha, v_opt, g, h, alpha_opt, is_one_sided, precision));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -177,7 +246,7 @@ BEGIN_RCPP
 END_RCPP
 }
 // bernoulli_confidence_interval
-Rcpp::List bernoulli_confidence_interval(const Rcpp::NumericVector num_successes, const Rcpp::NumericVector num_trials, const double alpha, const double t_opt, const double alpha_opt);
+Rcpp::List bernoulli_confidence_interval(const Rcpp::NumericVector num_successes, const Rcpp::NumericVector num_trials, const double alpha, const Rcpp::NumericVector t_opt, const double alpha_opt);
 RcppExport SEXP _confseq_bernoulli_confidence_interval(SEXP num_successesSEXP, SEXP num_trialsSEXP, SEXP alphaSEXP, SEXP t_optSEXP, SEXP alpha_optSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
@@ -185,46 +254,115 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type num_successes(num_successesSEXP);
     Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type num_trials(num_trialsSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha(alphaSEXP);
-    Rcpp::traits::input_parameter< const double >::type t_opt(t_optSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type t_opt(t_optSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
     rcpp_result_gen = Rcpp::wrap(bernoulli_confidence_interval(num_successes, num_trials, alpha, t_opt, alpha_opt));
     return rcpp_result_gen;
 END_RCPP
 }
+// bernoulli_confidence_sequence
+Rcpp::List bernoulli_confidence_sequence(const Rcpp::NumericVector num_successes, const Rcpp::IntegerVector num_trials, const double alpha, const double t_opt, const double alpha_opt, const bool running_intersection);
+RcppExport SEXP _confseq_bernoulli_confidence_sequence(SEXP num_successesSEXP, SEXP num_trialsSEXP, SEXP alphaSEXP, SEXP t_optSEXP, SEXP alpha_optSEXP, SEXP running_intersectionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type num_successes(num_successesSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::IntegerVector >::type num_trials(num_trialsSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< const double >::type t_opt(t_optSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
+    Rcpp::traits::input_parameter< const bool >::type running_intersection(running_intersectionSEXP);
+    rcpp_result_gen = Rcpp::wrap(bernoulli_confidence_sequence(num_successes, num_trials, alpha, t_opt, alpha_opt, running_intersection));
+    return rcpp_result_gen;
+END_RCPP
+}
 // quantile_ab_p_value
-double quantile_ab_p_value(const Rcpp::NumericVector a_values, const Rcpp::NumericVector b_values, const double quantile_p, const int t_opt, const double alpha_opt);
-RcppExport SEXP _confseq_quantile_ab_p_value(SEXP a_valuesSEXP, SEXP b_valuesSEXP, SEXP quantile_pSEXP, SEXP t_optSEXP, SEXP alpha_optSEXP) {
+double quantile_ab_p_value(SEXP a_values, SEXP b_values, const double quantile_p, const int t_opt, const double alpha_opt, const bool assume_sorted, const bool check_sorted);
+RcppExport SEXP _confseq_quantile_ab_p_value(SEXP a_valuesSEXP, SEXP b_valuesSEXP, SEXP quantile_pSEXP, SEXP t_optSEXP, SEXP alpha_optSEXP, SEXP assume_sortedSEXP, SEXP check_sortedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type a_values(a_valuesSEXP);
-    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type b_values(b_valuesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type a_values(a_valuesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type b_values(b_valuesSEXP);
     Rcpp::traits::input_parameter< const double >::type quantile_p(quantile_pSEXP);
     Rcpp::traits::input_parameter< const int >::type t_opt(t_optSEXP);
     Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
-    rcpp_result_gen = Rcpp::wrap(quantile_ab_p_value(a_values, b_values, quantile_p, t_opt, alpha_opt));
+    Rcpp::traits::input_parameter< const bool >::type assume_sorted(assume_sortedSEXP);
+    Rcpp::traits::input_parameter< const bool >::type check_sorted(check_sortedSEXP);
+    rcpp_result_gen = Rcpp::wrap(quantile_ab_p_value(a_values, b_values, quantile_p, t_opt, alpha_opt, assume_sorted, check_sorted));
     return rcpp_result_gen;
 END_RCPP
 }
 
+// quantile_ab_p_values
+Rcpp::NumericVector quantile_ab_p_values(SEXP a_values, SEXP b_values, const Rcpp::NumericVector quantile_p, const int t_opt, const double alpha_opt, const bool assume_sorted, const bool check_sorted);
+RcppExport SEXP _confseq_quantile_ab_p_values(SEXP a_valuesSEXP, SEXP b_valuesSEXP, SEXP quantile_pSEXP, SEXP t_optSEXP, SEXP alpha_optSEXP, SEXP assume_sortedSEXP, SEXP check_sortedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type a_values(a_valuesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type b_values(b_valuesSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector >::type quantile_p(quantile_pSEXP);
+    Rcpp::traits::input_parameter< const int >::type t_opt(t_optSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha_opt(alpha_optSEXP);
+    Rcpp::traits::input_parameter< const bool >::type assume_sorted(assume_sortedSEXP);
+    Rcpp::traits::input_parameter< const bool >::type check_sorted(check_sortedSEXP);
+    rcpp_result_gen = Rcpp::wrap(quantile_ab_p_values(a_values, b_values, quantile_p, t_opt, alpha_opt, assume_sorted, check_sorted));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// solver_counters
+Rcpp::NumericVector solver_counters();
+RcppExport SEXP _confseq_solver_counters() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(solver_counters());
+    return rcpp_result_gen;
+END_RCPP
+}
+// reset_solver_counters
+void reset_solver_counters();
+RcppExport SEXP _confseq_reset_solver_counters() {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    reset_solver_counters();
+    return R_NilValue;
+END_RCPP
+}
+
+RcppExport SEXP _rcpp_module_boot_boundaries();
+
 static const R_CallMethodDef CallEntries[] = {
     {"_confseq_normal_log_mixture", (DL_FUNC) &_confseq_normal_log_mixture, 5},
+    {"_confseq_normal_p_value", (DL_FUNC) &_confseq_normal_p_value, 6},
     {"_confseq_normal_mixture_bound", (DL_FUNC) &_confseq_normal_mixture_bound, 5},
     {"_confseq_gamma_exponential_log_mixture", (DL_FUNC) &_confseq_gamma_exponential_log_mixture, 5},
-    {"_confseq_gamma_exponential_mixture_bound", (DL_FUNC) &_confseq_gamma_exponential_mixture_bound, 5},
+    {"_confseq_gamma_exponential_p_value", (DL_FUNC) &_confseq_gamma_exponential_p_value, 6},
+    {"_confseq_gamma_exponential_mixture_bound", (DL_FUNC) &_confseq_gamma_exponential_mixture_bound, 6},
     {"_confseq_gamma_poisson_log_mixture", (DL_FUNC) &_confseq_gamma_poisson_log_mixture, 5},
-    {"_confseq_gamma_poisson_mixture_bound", (DL_FUNC) &_confseq_gamma_poisson_mixture_bound, 5},
+    {"_confseq_gamma_poisson_p_value", (DL_FUNC) &_confseq_gamma_poisson_p_value, 6},
+    {"_confseq_gamma_poisson_mixture_bound", (DL_FUNC) &_confseq_gamma_poisson_mixture_bound, 6},
     {"_confseq_beta_binomial_log_mixture", (DL_FUNC) &_confseq_beta_binomial_log_mixture, 7},
-    {"_confseq_beta_binomial_mixture_bound", (DL_FUNC) &_confseq_beta_binomial_mixture_bound, 7},
+    {"_confseq_beta_binomial_p_value", (DL_FUNC) &_confseq_beta_binomial_p_value, 8},
+    {"_confseq_beta_binomial_mixture_bound", (DL_FUNC) &_confseq_beta_binomial_mixture_bound, 8},
     {"_confseq_poly_stitching_bound", (DL_FUNC) &_confseq_poly_stitching_bound, 6},
     {"_confseq_empirical_process_lil_bound", (DL_FUNC) &_confseq_empirical_process_lil_bound, 4},
     {"_confseq_double_stitching_bound", (DL_FUNC) &_confseq_double_stitching_bound, 7},
     {"_confseq_bernoulli_confidence_interval", (DL_FUNC) &_confseq_bernoulli_confidence_interval, 5},
-    {"_confseq_quantile_ab_p_value", (DL_FUNC) &_confseq_quantile_ab_p_value, 5},
+    {"_confseq_bernoulli_confidence_sequence", (DL_FUNC) &_confseq_bernoulli_confidence_sequence, 6},
+    {"_confseq_quantile_ab_p_value", (DL_FUNC) &_confseq_quantile_ab_p_value, 7},
+    {"_confseq_quantile_ab_p_values", (DL_FUNC) &_confseq_quantile_ab_p_values, 7},
+    {"_confseq_solver_counters", (DL_FUNC) &_confseq_solver_counters, 0},
+    {"_confseq_reset_solver_counters", (DL_FUNC) &_confseq_reset_solver_counters, 0},
+    {"_rcpp_module_boot_boundaries", (DL_FUNC) &_rcpp_module_boot_boundaries, 0},
     {NULL, NULL, 0}
 };
 
+void register_boundary_vector_class(DllInfo* dll);
 RcppExport void R_init_confseq(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    register_boundary_vector_class(dll);
 }
@@ -1,7 +1,22 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
 
 //#include <RcppCommon.h>
 #include <Rcpp.h>
+#include <Rversion.h>
+// Older versions of Altrep.h have no C++ linkage guards, and before R 3.6 it
+// names a parameter "class".
+#if R_VERSION < R_Version(3, 6, 0)
+#define class klass
+#endif
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+#undef class
 
 //using namespace Rcpp;
 
@@ -9,34 +24,322 @@
 
 using namespace std::placeholders;
 
-Rcpp::NumericVector mapply2(std::function<double(double, double)> fn,
-                            Rcpp::NumericVector arg1,
-                            Rcpp::NumericVector arg2) {
-  int n = std::max(arg1.size(), arg2.size());
-  auto arg1_recycled = Rcpp::rep_len(arg1, n);
-  auto arg2_recycled = Rcpp::rep_len(arg2, n);
-  Rcpp::NumericVector out(n);
-  for (int i = 0; i < n; i++) {
-    out[i] = fn(arg1_recycled[i], arg2_recycled[i]);
+// Sizes the thread pool shared by all parallel evaluation from the
+// confseq.num_threads option, if set. Otherwise the pool keeps its current
+// size, by default the number of hardware threads.
+void apply_num_threads_option() {
+  const SEXP option = Rf_GetOption1(Rf_install("confseq.num_threads"));
+  if (option == R_NilValue) {
+    return;
+  }
+  const int num_threads = Rcpp::as<int>(option);
+  if (num_threads < 1) {
+    Rcpp::stop("option confseq.num_threads must be a positive integer");
   }
+  confseq::set_num_threads(num_threads);
+}
+
+// Applies fn elementwise with the arguments recycled to a common length, as
+// R does, across threads. Each argument is read at index i modulo its length
+// rather than copied out to the full length first. Worker threads touch only
+// raw storage, never the R API.
+template <class Fn>
+Rcpp::NumericVector mapply2(Fn fn, const Rcpp::NumericVector& arg1,
+                            const Rcpp::NumericVector& arg2) {
+  const R_xlen_t n1 = arg1.size(), n2 = arg2.size();
+  const R_xlen_t n = n1 == 0 || n2 == 0 ? 0 : std::max(n1, n2);
+  Rcpp::NumericVector out(n);
+  const double* arg1_data = arg1.begin();
+  const double* arg2_data = arg2.begin();
+  double* out_data = out.begin();
+  apply_num_threads_option();
+  confseq::parallel_for(n, [&](const size_t i) {
+    out_data[i] = fn(arg1_data[i % n1], arg2_data[i % n2]);
+  });
   return out;
 }
 
-Rcpp::NumericVector mapply3(std::function<double(double, double, double)> fn,
-                            Rcpp::NumericVector arg1,
-                            Rcpp::NumericVector arg2,
-                            Rcpp::NumericVector arg3) {
-  int n = std::max({arg1.size(), arg2.size(), arg3.size()});
-  auto arg1_recycled = Rcpp::rep_len(arg1, n);
-  auto arg2_recycled = Rcpp::rep_len(arg2, n);
-  auto arg3_recycled = Rcpp::rep_len(arg3, n);
+template <class Fn>
+Rcpp::NumericVector mapply3(Fn fn, const Rcpp::NumericVector& arg1,
+                            const Rcpp::NumericVector& arg2,
+                            const Rcpp::NumericVector& arg3) {
+  const R_xlen_t n1 = arg1.size(), n2 = arg2.size(), n3 = arg3.size();
+  const R_xlen_t n = n1 == 0 || n2 == 0 || n3 == 0 ? 0
+      : std::max({n1, n2, n3});
   Rcpp::NumericVector out(n);
-  for (int i = 0; i < n; i++) {
-    out[i] = fn(arg1_recycled[i], arg2_recycled[i], arg3_recycled[i]);
+  const double* arg1_data = arg1.begin();
+  const double* arg2_data = arg2.begin();
+  const double* arg3_data = arg3.begin();
+  double* out_data = out.begin();
+  apply_num_threads_option();
+  confseq::parallel_for(n, [&](const size_t i) {
+    out_data[i] = fn(arg1_data[i % n1], arg2_data[i % n2],
+                     arg3_data[i % n3]);
+  });
+  return out;
+}
+
+// confseq::mixture_p_values with s and v recycled to a common length.
+Rcpp::NumericVector recycled_p_values(
+    const confseq::MixtureSupermartingale& mixture,
+    const Rcpp::NumericVector& s, const Rcpp::NumericVector& v,
+    const bool running_min) {
+  const R_xlen_t n = s.size() == 0 || v.size() == 0 ? 0
+      : std::max(s.size(), v.size());
+  const Rcpp::NumericVector s_full = Rcpp::rep_len(s, n);
+  const Rcpp::NumericVector v_full = Rcpp::rep_len(v, n);
+  Rcpp::NumericVector out(n);
+  apply_num_threads_option();
+  confseq::mixture_p_values(mixture, s_full.begin(), v_full.begin(), n,
+                            running_min, out.begin());
+  return out;
+}
+
+// Evaluates bound at v and alpha recycled to a common length. A single alpha
+// runs PolyStitchingBound::bound_sequence over blocks of v across threads.
+Rcpp::NumericVector recycled_poly_stitching_bounds(
+    const confseq::PolyStitchingBound& bound, const Rcpp::NumericVector& v,
+    const Rcpp::NumericVector& alpha) {
+  if (alpha.size() != 1) {
+    return mapply2([&bound](const double v, const double alpha) {
+                     return bound(v, alpha);
+                   },
+                   v, alpha);
   }
+  const size_t n = v.size();
+  const size_t block_size = 4096;
+  Rcpp::NumericVector out(n);
+  const double* v_data = v.begin();
+  const double alpha_value = alpha[0];
+  double* out_data = out.begin();
+  apply_num_threads_option();
+  confseq::parallel_for(
+      (n + block_size - 1) / block_size,
+      [&](const size_t block) {
+        const size_t begin = block * block_size;
+        bound.bound_sequence(v_data + begin, std::min(block_size, n - begin),
+                             alpha_value, out_data + begin);
+      },
+      0, 1);
   return out;
 }
 
+// Maps a precision argument, "exact", "balanced" or "fast", to the solver
+// precision of the same name.
+confseq::SolverPrecision parse_precision(const std::string& precision) {
+  if (precision == "exact") {
+    return confseq::SolverPrecision::exact();
+  } else if (precision == "balanced") {
+    return confseq::SolverPrecision::balanced();
+  } else if (precision == "fast") {
+    return confseq::SolverPrecision::fast();
+  }
+  Rcpp::stop("precision must be \"exact\", \"balanced\" or \"fast\"");
+}
+
+// Lazy boundary vectors. A long boundary over evenly spaced v is returned as
+// an ALTREP numeric vector backed by a confseq::BoundarySequence, so that
+// entries are computed only as R reads them: single entries a chunk at a time,
+// cached, and regions directly. The whole vector is materialized only when R
+// asks for its data pointer. data1 is an external pointer to the sequence and
+// data2 the materialized values, or NULL.
+
+R_altrep_class_t boundary_vector_class;
+
+// Shorter results are computed eagerly.
+const R_xlen_t lazy_min_length = 1 << 16;
+const size_t lazy_chunk_size = 4096;
+
+confseq::BoundarySequence* boundary_vector_sequence(SEXP x) {
+  return static_cast<confseq::BoundarySequence*>(
+      R_ExternalPtrAddr(R_altrep_data1(x)));
+}
+
+void boundary_vector_finalize(SEXP pointer) {
+  delete static_cast<confseq::BoundarySequence*>(R_ExternalPtrAddr(pointer));
+  R_ClearExternalPtr(pointer);
+}
+
+// ALTREP methods are called from R's C code, which C++ exceptions must not
+// cross, so they are raised as R errors once caught.
+template <class Fn>
+void call_from_altrep(Fn fn) {
+  char message[256];
+  try {
+    fn();
+    return;
+  } catch (const std::exception& e) {
+    snprintf(message, sizeof(message), "%s", e.what());
+  }
+  Rf_error("%s", message);
+}
+
+// All entries of x as an ordinary numeric vector, evaluated in chunks across
+// threads without adding to the sequence's cache.
+SEXP boundary_vector_values(SEXP x) {
+  const confseq::BoundarySequence* sequence = boundary_vector_sequence(x);
+  const size_t n = sequence->size();
+  SEXP values = PROTECT(Rf_allocVector(REALSXP, n));
+  double* data = REAL(values);
+  call_from_altrep([=]() {
+    apply_num_threads_option();
+    confseq::parallel_for(
+        (n + lazy_chunk_size - 1) / lazy_chunk_size,
+        [=](const size_t chunk) {
+          const size_t begin = chunk * lazy_chunk_size;
+          sequence->values(begin, std::min(n, begin + lazy_chunk_size),
+                           data + begin);
+        },
+        0, 1);
+  });
+  UNPROTECT(1);
+  return values;
+}
+
+R_xlen_t boundary_vector_length(SEXP x) {
+  return boundary_vector_sequence(x)->size();
+}
+
+double boundary_vector_elt(SEXP x, R_xlen_t i) {
+  const SEXP values = R_altrep_data2(x);
+  if (values != R_NilValue) {
+    return REAL(values)[i];
+  }
+  double value = 0;
+  call_from_altrep([&]() { value = (*boundary_vector_sequence(x))[i]; });
+  return value;
+}
+
+R_xlen_t boundary_vector_get_region(SEXP x, R_xlen_t i, R_xlen_t n,
+                                    double* buffer) {
+  const SEXP values = R_altrep_data2(x);
+  const R_xlen_t count =
+      std::max(R_xlen_t(0), std::min(n, boundary_vector_length(x) - i));
+  if (values != R_NilValue) {
+    std::copy(REAL(values) + i, REAL(values) + i + count, buffer);
+  } else {
+    call_from_altrep([&]() {
+      boundary_vector_sequence(x)->values(i, i + count, buffer);
+    });
+  }
+  return count;
+}
+
+void* boundary_vector_dataptr(SEXP x, Rboolean /*writeable*/) {
+  if (R_altrep_data2(x) == R_NilValue) {
+    R_set_altrep_data2(x, boundary_vector_values(x));
+    // The materialized values supersede any cached chunks.
+    boundary_vector_sequence(x)->discard_before(boundary_vector_length(x));
+  }
+  return REAL(R_altrep_data2(x));
+}
+
+const void* boundary_vector_dataptr_or_null(SEXP x) {
+  const SEXP values = R_altrep_data2(x);
+  return values == R_NilValue ? nullptr : REAL(values);
+}
+
+// Copies are ordinary vectors, leaving x lazy.
+SEXP boundary_vector_duplicate(SEXP x, Rboolean /*deep*/) {
+  const SEXP values = R_altrep_data2(x);
+  return values == R_NilValue ? boundary_vector_values(x)
+      : Rf_duplicate(values);
+}
+
+Rboolean boundary_vector_inspect(SEXP x, int /*pre*/, int /*deep*/,
+                                 int /*pvec*/,
+                                 void (*)(SEXP, int, int, int)) {
+  const confseq::BoundarySequence* sequence = boundary_vector_sequence(x);
+  Rprintf(" confseq boundary vector (size %.0f, %s, %.0f cached chunks)\n",
+          double(sequence->size()),
+          R_altrep_data2(x) == R_NilValue ? "lazy" : "materialized",
+          double(sequence->num_cached_chunks()));
+  return TRUE;
+}
+
+// [[Rcpp::init]]
+void register_boundary_vector_class(DllInfo* dll) {
+  boundary_vector_class = R_make_altreal_class("boundary_vector", "confseq",
+                                               dll);
+  R_set_altrep_Length_method(boundary_vector_class, boundary_vector_length);
+  R_set_altrep_Inspect_method(boundary_vector_class, boundary_vector_inspect);
+  R_set_altrep_Duplicate_method(boundary_vector_class,
+                                boundary_vector_duplicate);
+  R_set_altvec_Dataptr_method(boundary_vector_class, boundary_vector_dataptr);
+  R_set_altvec_Dataptr_or_null_method(boundary_vector_class,
+                                      boundary_vector_dataptr_or_null);
+  R_set_altreal_Elt_method(boundary_vector_class, boundary_vector_elt);
+  R_set_altreal_Get_region_method(boundary_vector_class,
+                                  boundary_vector_get_region);
+}
+
+// Whether the bound at v for a single alpha should be a lazy vector: v is a
+// numeric or integer vector of at least lazy_min_length positive, increasing,
+// evenly spaced values, to 1e-12 relative, and the confseq.lazy_bounds option
+// is not FALSE. If so, sets v_first and v_step. Compact sequences such as
+// 1:n are read without being materialized.
+bool lazy_bound_inputs(SEXP v, const double alpha, double& v_first,
+                       double& v_step) {
+  if ((TYPEOF(v) != REALSXP && TYPEOF(v) != INTSXP)
+      || XLENGTH(v) < lazy_min_length || !(0 < alpha && alpha < 1)) {
+    return false;
+  }
+  const SEXP option = Rf_GetOption1(Rf_install("confseq.lazy_bounds"));
+  if (option != R_NilValue && !Rcpp::as<bool>(option)) {
+    return false;
+  }
+  const R_xlen_t n = XLENGTH(v);
+  std::vector<double> block(lazy_chunk_size);
+  std::vector<int> int_block(TYPEOF(v) == INTSXP ? lazy_chunk_size : 0);
+  const auto read = [&](const R_xlen_t begin, const R_xlen_t count) {
+    if (TYPEOF(v) == REALSXP) {
+      REAL_GET_REGION(v, begin, count, block.data());
+      return;
+    }
+    INTEGER_GET_REGION(v, begin, count, int_block.data());
+    for (R_xlen_t j = 0; j < count; j++) {
+      block[j] = int_block[j] == NA_INTEGER ? NA_REAL : int_block[j];
+    }
+  };
+  read(n - 1, 1);
+  const double v_last = block[0];
+  read(0, 1);
+  v_first = block[0];
+  v_step = (v_last - v_first) / (n - 1);
+  if (!(v_first > 0 && v_step > 0 && std::isfinite(v_last))) {
+    return false;
+  }
+  for (R_xlen_t begin = 0; begin < n; begin += lazy_chunk_size) {
+    const R_xlen_t count = std::min(R_xlen_t(lazy_chunk_size), n - begin);
+    read(begin, count);
+    for (R_xlen_t j = 0; j < count; j++) {
+      // As confseq::BoundarySequence::v computes it.
+      const double expected = v_step * (begin + j + 1) + (v_first - v_step);
+      if (!(std::abs(block[j] - expected) <= 1e-12 * expected)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// A lazy vector of the boundary of mixture at the n values
+// v_first + i * v_step.
+SEXP new_boundary_vector(
+    std::unique_ptr<confseq::MixtureSupermartingale>&& mixture,
+    const double alpha, const R_xlen_t n, const double v_first,
+    const double v_step) {
+  std::unique_ptr<confseq::BoundarySequence> sequence(
+      new confseq::BoundarySequence(std::move(mixture), alpha, n, v_step,
+                                    v_first - v_step, lazy_chunk_size));
+  SEXP pointer = PROTECT(R_MakeExternalPtr(sequence.release(), R_NilValue,
+                                           R_NilValue));
+  R_RegisterCFinalizerEx(pointer, boundary_vector_finalize, TRUE);
+  SEXP x = R_new_altrep(boundary_vector_class, pointer, R_NilValue);
+  UNPROTECT(1);
+  return x;
+}
+
 //' Logarithm of mixture supermartingale for the one- or two-sided normal
 //' mixture.
 //' @param s value of the underlying martingale
@@ -59,21 +362,67 @@ Rcpp::NumericVector normal_log_mixture(
                  s, v);
 }
 
+//' Always-valid p-value for the one- or two-sided normal mixture.
+//'
+//' Computes min(1, exp(-log_mixture)) from the corresponding
+//' \code{*_log_mixture} function, without the root search of the
+//' \code{*_mixture_bound} functions.
+//' @inheritParams normal_log_mixture
+//' @param running_min if TRUE, s and v are successive values of one
+//'   martingale and its intrinsic time, and the running minimum of the
+//'   p-values is returned
+//' @return p-values, or their running minimum
+//' @examples
+//' normal_p_value(c(10, 20, 30), c(100, 200, 300), 100, running_min=TRUE)
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector normal_p_value(
+    const Rcpp::NumericVector s, const Rcpp::NumericVector v,
+    const double v_opt, const double alpha_opt=0.05,
+    const bool is_one_sided=true, const bool running_min=false) {
+  if (is_one_sided) {
+    return recycled_p_values(confseq::OneSidedNormalMixture(v_opt, alpha_opt),
+                             s, v, running_min);
+  }
+  return recycled_p_values(confseq::TwoSidedNormalMixture(v_opt, alpha_opt),
+                           s, v, running_min);
+}
+
 //' One- or two-sided normal mixture uniform boundary.
 //' @param v intrinsic time value
 //' @param alpha the error / crossing probability of the boundary
 //' @param v_opt intrinsic time value for which the boundary is optimized
 //' @param alpha_opt alpha for which the boundary is optimized
 //' @param is_one_sided if FALSE, use the two-sided normal mixture
+//' @details For a single `alpha` and a long, evenly spaced `v`, such as
+//'   `1:1e8 / 4`, the result is a lazy vector: entries are computed as they
+//'   are read, so subsetting or summarizing part of a long boundary costs only
+//'   what is read. The full vector is computed, across threads, only when R
+//'   needs all of it at once, for instance to modify it. Set
+//'   `options(confseq.lazy_bounds = FALSE)` to always compute eagerly.
 //' @examples
 //' normal_mixture_bound(c(100, 200), .05, 100)
 //' normal_mixture_bound(100, c(.05, .01), 100)
+//' bound <- normal_mixture_bound(1:1e8, .05, 100)
+//' bound[c(1, 1e8)]
 //' @export
 // [[Rcpp::export]]
-Rcpp::NumericVector normal_mixture_bound(
-    const Rcpp::NumericVector v, const Rcpp::NumericVector alpha,
-    const double v_opt, const double alpha_opt=0.05,
-    const bool is_one_sided=true) {
+SEXP normal_mixture_bound(
+    SEXP v, const Rcpp::NumericVector alpha, const double v_opt,
+    const double alpha_opt=0.05, const bool is_one_sided=true) {
+  double v_first, v_step;
+  if (alpha.size() == 1 && lazy_bound_inputs(v, alpha[0], v_first, v_step)) {
+    std::unique_ptr<confseq::MixtureSupermartingale> mixture;
+    if (is_one_sided) {
+      mixture = std::make_unique<confseq::OneSidedNormalMixture>(v_opt,
+                                                                 alpha_opt);
+    } else {
+      mixture = std::make_unique<confseq::TwoSidedNormalMixture>(v_opt,
+                                                                 alpha_opt);
+    }
+    return new_boundary_vector(std::move(mixture), alpha[0], XLENGTH(v),
+                               v_first, v_step);
+  }
   return mapply2(std::bind(confseq::normal_mixture_bound, _1, _2, v_opt,
                            alpha_opt, is_one_sided),
                  v, alpha);
@@ -94,18 +443,47 @@ Rcpp::NumericVector gamma_exponential_log_mixture(
                  s, v);
 }
 
+//' Always-valid p-value for the gamma-exponential mixture.
+//' @inheritParams gamma_exponential_log_mixture
+//' @inherit normal_p_value
+//' @examples
+//' gamma_exponential_p_value(c(10, 20), c(100, 400), 100, 2)
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector gamma_exponential_p_value(
+    const Rcpp::NumericVector s, const Rcpp::NumericVector v,
+    const double v_opt, const double c, const double alpha_opt=0.05,
+    const bool running_min=false) {
+  return recycled_p_values(
+      confseq::GammaExponentialMixture(v_opt, alpha_opt, c), s, v,
+      running_min);
+}
+
 //' Gamma-exponential uniform boundary.
 //' @inherit normal_mixture_bound
 //' @param c sub-exponential scale parameter
+//' @param precision "exact", or "balanced" or "fast" to trade accuracy of the
+//'   root search and special functions, about 1e-9 and 1e-6 relative plus the
+//'   special-function error, for speed. Reduced precision only widens bounds.
 //' @examples
 //' gamma_exponential_mixture_bound(c(100, 200), .05, 100, 2)
+//' gamma_exponential_mixture_bound(c(100, 200), .05, 100, 2, precision="fast")
 //' @export
 // [[Rcpp::export]]
-Rcpp::NumericVector gamma_exponential_mixture_bound(
-    const Rcpp::NumericVector v, const Rcpp::NumericVector alpha,
-    const double v_opt, const double c, const double alpha_opt=0.05) {
+SEXP gamma_exponential_mixture_bound(
+    SEXP v, const Rcpp::NumericVector alpha, const double v_opt,
+    const double c, const double alpha_opt=0.05,
+    const std::string precision="exact") {
+  double v_first, v_step;
+  if (alpha.size() == 1 && lazy_bound_inputs(v, alpha[0], v_first, v_step)) {
+    auto mixture = std::make_unique<confseq::GammaExponentialMixture>(
+        v_opt, alpha_opt, c);
+    mixture->set_precision(parse_precision(precision));
+    return new_boundary_vector(std::move(mixture), alpha[0], XLENGTH(v),
+                               v_first, v_step);
+  }
   return mapply2(std::bind(confseq::gamma_exponential_mixture_bound, _1, _2,
-                           v_opt, c, alpha_opt),
+                           v_opt, c, alpha_opt, parse_precision(precision)),
                  v, alpha);
 }
 
@@ -124,18 +502,42 @@ Rcpp::NumericVector gamma_poisson_log_mixture(
                  s, v);
 }
 
+//' Always-valid p-value for the gamma-Poisson mixture.
+//' @inheritParams gamma_poisson_log_mixture
+//' @inherit normal_p_value
+//' @examples
+//' gamma_poisson_p_value(c(10, 20), c(100, 400), 100, 2)
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector gamma_poisson_p_value(
+    const Rcpp::NumericVector s, const Rcpp::NumericVector v,
+    const double v_opt, const double c, const double alpha_opt=0.05,
+    const bool running_min=false) {
+  return recycled_p_values(confseq::GammaPoissonMixture(v_opt, alpha_opt, c),
+                           s, v, running_min);
+}
+
 //' Gamma-Poisson uniform boundary.
-//' @inherit normal_mixture_bound
+//' @inherit gamma_exponential_mixture_bound
 //' @param c sub-Poisson scale parameter
 //' @examples
 //' gamma_poisson_mixture_bound(c(100, 200), .05, 100, 2)
 //' @export
 // [[Rcpp::export]]
-Rcpp::NumericVector gamma_poisson_mixture_bound(
-    const Rcpp::NumericVector v, const Rcpp::NumericVector alpha,
-    const double v_opt, const double c, const double alpha_opt=0.05) {
+SEXP gamma_poisson_mixture_bound(
+    SEXP v, const Rcpp::NumericVector alpha, const double v_opt,
+    const double c, const double alpha_opt=0.05,
+    const std::string precision="exact") {
+  double v_first, v_step;
+  if (alpha.size() == 1 && lazy_bound_inputs(v, alpha[0], v_first, v_step)) {
+    auto mixture = std::make_unique<confseq::GammaPoissonMixture>(
+        v_opt, alpha_opt, c);
+    mixture->set_precision(parse_precision(precision));
+    return new_boundary_vector(std::move(mixture), alpha[0], XLENGTH(v),
+                               v_first, v_step);
+  }
   return mapply2(std::bind(confseq::gamma_poisson_mixture_bound, _1, _2, v_opt,
-                           c, alpha_opt),
+                           c, alpha_opt, parse_precision(precision)),
                  v, alpha);
 }
 
@@ -157,19 +559,46 @@ Rcpp::NumericVector beta_binomial_log_mixture(
                  s, v);
 }
 
+//' Always-valid p-value for the beta-binomial mixture.
+//' @inheritParams beta_binomial_log_mixture
+//' @inherit normal_p_value
+//' @examples
+//' beta_binomial_p_value(c(10, 20), c(100, 400), 100, .2, .8)
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector beta_binomial_p_value(
+    const Rcpp::NumericVector s, const Rcpp::NumericVector v,
+    const double v_opt, const double g, const double h,
+    const double alpha_opt=0.05, const bool is_one_sided=true,
+    const bool running_min=false) {
+  return recycled_p_values(
+      confseq::BetaBinomialMixture(v_opt, alpha_opt, g, h, is_one_sided), s, v,
+      running_min);
+}
+
 //' Beta-binomial uniform boundary.
 //' @inherit normal_mixture_bound
 //' @inherit beta_binomial_log_mixture
+//' @inheritParams gamma_exponential_mixture_bound
 //' @examples
 //' beta_binomial_mixture_bound(c(100, 200), .05, 100, .2, .8)
 //' @export
 // [[Rcpp::export]]
-Rcpp::NumericVector beta_binomial_mixture_bound(
-    const Rcpp::NumericVector v, const Rcpp::NumericVector alpha,
-    const double v_opt, const double g, const double h,
-    const double alpha_opt=0.05, const bool is_one_sided=true) {
+SEXP beta_binomial_mixture_bound(
+    SEXP v, const Rcpp::NumericVector alpha, const double v_opt,
+    const double g, const double h, const double alpha_opt=0.05,
+    const bool is_one_sided=true, const std::string precision="exact") {
+  double v_first, v_step;
+  if (alpha.size() == 1 && lazy_bound_inputs(v, alpha[0], v_first, v_step)) {
+    auto mixture = std::make_unique<confseq::BetaBinomialMixture>(
+        v_opt, alpha_opt, g, h, is_one_sided);
+    mixture->set_precision(parse_precision(precision));
+    return new_boundary_vector(std::move(mixture), alpha[0], XLENGTH(v),
+                               v_first, v_step);
+  }
   return mapply2(std::bind(confseq::beta_binomial_mixture_bound, _1, _2, v_opt,
-                           g, h, alpha_opt, is_one_sided),
+                           g, h, alpha_opt, is_one_sided,
+                           parse_precision(precision)),
                  v, alpha);
 }
 
@@ -187,9 +616,8 @@ Rcpp::NumericVector poly_stitching_bound(
     const Rcpp::NumericVector v, const Rcpp::NumericVector alpha,
     const double v_min, const double c=0, const double s=1.4,
     const double eta=2) {
-  return mapply2(
-      std::bind(confseq::poly_stitching_bound, _1, _2, v_min, c, s, eta),
-      v, alpha);
+  return recycled_poly_stitching_bounds(
+      confseq::PolyStitchingBound(v_min, c, s, eta), v, alpha);
 }
 
 //' Empirical process finite LIL bound.
@@ -259,6 +687,8 @@ Rcpp::NumericVector double_stitching_bound(
 //' @param alpha_opt 1 - confidence level for which confidence is optimized
 //' @return a list with named elements `lower` and `upper` giving lower and
 //'   upper confidence bounds, respectively
+//' @details Vector arguments are recycled to a common length, and intervals
+//'   are computed across threads.
 //' @examples
 //' bernoulli_confidence_interval(c(50, 500, 5000), c(100, 1000, 10000), .05,
 //'                               1000)
@@ -267,16 +697,67 @@ Rcpp::NumericVector double_stitching_bound(
 Rcpp::List bernoulli_confidence_interval(
     const Rcpp::NumericVector num_successes,
     const Rcpp::NumericVector num_trials, const double alpha,
-    const double t_opt, const double alpha_opt=0.05) {
+    const Rcpp::NumericVector t_opt, const double alpha_opt=0.05) {
+  int n = std::max({num_successes.size(), num_trials.size(), t_opt.size()});
+  const Rcpp::NumericVector num_successes_recycled =
+      Rcpp::rep_len(num_successes, n);
+  const Rcpp::NumericVector num_trials_recycled = Rcpp::rep_len(num_trials, n);
+  const Rcpp::NumericVector t_opt_recycled = Rcpp::rep_len(t_opt, n);
+  Rcpp::NumericVector lower_bounds(n);
+  Rcpp::NumericVector upper_bounds(n);
+  // Worker threads touch only raw storage, never the R API.
+  const double* successes_data = num_successes_recycled.begin();
+  const double* trials_data = num_trials_recycled.begin();
+  const double* t_opt_data = t_opt_recycled.begin();
+  double* lower_data = lower_bounds.begin();
+  double* upper_data = upper_bounds.begin();
+  apply_num_threads_option();
+  confseq::parallel_for(n, [=](const size_t i) {
+    auto bounds = confseq::bernoulli_confidence_interval(
+        successes_data[i], trials_data[i], alpha, t_opt_data[i], alpha_opt);
+    lower_data[i] = bounds.first;
+    upper_data[i] = bounds.second;
+  });
+  return Rcpp::List::create(Rcpp::_["lower"]=lower_bounds,
+                            Rcpp::_["upper"]=upper_bounds);
+}
+
+//' Streaming confidence sequence for [0, 1]-bounded distributions.
+//'
+//' Computes the same intervals as `bernoulli_confidence_interval` at each step
+//' of a stream of observations, re-solving each endpoint from a narrow bracket
+//' around its previous value. This is much faster than recomputing every
+//' interval from scratch.
+//'
+//' @param num_successes numbers of successes (or sums of outcomes) observed in
+//'   each step
+//' @param num_trials numbers of observations in each step
+//' @param alpha 1 - confidence level
+//' @param t_opt sample size for which confidence sequence is optimized
+//' @param alpha_opt 1 - confidence level for which confidence is optimized
+//' @param running_intersection if true, report the intersection of all
+//'   intervals up to each step
+//' @return a list with named elements `lower` and `upper` giving lower and
+//'   upper confidence bounds after each step
+//' @examples
+//' bernoulli_confidence_sequence(rbinom(100, 10, .3), 10, .05, 1000)
+//' @export
+// [[Rcpp::export]]
+Rcpp::List bernoulli_confidence_sequence(
+    const Rcpp::NumericVector num_successes,
+    const Rcpp::IntegerVector num_trials, const double alpha,
+    const double t_opt, const double alpha_opt=0.05,
+    const bool running_intersection=false) {
   int n = std::max(num_successes.size(), num_trials.size());
   auto num_successes_recycled = Rcpp::rep_len(num_successes, n);
   auto num_trials_recycled = Rcpp::rep_len(num_trials, n);
+  confseq::BernoulliConfidenceSequence sequence(alpha, t_opt, alpha_opt,
+                                                running_intersection);
   Rcpp::NumericVector lower_bounds(n);
   Rcpp::NumericVector upper_bounds(n);
   for (int i = 0; i < n; i++) {
-    auto bounds = confseq::bernoulli_confidence_interval(
-        num_successes_recycled[i], num_trials_recycled[i], alpha, t_opt,
-        alpha_opt);
+    auto bounds = sequence.update(num_successes_recycled[i],
+                                  num_trials_recycled[i]);
     lower_bounds[i] = bounds.first;
     upper_bounds[i] = bounds.second;
   }
@@ -284,6 +765,41 @@ Rcpp::List bernoulli_confidence_interval(
                             Rcpp::_["upper"]=upper_bounds);
 }
 
+// Calls fn(first, last) on the values of an R vector. Integer vectors are read
+// in place as ints; others are coerced to doubles held in converted.
+template <class Fn>
+void with_values(SEXP values, Rcpp::NumericVector& converted, Fn fn) {
+  if (TYPEOF(values) == INTSXP) {
+    const int* first = INTEGER(values);
+    fn(first, first + XLENGTH(values));
+  } else {
+    converted = Rcpp::NumericVector(values);
+    fn(converted.begin(), converted.end());
+  }
+}
+
+// With assume_sorted, values are read in place rather than copied and sorted.
+std::array<std::shared_ptr<confseq::OrderStatisticInterface>, 2>
+arm_order_statistics(SEXP a_values, SEXP b_values, const bool assume_sorted,
+                     const bool check_sorted,
+                     std::array<Rcpp::NumericVector, 2>& converted) {
+  std::array<std::shared_ptr<confseq::OrderStatisticInterface>, 2> arms;
+  with_values(a_values, converted[0], [&](const auto* a_first,
+                                          const auto* a_last) {
+    with_values(b_values, converted[1], [&](const auto* b_first,
+                                            const auto* b_last) {
+      if (assume_sorted && check_sorted
+          && !(std::is_sorted(a_first, a_last)
+               && std::is_sorted(b_first, b_last))) {
+        Rcpp::stop("values are not sorted");
+      }
+      arms = confseq::two_arm_order_statistics(a_first, a_last, b_first,
+                                               b_last, assume_sorted);
+    });
+  });
+  return arms;
+}
+
 //' Two-sample, sequential test of equal quantiles.
 //'
 //' This function tests the null that two i.i.d. samples are drawn from
@@ -295,19 +811,384 @@ Rcpp::List bernoulli_confidence_interval(
 //' @param quantile_p designates which quantile we wish to test
 //' @param t_opt sample size for which test is optimized
 //' @param alpha_opt level for which test is optimized
+//' @param assume_sorted if TRUE, values are already in ascending order and are
+//'   read in place, without copying or sorting
+//' @param check_sorted with `assume_sorted`, verify the order in a single pass
+//'   and signal an error if it does not hold
 //' @examples
 //' quantile_ab_p_value(1:1000, 86:1085, .5, 100)
 //' @export
 // [[Rcpp::export]]
-double quantile_ab_p_value(const Rcpp::NumericVector a_values,
-                           const Rcpp::NumericVector b_values,
+double quantile_ab_p_value(SEXP a_values, SEXP b_values,
                            const double quantile_p, const int t_opt,
-                           const double alpha_opt=0.05) {
-  auto a_os = std::make_unique<confseq::StaticOrderStatistics>(
-      a_values.begin(), a_values.end());
-  auto b_os = std::make_unique<confseq::StaticOrderStatistics>(
-      b_values.begin(), b_values.end());
-  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, std::move(a_os),
-                               std::move(b_os));
+                           const double alpha_opt=0.05,
+                           const bool assume_sorted=false,
+                           const bool check_sorted=true) {
+  std::array<Rcpp::NumericVector, 2> converted;
+  apply_num_threads_option();
+  const auto arms = arm_order_statistics(a_values, b_values, assume_sorted,
+                                         check_sorted, converted);
+  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, arms[0],
+                               arms[1]);
   return test.p_value();
 }
+
+//' Two-sample, sequential tests of equal quantiles at several levels.
+//'
+//' Computes `quantile_ab_p_value` for each level in `quantile_p`, sorting each
+//' sample once and testing the levels across threads.
+//'
+//' @inheritParams quantile_ab_p_value
+//' @param quantile_p vector of quantiles to test
+//' @return vector of p-values, one for each element of `quantile_p`
+//' @examples
+//' quantile_ab_p_values(1:1000, 56:1055, c(.5, .9, .99), 100)
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector quantile_ab_p_values(SEXP a_values, SEXP b_values,
+                                         const Rcpp::NumericVector quantile_p,
+                                         const int t_opt,
+                                         const double alpha_opt=0.05,
+                                         const bool assume_sorted=false,
+                                         const bool check_sorted=true) {
+  std::array<Rcpp::NumericVector, 2> converted;
+  apply_num_threads_option();
+  const auto arms = arm_order_statistics(a_values, b_values, assume_sorted,
+                                         check_sorted, converted);
+  Rcpp::NumericVector p_values(quantile_p.size());
+  confseq::quantile_ab_p_values(arms[0], arms[1], quantile_p.begin(),
+                                quantile_p.size(), t_opt, alpha_opt,
+                                p_values.begin());
+  return p_values;
+}
+
+//' Root-search work counters.
+//'
+//' Counts the work done by mixture bound and Bernoulli confidence interval
+//' root searches on the calling thread, for tuning `v_opt`, `alpha_opt` and
+//' solver precision. Counts stay zero unless the package was compiled with
+//' `-DCONFSEQ_INSTRUMENT`, for example through `PKG_CPPFLAGS` in
+//' `~/.R/Makevars`. Work on worker threads is not included, so measure with
+//' `options(confseq.num_threads = 1)`.
+//' @return named vector of counts: solves, objective_evaluations,
+//'   bracket_expansions, halley_steps, bisection_steps,
+//'   special_function_calls and max_evaluations_per_solve. The
+//'   `instrumented` attribute is TRUE when counting is compiled in.
+//' @examples
+//' reset_solver_counters()
+//' normal_mixture_bound(100, .05, 100)
+//' solver_counters()
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericVector solver_counters() {
+  const confseq::SolverCounters& counters = confseq::solver_counters();
+  Rcpp::NumericVector result = Rcpp::NumericVector::create(
+      counters.solves, counters.objective_evaluations,
+      counters.bracket_expansions, counters.halley_steps,
+      counters.bisection_steps, counters.special_function_calls,
+      counters.max_evaluations_per_solve);
+  result.names() = Rcpp::CharacterVector::create(
+      "solves", "objective_evaluations", "bracket_expansions", "halley_steps",
+      "bisection_steps", "special_function_calls",
+      "max_evaluations_per_solve");
+  result.attr("instrumented") = confseq::instrumentation_enabled();
+  return result;
+}
+
+//' @rdname solver_counters
+//' @export
+// [[Rcpp::export]]
+void reset_solver_counters() {
+  confseq::reset_solver_counters();
+}
+
+// Methods of the boundaries module below. Objects are tuned once on
+// construction, and vector methods recycle their arguments like the
+// functions above.
+
+Rcpp::NumericVector mixture_log_superMG(
+    confseq::MixtureSupermartingale* mixture, const Rcpp::NumericVector s,
+    const Rcpp::NumericVector v) {
+  return mapply2([mixture](const double s, const double v) {
+                   return mixture->log_superMG(s, v);
+                 },
+                 s, v);
+}
+
+// MixtureBoundary keeps its own copy of the mixture, of whichever module
+// class the R object is.
+template <class Mixture>
+bool copy_mixture(SEXP mixture, const char* r_class,
+                  std::unique_ptr<confseq::MixtureSupermartingale>& copy) {
+  if (!Rf_inherits(mixture, r_class)) {
+    return false;
+  }
+  const Rcpp::Environment object(mixture);
+  const Rcpp::XPtr<Mixture> pointer(object.get(".pointer"));
+  copy = std::make_unique<Mixture>(*pointer);
+  return true;
+}
+
+// Lazy vectors from a mixture's methods keep their own copy of it, found
+// from the C++ object the method is called on.
+template <class Mixture>
+bool copy_mixture(const confseq::MixtureSupermartingale* mixture,
+                  std::unique_ptr<confseq::MixtureSupermartingale>& copy) {
+  const Mixture* derived = dynamic_cast<const Mixture*>(mixture);
+  if (derived == nullptr) {
+    return false;
+  }
+  copy = std::make_unique<Mixture>(*derived);
+  return true;
+}
+
+// The bound of mixture at v for a single alpha as a lazy vector, or
+// R_NilValue if lazy_bound_inputs declines v or mixture is of no module class.
+SEXP lazy_mixture_bound(const confseq::MixtureSupermartingale* mixture,
+                        SEXP v, const double alpha) {
+  double v_first, v_step;
+  std::unique_ptr<confseq::MixtureSupermartingale> copy;
+  if (!lazy_bound_inputs(v, alpha, v_first, v_step)
+      || !(copy_mixture<confseq::TwoSidedNormalMixture>(mixture, copy)
+           || copy_mixture<confseq::OneSidedNormalMixture>(mixture, copy)
+           || copy_mixture<confseq::GammaExponentialMixture>(mixture, copy)
+           || copy_mixture<confseq::GammaPoissonMixture>(mixture, copy)
+           || copy_mixture<confseq::BetaBinomialMixture>(mixture, copy))) {
+    return R_NilValue;
+  }
+  return new_boundary_vector(std::move(copy), alpha, XLENGTH(v), v_first,
+                             v_step);
+}
+
+SEXP mixture_bound(confseq::MixtureSupermartingale* mixture, SEXP v,
+                   const Rcpp::NumericVector alpha) {
+  if (alpha.size() == 1) {
+    const SEXP lazy = lazy_mixture_bound(mixture, v, alpha[0]);
+    if (lazy != R_NilValue) {
+      return lazy;
+    }
+  }
+  return mapply2([mixture](const double v, const double alpha) {
+                   return mixture->bound(v, log(1 / alpha));
+                 },
+                 v, alpha);
+}
+
+SEXP mixture_bound_sequence(confseq::MixtureSupermartingale* mixture, SEXP v,
+                            const double alpha) {
+  const SEXP lazy = lazy_mixture_bound(mixture, v, alpha);
+  if (lazy != R_NilValue) {
+    return lazy;
+  }
+  const Rcpp::NumericVector v_values(v);
+  Rcpp::NumericVector out(v_values.size());
+  mixture->bound_sequence(v_values.begin(), v_values.size(), log(1 / alpha),
+                          out.begin());
+  return out;
+}
+
+std::unique_ptr<confseq::MixtureSupermartingale> copy_any_mixture(
+    SEXP mixture) {
+  std::unique_ptr<confseq::MixtureSupermartingale> copy;
+  if (!(copy_mixture<confseq::TwoSidedNormalMixture>(
+            mixture, "Rcpp_TwoSidedNormalMixture", copy)
+        || copy_mixture<confseq::OneSidedNormalMixture>(
+            mixture, "Rcpp_OneSidedNormalMixture", copy)
+        || copy_mixture<confseq::GammaExponentialMixture>(
+            mixture, "Rcpp_GammaExponentialMixture", copy)
+        || copy_mixture<confseq::GammaPoissonMixture>(
+            mixture, "Rcpp_GammaPoissonMixture", copy)
+        || copy_mixture<confseq::BetaBinomialMixture>(
+            mixture, "Rcpp_BetaBinomialMixture", copy))) {
+    Rcpp::stop("mixture must be one of the mixture classes");
+  }
+  return copy;
+}
+
+confseq::MixtureBoundary* new_mixture_boundary(SEXP mixture) {
+  return new confseq::MixtureBoundary(copy_any_mixture(mixture));
+}
+
+Rcpp::NumericVector mixture_boundary_bound(confseq::MixtureBoundary* boundary,
+                                           const Rcpp::NumericVector v,
+                                           const Rcpp::NumericVector alpha) {
+  return mapply2([boundary](const double v, const double alpha) {
+                   return (*boundary)(v, alpha);
+                 },
+                 v, alpha);
+}
+
+Rcpp::NumericVector mixture_boundary_bound_sequence(
+    confseq::MixtureBoundary* boundary, const Rcpp::NumericVector v,
+    const double alpha) {
+  Rcpp::NumericVector out(v.size());
+  boundary->bound_sequence(v.begin(), v.size(), alpha, out.begin());
+  return out;
+}
+
+confseq::BoundarySequence* new_boundary_sequence(
+    SEXP mixture, const double alpha, const double size, const double v_scale,
+    const double v_offset, const int chunk_size) {
+  if (size < 0 || chunk_size < 1) {
+    Rcpp::stop("size must be nonnegative and chunk_size positive");
+  }
+  return new confseq::BoundarySequence(copy_any_mixture(mixture), alpha, size,
+                                       v_scale, v_offset, chunk_size);
+}
+
+// Entries at 1-based times t, each computing and caching its chunk on first
+// access.
+Rcpp::NumericVector boundary_sequence_at(confseq::BoundarySequence* sequence,
+                                         const Rcpp::NumericVector t) {
+  Rcpp::NumericVector out(t.size());
+  for (R_xlen_t i = 0; i < t.size(); i++) {
+    if (!(t[i] >= 1 && t[i] <= sequence->size())) {
+      Rcpp::stop("t must be between 1 and the sequence size");
+    }
+    out[i] = (*sequence)[size_t(t[i]) - 1];
+  }
+  return out;
+}
+
+// Entries at times from, ..., to, without adding to the cache.
+Rcpp::NumericVector boundary_sequence_range(
+    confseq::BoundarySequence* sequence, const double from, const double to) {
+  if (!(1 <= from && from <= to + 1 && to <= sequence->size())) {
+    Rcpp::stop("from and to must be between 1 and the sequence size");
+  }
+  Rcpp::NumericVector out(size_t(to) - size_t(from) + 1);
+  sequence->values(size_t(from) - 1, size_t(to), out.begin());
+  return out;
+}
+
+void boundary_sequence_discard_before(confseq::BoundarySequence* sequence,
+                                      const double t) {
+  sequence->discard_before(t < 1 ? 0 : size_t(t) - 1);
+}
+
+double boundary_sequence_size(confseq::BoundarySequence* sequence) {
+  return sequence->size();
+}
+
+Rcpp::NumericVector poly_stitching_bound_method(
+    confseq::PolyStitchingBound* bound, const Rcpp::NumericVector v,
+    const Rcpp::NumericVector alpha) {
+  return recycled_poly_stitching_bounds(*bound, v, alpha);
+}
+
+Rcpp::NumericVector empirical_process_lil_bound_method(
+    confseq::EmpiricalProcessLILBound* bound, const Rcpp::NumericVector t) {
+  Rcpp::NumericVector out(t.size());
+  const double* t_data = t.begin();
+  double* out_data = out.begin();
+  apply_num_threads_option();
+  confseq::parallel_for(t.size(), [=](const size_t i) {
+    out_data[i] = (*bound)(t_data[i]);
+  });
+  return out;
+}
+
+Rcpp::NumericVector double_stitching_bound_method(
+    confseq::DoubleStitchingBound* bound,
+    const Rcpp::NumericVector quantile_p, const Rcpp::NumericVector t,
+    const Rcpp::NumericVector alpha) {
+  return mapply3([bound](const double p, const double t, const double alpha) {
+                   return (*bound)(p, t, alpha);
+                 },
+                 quantile_p, t, alpha);
+}
+
+// The bound at every level in quantile_p for a single t and alpha, with the
+// t-dependent terms computed once.
+Rcpp::NumericVector double_stitching_band(
+    confseq::DoubleStitchingBound* bound,
+    const Rcpp::NumericVector quantile_p, const double t,
+    const double alpha) {
+  Rcpp::NumericVector out(quantile_p.size());
+  bound->band(quantile_p.begin(), quantile_p.size(), t, alpha, out.begin());
+  return out;
+}
+
+// The config is owned by its R object, which outlives the test, so the test
+// shares it through a pointer that does not delete it.
+double quantile_ab_test_config_p_value(confseq::QuantileABTestConfig* config,
+                                       SEXP a_values, SEXP b_values,
+                                       const bool assume_sorted,
+                                       const bool check_sorted) {
+  std::array<Rcpp::NumericVector, 2> converted;
+  apply_num_threads_option();
+  const auto arms = arm_order_statistics(a_values, b_values, assume_sorted,
+                                         check_sorted, converted);
+  const confseq::QuantileABTest test(
+      std::shared_ptr<const confseq::QuantileABTestConfig>(
+          config, [](const confseq::QuantileABTestConfig*) {}),
+      arms[0], arms[1]);
+  return test.p_value();
+}
+
+RCPP_MODULE(boundaries) {
+  Rcpp::class_<confseq::MixtureSupermartingale>("MixtureSupermartingale")
+      .method("log_superMG", &mixture_log_superMG,
+              "Logarithm of the mixture supermartingale at s and v")
+      .method("bound", &mixture_bound,
+              "Uniform boundary at v with crossing probability alpha")
+      .method("bound_sequence", &mixture_bound_sequence,
+              "Uniform boundary over v for a single alpha, warm-starting "
+              "each root search from the previous element");
+  Rcpp::class_<confseq::TwoSidedNormalMixture>("TwoSidedNormalMixture")
+      .derives<confseq::MixtureSupermartingale>("MixtureSupermartingale")
+      .constructor<double, double>("v_opt, alpha_opt");
+  Rcpp::class_<confseq::OneSidedNormalMixture>("OneSidedNormalMixture")
+      .derives<confseq::MixtureSupermartingale>("MixtureSupermartingale")
+      .constructor<double, double>("v_opt, alpha_opt");
+  Rcpp::class_<confseq::GammaExponentialMixture>("GammaExponentialMixture")
+      .derives<confseq::MixtureSupermartingale>("MixtureSupermartingale")
+      .constructor<double, double, double>("v_opt, alpha_opt, c");
+  Rcpp::class_<confseq::GammaPoissonMixture>("GammaPoissonMixture")
+      .derives<confseq::MixtureSupermartingale>("MixtureSupermartingale")
+      .constructor<double, double, double>("v_opt, alpha_opt, c");
+  Rcpp::class_<confseq::BetaBinomialMixture>("BetaBinomialMixture")
+      .derives<confseq::MixtureSupermartingale>("MixtureSupermartingale")
+      .constructor<double, double, double, double, bool>(
+          "v_opt, alpha_opt, g, h, is_one_sided");
+
+  Rcpp::class_<confseq::MixtureBoundary>("MixtureBoundary")
+      .factory<SEXP>(&new_mixture_boundary,
+                     "copy of a mixture supermartingale object")
+      .method("bound", &mixture_boundary_bound,
+              "Uniform boundary at v with crossing probability alpha")
+      .method("bound_sequence", &mixture_boundary_bound_sequence,
+              "Uniform boundary over v for a single alpha");
+  Rcpp::class_<confseq::BoundarySequence>("BoundarySequence")
+      .factory<SEXP, double, double, double, double, int>(
+          &new_boundary_sequence,
+          "copy of a mixture supermartingale object, alpha, size, v_scale, "
+          "v_offset, chunk_size")
+      .method("at", &boundary_sequence_at,
+              "Boundary at times t, computed on first access")
+      .method("range", &boundary_sequence_range,
+              "Boundary at times from, ..., to")
+      .method("discard_before", &boundary_sequence_discard_before,
+              "Drop cached chunks lying entirely before time t")
+      .method("size", &boundary_sequence_size, "Number of times");
+  Rcpp::class_<confseq::PolyStitchingBound>("PolyStitchingBound")
+      .constructor<double, double, double, double>("v_min, c, s, eta")
+      .method("bound", &poly_stitching_bound_method,
+              "Uniform boundary at v with crossing probability alpha");
+  Rcpp::class_<confseq::EmpiricalProcessLILBound>("EmpiricalProcessLILBound")
+      .constructor<double, double, double>("alpha, t_min, A")
+      .method("bound", &empirical_process_lil_bound_method,
+              "Bound after t samples");
+  Rcpp::class_<confseq::DoubleStitchingBound>("DoubleStitchingBound")
+      .constructor<int, double, double, double>("t_opt, delta, s, eta")
+      .method("bound", &double_stitching_bound_method,
+              "Bound at quantile_p after t samples with crossing probability "
+              "alpha")
+      .method("band", &double_stitching_band,
+              "Bound at each level of quantile_p for a single t and alpha");
+  Rcpp::class_<confseq::QuantileABTestConfig>("QuantileABTestConfig")
+      .constructor<double, int, double>("quantile_p, t_opt, alpha_opt")
+      .method("p_value", &quantile_ab_test_config_p_value,
+              "quantile_ab_p_value of a_values against b_values, given "
+              "assume_sorted and check_sorted");
+}
@@ -34,8 +34,13 @@ setup(
     package_dir={'': 'src'},
     cmake_install_dir="src/confseq",
     include_package_data = True,
-    install_requires=['pybind11>=2.3', 'numpy', 'matplotlib', 'multiprocess',
-                      'scipy', 'pytest', 'pandas'],
+    # The compute modules need only NumPy and the compiled extensions.
+    # Plotting, in cs_plots, and the tests need the extras.
+    install_requires=['numpy'],
+    extras_require={
+        'plots': ['matplotlib'],
+        'test': ['pytest', 'scipy'],
+    },
     zip_safe=False,
     classifiers=[
         "Programming Language :: Python :: 3",
@@ -0,0 +1,7 @@
+import os
+
+# The native modules map the precomputed constants installed beside them on
+# first use, unless the environment names another file.
+_constants_bundle = os.path.join(os.path.dirname(__file__), "confseq_constants.bin")
+if os.path.exists(_constants_bundle):
+    os.environ.setdefault("CONFSEQ_CONSTANTS_BUNDLE", _constants_bundle)
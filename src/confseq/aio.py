@@ -0,0 +1,100 @@
+"""
+asyncio front end for the long-running entry points. Each coroutine runs its
+call on a dedicated thread pool, and the native kernels release the GIL, so
+the event loop keeps serving other requests while confidence sequences and
+p-values are computed, and many of them run concurrently without spawning
+processes.
+
+Cancelling a coroutine, or the future returned by `submit()`, drops a call
+that has not started yet. A native call already running cannot be
+interrupted: it runs to completion on its worker thread, and its result is
+discarded.
+"""
+
+import asyncio
+import functools
+
+from confseq import misc
+from confseq.batch import batch_cs
+from confseq.betting import betting_cs
+from confseq.quantiles import (
+    batch_quantile_ab_p_values,
+    quantile_ab_p_value,
+    quantile_ab_p_values,
+)
+
+
+def executor():
+    """
+    Thread pool that `submit()` runs calls on, `misc.thread_pool("aio")`. It
+    is separate from `betting.thread_pool()`, which calls running here may use
+    themselves with `parallel=True`.
+    """
+    return misc.thread_pool("aio")
+
+
+def submit(fn, *args, **kwargs):
+    """
+    Schedule `fn(*args, **kwargs)` on `executor()`
+
+    Parameters
+    ----------
+    fn, callable
+        Any function, typically one of the native batch functions such as
+        `boundaries.normal_mixture_bound` on arrays, or
+        `quantiles.QuantileABTestConfig.p_value`
+
+    Returns
+    -------
+    future, asyncio.Future
+        Result of the call, bound to the running event loop. Cancelling it
+        before the call starts removes the call from the queue
+    """
+    loop = asyncio.get_running_loop()
+    return loop.run_in_executor(executor(), functools.partial(fn, *args, **kwargs))
+
+
+async def betting_cs_async(x, **kwargs):
+    """
+    `betting.betting_cs(x, **kwargs)`, awaited without blocking the event loop
+    """
+    return await submit(betting_cs, x, **kwargs)
+
+
+async def batch_cs_async(values, **kwargs):
+    """
+    `batch.batch_cs(values, **kwargs)`, awaited without blocking the event loop
+    """
+    return await submit(batch_cs, values, **kwargs)
+
+
+async def quantile_ab_p_value_async(a_values, b_values, quantile_p, t_opt, **kwargs):
+    """
+    `quantiles.quantile_ab_p_value`, awaited without blocking the event loop
+    """
+    return await submit(
+        quantile_ab_p_value, a_values, b_values, quantile_p, t_opt, **kwargs
+    )
+
+
+async def quantile_ab_p_values_async(
+    a_values, b_values, quantile_p, t_opt, **kwargs
+):
+    """
+    `quantiles.quantile_ab_p_values`, awaited without blocking the event loop
+    """
+    return await submit(
+        quantile_ab_p_values, a_values, b_values, quantile_p, t_opt, **kwargs
+    )
+
+
+async def batch_quantile_ab_p_values_async(
+    a_values, b_values, quantile_p, t_opt, **kwargs
+):
+    """
+    `quantiles.batch_quantile_ab_p_values`, awaited without blocking the event
+    loop
+    """
+    return await submit(
+        batch_quantile_ab_p_values, a_values, b_values, quantile_p, t_opt, **kwargs
+    )
@@ -0,0 +1,167 @@
+import numpy as np
+
+from confseq.capital_processes import (
+    IntersectedConfidenceSequence,
+    batch_confidence_sequences,
+)
+
+
+def batch_cs(values, offsets=None, lengths=None, cs="predmix_empbern", **kwargs):
+    """
+    Confidence sequences of one kind for many independent streams, computed
+    natively across threads in a single call
+
+    Parameters
+    ----------
+    values, array-like of [0, 1]-valued reals
+        Either a 1-D array of streams held back to back, or a padded 2-D
+        array with one stream per row
+
+    offsets, array-like of nonnegative integers or None
+        For 1-D `values`, stream `s` is `values[offsets[s]:offsets[s + 1]]`.
+        Ignored for 2-D `values`
+
+    lengths, array-like of nonnegative integers or None
+        For 2-D `values`, the length of each row's stream, or None if every
+        row is a full stream. Entries past a stream's length are ignored
+
+    cs, string
+        "predmix_empbern", "predmix_hoeffding", "predmix_empbern_wor",
+        "predmix_hoeffding_wor", "conjmix_hoeffding", "conjmix_empbern" or
+        "hedged", for `predmix_empbern_cs`, `predmix_hoeffding_cs`,
+        `predmix_empbern_cs_wor`, `predmix_hoeffding_cs_wor`,
+        `conjmix_hoeffding_cs`, `conjmix_empbern_cs` and `hedged_cs`
+
+    kwargs
+        Arguments of `capital_processes.batch_confidence_sequences`: `alpha`,
+        `running_intersection`, `truncation`, `fixed_n`, `t_opt`, `v_opt`,
+        `N`, `population_sizes` (one `N` per stream), `lower_bd`,
+        `upper_bd`, `breaks`, `theta`, `trunc_scale`, `side` ("both", or
+        "lower" or "upper" for a one-sided "predmix_empbern",
+        "conjmix_empbern" or "hedged" sequence), `num_threads`, and `sink`
+        and `block_size` to write the bounds of 1-D `values` to a file or a
+        callback in blocks instead of returning them
+
+    Returns
+    -------
+    l, array-like of reals
+        Lower confidence sequences, laid out like `values`, with NaN past
+        each stream's length for 2-D `values`
+
+    u, array-like of reals
+        Upper confidence sequences, laid out like `l`, or None for both with
+        `sink`
+    """
+    values = np.asarray(values, dtype=float)
+    if values.ndim == 1:
+        if offsets is None:
+            offsets = [0, len(values)]
+        return batch_confidence_sequences(values, offsets, cs=cs, **kwargs)
+    if kwargs.get("sink") is not None:
+        raise ValueError("sink requires 1-D values")
+
+    num_streams, width = values.shape
+    if lengths is None:
+        lengths = np.full(num_streams, width)
+    lengths = np.asarray(lengths)
+    assert np.all((0 <= lengths) & (lengths <= width))
+    inside = np.arange(width) < lengths[:, np.newaxis]
+    offsets = np.append(0, np.cumsum(lengths))
+    flat_l, flat_u = batch_confidence_sequences(
+        values[inside], offsets, cs=cs, **kwargs
+    )
+    l = np.full(values.shape, np.nan)
+    u = np.full(values.shape, np.nan)
+    l[inside] = flat_l
+    u[inside] = flat_u
+    return l, u
+
+
+def chunked_cs(chunks, cs="predmix_empbern", **kwargs):
+    """
+    Confidence sequence of one stream that arrives as an iterable of chunks,
+    such as NumPy arrays or Arrow arrays read from the row groups of a
+    Parquet file, computed natively with bounded memory
+
+    The running sums, bets and grid of log capital are carried between
+    chunks, so the bounds are bit for bit those of `batch_cs` on the whole
+    stream, and the functions computed natively by it, such as
+    `conjmix_bounded.conjmix_empbern_cs`, however the stream is chunked.
+    The NumPy functions `predmix.predmix_empbern_cs` and `betting.hedged_cs`
+    agree with it up to rounding. Betting CSs with general bets functions,
+    as taken by `betting.betting_cs`, need the whole stream for their bets;
+    "hedged" is the betting CS computed in chunks.
+
+    Parameters
+    ----------
+    chunks, iterable of 1-D array-likes of [0, 1]-valued reals
+        Consecutive pieces of the stream, of any sizes
+
+    cs, string or list of strings
+        Kind of confidence sequence, as for `batch_cs`, or several kinds
+        whose intersection is taken, each at level `alpha / len(cs)`, as by
+        `capital_processes.intersected_cs`
+
+    kwargs
+        Arguments of `capital_processes.IntersectedConfidenceSequence`:
+        `alpha`, `running_intersection`, `truncation`, `fixed_n`, `t_opt`,
+        `v_opt`, `N`, `lower_bd`, `upper_bd`, `breaks`, `theta`,
+        `trunc_scale` and `side`
+
+    Yields
+    ------
+    l, u, arrays of reals
+        Lower and upper confidence sequences over each chunk in turn, as
+        long as the chunk
+    """
+    sequence = IntersectedConfidenceSequence(
+        [cs] if isinstance(cs, str) else list(cs), **kwargs
+    )
+    for chunk in chunks:
+        x = np.asarray(chunk, dtype=float)
+        if x.ndim != 1:
+            raise ValueError("chunks must be 1-D")
+        yield sequence.update(x)
+
+
+BOUNDS_FILE_MAGIC = b"CSBOUND\0"
+BOUNDS_FILE_HEADER_SIZE = 24
+
+
+def read_bounds_file(path):
+    """
+    Bounds written to a file by `batch_confidence_sequences` or
+    `intersected_cs` with a path as `sink`, memory-mapped rather than read,
+    so that files larger than memory can be sliced
+
+    Parameters
+    ----------
+    path, string or path-like
+        The file written
+
+    Returns
+    -------
+    l, array-like of reals
+        Lower bounds, a read-only view of the file
+
+    u, array-like of reals
+        Upper bounds, laid out like `l`
+    """
+    with open(path, "rb") as f:
+        header = f.read(BOUNDS_FILE_HEADER_SIZE)
+    if len(header) < BOUNDS_FILE_HEADER_SIZE or header[:8] != BOUNDS_FILE_MAGIC:
+        raise ValueError("not a bounds file")
+    version = int(np.frombuffer(header[8:12], dtype=np.uint32)[0])
+    num_rows = int(np.frombuffer(header[16:24], dtype=np.uint64)[0])
+    if version != 1:
+        raise ValueError("unsupported bounds file version")
+    if num_rows == 0:
+        return np.empty(0), np.empty(0)
+    rows = np.memmap(
+        path,
+        dtype=np.float64,
+        mode="r",
+        offset=BOUNDS_FILE_HEADER_SIZE,
+        shape=(num_rows, 2),
+    )
+    return rows[:, 0], rows[:, 1]
@@ -1,15 +1,42 @@
 import numpy as np
 import math
-import matplotlib.pyplot as plt
-from time import time
-from scipy.optimize import minimize, newton, root
-import multiprocess
-from copy import copy, deepcopy
-from logging import info, warnings
 
+from confseq import capital_processes, misc
+from confseq.capital_processes import (
+    BettingStrategy,
+    BettingStrategyKind,
+    HedgedConfidenceSequence,
+    betting_capital_process,
+    betting_cs_bisection,
+    betting_grid_cs,
+    betting_strategy_bets,
+    diversified_betting_capital_process,
+    diversified_betting_ci_sequence,
+    diversified_betting_first_rejections,
+    diversified_betting_grid_cs,
+    diversified_betting_grid_cs_thresholds,
+    diversified_betting_pruned_grid_cs,
+)
 from confseq.predmix import lambda_predmix_eb
 
 
+def thread_pool():
+    """
+    Thread pool for `parallel=True` evaluation of Python callables,
+    `misc.thread_pool("betting")`. Threads share `x` without pickling or
+    copies, and native kernels called from the callables release the GIL.
+    """
+    return misc.thread_pool("betting")
+
+
+def thread_map(fn, iterable):
+    """
+    `map(fn, iterable)` across the threads of `thread_pool()`, or on the
+    calling thread when it is already one of them, as `misc.pool_map` does.
+    """
+    return misc.pool_map("betting", fn, iterable)
+
+
 def betting_mart(
     x,
     m,
@@ -21,6 +48,9 @@ def betting_mart(
     theta=1 / 2,
     trunc_scale=1 / 2,
     m_trunc=True,
+    log_space=False,
+    weights=None,
+    max_weight=None,
 ):
     """
     Betting martingale for a given sequence
@@ -37,11 +67,13 @@ def betting_mart(
     alpha, real
         Significance level between 0 and 1.
 
-    lambdas_fn_postive, bivariate function or None
+    lambdas_fn_postive, bivariate function, BettingStrategy or None
         Function of `x` and `m` which generates an array-like
-        of bets with the same length as `x`.
+        of bets with the same length as `x`, or a native
+        `BettingStrategy` or its name, evaluated without Python
+        callbacks. If None, `lambda_predmix_eb` with `alpha` is used.
 
-    lambdas_fn_negative=None, bivariate function or None
+    lambdas_fn_negative=None, bivariate function, BettingStrategy or None
         Same as above but for the negative capital process.
         This will be set to lambdas_fn_positive if
         left as None.
@@ -71,90 +103,138 @@ def betting_mart(
         depending on the capital process. If False, then truncation
         will be given by trunc_scale.
 
+    log_space, boolean
+        Should the log of the martingale be returned? Log capital
+        neither overflows on long streams nor underflows to 0.
+
+    weights, array-like or None
+        Importance weights of the observations for off-policy estimation,
+        such as target over logging propensities, between 0 and
+        `max_weight`. The mean is then that of `x` under the target policy,
+        from the weighted outcomes `weights * x`. Requires sampling with
+        replacement.
+
+    max_weight, real or None
+        Bound on `weights`, fixed before the data are seen, by which bets
+        are truncated so that capital stays nonnegative on the weighted
+        outcomes. Required with `weights`.
+        Bets functions are evaluated on the weighted outcomes.
+
 
     Returns
     -------
     mart, array-like
-        The martingale that results from the observed x
+        The martingale that results from the observed x, or its log
+        if `log_space` is True
     """
 
-    if lambdas_fn_positive is None:
-        lambdas_fn_positive = lambda x, m: lambda_predmix_eb(x, alpha=alpha)
-
     if lambdas_fn_negative is None:
         lambdas_fn_negative = lambdas_fn_positive
 
+    x, max_weight = importance_weighted(x, weights, max_weight, N)
+    lambdas_positive, lambdas_negative = [
+        bets(lambdas_fn, x, m, alpha=alpha, N=N, negative=negative)
+        for lambdas_fn, negative in [
+            (lambdas_fn_positive, False),
+            (lambdas_fn_negative, True),
+        ]
+    ]
+
+    assert 0 < trunc_scale <= 1
+    return betting_capital_process(
+        x,
+        m,
+        lambdas_positive,
+        lambdas_negative,
+        N=0 if N is None else N,
+        convex_comb=convex_comb,
+        theta=theta,
+        trunc_scale=trunc_scale,
+        m_trunc=m_trunc,
+        log_space=log_space,
+        max_weight=max_weight,
+    )
+
+
+def importance_weighted(x, weights, max_weight, N=None):
+    """
+    The observations to bet on and the bound on them, as a tuple
+    `(weights * x, max_weight)`, or `(x, 1)` without weights. Raises
+    `ValueError` for weights outside [0, `max_weight`], a missing
+    `max_weight`, or sampling without replacement.
+    """
+    x = np.asarray(x, dtype=float)
+    if weights is None:
+        return x, 1 if max_weight is None else max_weight
+    if max_weight is None:
+        raise ValueError("weights require a known bound max_weight")
     if N is not None:
-        t = np.arange(1, len(x) + 1)
-        S_t = np.cumsum(x)
-        S_tminus1 = np.append(0, S_t[0 : (len(x) - 1)])
-        mu_t = (N * m - S_tminus1) / (N - (t - 1))
-    else:
-        mu_t = np.repeat(m, len(x))
+        raise ValueError("weights require sampling with replacement")
+    weights = np.asarray(weights, dtype=float)
+    if weights.shape != x.shape:
+        raise ValueError("weights must have the same shape as x")
+    if not np.all((0 <= weights) & (weights <= max_weight)):
+        raise ValueError("weights must lie in [0, max_weight]")
+    return weights * x, max_weight
 
-    lambdas_positive = lambdas_fn_positive(x, m)
-    lambdas_negative = lambdas_fn_negative(x, m)
 
-    assert 0 < trunc_scale <= 1
-    # if we want to truncate with m
-    if m_trunc:
-        with np.errstate(divide="ignore"):
-            lambdas_positive = np.minimum(lambdas_positive, trunc_scale / mu_t)
-            lambdas_positive = np.maximum(lambdas_positive, -trunc_scale / (1 - mu_t))
-
-            lambdas_negative = np.minimum(lambdas_negative, trunc_scale / (1 - mu_t))
-            lambdas_negative = np.maximum(lambdas_negative, -trunc_scale / mu_t)
-    else:
-        lambdas_positive = np.minimum(lambdas_positive, trunc_scale)
-        lambdas_positive = np.maximum(lambdas_positive, -trunc_scale)
-
-        lambdas_negative = np.minimum(lambdas_negative, trunc_scale)
-        lambdas_negative = np.maximum(lambdas_negative, -trunc_scale)
-
-    with np.errstate(invalid="ignore"):
-        multiplicand_positive = 1 + lambdas_positive * (x - mu_t)
-        multiplicand_negative = 1 - lambdas_negative * (x - mu_t)
-
-    # Use convention that inf * 0 = 0. We still have
-    # a martingale under the null
-    multiplicand_positive[
-        np.logical_and(lambdas_positive == math.inf, x - mu_t == 0)
-    ] = 1
-    multiplicand_negative[
-        np.logical_and(lambdas_negative == math.inf, x - mu_t == 0)
-    ] = 1
-    
-    with np.errstate(invalid="ignore"):
-        capital_process_positive = np.cumprod(multiplicand_positive)
-        capital_process_negative = np.cumprod(multiplicand_negative)
-
-    # If we get nans from 0 * inf, this should be 0
-    capital_process_positive[np.isnan(capital_process_positive)] = 0
-    capital_process_negative[np.isnan(capital_process_negative)] = 0
-    
-    if theta == 1:
-        capital_process = theta * capital_process_positive
-    elif theta == 0:
-        capital_process = (1 - theta) * capital_process_negative
-    else:
-        if convex_comb:
-            capital_process = (
-                theta * capital_process_positive
-                + (1 - theta) * capital_process_negative
-            )
-        else:
-            capital_process = np.maximum(
-                theta * capital_process_positive, (1 - theta) * capital_process_negative
-            )
-    
-    # If mu_t < 0 or mu_t > 1, we cannot be under the null
-    capital_process[np.logical_or(mu_t < 0, mu_t > 1)] = math.inf
-    
-    assert not any(np.isnan(capital_process))
+def side_theta(side, theta):
+    """
+    The positive capital process weight for a `side` of "both", "lower" or
+    "upper": `theta`, or 1 or 0 so that only the process rejecting means
+    below, or above, the truth is kept, at the full `alpha`. Raises
+    `ValueError` for any other side.
+    """
+    if side == "both":
+        return theta
+    if side == "lower":
+        return 1
+    if side == "upper":
+        return 0
+    raise ValueError('side must be "both", "lower" or "upper"')
 
-    assert all(capital_process >= 0)
 
-    return capital_process
+def native_strategy(lambdas_fn, alpha=0.05):
+    """
+    The native `BettingStrategy` for a bets function given as a
+    `BettingStrategy`, a `BettingStrategyKind` or its name, or None for
+    `lambda_predmix_eb` with `alpha`. Returns None for Python callables.
+    """
+    if alpha is None:
+        alpha = 0.05
+    if lambdas_fn is None:
+        return BettingStrategy("predmix_eb", alpha=alpha)
+    if isinstance(lambdas_fn, (str, BettingStrategyKind)):
+        return BettingStrategy(lambdas_fn, alpha=alpha)
+    if isinstance(lambdas_fn, BettingStrategy):
+        return lambdas_fn
+    return None
+
+
+def native_strategies(lambdas_fns_positive, lambdas_fns_negative, alpha=0.05):
+    """
+    Lists of native strategies for lists of bets functions, as a tuple
+    `(strategies_positive, strategies_negative)`, or None if any of them
+    is a Python callable.
+    """
+    strategies_positive = [native_strategy(fn, alpha) for fn in lambdas_fns_positive]
+    strategies_negative = [native_strategy(fn, alpha) for fn in lambdas_fns_negative]
+    if None in strategies_positive + strategies_negative:
+        return None
+    return strategies_positive, strategies_negative
+
+
+def bets(lambdas_fn, x, m, alpha=0.05, N=None, negative=False):
+    """
+    Bets on `x` against `m` from a bets function as taken by `betting_mart`,
+    for the negative capital process if `negative` is True.
+    """
+    strategy = native_strategy(lambdas_fn, alpha)
+    if strategy is None:
+        return np.broadcast_to(np.asarray(lambdas_fn(x, m), dtype=float), x.shape)
+    return betting_strategy_bets(
+        x, m, strategy, negative=negative, N=0 if N is None else N
+    )
 
 
 def betting_cs(
@@ -170,6 +250,14 @@ def betting_cs(
     theta=1 / 2,
     trunc_scale=1 / 2,
     m_trunc=True,
+    resolution=None,
+    times=None,
+    bets_alpha=None,
+    prune_rejected=False,
+    weights=None,
+    max_weight=None,
+    first_rejections=False,
+    side="both",
 ):
     """
     Betting-based confidence sequence
@@ -179,16 +267,21 @@ def betting_cs(
     x, array-like
         The vector of observations between 0 and 1.
 
-    alpha, real
-        Significance level between 0 and 1.
+    alpha, real or 1-D array-like
+        Significance level between 0 and 1. For an array of levels, the
+        capital processes are computed once and every level's endpoints
+        are read from them, and `l` and `u` have one row per level.
 
-    lambdas_fn_postive, bivariate function or None
-        Function of `x` and `m` which generates an array-like
-        of bets with the same length as `x`.
+    lambdas_fns_postive, list of bets functions or a bets function
+        Bets functions as taken by `betting_mart`, averaged with
+        equal weights. If all of them, positive and negative, are
+        native `BettingStrategy` objects, names or None, the whole
+        grid of means is evaluated natively, with statistics shared
+        across means; Python callables are evaluated once per mean.
 
-    lambdas_fn_negative=None, bivariate function or None
+    lambdas_fns_negative=None, list of bets functions or a bets function
         Same as above but for the negative capital process.
-        This will be set to lambdas_fn_positive if
+        This will be set to lambdas_fns_positive if
         left as None.
 
     N, positive integer or None
@@ -225,6 +318,54 @@ def betting_cs(
         depending on the capital process. If False, then truncation
         will be given by trunc_scale.
 
+    resolution, positive real or None
+        Resolution of an adaptive grid refined around the endpoints, as
+        taken by `cs_from_martingale`, starting from `breaks`.
+
+    times, array-like of positive integers or None
+        Times at which to refine an adaptive grid, as taken by
+        `cs_from_martingale`.
+
+    bets_alpha, real or None
+        Level at which bets tuned to a level, such as the default
+        `lambda_predmix_eb` or strategies given by name, are computed when
+        `alpha` is an array. Bets are shared by all levels, so this is
+        required for such bets if `alpha` holds several distinct levels.
+
+    prune_rejected, boolean
+        Should a mean, once rejected, stay out of the confidence sequence?
+        Rejected means are then dropped from the grid, so long streams cost
+        time proportional to the width of the CS rather than to `breaks`.
+        The result is intersected over time and lies within the running
+        intersection. Requires native strategies and no adaptive grid.
+
+    weights, array-like or None
+        Importance weights of the observations for off-policy estimation,
+        such as target over logging propensities, between 0 and
+        `max_weight`. The mean is then that of `x` under the target policy,
+        from the weighted outcomes `weights * x`. Requires sampling with
+        replacement.
+
+    max_weight, real or None
+        Bound on `weights`, fixed before the data are seen, by which bets
+        are truncated so that capital stays nonnegative on the weighted
+        outcomes. Required with `weights`.
+        With native strategies, the weighted CS runs at native speed on
+        the same grid and pruning kernels.
+
+    first_rejections, boolean
+        Should the CS be returned as a `FirstRejectionCS`, the time at which
+        each grid mean is first rejected, rather than as `l` and `u`? It is
+        the CS of `prune_rejected` in O(breaks) memory, from which bounds
+        are read at any time. With native strategies, the times are found
+        in one native pass. Requires a single alpha and sampling with
+        replacement.
+
+    side, "both", "lower" or "upper"
+        "lower" or "upper" keeps only the capital process that bounds the
+        mean from that side, at the full `alpha`, in place of `theta`; the
+        other bound is then trivial.
+
 
     Returns
     -------
@@ -234,6 +375,8 @@ def betting_cs(
     u, array-like
         Upper confidence sequence for the mean
     """
+    x, max_weight = importance_weighted(x, weights, max_weight, N)
+    theta = side_theta(side, theta)
     if lambdas_fns_negative is None:
         lambdas_fns_negative = lambdas_fns_positive
 
@@ -244,6 +387,157 @@ def betting_cs(
 
     assert len(lambdas_fns_positive) == len(lambdas_fns_negative)
 
+    adaptive = resolution is not None and resolution < 1 / breaks
+    if prune_rejected and adaptive:
+        raise ValueError("prune_rejected does not support adaptive grids")
+    if first_rejections and (adaptive or N is not None or np.ndim(alpha) > 0):
+        raise ValueError(
+            "first_rejections requires a single alpha, sampling with "
+            "replacement and no adaptive grid"
+        )
+
+    if np.ndim(alpha) > 0:
+        alphas = np.asarray(alpha, dtype=float)
+        assert alphas.ndim == 1
+        lambdas_fns = list(lambdas_fns_positive) + list(lambdas_fns_negative)
+        tuned = any(
+            fn is None or isinstance(fn, (str, BettingStrategyKind))
+            for fn in lambdas_fns
+        )
+        if bets_alpha is None:
+            if tuned and len(np.unique(alphas)) > 1:
+                raise ValueError(
+                    "bets depend on alpha; pass bets_alpha to share them "
+                    "across levels"
+                )
+            bets_alpha = alphas[0] if len(alphas) > 0 else 0.05
+        # Bets tuned to a level are fixed at bets_alpha, once for all levels.
+        fixed = lambda fns: [
+            fn if native_strategy(fn) is None else native_strategy(fn, bets_alpha)
+            for fn in fns
+        ]
+        lambdas_fns_positive = fixed(lambdas_fns_positive)
+        lambdas_fns_negative = fixed(lambdas_fns_negative)
+        kwargs = dict(
+            N=N,
+            breaks=breaks,
+            running_intersection=running_intersection,
+            parallel=parallel,
+            convex_comb=convex_comb,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=m_trunc,
+            resolution=resolution,
+            times=times,
+            prune_rejected=prune_rejected,
+            max_weight=max_weight,
+        )
+        strategies = native_strategies(lambdas_fns_positive, lambdas_fns_negative)
+        if strategies is None or adaptive or prune_rejected:
+            # Python callables, adaptive grids and pruning, whose working set
+            # depends on the level, take one pass per level.
+            cs = [
+                betting_cs(
+                    x, lambdas_fns_positive, lambdas_fns_negative, alpha=a, **kwargs
+                )
+                for a in alphas
+            ]
+            shape = (len(alphas), len(x))
+            return (
+                np.reshape([l for l, _ in cs], shape),
+                np.reshape([u for _, u in cs], shape),
+            )
+        strategies_positive, strategies_negative = strategies
+        x = np.asarray(x, dtype=float)
+        K = len(strategies_positive)
+        assert 0 < trunc_scale <= 1
+        return diversified_betting_grid_cs_thresholds(
+            x,
+            breaks,
+            strategies_positive,
+            strategies_negative,
+            [1 / K] * K,
+            1 / alphas,
+            N=0 if N is None else N,
+            convex_comb=convex_comb,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=m_trunc,
+            log_space=True,
+            running_intersection=running_intersection,
+            num_threads=0 if parallel else 1,
+            max_weight=max_weight,
+        )
+
+    strategies = native_strategies(lambdas_fns_positive, lambdas_fns_negative, alpha)
+    if prune_rejected and strategies is None:
+        raise ValueError("prune_rejected requires native strategies")
+    if strategies is not None and first_rejections:
+        strategies_positive, strategies_negative = strategies
+        x = np.asarray(x, dtype=float)
+        K = len(strategies_positive)
+        assert 0 < trunc_scale <= 1
+        possible_m = np.arange(0, 1 + 1 / breaks, step=1 / breaks)
+        times = diversified_betting_first_rejections(
+            x,
+            possible_m,
+            strategies_positive,
+            strategies_negative,
+            [1 / K] * K,
+            1 / alpha,
+            convex_comb=convex_comb,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=m_trunc,
+            log_space=True,
+            num_threads=0 if parallel else 1,
+            max_weight=max_weight,
+        )
+        return FirstRejectionCS(possible_m, breaks, times)
+    if strategies is not None and prune_rejected:
+        strategies_positive, strategies_negative = strategies
+        x = np.asarray(x, dtype=float)
+        K = len(strategies_positive)
+        assert 0 < trunc_scale <= 1
+        return diversified_betting_pruned_grid_cs(
+            x,
+            breaks,
+            strategies_positive,
+            strategies_negative,
+            [1 / K] * K,
+            1 / alpha,
+            N=0 if N is None else N,
+            convex_comb=convex_comb,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=m_trunc,
+            log_space=True,
+            num_threads=0 if parallel else 1,
+            max_weight=max_weight,
+        )
+    if strategies is not None and not adaptive:
+        strategies_positive, strategies_negative = strategies
+        x = np.asarray(x, dtype=float)
+        K = len(strategies_positive)
+        assert 0 < trunc_scale <= 1
+        return diversified_betting_grid_cs(
+            x,
+            breaks,
+            strategies_positive,
+            strategies_negative,
+            [1 / K] * K,
+            1 / alpha,
+            N=0 if N is None else N,
+            convex_comb=convex_comb,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=m_trunc,
+            log_space=True,
+            running_intersection=running_intersection,
+            num_threads=0 if parallel else 1,
+            max_weight=max_weight,
+        )
+
     mart_fn = lambda x, m: diversified_betting_mart(
         x,
         m,
@@ -255,20 +549,24 @@ def betting_cs(
         convex_comb=convex_comb,
         trunc_scale=trunc_scale,
         m_trunc=m_trunc,
+        log_space=True,
+        max_weight=max_weight,
     )
 
-    l, u = cs_from_martingale(
+    return cs_from_martingale(
         x,
         mart_fn,
         breaks=breaks,
         alpha=alpha,
         N=N,
-        parallel=parallel,
         running_intersection=running_intersection,
+        parallel=parallel,
+        log_space=True,
+        resolution=resolution,
+        times=times,
+        first_rejections=first_rejections,
     )
 
-    return l, u
-
 
 def diversified_betting_mart(
     x,
@@ -282,9 +580,14 @@ def diversified_betting_mart(
     theta=1 / 2,
     trunc_scale=1 / 2,
     m_trunc=True,
+    log_space=False,
+    max_weight=1,
 ):
-    mart_positive = np.zeros(len(x))
-    mart_negative = np.zeros(len(x))
+    # With log_space, the log martingale is returned, and strategies and
+    # capital processes are mixed by log-sum-exp. With max_weight, x holds
+    # importance-weighted outcomes in [0, max_weight], as in betting_mart.
+    mart_positive = np.repeat(-math.inf if log_space else 0.0, len(x))
+    mart_negative = np.repeat(-math.inf if log_space else 0.0, len(x))
 
     # Number of betting strategies to use
     K = len(lambdas_fns_positive)
@@ -297,55 +600,73 @@ def diversified_betting_mart(
 
     assert len(lambdas_fns_positive) == len(lambdas_fns_negative)
 
-    for k in range(K):
-        lambdas_fn_positive = lambdas_fns_positive[k]
-        lambdas_fn_negative = lambdas_fns_negative[k]
-
-        summand_positive = (
-            (
-                lambdas_weights[k]
-                * betting_mart(
-                    x,
-                    m,
-                    alpha=alpha,
-                    lambdas_fn_positive=lambdas_fn_positive,
-                    lambdas_fn_negative=lambdas_fn_negative,
-                    N=N,
-                    theta=1,
-                    trunc_scale=trunc_scale,
-                    m_trunc=m_trunc,
-                )
-            )
-            if lambdas_weights[k] != 0
-            else 0
+    x = np.asarray(x, dtype=float)
+    assert 0 < trunc_scale <= 1
+    strategies = native_strategies(lambdas_fns_positive, lambdas_fns_negative, alpha)
+    if strategies is not None:
+        strategies_positive, strategies_negative = strategies
+        return diversified_betting_capital_process(
+            x,
+            m,
+            strategies_positive,
+            strategies_negative,
+            list(lambdas_weights),
+            N=0 if N is None else N,
+            convex_comb=convex_comb,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=m_trunc,
+            log_space=log_space,
+            max_weight=max_weight,
         )
 
-        mart_positive = mart_positive + summand_positive
-
-        summand_negative = (
-            (
-                lambdas_weights[k]
-                * betting_mart(
-                    x,
-                    m,
-                    alpha=alpha,
-                    lambdas_fn_positive=lambdas_fn_positive,
-                    lambdas_fn_negative=lambdas_fn_negative,
-                    N=N,
-                    theta=0,
-                    trunc_scale=trunc_scale,
-                    m_trunc=m_trunc,
-                )
+    for k in range(K):
+        if lambdas_weights[k] == 0:
+            continue
+        # Bets are evaluated once and shared by both capital processes
+        lambdas_positive, lambdas_negative = [
+            bets(lambdas_fn, x, m, alpha=alpha, N=N, negative=negative)
+            for lambdas_fn, negative in [
+                (lambdas_fns_positive[k], False),
+                (lambdas_fns_negative[k], True),
+            ]
+        ]
+
+        summand_positive, summand_negative = [
+            betting_capital_process(
+                x,
+                m,
+                lambdas_positive,
+                lambdas_negative,
+                N=0 if N is None else N,
+                theta=theta_k,
+                trunc_scale=trunc_scale,
+                m_trunc=m_trunc,
+                log_space=log_space,
+                max_weight=max_weight,
             )
-            if lambdas_weights[k] != 0
-            else 0
-        )
-        mart_negative = mart_negative + summand_negative
+            for theta_k in [1, 0]
+        ]
+        if log_space:
+            log_weight = math.log(lambdas_weights[k])
+            mart_positive = np.logaddexp(mart_positive, log_weight + summand_positive)
+            mart_negative = np.logaddexp(mart_negative, log_weight + summand_negative)
+        else:
+            mart_positive = mart_positive + lambdas_weights[k] * summand_positive
+            mart_negative = mart_negative + lambdas_weights[k] * summand_negative
 
     if theta == 1:
         mart = mart_positive
     elif theta == 0:
         mart = mart_negative
+    elif log_space:
+        log_positive = math.log(theta) + mart_positive
+        log_negative = math.log(1 - theta) + mart_negative
+        mart = (
+            np.logaddexp(log_positive, log_negative)
+            if convex_comb
+            else np.maximum(log_positive, log_negative)
+        )
     else:
         mart = (
             theta * mart_positive + (1 - theta) * mart_negative
@@ -366,6 +687,10 @@ def cs_from_martingale(
     N=None,
     running_intersection=False,
     parallel=False,
+    log_space=False,
+    resolution=None,
+    times=None,
+    first_rejections=False,
 ):
     """
     Given a test supermartingale, produce a confidence sequence for
@@ -394,7 +719,29 @@ def cs_from_martingale(
         Should the running intersection be taken?
 
     parallel, boolean
-        Should computation be parallelized?
+        Should grid means be evaluated across the threads of
+        `thread_pool()`?
+
+    log_space, boolean
+        Does `mart_fn` return the log of the martingale? If so, it is
+        compared with log(1/alpha), which long streams cannot overflow.
+
+    resolution, positive real or None
+        If smaller than 1 / `breaks`, the grid of `breaks` is only a
+        starting point: grid cells bracketing the acceptance boundary
+        are refined tenfold, recursively, until they are at most
+        `resolution` wide. See `adaptive_cs_from_martingale`.
+
+    times, array-like of positive integers or None
+        Times at which the boundary is refined with `resolution`, or
+        None for all times. Endpoints at other times are as precise as
+        the cells evaluated for these times happen to make them.
+
+    first_rejections, boolean
+        Should a `FirstRejectionCS` be returned instead of `l` and `u`?
+        Only the first time each grid mean is rejected is kept, in
+        O(breaks) memory, and a rejected mean stays out of the CS. Requires
+        sampling with replacement and no adaptive grid.
 
     Returns
     -------
@@ -403,47 +750,211 @@ def cs_from_martingale(
     u, array-like
         Upper confidence sequence for the parameter
     """
+    threshold = -math.log(alpha) if log_space else 1 / alpha
+    if first_rejections:
+        if N is not None or (resolution is not None and resolution < 1 / breaks):
+            raise ValueError(
+                "first_rejections requires sampling with replacement and no "
+                "adaptive grid"
+            )
+        possible_m = np.arange(0, 1 + 1 / breaks, step=1 / breaks)
+
+        def rejection_time(m):
+            rejected = np.flatnonzero(np.asarray(mart_fn(x, m)) > threshold)
+            return rejected[0] + 1 if len(rejected) else 0
+
+        map_fn = thread_map if parallel else map
+        times = np.fromiter(map_fn(rejection_time, possible_m), dtype=np.int64)
+        return FirstRejectionCS(possible_m, breaks, times)
+
+    if resolution is not None and resolution < 1 / breaks:
+        l, u = adaptive_cs_from_martingale(
+            x, mart_fn, threshold, breaks, resolution, times, parallel
+        )
+        return intersect_cs(x, l, u, N, running_intersection)
+
     possible_m = np.arange(0, 1 + 1 / breaks, step=1 / breaks)
-    confseq_mtx = np.zeros((len(possible_m), len(x)))
+    # Track only the first and last accepted m at each time, one m at a time
+    first = np.full(len(x), -1)
+    last = np.full(len(x), -1)
 
+    def update(i, accepted):
+        first[np.logical_and(first < 0, accepted)] = i
+        last[accepted] = i
+
+    accepted_fn = lambda m: mart_fn(x, m) <= threshold
     if parallel:
-        n_cores = multiprocess.cpu_count()
-        info("Using " + str(n_cores) + " cores")
-        with multiprocess.Pool(n_cores) as p:
-            result = p.map(lambda m: mart_fn(x, m), possible_m)
-            confseq_mtx = np.vstack(result) <= 1 / alpha
+        for i, accepted in enumerate(thread_map(accepted_fn, possible_m)):
+            update(i, accepted)
     else:
-        for i in np.arange(0, len(possible_m)):
-            m = possible_m[i]
-            confseq_mtx[i, :] = mart_fn(x, m) <= 1 / alpha
-
-    l = np.zeros(len(x))
-    u = np.ones(len(x))
-
-    for j in np.arange(0, len(x)):
-        where_in_cs = np.where(confseq_mtx[:, j])
-        if len(where_in_cs[0]) == 0:
-            l[j] = 0
-            u[j] = 1
-        else:
-            l[j] = possible_m[where_in_cs[0][0]]
-            u[j] = possible_m[where_in_cs[0][-1]]
-    l = np.maximum(0, l - 1 / breaks)
-    u = np.minimum(1, u + 1 / breaks)
+        for i, m in enumerate(possible_m):
+            update(i, accepted_fn(m))
 
-    if N is not None:
-        logical_l, logical_u = logical_cs(x, N)
+    return cs_from_accepted_range(
+        x, possible_m, first, last, breaks, N, running_intersection
+    )
 
-        l = np.maximum(l, logical_l)
-        u = np.minimum(u, logical_u)
 
-    if running_intersection:
-        l = np.maximum.accumulate(l)
-        u = np.minimum.accumulate(u)
+def adaptive_cs_from_martingale(
+    x, mart_fn, threshold, breaks, resolution, times=None, parallel=False
+):
+    """
+    Grid-method confidence sequence endpoints, before intersection, from a
+    grid of `breaks` refined coarse to fine around the acceptance boundary.
+
+    At each of `times` (all times if None), the cells on either side of
+    the smallest and largest accepted means, or of the mean with the least
+    capital where none is accepted, are split into ten until they are at
+    most `resolution` wide. Only the smallest and largest accepted means
+    and the least capital are kept per time, so memory is O(len(x)) beyond
+    the evaluated means. Endpoints are the outer edges of the boundary
+    cells: the nearest evaluated, hence rejected, means beyond the
+    accepted ones, or 0 and 1 where none are accepted, just as the grid
+    method widens its accepted range by a grid step.
+    """
+    x = np.asarray(x)
+    n = len(x)
+    times = np.arange(n) if times is None else np.asarray(times) - 1
+    min_accepted = np.full(n, math.inf)
+    max_accepted = np.full(n, -math.inf)
+    min_capital = np.full(n, math.inf)
+    argmin_capital = np.zeros(n)
+    evaluated = set()
+
+    def evaluate(means):
+        means = [m for m in means if m not in evaluated]
+        evaluated.update(means)
+        if parallel:
+            marts = thread_map(lambda m: mart_fn(x, m), means)
+        else:
+            marts = (mart_fn(x, m) for m in means)
+        for m, mart in zip(means, marts):
+            mart = np.asarray(mart)
+            accepted = mart <= threshold
+            min_accepted[accepted] = np.minimum(min_accepted[accepted], m)
+            max_accepted[accepted] = np.maximum(max_accepted[accepted], m)
+            smaller = mart < min_capital
+            min_capital[smaller] = mart[smaller]
+            argmin_capital[smaller] = m
+
+    evaluate(np.arange(0, 1 + 1 / breaks, step=1 / breaks))
+    while True:
+        means = np.array(sorted(evaluated))
+        none_accepted = np.isinf(min_accepted[times])
+        lowest = np.where(none_accepted, argmin_capital[times], min_accepted[times])
+        highest = np.where(none_accepted, argmin_capital[times], max_accepted[times])
+        # Cell i lies between means[i] and means[i + 1]: refine the cells
+        # below the lowest and above the highest accepted means.
+        cells = np.unique(
+            np.concatenate(
+                [
+                    np.searchsorted(means, lowest) - 1,
+                    np.searchsorted(means, highest),
+                ]
+            )
+        )
+        cells = cells[(cells >= 0) & (cells < len(means) - 1)]
+        cells = cells[means[cells + 1] - means[cells] > resolution]
+        if len(cells) == 0:
+            break
+        evaluate(
+            np.concatenate(
+                [np.linspace(means[i], means[i + 1], 11)[1:-1] for i in cells]
+            )
+        )
 
+    means = np.array(sorted(evaluated))
+    none_accepted = np.isinf(min_accepted)
+    below = np.searchsorted(means, min_accepted) - 1
+    above = np.searchsorted(means, max_accepted) + 1
+    l = np.where(none_accepted | (below < 0), 0, means[np.maximum(below, 0)])
+    u = np.where(
+        none_accepted | (above >= len(means)),
+        1,
+        means[np.minimum(above, len(means) - 1)],
+    )
     return l, u
 
 
+class FirstRejectionCS:
+    """
+    Grid confidence sequence held as the number of observations after which
+    each grid mean is first rejected, or 0 if it never is. A rejected mean
+    stays out, so these O(breaks) times determine the CS at every time,
+    however long the stream, and bounds are reconstructed only when asked
+    for. The bounds are those of `betting_cs` with `prune_rejected`.
+
+    Parameters
+    ----------
+    possible_m, array-like
+        The grid of means, `np.arange(0, 1 + 1 / breaks, step=1 / breaks)`
+
+    breaks, positive integer
+        Number of breaks in the grid
+
+    times, array-like of nonnegative integers
+        First rejection time of each grid mean, or 0 if it is never rejected
+    """
+
+    def __init__(self, possible_m, breaks, times):
+        self.possible_m = np.asarray(possible_m, dtype=float)
+        self.breaks = breaks
+        self.times = np.asarray(times, dtype=np.int64)
+        # A mean is in the CS after t observations while t is below `out`.
+        # The first (last) mean in is the first index at which the running
+        # maximum of `out` from the start (end) exceeds t.
+        out = np.where(self.times == 0, np.inf, self.times)
+        self._out_from_start = np.maximum.accumulate(out)
+        self._out_from_end = np.maximum.accumulate(out[::-1])
+        self._all_out = out.max()
+
+    def bounds(self, t):
+        """
+        Lower and upper bounds after `t` observations, for an integer or an
+        array of integers, each found in O(log breaks) time
+        """
+        # Once every mean is out, the CS keeps its last interval.
+        s = np.minimum(t, self._all_out - 1)
+        first = np.searchsorted(self._out_from_start, s, side="right")
+        last = len(self.possible_m) - 1
+        last -= np.searchsorted(self._out_from_end, s, side="right")
+        l = np.maximum(0, self.possible_m[first] - 1 / self.breaks)
+        u = np.minimum(1, self.possible_m[last] + 1 / self.breaks)
+        return l, u
+
+
+def cs_from_accepted_range(
+    x, possible_m, first, last, breaks, N=None, running_intersection=False
+):
+    """
+    Confidence sequence from the first and last indices into the grid
+    `possible_m` of the means accepted at each time, or -1 where none is,
+    widened by one grid step and intersected as in `cs_from_martingale`.
+    """
+    return capital_processes.accepted_range_cs(
+        np.asarray(x, dtype=float),
+        breaks,
+        first,
+        last,
+        N=0 if N is None else N,
+        running_intersection=running_intersection,
+    )
+
+
+def intersect_cs(x, l, u, N=None, running_intersection=False):
+    """
+    Intersect a confidence sequence with the logical CS when sampling
+    WoR, and with its own past if `running_intersection` is True.
+    """
+    return capital_processes.intersect_cs(
+        np.asarray(x, dtype=float),
+        l,
+        u,
+        N=0 if N is None else N,
+        running_intersection=running_intersection,
+    )
+
+
 def hedged_cs(
     x,
     alpha=0.05,
@@ -456,6 +967,8 @@ def hedged_cs(
     prior_mean=1 / 2,
     prior_variance=1 / 4,
     fake_obs=1,
+    tolerance=None,
+    side="both",
 ):
     """
     Hedged capital confidence sequence.
@@ -490,6 +1003,15 @@ def hedged_cs(
         The factor by which to multiply the truncation.
         Leaving this as 1 will perform no additional truncation.
 
+    tolerance, positive real or None
+        If given, find each endpoint to within `tolerance` by
+        bisection on m, carried forward from the previous time,
+        instead of evaluating a grid of `breaks + 1` values of m.
+
+    side, "both", "lower" or "upper"
+        "lower" or "upper" keeps only the capital process bounding the mean
+        from that side, so the whole of `alpha` is spent on that bound.
+
     Returns
     -------
     l, array-like
@@ -498,27 +1020,53 @@ def hedged_cs(
     u, array-like
         Upper confidence sequence for the mean
     """
-    return betting_cs(
+    theta = side_theta(side, theta)
+    # Equivalent to betting_cs with the positive bets below and
+    # lambda_predmix_eb as the negative bets function, which caps its bets at
+    # m through its truncation argument. Neither depends on m otherwise, so
+    # bets are computed once and every m is evaluated natively.
+    x = np.asarray(x, dtype=float)
+    lambdas_positive = lambda_predmix_eb(
         x,
-        lambdas_fns_positive=[
-            lambda x, m: lambda_predmix_eb(
-                x,
-                alpha=alpha,
-                prior_mean=prior_mean,
-                prior_variance=prior_variance,
-                fake_obs=fake_obs,
-            )
-        ],
-        lambdas_fns_negative=[lambda_predmix_eb],
         alpha=alpha,
-        N=N,
-        breaks=breaks,
-        running_intersection=running_intersection,
-        parallel=parallel,
+        prior_mean=prior_mean,
+        prior_variance=prior_variance,
+        fake_obs=fake_obs,
+    )
+    lambdas_negative = lambda_predmix_eb(x)
+    assert 0 < trunc_scale <= 1
+    if tolerance is not None:
+        l, u = betting_cs_bisection(
+            x,
+            lambdas_positive,
+            lambdas_negative,
+            1 / alpha,
+            tolerance,
+            N=0 if N is None else N,
+            convex_comb=False,
+            theta=theta,
+            trunc_scale=trunc_scale,
+            m_trunc=True,
+            cap_negative_bets_at_m=True,
+            log_space=True,
+        )
+        return intersect_cs(x, l, u, N, running_intersection)
+
+    return betting_grid_cs(
+        x,
+        breaks,
+        lambdas_positive,
+        lambdas_negative,
+        1 / alpha,
+        N=0 if N is None else N,
         convex_comb=False,
         theta=theta,
         trunc_scale=trunc_scale,
         m_trunc=True,
+        cap_negative_bets_at_m=True,
+        log_space=True,
+        running_intersection=running_intersection,
+        num_threads=0 if parallel else 1,
     )
 
 
@@ -575,26 +1123,17 @@ def dKelly_cs(
     u, array-like
         Upper confidence sequence for the mean
     """
-    if N is not None:
-        lambdas_fns_positive = [
-            lambda x, m, i=i: (i + 1) / (mu_t(x, m, N) * (D + 1)) for i in range(D)
-        ]
-        lambdas_fns_negative = [
-            lambda x, m, i=i: (i + 1) / ((1 - mu_t(x, m, N)) * (D + 1))
-            for i in range(D)
-        ]
-    else:
-        lambdas_fns_positive = [
-            lambda x, m, i=i: (i + 1) / (m * (D + 1)) for i in range(D)
-        ]
-        lambdas_fns_negative = [
-            lambda x, m, i=i: (i + 1) / ((1 - m) * (D + 1)) for i in range(D)
-        ]
+    # Bets of (i + 1) / (D + 1) times 1 / mu_t and 1 / (1 - mu_t), where mu_t
+    # is the conditional mean when sampling WoR
+    lambdas_fns = [
+        BettingStrategy("fixed_fraction", fraction=(i + 1) / (D + 1))
+        for i in range(D)
+    ]
 
     return betting_cs(
         x,
-        lambdas_fns_positive=lambdas_fns_positive,
-        lambdas_fns_negative=lambdas_fns_negative,
+        lambdas_fns_positive=lambdas_fns,
+        lambdas_fns_negative=lambdas_fns,
         alpha=alpha,
         N=N,
         breaks=breaks,
@@ -674,9 +1213,12 @@ def betting_ci(
     alpha, real
         Significance level between 0 and 1.
 
-    lambdas_fn_postive, bivariate function or None
+    lambdas_fn_postive, bivariate function, BettingStrategy or None
         Function of `x` and `m` which generates an array-like
-        of bets with the same length as `x`.
+        of bets with the same length as `x`, or a list of them, as
+        for `betting_cs`. If all are native strategies, intervals
+        are computed natively; `BettingStrategy(fixed_horizon=True)`
+        optimizes predmix bets for the sample size of each interval.
 
     lambdas_fn_negative=None, bivariate function or None
         Same as above but for the negative capital process.
@@ -727,6 +1269,24 @@ def betting_ci(
     x = np.array(x)
     n = len(x)
 
+    native = native_betting_ci_seq(
+        x,
+        [n],
+        alpha=alpha,
+        lambdas_fns_positive=lambdas_fns_positive,
+        lambdas_fns_negative=lambdas_fns_negative,
+        N=N,
+        breaks=breaks,
+        running_intersection=running_intersection,
+        parallel=parallel,
+        convex_comb=convex_comb,
+        theta=theta,
+        trunc_scale=trunc_scale,
+        m_trunc=m_trunc,
+    )
+    if native is not None:
+        return native[0][0], native[1][0]
+
     l, u = betting_cs(
         x,
         alpha=alpha,
@@ -745,6 +1305,56 @@ def betting_ci(
     return l[-1], u[-1]
 
 
+def native_betting_ci_seq(
+    x,
+    times,
+    alpha,
+    lambdas_fns_positive,
+    lambdas_fns_negative,
+    N,
+    breaks,
+    running_intersection,
+    parallel,
+    convex_comb,
+    theta,
+    trunc_scale,
+    m_trunc,
+):
+    """
+    `betting_ci` on `x[0:time]` for each of `times`, computed natively in
+    one call, or None if any bets function is a Python callable. Arguments
+    are as for `betting_ci_seq`.
+    """
+    if lambdas_fns_negative is None:
+        lambdas_fns_negative = lambdas_fns_positive
+    if np.shape(lambdas_fns_positive) == ():
+        lambdas_fns_positive = [lambdas_fns_positive]
+    if np.shape(lambdas_fns_negative) == ():
+        lambdas_fns_negative = [lambdas_fns_negative]
+    assert len(lambdas_fns_positive) == len(lambdas_fns_negative)
+
+    strategies = native_strategies(lambdas_fns_positive, lambdas_fns_negative, alpha)
+    if strategies is None:
+        return None
+    K = len(lambdas_fns_positive)
+    return diversified_betting_ci_sequence(
+        np.asarray(x, dtype=float),
+        [int(time) for time in times],
+        breaks,
+        strategies[0],
+        strategies[1],
+        [1 / K] * K,
+        1 / alpha,
+        N=0 if N is None else N,
+        convex_comb=convex_comb,
+        theta=theta,
+        trunc_scale=trunc_scale,
+        m_trunc=m_trunc,
+        running_intersection=running_intersection,
+        num_threads=0 if parallel else 1,
+    )
+
+
 def get_ci_seq(x, ci_fn, times, parallel=False):
     """
     Get sequence of confidence intervals
@@ -763,7 +1373,7 @@ def get_ci_seq(x, ci_fn, times, parallel=False):
         Times at which to compute the confidence interval.
 
     parallel, boolean
-        Should this function be parallelized?
+        Should times be evaluated across the threads of `thread_pool()`?
 
     Returns
     -------
@@ -779,11 +1389,9 @@ def get_ci_seq(x, ci_fn, times, parallel=False):
     u = np.repeat(1.0, len(times))
 
     if parallel:
-        n_cores = multiprocess.cpu_count()
-        print("Using " + str(n_cores) + " cores")
-        with multiprocess.Pool(n_cores) as p:
-            result = np.array(p.map(lambda time: ci_fn(x[0:time]), times))
-        l, u = result[:, 0], result[:, 1]
+        intervals = thread_map(lambda time: ci_fn(x[0:time]), times)
+        for i, interval in enumerate(intervals):
+            l[i], u[i] = interval
     else:
         for i in np.arange(0, len(times)):
             time = times[i]
@@ -819,9 +1427,12 @@ def betting_ci_seq(
     alpha, (0, 1)-bounded real
         Significance level between 0 and 1.
 
-    lambdas_fn_postive, bivariate function or None
+    lambdas_fn_postive, bivariate function, BettingStrategy or None
         Function of `x` and `m` which generates an array-like
-        of bets with the same length as `x`.
+        of bets with the same length as `x`, or a list of them, as
+        for `betting_cs`. If all are native strategies, intervals
+        are computed natively; `BettingStrategy(fixed_horizon=True)`
+        optimizes predmix bets for the sample size of each interval.
 
     lambdas_fn_negative=None, bivariate function or None
         Same as above but for the negative capital process.
@@ -871,6 +1482,24 @@ def betting_ci_seq(
         Upper confidence intervals
     """
 
+    native = native_betting_ci_seq(
+        x,
+        times,
+        alpha=alpha,
+        lambdas_fns_positive=lambdas_fns_positive,
+        lambdas_fns_negative=lambdas_fns_negative,
+        N=N,
+        breaks=breaks,
+        running_intersection=running_intersection,
+        parallel=parallel,
+        convex_comb=convex_comb,
+        theta=theta,
+        trunc_scale=trunc_scale,
+        m_trunc=m_trunc,
+    )
+    if native is not None:
+        return native
+
     def ci_fn(x):
         return betting_ci(
             x,
@@ -1,6 +1,7 @@
 import math
 import numpy as np
-from scipy.optimize import root
+
+from confseq.capital_processes import kelly_bets
 
 
 def lambda_predmix_eb(
@@ -109,24 +110,14 @@ def lambda_aKelly(
 
 
 def lambda_Kelly(x, m):
-    lambdas_init = lambda_aKelly(x, m, trunc_scale=1)
-    lambdas = np.repeat(0.0, len(x))
-    for i in np.arange(1, len(x)):
-
-        def EL_fn(l):
-            cand_val = np.sum((x[0:i] - m) / (1 + l * (x[0:i] - m)))
-            return cand_val
-
-        if np.max(x[0:i]) <= m:
-            lambdas[i] = -1 / (1 - m)
-        elif np.min(x[0:i]) >= m:
-            lambdas[i] = 1 / m
-        else:
-            lambdas[i] = root(EL_fn, x0=lambdas_init[i])["x"]
-    lambdas[np.isnan(lambdas)] = 0
-    lambdas = lambdas
-
-    return lambdas
+    """
+    Kelly-optimal lambda values or "bets": at each time, the bet maximizing
+    the log wealth the earlier observations would have earned against `m`.
+    Solved natively by Newton steps warm-started from the previous bet, with
+    the past observations counted by value when they take few distinct
+    values, rather than by a `scipy.optimize.root` call per time.
+    """
+    return kelly_bets(np.asarray(x, dtype=float), m)
 
 
 def lambda_LBOW(x, m):
@@ -1,10 +1,657 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
+#include "parallel_vectorize.h"
 #include "uniform_boundaries.h"
 
 using namespace pybind11::literals;
 
+using DoubleArray = pybind11::array_t<
+    double, pybind11::array::c_style | pybind11::array::forcecast>;
+
+DoubleArray gamma_exponential_mixture_bound_sequence(
+    const DoubleArray v, const double alpha, const double v_opt,
+    const double c, const double alpha_opt) {
+  confseq::GammaExponentialMixture mixture(v_opt, alpha_opt, c);
+  DoubleArray out(v.size());
+  mixture.bound_sequence(v.data(), v.size(), log(1 / alpha),
+                         out.mutable_data());
+  return out;
+}
+
+// Broadcasts s against v and evaluates them with the mixture's batch
+// log_superMG kernel, one block of elements per parallel_for task.
+pybind11::object batch_log_superMG(
+    const confseq::MixtureSupermartingale& mixture, const DoubleArray s,
+    const DoubleArray v) {
+  const pybind11::sequence broadcast =
+      pybind11::module::import("numpy").attr("broadcast_arrays")(s, v);
+  const DoubleArray s_in = pybind11::cast<DoubleArray>(broadcast[0]);
+  const DoubleArray v_in = pybind11::cast<DoubleArray>(broadcast[1]);
+  DoubleArray out(std::vector<pybind11::ssize_t>(
+      s_in.shape(), s_in.shape() + s_in.ndim()));
+  const size_t size = out.size();
+  const size_t block_size = 4096;
+  const double* s_data = s_in.data();
+  const double* v_data = v_in.data();
+  double* out_data = out.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::parallel_for(
+        (size + block_size - 1) / block_size,
+        [&](const size_t block) {
+          const size_t begin = block * block_size;
+          mixture.log_superMG(s_data + begin, v_data + begin,
+                              std::min(block_size, size - begin),
+                              out_data + begin);
+        },
+        0, 1);
+  }
+  if (out.ndim() == 0) {
+    return pybind11::cast(out_data[0]);
+  }
+  return std::move(out);
+}
+
+// Broadcasts v against alpha and evaluates the PolyStitchingBound batch
+// kernels in blocks, as batch_log_superMG does. A single alpha uses
+// bound_sequence(), with log(1 / alpha) hoisted out of the loop.
+pybind11::object batch_poly_stitching_bound(
+    const confseq::PolyStitchingBound& bound, const DoubleArray v,
+    const DoubleArray alpha) {
+  const pybind11::sequence broadcast =
+      pybind11::module::import("numpy").attr("broadcast_arrays")(v, alpha);
+  const DoubleArray v_in = pybind11::cast<DoubleArray>(broadcast[0]);
+  const bool single_alpha = alpha.size() == 1;
+  const DoubleArray alpha_in = single_alpha
+      ? alpha : pybind11::cast<DoubleArray>(broadcast[1]);
+  DoubleArray out(std::vector<pybind11::ssize_t>(
+      v_in.shape(), v_in.shape() + v_in.ndim()));
+  const size_t size = out.size();
+  const size_t block_size = 4096;
+  const double* v_data = v_in.data();
+  const double* alpha_data = alpha_in.data();
+  double* out_data = out.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::parallel_for(
+        (size + block_size - 1) / block_size,
+        [&](const size_t block) {
+          const size_t begin = block * block_size;
+          const size_t n = std::min(block_size, size - begin);
+          if (single_alpha) {
+            bound.bound_sequence(v_data + begin, n, alpha_data[0],
+                                 out_data + begin);
+          } else {
+            bound.bounds(v_data + begin, alpha_data + begin, n,
+                         out_data + begin);
+          }
+        },
+        0, 1);
+  }
+  if (out.ndim() == 0) {
+    return pybind11::cast(out_data[0]);
+  }
+  return std::move(out);
+}
+
+// Broadcasts s against v and evaluates confseq::mixture_p_values. A running
+// minimum is taken along a 1-D stream.
+pybind11::object mixture_p_values(
+    const confseq::MixtureSupermartingale& mixture, const DoubleArray s,
+    const DoubleArray v, const bool running_min) {
+  const pybind11::sequence broadcast =
+      pybind11::module::import("numpy").attr("broadcast_arrays")(s, v);
+  const DoubleArray s_in = pybind11::cast<DoubleArray>(broadcast[0]);
+  const DoubleArray v_in = pybind11::cast<DoubleArray>(broadcast[1]);
+  if (running_min && s_in.ndim() > 1) {
+    throw pybind11::value_error(
+        "running_min requires s and v to broadcast to a 1-D stream");
+  }
+  DoubleArray out(std::vector<pybind11::ssize_t>(
+      s_in.shape(), s_in.shape() + s_in.ndim()));
+  const double* s_data = s_in.data();
+  const double* v_data = v_in.data();
+  double* out_data = out.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::mixture_p_values(mixture, s_data, v_data, out.size(),
+                              running_min, out_data);
+  }
+  if (out.ndim() == 0) {
+    return pybind11::cast(out_data[0]);
+  }
+  return std::move(out);
+}
+
+// mixture.log_superMG over s broadcast against v, with the ufunc-style out
+// and where of ParallelVectorized. The mixture is built once by the caller
+// rather than once per element.
+template <class Mixture>
+pybind11::object mixture_log_superMG(const Mixture& mixture,
+                                     const DoubleArray s, const DoubleArray v,
+                                     const pybind11::object& out,
+                                     const pybind11::object& where) {
+  return confseq::ParallelVectorized<double, double, double>(
+      [mixture](const double s, const double v) {
+        return mixture.log_superMG(s, v);
+      })(s, v, out, where);
+}
+
+// MixtureSupermartingale::bound_multi over a 1-D v and 1-D alpha, returning
+// a len(v) x len(alpha) array. Rows are spread across threads.
+DoubleArray bound_multi(const confseq::MixtureSupermartingale& mixture,
+                        const DoubleArray v, const DoubleArray alpha) {
+  if (v.ndim() > 1 || alpha.ndim() > 1) {
+    throw pybind11::value_error("v and alpha must be 1-D");
+  }
+  const size_t num_v = v.size();
+  const size_t num_alpha = alpha.size();
+  std::vector<double> log_thresholds(num_alpha);
+  for (size_t j = 0; j < num_alpha; j++) {
+    log_thresholds[j] = log(1 / alpha.data()[j]);
+  }
+  DoubleArray out(std::vector<pybind11::ssize_t>{
+      pybind11::ssize_t(num_v), pybind11::ssize_t(num_alpha)});
+  const double* v_data = v.data();
+  double* out_data = out.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::parallel_for(num_v, [&](const size_t i) {
+      mixture.bound_multi(v_data + i, 1, log_thresholds.data(), num_alpha,
+                          out_data + i * num_alpha);
+    }, 0, 16);
+  }
+  return out;
+}
+
+// confseq::tune_mixture over a list of mixtures, returning (best_index,
+// losses, bounds) with bounds a len(mixtures) x len(v) array.
+pybind11::tuple tune_mixture(
+    const std::vector<const confseq::MixtureSupermartingale*>& mixtures,
+    const DoubleArray v, const pybind11::object weights, const double alpha,
+    const int num_threads) {
+  if (v.ndim() > 1) {
+    throw pybind11::value_error("v must be 1-D");
+  }
+  DoubleArray weight_array;
+  if (!weights.is_none()) {
+    weight_array = pybind11::cast<DoubleArray>(weights);
+    if (weight_array.ndim() > 1 || weight_array.size() != v.size()) {
+      throw pybind11::value_error("weights must be 1-D and match v");
+    }
+  }
+  const double* v_data = v.data();
+  const double* weight_data =
+      weights.is_none() ? nullptr : weight_array.data();
+  confseq::MixtureTuningResult result;
+  {
+    pybind11::gil_scoped_release release;
+    result = confseq::tune_mixture(mixtures, v_data, weight_data, v.size(),
+                                   alpha, num_threads);
+  }
+  DoubleArray bounds(std::vector<pybind11::ssize_t>{
+      pybind11::ssize_t(mixtures.size()), pybind11::ssize_t(v.size())});
+  std::copy(result.bounds.begin(), result.bounds.end(),
+            bounds.mutable_data());
+  const pybind11::object best_index = result.best_index < mixtures.size()
+      ? pybind11::object(pybind11::cast(result.best_index))
+      : pybind11::object(pybind11::none());
+  return pybind11::make_tuple(
+      best_index, DoubleArray(result.losses.size(), result.losses.data()),
+      bounds);
+}
+
+// confseq::mixture_first_crossings over streams laid out back to back in s
+// and v, returning (times, p_values) with one entry per stream.
+pybind11::tuple mixture_first_crossings(
+    const confseq::MixtureSupermartingale& mixture, const DoubleArray s,
+    const DoubleArray v,
+    const pybind11::array_t<size_t, pybind11::array::c_style
+                                   | pybind11::array::forcecast> offsets,
+    const double alpha, const int num_threads) {
+  if (s.ndim() != 1 || v.ndim() != 1 || s.size() != v.size()) {
+    throw pybind11::value_error("s and v must be 1-D and the same length");
+  }
+  if (offsets.size() == 0 || offsets.data()[0] != 0
+      || offsets.data()[offsets.size() - 1] != size_t(s.size())) {
+    throw pybind11::value_error(
+        "offsets must run from 0 to the number of values");
+  }
+  for (size_t k = 1; k < size_t(offsets.size()); k++) {
+    if (offsets.data()[k] < offsets.data()[k - 1]) {
+      throw pybind11::value_error("offsets must be nondecreasing");
+    }
+  }
+  const size_t num_streams = offsets.size() - 1;
+  std::vector<confseq::FirstCrossing> crossings(num_streams);
+  const double* s_data = s.data();
+  const double* v_data = v.data();
+  const size_t* offsets_data = offsets.data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::mixture_first_crossings(mixture, s_data, v_data, offsets_data,
+                                     num_streams, alpha, crossings.data(),
+                                     num_threads);
+  }
+  pybind11::array_t<size_t> times(num_streams);
+  DoubleArray p_values(num_streams);
+  for (size_t k = 0; k < num_streams; k++) {
+    times.mutable_data()[k] = crossings[k].time;
+    p_values.mutable_data()[k] = crossings[k].p_value;
+  }
+  return pybind11::make_tuple(times, p_values);
+}
+
+// x broadcast to a 1-D array of size values, one per mixture of a batch.
+DoubleArray batch_column(const DoubleArray x, const size_t size) {
+  if (x.ndim() > 1) {
+    throw pybind11::value_error("mixture batch arguments must be 1-D");
+  }
+  return pybind11::cast<DoubleArray>(
+      pybind11::module::import("numpy").attr("broadcast_to")(
+          x, pybind11::make_tuple(size)));
+}
+
+std::unique_ptr<confseq::GammaExponentialMixtureBatch>
+make_gamma_exponential_mixture_batch(const DoubleArray v_opt,
+                                     const DoubleArray alpha_opt,
+                                     const DoubleArray c) {
+  const pybind11::sequence broadcast =
+      pybind11::module::import("numpy").attr("broadcast_arrays")(
+          v_opt, alpha_opt, c);
+  const size_t size = pybind11::cast<DoubleArray>(broadcast[0]).size();
+  const DoubleArray v_opt_in = batch_column(v_opt, size);
+  const DoubleArray alpha_opt_in = batch_column(alpha_opt, size);
+  const DoubleArray c_in = batch_column(c, size);
+  const double* v_opt_data = v_opt_in.data();
+  const double* alpha_opt_data = alpha_opt_in.data();
+  const double* c_data = c_in.data();
+  pybind11::gil_scoped_release release;
+  return std::make_unique<confseq::GammaExponentialMixtureBatch>(
+      v_opt_data, alpha_opt_data, c_data, size);
+}
+
+using StatusArray = pybind11::array_t<uint8_t>;
+
+// Broadcast form of confseq::mixture_bounds, returning (bound, status) arrays.
+pybind11::tuple mixture_bounds_with_status(
+    const confseq::MixtureSupermartingale& mixture, const DoubleArray v,
+    const DoubleArray alpha) {
+  const pybind11::sequence broadcast =
+      pybind11::module::import("numpy").attr("broadcast_arrays")(v, alpha);
+  const DoubleArray v_in = pybind11::cast<DoubleArray>(broadcast[0]);
+  const DoubleArray alpha_in = pybind11::cast<DoubleArray>(broadcast[1]);
+  const std::vector<pybind11::ssize_t> shape(v_in.shape(),
+                                             v_in.shape() + v_in.ndim());
+  DoubleArray out(shape);
+  StatusArray status(shape);
+  const double* v_data = v_in.data();
+  const double* alpha_data = alpha_in.data();
+  double* out_data = out.mutable_data();
+  confseq::EvaluationStatus* status_data =
+      reinterpret_cast<confseq::EvaluationStatus*>(status.mutable_data());
+  {
+    pybind11::gil_scoped_release release;
+    confseq::mixture_bounds(mixture, v_data, alpha_data, out.size(), out_data,
+                            status_data);
+  }
+  return pybind11::make_tuple(out, status);
+}
+
+// Elementwise confseq::bernoulli_confidence_intervals over 1-D arrays,
+// returning (lower, upper, status).
+pybind11::tuple bernoulli_confidence_intervals_with_status(
+    const DoubleArray num_successes,
+    const pybind11::array_t<int, pybind11::array::c_style
+                                     | pybind11::array::forcecast> num_trials,
+    const double alpha, const double t_opt, const double alpha_opt) {
+  if (num_successes.size() != num_trials.size()) {
+    throw std::invalid_argument(
+        "num_successes and num_trials must have the same size");
+  }
+  const size_t n = num_successes.size();
+  DoubleArray lower(n), upper(n);
+  StatusArray status(n);
+  const double* successes_data = num_successes.data();
+  const int* trials_data = num_trials.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  confseq::EvaluationStatus* status_data =
+      reinterpret_cast<confseq::EvaluationStatus*>(status.mutable_data());
+  {
+    pybind11::gil_scoped_release release;
+    confseq::bernoulli_confidence_intervals(
+        successes_data, trials_data, n, alpha, t_opt, alpha_opt, lower_data,
+        upper_data, status_data);
+  }
+  return pybind11::make_tuple(lower, upper, status);
+}
+
+pybind11::tuple bernoulli_cs_table_lookup(
+    const confseq::BernoulliCSTable& table,
+    const confseq::InputArray<int> num_successes,
+    const confseq::InputArray<int> num_trials) {
+  const pybind11::sequence broadcast =
+      pybind11::module::import("numpy").attr("broadcast_arrays")(
+          num_successes, num_trials);
+  const auto successes = pybind11::cast<confseq::InputArray<int>>(broadcast[0]);
+  const auto trials = pybind11::cast<confseq::InputArray<int>>(broadcast[1]);
+  const std::vector<pybind11::ssize_t> shape(
+      successes.shape(), successes.shape() + successes.ndim());
+  DoubleArray lower(shape), upper(shape);
+  for (pybind11::ssize_t i = 0; i < lower.size(); i++) {
+    if (!table.contains(successes.data()[i], trials.data()[i])) {
+      throw pybind11::value_error("counts outside the table");
+    }
+    const auto bounds = table(successes.data()[i], trials.data()[i]);
+    lower.mutable_data()[i] = bounds.first;
+    upper.mutable_data()[i] = bounds.second;
+  }
+  if (lower.ndim() == 0) {
+    return pybind11::make_tuple(lower.data()[0], upper.data()[0]);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+// update() of a KeyedBernoulliCS or KeyedConjmixEmpBernCS on arrays of keys
+// and observations.
+template <class Store>
+void keyed_store_update(Store& store,
+                        const confseq::InputArray<uint64_t> keys,
+                        const DoubleArray x) {
+  if (keys.size() != x.size()) {
+    throw pybind11::value_error("keys and x must have the same size");
+  }
+  const uint64_t* keys_data = keys.data();
+  const double* x_data = x.data();
+  pybind11::gil_scoped_release release;
+  store.update(keys_data, x_data, keys.size());
+}
+
+// query() of a keyed store, returning (lower, upper) arrays shaped as keys.
+template <class Store>
+pybind11::tuple keyed_store_query(const Store& store,
+                                  const confseq::InputArray<uint64_t> keys) {
+  const confseq::Shape shape = confseq::array_shape(keys);
+  DoubleArray lower(shape), upper(shape);
+  const uint64_t* keys_data = keys.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    store.query(keys_data, keys.size(), lower_data, upper_data);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+// The members shared by the keyed stores' bindings: batch update() and
+// query(), scalar readouts, and checkpoints to files and pickles.
+template <class Store>
+void define_keyed_store_methods(pybind11::class_<Store>& store_class) {
+  store_class
+      .def("update", &keyed_store_update<Store>,
+           R"pbdoc(
+             Add observation `x[i]` to the stream of `keys[i]` for each `i`.
+             Raises ValueError, leaving the store unchanged, for an invalid
+             observation.
+           )pbdoc",
+           "keys"_a, "x"_a)
+      .def("query", &keyed_store_query<Store>,
+           R"pbdoc(
+             Return `(lower, upper)` arrays of the intervals of `keys`, with
+             `[0, 1]` for keys never updated.
+           )pbdoc",
+           "keys"_a)
+      .def("interval",
+           [](const Store& store, const uint64_t key) {
+             return store.interval(key);
+           },
+           "key"_a)
+      .def("num_observations", &Store::num_observations, "key"_a)
+      .def("__len__", &Store::size)
+      .def_property_readonly("memory_bytes", &Store::memory_bytes)
+      .def("save",
+           [](const Store& store, const std::string path) {
+             std::ofstream out(path, std::ios::binary);
+             store.save(out);
+             if (!out) {
+               throw std::runtime_error("Unable to write " + path);
+             }
+           },
+           "Write every key's state to a file, for `load()`.", "path"_a)
+      .def_static("load",
+                  [](const std::string path) {
+                    std::ifstream in(path, std::ios::binary);
+                    if (!in) {
+                      throw std::runtime_error("Unable to read " + path);
+                    }
+                    return Store::load(in);
+                  },
+                  "path"_a)
+      .def(confseq::checkpoint_pickle<Store>());
+}
+
+confseq::CrossingSimulationResult simulate_mixture_crossings(
+    const confseq::MixtureSupermartingale& mixture,
+    const confseq::SimulatedData& data, const double alpha,
+    const size_t horizon, const size_t replicates,
+    const pybind11::object v_per_observation, const uint64_t seed,
+    const int num_threads) {
+  const double v = v_per_observation.is_none() ? data.variance()
+      : v_per_observation.cast<double>();
+  pybind11::gil_scoped_release release;
+  return confseq::simulate_mixture_crossings(mixture, data, alpha, v, horizon,
+                                             replicates, seed, num_threads);
+}
+
+// Accepts a PolyStitchingBound or MixtureBoundary with alpha, or a
+// TabulatedBoundary, whose own alpha is used.
+confseq::CrossingSimulationResult simulate_boundary_crossings(
+    const pybind11::object boundary, const confseq::SimulatedData& data,
+    const size_t horizon, const size_t replicates,
+    const pybind11::object alpha, const pybind11::object v_per_observation,
+    const bool two_sided, const uint64_t seed, const int num_threads) {
+  std::function<double(double)> boundary_fn;
+  if (pybind11::isinstance<confseq::TabulatedBoundary>(boundary)) {
+    const auto& table = boundary.cast<const confseq::TabulatedBoundary&>();
+    boundary_fn = [&table](const double v) { return table(v); };
+  } else {
+    if (alpha.is_none()) {
+      throw pybind11::value_error("alpha is required for this boundary");
+    }
+    const double alpha_value = alpha.cast<double>();
+    if (pybind11::isinstance<confseq::PolyStitchingBound>(boundary)) {
+      const auto& bound = boundary.cast<const confseq::PolyStitchingBound&>();
+      boundary_fn = [&bound, alpha_value](const double v) {
+        return bound(v, alpha_value);
+      };
+    } else if (pybind11::isinstance<confseq::MixtureBoundary>(boundary)) {
+      const auto& bound = boundary.cast<const confseq::MixtureBoundary&>();
+      boundary_fn = [&bound, alpha_value](const double v) {
+        return bound(v, alpha_value);
+      };
+    } else {
+      throw pybind11::type_error(
+          "boundary must be a PolyStitchingBound, MixtureBoundary or "
+          "TabulatedBoundary");
+    }
+  }
+  const double v = v_per_observation.is_none() ? data.variance()
+      : v_per_observation.cast<double>();
+  pybind11::gil_scoped_release release;
+  return confseq::simulate_boundary_crossings(boundary_fn, data, v, horizon,
+                                              replicates, two_sided, seed,
+                                              num_threads);
+}
+
+confseq::TwoSampleMeanTestParams two_sample_params(
+    const std::string& mixture, const double alpha, const double alpha_opt,
+    const double null_difference, const bool running_intersection,
+    const double t_opt, const double lower_bd, const double upper_bd,
+    const double v_opt, const double c, const double readout_eta) {
+  confseq::TwoSampleMeanTestParams params;
+  params.mixture = confseq::two_sample_mixture(mixture);
+  params.alpha = alpha;
+  params.alpha_opt = alpha_opt;
+  params.null_difference = null_difference;
+  params.running_intersection = running_intersection;
+  params.t_opt = t_opt;
+  params.lower_bd = lower_bd;
+  params.upper_bd = upper_bd;
+  params.v_opt = v_opt;
+  params.c = c;
+  params.readout_eta = readout_eta;
+  return params;
+}
+
+using SizeArray = pybind11::array_t<
+    size_t, pybind11::array::c_style | pybind11::array::forcecast>;
+
+void check_offsets(const SizeArray& offsets, const size_t num_values,
+                   const size_t num_experiments) {
+  if (size_t(offsets.size()) != num_experiments + 1
+      || offsets.data()[0] != 0
+      || offsets.data()[num_experiments] != num_values) {
+    throw pybind11::value_error(
+        "offsets must run from 0 to the number of values, with one more "
+        "entry than there are experiments");
+  }
+  for (size_t e = 0; e < num_experiments; e++) {
+    if (offsets.data()[e + 1] < offsets.data()[e]) {
+      throw pybind11::value_error("offsets must be nondecreasing");
+    }
+  }
+}
+
+pybind11::tuple two_sample_mean_tests(
+    const DoubleArray control, const SizeArray control_offsets,
+    const DoubleArray treatment, const SizeArray treatment_offsets,
+    const std::string& mixture, const double alpha, const double alpha_opt,
+    const double null_difference, const bool running_intersection,
+    const double t_opt, const double lower_bd, const double upper_bd,
+    const double v_opt, const double c, const double readout_eta,
+    const int num_threads) {
+  if (control_offsets.size() != treatment_offsets.size()
+      || control_offsets.size() == 0) {
+    throw pybind11::value_error(
+        "control_offsets and treatment_offsets must have the same, nonzero "
+        "length");
+  }
+  const size_t num_experiments = control_offsets.size() - 1;
+  check_offsets(control_offsets, control.size(), num_experiments);
+  check_offsets(treatment_offsets, treatment.size(), num_experiments);
+  const confseq::TwoSampleMeanTestParams params = two_sample_params(
+      mixture, alpha, alpha_opt, null_difference, running_intersection, t_opt,
+      lower_bd, upper_bd, v_opt, c, readout_eta);
+  DoubleArray lower(num_experiments), upper(num_experiments),
+      p_value(num_experiments);
+  const double* control_data = control.data();
+  const double* treatment_data = treatment.data();
+  const size_t* control_offsets_data = control_offsets.data();
+  const size_t* treatment_offsets_data = treatment_offsets.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  double* p_value_data = p_value.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::two_sample_mean_tests(params, control_data, control_offsets_data,
+                                   treatment_data, treatment_offsets_data,
+                                   num_experiments, lower_data, upper_data,
+                                   p_value_data, num_threads);
+  }
+  return pybind11::make_tuple(lower, upper, p_value);
+}
+
+// The columns of AverageTreatmentEffectCS rows as a dict of arrays, which
+// pandas.DataFrame() turns into the table of demo/ate_demo.py.
+pybind11::dict ate_columns(
+    const std::vector<confseq::AverageTreatmentEffectEstimate>& rows) {
+  DoubleArray t(rows.size()), point_estimate(rows.size()),
+      upper(rows.size()), lower(rows.size()), p_value(rows.size());
+  for (size_t r = 0; r < rows.size(); r++) {
+    t.mutable_data()[r] = rows[r].t;
+    point_estimate.mutable_data()[r] = rows[r].point_estimate;
+    upper.mutable_data()[r] = rows[r].upper_confidence_bound;
+    lower.mutable_data()[r] = rows[r].lower_confidence_bound;
+    p_value.mutable_data()[r] = rows[r].p_value;
+  }
+  pybind11::dict columns;
+  columns["t"] = t;
+  columns["point_estimate"] = point_estimate;
+  columns["upper_confidence_bound"] = upper;
+  columns["lower_confidence_bound"] = lower;
+  columns["p_value"] = p_value;
+  return columns;
+}
+
+pybind11::dict ate_update(confseq::AverageTreatmentEffectCS& cs,
+                          const DoubleArray y,
+                          const pybind11::object treatment,
+                          const pybind11::object propensity,
+                          const pybind11::object y1_prediction,
+                          const pybind11::object y0_prediction) {
+  // Propensities and predictions may be scalars, broadcast over the units.
+  const pybind11::object broadcast_to =
+      pybind11::module::import("numpy").attr("broadcast_to");
+  auto per_unit = [&](const pybind11::object values) {
+    return pybind11::cast<DoubleArray>(broadcast_to(values, y.size()));
+  };
+  const DoubleArray treatment_array = per_unit(treatment);
+  const DoubleArray propensity_array = per_unit(propensity);
+  const DoubleArray y1_array =
+      y1_prediction.is_none() ? DoubleArray(0) : per_unit(y1_prediction);
+  const DoubleArray y0_array =
+      y0_prediction.is_none() ? DoubleArray(0) : per_unit(y0_prediction);
+  std::vector<confseq::AverageTreatmentEffectEstimate> rows(
+      cs.num_rows(y.size()));
+  {
+    pybind11::gil_scoped_release release;
+    cs.update(y.data(), treatment_array.data(), propensity_array.data(),
+              y.size(), rows.data(),
+              y1_prediction.is_none() ? nullptr : y1_array.data(),
+              y0_prediction.is_none() ? nullptr : y0_array.data());
+  }
+  return ate_columns(rows);
+}
+
+template <class Mixture>
+void define_mixture_boundary_init(
+    pybind11::class_<confseq::MixtureBoundary>& mixture_boundary) {
+  mixture_boundary.def(
+      pybind11::init([](const Mixture& mixture) {
+        return confseq::MixtureBoundary(std::make_unique<Mixture>(mixture));
+      }),
+      "mixture"_a);
+}
+
+template <class Mixture>
+void define_boundary_sequence_init(
+    pybind11::class_<confseq::BoundarySequence>& boundary_sequence) {
+  boundary_sequence.def(
+      pybind11::init([](const Mixture& mixture, const double alpha,
+                        const size_t size, const double v_scale,
+                        const double v_offset, const size_t chunk_size) {
+        return confseq::BoundarySequence(std::make_unique<Mixture>(mixture),
+                                         alpha, size, v_scale, v_offset,
+                                         chunk_size);
+      }),
+      "mixture"_a, "alpha"_a, "size"_a, "v_scale"_a=1, "v_offset"_a=0,
+      "chunk_size"_a=1024);
+}
+
+// Iterates over a BoundarySequence, discarding the chunks behind it.
+struct BoundarySequenceIterator {
+  confseq::BoundarySequence& sequence;
+  size_t next;
+};
+
 PYBIND11_MODULE(boundaries, m) {
   m.doc() = R"pbdoc(
     Uniform boundaries and mixture supermartingales. See package documentation
@@ -20,57 +667,315 @@ PYBIND11_MODULE(boundaries, m) {
     All mixture functions accept `v_opt` and optionally `alpha_opt`. The
     mixtures are then tuned to optimize the uniform boundary with crossing
     probability `alpha_opt` at intrinsic time `v_opt`.
+
+    Array arguments are broadcast with NumPy rules and evaluated across
+    `get_num_threads()` threads with the GIL released.
     )pbdoc";
 
+  confseq::define_thread_settings(m);
+  confseq::define_solver_counters(m);
+  confseq::define_latency_tracing(m);
+
+  m.def("enable_boundary_cache", &confseq::enable_boundary_cache,
+        R"pbdoc(
+        Memoize boundary and confidence interval evaluations process-wide.
+
+        Applies to `MixtureBoundary`, all `*_mixture_bound()` functions and
+        `bernoulli_confidence_interval()`. At most `capacity` results are kept,
+        evicting the least recently used. Calling again replaces the cache.
+        )pbdoc",
+        "capacity"_a=100000);
+  m.def("disable_boundary_cache", &confseq::disable_boundary_cache,
+        "Disable and free the process-wide boundary cache.");
+  m.def("clear_boundary_cache", &confseq::clear_boundary_cache,
+        "Drop all cached results and reset hit and miss counts.");
+  m.def("boundary_cache_stats",
+        []() {
+          const confseq::BoundaryCacheStats stats =
+              confseq::boundary_cache_stats();
+          return pybind11::dict("hits"_a=stats.hits, "misses"_a=stats.misses,
+                                "size"_a=stats.size,
+                                "capacity"_a=stats.capacity);
+        },
+        "Return a dict of cache hits, misses, size and capacity.");
+
+  m.def("write_constants_bundle",
+        [](const std::string& path) {
+          confseq::ConstantsBundle bundle = [] {
+            pybind11::gil_scoped_release release;
+            return confseq::ConstantsBundle::build(
+                confseq::ConstantsBundleGrid());
+          }();
+          std::ofstream out(path, std::ios::binary);
+          bundle.save(out);
+          out.close();
+          if (!out) {
+            throw std::runtime_error("Unable to write " + path);
+          }
+          return bundle.size();
+        },
+        R"pbdoc(
+        Write the constants that mixture and LIL bound constructors compute
+        from their hyperparameters, for the default grids, to `path`, and
+        return how many were written. The package installs such a file and
+        maps it on import; see `load_constants_bundle()`.
+        )pbdoc",
+        "path"_a);
+  m.def("load_constants_bundle",
+        [](const std::string& path) {
+          auto bundle = std::make_shared<const confseq::ConstantsBundle>(
+              confseq::ConstantsBundle::map_file(path));
+          confseq::set_constants_bundle(bundle);
+          return bundle->size();
+        },
+        R"pbdoc(
+        Memory-map the constants written by `write_constants_bundle()` and
+        read them in constructors in place of computing them, replacing any
+        bundle in use. Constants missing from the file are still computed.
+        Returns the number of constants. The bundle is also mapped on first
+        use from the file named by the `CONFSEQ_CONSTANTS_BUNDLE` environment
+        variable.
+        )pbdoc",
+        "path"_a);
+  m.def("unload_constants_bundle",
+        []() { confseq::set_constants_bundle(nullptr); },
+        "Compute every constant again rather than read it from a bundle.");
+
+  pybind11::enum_<confseq::SpecialFunctionPrecision>(
+      m, "SpecialFunctionPrecision",
+      R"pbdoc(
+        Accuracy of the incomplete gamma and beta functions, lgamma and
+        related special functions inside mixture supermartingales: `FULL`
+        double precision, or about 40 (`BALANCED`) or 24 (`FAST`) bits.
+        `FAST` evaluates most incomplete gamma functions from precomputed
+        Chebyshev tables.
+      )pbdoc")
+      .value("FULL", confseq::SpecialFunctionPrecision::FULL)
+      .value("BALANCED", confseq::SpecialFunctionPrecision::BALANCED)
+      .value("FAST", confseq::SpecialFunctionPrecision::FAST);
+
+  pybind11::class_<confseq::SolverPrecision>(
+      m, "SolverPrecision",
+      R"pbdoc(
+        Precision of the root searches behind boundaries and intervals, in
+        `bits` of relative accuracy, and of the special functions they
+        evaluate. With `conservative=True`, reduced precision can only widen
+        results. `SolverPrecision.balanced()` and `SolverPrecision.fast()`
+        trade accuracy to about 1e-9 and 1e-6, plus the special-function
+        error, for several times faster gamma and beta-binomial mixture
+        bounds.
+      )pbdoc")
+      .def(pybind11::init([](const int bits, const bool conservative,
+                             const confseq::SpecialFunctionPrecision
+                                 special_functions) {
+             confseq::SolverPrecision precision;
+             precision.bits = bits;
+             precision.conservative = conservative;
+             precision.special_functions = special_functions;
+             return precision;
+           }),
+           "bits"_a=40, "conservative"_a=false,
+           "special_functions"_a=confseq::SpecialFunctionPrecision::FULL)
+      .def_readwrite("bits", &confseq::SolverPrecision::bits)
+      .def_readwrite("conservative", &confseq::SolverPrecision::conservative)
+      .def_readwrite("special_functions",
+                     &confseq::SolverPrecision::special_functions)
+      .def_static("exact", &confseq::SolverPrecision::exact)
+      .def_static("balanced", &confseq::SolverPrecision::balanced)
+      .def_static("fast", &confseq::SolverPrecision::fast);
+
+  // Each log mixture first tries scalar mixture parameters, constructing the
+  // mixture once, and falls back to evaluating every element's parameters.
+  m.def("normal_log_mixture",
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double alpha_opt, const bool is_one_sided,
+           const pybind11::object out, const pybind11::object where) {
+          if (is_one_sided) {
+            return mixture_log_superMG(
+                confseq::OneSidedNormalMixture(v_opt, alpha_opt), s, v, out,
+                where);
+          }
+          return mixture_log_superMG(
+              confseq::TwoSidedNormalMixture(v_opt, alpha_opt), s, v, out,
+              where);
+        },
+        "s"_a, "v"_a, "v_opt"_a, "alpha_opt"_a=0.05, "is_one_sided"_a=true,
+        "out"_a=pybind11::none(), "where"_a=true);
   m.def("normal_log_mixture",
-        pybind11::vectorize(confseq::normal_log_mixture),
+        confseq::parallel_vectorize(confseq::normal_log_mixture),
         R"pbdoc(
           Logarithm of mixture supermartingale for the one- or two-sided normal
           mixture.
         )pbdoc",
-        "s"_a, "v"_a, "v_opt"_a, "alpha_opt"_a=0.05, "is_one_sided"_a=true);
+        "s"_a, "v"_a, "v_opt"_a, "alpha_opt"_a=0.05, "is_one_sided"_a=true,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("normal_p_value",
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double alpha_opt, const bool is_one_sided,
+           const bool running_min) {
+          if (is_one_sided) {
+            return mixture_p_values(
+                confseq::OneSidedNormalMixture(v_opt, alpha_opt), s, v,
+                running_min);
+          }
+          return mixture_p_values(
+              confseq::TwoSidedNormalMixture(v_opt, alpha_opt), s, v,
+              running_min);
+        },
+        R"pbdoc(
+          P-value `min(1, exp(-normal_log_mixture(s, v, ...)))` for the one-
+          or two-sided normal mixture, without a root search. With
+          `running_min=True`, `s` and `v` are a 1-D stream of martingale and
+          intrinsic time values and the always-valid running minimum is
+          returned.
+        )pbdoc",
+        "s"_a, "v"_a, "v_opt"_a, "alpha_opt"_a=0.05, "is_one_sided"_a=true,
+        "running_min"_a=false);
   m.def("normal_mixture_bound",
-        pybind11::vectorize(confseq::normal_mixture_bound),
+        confseq::parallel_vectorize(confseq::normal_mixture_bound),
         R"pbdoc(
           One- or two-sided normal mixture uniform boundary.
+
+          A C-contiguous float32 `v` with scalar other arguments gives float32
+          bounds, computed in double precision and rounded up to the next
+          float so that they stay conservative.
         )pbdoc",
         "v"_a, "alpha"_a, "v_opt"_a, "alpha_opt"_a=0.05,
+        "is_one_sided"_a=true,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("normal_mixture_bound",
+        [](const confseq::Float32Array v, const double alpha,
+           const double v_opt, const double alpha_opt,
+           const bool is_one_sided) {
+          const double log_threshold = log(1 / alpha);
+          if (is_one_sided) {
+            const confseq::OneSidedNormalMixture mixture(v_opt, alpha_opt);
+            return confseq::float32_blocks(
+                v, [&](const float* v, const size_t n, float* out) {
+                  for (size_t i = 0; i < n; i++) {
+                    out[i] = confseq::round_up_to_float(
+                        mixture.bound(v[i], log_threshold));
+                  }
+                });
+          }
+          const confseq::TwoSidedNormalMixture mixture(v_opt, alpha_opt);
+          return confseq::float32_blocks(
+              v, [&](const float* v, const size_t n, float* out) {
+                mixture.bound_sequence(v, n, log_threshold, out);
+              });
+        },
+        "v"_a.noconvert(), "alpha"_a, "v_opt"_a, "alpha_opt"_a=0.05,
         "is_one_sided"_a=true);
   m.def("gamma_exponential_log_mixture",
-        pybind11::vectorize(confseq::gamma_exponential_log_mixture),
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double c, const double alpha_opt,
+           const pybind11::object out, const pybind11::object where) {
+          return mixture_log_superMG(
+              confseq::GammaExponentialMixture(v_opt, alpha_opt, c), s, v, out, where);
+        },
+        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("gamma_exponential_log_mixture",
+        confseq::parallel_vectorize(confseq::gamma_exponential_log_mixture),
         R"pbdoc(
           Logarithm of mixture supermartingale for the gamma-exponential
           mixture.
 
           `c` is the sub-exponential scale parameter.
         )pbdoc",
-        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05);
+        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("gamma_exponential_p_value",
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double c, const double alpha_opt, const bool running_min) {
+          return mixture_p_values(
+              confseq::GammaExponentialMixture(v_opt, alpha_opt, c), s, v,
+              running_min);
+        },
+        R"pbdoc(
+          P-value for the gamma-exponential mixture, as `normal_p_value()`.
+        )pbdoc",
+        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "running_min"_a=false);
   m.def("gamma_exponential_mixture_bound",
-        pybind11::vectorize(confseq::gamma_exponential_mixture_bound),
+        confseq::parallel_vectorize_with_precision(
+            confseq::gamma_exponential_mixture_bound),
         R"pbdoc(
           Gamma-exponential mixture uniform boundary.
 
-          `c` is the sub-exponential scale parameter.
+          `c` is the sub-exponential scale parameter. `precision` is a
+          `SolverPrecision`, such as `SolverPrecision.fast()`.
+        )pbdoc",
+        "v"_a, "alpha"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "precision"_a=confseq::SolverPrecision(),
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("gamma_exponential_mixture_bound_sequence",
+        &gamma_exponential_mixture_bound_sequence,
+        R"pbdoc(
+          Gamma-exponential mixture uniform boundary over a 1-D array of `v`.
+
+          Equivalent to `gamma_exponential_mixture_bound` with scalar `alpha`,
+          but each root search is warm-started from the previous element, so
+          this is much faster when `v` is sorted, e.g. cumulative variance.
         )pbdoc",
         "v"_a, "alpha"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05);
   m.def("gamma_poisson_log_mixture",
-        pybind11::vectorize(confseq::gamma_poisson_log_mixture),
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double c, const double alpha_opt,
+           const pybind11::object out, const pybind11::object where) {
+          return mixture_log_superMG(
+              confseq::GammaPoissonMixture(v_opt, alpha_opt, c), s, v, out, where);
+        },
+        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("gamma_poisson_log_mixture",
+        confseq::parallel_vectorize(confseq::gamma_poisson_log_mixture),
         R"pbdoc(
           Logarithm of mixture supermartingale for the gamma-Poisson mixture.
 
           `c` is the sub-Poisson scale parameter.
         )pbdoc",
-        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05);
+        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("gamma_poisson_p_value",
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double c, const double alpha_opt, const bool running_min) {
+          return mixture_p_values(
+              confseq::GammaPoissonMixture(v_opt, alpha_opt, c), s, v,
+              running_min);
+        },
+        R"pbdoc(
+          P-value for the gamma-Poisson mixture, as `normal_p_value()`.
+        )pbdoc",
+        "s"_a, "v"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "running_min"_a=false);
   m.def("gamma_poisson_mixture_bound",
-        pybind11::vectorize(confseq::gamma_poisson_mixture_bound),
+        confseq::parallel_vectorize_with_precision(
+            confseq::gamma_poisson_mixture_bound),
         R"pbdoc(
           Gamma-Poisson mixture uniform boundary.
 
-          `c` is the sub-Poisson scale parameter.
+          `c` is the sub-Poisson scale parameter. `precision` is a
+          `SolverPrecision`, such as `SolverPrecision.fast()`.
         )pbdoc",
-        "v"_a, "alpha"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05);
+        "v"_a, "alpha"_a, "v_opt"_a, "c"_a, "alpha_opt"_a=0.05,
+        "precision"_a=confseq::SolverPrecision(),
+        "out"_a=pybind11::none(), "where"_a=true);
   m.def("beta_binomial_log_mixture",
-        pybind11::vectorize(confseq::beta_binomial_log_mixture),
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double g, const double h, const double alpha_opt,
+           const bool is_one_sided, const pybind11::object out,
+           const pybind11::object where) {
+          return mixture_log_superMG(
+              confseq::BetaBinomialMixture(v_opt, alpha_opt, g, h,
+                                           is_one_sided),
+              s, v, out, where);
+        },
+        "s"_a, "v"_a, "v_opt"_a, "g"_a, "h"_a, "alpha_opt"_a=0.05,
+        "is_one_sided"_a=true,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("beta_binomial_log_mixture",
+        confseq::parallel_vectorize(confseq::beta_binomial_log_mixture),
         R"pbdoc(
           Logarithm of mixture supermartingale for the one- or two-sided
           beta-binomial mixture.
@@ -78,18 +983,41 @@ PYBIND11_MODULE(boundaries, m) {
           `g` and `h` are the sub-Bernoulli range parameter.
         )pbdoc",
         "s"_a, "v"_a, "v_opt"_a, "g"_a, "h"_a, "alpha_opt"_a=0.05,
-        "is_one_sided"_a=true);
+        "is_one_sided"_a=true,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("beta_binomial_p_value",
+        [](const DoubleArray s, const DoubleArray v, const double v_opt,
+           const double g, const double h, const double alpha_opt,
+           const bool is_one_sided, const bool running_min) {
+          return mixture_p_values(
+              confseq::BetaBinomialMixture(v_opt, alpha_opt, g, h,
+                                           is_one_sided),
+              s, v, running_min);
+        },
+        R"pbdoc(
+          P-value for the one- or two-sided beta-binomial mixture, as
+          `normal_p_value()`.
+        )pbdoc",
+        "s"_a, "v"_a, "v_opt"_a, "g"_a, "h"_a, "alpha_opt"_a=0.05,
+        "is_one_sided"_a=true, "running_min"_a=false);
   m.def("beta_binomial_mixture_bound",
-        pybind11::vectorize(confseq::beta_binomial_mixture_bound),
+        confseq::parallel_vectorize_with_precision(
+            confseq::beta_binomial_mixture_bound),
         R"pbdoc(
           One- or two-sided beta-binomial mixture uniform boundary.
 
-          `g` and `h` are the sub-Bernoulli range parameter.
+          `g` and `h` are the sub-Bernoulli range parameter. `precision` is a
+          `SolverPrecision`, such as `SolverPrecision.fast()`.
         )pbdoc",
         "v"_a, "alpha"_a, "v_opt"_a, "g"_a, "h"_a, "alpha_opt"_a=0.05,
-        "is_one_sided"_a=true);
+        "is_one_sided"_a=true, "precision"_a=confseq::SolverPrecision(),
+        "out"_a=pybind11::none(), "where"_a=true);
   m.def("poly_stitching_bound",
-        pybind11::vectorize(confseq::poly_stitching_bound),
+        [](const DoubleArray v, const DoubleArray alpha, const double v_min,
+           const double c, const double s, const double eta) {
+          return batch_poly_stitching_bound(
+              confseq::PolyStitchingBound(v_min, c, s, eta), v, alpha);
+        },
         R"pbdoc(
           Polynomial stitched uniform boundary.
 
@@ -97,10 +1025,37 @@ PYBIND11_MODULE(boundaries, m) {
           * `c`: sub-gamma scale parameter
           * `s`: controls how crossing probability is distribted over epochs
           * `eta`: controls the spacing of epochs
+
+          With scalar `v_min`, `c`, `s` and `eta`, the boundary is constructed
+          once per call and evaluated in blocks across threads. Arrays of them
+          are broadcast with `v` and `alpha` instead, constructing it per
+          element. A C-contiguous float32 `v` with scalar `alpha` gives float32
+          bounds, each rounded up from the float64 bound.
         )pbdoc",
         "v"_a, "alpha"_a, "v_min"_a, "c"_a=0, "s"_a=1.4, "eta"_a=2);
+  m.def("poly_stitching_bound",
+        [](const confseq::Float32Array v, const double alpha,
+           const double v_min, const double c, const double s,
+           const double eta) {
+          const confseq::PolyStitchingBound bound(v_min, c, s, eta);
+          return confseq::float32_blocks(
+              v, [&](const float* v, const size_t n, float* out) {
+                bound.bound_sequence(v, n, alpha, out);
+              });
+        },
+        "v"_a.noconvert(), "alpha"_a, "v_min"_a, "c"_a=0, "s"_a=1.4,
+        "eta"_a=2);
+  m.def("poly_stitching_bound",
+        confseq::parallel_vectorize(confseq::poly_stitching_bound),
+        "v"_a, "alpha"_a, "v_min"_a, "c"_a=0, "s"_a=1.4, "eta"_a=2,
+        "out"_a=pybind11::none(), "where"_a=true);
   m.def("bernoulli_confidence_interval",
-        &confseq::bernoulli_confidence_interval,
+        confseq::parallel_vectorize(
+            +[](double num_successes, int num_trials, double alpha,
+                double t_opt, double alpha_opt) {
+              return confseq::bernoulli_confidence_interval(
+                  num_successes, num_trials, alpha, t_opt, alpha_opt);
+            }),
         R"pbdoc(
         Confidence sequence for [0, 1]-bounded distributions.
 
@@ -114,7 +1069,1024 @@ PYBIND11_MODULE(boundaries, m) {
         * `num_successes`: number of "successful" Bernoulli trials seen so far,
           or more generally, sum of observed outcomes.
         * `num_trials`: total number of observations seen so far.
+
+        Array arguments, for example counts for many arms, give a tuple
+        `(lower, upper)` of arrays, computed across threads.
+        )pbdoc",
+        "num_successes"_a, "num_trials"_a, "alpha"_a, "t_opt"_a,
+        "alpha_opt"_a=0.05,
+        "out"_a=pybind11::none(), "where"_a=true);
+
+  pybind11::enum_<confseq::EvaluationStatus>(
+      m, "EvaluationStatus",
+      R"pbdoc(
+        Per-element outcome codes in the status arrays returned by
+        `MixtureSupermartingale.bound_with_status()` and
+        `bernoulli_confidence_interval_with_status()`.
+      )pbdoc")
+      .value("OK", confseq::EvaluationStatus::OK)
+      .value("INVALID_ARGUMENT", confseq::EvaluationStatus::INVALID_ARGUMENT)
+      .value("NUMERICAL_ERROR", confseq::EvaluationStatus::NUMERICAL_ERROR);
+
+  m.def("bernoulli_confidence_interval_with_status",
+        &bernoulli_confidence_intervals_with_status,
+        R"pbdoc(
+        As `bernoulli_confidence_interval()` over 1-D arrays of counts, but
+        never raising for a bad element. Returns `(lower, upper, status)`,
+        where elements with a nonzero `EvaluationStatus` code in `status`
+        have NaN bounds.
         )pbdoc",
         "num_successes"_a, "num_trials"_a, "alpha"_a, "t_opt"_a,
         "alpha_opt"_a=0.05);
+
+  pybind11::class_<confseq::MixtureSupermartingale>(
+      m, "MixtureSupermartingale",
+      R"pbdoc(
+        Base class for mixture supermartingales. Each subclass is tuned once on
+        construction, so evaluating many `(s, v)` values through an instance
+        avoids repeating that work for every element.
+      )pbdoc")
+      .def("log_superMG", &batch_log_superMG,
+           R"pbdoc(
+             Logarithm of the mixture supermartingale at `s` and `v`.
+           )pbdoc",
+           "s"_a, "v"_a)
+      .def("p_value", &mixture_p_values,
+           R"pbdoc(
+             `min(1, exp(-log_superMG(s, v)))`, computed across threads. With
+             `running_min=True`, `s` and `v` are a 1-D stream and the
+             always-valid running minimum is returned.
+           )pbdoc",
+           "s"_a, "v"_a, "running_min"_a=false)
+      .def("bound",
+           pybind11::vectorize(
+               [](const confseq::MixtureSupermartingale& mixture,
+                  const double v, const double alpha) {
+                 return mixture.bound(v, log(1 / alpha));
+               }),
+           R"pbdoc(
+             Uniform boundary with crossing probability `alpha` at `v`.
+           )pbdoc",
+           "v"_a, "alpha"_a)
+      .def("bound_multi", &bound_multi,
+           R"pbdoc(
+             Uniform boundaries at each of the 1-D array `v` for each of the
+             1-D array `alpha`, as a `len(v)` by `len(alpha)` array, e.g. for
+             several confidence bands at once. The searches for the
+             different `alpha` share brackets, so this is cheaper than
+             separate `bound()` calls.
+           )pbdoc",
+           "v"_a, "alpha"_a)
+      .def("bound_with_status", &mixture_bounds_with_status,
+           R"pbdoc(
+             As `bound()`, computed across threads without raising for a bad
+             element. Returns `(bound, status)` arrays, where elements with a
+             nonzero `EvaluationStatus` code in `status` have NaN bounds.
+           )pbdoc",
+           "v"_a, "alpha"_a)
+      .def("bound_sequence",
+           [](const confseq::MixtureSupermartingale& mixture,
+              const DoubleArray v, const double alpha) {
+             DoubleArray out(v.size());
+             mixture.bound_sequence(v.data(), v.size(), log(1 / alpha),
+                                    out.mutable_data());
+             return out;
+           },
+           R"pbdoc(
+             Uniform boundary over a 1-D array of `v` with scalar `alpha`,
+             warm-starting each root search from the previous element.
+           )pbdoc",
+           "v"_a, "alpha"_a)
+      .def_property("precision", &confseq::MixtureSupermartingale::precision,
+                    &confseq::MixtureSupermartingale::set_precision,
+                    R"pbdoc(
+                      `SolverPrecision` used by `bound()` and
+                      `bound_sequence()`.
+                    )pbdoc");
+  pybind11::class_<confseq::TwoSidedNormalMixture,
+                   confseq::MixtureSupermartingale>(
+      m, "TwoSidedNormalMixture")
+      .def(pybind11::init<double, double>(), "v_opt"_a, "alpha_opt"_a=0.05);
+  pybind11::class_<confseq::OneSidedNormalMixture,
+                   confseq::MixtureSupermartingale>(
+      m, "OneSidedNormalMixture")
+      .def(pybind11::init<double, double>(), "v_opt"_a, "alpha_opt"_a=0.05);
+  pybind11::class_<confseq::GammaExponentialMixture,
+                   confseq::MixtureSupermartingale>(
+      m, "GammaExponentialMixture")
+      .def(pybind11::init<double, double, double>(), "v_opt"_a,
+           "alpha_opt"_a, "c"_a)
+      .def("log_superMG_spaced",
+           [](const confseq::GammaExponentialMixture& mixture,
+              const DoubleArray s, const double v_start,
+              const double v_step) {
+             if (s.ndim() > 1) {
+               throw pybind11::value_error("s must be 1-D");
+             }
+             DoubleArray out(s.size());
+             const double* s_data = s.data();
+             double* out_data = out.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               mixture.log_superMG_spaced(s_data, v_start, v_step, s.size(),
+                                          out_data);
+             }
+             return out;
+           },
+           R"pbdoc(
+             `log_superMG(s, v_start + v_step * np.arange(len(s)))` for a
+             stream whose intrinsic time advances by a constant step. When
+             `v_step / c**2` is a small positive integer, the log-gamma term
+             is updated by recurrence rather than recomputed.
+           )pbdoc",
+           "s"_a, "v_start"_a, "v_step"_a);
+  pybind11::class_<confseq::GammaExponentialMixtureBatch>(
+      m, "GammaExponentialMixtureBatch",
+      R"pbdoc(
+        Many `GammaExponentialMixture` objects, mixture `i` having
+        `v_opt[i]`, `alpha_opt[i]` and `c[i]`, stored as contiguous columns.
+        Arguments broadcast to one 1-D length. `log_superMG()` and `bound()`
+        take one value per mixture and run across threads with the GIL
+        released, without a Python object or virtual call per mixture.
+      )pbdoc")
+      .def(pybind11::init(&make_gamma_exponential_mixture_batch), "v_opt"_a,
+           "alpha_opt"_a, "c"_a)
+      .def("__len__", &confseq::GammaExponentialMixtureBatch::size)
+      .def("log_superMG",
+           [](const confseq::GammaExponentialMixtureBatch& batch,
+              const DoubleArray s, const DoubleArray v) {
+             const DoubleArray s_in = batch_column(s, batch.size());
+             const DoubleArray v_in = batch_column(v, batch.size());
+             DoubleArray out(batch.size());
+             const double* s_data = s_in.data();
+             const double* v_data = v_in.data();
+             double* out_data = out.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               batch.log_superMG(s_data, v_data, out_data);
+             }
+             return out;
+           },
+           R"pbdoc(
+             Log mixture supermartingale of mixture `i` at `s[i]` and `v[i]`.
+           )pbdoc",
+           "s"_a, "v"_a)
+      .def("bound",
+           [](const confseq::GammaExponentialMixtureBatch& batch,
+              const DoubleArray v, const double alpha) {
+             const DoubleArray v_in = batch_column(v, batch.size());
+             DoubleArray out(batch.size());
+             const double* v_data = v_in.data();
+             double* out_data = out.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               batch.bound(v_data, log(1 / alpha), out_data);
+             }
+             return out;
+           },
+           R"pbdoc(
+             Uniform boundary of mixture `i` at `v[i]` with crossing
+             probability `alpha`.
+           )pbdoc",
+           "v"_a, "alpha"_a)
+      .def("mixture",
+           [](const confseq::GammaExponentialMixtureBatch& batch,
+              const size_t i) {
+             if (i >= batch.size()) {
+               throw pybind11::index_error("mixture index out of range");
+             }
+             return batch.mixture(i);
+           },
+           "The `GammaExponentialMixture` at index `i`.", "i"_a)
+      .def_property("precision",
+                    &confseq::GammaExponentialMixtureBatch::precision,
+                    &confseq::GammaExponentialMixtureBatch::set_precision,
+                    "`SolverPrecision` of every mixture in the batch.");
+  pybind11::class_<confseq::GammaPoissonMixture,
+                   confseq::MixtureSupermartingale>(
+      m, "GammaPoissonMixture")
+      .def(pybind11::init<double, double, double>(), "v_opt"_a,
+           "alpha_opt"_a, "c"_a);
+  pybind11::class_<confseq::BetaBinomialMixture,
+                   confseq::MixtureSupermartingale>(
+      m, "BetaBinomialMixture")
+      .def(pybind11::init<double, double, double, double, bool>(), "v_opt"_a,
+           "alpha_opt"_a, "g"_a, "h"_a, "is_one_sided"_a=true);
+  pybind11::class_<confseq::TabulatedBetaBinomialMixture,
+                   confseq::MixtureSupermartingale>(
+      m, "TabulatedBetaBinomialMixture",
+      R"pbdoc(
+        `BetaBinomialMixture` with `log_superMG` precomputed on `num_v`
+        log-spaced values of `v` between `v_min` and `v_max`, each with
+        `num_z` values of `s / sqrt(v)` up to `z_max` in absolute value.
+
+        `log_superMG` returns a certified lower bound of the exact log
+        mixture, so p-values and bounds computed from it are conservative.
+        Queries outside the table use the exact mixture.
+      )pbdoc")
+      .def(pybind11::init<const confseq::BetaBinomialMixture&, double, double,
+                          size_t, size_t, double>(),
+           "mixture"_a, "v_min"_a, "v_max"_a, "num_v"_a=128, "num_z"_a=257,
+           "z_max"_a=16)
+      .def("log_superMG_bounds",
+           [](const confseq::TabulatedBetaBinomialMixture& table,
+              const confseq::InputArray<double> s,
+              const confseq::InputArray<double> v,
+              const pybind11::object out, const pybind11::object where) {
+             return confseq::ParallelVectorized<std::pair<double, double>,
+                                                double, double>(
+                 [&table](const double s, const double v) {
+                   return table.log_superMG_bounds(s, v);
+                 })(s, v, out, where);
+           },
+           R"pbdoc(
+             Certified `(lower, upper)` bounds on the exact log mixture at `s`
+             and `v`. The upper bound is infinite where the table does not
+             determine one.
+           )pbdoc",
+           "s"_a, "v"_a, "out"_a=pybind11::none(), "where"_a=true)
+      .def_property_readonly("v_min",
+                             &confseq::TabulatedBetaBinomialMixture::v_min)
+      .def_property_readonly("v_max",
+                             &confseq::TabulatedBetaBinomialMixture::v_max);
+
+  pybind11::class_<confseq::PolyStitchingBound>(
+      m, "PolyStitchingBound",
+      R"pbdoc(
+        Polynomial stitched uniform boundary; see `poly_stitching_bound`.
+      )pbdoc")
+      .def(pybind11::init<double, double, double, double>(), "v_min"_a,
+           "c"_a=0, "s"_a=1.4, "eta"_a=2)
+      .def("__call__", &batch_poly_stitching_bound, "v"_a, "alpha"_a)
+      .def("__call__",
+           [](const confseq::PolyStitchingBound& bound,
+              const confseq::Float32Array v, const double alpha) {
+             return confseq::float32_blocks(
+                 v, [&](const float* v, const size_t n, float* out) {
+                   bound.bound_sequence(v, n, alpha, out);
+                 });
+           },
+           R"pbdoc(
+             Float32 bounds for a C-contiguous float32 `v`, each rounded up
+             from the float64 bound.
+           )pbdoc",
+           "v"_a.noconvert(), "alpha"_a);
+
+  pybind11::class_<confseq::MixtureBoundary> mixture_boundary(
+      m, "MixtureBoundary",
+      R"pbdoc(
+        Uniform boundary `(v, alpha) -> bound` backed by a copy of the given
+        mixture supermartingale.
+      )pbdoc");
+  define_mixture_boundary_init<confseq::TwoSidedNormalMixture>(
+      mixture_boundary);
+  define_mixture_boundary_init<confseq::OneSidedNormalMixture>(
+      mixture_boundary);
+  define_mixture_boundary_init<confseq::GammaExponentialMixture>(
+      mixture_boundary);
+  define_mixture_boundary_init<confseq::GammaPoissonMixture>(
+      mixture_boundary);
+  define_mixture_boundary_init<confseq::BetaBinomialMixture>(
+      mixture_boundary);
+  mixture_boundary
+      .def("__call__",
+           pybind11::vectorize(
+               [](const confseq::MixtureBoundary& boundary, const double v,
+                  const double alpha) { return boundary(v, alpha); }),
+           "v"_a, "alpha"_a)
+      .def("bound_sequence",
+           [](const confseq::MixtureBoundary& boundary, const DoubleArray v,
+              const double alpha) {
+             DoubleArray out(v.size());
+             boundary.bound_sequence(v.data(), v.size(), alpha,
+                                     out.mutable_data());
+             return out;
+           },
+           "v"_a, "alpha"_a);
+
+  pybind11::class_<confseq::BoundarySequence> boundary_sequence(
+      m, "BoundarySequence",
+      R"pbdoc(
+        Lazy sequence of the mixture boundary at `v = v_scale * t + v_offset`
+        for `t = 1, ..., size`, with crossing probability `alpha`.
+
+        Indexing entry `i`, at `t = i + 1`, computes and caches the
+        `chunk_size` entries around it, so no array of length `size` is built
+        unless a slice asks for one. Slices return arrays; a contiguous slice
+        does not add to the cache. Iteration discards the chunks behind it,
+        as `discard_before()` does for other access patterns.
+      )pbdoc");
+  define_boundary_sequence_init<confseq::TwoSidedNormalMixture>(
+      boundary_sequence);
+  define_boundary_sequence_init<confseq::OneSidedNormalMixture>(
+      boundary_sequence);
+  define_boundary_sequence_init<confseq::GammaExponentialMixture>(
+      boundary_sequence);
+  define_boundary_sequence_init<confseq::GammaPoissonMixture>(
+      boundary_sequence);
+  define_boundary_sequence_init<confseq::BetaBinomialMixture>(
+      boundary_sequence);
+  boundary_sequence
+      .def("__len__", &confseq::BoundarySequence::size)
+      .def("__getitem__",
+           [](confseq::BoundarySequence& sequence, const pybind11::ssize_t i) {
+             return sequence[i < 0 ? i + sequence.size() : i];
+           },
+           "i"_a)
+      .def("__getitem__",
+           [](confseq::BoundarySequence& sequence,
+              const pybind11::slice slice) {
+             size_t start = 0, stop = 0, step = 0, length = 0;
+             if (!slice.compute(sequence.size(), &start, &stop, &step,
+                                &length)) {
+               throw pybind11::error_already_set();
+             }
+             DoubleArray out(length);
+             double* out_data = out.mutable_data();
+             if (step == 1) {
+               sequence.values(start, start + length, out_data);
+             } else {
+               for (size_t k = 0; k < length; k++, start += step) {
+                 out_data[k] = sequence[start];
+               }
+             }
+             return out;
+           },
+           "slice"_a)
+      .def("__iter__",
+           [](confseq::BoundarySequence& sequence) {
+             return BoundarySequenceIterator{sequence, 0};
+           },
+           pybind11::keep_alive<0, 1>())
+      .def("discard_before", &confseq::BoundarySequence::discard_before,
+           R"pbdoc(
+             Drop cached chunks lying entirely before entry `i`.
+           )pbdoc",
+           "i"_a)
+      .def("v", &confseq::BoundarySequence::v,
+           "Intrinsic time of entry `i`.", "i"_a)
+      .def_property_readonly("alpha", &confseq::BoundarySequence::alpha)
+      .def_property_readonly("chunk_size",
+                             &confseq::BoundarySequence::chunk_size)
+      .def_property_readonly("num_cached_chunks",
+                             &confseq::BoundarySequence::num_cached_chunks);
+  pybind11::class_<BoundarySequenceIterator>(m, "BoundarySequenceIterator")
+      .def("__iter__",
+           [](BoundarySequenceIterator& iterator)
+               -> BoundarySequenceIterator& { return iterator; })
+      .def("__next__", [](BoundarySequenceIterator& iterator) {
+        if (iterator.next >= iterator.sequence.size()) {
+          throw pybind11::stop_iteration();
+        }
+        const double value = iterator.sequence[iterator.next++];
+        iterator.sequence.discard_before(iterator.next);
+        return value;
+      });
+
+  pybind11::class_<confseq::TabulatedBoundary>(
+      m, "TabulatedBoundary",
+      R"pbdoc(
+        Mixture boundary for a fixed `alpha`, precomputed at `num_points`
+        log-spaced values of `v` between `v_min` and `v_max`.
+
+        Lookups return a certified upper envelope of the exact boundary, so the
+        table is never anti-conservative. Tables can be pickled. Saved tables
+        are memory-mapped by `map_file()`, so worker processes mapping the
+        same file share one copy of it.
+      )pbdoc")
+      .def(pybind11::init<const confseq::MixtureSupermartingale&, double,
+                          double, double, size_t>(),
+           "mixture"_a, "alpha"_a, "v_min"_a, "v_max"_a, "num_points"_a=1000)
+      .def("__call__",
+           pybind11::vectorize(
+               [](const confseq::TabulatedBoundary& table, const double v) {
+                 return table(v);
+               }),
+           "v"_a)
+      .def("__call__",
+           [](const confseq::TabulatedBoundary& table,
+              const confseq::Float32Array v) {
+             return confseq::float32_blocks(
+                 v, [&](const float* v, const size_t n, float* out) {
+                   table.bound_sequence(v, n, out);
+                 });
+           },
+           R"pbdoc(
+             Float32 lookups for a C-contiguous float32 `v`, rounded up so
+             they stay above the exact boundary.
+           )pbdoc",
+           "v"_a.noconvert())
+      .def("save",
+           [](const confseq::TabulatedBoundary& table, const std::string path) {
+             std::ofstream out(path, std::ios::binary);
+             table.save(out);
+             if (!out) {
+               throw std::runtime_error("Unable to write " + path);
+             }
+           },
+           "path"_a)
+      .def_static("map_file", &confseq::TabulatedBoundary::map_file, "path"_a)
+      .def_property_readonly("alpha", &confseq::TabulatedBoundary::alpha)
+      .def_property_readonly("v_min", &confseq::TabulatedBoundary::v_min)
+      .def_property_readonly("v_max", &confseq::TabulatedBoundary::v_max)
+      .def(pybind11::pickle(
+          [](const confseq::TabulatedBoundary& table) {
+            std::ostringstream out;
+            table.save(out);
+            return pybind11::make_tuple(pybind11::bytes(out.str()));
+          },
+          [](const pybind11::tuple state) {
+            std::istringstream in(state[0].cast<std::string>());
+            return confseq::TabulatedBoundary::load(in);
+          }));
+
+  pybind11::class_<confseq::BernoulliCSTable>(
+      m, "BernoulliCSTable",
+      R"pbdoc(
+        `bernoulli_confidence_interval()` precomputed for every
+        `num_successes <= num_trials <= n_max`, for fixed `alpha`, `t_opt` and
+        `alpha_opt`. Construction runs across threads. Saved tables are
+        memory-mapped by `map_file()`.
+      )pbdoc")
+      .def(pybind11::init<int, double, double, double>(),
+           "n_max"_a, "alpha"_a, "t_opt"_a, "alpha_opt"_a=0.05)
+      .def("__call__", &bernoulli_cs_table_lookup,
+           R"pbdoc(
+             Return `(lower, upper)` for the given counts, which are broadcast
+             as arrays.
+           )pbdoc",
+           "num_successes"_a, "num_trials"_a)
+      .def("save",
+           [](const confseq::BernoulliCSTable& table, const std::string path) {
+             std::ofstream out(path, std::ios::binary);
+             table.save(out);
+             if (!out) {
+               throw std::runtime_error("Unable to write " + path);
+             }
+           },
+           "path"_a)
+      .def_static("map_file", &confseq::BernoulliCSTable::map_file, "path"_a)
+      .def_property_readonly("n_max", &confseq::BernoulliCSTable::n_max)
+      .def_property_readonly("alpha", &confseq::BernoulliCSTable::alpha)
+      .def_property_readonly("t_opt", &confseq::BernoulliCSTable::t_opt)
+      .def_property_readonly("alpha_opt",
+                             &confseq::BernoulliCSTable::alpha_opt);
+
+  pybind11::class_<confseq::BernoulliConfidenceSequence>(
+      m, "BernoulliConfidenceSequence",
+      R"pbdoc(
+        Streaming form of `bernoulli_confidence_interval()`.
+
+        Observations arrive through `update()`, which re-solves each endpoint
+        from a narrow bracket around its previous value, so that frequent small
+        updates are much cheaper than recomputing the interval. With
+        `running_intersection=True`, the reported interval is the intersection
+        of all intervals so far. Sequences can be pickled, and resume exactly
+        where they left off.
+      )pbdoc")
+      .def(pybind11::init<double, double, double, bool,
+                          const confseq::SolverPrecision&>(),
+           "alpha"_a, "t_opt"_a, "alpha_opt"_a=0.05,
+           "running_intersection"_a=false,
+           "precision"_a=confseq::SolverPrecision())
+      .def("update", &confseq::BernoulliConfidenceSequence::update,
+           R"pbdoc(
+             Add `num_trials` observations summing to `num_successes`, and
+             return the updated `(lower, upper)` interval.
+           )pbdoc",
+           "num_successes"_a, "num_trials"_a)
+      .def_property_readonly("interval",
+                             &confseq::BernoulliConfidenceSequence::interval)
+      .def_property_readonly(
+          "num_successes", &confseq::BernoulliConfidenceSequence::num_successes)
+      .def_property_readonly(
+          "num_trials", &confseq::BernoulliConfidenceSequence::num_trials)
+      .def(confseq::checkpoint_pickle<
+           confseq::BernoulliConfidenceSequence>());
+
+  pybind11::class_<confseq::TwoSampleMeanTest>(
+      m, "TwoSampleMeanTest",
+      R"pbdoc(
+        Sequential test of the difference in means, treatment minus control,
+        of two arms. The k-th observations of the two arms are paired, and
+        each pair updates an always-valid `p_value` for the difference
+        `null_difference` and a confidence sequence `interval` for the
+        difference, at O(1) cost.
+
+        With `mixture="beta_binomial"`, outcomes must lie in
+        `[lower_bd, upper_bd]`, and the paired differences use the
+        beta-binomial mixture of `bernoulli_confidence_interval()` tuned for
+        `t_opt` pairs. With `mixture="gamma_exponential"`, each difference
+        must lie within `c` of the mean of the earlier ones, for instance with
+        `c = 2 * (upper_bd - lower_bd)` for bounded outcomes, and the paired
+        differences use the gamma-exponential mixture with an empirical
+        variance process tuned for `v_opt`, as `conjmix_empbern_cs()` does.
+
+        With `readout_eta > 1`, the interval and p-value are evaluated only
+        when the number of pairs reaches `geometric_readout_times()` with
+        ratio `readout_eta`, or at `readout()`, while the sums take every
+        pair; between readouts `interval` and `p_value` keep their last
+        values.
+      )pbdoc")
+      .def(pybind11::init([](const std::string& mixture, const double alpha,
+                             const double alpha_opt,
+                             const double null_difference,
+                             const bool running_intersection,
+                             const double t_opt, const double lower_bd,
+                             const double upper_bd, const double v_opt,
+                             const double c, const double readout_eta) {
+             return confseq::TwoSampleMeanTest(two_sample_params(
+                 mixture, alpha, alpha_opt, null_difference,
+                 running_intersection, t_opt, lower_bd, upper_bd, v_opt, c,
+                 readout_eta));
+           }),
+           "mixture"_a="beta_binomial", "alpha"_a=0.05, "alpha_opt"_a=0.05,
+           "null_difference"_a=0, "running_intersection"_a=false,
+           "t_opt"_a=100, "lower_bd"_a=0, "upper_bd"_a=1, "v_opt"_a=100,
+           "c"_a=1, "readout_eta"_a=0)
+      .def("update",
+           [](confseq::TwoSampleMeanTest& test, const pybind11::object control,
+              const pybind11::object treatment) {
+             const DoubleArray x = control.is_none()
+                 ? DoubleArray(0) : control.cast<DoubleArray>();
+             const DoubleArray y = treatment.is_none()
+                 ? DoubleArray(0) : treatment.cast<DoubleArray>();
+             return test.update(x.data(), x.size(), y.data(), y.size());
+           },
+           R"pbdoc(
+             Add arrays of control and treatment observations, either of which
+             may be empty, and return the updated `(lower, upper)` interval.
+           )pbdoc",
+           "control"_a=pybind11::none(), "treatment"_a=pybind11::none())
+      .def("readout",
+           &confseq::TwoSampleMeanTest::readout,
+           R"pbdoc(
+             Evaluate the interval and p-value for all pairs so far, if
+             `readout_eta` has left them stale, and return the interval.
+           )pbdoc")
+      .def_property_readonly("interval", &confseq::TwoSampleMeanTest::interval)
+      .def_property_readonly("p_value", &confseq::TwoSampleMeanTest::p_value)
+      .def_property_readonly("estimate", &confseq::TwoSampleMeanTest::estimate)
+      .def_property_readonly("num_pairs",
+                             &confseq::TwoSampleMeanTest::num_pairs)
+      .def_property_readonly("num_control",
+                             &confseq::TwoSampleMeanTest::num_control)
+      .def_property_readonly("num_treatment",
+                             &confseq::TwoSampleMeanTest::num_treatment);
+  m.def("two_sample_mean_tests",
+        &two_sample_mean_tests,
+        R"pbdoc(
+          `TwoSampleMeanTest` over many experiments in one call, spread across
+          threads with the GIL released. Experiment `e` has control
+          observations `control[control_offsets[e]:control_offsets[e + 1]]`
+          and treatment observations likewise. Returns arrays of the final
+          lower and upper confidence bounds and p-values of the experiments,
+          read out after their last pair. Other arguments are as for
+          `TwoSampleMeanTest`; `readout_eta > 1` skips most boundary solves.
+        )pbdoc",
+        "control"_a, "control_offsets"_a, "treatment"_a,
+        "treatment_offsets"_a, "mixture"_a="beta_binomial", "alpha"_a=0.05,
+        "alpha_opt"_a=0.05, "null_difference"_a=0,
+        "running_intersection"_a=false, "t_opt"_a=100, "lower_bd"_a=0,
+        "upper_bd"_a=1, "v_opt"_a=100, "c"_a=1, "readout_eta"_a=0,
+        "num_threads"_a=0);
+  m.def("geometric_readout_times",
+        &confseq::geometric_readout_times,
+        R"pbdoc(
+          List of the observation counts at which to read out a sequence of
+          `n` observations geometrically: each distinct
+          `ceil(first * eta**k)` below `n`, then `n`.
+        )pbdoc",
+        "n"_a, "eta"_a=2, "first"_a=1);
+
+  pybind11::class_<confseq::AverageTreatmentEffectCS>(
+      m, "AverageTreatmentEffectCS",
+      R"pbdoc(
+        Streaming confidence sequence and always-valid p-value for the average
+        treatment effect in a randomized experiment with potential outcomes in
+        `[lower_bd, upper_bd]`, as in `demo/ate_demo.py` (Corollary 2 of the
+        paper). Each unit adds its inverse propensity weighted effect estimate
+        to a running sum at O(1) cost, and every `cadence` units a row is
+        emitted from the gamma-exponential mixture boundary, warm-started from
+        the previous row. Propensities must lie in
+        `[min_propensity, 1 - min_propensity]`; `v_opt` tunes the boundary as
+        for `gamma_exponential_mixture_bound()`. Pass a reduced `precision`
+        for more than about 10^5 rows per second.
+      )pbdoc")
+      .def(pybind11::init([](const double alpha, const double v_opt,
+                             const double lower_bd, const double upper_bd,
+                             const double min_propensity, const size_t cadence,
+                             const double alpha_opt,
+                             const confseq::SolverPrecision& precision) {
+             confseq::AverageTreatmentEffectParams params;
+             params.alpha = alpha;
+             params.alpha_opt = alpha_opt;
+             params.v_opt = v_opt;
+             params.lower_bd = lower_bd;
+             params.upper_bd = upper_bd;
+             params.min_propensity = min_propensity;
+             params.cadence = cadence;
+             params.precision = precision;
+             return confseq::AverageTreatmentEffectCS(params);
+           }),
+           "alpha"_a=0.05, "v_opt"_a=100, "lower_bd"_a=0, "upper_bd"_a=1,
+           "min_propensity"_a=0.5, "cadence"_a=1, "alpha_opt"_a=0.05,
+           "precision"_a=confseq::SolverPrecision())
+      .def("update", &ate_update,
+           R"pbdoc(
+             Add units with outcomes `y`, 0/1 treatment indicators `treatment`
+             and propensities `propensity`, either of which may be a scalar.
+             Predictions of each unit's treated and control outcomes default
+             to the running arm means, and can be given as `y1_prediction` and
+             `y0_prediction`. Returns a dict of arrays `t`, `point_estimate`,
+             `upper_confidence_bound`, `lower_confidence_bound` and `p_value`,
+             one entry per emitted row.
+           )pbdoc",
+           "y"_a, "treatment"_a, "propensity"_a,
+           "y1_prediction"_a=pybind11::none(),
+           "y0_prediction"_a=pybind11::none())
+      .def_property_readonly(
+          "estimate",
+          [](const confseq::AverageTreatmentEffectCS& cs) {
+            return ate_columns({cs.estimate()});
+          },
+          "The row for the units so far, as a dict of length-one arrays.")
+      .def_property_readonly("t", &confseq::AverageTreatmentEffectCS::t);
+
+  pybind11::class_<confseq::SimulatedData>(
+      m, "SimulatedData",
+      R"pbdoc(
+        Distribution of the i.i.d. observations of simulated streams, for
+        `simulate_mixture_crossings()`, `simulate_boundary_crossings()` and
+        `capital_processes.simulate_cs_miscoverage()`. Built by the static
+        methods below; `resample()` and `permutation()` copy `values` and draw
+        from them with and without replacement.
+      )pbdoc")
+      .def_static("bernoulli", &confseq::SimulatedData::bernoulli, "p"_a)
+      .def_static("uniform", &confseq::SimulatedData::uniform, "low"_a=0,
+                  "high"_a=1)
+      .def_static("gaussian", &confseq::SimulatedData::gaussian, "mean"_a=0,
+                  "sd"_a=1)
+      .def_static("resample",
+                  [](const DoubleArray values) {
+                    return confseq::SimulatedData::resample(values.data(),
+                                                            values.size());
+                  },
+                  "values"_a)
+      .def_static("permutation",
+                  [](const DoubleArray values) {
+                    return confseq::SimulatedData::permutation(values.data(),
+                                                               values.size());
+                  },
+                  "values"_a)
+      .def_property_readonly("mean", &confseq::SimulatedData::mean)
+      .def_property_readonly("variance", &confseq::SimulatedData::variance);
+
+  pybind11::class_<confseq::CrossingSimulationResult>(
+      m, "CrossingSimulationResult",
+      R"pbdoc(
+        Outcome of a crossing simulation: the number of `replicates` and of
+        `crossings`, their ratio `crossing_fraction` with its Monte Carlo
+        `standard_error`, and `crossing_times`, the number of observations at
+        each replicate's first crossing, or 0 where it never crossed.
+      )pbdoc")
+      .def_readonly("replicates",
+                    &confseq::CrossingSimulationResult::replicates)
+      .def_readonly("crossings", &confseq::CrossingSimulationResult::crossings)
+      .def_property_readonly(
+          "crossing_fraction",
+          &confseq::CrossingSimulationResult::crossing_fraction)
+      .def_property_readonly(
+          "standard_error", &confseq::CrossingSimulationResult::standard_error)
+      .def_property_readonly(
+          "crossing_times",
+          [](const confseq::CrossingSimulationResult& result) {
+            return pybind11::array_t<size_t>(result.crossing_times.size(),
+                                             result.crossing_times.data());
+          });
+
+  m.def("simulate_mixture_crossings",
+        &simulate_mixture_crossings,
+        R"pbdoc(
+          `misc.superMG_crossing_fraction()` natively: simulate `replicates`
+          streams of up to `horizon` observations from the `SimulatedData`
+          `data`, with S_t the sum of the observations less `data.mean` and
+          V_t = t * `v_per_observation` (by default `data.variance`), and
+          return a `CrossingSimulationResult` for the event that the
+          supermartingale of `mixture` exceeds 1 / `alpha`. Replicates run
+          across threads with the GIL released and stop at their first
+          crossing. Replicate r draws from stream r of a counter-based
+          generator keyed by `seed`, so results do not depend on the number
+          of threads.
+        )pbdoc",
+        "mixture"_a, "data"_a, "alpha"_a, "horizon"_a, "replicates"_a,
+        "v_per_observation"_a=pybind11::none(), "seed"_a=0,
+        "num_threads"_a=0);
+  m.def("simulate_boundary_crossings",
+        &simulate_boundary_crossings,
+        R"pbdoc(
+          As `simulate_mixture_crossings()`, for the event that S_t, or |S_t|
+          if `two_sided`, exceeds `boundary`, a `PolyStitchingBound` or
+          `MixtureBoundary` evaluated at `alpha`, or a `TabulatedBoundary`
+          with its own alpha. The boundary is evaluated once per time before
+          the replicates run.
+        )pbdoc",
+        "boundary"_a, "data"_a, "horizon"_a, "replicates"_a,
+        "alpha"_a=pybind11::none(), "v_per_observation"_a=pybind11::none(),
+        "two_sided"_a=false, "seed"_a=0, "num_threads"_a=0);
+
+  m.def("mixture_first_crossings",
+        &mixture_first_crossings,
+        R"pbdoc(
+          For streams of martingale values `s` and intrinsic times `v` held
+          back to back, stream `k` being `s[offsets[k]:offsets[k + 1]]`, the
+          first time the always-valid p-value of `mixture`, the running
+          minimum of `mixture.p_value()`, falls to `alpha` or below. Returns a
+          tuple of the times, 0 for streams that never cross, and the
+          p-values then, or after the last value. Each stream is evaluated in
+          growing blocks and stops at its crossing; streams run across threads
+          with the GIL released.
+        )pbdoc",
+        "mixture"_a, "s"_a, "v"_a, "offsets"_a, "alpha"_a=0.05,
+        "num_threads"_a=0);
+  m.def("tune_mixture",
+        &tune_mixture,
+        R"pbdoc(
+          Score each mixture in `mixtures`, typically one mixture type
+          constructed over a grid of v_opt, alpha_opt or t_opt, by the sum of
+          its boundary at level `alpha` over the intrinsic times `v`, weighted
+          by `weights` (by default 1 / len(v) each), for example the
+          probability of stopping at each v under a prior. Returns
+          (best_index, losses, bounds): the index of the smallest loss, or
+          None if every loss is NaN, the loss of each mixture and a
+          len(mixtures) x len(v) array of boundary values. Mixtures and blocks
+          of v run across threads with the GIL released, and boundary roots
+          are warm-started along v.
+        )pbdoc",
+        "mixtures"_a, "v"_a, "weights"_a=pybind11::none(), "alpha"_a=0.05,
+        "num_threads"_a=0);
+
+  pybind11::class_<confseq::EBHProcedure>(
+      m, "EBHProcedure",
+      R"pbdoc(
+        The e-BH procedure over `num_tests` sequential tests, controlling the
+        false discovery rate at `alpha` under any dependence. Each tick,
+        pass the log e-values of the tests that changed, for instance a
+        mixture's `log_superMG` at their current (s, v), to `update()` or
+        `update_from_mixture()`; the rejections are then updated in time
+        linear in `num_tests` without sorting. All e-values start at 1.
+      )pbdoc")
+      .def(pybind11::init<size_t, double>(), "num_tests"_a, "alpha"_a)
+      .def("update",
+           [](confseq::EBHProcedure& procedure, const DoubleArray log_e_values,
+              const pybind11::object indices) {
+             if (indices.is_none()) {
+               if (size_t(log_e_values.size()) != procedure.num_tests()) {
+                 throw pybind11::value_error(
+                     "log_e_values must have one entry per test");
+               }
+               procedure.update_all(log_e_values.data());
+               return procedure.num_rejections();
+             }
+             const SizeArray index_array = indices.cast<SizeArray>();
+             if (index_array.size() != log_e_values.size()) {
+               throw pybind11::value_error(
+                   "indices and log_e_values must match");
+             }
+             procedure.update(index_array.data(), log_e_values.data(),
+                              log_e_values.size());
+             return procedure.num_rejections();
+           },
+           R"pbdoc(
+             Set the log e-values of the tests `indices`, or of every test if
+             None, and return the number of rejections.
+           )pbdoc",
+           "log_e_values"_a, "indices"_a=pybind11::none())
+      .def("update_from_mixture",
+           [](confseq::EBHProcedure& procedure,
+              const confseq::MixtureSupermartingale& mixture,
+              const DoubleArray s, const DoubleArray v,
+              const pybind11::object indices) {
+             if (s.size() != v.size()) {
+               throw pybind11::value_error("s and v must match");
+             }
+             SizeArray index_array;
+             if (!indices.is_none()) {
+               index_array = indices.cast<SizeArray>();
+               if (index_array.size() != s.size()) {
+                 throw pybind11::value_error("indices and s must match");
+               }
+             }
+             const size_t* index_data =
+                 indices.is_none() ? nullptr : index_array.data();
+             {
+               pybind11::gil_scoped_release release;
+               procedure.update_from_mixture(mixture, index_data, s.data(),
+                                             v.data(), s.size());
+             }
+             return procedure.num_rejections();
+           },
+           R"pbdoc(
+             As `update()` with log e-values `mixture.log_superMG(s, v)`,
+             evaluated natively across threads with the GIL released.
+           )pbdoc",
+           "mixture"_a, "s"_a, "v"_a, "indices"_a=pybind11::none())
+      .def("rejections",
+           [](const confseq::EBHProcedure& procedure) {
+             pybind11::array_t<bool> out(procedure.num_tests());
+             procedure.rejections(out.mutable_data());
+             return out;
+           },
+           "Return a boolean array of the rejected tests.")
+      .def_property_readonly("num_rejections",
+                             &confseq::EBHProcedure::num_rejections)
+      .def_property_readonly("num_tests", &confseq::EBHProcedure::num_tests)
+      .def_property_readonly("alpha", &confseq::EBHProcedure::alpha)
+      .def_property_readonly(
+          "log_e_values", [](const confseq::EBHProcedure& procedure) {
+            DoubleArray out(procedure.num_tests());
+            for (size_t i = 0; i < procedure.num_tests(); i++) {
+              out.mutable_data()[i] = procedure.log_e_value(i);
+            }
+            return out;
+          });
+
+  pybind11::class_<confseq::RefreshScheduler>(
+      m, "RefreshScheduler",
+      R"pbdoc(
+        Chooses which of `num_tests` sequential tests to refresh when there is
+        no time to recompute all of them each tick. Tests are refreshed in
+        decreasing `priority()`, a prediction of how far each test's
+        log_superMG is from `log(1 / alpha)` at its current intrinsic time,
+        so the work goes to tests near rejection. Deferred tests keep their
+        last readout, which is stale but still valid since the boundaries
+        hold uniformly over time. Rejected tests are not refreshed again.
+      )pbdoc")
+      .def(pybind11::init<size_t, double>(), "num_tests"_a, "alpha"_a)
+      .def("observe",
+           [](confseq::RefreshScheduler& scheduler, const SizeArray tests,
+              const DoubleArray v) {
+             if (tests.size() != v.size()) {
+               throw pybind11::value_error("tests and v must match");
+             }
+             for (pybind11::ssize_t j = 0; j < tests.size(); j++) {
+               scheduler.observe(tests.data()[j], v.data()[j]);
+             }
+           },
+           "Record that the intrinsic time of each of `tests` reached `v`.",
+           "tests"_a, "v"_a)
+      .def("record_refresh", &confseq::RefreshScheduler::record_refresh,
+           "Record the log_superMG of `test` at intrinsic time `v`.",
+           "test"_a, "log_superMG"_a, "v"_a)
+      .def("priority", &confseq::RefreshScheduler::priority, "test"_a)
+      .def("run",
+           [](confseq::RefreshScheduler& scheduler,
+              const pybind11::function refresh,
+              const pybind11::object budget_seconds) {
+             std::chrono::steady_clock::time_point deadline{};
+             if (!budget_seconds.is_none()) {
+               deadline = std::chrono::steady_clock::now()
+                   + std::chrono::duration_cast<
+                         std::chrono::steady_clock::duration>(
+                       std::chrono::duration<double>(
+                           budget_seconds.cast<double>()));
+             }
+             return scheduler.run(
+                 [&refresh](const size_t test) {
+                   return refresh(test).cast<std::pair<double, double>>();
+                 },
+                 deadline);
+           },
+           R"pbdoc(
+             Call `refresh(test)`, which returns the test's current
+             `(log_superMG, v)`, on the stale tests in decreasing priority
+             until none is left or `budget_seconds` have passed, and return
+             how many were refreshed.
+           )pbdoc",
+           "refresh"_a, "budget_seconds"_a=pybind11::none())
+      .def("stale", &confseq::RefreshScheduler::stale, "test"_a)
+      .def("rejected", &confseq::RefreshScheduler::rejected, "test"_a)
+      .def("log_superMG", &confseq::RefreshScheduler::log_superMG, "test"_a)
+      .def("refreshed_v", &confseq::RefreshScheduler::refreshed_v, "test"_a)
+      .def_property_readonly("num_tests",
+                             &confseq::RefreshScheduler::num_tests)
+      .def_property_readonly("alpha", &confseq::RefreshScheduler::alpha);
+
+  pybind11::class_<confseq::MixtureSufficientStatistics>(
+      m, "MixtureSufficientStatistics",
+      R"pbdoc(
+        Running S_t and V_t of a mixture test, and the number of observations
+        behind them, computed on separate shards of a stream and combined
+        with `merge()`. The normal, gamma-exponential, gamma-Poisson and
+        beta-binomial mixtures depend on the data only through S_t and V_t,
+        so the merged state gives the same p-values and bounds as the pooled
+        data. `to_bytes()` and `from_bytes()` give a compact 40-byte wire
+        format, which is also used for pickling.
+      )pbdoc")
+      .def(pybind11::init<double, double, uint64_t>(), "s"_a=0, "v"_a=0,
+           "num_observations"_a=0)
+      .def("add",
+           [](confseq::MixtureSufficientStatistics& stats,
+              const DoubleArray s_increments, const DoubleArray v_increments) {
+             if (s_increments.size() != v_increments.size()) {
+               throw pybind11::value_error(
+                   "s_increments and v_increments must match");
+             }
+             stats.add(s_increments.data(), v_increments.data(),
+                       s_increments.size());
+           },
+           R"pbdoc(
+             Add observations with the given increments of S_t and V_t,
+             scalars for one observation or arrays for several.
+           )pbdoc",
+           "s_increments"_a, "v_increments"_a)
+      .def("merge", &confseq::MixtureSufficientStatistics::merge,
+           "Add the observations of another state.", "other"_a)
+      .def("log_superMG", &confseq::MixtureSufficientStatistics::log_superMG,
+           "mixture"_a)
+      .def("p_value", &confseq::MixtureSufficientStatistics::p_value,
+           "mixture"_a)
+      .def("bound", &confseq::MixtureSufficientStatistics::bound,
+           "Evaluate the `MixtureBoundary` at the merged V_t.",
+           "boundary"_a, "alpha"_a)
+      .def("to_bytes",
+           [](const confseq::MixtureSufficientStatistics& stats) {
+             std::ostringstream out;
+             stats.save(out);
+             return pybind11::bytes(out.str());
+           })
+      .def_static("from_bytes",
+                  [](const std::string& data) {
+                    std::istringstream in(data);
+                    return confseq::MixtureSufficientStatistics::load(in);
+                  },
+                  "data"_a)
+      .def_property_readonly("s", &confseq::MixtureSufficientStatistics::s)
+      .def_property_readonly("v", &confseq::MixtureSufficientStatistics::v)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::MixtureSufficientStatistics::num_observations)
+      .def(confseq::checkpoint_pickle<confseq::MixtureSufficientStatistics>());
+
+  pybind11::class_<confseq::KeyedBernoulliCS> keyed_bernoulli_cs(
+      m, "KeyedBernoulliCS",
+      R"pbdoc(
+        `bernoulli_confidence_interval()` for the 0/1 observations of many
+        streams keyed by uint64, such as one per user, in a native hash table
+        at 16 bytes per key.
+
+        Intervals come from a `BernoulliCSTable` for keys with at most `n_max`
+        observations, or from the given `table`, and are solved beyond it. No
+        running intersection is kept. `save()` and `load()` spill the store
+        to disk and back; `load()` rebuilds the table of `n_max`.
+      )pbdoc");
+  keyed_bernoulli_cs
+      .def(pybind11::init<double, double, double, int, size_t>(),
+           "alpha"_a, "t_opt"_a, "alpha_opt"_a=0.05, "n_max"_a=0,
+           "capacity"_a=0)
+      .def(pybind11::init<const confseq::BernoulliCSTable&, size_t>(),
+           "table"_a, "capacity"_a=0);
+  define_keyed_store_methods(keyed_bernoulli_cs);
+
+  pybind11::class_<confseq::KeyedConjmixEmpBernCS> keyed_conjmix_empbern_cs(
+      m, "KeyedConjmixEmpBernCS",
+      R"pbdoc(
+        `ConjmixEmpBernAccumulator` for the observations in [0, 1] of many
+        streams keyed by uint64, in a native hash table at 32 bytes per key.
+
+        Queries read the boundary from a `TabulatedBoundary`, built for
+        `v_opt`, `alpha` and `side` up to `v_max`, or passed in as `boundary`
+        at the per-side level, so intervals match the accumulator's up to the
+        table's upper envelope and are never narrower. No running
+        intersection is kept. `save()` and `load()` spill the store, with its
+        table, to disk and back.
+      )pbdoc");
+  keyed_conjmix_empbern_cs
+      .def(pybind11::init([](const double v_opt, const double alpha,
+                             const std::string& side, const double v_max,
+                             const size_t num_points, const size_t capacity) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             if (!(v_opt > 0 && v_max > 1e-2 && num_points >= 2)) {
+               throw pybind11::value_error(
+                   "v_opt must be positive, v_max above 0.01 and num_points "
+                   "at least 2");
+             }
+             return confseq::KeyedConjmixEmpBernCS(
+                 v_opt, alpha, confseq::cs_side(side), v_max, num_points,
+                 capacity);
+           }),
+           "v_opt"_a, "alpha"_a=0.05, "side"_a="both", "v_max"_a=1e7,
+           "num_points"_a=1000, "capacity"_a=0)
+      .def(pybind11::init([](const confseq::TabulatedBoundary& boundary,
+                             const std::string& side, const size_t capacity) {
+             return confseq::KeyedConjmixEmpBernCS(
+                 boundary, confseq::cs_side(side), capacity);
+           }),
+           "boundary"_a, "side"_a="both", "capacity"_a=0)
+      .def_property_readonly("boundary",
+                             &confseq::KeyedConjmixEmpBernCS::boundary);
+  define_keyed_store_methods(keyed_conjmix_empbern_cs);
 }
+
@@ -0,0 +1,1786 @@
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "parallel_vectorize.h"
+#include "uniform_boundaries.h"
+
+using namespace pybind11::literals;
+
+using DoubleArray = pybind11::array_t<
+    double, pybind11::array::c_style | pybind11::array::forcecast>;
+
+confseq::BettingOptions betting_options(
+    const double N, const bool convex_comb, const double theta,
+    const double trunc_scale, const bool m_trunc,
+    const bool cap_negative_bets_at_m, const bool log_space,
+    const double max_weight=1) {
+  if (!(0 < trunc_scale && trunc_scale <= 1)) {
+    throw pybind11::value_error("trunc_scale must be in (0, 1]");
+  }
+  if (!(max_weight >= 1)) {
+    throw pybind11::value_error("max_weight must be at least 1");
+  }
+  if (max_weight != 1 && N > 0) {
+    throw pybind11::value_error(
+        "Importance weights require sampling with replacement");
+  }
+  confseq::BettingOptions options;
+  options.N = N;
+  options.convex_comb = convex_comb;
+  options.theta = theta;
+  options.trunc_scale = trunc_scale;
+  options.m_trunc = m_trunc;
+  options.cap_negative_bets_at_m = cap_negative_bets_at_m;
+  options.log_space = log_space;
+  options.max_weight = max_weight;
+  return options;
+}
+
+// x * weights, the importance-weighted outcomes, or x if weights is None.
+DoubleArray weighted_observations(const DoubleArray x,
+                                  const pybind11::object weights) {
+  if (weights.is_none()) {
+    return x;
+  }
+  const DoubleArray weight_array = weights.cast<DoubleArray>();
+  if (weight_array.size() != x.size()) {
+    throw pybind11::value_error("weights must have the same length as x");
+  }
+  DoubleArray out(x.size());
+  for (pybind11::ssize_t i = 0; i < x.size(); i++) {
+    out.mutable_data()[i] = x.data()[i] * weight_array.data()[i];
+  }
+  return out;
+}
+
+DoubleArray betting_capital_process(
+    const DoubleArray x, const double m, const DoubleArray lambdas_positive,
+    const DoubleArray lambdas_negative, const double N=0,
+    const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const double max_weight=1) {
+  if (lambdas_positive.size() != x.size()
+      || lambdas_negative.size() != x.size()) {
+    throw pybind11::value_error("bets must have the same length as x");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space,
+      max_weight);
+  DoubleArray capital(x.size());
+  const double* x_data = x.data();
+  const double* positive_data = lambdas_positive.data();
+  const double* negative_data = lambdas_negative.data();
+  double* capital_data = capital.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::betting_capital_process(x_data, x.size(), m, positive_data,
+                                     negative_data, options, capital_data);
+  }
+  return capital;
+}
+
+pybind11::tuple betting_grid_accepted_range(
+    const DoubleArray x, const DoubleArray grid,
+    const DoubleArray lambdas_positive, const DoubleArray lambdas_negative,
+    const double threshold, const double N=0, const bool convex_comb=false,
+    const double theta=0.5, const double trunc_scale=0.5,
+    const bool m_trunc=true, const bool cap_negative_bets_at_m=false,
+    const bool log_space=false, const int num_threads=0) {
+  if (lambdas_positive.size() != x.size()
+      || lambdas_negative.size() != x.size()) {
+    throw pybind11::value_error("bets must have the same length as x");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, cap_negative_bets_at_m,
+      log_space);
+  pybind11::array_t<int> first(x.size()), last(x.size());
+  const double* x_data = x.data();
+  const double* grid_data = grid.data();
+  const double* positive_data = lambdas_positive.data();
+  const double* negative_data = lambdas_negative.data();
+  int* first_data = first.mutable_data();
+  int* last_data = last.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::betting_grid_accepted_range(
+        x_data, x.size(), grid_data, grid.size(), positive_data,
+        negative_data, options, threshold, first_data, last_data,
+        num_threads);
+  }
+  return pybind11::make_tuple(first, last);
+}
+
+pybind11::array_t<size_t> betting_first_rejections(
+    const DoubleArray x, const DoubleArray nulls,
+    const DoubleArray lambdas_positive, const DoubleArray lambdas_negative,
+    const double threshold, const double N=0, const bool convex_comb=false,
+    const double theta=0.5, const double trunc_scale=0.5,
+    const bool m_trunc=true, const bool cap_negative_bets_at_m=false,
+    const bool log_space=false, const int num_threads=0) {
+  if (lambdas_positive.size() != x.size()
+      || lambdas_negative.size() != x.size()) {
+    throw pybind11::value_error("bets must have the same length as x");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, cap_negative_bets_at_m,
+      log_space);
+  pybind11::array_t<size_t> times(nulls.size());
+  const double* x_data = x.data();
+  const double* nulls_data = nulls.data();
+  const double* positive_data = lambdas_positive.data();
+  const double* negative_data = lambdas_negative.data();
+  size_t* times_data = times.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::betting_first_rejections(
+        x_data, x.size(), nulls_data, nulls.size(), positive_data,
+        negative_data, options, threshold, times_data, num_threads);
+  }
+  return times;
+}
+
+pybind11::tuple betting_grid_cs(
+    const DoubleArray x, const int breaks, const DoubleArray lambdas_positive,
+    const DoubleArray lambdas_negative, const double threshold,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool cap_negative_bets_at_m=false, const bool log_space=false,
+    const bool running_intersection=false, const int num_threads=0) {
+  if (lambdas_positive.size() != x.size()
+      || lambdas_negative.size() != x.size()) {
+    throw pybind11::value_error("bets must have the same length as x");
+  }
+  if (breaks <= 0) {
+    throw pybind11::value_error("breaks must be positive");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, cap_negative_bets_at_m,
+      log_space);
+  DoubleArray lower(x.size()), upper(x.size());
+  const double* x_data = x.data();
+  const double* positive_data = lambdas_positive.data();
+  const double* negative_data = lambdas_negative.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::betting_grid_cs(x_data, x.size(), breaks, positive_data,
+                             negative_data, options, threshold,
+                             running_intersection, lower_data, upper_data,
+                             num_threads);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+pybind11::tuple accepted_range_cs(
+    const DoubleArray x, const int breaks,
+    const pybind11::array_t<int, pybind11::array::c_style
+                                | pybind11::array::forcecast> first_accepted,
+    const pybind11::array_t<int, pybind11::array::c_style
+                                | pybind11::array::forcecast> last_accepted,
+    const double N=0, const bool running_intersection=false) {
+  if (first_accepted.size() != x.size() || last_accepted.size() != x.size()) {
+    throw pybind11::value_error(
+        "accepted ranges must have the same length as x");
+  }
+  if (breaks <= 0) {
+    throw pybind11::value_error("breaks must be positive");
+  }
+  const std::vector<double> grid = confseq::betting_grid(breaks);
+  const int grid_size = grid.size();
+  for (size_t t = 0; t < size_t(x.size()); t++) {
+    if (first_accepted.data()[t] >= grid_size
+        || last_accepted.data()[t] >= grid_size) {
+      throw pybind11::value_error("accepted indices must be in the grid");
+    }
+  }
+  DoubleArray lower(x.size()), upper(x.size());
+  confseq::accepted_range_cs(x.data(), x.size(), grid.data(), breaks,
+                             first_accepted.data(), last_accepted.data(), N,
+                             running_intersection, lower.mutable_data(),
+                             upper.mutable_data());
+  return pybind11::make_tuple(lower, upper);
+}
+
+pybind11::tuple intersect_cs(const DoubleArray x, const DoubleArray lower,
+                             const DoubleArray upper, const double N=0,
+                             const bool running_intersection=false) {
+  if (lower.size() != x.size() || upper.size() != x.size()) {
+    throw pybind11::value_error("bounds must have the same length as x");
+  }
+  DoubleArray intersected_lower(x.size()), intersected_upper(x.size());
+  double* lower_data = intersected_lower.mutable_data();
+  double* upper_data = intersected_upper.mutable_data();
+  std::copy(lower.data(), lower.data() + x.size(), lower_data);
+  std::copy(upper.data(), upper.data() + x.size(), upper_data);
+  confseq::intersect_cs(x.data(), x.size(), N, running_intersection,
+                        lower_data, upper_data);
+  return pybind11::make_tuple(intersected_lower, intersected_upper);
+}
+
+pybind11::tuple betting_cs_bisection(
+    const DoubleArray x, const DoubleArray lambdas_positive,
+    const DoubleArray lambdas_negative, const double threshold,
+    const double tolerance, const double N=0, const bool convex_comb=false,
+    const double theta=0.5, const double trunc_scale=0.5,
+    const bool m_trunc=true, const bool cap_negative_bets_at_m=false,
+    const bool log_space=false) {
+  if (lambdas_positive.size() != x.size()
+      || lambdas_negative.size() != x.size()) {
+    throw pybind11::value_error("bets must have the same length as x");
+  }
+  if (!(tolerance > 0)) {
+    throw pybind11::value_error("tolerance must be positive");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, cap_negative_bets_at_m,
+      log_space);
+  DoubleArray lower(x.size()), upper(x.size());
+  const double* x_data = x.data();
+  const double* positive_data = lambdas_positive.data();
+  const double* negative_data = lambdas_negative.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::betting_cs_bisection(x_data, x.size(), positive_data,
+                                  negative_data, options, threshold,
+                                  tolerance, lower_data, upper_data);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+using StrategyList = std::vector<confseq::BettingStrategyParams>;
+
+void check_strategies(const StrategyList& strategies_positive,
+                      const StrategyList& strategies_negative,
+                      const std::vector<double>& weights) {
+  if (strategies_negative.size() != strategies_positive.size()
+      || weights.size() != strategies_positive.size()) {
+    throw pybind11::value_error(
+        "strategies and weights must have the same length");
+  }
+}
+
+// Computes each strategy's statistics once for all null means.
+std::vector<confseq::BettingStrategy> make_strategies(
+    const double* x, const size_t n, const StrategyList& strategies,
+    const double N) {
+  std::vector<confseq::BettingStrategy> native;
+  for (const confseq::BettingStrategyParams& params : strategies) {
+    native.emplace_back(x, n, params, N);
+  }
+  return native;
+}
+
+DoubleArray betting_strategy_bets(
+    const DoubleArray x, const double m,
+    const confseq::BettingStrategyParams& strategy, const bool negative=false,
+    const double N=0) {
+  DoubleArray bets(x.size());
+  const double* x_data = x.data();
+  double* bets_data = bets.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    const confseq::BettingStrategy native(x_data, x.size(), strategy, N);
+    for (size_t i = 0; i < size_t(x.size()); i++) {
+      bets_data[i] = native.bet(i, m, negative);
+    }
+  }
+  return bets;
+}
+
+DoubleArray kelly_bets(const DoubleArray x, const double m) {
+  DoubleArray bets(x.size());
+  const double* x_data = x.data();
+  double* bets_data = bets.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::kelly_bets(x_data, x.size(), m, bets_data);
+  }
+  return bets;
+}
+
+DoubleArray diversified_betting_capital_process(
+    const DoubleArray x, const double m,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const double N=0,
+    const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const double max_weight=1) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space,
+      max_weight);
+  DoubleArray capital(x.size());
+  const double* x_data = x.data();
+  double* capital_data = capital.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::diversified_betting_capital_process(
+        x_data, x.size(), m,
+        make_strategies(x_data, x.size(), strategies_positive, N),
+        make_strategies(x_data, x.size(), strategies_negative, N), weights,
+        options, capital_data);
+  }
+  return capital;
+}
+
+pybind11::tuple diversified_betting_grid_accepted_range(
+    const DoubleArray x, const DoubleArray grid,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const double threshold,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const int num_threads=0) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space);
+  pybind11::array_t<int> first(x.size()), last(x.size());
+  const double* x_data = x.data();
+  const double* grid_data = grid.data();
+  int* first_data = first.mutable_data();
+  int* last_data = last.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::diversified_betting_grid_accepted_range(
+        x_data, x.size(), grid_data, grid.size(),
+        make_strategies(x_data, x.size(), strategies_positive, N),
+        make_strategies(x_data, x.size(), strategies_negative, N), weights,
+        options, threshold, first_data, last_data, num_threads);
+  }
+  return pybind11::make_tuple(first, last);
+}
+
+pybind11::tuple diversified_betting_grid_cs(
+    const DoubleArray x, const int breaks,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const double threshold,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const bool running_intersection=false,
+    const int num_threads=0, const double max_weight=1) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  if (breaks <= 0) {
+    throw pybind11::value_error("breaks must be positive");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space,
+      max_weight);
+  DoubleArray lower(x.size()), upper(x.size());
+  const double* x_data = x.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::diversified_betting_grid_cs(
+        x_data, x.size(), breaks,
+        make_strategies(x_data, x.size(), strategies_positive, N),
+        make_strategies(x_data, x.size(), strategies_negative, N), weights,
+        options, threshold, running_intersection, lower_data, upper_data,
+        num_threads);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+pybind11::tuple diversified_betting_grid_cs_thresholds(
+    const DoubleArray x, const int breaks,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const DoubleArray thresholds,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const bool running_intersection=false,
+    const int num_threads=0, const double max_weight=1) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  if (breaks <= 0) {
+    throw pybind11::value_error("breaks must be positive");
+  }
+  if (thresholds.ndim() != 1) {
+    throw pybind11::value_error("thresholds must be 1-D");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space,
+      max_weight);
+  const size_t num_thresholds = thresholds.size();
+  const std::vector<pybind11::ssize_t> shape{
+      pybind11::ssize_t(num_thresholds), pybind11::ssize_t(x.size())};
+  DoubleArray lower(shape), upper(shape);
+  const double* x_data = x.data();
+  const double* thresholds_data = thresholds.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::diversified_betting_grid_cs(
+        x_data, x.size(), breaks,
+        make_strategies(x_data, x.size(), strategies_positive, N),
+        make_strategies(x_data, x.size(), strategies_negative, N), weights,
+        options, thresholds_data, num_thresholds, running_intersection,
+        lower_data, upper_data, num_threads);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+pybind11::tuple diversified_betting_pruned_grid_cs(
+    const DoubleArray x, const int breaks,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const double threshold,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const int num_threads=0,
+    const double max_weight=1) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  if (breaks <= 0) {
+    throw pybind11::value_error("breaks must be positive");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space,
+      max_weight);
+  DoubleArray lower(x.size()), upper(x.size());
+  const double* x_data = x.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::diversified_betting_pruned_grid_cs(
+        x_data, x.size(), breaks,
+        make_strategies(x_data, x.size(), strategies_positive, N),
+        make_strategies(x_data, x.size(), strategies_negative, N), weights,
+        options, threshold, lower_data, upper_data, num_threads);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+pybind11::array_t<size_t> diversified_betting_first_rejections(
+    const DoubleArray x, const DoubleArray nulls,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const double threshold,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool log_space=false, const int num_threads=0,
+    const double max_weight=1) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, log_space,
+      max_weight);
+  pybind11::array_t<size_t> times(nulls.size());
+  const double* x_data = x.data();
+  const double* nulls_data = nulls.data();
+  size_t* times_data = times.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::diversified_betting_first_rejections(
+        x_data, x.size(), nulls_data, nulls.size(),
+        make_strategies(x_data, x.size(), strategies_positive, N),
+        make_strategies(x_data, x.size(), strategies_negative, N), weights,
+        options, threshold, times_data, num_threads);
+  }
+  return times;
+}
+
+pybind11::tuple diversified_betting_ci_sequence(
+    const DoubleArray x, const std::vector<size_t>& times, const int breaks,
+    const StrategyList& strategies_positive,
+    const StrategyList& strategies_negative,
+    const std::vector<double>& weights, const double threshold,
+    const double N=0, const bool convex_comb=false, const double theta=0.5,
+    const double trunc_scale=0.5, const bool m_trunc=true,
+    const bool running_intersection=true, const int num_threads=0) {
+  check_strategies(strategies_positive, strategies_negative, weights);
+  for (const size_t time : times) {
+    if (time == 0 || time > size_t(x.size())) {
+      throw pybind11::value_error("times must be in [1, len(x)]");
+    }
+  }
+  if (breaks <= 0) {
+    throw pybind11::value_error("breaks must be positive");
+  }
+  const confseq::BettingOptions options = betting_options(
+      N, convex_comb, theta, trunc_scale, m_trunc, false, true);
+  DoubleArray lower(times.size()), upper(times.size());
+  const double* x_data = x.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    const size_t n = times.empty()
+        ? 0 : *std::max_element(times.begin(), times.end());
+    confseq::diversified_betting_ci_sequence(
+        x_data, times.data(), times.size(), breaks,
+        make_strategies(x_data, n, strategies_positive, N),
+        make_strategies(x_data, n, strategies_negative, N), weights, options,
+        threshold, running_intersection, lower_data, upper_data, num_threads);
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+using OffsetArray = pybind11::array_t<
+    size_t, pybind11::array::c_style | pybind11::array::forcecast>;
+
+void check_offsets(const OffsetArray& offsets, const size_t num_values) {
+  if (offsets.size() == 0 || offsets.data()[0] != 0
+      || offsets.data()[offsets.size() - 1] != num_values) {
+    throw pybind11::value_error(
+        "offsets must run from 0 to the number of values");
+  }
+  for (size_t s = 1; s < size_t(offsets.size()); s++) {
+    if (offsets.data()[s] < offsets.data()[s - 1]) {
+      throw pybind11::value_error("offsets must be nondecreasing");
+    }
+  }
+}
+
+// StreamCSParams for num_streams streams. sizes holds population_sizes, if
+// given, and must outlive the params.
+confseq::StreamCSParams stream_cs_params(
+    const std::string& cs, const double alpha, const bool running_intersection,
+    const double truncation, const double fixed_n, const double t_opt,
+    const double v_opt, const double N, const pybind11::object population_sizes,
+    const size_t num_streams, const double lower_bd, const double upper_bd,
+    const int breaks, const double theta, const double trunc_scale,
+    const std::string& side, DoubleArray& sizes) {
+  confseq::StreamCSParams params;
+  params.kind = confseq::stream_cs_kind(cs);
+  params.alpha = alpha;
+  params.running_intersection = running_intersection;
+  params.side = confseq::cs_side(side);
+  params.truncation = truncation;
+  params.fixed_n = fixed_n;
+  params.t_opt = t_opt;
+  params.v_opt = v_opt;
+  params.N = N;
+  if (!population_sizes.is_none()) {
+    sizes = population_sizes.cast<DoubleArray>();
+    if (size_t(sizes.size()) != num_streams) {
+      throw pybind11::value_error(
+          "population_sizes must have one entry per stream");
+    }
+    params.population_sizes = sizes.data();
+  }
+  params.lower_bd = lower_bd;
+  params.upper_bd = upper_bd;
+  params.breaks = breaks;
+  params.theta = theta;
+  params.trunc_scale = trunc_scale;
+  return params;
+}
+
+// The confseq::BoundsSink for a sink argument: a callable, called as
+// sink(offset, lower, upper) with the arrays of each block, or a path for a
+// confseq::BoundsFileSink of num_rows rows.
+std::unique_ptr<confseq::BoundsSink> bounds_sink(const pybind11::object& sink,
+                                                 const size_t num_rows) {
+  if (!PyCallable_Check(sink.ptr())) {
+    const std::string path = pybind11::str(
+        pybind11::module::import("os").attr("fspath")(sink));
+    return std::unique_ptr<confseq::BoundsSink>(
+        new confseq::BoundsFileSink(path, num_rows));
+  }
+  const pybind11::function callback = sink.cast<pybind11::function>();
+  return std::unique_ptr<confseq::BoundsSink>(new confseq::CallbackBoundsSink(
+      [callback](const size_t offset, const double* lower,
+                 const double* upper, const size_t n) {
+        pybind11::gil_scoped_acquire acquire;
+        callback(offset, DoubleArray(n, lower), DoubleArray(n, upper));
+      }));
+}
+
+pybind11::object batch_confidence_sequences(
+    const DoubleArray values, const OffsetArray offsets, const std::string& cs,
+    const double alpha, const bool running_intersection,
+    const double truncation, const double fixed_n, const double t_opt,
+    const double v_opt, const double N, const pybind11::object population_sizes,
+    const double lower_bd, const double upper_bd, const int breaks,
+    const double theta, const double trunc_scale, const std::string& side,
+    const int num_threads, const pybind11::object sink,
+    const size_t block_size) {
+  check_offsets(offsets, values.size());
+  DoubleArray sizes;
+  const confseq::StreamCSParams params = stream_cs_params(
+      cs, alpha, running_intersection, truncation, fixed_n, t_opt, v_opt, N,
+      population_sizes, offsets.size() - 1, lower_bd, upper_bd, breaks, theta,
+      trunc_scale, side, sizes);
+  if (!sink.is_none()) {
+    const std::unique_ptr<confseq::BoundsSink> bounds =
+        bounds_sink(sink, values.size());
+    const double* values_data = values.data();
+    const size_t* offsets_data = offsets.data();
+    {
+      pybind11::gil_scoped_release release;
+      try {
+        confseq::batch_confidence_sequences(values_data, offsets_data,
+                                            offsets.size() - 1, params,
+                                            *bounds, num_threads, block_size);
+      } catch (const std::invalid_argument& e) {
+        throw pybind11::value_error(e.what());
+      }
+    }
+    return pybind11::none();
+  }
+  DoubleArray lower(values.size()), upper(values.size());
+  const double* values_data = values.data();
+  const size_t* offsets_data = offsets.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    try {
+      confseq::batch_confidence_sequences(values_data, offsets_data,
+                                          offsets.size() - 1, params,
+                                          lower_data, upper_data,
+                                          num_threads);
+    } catch (const std::invalid_argument& e) {
+      throw pybind11::value_error(e.what());
+    }
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+// confseq::cs_first_exclusions, returning (times, lower, upper) with one
+// entry per stream. null_mean is a float or one mean per stream.
+pybind11::tuple cs_first_exclusions(
+    const DoubleArray values, const OffsetArray offsets,
+    const DoubleArray null_mean, const std::string& cs, const double alpha,
+    const bool running_intersection, const double truncation,
+    const double fixed_n, const double t_opt, const double v_opt,
+    const double N, const pybind11::object population_sizes,
+    const double lower_bd, const double upper_bd, const int breaks,
+    const double theta, const double trunc_scale, const std::string& side,
+    const int num_threads) {
+  check_offsets(offsets, values.size());
+  const size_t num_streams = offsets.size() - 1;
+  if (null_mean.ndim() > 1
+      || (null_mean.ndim() == 1 && size_t(null_mean.size()) != num_streams)) {
+    throw pybind11::value_error(
+        "null_mean must be a float or have one entry per stream");
+  }
+  DoubleArray sizes;
+  const confseq::StreamCSParams params = stream_cs_params(
+      cs, alpha, running_intersection, truncation, fixed_n, t_opt, v_opt, N,
+      population_sizes, num_streams, lower_bd, upper_bd, breaks, theta,
+      trunc_scale, side, sizes);
+  std::vector<confseq::FirstCrossing> crossings(num_streams);
+  const double* values_data = values.data();
+  const size_t* offsets_data = offsets.data();
+  const double* null_means =
+      null_mean.ndim() == 1 ? null_mean.data() : nullptr;
+  const double scalar_null = null_mean.ndim() == 0 ? null_mean.data()[0] : 0;
+  {
+    pybind11::gil_scoped_release release;
+    try {
+      confseq::cs_first_exclusions(values_data, offsets_data, num_streams,
+                                   params, scalar_null, null_means,
+                                   crossings.data(), num_threads);
+    } catch (const std::invalid_argument& e) {
+      throw pybind11::value_error(e.what());
+    }
+  }
+  pybind11::array_t<size_t> times(num_streams);
+  DoubleArray lower(num_streams), upper(num_streams);
+  for (size_t k = 0; k < num_streams; k++) {
+    times.mutable_data()[k] = crossings[k].time;
+    lower.mutable_data()[k] = crossings[k].lower;
+    upper.mutable_data()[k] = crossings[k].upper;
+  }
+  return pybind11::make_tuple(times, lower, upper);
+}
+
+pybind11::tuple confidence_sequence_readouts(
+    const DoubleArray x, const pybind11::object times, const double eta,
+    const std::string& cs, const double alpha, const bool running_intersection,
+    const double truncation, const double fixed_n, const double t_opt,
+    const double v_opt, const double N, const double lower_bd,
+    const double upper_bd, const int breaks, const double theta,
+    const double trunc_scale, const std::string& side) {
+  const std::vector<size_t> readout_times = times.is_none()
+      ? confseq::geometric_readout_times(x.size(), eta)
+      : times.cast<std::vector<size_t>>();
+  if (!readout_times.empty() && readout_times.back() > size_t(x.size())) {
+    throw pybind11::value_error("times must not exceed len(x)");
+  }
+  confseq::StreamCSParams params;
+  params.kind = confseq::stream_cs_kind(cs);
+  params.alpha = alpha;
+  params.running_intersection = running_intersection;
+  params.truncation = truncation;
+  params.fixed_n = fixed_n;
+  params.t_opt = t_opt;
+  params.v_opt = v_opt;
+  params.N = N;
+  params.lower_bd = lower_bd;
+  params.upper_bd = upper_bd;
+  params.breaks = breaks;
+  params.theta = theta;
+  params.trunc_scale = trunc_scale;
+  params.side = confseq::cs_side(side);
+  pybind11::array_t<size_t> times_out(readout_times.size());
+  std::copy(readout_times.begin(), readout_times.end(),
+            times_out.mutable_data());
+  DoubleArray lower(readout_times.size()), upper(readout_times.size());
+  const double* x_data = x.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    try {
+      confseq::confidence_sequence_readouts(
+          x_data, readout_times.data(), readout_times.size(), params,
+          lower_data, upper_data);
+    } catch (const std::invalid_argument& e) {
+      throw pybind11::value_error(e.what());
+    }
+  }
+  return pybind11::make_tuple(times_out, lower, upper);
+}
+
+// StreamCSParams of the kinds named in cs, each at alpha / len(cs).
+std::vector<confseq::StreamCSParams> intersected_cs_methods(
+    const std::vector<std::string>& cs, const double alpha,
+    const double truncation, const double fixed_n, const double t_opt,
+    const double v_opt, const double N, const double lower_bd,
+    const double upper_bd, const int breaks, const double theta,
+    const double trunc_scale, const std::string& side) {
+  if (cs.empty()) {
+    throw pybind11::value_error("cs must name at least one method");
+  }
+  std::vector<confseq::StreamCSParams> methods(cs.size());
+  for (size_t k = 0; k < cs.size(); k++) {
+    confseq::StreamCSParams& params = methods[k];
+    params.kind = confseq::stream_cs_kind(cs[k]);
+    params.alpha = alpha / cs.size();
+    params.truncation = truncation;
+    params.fixed_n = fixed_n;
+    params.t_opt = t_opt;
+    params.v_opt = v_opt;
+    params.N = N;
+    params.lower_bd = lower_bd;
+    params.upper_bd = upper_bd;
+    params.breaks = breaks;
+    params.theta = theta;
+    params.trunc_scale = trunc_scale;
+    params.side = confseq::cs_side(side);
+  }
+  return methods;
+}
+
+// confseq::intersected_cs of the kinds named in cs, each at alpha / len(cs).
+pybind11::object intersected_cs(
+    const DoubleArray x, const std::vector<std::string>& cs,
+    const double alpha, const bool running_intersection,
+    const double truncation, const double fixed_n, const double t_opt,
+    const double v_opt, const double N, const double lower_bd,
+    const double upper_bd, const int breaks, const double theta,
+    const double trunc_scale, const std::string& side,
+    const pybind11::object sink, const size_t block_size) {
+  const std::vector<confseq::StreamCSParams> methods = intersected_cs_methods(
+      cs, alpha, truncation, fixed_n, t_opt, v_opt, N, lower_bd, upper_bd,
+      breaks, theta, trunc_scale, side);
+  if (!sink.is_none()) {
+    const std::unique_ptr<confseq::BoundsSink> bounds =
+        bounds_sink(sink, x.size());
+    const double* x_data = x.data();
+    {
+      pybind11::gil_scoped_release release;
+      try {
+        confseq::intersected_cs(x_data, x.size(), methods.data(),
+                                methods.size(), running_intersection, *bounds,
+                                block_size);
+      } catch (const std::invalid_argument& e) {
+        throw pybind11::value_error(e.what());
+      }
+    }
+    return pybind11::none();
+  }
+  DoubleArray lower(x.size()), upper(x.size());
+  const double* x_data = x.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    try {
+      confseq::intersected_cs(x_data, x.size(), methods.data(),
+                              methods.size(), running_intersection,
+                              lower_data, upper_data);
+    } catch (const std::invalid_argument& e) {
+      throw pybind11::value_error(e.what());
+    }
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+confseq::CrossingSimulationResult simulate_cs_miscoverage(
+    const confseq::SimulatedData& data, const size_t horizon,
+    const size_t replicates, const std::string& cs, const double alpha,
+    const bool running_intersection, const double truncation,
+    const double fixed_n, const double t_opt, const double v_opt,
+    const double lower_bd, const double upper_bd, const int breaks,
+    const double theta, const double trunc_scale, const std::string& side,
+    const uint64_t seed, const int num_threads) {
+  confseq::StreamCSParams params;
+  params.kind = confseq::stream_cs_kind(cs);
+  params.alpha = alpha;
+  params.running_intersection = running_intersection;
+  params.truncation = truncation;
+  params.fixed_n = fixed_n;
+  params.t_opt = t_opt;
+  params.v_opt = v_opt;
+  params.lower_bd = lower_bd;
+  params.upper_bd = upper_bd;
+  params.breaks = breaks;
+  params.theta = theta;
+  params.trunc_scale = trunc_scale;
+  params.side = confseq::cs_side(side);
+  pybind11::gil_scoped_release release;
+  try {
+    return confseq::simulate_cs_miscoverage(params, data, horizon, replicates,
+                                            seed, num_threads);
+  } catch (const std::invalid_argument& e) {
+    throw pybind11::value_error(e.what());
+  }
+}
+
+template <class Accumulator>
+pybind11::tuple predmix_cs_wor(
+    const DoubleArray x, const double N, const pybind11::object lambdas,
+    const double alpha, const double lower_bd, const double upper_bd,
+    const bool running_intersection) {
+  if (x.size() > N) {
+    throw pybind11::value_error("More observations than the population size");
+  }
+  DoubleArray given_lambdas;
+  const double* lambdas_data = nullptr;
+  if (!lambdas.is_none()) {
+    given_lambdas = lambdas.cast<DoubleArray>();
+    if (given_lambdas.size() != x.size()) {
+      throw pybind11::value_error("lambdas must have the same length as x");
+    }
+    lambdas_data = given_lambdas.data();
+  }
+  DoubleArray lower(x.size()), upper(x.size());
+  const double* x_data = x.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    Accumulator cs(N, alpha, lower_bd, upper_bd, running_intersection);
+    for (size_t t = 0; t < size_t(x.size()); t++) {
+      std::tie(lower_data[t], upper_data[t]) = cs.update(
+          x_data + t, 1, lambdas_data == nullptr ? nullptr : lambdas_data + t);
+    }
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
+template <class Accumulator>
+void bind_predmix_wor_accumulator(pybind11::module& m, const char* name,
+                                  const char* doc) {
+  pybind11::class_<Accumulator>(m, name, doc)
+      .def(pybind11::init([](const double N, const double alpha,
+                             const double lower_bd, const double upper_bd,
+                             const bool running_intersection) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             if (!(lower_bd < upper_bd)) {
+               throw pybind11::value_error("lower_bd must be below upper_bd");
+             }
+             return Accumulator(N, alpha, lower_bd, upper_bd,
+                                running_intersection);
+           }),
+           "N"_a, "alpha"_a=0.05, "lower_bd"_a=0, "upper_bd"_a=1,
+           "running_intersection"_a=false)
+      .def("update",
+           [](Accumulator& cs, const DoubleArray x,
+              const pybind11::object lambdas) {
+             DoubleArray given_lambdas;
+             const double* lambdas_data = nullptr;
+             if (!lambdas.is_none()) {
+               given_lambdas = lambdas.cast<DoubleArray>();
+               if (given_lambdas.size() != x.size()) {
+                 throw pybind11::value_error(
+                     "lambdas must have the same length as x");
+               }
+               lambdas_data = given_lambdas.data();
+             }
+             const double* x_data = x.data();
+             pybind11::gil_scoped_release release;
+             try {
+               return cs.update(x_data, x.size(), lambdas_data);
+             } catch (const std::invalid_argument& e) {
+               throw pybind11::value_error(e.what());
+             }
+           },
+           R"pbdoc(
+             Add the observations `x`, an array or a single value, bet on
+             with `lambdas` if given and the default bets otherwise, and
+             return the updated `(lower, upper)` interval. Raises
+             `ValueError`, leaving the state unchanged, for more than `N`
+             observations in all.
+           )pbdoc",
+           "x"_a, "lambdas"_a=pybind11::none())
+      .def_property_readonly("interval", &Accumulator::interval)
+      .def_property_readonly("num_observations",
+                             &Accumulator::num_observations)
+      .def(confseq::checkpoint_pickle<Accumulator>());
+}
+
+// Rollup readouts as a tuple of (grain, start, num_observations, mean,
+// lower, upper) arrays.
+pybind11::tuple rollup_readouts(
+    const std::vector<confseq::RollupReadout>& readouts) {
+  const size_t n = readouts.size();
+  pybind11::array_t<int64_t> grain(n), start(n);
+  pybind11::array_t<size_t> num_observations(n);
+  DoubleArray mean(n), lower(n), upper(n);
+  for (size_t i = 0; i < n; i++) {
+    grain.mutable_data()[i] = readouts[i].grain;
+    start.mutable_data()[i] = readouts[i].start;
+    num_observations.mutable_data()[i] = readouts[i].num_observations;
+    mean.mutable_data()[i] = readouts[i].mean;
+    lower.mutable_data()[i] = readouts[i].lower;
+    upper.mutable_data()[i] = readouts[i].upper;
+  }
+  return pybind11::make_tuple(grain, start, num_observations, mean, lower,
+                              upper);
+}
+
+PYBIND11_MODULE(capital_processes, m) {
+  // For SimulatedData and CrossingSimulationResult.
+  pybind11::module::import("confseq.boundaries");
+  confseq::define_thread_settings(m);
+  confseq::define_solver_counters(m);
+  confseq::define_latency_tracing(m);
+  pybind11::enum_<confseq::BettingStrategyKind>(m, "BettingStrategyKind")
+      .value("predmix_eb", confseq::BettingStrategyKind::PREDMIX_EB)
+      .value("aKelly", confseq::BettingStrategyKind::AKELLY)
+      .value("LBOW", confseq::BettingStrategyKind::LBOW)
+      .value("fixed_fraction", confseq::BettingStrategyKind::FIXED_FRACTION);
+  pybind11::class_<confseq::BettingStrategyParams>(
+      m, "BettingStrategy",
+      R"pbdoc(
+        A betting strategy of `betting_strategies`, computed natively so that
+        grids of null means need no Python callbacks. `kind` is a
+        `BettingStrategyKind` or its name: "predmix_eb", "aKelly", "LBOW", or
+        "fixed_fraction" for the constant bets `fraction / m` and
+        `fraction / (1 - m)` of `betting.dKelly_cs()`. Other arguments are
+        those of the corresponding functions, each used only by the kinds
+        that take it. With `fixed_horizon`, "predmix_eb" bets are optimized
+        for the sample size of each fixed-time interval, as
+        `fixed_n=len(x)` would be in a `betting.betting_ci()` bets function.
+        Sampling without replacement follows the `N` of the capital process.
+      )pbdoc")
+      .def(pybind11::init([](const pybind11::object kind, const double alpha,
+                             const double truncation, const double fixed_n,
+                             const double scale, const bool fixed_horizon,
+                             const double prior_mean,
+                             const double prior_variance,
+                             const double fake_obs, const double trunc_scale,
+                             const double fraction) {
+             if (!(0 < trunc_scale && trunc_scale <= 1)) {
+               throw pybind11::value_error("trunc_scale must be in (0, 1]");
+             }
+             confseq::BettingStrategyParams params;
+             if (pybind11::isinstance<pybind11::str>(kind)) {
+               try {
+                 params.kind = confseq::betting_strategy_kind(
+                     kind.cast<std::string>());
+               } catch (const std::invalid_argument& e) {
+                 throw pybind11::value_error(e.what());
+               }
+             } else {
+               params.kind = kind.cast<confseq::BettingStrategyKind>();
+             }
+             params.alpha = alpha;
+             params.truncation = truncation;
+             params.fixed_n = fixed_n;
+             params.scale = scale;
+             params.fixed_horizon = fixed_horizon;
+             params.prior_mean = prior_mean;
+             params.prior_variance = prior_variance;
+             params.fake_obs = fake_obs;
+             params.trunc_scale = trunc_scale;
+             params.fraction = fraction;
+             return params;
+           }),
+           "kind"_a="predmix_eb", "alpha"_a=0.05,
+           "truncation"_a=std::numeric_limits<double>::infinity(),
+           "fixed_n"_a=0, "scale"_a=1, "fixed_horizon"_a=false,
+           "prior_mean"_a=0.5,
+           "prior_variance"_a=0.25, "fake_obs"_a=1, "trunc_scale"_a=1,
+           "fraction"_a=0.5)
+      .def_readwrite("kind", &confseq::BettingStrategyParams::kind)
+      .def_readwrite("alpha", &confseq::BettingStrategyParams::alpha)
+      .def_readwrite("truncation",
+                     &confseq::BettingStrategyParams::truncation)
+      .def_readwrite("fixed_n", &confseq::BettingStrategyParams::fixed_n)
+      .def_readwrite("scale", &confseq::BettingStrategyParams::scale)
+      .def_readwrite("fixed_horizon",
+                     &confseq::BettingStrategyParams::fixed_horizon)
+      .def_readwrite("prior_mean",
+                     &confseq::BettingStrategyParams::prior_mean)
+      .def_readwrite("prior_variance",
+                     &confseq::BettingStrategyParams::prior_variance)
+      .def_readwrite("fake_obs", &confseq::BettingStrategyParams::fake_obs)
+      .def_readwrite("trunc_scale",
+                     &confseq::BettingStrategyParams::trunc_scale)
+      .def_readwrite("fraction", &confseq::BettingStrategyParams::fraction);
+  pybind11::class_<confseq::HedgedConfidenceSequence>(
+      m, "HedgedConfidenceSequence",
+      R"pbdoc(
+        Streaming form of `betting.hedged_cs()`, for observations in [0, 1],
+        or importance-weighted outcomes in [0, `max_weight`].
+
+        The log capital at each grid mean and the running statistics of the
+        bets are kept, so `update()` costs O(`breaks`) per observation
+        however many came before, and observations need not be kept.
+        Arguments are as for `hedged_cs()`, with `N=0` for sampling with
+        replacement. Intervals match `hedged_cs()` on the same observations.
+      )pbdoc")
+      .def(pybind11::init([](const double alpha, const double N,
+                             const int breaks, const bool running_intersection,
+                             const double theta, const double trunc_scale,
+                             const double prior_mean,
+                             const double prior_variance,
+                             const double fake_obs, const double max_weight) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             if (breaks <= 0) {
+               throw pybind11::value_error("breaks must be positive");
+             }
+             if (!(0 < trunc_scale && trunc_scale <= 1)) {
+               throw pybind11::value_error("trunc_scale must be in (0, 1]");
+             }
+             if (!(max_weight >= 1) || (max_weight != 1 && N > 0)) {
+               throw pybind11::value_error(
+                   "max_weight must be at least 1, and 1 if N > 0");
+             }
+             return confseq::HedgedConfidenceSequence(
+                 alpha, N, breaks, running_intersection, theta, trunc_scale,
+                 prior_mean, prior_variance, fake_obs, max_weight);
+           }),
+           "alpha"_a=0.05, "N"_a=0, "breaks"_a=1000,
+           "running_intersection"_a=true, "theta"_a=0.5,
+           "trunc_scale"_a=0.5, "prior_mean"_a=0.5, "prior_variance"_a=0.25,
+           "fake_obs"_a=1, "max_weight"_a=1)
+      .def("update",
+           [](confseq::HedgedConfidenceSequence& cs, DoubleArray x,
+              const pybind11::object weights) {
+             x = weighted_observations(x, weights);
+             const double* x_data = x.data();
+             pybind11::gil_scoped_release release;
+             try {
+               return cs.update(x_data, x.size());
+             } catch (const std::invalid_argument& e) {
+               throw pybind11::value_error(e.what());
+             }
+           },
+           R"pbdoc(
+             Add the observations `x`, an array or a single value, weighted
+             by the importance weights `weights` if given, and return the
+             updated `(lower, upper)` interval. Raises `ValueError`, leaving
+             the state unchanged, for weighted observations outside
+             [0, `max_weight`] or beyond the population size.
+           )pbdoc",
+           "x"_a, "weights"_a=pybind11::none())
+      .def("update_path",
+           [](confseq::HedgedConfidenceSequence& cs, DoubleArray x,
+              const pybind11::object weights) {
+             x = weighted_observations(x, weights);
+             pybind11::array_t<double> lower(x.size()), upper(x.size());
+             const double* x_data = x.data();
+             double* lower_data = lower.mutable_data();
+             double* upper_data = upper.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               try {
+                 cs.update(x_data, x.size(), lower_data, upper_data);
+               } catch (const std::invalid_argument& e) {
+                 throw pybind11::value_error(e.what());
+               }
+             }
+             return pybind11::make_tuple(lower, upper);
+           },
+           R"pbdoc(
+             As `update()`, but return arrays `(lower, upper)` of the interval
+             after each observation, as `hedged_cs()` does. The grid means
+             take each observation in turn, with no per-observation buffers.
+           )pbdoc",
+           "x"_a, "weights"_a=pybind11::none())
+      .def_property_readonly("interval",
+                             &confseq::HedgedConfidenceSequence::interval)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::HedgedConfidenceSequence::num_observations);
+  pybind11::class_<confseq::PredmixEmpBernAccumulator>(
+      m, "PredmixEmpBernAccumulator",
+      R"pbdoc(
+        Streaming form of `predmix.predmix_empbern_cs()`, for observations in
+        [0, 1].
+
+        Only running sums are kept, so memory is constant and `update()`
+        costs O(1) per observation however many came before. Arguments are
+        as for `predmix_empbern_cs()`, with `fixed_n=0` for None. Intervals
+        match `predmix_empbern_cs()` on the same observations.
+
+        This and the other accumulators can be pickled, saving their running
+        sums so that a restored accumulator continues exactly.
+      )pbdoc")
+      .def(pybind11::init([](const double alpha, const double truncation,
+                             const bool running_intersection,
+                             const double fixed_n, const std::string& side) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             return confseq::PredmixEmpBernAccumulator(
+                 alpha, truncation, running_intersection, fixed_n,
+                 confseq::cs_side(side));
+           }),
+           "alpha"_a=0.05, "truncation"_a=0.5,
+           "running_intersection"_a=false, "fixed_n"_a=0, "side"_a="both")
+      .def("update",
+           [](confseq::PredmixEmpBernAccumulator& cs, const DoubleArray x) {
+             const double* x_data = x.data();
+             pybind11::gil_scoped_release release;
+             return cs.update(x_data, x.size());
+           },
+           R"pbdoc(
+             Add the observations `x`, an array or a single value, and return
+             the updated `(lower, upper)` interval.
+           )pbdoc",
+           "x"_a)
+      .def_property_readonly("interval",
+                             &confseq::PredmixEmpBernAccumulator::interval)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::PredmixEmpBernAccumulator::num_observations)
+      .def(confseq::checkpoint_pickle<
+           confseq::PredmixEmpBernAccumulator>());
+  pybind11::class_<confseq::PredmixHoeffdingAccumulator>(
+      m, "PredmixHoeffdingAccumulator",
+      R"pbdoc(
+        Streaming form of `predmix.predmix_hoeffding_cs()`, as
+        `PredmixEmpBernAccumulator` is of `predmix_empbern_cs()`.
+      )pbdoc")
+      .def(pybind11::init([](const double alpha,
+                             const bool running_intersection) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             return confseq::PredmixHoeffdingAccumulator(
+                 alpha, running_intersection);
+           }),
+           "alpha"_a=0.05, "running_intersection"_a=false)
+      .def("update",
+           [](confseq::PredmixHoeffdingAccumulator& cs, const DoubleArray x) {
+             const double* x_data = x.data();
+             pybind11::gil_scoped_release release;
+             return cs.update(x_data, x.size());
+           },
+           R"pbdoc(
+             Add the observations `x`, an array or a single value, and return
+             the updated `(lower, upper)` interval.
+           )pbdoc",
+           "x"_a)
+      .def_property_readonly("interval",
+                             &confseq::PredmixHoeffdingAccumulator::interval)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::PredmixHoeffdingAccumulator::num_observations)
+      .def(confseq::checkpoint_pickle<
+           confseq::PredmixHoeffdingAccumulator>());
+  pybind11::class_<confseq::ConjmixHoeffdingAccumulator>(
+      m, "ConjmixHoeffdingAccumulator",
+      R"pbdoc(
+        Streaming form of `conjmix_bounded.conjmix_hoeffding_cs()`, with the
+        closed-form boundary evaluated at constant cost per observation.
+        Intervals match `conjmix_hoeffding_cs()`.
+      )pbdoc")
+      .def(pybind11::init([](const double t_opt, const double alpha,
+                             const bool running_intersection) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             if (!(t_opt > 0)) {
+               throw pybind11::value_error("t_opt must be positive");
+             }
+             return confseq::ConjmixHoeffdingAccumulator(t_opt, alpha,
+                                                         running_intersection);
+           }),
+           "t_opt"_a, "alpha"_a=0.05, "running_intersection"_a=false)
+      .def("update",
+           [](confseq::ConjmixHoeffdingAccumulator& cs, const DoubleArray x) {
+             const double* x_data = x.data();
+             pybind11::gil_scoped_release release;
+             return cs.update(x_data, x.size());
+           },
+           R"pbdoc(
+             Add the observations `x`, an array or a single value, and return
+             the updated `(lower, upper)` interval.
+           )pbdoc",
+           "x"_a)
+      .def_property_readonly("interval",
+                             &confseq::ConjmixHoeffdingAccumulator::interval)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::ConjmixHoeffdingAccumulator::num_observations)
+      .def(confseq::checkpoint_pickle<
+           confseq::ConjmixHoeffdingAccumulator>());
+  pybind11::class_<confseq::ConjmixEmpBernAccumulator>(
+      m, "ConjmixEmpBernAccumulator",
+      R"pbdoc(
+        Streaming form of `conjmix_bounded.conjmix_empbern_cs()`.
+
+        The gamma-exponential mixture is built once and each boundary root
+        is warm-started from the previous one, so `update()` costs O(1) per
+        observation and intervals match `conjmix_empbern_cs()`.
+      )pbdoc")
+      .def(pybind11::init([](const double v_opt, const double alpha,
+                             const bool running_intersection,
+                             const std::string& side) {
+             if (!(0 < alpha && alpha < 1)) {
+               throw pybind11::value_error("alpha must be in (0, 1)");
+             }
+             if (!(v_opt > 0)) {
+               throw pybind11::value_error("v_opt must be positive");
+             }
+             return confseq::ConjmixEmpBernAccumulator(
+                 v_opt, alpha, running_intersection, confseq::cs_side(side));
+           }),
+           "v_opt"_a, "alpha"_a=0.05, "running_intersection"_a=false,
+           "side"_a="both")
+      .def("update",
+           [](confseq::ConjmixEmpBernAccumulator& cs, const DoubleArray x) {
+             const double* x_data = x.data();
+             pybind11::gil_scoped_release release;
+             return cs.update(x_data, x.size());
+           },
+           R"pbdoc(
+             Add the observations `x`, an array or a single value, and return
+             the updated `(lower, upper)` interval.
+           )pbdoc",
+           "x"_a)
+      .def_property_readonly("interval",
+                             &confseq::ConjmixEmpBernAccumulator::interval)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::ConjmixEmpBernAccumulator::num_observations)
+      .def(confseq::checkpoint_pickle<
+           confseq::ConjmixEmpBernAccumulator>());
+  bind_predmix_wor_accumulator<confseq::PredmixEmpBernWoRAccumulator>(
+      m, "PredmixEmpBernWoRAccumulator",
+      R"pbdoc(
+        Streaming form of `predmix.predmix_empbern_cs_wor()`, sampling
+        without replacement from a population of size `N`.
+
+        The finite-population corrections are kept as running sums, so
+        memory is constant and `update()` costs O(1) per observation.
+        Intervals match `predmix_empbern_cs_wor()`.
+      )pbdoc");
+  bind_predmix_wor_accumulator<confseq::PredmixHoeffdingWoRAccumulator>(
+      m, "PredmixHoeffdingWoRAccumulator",
+      R"pbdoc(
+        Streaming form of `predmix.predmix_hoeffding_cs_wor()`, as
+        `PredmixEmpBernWoRAccumulator` is of `predmix_empbern_cs_wor()`.
+      )pbdoc");
+  m.def("predmix_empbern_cs_wor",
+        &predmix_cs_wor<confseq::PredmixEmpBernWoRAccumulator>,
+        R"pbdoc(
+          `predmix.predmix_empbern_cs_wor()` in one native pass, with the
+          default bets if `lambdas` is None.
+        )pbdoc",
+        "x"_a, "N"_a, "lambdas"_a=pybind11::none(), "alpha"_a=0.05,
+        "lower_bd"_a=0, "upper_bd"_a=1, "running_intersection"_a=false);
+  m.def("predmix_hoeffding_cs_wor",
+        &predmix_cs_wor<confseq::PredmixHoeffdingWoRAccumulator>,
+        R"pbdoc(
+          `predmix.predmix_hoeffding_cs_wor()` in one native pass, with the
+          default bets if `lambdas` is None.
+        )pbdoc",
+        "x"_a, "N"_a, "lambdas"_a=pybind11::none(), "alpha"_a=0.05,
+        "lower_bd"_a=0, "upper_bd"_a=1, "running_intersection"_a=false);
+  m.def("batch_confidence_sequences",
+        &batch_confidence_sequences,
+        R"pbdoc(
+          Confidence sequences of kind `cs` for many independent streams in
+          one call, as a tuple of lower and upper arrays laid out like
+          `values`: stream `s` is `values[offsets[s]:offsets[s + 1]]`.
+
+          `cs` is "predmix_empbern" (`predmix_empbern_cs()`, with
+          `truncation` and `fixed_n=0` for None), "predmix_hoeffding"
+          (`predmix_hoeffding_cs()`), "predmix_empbern_wor" and
+          "predmix_hoeffding_wor" (`predmix_empbern_cs_wor()` and
+          `predmix_hoeffding_cs_wor()` with `N`, `lower_bd` and `upper_bd`),
+          "conjmix_hoeffding" (`conjmix_hoeffding_cs()` with `t_opt`),
+          "conjmix_empbern" (`conjmix_empbern_cs()` with `v_opt`) or "hedged"
+          (`hedged_cs()` with `N`, `breaks`, `theta` and `trunc_scale`).
+          `population_sizes`, if given, holds one population size per stream
+          in place of `N`. `side` is "both", or "lower" or "upper" for a
+          one-sided confidence sequence of "predmix_empbern",
+          "conjmix_empbern" or "hedged", which spends all of `alpha` on one
+          bound and reports the other as 0 or 1. Streams are spread across
+          threads with the GIL released, each computed in one pass.
+          `batch.batch_cs()` accepts padded 2-D arrays too.
+
+          With `sink`, the bounds are written in blocks of up to
+          `block_size` per stream instead of being returned, so memory stays
+          bounded however long the streams are, and None is returned.
+          `sink` is a path, for a binary file read back by
+          `batch.read_bounds_file()`, or a callable, called with the GIL
+          held as `sink(offset, lower, upper)` for the bounds of rows
+          `offset` onward, one block at a time.
+        )pbdoc",
+        "values"_a, "offsets"_a, "cs"_a="predmix_empbern", "alpha"_a=0.05,
+        "running_intersection"_a=false, "truncation"_a=0.5, "fixed_n"_a=0,
+        "t_opt"_a=1, "v_opt"_a=1, "N"_a=0,
+        "population_sizes"_a=pybind11::none(), "lower_bd"_a=0, "upper_bd"_a=1,
+        "breaks"_a=1000, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "side"_a="both", "num_threads"_a=0,
+        "sink"_a=pybind11::none(), "block_size"_a=4096);
+  m.def("cs_first_exclusions",
+        &cs_first_exclusions,
+        R"pbdoc(
+          For each stream of `batch_confidence_sequences()`, with the same
+          `values`, `offsets` and confidence sequence arguments, the first
+          time the confidence sequence excludes `null_mean`, a float or one
+          mean per stream. Returns a tuple of the times, 0 for streams that
+          never exclude their mean, and the lower and upper bounds then, or
+          after the last observation. Each stream stops at its exclusion, so
+          this is much cheaper than the dense sequences when streams stop
+          early; with `running_intersection`, observations are added in
+          blocks and only the block holding the exclusion is replayed.
+        )pbdoc",
+        "values"_a, "offsets"_a, "null_mean"_a, "cs"_a="predmix_empbern",
+        "alpha"_a=0.05, "running_intersection"_a=false, "truncation"_a=0.5,
+        "fixed_n"_a=0, "t_opt"_a=1, "v_opt"_a=1, "N"_a=0,
+        "population_sizes"_a=pybind11::none(), "lower_bd"_a=0, "upper_bd"_a=1,
+        "breaks"_a=1000, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "side"_a="both", "num_threads"_a=0);
+  m.def("confidence_sequence_readouts",
+        &confidence_sequence_readouts,
+        R"pbdoc(
+          The confidence sequence of kind `cs` on `x`, as for
+          `batch_confidence_sequences()`, read out only after `times`
+          observations, an increasing list defaulting to
+          `boundaries.geometric_readout_times(len(x), eta)`. Returns a tuple
+          of the times and the lower and upper bounds at them. Every
+          observation enters the running sums, but "conjmix_empbern" solves
+          its boundary only at the readouts, so `O(log n)` readouts of `n`
+          observations cost `O(log n)` root searches rather than `n`; its
+          `running_intersection` then runs over the readouts.
+        )pbdoc",
+        "x"_a, "times"_a=pybind11::none(), "eta"_a=2,
+        "cs"_a="predmix_empbern", "alpha"_a=0.05,
+        "running_intersection"_a=false, "truncation"_a=0.5, "fixed_n"_a=0,
+        "t_opt"_a=1, "v_opt"_a=1, "N"_a=0, "lower_bd"_a=0, "upper_bd"_a=1,
+        "breaks"_a=1000, "theta"_a=0.5, "trunc_scale"_a=0.5,
+        "side"_a="both");
+  m.def("intersected_cs",
+        &intersected_cs,
+        R"pbdoc(
+          The intersection of the confidence sequences of the kinds named in
+          `cs`, as for `batch_confidence_sequences()`, each at level
+          `alpha / len(cs)` so that the intersection has level `alpha`.
+          Returns a tuple of lower and upper arrays. The observations pass
+          through every method in one native pass, blockwise, and the
+          intersection and running intersection are taken as the bounds are
+          written, so it replaces separate calls followed by
+          `np.maximum` and `np.minimum` without their temporaries. `sink`
+          and `block_size` are as for `batch_confidence_sequences()`.
+        )pbdoc",
+        "x"_a, "cs"_a=std::vector<std::string>{"predmix_empbern",
+                                               "conjmix_empbern", "hedged"},
+        "alpha"_a=0.05, "running_intersection"_a=false, "truncation"_a=0.5,
+        "fixed_n"_a=0, "t_opt"_a=1, "v_opt"_a=1, "N"_a=0, "lower_bd"_a=0,
+        "upper_bd"_a=1, "breaks"_a=1000, "theta"_a=0.5, "trunc_scale"_a=0.5,
+        "side"_a="both", "sink"_a=pybind11::none(), "block_size"_a=4096);
+  pybind11::class_<confseq::IntersectedConfidenceSequence>(
+      m, "IntersectedConfidenceSequence",
+      R"pbdoc(
+        Streaming form of `intersected_cs()`, for streams that arrive in
+        chunks, such as the row groups of a file too large for memory.
+
+        Each method carries its running sums, bets and grid of log capital
+        between calls to `update()`, so memory is bounded by the largest
+        chunk, and for a single kind in `cs` the bounds are bit for bit
+        those of `batch_confidence_sequences()` on the whole stream, however
+        it is chunked. `batch.chunked_cs()` drives it from an iterable of
+        chunks.
+      )pbdoc")
+      .def(pybind11::init([](const std::vector<std::string>& cs,
+                             const double alpha,
+                             const bool running_intersection,
+                             const double truncation, const double fixed_n,
+                             const double t_opt, const double v_opt,
+                             const double N, const double lower_bd,
+                             const double upper_bd, const int breaks,
+                             const double theta, const double trunc_scale,
+                             const std::string& side) {
+             const std::vector<confseq::StreamCSParams> methods =
+                 intersected_cs_methods(cs, alpha, truncation, fixed_n,
+                                        t_opt, v_opt, N, lower_bd, upper_bd,
+                                        breaks, theta, trunc_scale, side);
+             return new confseq::IntersectedConfidenceSequence(
+                 methods.data(), methods.size(), running_intersection);
+           }),
+           "cs"_a=std::vector<std::string>{"predmix_empbern"},
+           "alpha"_a=0.05, "running_intersection"_a=false,
+           "truncation"_a=0.5, "fixed_n"_a=0, "t_opt"_a=1, "v_opt"_a=1,
+           "N"_a=0, "lower_bd"_a=0, "upper_bd"_a=1, "breaks"_a=1000,
+           "theta"_a=0.5, "trunc_scale"_a=0.5, "side"_a="both")
+      .def("update",
+           [](confseq::IntersectedConfidenceSequence& cs,
+              const DoubleArray x) {
+             DoubleArray lower(x.size()), upper(x.size());
+             const double* x_data = x.data();
+             double* lower_data = lower.mutable_data();
+             double* upper_data = upper.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               try {
+                 cs.update(x_data, x.size(), lower_data, upper_data);
+               } catch (const std::invalid_argument& e) {
+                 throw pybind11::value_error(e.what());
+               }
+             }
+             return pybind11::make_tuple(lower, upper);
+           },
+           R"pbdoc(
+             Add the observations `x` and return `(lower, upper)` arrays of
+             the interval after each of them. Raises ValueError, leaving the
+             state unchanged, for observations that a method rejects.
+           )pbdoc",
+           "x"_a)
+      .def_property_readonly(
+          "interval", &confseq::IntersectedConfidenceSequence::interval)
+      .def_property_readonly(
+          "num_observations",
+          &confseq::IntersectedConfidenceSequence::num_observations);
+  pybind11::class_<confseq::RollupConfidenceSequences>(
+      m, "RollupConfidenceSequences",
+      R"pbdoc(
+        Confidence sequences of one metric over the buckets of several
+        reporting grains, such as minutes, hours and days, from one pass
+        over timestamped observations.
+
+        `grains` are bucket widths in the units of the timestamps, each a
+        multiple of the one before, and `cs` is "bernoulli", as for
+        `boundaries.bernoulli_confidence_interval()`, "conjmix_hoeffding" or
+        "predmix_empbern". Each bucket's interval is that of `cs` on the
+        bucket's observations alone, read out once the bucket closes. The
+        first two kinds keep only sums and counts, rolled up from each grain
+        into the next, and evaluate each boundary once for all the buckets
+        sharing its counts.
+      )pbdoc")
+      .def(pybind11::init([](const std::vector<int64_t>& grains,
+                             const std::string& cs, const double alpha,
+                             const double t_opt, const double alpha_opt,
+                             const double truncation, const double fixed_n) {
+             confseq::RollupCSParams params;
+             try {
+               params.kind = confseq::rollup_cs_kind(cs);
+               params.alpha = alpha;
+               params.t_opt = t_opt;
+               params.alpha_opt = alpha_opt;
+               params.truncation = truncation;
+               params.fixed_n = fixed_n;
+               return new confseq::RollupConfidenceSequences(params, grains);
+             } catch (const std::invalid_argument& e) {
+               throw pybind11::value_error(e.what());
+             }
+           }),
+           "grains"_a, "cs"_a="bernoulli", "alpha"_a=0.05, "t_opt"_a=100,
+           "alpha_opt"_a=0.05, "truncation"_a=0.5, "fixed_n"_a=0)
+      .def("update",
+           [](confseq::RollupConfidenceSequences& rollups,
+              const confseq::InputArray<int64_t> timestamps,
+              const DoubleArray x) {
+             if (timestamps.size() != x.size()) {
+               throw pybind11::value_error(
+                   "timestamps and x must have the same size");
+             }
+             const int64_t* timestamps_data = timestamps.data();
+             const double* x_data = x.data();
+             std::vector<confseq::RollupReadout> readouts;
+             {
+               pybind11::gil_scoped_release release;
+               try {
+                 rollups.update(timestamps_data, x_data, x.size(), readouts);
+               } catch (const std::invalid_argument& e) {
+                 throw pybind11::value_error(e.what());
+               }
+             }
+             return rollup_readouts(readouts);
+           },
+           R"pbdoc(
+             Add the observations `x` at nondecreasing `timestamps` and
+             return the buckets they close as `(grain, start,
+             num_observations, mean, lower, upper)` arrays, finest first
+             among buckets closing together. Raises ValueError, leaving the
+             state unchanged, for decreasing timestamps or invalid
+             observations.
+           )pbdoc",
+           "timestamps"_a, "x"_a)
+      .def("flush",
+           [](confseq::RollupConfidenceSequences& rollups) {
+             std::vector<confseq::RollupReadout> readouts;
+             rollups.flush(readouts);
+             return rollup_readouts(readouts);
+           },
+           R"pbdoc(
+             Close every open bucket and return its readout, as for
+             `update()`.
+           )pbdoc")
+      .def_property_readonly("grains",
+                             &confseq::RollupConfidenceSequences::grains)
+      .def_property_readonly(
+          "num_boundary_evaluations",
+          &confseq::RollupConfidenceSequences::num_boundary_evaluations);
+  m.def("simulate_cs_miscoverage",
+        &simulate_cs_miscoverage,
+        R"pbdoc(
+          Simulate `replicates` streams of up to `horizon` observations from
+          the `boundaries.SimulatedData` `data` and return a
+          `boundaries.CrossingSimulationResult` for the event that the
+          confidence sequence of kind `cs`, as for
+          `batch_confidence_sequences()`, ever excludes `data.mean`. Each
+          replicate is fed to a streaming accumulator one observation at a time
+          and stops at its first miscoverage. Replicates run across threads
+          with the GIL released, and replicate r draws from stream r of a
+          counter-based generator keyed by `seed`. The "*_wor" kinds need
+          `SimulatedData.permutation()` data, whose size is used as `N`, as it
+          is for "hedged".
+        )pbdoc",
+        "data"_a, "horizon"_a, "replicates"_a, "cs"_a="predmix_empbern",
+        "alpha"_a=0.05, "running_intersection"_a=false, "truncation"_a=0.5,
+        "fixed_n"_a=0, "t_opt"_a=1, "v_opt"_a=1, "lower_bd"_a=0,
+        "upper_bd"_a=1, "breaks"_a=1000, "theta"_a=0.5, "trunc_scale"_a=0.5,
+        "side"_a="both", "seed"_a=0, "num_threads"_a=0);
+  m.def("betting_strategy_bets",
+        &betting_strategy_bets,
+        R"pbdoc(
+          Bets of `strategy` on `x` against the null mean `m`, for the
+          negative capital process if `negative` is True, sampling without
+          replacement from a population of size `N` if `N > 0`.
+        )pbdoc",
+        "x"_a, "m"_a, "strategy"_a, "negative"_a=false, "N"_a=0);
+  m.def("kelly_bets",
+        &kelly_bets,
+        R"pbdoc(
+          `betting_strategies.lambda_Kelly()`: bets solving the empirical
+          Kelly condition on the earlier observations of `x` against the null
+          mean `m`, by warm-started safeguarded Newton.
+        )pbdoc",
+        "x"_a, "m"_a);
+  m.def("diversified_betting_capital_process",
+        &diversified_betting_capital_process,
+        R"pbdoc(
+          `betting.diversified_betting_mart()` with lists of `BettingStrategy`
+          objects and their weights, without calling back into Python. Other
+          arguments are as for `betting_capital_process()`.
+        )pbdoc",
+        "x"_a, "m"_a, "strategies_positive"_a, "strategies_negative"_a,
+        "weights"_a, "N"_a=0, "convex_comb"_a=false, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "m_trunc"_a=true, "log_space"_a=false,
+        "max_weight"_a=1);
+  m.def("diversified_betting_grid_accepted_range",
+        &diversified_betting_grid_accepted_range,
+        R"pbdoc(
+          `betting_grid_accepted_range()` for
+          `diversified_betting_capital_process()`. Statistics of each
+          strategy that do not depend on the null mean are computed once and
+          shared across the whole grid.
+        )pbdoc",
+        "x"_a, "grid"_a, "strategies_positive"_a, "strategies_negative"_a,
+        "weights"_a, "threshold"_a, "N"_a=0, "convex_comb"_a=false,
+        "theta"_a=0.5, "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "log_space"_a=false, "num_threads"_a=0);
+  m.def("diversified_betting_grid_cs",
+        &diversified_betting_grid_cs,
+        R"pbdoc(
+          `betting_grid_cs()` for `diversified_betting_capital_process()`,
+          as `betting.betting_cs()` computes it for native strategies.
+        )pbdoc",
+        "x"_a, "breaks"_a, "strategies_positive"_a, "strategies_negative"_a,
+        "weights"_a, "threshold"_a, "N"_a=0, "convex_comb"_a=false,
+        "theta"_a=0.5, "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "log_space"_a=false, "running_intersection"_a=false,
+        "num_threads"_a=0, "max_weight"_a=1);
+  m.def("diversified_betting_grid_cs_thresholds",
+        &diversified_betting_grid_cs_thresholds,
+        R"pbdoc(
+          `diversified_betting_grid_cs()` at each of the 1-D array
+          `thresholds`, such as `1 / alpha` for several levels, as a tuple of
+          lower and upper arrays of shape `(len(thresholds), len(x))`.
+
+          Each capital process is computed once and compared with every
+          threshold, so the bets must not depend on the level.
+        )pbdoc",
+        "x"_a, "breaks"_a, "strategies_positive"_a, "strategies_negative"_a,
+        "weights"_a, "thresholds"_a, "N"_a=0, "convex_comb"_a=false,
+        "theta"_a=0.5, "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "log_space"_a=false, "running_intersection"_a=false,
+        "num_threads"_a=0, "max_weight"_a=1);
+  m.def("diversified_betting_pruned_grid_cs",
+        &diversified_betting_pruned_grid_cs,
+        R"pbdoc(
+          `diversified_betting_grid_cs()` in which a null mean, once its
+          capital exceeds `threshold`, stays out of the confidence sequence,
+          as `betting.betting_cs()` computes it with `prune_rejected`.
+          Rejected means are dropped from the working set, so each
+          observation costs time proportional to the width of the CS rather
+          than to `breaks`. Intervals are intersected over time and lie
+          within those of the running intersection.
+        )pbdoc",
+        "x"_a, "breaks"_a, "strategies_positive"_a, "strategies_negative"_a,
+        "weights"_a, "threshold"_a, "N"_a=0, "convex_comb"_a=false,
+        "theta"_a=0.5, "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "log_space"_a=false, "num_threads"_a=0, "max_weight"_a=1);
+  m.def("diversified_betting_first_rejections",
+        &diversified_betting_first_rejections,
+        R"pbdoc(
+          `betting_first_rejections()` for the diversified capital process
+          with native strategies: for each null mean in `nulls`, the number
+          of observations after which its capital first exceeds `threshold`,
+          or 0 if it never does. Over the grid of `breaks`, these times hold
+          the whole confidence sequence of
+          `diversified_betting_pruned_grid_cs()` in O(breaks) memory, as read
+          back by `betting.FirstRejectionCS`.
+        )pbdoc",
+        "x"_a, "nulls"_a, "strategies_positive"_a, "strategies_negative"_a,
+        "weights"_a, "threshold"_a, "N"_a=0, "convex_comb"_a=false,
+        "theta"_a=0.5, "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "log_space"_a=false, "num_threads"_a=0, "max_weight"_a=1);
+  m.def("diversified_betting_ci_sequence",
+        &diversified_betting_ci_sequence,
+        R"pbdoc(
+          `betting.betting_ci()` on `x[0:time]` for each of `times`, with
+          lists of `BettingStrategy` objects and their weights, as a tuple of
+          lower and upper arrays.
+
+          Strategy statistics are computed once for the longest prefix.
+          Without `fixed_horizon` strategies, all intervals are read from one
+          confidence sequence; otherwise horizons are evaluated across threads.
+          Log capital is compared with `log(threshold)`.
+        )pbdoc",
+        "x"_a, "times"_a, "breaks"_a, "strategies_positive"_a,
+        "strategies_negative"_a, "weights"_a, "threshold"_a, "N"_a=0,
+        "convex_comb"_a=false, "theta"_a=0.5, "trunc_scale"_a=0.5,
+        "m_trunc"_a=true, "running_intersection"_a=true, "num_threads"_a=0);
+  m.def("betting_capital_process",
+        &betting_capital_process,
+        R"pbdoc(
+          Hedged betting capital process against the null mean `m`, computed
+          in a single pass over `x`.
+
+          Arguments and conventions are as for `betting.betting_mart()`, with
+          the bets given as arrays `lambdas_positive` and `lambdas_negative`
+          of the same length as `x` and `N=0` for sampling with replacement.
+          With `log_space`, returns the log capital, which neither overflows
+          nor loses small values. Raises `ValueError` if the capital is
+          negative, as happens for bets outside the truncation range.
+
+          For off-policy estimation, `x` holds importance-weighted outcomes
+          `w * y` with `y` in [0, 1] and weights `w` at most `max_weight`,
+          and bets are truncated to keep capital nonnegative on
+          [0, `max_weight`].
+        )pbdoc",
+        "x"_a, "m"_a, "lambdas_positive"_a, "lambdas_negative"_a, "N"_a=0,
+        "convex_comb"_a=false, "theta"_a=0.5, "trunc_scale"_a=0.5,
+        "m_trunc"_a=true, "log_space"_a=false, "max_weight"_a=1);
+  m.def("betting_grid_accepted_range",
+        &betting_grid_accepted_range,
+        R"pbdoc(
+          For each time, the indices of the first and last null means in
+          `grid` whose betting capital process is at most `threshold`, or -1
+          where there are none, as a tuple of integer arrays.
+
+          Bets must not depend on the null mean, except through
+          `cap_negative_bets_at_m`, which caps negative bets at the mean as
+          passing `lambda_predmix_eb` itself as a bets function does. Other
+          arguments are as for `betting_capital_process()`. Grid values are
+          evaluated across threads, without storing capital for more than one
+          mean per thread. With `log_space`, log capital is compared with
+          `log(threshold)`. `num_threads=0` uses `get_num_threads()`.
+        )pbdoc",
+        "x"_a, "grid"_a, "lambdas_positive"_a, "lambdas_negative"_a,
+        "threshold"_a, "N"_a=0, "convex_comb"_a=false, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "cap_negative_bets_at_m"_a=false, "log_space"_a=false,
+        "num_threads"_a=0);
+  m.def("betting_first_rejections",
+        &betting_first_rejections,
+        R"pbdoc(
+          For each null mean in `nulls`, the number of observations of `x`
+          after which its betting capital process first exceeds `threshold`,
+          when the sequential test of that mean rejects, or 0 if it never
+          does. Only the nulls not yet rejected are carried through each block
+          of observations, so the scan ends once all are rejected. Arguments
+          are as for `betting_grid_accepted_range()`.
+        )pbdoc",
+        "x"_a, "nulls"_a, "lambdas_positive"_a, "lambdas_negative"_a,
+        "threshold"_a, "N"_a=0, "convex_comb"_a=false, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "cap_negative_bets_at_m"_a=false, "log_space"_a=false,
+        "num_threads"_a=0);
+  m.def("betting_grid_cs",
+        &betting_grid_cs,
+        R"pbdoc(
+          Lower and upper confidence sequences of the grid of null means
+          `np.arange(0, 1 + 1 / breaks, step=1 / breaks)`, as
+          `betting.cs_from_martingale()` computes them, in one native call.
+
+          The accepted ranges of `betting_grid_accepted_range()` are widened
+          by a grid step, intersected with the logical confidence sequence
+          when sampling without replacement (`N > 0`) and, with
+          `running_intersection`, with their own past, in the same pass that
+          accumulates the sum of `x`. Conditional means under sampling
+          without replacement are evaluated inside the capital processes
+          rather than by `betting.mu_t()`.
+        )pbdoc",
+        "x"_a, "breaks"_a, "lambdas_positive"_a, "lambdas_negative"_a,
+        "threshold"_a, "N"_a=0, "convex_comb"_a=false, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "cap_negative_bets_at_m"_a=false, "log_space"_a=false,
+        "running_intersection"_a=false, "num_threads"_a=0);
+  m.def("accepted_range_cs",
+        &accepted_range_cs,
+        R"pbdoc(
+          `betting.cs_from_accepted_range()` on the grid of `breaks`, from
+          the first and last accepted indices at each time, in one pass.
+        )pbdoc",
+        "x"_a, "breaks"_a, "first_accepted"_a, "last_accepted"_a, "N"_a=0,
+        "running_intersection"_a=false);
+  m.def("intersect_cs",
+        &intersect_cs,
+        R"pbdoc(
+          `betting.intersect_cs()` with `N=0` for sampling with replacement,
+          returning new lower and upper arrays.
+        )pbdoc",
+        "x"_a, "lower"_a, "upper"_a, "N"_a=0,
+        "running_intersection"_a=false);
+  m.def("betting_cs_bisection",
+        &betting_cs_bisection,
+        R"pbdoc(
+          Lower and upper confidence sequences for the mean, the null means at
+          which the betting capital process first exceeds `threshold`, found
+          to within `tolerance` by bisection at each time.
+
+          Assumes the accepted means form an interval at each time, as they do
+          for hedged capital processes. Brackets around each endpoint are
+          carried forward through the stream and re-searched only when an
+          observation moves the endpoint out of its bracket. Bets and
+          `log_space` are as for `betting_grid_accepted_range()`.
+        )pbdoc",
+        "x"_a, "lambdas_positive"_a, "lambdas_negative"_a, "threshold"_a,
+        "tolerance"_a, "N"_a=0, "convex_comb"_a=false, "theta"_a=0.5,
+        "trunc_scale"_a=0.5, "m_trunc"_a=true,
+        "cap_negative_bets_at_m"_a=false, "log_space"_a=false);
+}
@@ -0,0 +1,262 @@
+#ifndef CONFIDENCESEQUENCES_CONFSEQ_H_
+#define CONFIDENCESEQUENCES_CONFSEQ_H_
+
+/*
+ * C interface to the confseq_core library, for callers that cannot use the
+ * C++ header. Objects are opaque handles created by *_new functions and
+ * released with the matching *_free. Every function returning confseq_status
+ * reports failure through it rather than by exception, and on failure leaves
+ * a description in confseq_last_error().
+ *
+ * Evaluation functions write into caller-provided buffers and allocate nothing
+ * per element, except for boundary cache entries while the process-wide cache
+ * is enabled. A handle may be used from several threads at once only through
+ * functions taking it as const.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define CONFSEQ_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define CONFSEQ_API __attribute__((visibility("default")))
+#else
+#define CONFSEQ_API
+#endif
+
+/* Incremented on incompatible changes to this interface. */
+#define CONFSEQ_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  CONFSEQ_OK = 0,
+  /* A null pointer, a parameter out of range, or a mismatched handle. */
+  CONFSEQ_INVALID_ARGUMENT = 1,
+  CONFSEQ_OUT_OF_MEMORY = 2,
+  /* A root search or special function failed to converge. */
+  CONFSEQ_NUMERICAL_ERROR = 3,
+  CONFSEQ_INTERNAL_ERROR = 4
+} confseq_status;
+
+CONFSEQ_API int confseq_api_version(void);
+CONFSEQ_API const char* confseq_status_string(confseq_status status);
+/* Description of the calling thread's most recent failure, or "". */
+CONFSEQ_API const char* confseq_last_error(void);
+
+/* Threads used by batch functions; see confseq::set_num_threads. */
+CONFSEQ_API confseq_status confseq_set_num_threads(int num_threads);
+CONFSEQ_API int confseq_get_num_threads(void);
+
+/*
+ * Mixture supermartingales, tuned to optimize the boundary with crossing
+ * probability alpha_opt at intrinsic time v_opt.
+ */
+typedef struct confseq_mixture confseq_mixture;
+
+CONFSEQ_API confseq_status confseq_two_sided_normal_mixture_new(
+    double v_opt, double alpha_opt, confseq_mixture** out);
+CONFSEQ_API confseq_status confseq_one_sided_normal_mixture_new(
+    double v_opt, double alpha_opt, confseq_mixture** out);
+CONFSEQ_API confseq_status confseq_gamma_exponential_mixture_new(
+    double v_opt, double alpha_opt, double c, confseq_mixture** out);
+CONFSEQ_API confseq_status confseq_gamma_poisson_mixture_new(
+    double v_opt, double alpha_opt, double c, confseq_mixture** out);
+CONFSEQ_API confseq_status confseq_beta_binomial_mixture_new(
+    double v_opt, double alpha_opt, double g, double h, int is_one_sided,
+    confseq_mixture** out);
+CONFSEQ_API void confseq_mixture_free(confseq_mixture* mixture);
+
+/* Bits of relative accuracy of the root searches, 40 by default. With
+ * conservative nonzero, reduced precision widens bounds but never narrows
+ * them. */
+CONFSEQ_API confseq_status confseq_mixture_set_precision(
+    confseq_mixture* mixture, int bits, int conservative);
+
+/* out[i] = log m(s[i], v[i]) for i < n. */
+CONFSEQ_API confseq_status confseq_mixture_log_superMG(
+    const confseq_mixture* mixture, const double* s, const double* v,
+    size_t n, double* out);
+/* out[i] = the uniform boundary at intrinsic time v[i] with crossing
+ * probability alpha. */
+CONFSEQ_API confseq_status confseq_mixture_bound(
+    const confseq_mixture* mixture, const double* v, size_t n, double alpha,
+    double* out);
+/* As confseq_mixture_bound, warm-starting each root search from the previous
+ * one, which is fastest for sorted v. Runs on the calling thread. */
+CONFSEQ_API confseq_status confseq_mixture_bound_sequence(
+    const confseq_mixture* mixture, const double* v, size_t n, double alpha,
+    double* out);
+
+/* Uniform boundaries evaluated at intrinsic time v and crossing probability
+ * alpha. */
+typedef struct confseq_boundary confseq_boundary;
+
+/* The boundary of a copy of mixture, consulting the boundary cache when it is
+ * enabled. */
+CONFSEQ_API confseq_status confseq_mixture_boundary_new(
+    const confseq_mixture* mixture, confseq_boundary** out);
+CONFSEQ_API confseq_status confseq_poly_stitching_boundary_new(
+    double v_min, double c, double s, double eta, confseq_boundary** out);
+CONFSEQ_API void confseq_boundary_free(confseq_boundary* boundary);
+CONFSEQ_API confseq_status confseq_boundary_evaluate(
+    const confseq_boundary* boundary, const double* v, size_t n, double alpha,
+    double* out);
+
+/* Streaming confidence sequence for the mean of [0, 1]-valued observations. */
+typedef struct confseq_bernoulli_cs confseq_bernoulli_cs;
+
+CONFSEQ_API confseq_status confseq_bernoulli_cs_new(
+    double alpha, double t_opt, double alpha_opt, int running_intersection,
+    confseq_bernoulli_cs** out);
+CONFSEQ_API void confseq_bernoulli_cs_free(confseq_bernoulli_cs* cs);
+/* Applies n updates in order, the i-th adding num_trials[i] observations
+ * summing to num_successes[i], and writes the interval after each. */
+CONFSEQ_API confseq_status confseq_bernoulli_cs_update(
+    confseq_bernoulli_cs* cs, const double* num_successes,
+    const int* num_trials, size_t n, double* lower, double* upper);
+CONFSEQ_API confseq_status confseq_bernoulli_cs_interval(
+    const confseq_bernoulli_cs* cs, double* lower, double* upper);
+
+/* Independent intervals for n (num_successes, num_trials) pairs, computed
+ * across threads. */
+CONFSEQ_API confseq_status confseq_bernoulli_confidence_intervals(
+    const double* num_successes, const int* num_trials, size_t n, double alpha,
+    double t_opt, double alpha_opt, double* lower, double* upper);
+
+/* Sequential two-sample test of equal quantile_p-quantiles. Arms are 1 and
+ * 2. Adding values may allocate; p-values do not. */
+typedef struct confseq_quantile_ab_test confseq_quantile_ab_test;
+
+CONFSEQ_API confseq_status confseq_quantile_ab_test_new(
+    double quantile_p, int t_opt, double alpha_opt,
+    confseq_quantile_ab_test** out);
+CONFSEQ_API void confseq_quantile_ab_test_free(confseq_quantile_ab_test* test);
+CONFSEQ_API confseq_status confseq_quantile_ab_test_add(
+    confseq_quantile_ab_test* test, int arm, const double* values, size_t n);
+/* p-value given all observations so far, or 1 while either arm is empty. With
+ * running nonzero, the minimum over every evaluation so far. */
+CONFSEQ_API confseq_status confseq_quantile_ab_test_p_value(
+    confseq_quantile_ab_test* test, int running, double* p_value);
+
+/*
+ * Columnar entry points over the Arrow C data interface, for data held in
+ * Arrow or Parquet. Input columns are chunked: num_chunks arrays described by
+ * one schema, read in place and never released. Numeric columns may be
+ * float64, float32, int64 or int32 ("g", "f", "l" or "i"), and null entries
+ * give null results. Chunks are split into blocks evaluated across threads.
+ *
+ * Each result column is written as a float64 schema and one array per input
+ * chunk into caller-provided structs, and the caller owns them: release each
+ * with its release callback, or move it to an Arrow importer. On failure
+ * nothing is written and nothing needs releasing.
+ */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+  void (*release)(struct ArrowSchema*);
+  void* private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+  void (*release)(struct ArrowArray*);
+  void* private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
+typedef struct {
+  const struct ArrowSchema* schema;
+  const struct ArrowArray* const* chunks;
+  size_t num_chunks;
+} confseq_arrow_column;
+
+/* schema and chunks[0 .. num_chunks) are filled by the library, with
+ * num_chunks that of the input column. */
+typedef struct {
+  struct ArrowSchema* schema;
+  struct ArrowArray* chunks;
+} confseq_arrow_result;
+
+/* out = the boundary at each intrinsic time in v. */
+CONFSEQ_API confseq_status confseq_arrow_boundary_evaluate(
+    const confseq_boundary* boundary, const confseq_arrow_column* v,
+    double alpha, confseq_arrow_result* out);
+
+/* As confseq_bernoulli_confidence_intervals, row by row. The two columns
+ * must be chunked alike, and num_trials must hold positive integers. */
+CONFSEQ_API confseq_status confseq_arrow_bernoulli_confidence_intervals(
+    const confseq_arrow_column* num_successes,
+    const confseq_arrow_column* num_trials, double alpha, double t_opt,
+    double alpha_opt, confseq_arrow_result* lower,
+    confseq_arrow_result* upper);
+
+/* Parameters of the confidence sequences of
+ * confseq_arrow_confidence_sequences, as for confseq::StreamCSParams. kind is
+ * "predmix_empbern", "predmix_hoeffding", "predmix_empbern_wor",
+ * "predmix_hoeffding_wor", "conjmix_hoeffding", "conjmix_empbern" or
+ * "hedged". Fields not used by the kind are ignored. */
+typedef struct {
+  const char* kind;
+  double alpha;
+  int running_intersection;
+  double truncation;
+  double fixed_n;
+  double t_opt;
+  double v_opt;
+  double lower_bd;
+  double upper_bd;
+  double N;
+  int breaks;
+  double theta;
+  double trunc_scale;
+} confseq_stream_cs_params;
+
+/* Fills params with the defaults of confseq::StreamCSParams. */
+CONFSEQ_API void confseq_stream_cs_params_init(
+    confseq_stream_cs_params* params);
+
+/* Confidence sequences for a column of streams: each entry of streams is a
+ * list ("+l") of numeric observations without nulls, and lower and upper are
+ * lists of float64 bounds with the same offsets. Null lists give null
+ * results. Streams are spread across threads. */
+CONFSEQ_API confseq_status confseq_arrow_confidence_sequences(
+    const confseq_arrow_column* streams,
+    const confseq_stream_cs_params* params, confseq_arrow_result* lower,
+    confseq_arrow_result* upper);
+
+/* p-value of the fixed-sample quantile A/B test on two columns of arm
+ * values, skipping nulls. Values are copied to be sorted, and each arm needs
+ * at least one. */
+CONFSEQ_API confseq_status confseq_arrow_quantile_ab_p_value(
+    const confseq_arrow_column* arm1, const confseq_arrow_column* arm2,
+    double quantile_p, int t_opt, double alpha_opt, double* p_value);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* CONFIDENCESEQUENCES_CONFSEQ_H_ */
@@ -0,0 +1,1086 @@
+// Implementation of the C interface in confseq.h. Each entry point checks its
+// arguments before calling into uniform_boundaries.h, whose own checks are
+// asserts, and converts any exception into a confseq_status.
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "confseq.h"
+#include "uniform_boundaries.h"
+
+struct confseq_mixture {
+  std::unique_ptr<confseq::MixtureSupermartingale> mixture;
+};
+
+struct confseq_boundary {
+  std::unique_ptr<confseq::MixtureBoundary> mixture_boundary;
+  std::unique_ptr<confseq::PolyStitchingBound> poly_stitching_bound;
+
+  double operator()(const double v, const double alpha) const {
+    return mixture_boundary ? (*mixture_boundary)(v, alpha)
+        : (*poly_stitching_bound)(v, alpha);
+  }
+};
+
+struct confseq_bernoulli_cs {
+  confseq::BernoulliConfidenceSequence cs;
+};
+
+struct confseq_quantile_ab_test {
+  confseq::SequentialQuantileABTest test;
+};
+
+namespace {
+
+std::string& last_error() {
+  static thread_local std::string error;
+  return error;
+}
+
+confseq_status fail(const confseq_status status, const char* message) {
+  last_error() = message;
+  return status;
+}
+
+// Runs fn, which returns a confseq_status, mapping exceptions to statuses.
+template <class Fn>
+confseq_status guard(Fn fn) {
+  try {
+    return fn();
+  } catch (const std::bad_alloc&) {
+    return fail(CONFSEQ_OUT_OF_MEMORY, "out of memory");
+  } catch (const std::logic_error& e) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, e.what());
+  } catch (const std::exception& e) {
+    return fail(CONFSEQ_NUMERICAL_ERROR, e.what());
+  } catch (...) {
+    return fail(CONFSEQ_INTERNAL_ERROR, "unknown exception");
+  }
+}
+
+bool is_probability(const double alpha) {
+  return 0 < alpha && alpha < 1;
+}
+
+bool is_positive(const double x) {
+  return x > 0 && std::isfinite(x);
+}
+
+confseq_status check_mixture_tuning(const double v_opt,
+                                    const double alpha_opt) {
+  if (!is_positive(v_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "v_opt must be positive");
+  }
+  if (!is_probability(alpha_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "alpha_opt must be in (0, 1)");
+  }
+  return CONFSEQ_OK;
+}
+
+template <class Mixture, class... Args>
+confseq_status new_mixture(confseq_mixture** out, const Args... args) {
+  if (!out) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "out must not be null");
+  }
+  *out = nullptr;
+  return guard([&]() {
+    std::unique_ptr<confseq_mixture> handle(new confseq_mixture);
+    handle->mixture.reset(new Mixture(args...));
+    *out = handle.release();
+    return CONFSEQ_OK;
+  });
+}
+
+template <class Mixture>
+bool clone_as(const confseq::MixtureSupermartingale& mixture,
+              std::unique_ptr<confseq::MixtureSupermartingale>& out) {
+  const Mixture* concrete = dynamic_cast<const Mixture*>(&mixture);
+  if (concrete) {
+    out.reset(new Mixture(*concrete));
+  }
+  return concrete != nullptr;
+}
+
+std::unique_ptr<confseq::MixtureSupermartingale> clone_mixture(
+    const confseq::MixtureSupermartingale& mixture) {
+  std::unique_ptr<confseq::MixtureSupermartingale> copy;
+  clone_as<confseq::TwoSidedNormalMixture>(mixture, copy)
+      || clone_as<confseq::OneSidedNormalMixture>(mixture, copy)
+      || clone_as<confseq::GammaExponentialMixture>(mixture, copy)
+      || clone_as<confseq::GammaPoissonMixture>(mixture, copy)
+      || clone_as<confseq::BetaBinomialMixture>(mixture, copy);
+  if (!copy) {
+    throw std::logic_error("unknown mixture type");
+  }
+  copy->set_precision(mixture.precision());
+  return copy;
+}
+
+// Buffers of n elements may be null only when n is zero.
+confseq_status check_buffers(const size_t n, const void* a, const void* b,
+                             const void* c) {
+  if (n > 0 && (!a || !b || !c)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "buffers must not be null");
+  }
+  return CONFSEQ_OK;
+}
+
+confseq_status check_buffers(const size_t n, const void* a, const void* b) {
+  return check_buffers(n, a, b, a);
+}
+
+confseq_status check_bernoulli_update(const double num_successes,
+                                      const int num_trials) {
+  if (num_trials < 0 || !(0 <= num_successes && num_successes <= num_trials)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "need 0 <= num_successes <= num_trials");
+  }
+  return CONFSEQ_OK;
+}
+
+} // namespace
+
+#define CONFSEQ_RETURN_IF_ERROR(expr)                                          \
+  do {                                                                         \
+    const confseq_status status_ = (expr);                                     \
+    if (status_ != CONFSEQ_OK) {                                               \
+      return status_;                                                          \
+    }                                                                          \
+  } while (0)
+
+namespace {
+
+// A numeric chunk of an Arrow column, read in place.
+struct NumericChunk {
+  char format;
+  const void* data;
+  // Null when every entry is valid.
+  const uint8_t* validity;
+  int64_t offset;
+  int64_t length;
+
+  bool is_valid(const int64_t i) const {
+    const int64_t bit = offset + i;
+    return !validity || ((validity[bit >> 3] >> (bit & 7)) & 1);
+  }
+
+  double operator[](const int64_t i) const {
+    switch (format) {
+    case 'g':
+      return static_cast<const double*>(data)[offset + i];
+    case 'f':
+      return static_cast<const float*>(data)[offset + i];
+    case 'l':
+      return double(static_cast<const int64_t*>(data)[offset + i]);
+    default:
+      return static_cast<const int32_t*>(data)[offset + i];
+    }
+  }
+};
+
+bool is_numeric_format(const char* format) {
+  return format && format[0] != '\0' && format[1] == '\0'
+      && strchr("gfli", format[0]);
+}
+
+// Checks the parts of an Arrow array common to every layout read here.
+confseq_status check_arrow_array(const ArrowArray* array,
+                                 const int64_t n_children) {
+  if (!array || !array->release || array->length < 0 || array->offset < 0
+      || array->n_buffers != 2 || !array->buffers
+      || (array->length > 0 && !array->buffers[1])
+      || array->n_children != n_children
+      || (n_children > 0 && (!array->children || !array->children[0]))
+      || array->dictionary) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "invalid or unsupported Arrow array");
+  }
+  return CONFSEQ_OK;
+}
+
+const uint8_t* validity_bitmap(const ArrowArray* array) {
+  return array->null_count == 0
+      ? nullptr : static_cast<const uint8_t*>(array->buffers[0]);
+}
+
+confseq_status numeric_chunk(const ArrowArray* array, const char format,
+                             NumericChunk* out) {
+  CONFSEQ_RETURN_IF_ERROR(check_arrow_array(array, 0));
+  *out = NumericChunk{format, array->buffers[1], validity_bitmap(array),
+                      array->offset, array->length};
+  return CONFSEQ_OK;
+}
+
+confseq_status check_column(const confseq_arrow_column* column) {
+  if (!column || !column->schema || !column->schema->format
+      || column->schema->dictionary
+      || (column->num_chunks > 0 && !column->chunks)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "invalid Arrow column");
+  }
+  return CONFSEQ_OK;
+}
+
+confseq_status read_numeric_column(const confseq_arrow_column* column,
+                                   std::vector<NumericChunk>* chunks) {
+  CONFSEQ_RETURN_IF_ERROR(check_column(column));
+  if (!is_numeric_format(column->schema->format)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "column must be float64, float32, int64 or int32");
+  }
+  chunks->resize(column->num_chunks);
+  for (size_t c = 0; c < column->num_chunks; c++) {
+    CONFSEQ_RETURN_IF_ERROR(numeric_chunk(
+        column->chunks[c], column->schema->format[0], &(*chunks)[c]));
+  }
+  return CONFSEQ_OK;
+}
+
+confseq_status check_result(const confseq_arrow_result* result,
+                            const size_t num_chunks) {
+  if (!result || !result->schema || (num_chunks > 0 && !result->chunks)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "result must not be null");
+  }
+  return CONFSEQ_OK;
+}
+
+// Calls fn(chunk, begin, end) over blocks of every chunk, across threads.
+template <class Fn>
+void for_each_block(const std::vector<int64_t>& lengths, Fn fn) {
+  const int64_t block_size = 256;
+  std::vector<std::pair<size_t, int64_t>> blocks;
+  for (size_t c = 0; c < lengths.size(); c++) {
+    for (int64_t begin = 0; begin < lengths[c]; begin += block_size) {
+      blocks.emplace_back(c, begin);
+    }
+  }
+  confseq::parallel_for(blocks.size(), [&](const size_t b) {
+    const size_t c = blocks[b].first;
+    const int64_t begin = blocks[b].second;
+    fn(c, begin, std::min(lengths[c], begin + block_size));
+  }, 0, 1);
+}
+
+// A validity bitmap of length bits from valid(i), and its null count. The
+// bitmap stays empty when nothing is null.
+template <class Valid>
+int64_t make_validity(const int64_t length, Valid valid,
+                      std::vector<uint8_t>* bitmap) {
+  bitmap->assign((length + 7) / 8, 0);
+  int64_t null_count = 0;
+  for (int64_t i = 0; i < length; i++) {
+    if (valid(i)) {
+      (*bitmap)[i >> 3] |= uint8_t(1 << (i & 7));
+    } else {
+      null_count++;
+    }
+  }
+  if (null_count == 0) {
+    bitmap->clear();
+  }
+  return null_count;
+}
+
+// A float64 Arrow array owning its buffers.
+struct DoubleChunk {
+  std::vector<double> values;
+  std::vector<uint8_t> validity;
+  int64_t null_count = 0;
+  const void* buffers[2];
+};
+
+void release_double_chunk(ArrowArray* array) {
+  delete static_cast<DoubleChunk*>(array->private_data);
+  array->release = nullptr;
+}
+
+template <class Valid>
+std::unique_ptr<DoubleChunk> new_double_chunk(const int64_t length,
+                                              Valid valid) {
+  std::unique_ptr<DoubleChunk> chunk(new DoubleChunk);
+  chunk->values.assign(length, std::numeric_limits<double>::quiet_NaN());
+  chunk->null_count = make_validity(length, valid, &chunk->validity);
+  return chunk;
+}
+
+void export_double_chunk(std::unique_ptr<DoubleChunk> chunk, ArrowArray* out) {
+  DoubleChunk* owned = chunk.release();
+  owned->buffers[0] = owned->validity.empty() ? nullptr
+      : owned->validity.data();
+  owned->buffers[1] = owned->values.data();
+  *out = ArrowArray{int64_t(owned->values.size()), owned->null_count, 0, 2, 0,
+                    owned->buffers, nullptr, nullptr, &release_double_chunk,
+                    owned};
+}
+
+// A list-of-float64 Arrow array owning its offsets and values.
+struct ListChunk {
+  std::vector<int32_t> offsets;
+  std::vector<uint8_t> validity;
+  int64_t null_count = 0;
+  const void* buffers[2];
+  ArrowArray child;
+  ArrowArray* children[1];
+};
+
+void release_list_chunk(ArrowArray* array) {
+  ListChunk* owned = static_cast<ListChunk*>(array->private_data);
+  if (owned->child.release) {
+    owned->child.release(&owned->child);
+  }
+  delete owned;
+  array->release = nullptr;
+}
+
+void export_list_chunk(std::unique_ptr<ListChunk> chunk,
+                       std::unique_ptr<DoubleChunk> values, ArrowArray* out) {
+  ListChunk* owned = chunk.release();
+  export_double_chunk(std::move(values), &owned->child);
+  owned->children[0] = &owned->child;
+  owned->buffers[0] = owned->validity.empty() ? nullptr
+      : owned->validity.data();
+  owned->buffers[1] = owned->offsets.data();
+  *out = ArrowArray{int64_t(owned->offsets.size() - 1), owned->null_count, 0,
+                    2, 1, owned->buffers, owned->children, nullptr,
+                    &release_list_chunk, owned};
+}
+
+void release_static_schema(ArrowSchema* schema) {
+  schema->release = nullptr;
+}
+
+ArrowSchema double_schema(const char* name) {
+  return ArrowSchema{"g", name, nullptr, ARROW_FLAG_NULLABLE, 0, nullptr,
+                     nullptr, &release_static_schema, nullptr};
+}
+
+struct ListSchema {
+  ArrowSchema child;
+  ArrowSchema* children[1];
+};
+
+void release_list_schema(ArrowSchema* schema) {
+  ListSchema* owned = static_cast<ListSchema*>(schema->private_data);
+  if (owned->child.release) {
+    owned->child.release(&owned->child);
+  }
+  delete owned;
+  schema->release = nullptr;
+}
+
+void export_list_schema(ArrowSchema* out) {
+  ListSchema* owned = new ListSchema;
+  owned->child = double_schema("item");
+  owned->children[0] = &owned->child;
+  *out = ArrowSchema{"+l", "", nullptr, ARROW_FLAG_NULLABLE, 1,
+                     owned->children, nullptr, &release_list_schema, owned};
+}
+
+void export_double_results(std::vector<std::unique_ptr<DoubleChunk>>& chunks,
+                           confseq_arrow_result* out) {
+  for (size_t c = 0; c < chunks.size(); c++) {
+    export_double_chunk(std::move(chunks[c]), &out->chunks[c]);
+  }
+  *out->schema = double_schema("");
+}
+
+// A chunk of a list column of numeric streams, read in place.
+struct StreamChunk {
+  NumericChunk values;
+  // length + 1 offsets into values.
+  const int32_t* offsets;
+  const uint8_t* validity;
+  int64_t offset;
+  int64_t length;
+
+  bool is_valid(const int64_t i) const {
+    const int64_t bit = offset + i;
+    return !validity || ((validity[bit >> 3] >> (bit & 7)) & 1);
+  }
+};
+
+confseq_status read_stream_column(const confseq_arrow_column* column,
+                                  std::vector<StreamChunk>* chunks) {
+  CONFSEQ_RETURN_IF_ERROR(check_column(column));
+  const ArrowSchema* schema = column->schema;
+  if (strcmp(schema->format, "+l") != 0 || schema->n_children != 1
+      || !schema->children || !schema->children[0]
+      || !is_numeric_format(schema->children[0]->format)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "streams must be a list of float64, float32, int64 or int32");
+  }
+  const char format = schema->children[0]->format[0];
+  chunks->resize(column->num_chunks);
+  for (size_t c = 0; c < column->num_chunks; c++) {
+    const ArrowArray* array = column->chunks[c];
+    CONFSEQ_RETURN_IF_ERROR(check_arrow_array(array, 1));
+    if (!array->buffers[1]) {
+      return fail(CONFSEQ_INVALID_ARGUMENT, "list offsets must not be null");
+    }
+    StreamChunk& chunk = (*chunks)[c];
+    CONFSEQ_RETURN_IF_ERROR(numeric_chunk(array->children[0], format,
+                                          &chunk.values));
+    chunk.offsets = static_cast<const int32_t*>(array->buffers[1])
+        + array->offset;
+    chunk.validity = validity_bitmap(array);
+    chunk.offset = array->offset;
+    chunk.length = array->length;
+    bool valid = chunk.offsets[0] >= 0
+        && chunk.offsets[chunk.length] <= chunk.values.length;
+    for (int64_t i = 0; valid && i < chunk.length; i++) {
+      valid = chunk.offsets[i] <= chunk.offsets[i + 1];
+    }
+    if (!valid) {
+      return fail(CONFSEQ_INVALID_ARGUMENT, "invalid list offsets");
+    }
+    for (int64_t i = chunk.offsets[0]; i < chunk.offsets[chunk.length]; i++) {
+      if (!chunk.values.is_valid(i)) {
+        return fail(CONFSEQ_INVALID_ARGUMENT,
+                    "stream observations must not be null");
+      }
+    }
+  }
+  return CONFSEQ_OK;
+}
+
+// The valid entries of a numeric column, in order.
+std::vector<double> gather_valid(const std::vector<NumericChunk>& chunks) {
+  std::vector<double> values;
+  for (const NumericChunk& chunk : chunks) {
+    for (int64_t i = 0; i < chunk.length; i++) {
+      if (chunk.is_valid(i)) {
+        values.push_back(chunk[i]);
+      }
+    }
+  }
+  return values;
+}
+
+} // namespace
+
+extern "C" {
+
+int confseq_api_version(void) {
+  return CONFSEQ_API_VERSION;
+}
+
+const char* confseq_status_string(const confseq_status status) {
+  switch (status) {
+  case CONFSEQ_OK:
+    return "ok";
+  case CONFSEQ_INVALID_ARGUMENT:
+    return "invalid argument";
+  case CONFSEQ_OUT_OF_MEMORY:
+    return "out of memory";
+  case CONFSEQ_NUMERICAL_ERROR:
+    return "numerical error";
+  case CONFSEQ_INTERNAL_ERROR:
+    return "internal error";
+  }
+  return "unknown status";
+}
+
+const char* confseq_last_error(void) {
+  return last_error().c_str();
+}
+
+confseq_status confseq_set_num_threads(const int num_threads) {
+  if (num_threads < 1) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "num_threads must be at least 1");
+  }
+  return guard([num_threads]() {
+    confseq::set_num_threads(num_threads);
+    return CONFSEQ_OK;
+  });
+}
+
+int confseq_get_num_threads(void) {
+  return confseq::get_num_threads();
+}
+
+confseq_status confseq_two_sided_normal_mixture_new(
+    const double v_opt, const double alpha_opt, confseq_mixture** out) {
+  CONFSEQ_RETURN_IF_ERROR(check_mixture_tuning(v_opt, alpha_opt));
+  return new_mixture<confseq::TwoSidedNormalMixture>(out, v_opt, alpha_opt);
+}
+
+confseq_status confseq_one_sided_normal_mixture_new(
+    const double v_opt, const double alpha_opt, confseq_mixture** out) {
+  CONFSEQ_RETURN_IF_ERROR(check_mixture_tuning(v_opt, alpha_opt));
+  return new_mixture<confseq::OneSidedNormalMixture>(out, v_opt, alpha_opt);
+}
+
+confseq_status confseq_gamma_exponential_mixture_new(
+    const double v_opt, const double alpha_opt, const double c,
+    confseq_mixture** out) {
+  CONFSEQ_RETURN_IF_ERROR(check_mixture_tuning(v_opt, alpha_opt));
+  if (!is_positive(c)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "c must be positive");
+  }
+  return new_mixture<confseq::GammaExponentialMixture>(out, v_opt, alpha_opt,
+                                                       c);
+}
+
+confseq_status confseq_gamma_poisson_mixture_new(
+    const double v_opt, const double alpha_opt, const double c,
+    confseq_mixture** out) {
+  CONFSEQ_RETURN_IF_ERROR(check_mixture_tuning(v_opt, alpha_opt));
+  if (!is_positive(c)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "c must be positive");
+  }
+  return new_mixture<confseq::GammaPoissonMixture>(out, v_opt, alpha_opt, c);
+}
+
+confseq_status confseq_beta_binomial_mixture_new(
+    const double v_opt, const double alpha_opt, const double g, const double h,
+    const int is_one_sided, confseq_mixture** out) {
+  CONFSEQ_RETURN_IF_ERROR(check_mixture_tuning(v_opt, alpha_opt));
+  if (!is_positive(g) || !is_positive(h)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "g and h must be positive");
+  }
+  return new_mixture<confseq::BetaBinomialMixture>(out, v_opt, alpha_opt, g, h,
+                                                   is_one_sided != 0);
+}
+
+void confseq_mixture_free(confseq_mixture* mixture) {
+  delete mixture;
+}
+
+confseq_status confseq_mixture_set_precision(confseq_mixture* mixture,
+                                             const int bits,
+                                             const int conservative) {
+  if (!mixture) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "mixture must not be null");
+  }
+  if (bits < 1 || bits > 53) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "bits must be in [1, 53]");
+  }
+  confseq::SolverPrecision precision;
+  precision.bits = bits;
+  precision.conservative = conservative != 0;
+  mixture->mixture->set_precision(precision);
+  return CONFSEQ_OK;
+}
+
+confseq_status confseq_mixture_log_superMG(const confseq_mixture* mixture,
+                                           const double* s, const double* v,
+                                           const size_t n, double* out) {
+  if (!mixture) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "mixture must not be null");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, s, v, out));
+  return guard([&]() {
+    mixture->mixture->log_superMG(s, v, n, out);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_mixture_bound(const confseq_mixture* mixture,
+                                     const double* v, const size_t n,
+                                     const double alpha, double* out) {
+  if (!mixture) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "mixture must not be null");
+  }
+  if (!is_probability(alpha)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "alpha must be in (0, 1)");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, v, out));
+  return guard([&]() {
+    const confseq::MixtureSupermartingale& superMG = *mixture->mixture;
+    const double log_threshold = log(1 / alpha);
+    confseq::parallel_for(n, [&](const size_t i) {
+      out[i] = superMG.bound(v[i], log_threshold);
+    }, 0, 64);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_mixture_bound_sequence(const confseq_mixture* mixture,
+                                              const double* v, const size_t n,
+                                              const double alpha,
+                                              double* out) {
+  if (!mixture) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "mixture must not be null");
+  }
+  if (!is_probability(alpha)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "alpha must be in (0, 1)");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, v, out));
+  return guard([&]() {
+    mixture->mixture->bound_sequence(v, n, log(1 / alpha), out);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_mixture_boundary_new(const confseq_mixture* mixture,
+                                            confseq_boundary** out) {
+  if (!mixture || !out) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "mixture and out must not be null");
+  }
+  *out = nullptr;
+  return guard([&]() {
+    std::unique_ptr<confseq_boundary> handle(new confseq_boundary);
+    handle->mixture_boundary.reset(
+        new confseq::MixtureBoundary(clone_mixture(*mixture->mixture)));
+    *out = handle.release();
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_poly_stitching_boundary_new(const double v_min,
+                                                   const double c,
+                                                   const double s,
+                                                   const double eta,
+                                                   confseq_boundary** out) {
+  if (!out) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "out must not be null");
+  }
+  *out = nullptr;
+  if (!is_positive(v_min)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "v_min must be positive");
+  }
+  if (!(c >= 0) || !(s > 1) || !(eta > 1)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "need c >= 0, s > 1 and eta > 1");
+  }
+  return guard([&]() {
+    std::unique_ptr<confseq_boundary> handle(new confseq_boundary);
+    handle->poly_stitching_bound.reset(
+        new confseq::PolyStitchingBound(v_min, c, s, eta));
+    *out = handle.release();
+    return CONFSEQ_OK;
+  });
+}
+
+void confseq_boundary_free(confseq_boundary* boundary) {
+  delete boundary;
+}
+
+confseq_status confseq_boundary_evaluate(const confseq_boundary* boundary,
+                                         const double* v, const size_t n,
+                                         const double alpha, double* out) {
+  if (!boundary) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "boundary must not be null");
+  }
+  if (!is_probability(alpha)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "alpha must be in (0, 1)");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, v, out));
+  return guard([&]() {
+    confseq::parallel_for(n, [&](const size_t i) {
+      out[i] = (*boundary)(v[i], alpha);
+    }, 0, 64);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_bernoulli_cs_new(const double alpha, const double t_opt,
+                                        const double alpha_opt,
+                                        const int running_intersection,
+                                        confseq_bernoulli_cs** out) {
+  if (!out) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "out must not be null");
+  }
+  *out = nullptr;
+  if (!is_probability(alpha) || !is_probability(alpha_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "alpha and alpha_opt must be in (0, 1)");
+  }
+  if (!is_positive(t_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "t_opt must be positive");
+  }
+  return guard([&]() {
+    *out = new confseq_bernoulli_cs{confseq::BernoulliConfidenceSequence(
+        alpha, t_opt, alpha_opt, running_intersection != 0)};
+    return CONFSEQ_OK;
+  });
+}
+
+void confseq_bernoulli_cs_free(confseq_bernoulli_cs* cs) {
+  delete cs;
+}
+
+confseq_status confseq_bernoulli_cs_update(confseq_bernoulli_cs* cs,
+                                           const double* num_successes,
+                                           const int* num_trials,
+                                           const size_t n, double* lower,
+                                           double* upper) {
+  if (!cs) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "cs must not be null");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, num_successes, num_trials));
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, lower, upper));
+  // Every update is checked before any is applied, so that a bad entry leaves
+  // the sequence unchanged.
+  for (size_t i = 0; i < n; i++) {
+    CONFSEQ_RETURN_IF_ERROR(check_bernoulli_update(num_successes[i],
+                                                   num_trials[i]));
+  }
+  return guard([&]() {
+    for (size_t i = 0; i < n; i++) {
+      const std::pair<double, double> interval =
+          cs->cs.update(num_successes[i], num_trials[i]);
+      lower[i] = interval.first;
+      upper[i] = interval.second;
+    }
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_bernoulli_cs_interval(const confseq_bernoulli_cs* cs,
+                                             double* lower, double* upper) {
+  if (!cs || !lower || !upper) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "arguments must not be null");
+  }
+  const std::pair<double, double> interval = cs->cs.interval();
+  *lower = interval.first;
+  *upper = interval.second;
+  return CONFSEQ_OK;
+}
+
+confseq_status confseq_bernoulli_confidence_intervals(
+    const double* num_successes, const int* num_trials, const size_t n,
+    const double alpha, const double t_opt, const double alpha_opt,
+    double* lower, double* upper) {
+  if (!is_probability(alpha) || !is_probability(alpha_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "alpha and alpha_opt must be in (0, 1)");
+  }
+  if (!is_positive(t_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "t_opt must be positive");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, num_successes, num_trials));
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, lower, upper));
+  for (size_t i = 0; i < n; i++) {
+    CONFSEQ_RETURN_IF_ERROR(check_bernoulli_update(num_successes[i],
+                                                   num_trials[i]));
+    if (num_trials[i] == 0) {
+      return fail(CONFSEQ_INVALID_ARGUMENT, "num_trials must be positive");
+    }
+  }
+  return guard([&]() {
+    confseq::parallel_for(n, [&](const size_t i) {
+      const std::pair<double, double> interval =
+          confseq::bernoulli_confidence_interval(
+              num_successes[i], num_trials[i], alpha, t_opt, alpha_opt);
+      lower[i] = interval.first;
+      upper[i] = interval.second;
+    }, 0, 16);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_quantile_ab_test_new(const double quantile_p,
+                                            const int t_opt,
+                                            const double alpha_opt,
+                                            confseq_quantile_ab_test** out) {
+  if (!out) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "out must not be null");
+  }
+  *out = nullptr;
+  if (!is_probability(quantile_p) || !is_probability(alpha_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "quantile_p and alpha_opt must be in (0, 1)");
+  }
+  if (t_opt < 1) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "t_opt must be at least 1");
+  }
+  return guard([&]() {
+    *out = new confseq_quantile_ab_test{
+        confseq::SequentialQuantileABTest(quantile_p, t_opt, alpha_opt)};
+    return CONFSEQ_OK;
+  });
+}
+
+void confseq_quantile_ab_test_free(confseq_quantile_ab_test* test) {
+  delete test;
+}
+
+confseq_status confseq_quantile_ab_test_add(confseq_quantile_ab_test* test,
+                                            const int arm,
+                                            const double* values,
+                                            const size_t n) {
+  if (!test) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "test must not be null");
+  }
+  if (arm != 1 && arm != 2) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "arm must be 1 or 2");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_buffers(n, values, values));
+  return guard([&]() {
+    test->test.add(arm, values, values + n);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_quantile_ab_test_p_value(confseq_quantile_ab_test* test,
+                                                const int running,
+                                                double* p_value) {
+  if (!test || !p_value) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "arguments must not be null");
+  }
+  return guard([&]() {
+    *p_value = running ? test->test.running_p_value() : test->test.p_value();
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_arrow_boundary_evaluate(
+    const confseq_boundary* boundary, const confseq_arrow_column* v,
+    const double alpha, confseq_arrow_result* out) {
+  if (!boundary) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "boundary must not be null");
+  }
+  if (!is_probability(alpha)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "alpha must be in (0, 1)");
+  }
+  std::vector<NumericChunk> chunks;
+  CONFSEQ_RETURN_IF_ERROR(read_numeric_column(v, &chunks));
+  CONFSEQ_RETURN_IF_ERROR(check_result(out, chunks.size()));
+  return guard([&]() {
+    std::vector<std::unique_ptr<DoubleChunk>> results(chunks.size());
+    std::vector<int64_t> lengths(chunks.size());
+    for (size_t c = 0; c < chunks.size(); c++) {
+      const NumericChunk& chunk = chunks[c];
+      results[c] = new_double_chunk(chunk.length, [&chunk](const int64_t i) {
+        return chunk.is_valid(i);
+      });
+      lengths[c] = chunk.length;
+    }
+    for_each_block(lengths, [&](const size_t c, const int64_t begin,
+                                const int64_t end) {
+      const NumericChunk& chunk = chunks[c];
+      double* values = results[c]->values.data();
+      for (int64_t i = begin; i < end; i++) {
+        if (chunk.is_valid(i)) {
+          values[i] = (*boundary)(chunk[i], alpha);
+        }
+      }
+    });
+    export_double_results(results, out);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_arrow_bernoulli_confidence_intervals(
+    const confseq_arrow_column* num_successes,
+    const confseq_arrow_column* num_trials, const double alpha,
+    const double t_opt, const double alpha_opt, confseq_arrow_result* lower,
+    confseq_arrow_result* upper) {
+  if (!is_probability(alpha) || !is_probability(alpha_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "alpha and alpha_opt must be in (0, 1)");
+  }
+  if (!is_positive(t_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "t_opt must be positive");
+  }
+  std::vector<NumericChunk> successes, trials;
+  CONFSEQ_RETURN_IF_ERROR(read_numeric_column(num_successes, &successes));
+  CONFSEQ_RETURN_IF_ERROR(read_numeric_column(num_trials, &trials));
+  bool aligned = successes.size() == trials.size();
+  for (size_t c = 0; aligned && c < successes.size(); c++) {
+    aligned = successes[c].length == trials[c].length;
+  }
+  if (!aligned) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "num_successes and num_trials must be chunked alike");
+  }
+  CONFSEQ_RETURN_IF_ERROR(check_result(lower, successes.size()));
+  CONFSEQ_RETURN_IF_ERROR(check_result(upper, successes.size()));
+  for (size_t c = 0; c < successes.size(); c++) {
+    for (int64_t i = 0; i < successes[c].length; i++) {
+      if (!successes[c].is_valid(i) || !trials[c].is_valid(i)) {
+        continue;
+      }
+      const double t = trials[c][i];
+      if (!(t >= 1 && t <= std::numeric_limits<int>::max()
+            && t == std::floor(t))) {
+        return fail(CONFSEQ_INVALID_ARGUMENT,
+                    "num_trials must be positive integers");
+      }
+      CONFSEQ_RETURN_IF_ERROR(check_bernoulli_update(successes[c][i],
+                                                     int(t)));
+    }
+  }
+  return guard([&]() {
+    std::vector<std::unique_ptr<DoubleChunk>> lower_results(successes.size()),
+        upper_results(successes.size());
+    std::vector<int64_t> lengths(successes.size());
+    for (size_t c = 0; c < successes.size(); c++) {
+      const NumericChunk& s = successes[c];
+      const NumericChunk& t = trials[c];
+      const auto valid = [&s, &t](const int64_t i) {
+        return s.is_valid(i) && t.is_valid(i);
+      };
+      lower_results[c] = new_double_chunk(s.length, valid);
+      upper_results[c] = new_double_chunk(s.length, valid);
+      lengths[c] = s.length;
+    }
+    for_each_block(lengths, [&](const size_t c, const int64_t begin,
+                                const int64_t end) {
+      const NumericChunk& s = successes[c];
+      const NumericChunk& t = trials[c];
+      for (int64_t i = begin; i < end; i++) {
+        if (s.is_valid(i) && t.is_valid(i)) {
+          const std::pair<double, double> interval =
+              confseq::bernoulli_confidence_interval(s[i], int(t[i]), alpha,
+                                                     t_opt, alpha_opt);
+          lower_results[c]->values[i] = interval.first;
+          upper_results[c]->values[i] = interval.second;
+        }
+      }
+    });
+    export_double_results(lower_results, lower);
+    export_double_results(upper_results, upper);
+    return CONFSEQ_OK;
+  });
+}
+
+void confseq_stream_cs_params_init(confseq_stream_cs_params* params) {
+  if (!params) {
+    return;
+  }
+  const confseq::StreamCSParams defaults;
+  params->kind = "predmix_empbern";
+  params->alpha = defaults.alpha;
+  params->running_intersection = defaults.running_intersection;
+  params->truncation = defaults.truncation;
+  params->fixed_n = defaults.fixed_n;
+  params->t_opt = defaults.t_opt;
+  params->v_opt = defaults.v_opt;
+  params->lower_bd = defaults.lower_bd;
+  params->upper_bd = defaults.upper_bd;
+  params->N = defaults.N;
+  params->breaks = defaults.breaks;
+  params->theta = defaults.theta;
+  params->trunc_scale = defaults.trunc_scale;
+}
+
+confseq_status confseq_arrow_confidence_sequences(
+    const confseq_arrow_column* streams,
+    const confseq_stream_cs_params* params, confseq_arrow_result* lower,
+    confseq_arrow_result* upper) {
+  if (!params || !params->kind) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "params must not be null");
+  }
+  std::vector<StreamChunk> chunks;
+  CONFSEQ_RETURN_IF_ERROR(read_stream_column(streams, &chunks));
+  CONFSEQ_RETURN_IF_ERROR(check_result(lower, chunks.size()));
+  CONFSEQ_RETURN_IF_ERROR(check_result(upper, chunks.size()));
+  return guard([&]() {
+    confseq::StreamCSParams cs_params;
+    cs_params.kind = confseq::stream_cs_kind(params->kind);
+    cs_params.alpha = params->alpha;
+    cs_params.running_intersection = params->running_intersection != 0;
+    cs_params.truncation = params->truncation;
+    cs_params.fixed_n = params->fixed_n;
+    cs_params.t_opt = params->t_opt;
+    cs_params.v_opt = params->v_opt;
+    cs_params.lower_bd = params->lower_bd;
+    cs_params.upper_bd = params->upper_bd;
+    cs_params.N = params->N;
+    cs_params.breaks = params->breaks;
+    cs_params.theta = params->theta;
+    cs_params.trunc_scale = params->trunc_scale;
+
+    std::vector<std::unique_ptr<ListChunk>> lower_lists(chunks.size()),
+        upper_lists(chunks.size());
+    std::vector<std::unique_ptr<DoubleChunk>> lower_values(chunks.size()),
+        upper_values(chunks.size());
+    for (size_t c = 0; c < chunks.size(); c++) {
+      const StreamChunk& chunk = chunks[c];
+      const int32_t first = chunk.offsets[0];
+      const int64_t num_values = chunk.offsets[chunk.length] - first;
+      const auto all_valid = [](const int64_t) { return true; };
+      lower_values[c] = new_double_chunk(num_values, all_valid);
+      upper_values[c] = new_double_chunk(num_values, all_valid);
+      for (std::unique_ptr<ListChunk>* list : {&lower_lists[c],
+                                               &upper_lists[c]}) {
+        list->reset(new ListChunk);
+        (*list)->offsets.resize(chunk.length + 1);
+        for (int64_t i = 0; i <= chunk.length; i++) {
+          (*list)->offsets[i] = chunk.offsets[i] - first;
+        }
+        (*list)->null_count = make_validity(
+            chunk.length,
+            [&chunk](const int64_t i) { return chunk.is_valid(i); },
+            &(*list)->validity);
+      }
+    }
+    // Chunks run in parallel, and batch_confidence_sequences spreads the
+    // streams of each across the same pool.
+    confseq::parallel_for(chunks.size(), [&](const size_t c) {
+      const StreamChunk& chunk = chunks[c];
+      const int32_t first = chunk.offsets[0];
+      const int64_t num_values = chunk.offsets[chunk.length] - first;
+      std::vector<double> converted;
+      const double* values;
+      if (chunk.values.format == 'g') {
+        values = static_cast<const double*>(chunk.values.data)
+            + chunk.values.offset + first;
+      } else {
+        converted.resize(num_values);
+        for (int64_t i = 0; i < num_values; i++) {
+          converted[i] = chunk.values[first + i];
+        }
+        values = converted.data();
+      }
+      std::vector<size_t> offsets(chunk.length + 1);
+      for (int64_t i = 0; i <= chunk.length; i++) {
+        offsets[i] = size_t(chunk.offsets[i] - first);
+      }
+      confseq::batch_confidence_sequences(
+          values, offsets.data(), chunk.length, cs_params,
+          lower_values[c]->values.data(), upper_values[c]->values.data());
+    }, 0, 1);
+
+    for (size_t c = 0; c < chunks.size(); c++) {
+      export_list_chunk(std::move(lower_lists[c]), std::move(lower_values[c]),
+                        &lower->chunks[c]);
+      export_list_chunk(std::move(upper_lists[c]), std::move(upper_values[c]),
+                        &upper->chunks[c]);
+    }
+    export_list_schema(lower->schema);
+    export_list_schema(upper->schema);
+    return CONFSEQ_OK;
+  });
+}
+
+confseq_status confseq_arrow_quantile_ab_p_value(
+    const confseq_arrow_column* arm1, const confseq_arrow_column* arm2,
+    const double quantile_p, const int t_opt, const double alpha_opt,
+    double* p_value) {
+  if (!p_value) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "p_value must not be null");
+  }
+  if (!is_probability(quantile_p) || !is_probability(alpha_opt)) {
+    return fail(CONFSEQ_INVALID_ARGUMENT,
+                "quantile_p and alpha_opt must be in (0, 1)");
+  }
+  if (t_opt < 1) {
+    return fail(CONFSEQ_INVALID_ARGUMENT, "t_opt must be at least 1");
+  }
+  std::vector<NumericChunk> arm1_chunks, arm2_chunks;
+  CONFSEQ_RETURN_IF_ERROR(read_numeric_column(arm1, &arm1_chunks));
+  CONFSEQ_RETURN_IF_ERROR(read_numeric_column(arm2, &arm2_chunks));
+  return guard([&]() {
+    const std::vector<double> arm1_values = gather_valid(arm1_chunks);
+    const std::vector<double> arm2_values = gather_valid(arm2_chunks);
+    if (arm1_values.empty() || arm2_values.empty()) {
+      return fail(CONFSEQ_INVALID_ARGUMENT, "each arm needs a value");
+    }
+    confseq::QuantileABTest test(
+        quantile_p, t_opt, alpha_opt,
+        std::make_shared<confseq::StaticOrderStatistics>(arm1_values.begin(),
+                                                         arm1_values.end()),
+        std::make_shared<confseq::StaticOrderStatistics>(arm2_values.begin(),
+                                                         arm2_values.end()));
+    *p_value = test.p_value();
+    return CONFSEQ_OK;
+  });
+}
+
+} // extern "C"
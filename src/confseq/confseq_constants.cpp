@@ -0,0 +1,35 @@
+// confseq-constants: writes the ConstantsBundle of uniform_boundaries.h for
+// the default hyperparameter grids to a file, at build or install time.
+// Processes that set CONFSEQ_CONSTANTS_BUNDLE to the file then map it on
+// first use, and their constructors read the constants rather than compute
+// them.
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+
+#include "uniform_boundaries.h"
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: confseq-constants OUTPUT\n");
+    return 2;
+  }
+  try {
+    const confseq::ConstantsBundle bundle =
+        confseq::ConstantsBundle::build(confseq::ConstantsBundleGrid());
+    const std::string path = argv[1];
+    std::ofstream out(path, std::ios::binary);
+    bundle.save(out);
+    out.close();
+    if (!out) {
+      throw std::runtime_error("Unable to write " + path);
+    }
+    std::printf("Wrote %zu constants to %s\n", bundle.size(), path.c_str());
+    return 0;
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "confseq-constants: %s\n", error.what());
+    return 1;
+  }
+}
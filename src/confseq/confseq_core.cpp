@@ -0,0 +1,12 @@
+// Out-of-line implementations of uniform_boundaries.h for the confseq_core
+// library. Users of the library compile with CONFSEQ_SEPARATE_COMPILATION and
+// see only declarations and templates.
+
+#define CONFSEQ_CORE_IMPLEMENTATION
+#include "uniform_boundaries.h"
+
+namespace confseq {
+
+CONFSEQ_ALL_MIXTURE_SOLVER_INSTANTIATIONS();
+
+}; // namespace confseq
@@ -0,0 +1,776 @@
+// confseq-cs: confidence sequences over a stream of records, as a pipeline
+// stage. Records are read from stdin as CSV or as fixed-width binary rows of
+// doubles, fed to one streaming confidence sequence of uniform_boundaries.h,
+// and a CSV row of bounds is written to stdout after every stride-th record
+// and after the last. Records between output rows are passed to the
+// accumulator in a single update, so with a large stride the cost per record
+// is parsing and a few flops. Output is flushed whenever the reader waits for
+// more input, so rows appear as soon as their records have arrived.
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+#else
+#include <unistd.h>
+#endif
+
+#include "uniform_boundaries.h"
+
+namespace {
+
+const char USAGE[] = R"(usage: confseq-cs --cs KIND [options] < records > bounds
+
+Kinds and the columns they read:
+  bernoulli            --column successes, --trials-column trials (optional;
+                       one trial per record if omitted)
+  quantile             --column values, for the --quantile level
+  ate                  --column outcomes, --treatment-column 0/1 indicators;
+                       average treatment effect at constant --propensity
+  predmix_empbern, predmix_hoeffding, predmix_empbern_wor,
+  predmix_hoeffding_wor, conjmix_empbern, conjmix_hoeffding, hedged
+                       --column observations of a bounded mean
+
+Input:
+  --format csv|binary  CSV text (default) or native-endian float64 rows
+  --no-header          CSV has no header row; columns are then 0-based indices
+  --delimiter C        CSV field delimiter (default ,)
+  --fields K           doubles per binary row; columns are 0-based indices
+  --column COL         value column (default y, or 0 without a header)
+  --trials-column COL
+  --treatment-column COL  (default treatment, or 1 without a header)
+
+Output:
+  --stride N           write bounds after every N records (default 1)
+
+Parameters (defaults in brackets):
+  --alpha A [0.05]  --alpha-opt A [0.05]  --t-opt T [100]  --v-opt V [100]
+  --quantile P [0.5]  --running-intersection  --truncation L [0.5]
+  --fixed-n N [0]  --population N [0, with replacement]  --lower-bd B [0]
+  --upper-bd B [1]  --propensity P [0.5]  --breaks K [1000]
+)";
+
+// Bad command lines, reported with the usage.
+class UsageError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+struct Options {
+  std::string cs;
+  bool binary = false;
+  bool header = true;
+  char delimiter = ',';
+  size_t num_fields = 0;
+  std::string column;
+  std::string trials_column;
+  std::string treatment_column;
+  size_t stride = 1;
+  double alpha = 0.05;
+  double alpha_opt = 0.05;
+  double t_opt = 100;
+  double v_opt = 100;
+  double quantile = 0.5;
+  bool running_intersection = false;
+  double truncation = 0.5;
+  double fixed_n = 0;
+  double population = 0;
+  double lower_bd = 0;
+  double upper_bd = 1;
+  double propensity = 0.5;
+  int breaks = 1000;
+};
+
+double parse_double(const std::string& name, const std::string& value) {
+  char* end = nullptr;
+  errno = 0;
+  const double result = std::strtod(value.c_str(), &end);
+  if (value.empty() || *end != '\0' || errno == ERANGE) {
+    throw UsageError(name + " expects a number, not '" + value + "'");
+  }
+  return result;
+}
+
+size_t parse_size(const std::string& name, const std::string& value) {
+  char* end = nullptr;
+  errno = 0;
+  const unsigned long long result = std::strtoull(value.c_str(), &end, 10);
+  if (value.empty() || value[0] == '-' || *end != '\0' || errno == ERANGE) {
+    throw UsageError(name + " expects a nonnegative integer, not '" + value
+                     + "'");
+  }
+  return size_t(result);
+}
+
+Options parse_options(const int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string name = argv[i];
+    std::string value;
+    bool has_value = false;
+    const size_t equals = name.find('=');
+    if (equals != std::string::npos) {
+      value = name.substr(equals + 1);
+      name = name.substr(0, equals);
+      has_value = true;
+    }
+    auto flag = [&]() {
+      if (has_value) {
+        throw UsageError(name + " takes no value");
+      }
+      return true;
+    };
+    // The value of an option taking one, from "--name=value" or the next
+    // argument.
+    auto next = [&]() -> const std::string& {
+      if (!has_value) {
+        if (i + 1 == argc) {
+          throw UsageError(name + " expects a value");
+        }
+        value = argv[++i];
+        has_value = true;
+      }
+      return value;
+    };
+    if (name == "--help" || name == "-h") {
+      std::fputs(USAGE, stdout);
+      std::exit(0);
+    } else if (name == "--cs") {
+      options.cs = next();
+    } else if (name == "--format") {
+      if (next() != "csv" && value != "binary") {
+        throw UsageError("--format must be csv or binary");
+      }
+      options.binary = value == "binary";
+    } else if (name == "--no-header") {
+      options.header = !flag();
+    } else if (name == "--delimiter") {
+      if (next().size() != 1) {
+        throw UsageError("--delimiter must be a single character");
+      }
+      options.delimiter = value[0];
+    } else if (name == "--fields") {
+      options.num_fields = parse_size(name, next());
+    } else if (name == "--column") {
+      options.column = next();
+    } else if (name == "--trials-column") {
+      options.trials_column = next();
+    } else if (name == "--treatment-column") {
+      options.treatment_column = next();
+    } else if (name == "--stride") {
+      options.stride = parse_size(name, next());
+    } else if (name == "--alpha") {
+      options.alpha = parse_double(name, next());
+    } else if (name == "--alpha-opt") {
+      options.alpha_opt = parse_double(name, next());
+    } else if (name == "--t-opt") {
+      options.t_opt = parse_double(name, next());
+    } else if (name == "--v-opt") {
+      options.v_opt = parse_double(name, next());
+    } else if (name == "--quantile") {
+      options.quantile = parse_double(name, next());
+    } else if (name == "--running-intersection") {
+      options.running_intersection = flag();
+    } else if (name == "--truncation") {
+      options.truncation = parse_double(name, next());
+    } else if (name == "--fixed-n") {
+      options.fixed_n = parse_double(name, next());
+    } else if (name == "--population") {
+      options.population = parse_double(name, next());
+    } else if (name == "--lower-bd") {
+      options.lower_bd = parse_double(name, next());
+    } else if (name == "--upper-bd") {
+      options.upper_bd = parse_double(name, next());
+    } else if (name == "--propensity") {
+      options.propensity = parse_double(name, next());
+    } else if (name == "--breaks") {
+      options.breaks = int(parse_size(name, next()));
+    } else {
+      throw UsageError("unknown option " + name);
+    }
+  }
+  if (options.cs.empty()) {
+    throw UsageError("--cs is required");
+  }
+  if (options.stride == 0) {
+    throw UsageError("--stride must be positive");
+  }
+  if (!(0 < options.alpha && options.alpha < 1)
+      || !(0 < options.alpha_opt && options.alpha_opt < 1)) {
+    throw UsageError("--alpha and --alpha-opt must lie in (0, 1)");
+  }
+  if (!(options.t_opt > 0) || !(options.v_opt > 0)) {
+    throw UsageError("--t-opt and --v-opt must be positive");
+  }
+  if (options.binary && options.num_fields == 0) {
+    throw UsageError("--format binary requires --fields");
+  }
+  return options;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Record readers
+//////////////////////////////////////////////////////////////////////
+
+// Reads the selected columns of each record from a file descriptor, in large
+// blocks.
+class RecordReader {
+ public:
+  explicit RecordReader(const int fd) : fd_(fd), buffer_(1 << 20) {}
+  virtual ~RecordReader() = default;
+
+  // Stores the selected columns of the next record into values, in the order
+  // they were selected, and returns false at the end of the input. Throws
+  // std::runtime_error for malformed records.
+  virtual bool next(double* values) = 0;
+
+ protected:
+  // Moves the unconsumed bytes from begin_ to the front of the buffer and
+  // reads more after them, growing the buffer if it is full. Flushes stdout
+  // first, since the read may block. Returns false at the end of the input.
+  bool refill() {
+    const size_t remaining = end_ - begin_;
+    std::memmove(buffer_.data(), buffer_.data() + begin_, remaining);
+    begin_ = 0;
+    end_ = remaining;
+    if (end_ == buffer_.size()) {
+      buffer_.resize(2 * buffer_.size());
+    }
+    std::fflush(stdout);
+    while (true) {
+      const auto count = read(fd_, buffer_.data() + end_,
+                              unsigned(buffer_.size() - end_));
+      if (count >= 0) {
+        end_ += count;
+        return count > 0;
+      }
+      if (errno != EINTR) {
+        throw std::runtime_error(std::string("reading input: ")
+                                 + std::strerror(errno));
+      }
+    }
+  }
+
+  const int fd_;
+  std::vector<char> buffer_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+};
+
+// Rows of num_fields native-endian doubles.
+class BinaryReader final : public RecordReader {
+ public:
+  BinaryReader(const int fd, const size_t num_fields,
+               const std::vector<size_t>& columns)
+      : RecordReader(fd), num_fields_(num_fields), columns_(columns) {
+    for (const size_t column : columns) {
+      if (column >= num_fields) {
+        throw UsageError("column " + std::to_string(column)
+                         + " is beyond --fields");
+      }
+    }
+  }
+
+  bool next(double* values) override {
+    const size_t row_bytes = num_fields_ * sizeof(double);
+    while (end_ - begin_ < row_bytes) {
+      if (!refill()) {
+        if (end_ != begin_) {
+          throw std::runtime_error("input ends within a binary row");
+        }
+        return false;
+      }
+    }
+    const char* row = buffer_.data() + begin_;
+    for (size_t i = 0; i < columns_.size(); i++) {
+      std::memcpy(&values[i], row + columns_[i] * sizeof(double),
+                  sizeof(double));
+    }
+    begin_ += row_bytes;
+    return true;
+  }
+
+ private:
+  const size_t num_fields_;
+  const std::vector<size_t> columns_;
+};
+
+// Delimited text with one record per line. Fields may be quoted; selected
+// fields must hold numbers, which are parsed in place with strtod, and
+// fields after the last selected one are not scanned.
+class CsvReader final : public RecordReader {
+ public:
+  // Columns are header names, or 0-based indices without a header or when no
+  // header field matches.
+  CsvReader(const int fd, const bool header, const char delimiter,
+            const std::vector<std::string>& columns)
+      : RecordReader(fd), delimiter_(delimiter) {
+    std::vector<std::string> names;
+    if (header) {
+      const char* line = nullptr;
+      const char* line_end = nullptr;
+      if (next_line(&line, &line_end)) {
+        names = split_header(line, line_end);
+      }
+    }
+    for (size_t i = 0; i < columns.size(); i++) {
+      const size_t column = column_index(names, columns[i]);
+      if (column >= slots_.size()) {
+        slots_.resize(column + 1, -1);
+      }
+      if (slots_[column] != -1) {
+        throw UsageError("column " + columns[i] + " is selected twice");
+      }
+      slots_[column] = int(i);
+    }
+  }
+
+  bool next(double* values) override {
+    const char* line = nullptr;
+    const char* line_end = nullptr;
+    do {
+      if (!next_line(&line, &line_end)) {
+        return false;
+      }
+    } while (line == line_end);
+    const char* field = line;
+    for (size_t column = 0; column < slots_.size(); column++) {
+      if (field > line_end) {
+        throw std::runtime_error(location() + "has only "
+                                 + std::to_string(column) + " fields");
+      }
+      const char* field_end = skip_field(field, line_end);
+      if (slots_[column] >= 0) {
+        values[slots_[column]] = parse_field(field, field_end);
+      }
+      field = field_end + 1;
+    }
+    return true;
+  }
+
+ private:
+  // The next line, without its line terminator, within the buffer, which
+  // holds its newline or a sentinel after it so that strtod stops there.
+  bool next_line(const char** line, const char** line_end) {
+    size_t scanned = begin_;
+    while (true) {
+      const void* newline = std::memchr(buffer_.data() + scanned, '\n',
+                                        end_ - scanned);
+      if (newline) {
+        *line = buffer_.data() + begin_;
+        *line_end = static_cast<const char*>(newline);
+        begin_ = *line_end - buffer_.data() + 1;
+        break;
+      }
+      scanned = end_ - begin_;
+      if (!refill()) {
+        if (end_ == begin_) {
+          return false;
+        }
+        // A last line without a newline.
+        if (end_ == buffer_.size()) {
+          buffer_.resize(buffer_.size() + 1);
+        }
+        buffer_[end_++] = '\n';
+      }
+    }
+    line_number_++;
+    if (*line_end > *line && (*line_end)[-1] == '\r') {
+      (*line_end)--;
+    }
+    return true;
+  }
+
+  // The end of the field starting at field: the delimiter after it or
+  // line_end.
+  const char* skip_field(const char* field, const char* line_end) const {
+    const char* p = field;
+    if (p < line_end && *p == '"') {
+      for (p++; p < line_end; p++) {
+        if (*p == '"') {
+          if (p + 1 < line_end && p[1] == '"') {
+            p++;
+          } else {
+            break;
+          }
+        }
+      }
+    }
+    const void* delimiter = std::memchr(p, delimiter_, line_end - p);
+    return delimiter ? static_cast<const char*>(delimiter) : line_end;
+  }
+
+  double parse_field(const char* field, const char* field_end) const {
+    const char* start = field;
+    const char* stop = field_end;
+    if (stop - start >= 2 && *start == '"' && stop[-1] == '"') {
+      start++;
+      stop--;
+    }
+    // strtod would skip whitespace past the end of the line.
+    while (start < stop && (*start == ' ' || *start == '\t')) {
+      start++;
+    }
+    char* parsed_end = nullptr;
+    const double value = start < stop ? std::strtod(start, &parsed_end) : 0;
+    if (start == stop || parsed_end != stop) {
+      throw std::runtime_error(location() + "field '"
+                               + std::string(field, field_end)
+                               + "' is not a number");
+    }
+    return value;
+  }
+
+  std::vector<std::string> split_header(const char* line,
+                                        const char* line_end) const {
+    std::vector<std::string> names;
+    const char* field = line;
+    while (field <= line_end) {
+      const char* field_end = skip_field(field, line_end);
+      std::string name(field, field_end);
+      if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+        name = name.substr(1, name.size() - 2);
+      }
+      names.push_back(name);
+      field = field_end + 1;
+    }
+    return names;
+  }
+
+  static size_t column_index(const std::vector<std::string>& names,
+                             const std::string& column) {
+    for (size_t i = 0; i < names.size(); i++) {
+      if (names[i] == column) {
+        return i;
+      }
+    }
+    if (column.empty()
+        || column.find_first_not_of("0123456789") != std::string::npos) {
+      throw UsageError("no column named " + column);
+    }
+    return parse_size("column", column);
+  }
+
+  std::string location() const {
+    return "line " + std::to_string(line_number_) + ": ";
+  }
+
+  const char delimiter_;
+  // The position of each column among the selected values, or -1.
+  std::vector<int> slots_;
+  size_t line_number_ = 0;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Confidence sequences
+//////////////////////////////////////////////////////////////////////
+
+void write_bounds(const size_t t, const std::pair<double, double>& bounds,
+                  FILE* out) {
+  std::fprintf(out, "%zu,%.17g,%.17g\n", t, bounds.first, bounds.second);
+}
+
+// One confidence sequence. add() takes the selected columns of a record and
+// write() brings the sequence up to date with the records added since the
+// last write() and writes its row.
+class Estimator {
+ public:
+  virtual ~Estimator() = default;
+  virtual void add(const double* values) = 0;
+  virtual void write(size_t t, FILE* out) = 0;
+};
+
+// Any accumulator with update(x, n) and interval(), on observations in
+// [lower_bd, upper_bd].
+template <class Accumulator>
+class MeanEstimator final : public Estimator {
+ public:
+  MeanEstimator(Accumulator accumulator, const double lower_bd,
+                const double upper_bd)
+      : accumulator_(std::move(accumulator)), lower_bd_(lower_bd),
+        upper_bd_(upper_bd) {}
+
+  void add(const double* values) override {
+    if (!(lower_bd_ <= values[0] && values[0] <= upper_bd_)) {
+      throw std::runtime_error(
+          "observations must lie in [" + std::to_string(lower_bd_) + ", "
+          + std::to_string(upper_bd_) + "], not "
+          + std::to_string(values[0]));
+    }
+    pending_.push_back(values[0]);
+  }
+
+  void write(const size_t t, FILE* out) override {
+    write_bounds(t, accumulator_.update(pending_.data(), pending_.size()),
+                 out);
+    pending_.clear();
+  }
+
+ private:
+  Accumulator accumulator_;
+  const double lower_bd_;
+  const double upper_bd_;
+  std::vector<double> pending_;
+};
+
+// Successes, and optionally trials, per record. Only the sums since the last
+// row are kept, and each row is one BernoulliConfidenceSequence update, so
+// the running intersection is over written rows.
+class BernoulliEstimator final : public Estimator {
+ public:
+  explicit BernoulliEstimator(const Options& options)
+      : cs_(options.alpha, options.t_opt, options.alpha_opt,
+            options.running_intersection),
+        has_trials_(!options.trials_column.empty()) {}
+
+  void add(const double* values) override {
+    const double successes = values[0];
+    const double trials = has_trials_ ? values[1] : 1;
+    if (!(trials >= 0 && trials == std::floor(trials)
+          && trials <= std::numeric_limits<int>::max())
+        || !(0 <= successes && successes <= trials)) {
+      throw std::runtime_error(
+          "records need integer trials and 0 <= successes <= trials, not "
+          + std::to_string(successes) + " successes in "
+          + std::to_string(trials) + " trials");
+    }
+    successes_ += successes;
+    trials_ += trials;
+    if (trials_ > std::numeric_limits<int>::max()) {
+      throw std::runtime_error("too many trials between rows; use a smaller "
+                               "--stride");
+    }
+  }
+
+  void write(const size_t t, FILE* out) override {
+    write_bounds(t, cs_.update(successes_, int(trials_)), out);
+    successes_ = 0;
+    trials_ = 0;
+  }
+
+ private:
+  confseq::BernoulliConfidenceSequence cs_;
+  const bool has_trials_;
+  double successes_ = 0;
+  double trials_ = 0;
+};
+
+class QuantileEstimator final : public Estimator {
+ public:
+  explicit QuantileEstimator(const Options& options)
+      : cs_(options.alpha, int(options.t_opt)), p_(options.quantile) {
+    if (!(0 < p_ && p_ < 1)) {
+      throw UsageError("--quantile must lie in (0, 1)");
+    }
+  }
+
+  void add(const double* values) override {
+    pending_.push_back(values[0]);
+  }
+
+  void write(const size_t t, FILE* out) override {
+    cs_.add(pending_.begin(), pending_.end());
+    pending_.clear();
+    write_bounds(t, cs_.interval(p_), out);
+  }
+
+ private:
+  confseq::QuantileConfidenceSequence cs_;
+  const double p_;
+  std::vector<double> pending_;
+};
+
+// Outcomes and treatment indicators. The cadence of the
+// AverageTreatmentEffectCS is the stride, so each row costs one root search.
+class AverageTreatmentEffectEstimator final : public Estimator {
+ public:
+  explicit AverageTreatmentEffectEstimator(const Options& options)
+      : cs_(params(options)), propensity_(options.propensity) {}
+
+  void add(const double* values) override {
+    y_.push_back(values[0]);
+    treatment_.push_back(values[1]);
+  }
+
+  void write(const size_t t, FILE* out) override {
+    propensities_.resize(y_.size(), propensity_);
+    confseq::AverageTreatmentEffectEstimate estimate;
+    if (cs_.update(y_.data(), treatment_.data(), propensities_.data(),
+                   y_.size(), &estimate) == 0) {
+      estimate = cs_.estimate();
+    }
+    y_.clear();
+    treatment_.clear();
+    std::fprintf(out, "%zu,%.17g,%.17g,%.17g,%.17g\n", t,
+                 estimate.point_estimate, estimate.upper_confidence_bound,
+                 estimate.lower_confidence_bound, estimate.p_value);
+  }
+
+ private:
+  static confseq::AverageTreatmentEffectParams params(
+      const Options& options) {
+    confseq::AverageTreatmentEffectParams params;
+    params.alpha = options.alpha;
+    params.alpha_opt = options.alpha_opt;
+    params.v_opt = options.v_opt;
+    params.lower_bd = options.lower_bd;
+    params.upper_bd = options.upper_bd;
+    params.min_propensity =
+        std::min(options.propensity, 1 - options.propensity);
+    params.cadence = options.stride;
+    return params;
+  }
+
+  confseq::AverageTreatmentEffectCS cs_;
+  const double propensity_;
+  std::vector<double> y_;
+  std::vector<double> treatment_;
+  std::vector<double> propensities_;
+};
+
+template <class Accumulator>
+std::unique_ptr<Estimator> mean_estimator(Accumulator accumulator,
+                                          const double lower_bd=0,
+                                          const double upper_bd=1) {
+  return std::unique_ptr<Estimator>(new MeanEstimator<Accumulator>(
+      std::move(accumulator), lower_bd, upper_bd));
+}
+
+std::unique_ptr<Estimator> make_estimator(const Options& options) {
+  if (options.cs == "bernoulli") {
+    return std::unique_ptr<Estimator>(new BernoulliEstimator(options));
+  }
+  if (options.cs == "quantile") {
+    return std::unique_ptr<Estimator>(new QuantileEstimator(options));
+  }
+  if (options.cs == "ate") {
+    return std::unique_ptr<Estimator>(
+        new AverageTreatmentEffectEstimator(options));
+  }
+  confseq::StreamCSKind kind;
+  try {
+    kind = confseq::stream_cs_kind(options.cs);
+  } catch (const std::invalid_argument&) {
+    throw UsageError("unknown --cs " + options.cs);
+  }
+  const double alpha = options.alpha;
+  const bool intersect = options.running_intersection;
+  switch (kind) {
+    case confseq::StreamCSKind::PREDMIX_EMPBERN:
+      return mean_estimator(confseq::PredmixEmpBernAccumulator(
+          alpha, options.truncation, intersect, options.fixed_n));
+    case confseq::StreamCSKind::PREDMIX_HOEFFDING:
+      return mean_estimator(
+          confseq::PredmixHoeffdingAccumulator(alpha, intersect));
+    case confseq::StreamCSKind::PREDMIX_EMPBERN_WOR:
+    case confseq::StreamCSKind::PREDMIX_HOEFFDING_WOR:
+      if (!(options.population > 0)) {
+        throw UsageError("--cs " + options.cs + " requires --population");
+      }
+      if (kind == confseq::StreamCSKind::PREDMIX_EMPBERN_WOR) {
+        return mean_estimator(
+            confseq::PredmixEmpBernWoRAccumulator(
+                options.population, alpha, options.lower_bd,
+                options.upper_bd, intersect),
+            options.lower_bd, options.upper_bd);
+      }
+      return mean_estimator(
+          confseq::PredmixHoeffdingWoRAccumulator(
+              options.population, alpha, options.lower_bd, options.upper_bd,
+              intersect),
+          options.lower_bd, options.upper_bd);
+    case confseq::StreamCSKind::CONJMIX_HOEFFDING:
+      return mean_estimator(confseq::ConjmixHoeffdingAccumulator(
+          options.t_opt, alpha, intersect));
+    case confseq::StreamCSKind::CONJMIX_EMPBERN:
+      return mean_estimator(confseq::ConjmixEmpBernAccumulator(
+          options.v_opt, alpha, intersect));
+    case confseq::StreamCSKind::HEDGED:
+      return mean_estimator(confseq::HedgedConfidenceSequence(
+          alpha, options.population, options.breaks, intersect));
+  }
+  throw UsageError("unknown --cs " + options.cs);
+}
+
+// The columns each kind reads, in the order its Estimator expects them.
+std::vector<std::string> selected_columns(const Options& options) {
+  const bool named = options.header && !options.binary;
+  std::vector<std::string> columns = {
+      options.column.empty() ? (named ? "y" : "0") : options.column};
+  if (options.cs == "bernoulli" && !options.trials_column.empty()) {
+    columns.push_back(options.trials_column);
+  } else if (options.cs == "ate") {
+    columns.push_back(options.treatment_column.empty()
+                      ? (named ? "treatment" : "1")
+                      : options.treatment_column);
+  }
+  return columns;
+}
+
+std::unique_ptr<RecordReader> make_reader(
+    const Options& options, const std::vector<std::string>& columns) {
+  if (!options.binary) {
+    return std::unique_ptr<RecordReader>(
+        new CsvReader(0, options.header, options.delimiter, columns));
+  }
+  std::vector<size_t> indices;
+  for (const std::string& column : columns) {
+    indices.push_back(parse_size("binary columns", column));
+  }
+  return std::unique_ptr<RecordReader>(
+      new BinaryReader(0, options.num_fields, indices));
+}
+
+int run(const Options& options) {
+  const std::unique_ptr<Estimator> estimator = make_estimator(options);
+  const std::vector<std::string> columns = selected_columns(options);
+  const std::unique_ptr<RecordReader> reader = make_reader(options, columns);
+
+  static char output_buffer[1 << 16];
+  std::setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+  std::fputs(options.cs == "ate"
+             ? "t,point_estimate,upper_confidence_bound,"
+               "lower_confidence_bound,p_value\n"
+             : "t,lower,upper\n", stdout);
+  std::vector<double> values(columns.size());
+  size_t t = 0;
+  while (reader->next(values.data())) {
+    estimator->add(values.data());
+    if (++t % options.stride == 0) {
+      estimator->write(t, stdout);
+    }
+  }
+  if (t % options.stride != 0) {
+    estimator->write(t, stdout);
+  }
+  if (std::fflush(stdout) != 0) {
+    throw std::runtime_error(std::string("writing output: ")
+                             + std::strerror(errno));
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  try {
+    return run(parse_options(argc, argv));
+  } catch (const UsageError& error) {
+    std::fprintf(stderr, "confseq-cs: %s\n\n%s", error.what(), USAGE);
+    return 2;
+  } catch (const std::exception& error) {
+    std::fflush(stdout);
+    std::fprintf(stderr, "confseq-cs: %s\n", error.what());
+    return 1;
+  }
+}
@@ -1,5 +1,5 @@
 import numpy as np
-from confseq.boundaries import normal_mixture_bound, gamma_exponential_mixture_bound
+from confseq.capital_processes import batch_confidence_sequences
 
 
 def conjmix_hoeffding_cs(x, t_opt, alpha=0.05, running_intersection=False):
@@ -28,28 +28,22 @@ def conjmix_hoeffding_cs(x, t_opt, alpha=0.05, running_intersection=False):
     u, array-like of reals
         Upper confidence sequence
     """
-    t = np.arange(1, len(x) + 1)
-    mu_hat_t = np.cumsum(x) / t
-
-    bdry = (
-        normal_mixture_bound(
-            t / 4, alpha=alpha, v_opt=t_opt / 4, alpha_opt=alpha, is_one_sided=False
-        )
-        / t
+    x = np.asarray(x, dtype=float)
+    # The closed-form boundary with rho hoisted, the running mean, the clip
+    # and the running intersection in one native pass.
+    return batch_confidence_sequences(
+        x,
+        [0, len(x)],
+        cs="conjmix_hoeffding",
+        t_opt=t_opt,
+        alpha=alpha,
+        running_intersection=running_intersection,
     )
-    l, u = mu_hat_t - bdry, mu_hat_t + bdry
 
-    l = np.maximum(l, 0)
-    u = np.minimum(u, 1)
 
-    if running_intersection:
-        l = np.maximum.accumulate(l)
-        u = np.minimum.accumulate(u)
-
-    return l, u
-
-
-def conjmix_empbern_cs(x, v_opt, alpha=0.05, running_intersection=False):
+def conjmix_empbern_cs(
+    x, v_opt, alpha=0.05, running_intersection=False, side="both"
+):
     """
     Conjugate mixture empirical Bernstein confidence sequence
 
@@ -69,6 +63,10 @@ def conjmix_empbern_cs(x, v_opt, alpha=0.05, running_intersection=False):
     running_intersection, boolean
         Should the running intersection be taken?
 
+    side, "both", "lower" or "upper"
+        "lower" or "upper" spends all of `alpha` on that bound and reports
+        the other bound as 1 or 0
+
     Returns
     -------
     l, array-like of reals
@@ -77,23 +75,15 @@ def conjmix_empbern_cs(x, v_opt, alpha=0.05, running_intersection=False):
     u, array-like of reals
         Upper confidence sequence
     """
-    x = np.array(x)
-    t = np.arange(1, len(x) + 1)
-    S_t = np.cumsum(x)
-    mu_hat_t = S_t / t
-    mu_hat_tminus1 = np.append(1 / 2, mu_hat_t[0 : (len(mu_hat_t) - 1)])
-    V_t = np.cumsum(np.power(x - mu_hat_tminus1, 2))
-    bdry = (
-        gamma_exponential_mixture_bound(
-            V_t, alpha=alpha / 2, v_opt=v_opt, c=1, alpha_opt=alpha / 2
-        )
-        / t
+    x = np.asarray(x, dtype=float)
+    # One native pass: V_t, the warm-started boundary roots, the clip and the
+    # running intersection together.
+    return batch_confidence_sequences(
+        x,
+        [0, len(x)],
+        cs="conjmix_empbern",
+        v_opt=v_opt,
+        alpha=alpha,
+        running_intersection=running_intersection,
+        side=side,
     )
-    l, u = mu_hat_t - bdry, mu_hat_t + bdry
-    l = np.maximum(l, 0)
-    u = np.minimum(u, 1)
-    if running_intersection:
-        l = np.maximum.accumulate(l)
-        u = np.minimum.accumulate(u)
-
-    return l, u
@@ -1,7 +1,10 @@
 from confseq.betting import *
+import math
 import matplotlib
 import matplotlib.pyplot as plt
+import numpy as np
 import os
+from time import time
 
 class ConfseqToPlot:
     """
@@ -1,5 +1,10 @@
+import threading
+from concurrent.futures import ThreadPoolExecutor
+
 import numpy as np
 
+from confseq import capital_processes
+
 
 def superMG_crossing_fraction(mart_fn, dist_fn, alpha, repeats):
     exceeded = [None] * repeats
@@ -15,3 +20,47 @@ def expand_grid(a, b):
     # Trying to mimic behaviour of R's expand.grid
     # https://www.rdocumentation.org/packages/base/versions/3.6.2/topics/expand.grid
     return list(zip(np.repeat(a, len(b)), np.tile(b, len(a))))
+
+
+_pools = {}
+_pools_lock = threading.Lock()
+# The name of the pool whose worker the current thread is, if any.
+_worker = threading.local()
+
+
+def _start_worker(name):
+    _worker.pool = name
+
+
+def thread_pool(name):
+    """
+    Thread pool `name` with `capital_processes.get_num_threads()` threads,
+    created on first use and reused across calls from any thread. When the
+    thread count changes, the pool is replaced rather than shut down: calls
+    still holding the old pool can keep submitting to it, and its threads
+    exit once it is no longer referenced.
+    """
+    num_threads = capital_processes.get_num_threads()
+    with _pools_lock:
+        pool, pool_size = _pools.get(name, (None, None))
+        if pool is None or pool_size != num_threads:
+            pool = ThreadPoolExecutor(
+                num_threads,
+                thread_name_prefix="confseq-" + name,
+                initializer=_start_worker,
+                initargs=(name,),
+            )
+            _pools[name] = (pool, num_threads)
+        return pool
+
+
+def pool_map(name, fn, iterable):
+    """
+    `map(fn, iterable)` across the threads of `thread_pool(name)`, or the
+    builtin `map` when called from one of that pool's workers. A nested call
+    would otherwise queue its tasks behind the outer ones and, once every
+    worker is waiting on such a call, wait forever.
+    """
+    if getattr(_worker, "pool", None) == name:
+        return map(fn, iterable)
+    return thread_pool(name).map(fn, iterable)
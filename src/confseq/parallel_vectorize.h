@@ -0,0 +1,486 @@
+#ifndef CONFIDENCESEQUENCES_PARALLEL_VECTORIZE_H_
+#define CONFIDENCESEQUENCES_PARALLEL_VECTORIZE_H_
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include "uniform_boundaries.h"
+
+namespace confseq {
+
+template <class T>
+using InputArray = pybind11::array_t<
+    T, pybind11::array::c_style | pybind11::array::forcecast>;
+
+using Shape = std::vector<pybind11::ssize_t>;
+
+inline Shape array_shape(const pybind11::array& array) {
+  return Shape(array.shape(), array.shape() + array.ndim());
+}
+
+inline pybind11::tuple shape_tuple(const Shape& shape) {
+  pybind11::tuple tuple(shape.size());
+  for (size_t i = 0; i < shape.size(); i++) {
+    tuple[i] = pybind11::int_(shape[i]);
+  }
+  return tuple;
+}
+
+// Shape of args broadcast together with NumPy rules. Arguments that already
+// share a shape, as in most hot loops, skip the call into NumPy.
+template <class... Arrays>
+Shape broadcast_shape(const Arrays&... args) {
+  const std::array<Shape, sizeof...(Arrays)> shapes = {{array_shape(args)...}};
+  if (std::all_of(shapes.begin(), shapes.end(),
+                  [&](const Shape& shape) { return shape == shapes[0]; })) {
+    return shapes[0];
+  }
+  const pybind11::tuple broadcast = pybind11::module::import("numpy").attr(
+      "broadcast")(args...).attr("shape");
+  Shape shape;
+  for (const pybind11::handle extent : broadcast) {
+    shape.push_back(extent.cast<pybind11::ssize_t>());
+  }
+  return shape;
+}
+
+// arg as a C-contiguous array of the given shape, read in place if it
+// already has it and broadcast and copied otherwise.
+template <class T>
+InputArray<T> broadcast_to(const InputArray<T>& arg, const Shape& shape) {
+  if (array_shape(arg) == shape) {
+    return arg;
+  }
+  return pybind11::cast<InputArray<T>>(
+      pybind11::module::import("numpy").attr("broadcast_to")(
+          arg, shape_tuple(shape)));
+}
+
+// The array results are written to: out, if given, which must be a
+// writeable C-contiguous array of T of the given shape, or else a new one.
+template <class T>
+pybind11::array_t<T> output_array(const pybind11::handle out,
+                                  const Shape& shape) {
+  if (out.is_none()) {
+    return pybind11::array_t<T>(shape);
+  }
+  if (!pybind11::isinstance<pybind11::array_t<T, pybind11::array::c_style>>(
+          out)) {
+    throw pybind11::type_error(
+        "out must be a C-contiguous array of the result dtype");
+  }
+  pybind11::array_t<T> array = pybind11::reinterpret_borrow<
+      pybind11::array_t<T>>(out);
+  if (!array.writeable()) {
+    throw pybind11::value_error("out must be writeable");
+  }
+  if (array_shape(array) != shape) {
+    throw pybind11::value_error(
+        "out must have the shape of the broadcast arguments");
+  }
+  return array;
+}
+
+// The elements to evaluate, as NumPy's where=: empty if where is True, and
+// otherwise where broadcast to shape, as bools.
+using MaskArray = pybind11::array_t<
+    bool, pybind11::array::c_style | pybind11::array::forcecast>;
+
+inline MaskArray where_mask(const pybind11::object& where,
+                            const Shape& shape) {
+  if (where.ptr() == Py_True) {
+    return MaskArray(Shape{0});
+  }
+  return pybind11::cast<MaskArray>(
+      pybind11::module::import("numpy").attr("broadcast_to")(
+          where, shape_tuple(shape)));
+}
+
+// Shape of the result of a vectorized call: out's shape if given, so that
+// the arguments broadcast to it, and otherwise the arguments' own.
+template <class... Arrays>
+Shape result_shape(const pybind11::handle out, const Arrays&... args) {
+  if (!out.is_none() && pybind11::isinstance<pybind11::array>(out)) {
+    return array_shape(pybind11::reinterpret_borrow<pybind11::array>(out));
+  }
+  return broadcast_shape(args...);
+}
+
+// Stand-in for NumPy ufuncs. Arguments are broadcast with NumPy rules, then
+// the GIL is released and elements are evaluated across threads with
+// parallel_for. As with ufuncs, results are written into out if it is given
+// and returned there, and where=False elements are skipped: left unchanged
+// in out, or NaN in a new array. Otherwise all-scalar arguments give a
+// scalar result.
+template <class Return, class... Args>
+class ParallelVectorized {
+ public:
+  explicit ParallelVectorized(std::function<Return(Args...)> fn)
+      : fn_(std::move(fn)) {}
+
+  pybind11::object operator()(InputArray<std::decay_t<Args>>... args,
+                              const pybind11::object& out,
+                              const pybind11::object& where) const {
+    return call(std::index_sequence_for<Args...>(), out, where, args...);
+  }
+
+ private:
+  template <size_t... I>
+  pybind11::object call(std::index_sequence<I...>,
+                        const pybind11::object& out,
+                        const pybind11::object& where,
+                        InputArray<std::decay_t<Args>>... args) const {
+    const Shape shape = result_shape(out, args...);
+    const std::tuple<InputArray<std::decay_t<Args>>...> inputs(
+        broadcast_to(args, shape)...);
+    pybind11::array_t<Return> result = output_array<Return>(out, shape);
+    const MaskArray mask = where_mask(where, shape);
+
+    Return* out_data = result.mutable_data();
+    const bool* mask_data = mask.size() > 0 ? mask.data() : nullptr;
+    const size_t size = result.size();
+    const auto& fn = fn_;
+    const auto data = std::make_tuple(std::get<I>(inputs).data()...);
+    {
+      pybind11::gil_scoped_release release;
+      if (mask_data && out.is_none()) {
+        std::fill_n(out_data, size, std::numeric_limits<Return>::quiet_NaN());
+      }
+      parallel_for(size, [out_data, mask_data, &fn, &data](const size_t i) {
+        if (!mask_data || mask_data[i]) {
+          out_data[i] = fn(std::get<I>(data)[i]...);
+        }
+      });
+    }
+    if (!out.is_none()) {
+      return out;
+    }
+    if (result.ndim() == 0) {
+      return pybind11::cast(out_data[0]);
+    }
+    return std::move(result);
+  }
+
+  std::function<Return(Args...)> fn_;
+};
+
+// Functions returning a (lower, upper) pair give a tuple of two arrays, or of
+// two floats for all-scalar arguments. out, if given, is a tuple of two
+// arrays.
+template <class... Args>
+class ParallelVectorized<std::pair<double, double>, Args...> {
+ public:
+  explicit ParallelVectorized(
+      std::function<std::pair<double, double>(Args...)> fn)
+      : fn_(std::move(fn)) {}
+
+  pybind11::object operator()(InputArray<std::decay_t<Args>>... args,
+                              const pybind11::object& out,
+                              const pybind11::object& where) const {
+    return call(std::index_sequence_for<Args...>(), out, where, args...);
+  }
+
+ private:
+  template <size_t... I>
+  pybind11::object call(std::index_sequence<I...>,
+                        const pybind11::object& out,
+                        const pybind11::object& where,
+                        InputArray<std::decay_t<Args>>... args) const {
+    pybind11::object first_out = pybind11::none();
+    pybind11::object second_out = pybind11::none();
+    if (!out.is_none()) {
+      if (!pybind11::isinstance<pybind11::tuple>(out) ||
+          pybind11::len(out) != 2) {
+        throw pybind11::type_error("out must be a tuple of two arrays");
+      }
+      const pybind11::tuple outs = pybind11::reinterpret_borrow<
+          pybind11::tuple>(out);
+      first_out = outs[0];
+      second_out = outs[1];
+    }
+    const Shape shape = result_shape(first_out, args...);
+    const std::tuple<InputArray<std::decay_t<Args>>...> inputs(
+        broadcast_to(args, shape)...);
+    pybind11::array_t<double> first = output_array<double>(first_out, shape);
+    pybind11::array_t<double> second =
+        output_array<double>(second_out, shape);
+    const MaskArray mask = where_mask(where, shape);
+
+    double* first_data = first.mutable_data();
+    double* second_data = second.mutable_data();
+    const bool* mask_data = mask.size() > 0 ? mask.data() : nullptr;
+    const size_t size = first.size();
+    const auto& fn = fn_;
+    const auto data = std::make_tuple(std::get<I>(inputs).data()...);
+    {
+      pybind11::gil_scoped_release release;
+      if (mask_data && out.is_none()) {
+        std::fill_n(first_data, size,
+                    std::numeric_limits<double>::quiet_NaN());
+        std::fill_n(second_data, size,
+                    std::numeric_limits<double>::quiet_NaN());
+      }
+      parallel_for(size, [first_data, second_data, mask_data, &fn,
+                          &data](const size_t i) {
+        if (!mask_data || mask_data[i]) {
+          const std::pair<double, double> result =
+              fn(std::get<I>(data)[i]...);
+          first_data[i] = result.first;
+          second_data[i] = result.second;
+        }
+      });
+    }
+    if (!out.is_none()) {
+      return out;
+    }
+    if (first.ndim() == 0) {
+      return pybind11::make_tuple(first_data[0], second_data[0]);
+    }
+    return pybind11::make_tuple(first, second);
+  }
+
+  std::function<std::pair<double, double>(Args...)> fn_;
+};
+
+using Float32Array = pybind11::array_t<float, pybind11::array::c_style>;
+
+// Calls fn(x + begin, n, out + begin) over blocks of x across threads with
+// the GIL released, giving a float32 array shaped like x, or a float for a
+// 0-d array. Bindings take x with noconvert() in an overload alongside their
+// float64 one, so only C-contiguous float32 arrays use the float32 path.
+template <class Fn>
+pybind11::object float32_blocks(const Float32Array x, Fn fn) {
+  Float32Array out(
+      std::vector<pybind11::ssize_t>(x.shape(), x.shape() + x.ndim()));
+  const size_t size = out.size();
+  const size_t block_size = 4096;
+  const float* x_data = x.data();
+  float* out_data = out.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    parallel_for(
+        (size + block_size - 1) / block_size,
+        [&](const size_t block) {
+          const size_t begin = block * block_size;
+          fn(x_data + begin, std::min(block_size, size - begin),
+             out_data + begin);
+        },
+        0, 1);
+  }
+  if (out.ndim() == 0) {
+    return pybind11::cast(out_data[0]);
+  }
+  return std::move(out);
+}
+
+template <class Return, class... Args>
+ParallelVectorized<Return, Args...> parallel_vectorize(
+    Return (*fn)(Args...)) {
+  return ParallelVectorized<Return, Args...>(fn);
+}
+
+// As ParallelVectorized, for functions whose last parameter is a
+// SolverPrecision. The precision is an extra argument before out and where,
+// passed to every element rather than broadcast.
+template <class Return, class... Args>
+class PrecisionVectorized {
+ public:
+  explicit PrecisionVectorized(
+      Return (*fn)(Args..., const SolverPrecision&)) : fn_(fn) {}
+
+  pybind11::object operator()(InputArray<std::decay_t<Args>>... args,
+                              const SolverPrecision& precision,
+                              const pybind11::object& out,
+                              const pybind11::object& where) const {
+    const auto fn = fn_;
+    return ParallelVectorized<Return, Args...>(
+        [fn, precision](const Args... values) {
+          return fn(values..., precision);
+        })(args..., out, where);
+  }
+
+ private:
+  Return (*fn_)(Args..., const SolverPrecision&);
+};
+
+// Peels the trailing SolverPrecision off Args to name the
+// PrecisionVectorized type.
+template <class Return, class Leading, class... Rest>
+struct PrecisionVectorizedOf;
+
+template <class Return, class... Leading, class Last>
+struct PrecisionVectorizedOf<Return, std::tuple<Leading...>, Last> {
+  static_assert(std::is_same<Last, const SolverPrecision&>::value,
+                "the last parameter must be a const SolverPrecision&");
+  using type = PrecisionVectorized<Return, Leading...>;
+};
+
+template <class Return, class... Leading, class Next, class... Rest>
+struct PrecisionVectorizedOf<Return, std::tuple<Leading...>, Next, Rest...>
+    : PrecisionVectorizedOf<Return, std::tuple<Leading..., Next>, Rest...> {};
+
+template <class Return, class... Args>
+typename PrecisionVectorizedOf<Return, std::tuple<>, Args...>::type
+parallel_vectorize_with_precision(Return (*fn)(Args...)) {
+  return typename PrecisionVectorizedOf<Return, std::tuple<>, Args...>::type(
+      fn);
+}
+
+// Pickling through T's checkpoint save() and load().
+template <class T>
+auto checkpoint_pickle() {
+  return pybind11::pickle(
+      [](const T& value) {
+        std::ostringstream out;
+        value.save(out);
+        return pybind11::make_tuple(pybind11::bytes(out.str()));
+      },
+      [](const pybind11::tuple state) {
+        std::istringstream in(state[0].cast<std::string>());
+        return T::load(in);
+      });
+}
+
+inline void define_thread_settings(pybind11::module& m) {
+  m.def("set_num_threads",
+        &set_num_threads,
+        R"pbdoc(
+          Set the number of threads used for array evaluation in this module.
+          Use 1 to disable threading.
+        )pbdoc",
+        pybind11::arg("num_threads"));
+  m.def("get_num_threads",
+        &get_num_threads,
+        R"pbdoc(
+          Number of threads used for array evaluation in this module. Defaults
+          to the number of hardware threads.
+        )pbdoc");
+  m.def("scratch_arena_stats",
+        []() {
+          const ScratchArenaStats stats = scratch_arena_stats();
+          pybind11::dict result;
+          result["high_water_bytes"] = stats.high_water_bytes;
+          result["reserved_bytes"] = stats.reserved_bytes;
+          result["heap_allocations"] = stats.heap_allocations;
+          return result;
+        },
+        R"pbdoc(
+          Return a dict describing the native engines' per-thread scratch
+          memory: `high_water_bytes`, the most any one thread has had in use
+          at once, `reserved_bytes`, the memory now held over all threads, and
+          `heap_allocations`, made since the last reset. Repeating a workload
+          once it has run leaves `heap_allocations` unchanged.
+        )pbdoc");
+  m.def("reset_scratch_arena_stats", &reset_scratch_arena_stats,
+        "Restart the scratch high-water mark and heap allocation count.");
+}
+
+inline void define_solver_counters(pybind11::module& m) {
+  m.attr("instrumentation_enabled") = instrumentation_enabled();
+  m.def("solver_counters",
+        []() {
+          const SolverCounters& counters = solver_counters();
+          pybind11::dict result;
+          result["solves"] = counters.solves;
+          result["objective_evaluations"] = counters.objective_evaluations;
+          result["bracket_expansions"] = counters.bracket_expansions;
+          result["halley_steps"] = counters.halley_steps;
+          result["bisection_steps"] = counters.bisection_steps;
+          result["special_function_calls"] =
+              counters.special_function_calls;
+          result["max_evaluations_per_solve"] =
+              counters.max_evaluations_per_solve;
+          return result;
+        },
+        R"pbdoc(
+          Return a dict of root-search work done by this module on the calling
+          thread: solves, objective_evaluations, bracket_expansions,
+          halley_steps, bisection_steps, special_function_calls and
+          max_evaluations_per_solve. Counts stay zero unless the module was
+          built with CONFSEQ_INSTRUMENT (see `instrumentation_enabled`). Work
+          on worker threads is not included, so measure after
+          `set_num_threads(1)`.
+        )pbdoc");
+  m.def("reset_solver_counters", &reset_solver_counters,
+        "Zero the calling thread's solver counters in this module.");
+}
+
+inline void define_latency_tracing(pybind11::module& m) {
+  m.def("enable_latency_histogram",
+        []() { enable_latency_histogram(); },
+        R"pbdoc(
+          Record the latency of this module's native entry points into a new
+          lock-free histogram, replacing any previous one. Costs two clock
+          reads per call while enabled.
+        )pbdoc");
+  m.def("disable_latency_histogram",
+        []() { set_trace_hook(nullptr); },
+        "Stop recording latencies in this module and free the histogram.");
+  m.def("reset_latency_histogram",
+        []() {
+          auto histogram =
+              std::dynamic_pointer_cast<LatencyHistogram>(trace_hook());
+          if (histogram) {
+            histogram->reset();
+          }
+        },
+        "Zero the latency histogram, if enabled.");
+  m.def("latency_snapshot",
+        []() {
+          pybind11::dict result;
+          auto histogram =
+              std::dynamic_pointer_cast<LatencyHistogram>(trace_hook());
+          if (!histogram) {
+            return result;
+          }
+          for (size_t i = 0;
+               i < size_t(TracedFunction::NUM_TRACED_FUNCTIONS); i++) {
+            const TracedFunction function = TracedFunction(i);
+            const LatencySummary summary = histogram->summary(function);
+            if (summary.count == 0) {
+              continue;
+            }
+            pybind11::dict entry;
+            entry["count"] = summary.count;
+            entry["mean_ns"] = summary.mean_ns;
+            entry["p50_ns"] = summary.p50_ns;
+            entry["p90_ns"] = summary.p90_ns;
+            entry["p99_ns"] = summary.p99_ns;
+            entry["p999_ns"] = summary.p999_ns;
+            entry["max_ns"] = summary.max_ns;
+            result[traced_function_name(function)] = entry;
+          }
+          return result;
+        },
+        R"pbdoc(
+          Return a dict mapping each native function called since the
+          histogram was enabled or reset to a dict of its call count and mean,
+          p50, p90, p99, p99.9 and max latency in nanoseconds. Quantiles are
+          within about 3%. Empty when the histogram is disabled.
+        )pbdoc");
+  m.def("dump_latency_histogram",
+        []() {
+          std::ostringstream out;
+          auto histogram =
+              std::dynamic_pointer_cast<LatencyHistogram>(trace_hook());
+          if (histogram) {
+            histogram->dump(out);
+          }
+          return out.str();
+        },
+        "Return the latency histogram as a text table in microseconds.");
+}
+
+} // namespace confseq
+
+#endif // CONFIDENCESEQUENCES_PARALLEL_VECTORIZE_H_
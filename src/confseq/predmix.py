@@ -1,5 +1,5 @@
-import math
 import numpy as np
+from confseq import capital_processes
 from confseq.betting_strategies import lambda_predmix_eb
 
 
@@ -9,6 +9,7 @@ def predmix_empbern_cs(
     truncation=1 / 2,
     running_intersection=False,
     fixed_n=None,
+    side="both",
 ):
     """
     Predictable mixture empirical Bernstein confidence sequence
@@ -31,6 +32,10 @@ def predmix_empbern_cs(
         Should lambda be optimized for a fixed time `n`?
         If left as `None`, lambda will scale as 1/sqrt(t log t)
 
+    side, "both", "lower" or "upper"
+        "lower" or "upper" spends all of `alpha` on that bound, which is
+        tighter than the two-sided one, and reports the other bound as 1 or 0
+
     Returns
     -------
     l, array-like of reals
@@ -39,6 +44,9 @@ def predmix_empbern_cs(
     u, array-like of reals
         Upper confidence sequence for the mean
     """
+    if side not in ("both", "lower", "upper"):
+        raise ValueError('side must be "both", "lower" or "upper"')
+    side_alpha = alpha / 2 if side == "both" else alpha
     x = np.array(x)
 
     t = np.arange(1, len(x) + 1)
@@ -46,17 +54,21 @@ def predmix_empbern_cs(
     mu_hat_tminus1 = np.append(0, mu_hat_t[0 : (len(x) - 1)])
 
     lambdas = lambda_predmix_eb(
-        x, truncation=truncation, alpha=alpha / 2, fixed_n=fixed_n
+        x, truncation=truncation, alpha=side_alpha, fixed_n=fixed_n
     )
 
     psi = np.power(x - mu_hat_tminus1, 2) * (-np.log(1 - lambdas) - lambdas)
-    margin = (np.log(2 / alpha) + np.cumsum(psi)) / np.cumsum(lambdas)
+    margin = (np.log(1 / side_alpha) + np.cumsum(psi)) / np.cumsum(lambdas)
 
     weighted_mu_hat_t = np.cumsum(x * lambdas) / np.cumsum(lambdas)
 
     l, u = weighted_mu_hat_t - margin, weighted_mu_hat_t + margin
     l = np.maximum(l, 0)
     u = np.minimum(u, 1)
+    if side == "lower":
+        u = np.ones_like(u)
+    elif side == "upper":
+        l = np.zeros_like(l)
 
     if running_intersection:
         l = np.maximum.accumulate(l)
@@ -155,50 +167,16 @@ def predmix_empbern_cs_wor(
     u, array-like of reals
         Upper confidence sequence for the mean
     """
-    c = upper_bd - lower_bd
-
-    x = np.array(x)
-    t = np.arange(1, len(x) + 1)
-    S_t = np.cumsum(x)
-    S_tminus1 = np.append(0, S_t[0 : (len(S_t) - 1)])
-    mu_hat_tminus1 = (1 / 2 + S_tminus1) / t
-
-    Zstar = S_tminus1 / (N - t + 1)
-    Wstar = (t - 1) / (N - t + 1)
-
-    V_t = np.cumsum(1 / 4 + np.power(x - mu_hat_tminus1, 2)) * np.power(c / 2, -2)
-    V_tminus1 = np.append(4 * np.power(c / 2, -2) / 4, V_t[0 : (len(x) - 1)])
-
-    # If the user doesn't supply a sequence of lambdas,
-    # use a sensible default.
-    if lambdas is None:
-        lambdas = np.sqrt(
-            8 * np.log(2 / alpha) / (V_tminus1 * np.log(1 + t) * np.power(c, 2))
-        )
-        lambdas[np.logical_or(np.isnan(lambdas), lambdas == math.inf)] = 0
-        lambdas = np.minimum(1 / (2 * c), lambdas)
-
-    weighted_mu_hat_t = np.cumsum(lambdas * (x + Zstar)) / np.cumsum(
-        lambdas * (1 + Wstar)
+    return capital_processes.predmix_empbern_cs_wor(
+        x,
+        N,
+        lambdas=lambdas,
+        alpha=alpha,
+        lower_bd=lower_bd,
+        upper_bd=upper_bd,
+        running_intersection=running_intersection,
     )
 
-    psi = (-np.log(1 - c * lambdas) - c * lambdas) / 4
-
-    margin = (
-        np.cumsum(np.power(c / 2, -2) * np.power(x - mu_hat_tminus1, 2) * psi)
-        + np.log(2 / alpha)
-    ) / np.cumsum(lambdas * (1 + Wstar))
-
-    l, u = weighted_mu_hat_t - margin, weighted_mu_hat_t + margin
-    l = np.maximum(l, lower_bd)
-    u = np.minimum(u, upper_bd)
-
-    if running_intersection:
-        l = np.maximum.accumulate(l)
-        u = np.minimum.accumulate(u)
-
-    return l, u
-
 
 def predmix_hoeffding_cs_wor(
     x, N, lambdas=None, alpha=0.05, lower_bd=0, upper_bd=1, running_intersection=False
@@ -237,40 +215,12 @@ def predmix_hoeffding_cs_wor(
     u, array-like of reals
         Upper confidence sequence for the mean
     """
-    x = np.array(x)
-    t = np.arange(1, len(x) + 1)
-    S_t = np.cumsum(x)
-    S_tminus1 = np.append(0, S_t[0 : (len(x) - 1)])
-
-    Zstar = S_tminus1 / (N - t + 1)
-    Wstar = (t - 1) / (N - t + 1)
-    # remove later
-    Wstar = np.append(0, t / (N - t))[0 : (len(S_t))]
-
-    if lambdas is None:
-        lambdas = np.sqrt(
-            8
-            * np.log(2 / alpha)
-            / (t * np.log(1 + t) * np.power(upper_bd - lower_bd, 2))
-        )
-        lambdas[np.logical_or(np.isnan(lambdas), lambdas == math.inf)] = 0
-        lambdas = np.minimum(1 / np.sqrt(np.power(upper_bd - lower_bd, 2)), lambdas)
-
-    psi = np.cumsum(np.power(lambdas, 2)) * np.power(upper_bd - lower_bd, 2) / 8
-
-    weighted_mu_hat_t = np.cumsum(lambdas * (x + Zstar)) / np.cumsum(
-        lambdas * (1 + Wstar)
+    return capital_processes.predmix_hoeffding_cs_wor(
+        x,
+        N,
+        lambdas=lambdas,
+        alpha=alpha,
+        lower_bd=lower_bd,
+        upper_bd=upper_bd,
+        running_intersection=running_intersection,
     )
-
-    margin = (psi + np.log(2 / alpha)) / np.cumsum(lambdas * (1 + Wstar))
-    lower_CI = weighted_mu_hat_t - margin
-    upper_CI = weighted_mu_hat_t + margin
-
-    lower_CI = np.maximum(lower_CI, lower_bd)
-    upper_CI = np.minimum(upper_CI, upper_bd)
-
-    if running_intersection:
-        lower_CI = np.maximum.accumulate(lower_CI)
-        upper_CI = np.minimum.accumulate(upper_CI)
-
-    return lower_CI, upper_CI
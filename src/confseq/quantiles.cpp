@@ -1,28 +1,406 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
+#include "parallel_vectorize.h"
 #include "uniform_boundaries.h"
 
 using namespace pybind11::literals;
 
-double quantile_ab_p_value(pybind11::array_t<double> a_values,
-                           pybind11::array_t<double> b_values,
+using ContiguousArray = pybind11::array_t<
+    double, pybind11::array::c_style | pybind11::array::forcecast>;
+
+template <class Value>
+bool has_contiguous_dtype(const pybind11::array& values) {
+  return pybind11::isinstance<
+      pybind11::array_t<Value, pybind11::array::c_style>>(values);
+}
+
+// Calls fn(first, last) on the values of a 1-D array. C-contiguous float64,
+// float32, int32 and int64 arrays are read in place as their own type; others
+// are converted to doubles held in converted.
+template <class Fn>
+void with_values(const pybind11::array& values, ContiguousArray& converted,
+                 Fn fn) {
+  if (has_contiguous_dtype<double>(values)) {
+    const double* first = static_cast<const double*>(values.data());
+    fn(first, first + values.size());
+  } else if (has_contiguous_dtype<float>(values)) {
+    const float* first = static_cast<const float*>(values.data());
+    fn(first, first + values.size());
+  } else if (has_contiguous_dtype<int32_t>(values)) {
+    const int32_t* first = static_cast<const int32_t*>(values.data());
+    fn(first, first + values.size());
+  } else if (has_contiguous_dtype<int64_t>(values)) {
+    const int64_t* first = static_cast<const int64_t*>(values.data());
+    fn(first, first + values.size());
+  } else {
+    converted = ContiguousArray::ensure(values);
+    if (!converted) {
+      throw pybind11::error_already_set();
+    }
+    fn(converted.data(), converted.data() + converted.size());
+  }
+}
+
+// Order statistics for both arms, with any converted copies of the values
+// they read.
+struct ArmOrderStatistics {
+  std::array<std::shared_ptr<confseq::OrderStatisticInterface>, 2> arms;
+  std::array<ContiguousArray, 2> converted;
+};
+
+// Tie-compressed order statistics of values, with weights[i] copies of
+// values[i] if weights is not None.
+std::shared_ptr<confseq::OrderStatisticInterface> compressed_order_statistics(
+    const pybind11::array& values, const pybind11::object& weights) {
+  if (weights.is_none()) {
+    std::shared_ptr<confseq::OrderStatisticInterface> os;
+    ContiguousArray converted;
+    with_values(values, converted, [&](const auto* first, const auto* last) {
+      pybind11::gil_scoped_release release;
+      os = std::make_shared<confseq::StaticOrderStatistics>(first, last, 0,
+                                                            true);
+    });
+    return os;
+  }
+  const pybind11::array weight_array = pybind11::array::ensure(weights);
+  if (!weight_array || (weight_array.dtype().kind() != 'i'
+                        && weight_array.dtype().kind() != 'u')) {
+    throw pybind11::value_error("weights must be an integer array");
+  }
+  const ContiguousArray value_array = ContiguousArray::ensure(values);
+  const auto counts = pybind11::array_t<
+      int64_t, pybind11::array::c_style | pybind11::array::forcecast>::ensure(
+          weight_array);
+  if (!value_array || !counts || value_array.ndim() != 1
+      || counts.size() != value_array.size()) {
+    throw pybind11::value_error(
+        "weights must be 1-D and the same length as their values");
+  }
+  pybind11::gil_scoped_release release;
+  return std::make_shared<confseq::StaticOrderStatistics>(
+      value_array.data(), counts.data(), value_array.size());
+}
+
+// With assume_sorted, arrays are read in place through views rather than
+// copied and sorted. The arrays stay alive for the duration of the call.
+// With weights for either arm, or compress_ties, both arms are instead held
+// as tie-compressed runs, which QuantileABTest scans one distinct value at a
+// time.
+ArmOrderStatistics arm_order_statistics(const pybind11::array& a_values,
+                                        const pybind11::array& b_values,
+                                        const bool assume_sorted,
+                                        const bool check_sorted,
+                                        const pybind11::object& a_weights,
+                                        const pybind11::object& b_weights,
+                                        const bool compress_ties) {
+  ArmOrderStatistics result;
+  if (compress_ties || !a_weights.is_none() || !b_weights.is_none()) {
+    result.arms[0] = compressed_order_statistics(a_values, a_weights);
+    result.arms[1] = compressed_order_statistics(b_values, b_weights);
+    return result;
+  }
+  with_values(a_values, result.converted[0], [&](const auto* a_first,
+                                                 const auto* a_last) {
+    with_values(b_values, result.converted[1], [&](const auto* b_first,
+                                                   const auto* b_last) {
+      if (assume_sorted && check_sorted
+          && !(std::is_sorted(a_first, a_last)
+               && std::is_sorted(b_first, b_last))) {
+        throw pybind11::value_error("values are not sorted");
+      }
+      pybind11::gil_scoped_release release;
+      result.arms = confseq::two_arm_order_statistics(
+          a_first, a_last, b_first, b_last, assume_sorted);
+    });
+  });
+  return result;
+}
+
+double quantile_ab_p_value(const pybind11::array a_values,
+                           const pybind11::array b_values,
                            const double quantile_p, const int t_opt,
-                           const double alpha_opt=0.05) {
-  const pybind11::buffer_info a_buffer = a_values.request(),
-      b_buffer = b_values.request();
-  auto a_os = std::make_unique<confseq::StaticOrderStatistics>(
-      (double*) a_buffer.ptr, (double*) a_buffer.ptr + a_buffer.shape[0]);
-  auto b_os = std::make_unique<confseq::StaticOrderStatistics>(
-      (double*) b_buffer.ptr, (double*) b_buffer.ptr + b_buffer.shape[0]);
-  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, std::move(a_os),
-                               std::move(b_os));
+                           const double alpha_opt=0.05,
+                           const bool assume_sorted=false,
+                           const bool check_sorted=true,
+                           const pybind11::object a_weights=pybind11::none(),
+                           const pybind11::object b_weights=pybind11::none(),
+                           const bool compress_ties=false) {
+  const ArmOrderStatistics os = arm_order_statistics(
+      a_values, b_values, assume_sorted, check_sorted, a_weights, b_weights,
+      compress_ties);
+  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, os.arms[0],
+                               os.arms[1]);
   return test.p_value();
 }
 
+// quantile_ab_p_value with the mixture of a reusable config.
+double config_quantile_ab_p_value(
+    const std::shared_ptr<confseq::QuantileABTestConfig>& config,
+    const pybind11::array a_values, const pybind11::array b_values,
+    const bool assume_sorted, const bool check_sorted,
+    const pybind11::object a_weights, const pybind11::object b_weights,
+    const bool compress_ties) {
+  const ArmOrderStatistics os = arm_order_statistics(
+      a_values, b_values, assume_sorted, check_sorted, a_weights, b_weights,
+      compress_ties);
+  pybind11::gil_scoped_release release;
+  const confseq::QuantileABTest test(config, os.arms[0], os.arms[1]);
+  return test.p_value();
+}
+
+double order_statistics_quantile_ab_p_value(
+    std::shared_ptr<confseq::OrderStatisticInterface> a_os,
+    std::shared_ptr<confseq::OrderStatisticInterface> b_os,
+    const double quantile_p, const int t_opt, const double alpha_opt=0.05) {
+  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, a_os, b_os);
+  return test.p_value();
+}
+
+pybind11::array_t<double> quantile_ab_p_values(
+    const pybind11::array a_values, const pybind11::array b_values,
+    const ContiguousArray quantile_p, const int t_opt,
+    const double alpha_opt=0.05, const bool assume_sorted=false,
+    const bool check_sorted=true,
+    const pybind11::object a_weights=pybind11::none(),
+    const pybind11::object b_weights=pybind11::none(),
+    const bool compress_ties=false) {
+  const ArmOrderStatistics os = arm_order_statistics(
+      a_values, b_values, assume_sorted, check_sorted, a_weights, b_weights,
+      compress_ties);
+  pybind11::array_t<double> p_values(quantile_p.size());
+  const double* quantile_p_data = quantile_p.data();
+  double* p_values_data = p_values.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::quantile_ab_p_values(os.arms[0], os.arms[1], quantile_p_data,
+                                  quantile_p.size(), t_opt, alpha_opt,
+                                  p_values_data);
+  }
+  return p_values;
+}
+
+using OffsetArray = pybind11::array_t<
+    size_t, pybind11::array::c_style | pybind11::array::forcecast>;
+
+// Concatenated values and offsets of the arms of one side of
+// batch_quantile_ab_p_values: values held flat with offsets, or a sequence
+// of 1-D arrays, one per pair, if offsets is None.
+struct RaggedArms {
+  ContiguousArray flat;
+  std::vector<double> concatenated;
+  std::vector<size_t> offsets;
+
+  const double* values() const {
+    return flat ? flat.data() : concatenated.data();
+  }
+};
+
+RaggedArms ragged_arms(const pybind11::object& values,
+                       const pybind11::object& offsets) {
+  RaggedArms arms;
+  if (offsets.is_none()) {
+    arms.offsets.push_back(0);
+    for (const pybind11::handle arm : values) {
+      const ContiguousArray array = ContiguousArray::ensure(arm);
+      if (!array || array.ndim() != 1) {
+        throw pybind11::value_error("each arm must be a 1-D array");
+      }
+      arms.concatenated.insert(arms.concatenated.end(), array.data(),
+                               array.data() + array.size());
+      arms.offsets.push_back(arms.concatenated.size());
+    }
+    return arms;
+  }
+  arms.flat = ContiguousArray::ensure(values);
+  const OffsetArray offset_array = OffsetArray::ensure(offsets);
+  if (!arms.flat || !offset_array) {
+    throw pybind11::value_error("values and offsets must be arrays");
+  }
+  arms.offsets.assign(offset_array.data(),
+                      offset_array.data() + offset_array.size());
+  if (arms.offsets.empty() || arms.offsets.front() != 0
+      || arms.offsets.back() != size_t(arms.flat.size())
+      || !std::is_sorted(arms.offsets.begin(), arms.offsets.end())) {
+    throw pybind11::value_error(
+        "offsets must run nondecreasing from 0 to the number of values");
+  }
+  return arms;
+}
+
+pybind11::array_t<double> batch_quantile_ab_p_values(
+    const pybind11::object a_values, const pybind11::object b_values,
+    const pybind11::object quantile_p, const pybind11::object t_opt,
+    const double alpha_opt=0.05,
+    const pybind11::object a_offsets=pybind11::none(),
+    const pybind11::object b_offsets=pybind11::none()) {
+  const RaggedArms a = ragged_arms(a_values, a_offsets);
+  const RaggedArms b = ragged_arms(b_values, b_offsets);
+  if (a.offsets.size() != b.offsets.size()) {
+    throw pybind11::value_error("both sides must have the same number of arms");
+  }
+  const size_t num_pairs = a.offsets.size() - 1;
+  const pybind11::object broadcast_to =
+      pybind11::module::import("numpy").attr("broadcast_to");
+  const ContiguousArray levels = ContiguousArray::ensure(
+      broadcast_to(quantile_p, pybind11::make_tuple(num_pairs)));
+  const auto t_opts = pybind11::array_t<
+      int, pybind11::array::c_style | pybind11::array::forcecast>::ensure(
+          broadcast_to(t_opt, pybind11::make_tuple(num_pairs)));
+  if (!levels || !t_opts) {
+    throw pybind11::error_already_set();
+  }
+  for (size_t i = 0; i < num_pairs; i++) {
+    if (!(0 < levels.data()[i] && levels.data()[i] < 1)) {
+      throw pybind11::value_error("quantile_p must be in (0, 1)");
+    }
+  }
+  pybind11::array_t<double> p_values(num_pairs);
+  double* p_values_data = p_values.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    confseq::batch_quantile_ab_p_values(
+        a.values(), a.offsets.data(), b.values(), b.offsets.data(), num_pairs,
+        levels.data(), t_opts.data(), alpha_opt, p_values_data);
+  }
+  return p_values;
+}
+
+bool quantile_ab_rejects(const pybind11::array a_values,
+                         const pybind11::array b_values,
+                         const double quantile_p, const int t_opt,
+                         const double alpha, const double alpha_opt=0.05,
+                         const bool assume_sorted=false,
+                         const bool check_sorted=true,
+                         const pybind11::object a_weights=pybind11::none(),
+                         const pybind11::object b_weights=pybind11::none(),
+                         const bool compress_ties=false) {
+  const ArmOrderStatistics os = arm_order_statistics(
+      a_values, b_values, assume_sorted, check_sorted, a_weights, b_weights,
+      compress_ties);
+  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, os.arms[0],
+                               os.arms[1]);
+  return test.rejects(alpha);
+}
+
+pybind11::tuple quantile_difference_cs(
+    const pybind11::array a_values, const pybind11::array b_values,
+    const double quantile_p, const int t_opt, const double alpha,
+    const double alpha_opt=0.05, const double tolerance=1e-9,
+    const bool assume_sorted=false, const bool check_sorted=true,
+    const pybind11::object a_weights=pybind11::none(),
+    const pybind11::object b_weights=pybind11::none(),
+    const bool compress_ties=false) {
+  const ArmOrderStatistics os = arm_order_statistics(
+      a_values, b_values, assume_sorted, check_sorted, a_weights, b_weights,
+      compress_ties);
+  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, os.arms[0],
+                               os.arms[1]);
+  std::pair<double, double> cs;
+  {
+    pybind11::gil_scoped_release release;
+    cs = test.quantile_difference_cs(alpha, tolerance);
+  }
+  return pybind11::make_tuple(cs.first, cs.second);
+}
+
+double quantile_ab_shifted_p_value(
+    const pybind11::array a_values, const pybind11::array b_values,
+    const double quantile_p, const int t_opt, const double delta,
+    const double alpha_opt=0.05, const bool assume_sorted=false,
+    const bool check_sorted=true,
+    const pybind11::object a_weights=pybind11::none(),
+    const pybind11::object b_weights=pybind11::none(),
+    const bool compress_ties=false) {
+  const ArmOrderStatistics os = arm_order_statistics(
+      a_values, b_values, assume_sorted, check_sorted, a_weights, b_weights,
+      compress_ties);
+  confseq::QuantileABTest test(quantile_p, t_opt, alpha_opt, os.arms[0],
+                               os.arms[1]);
+  return test.shifted_p_value(delta);
+}
+
+pybind11::tuple double_stitching_quantile_band(
+    pybind11::array_t<double> values, pybind11::array_t<double> quantile_p,
+    const double alpha, const double t_opt, const double delta=0.5,
+    const double s=1.4, const double eta=2) {
+  const pybind11::buffer_info values_buffer = values.request();
+  const confseq::StaticOrderStatistics order_stats(
+      (double*) values_buffer.ptr,
+      (double*) values_buffer.ptr + values_buffer.shape[0]);
+  const pybind11::array_t<double, pybind11::array::c_style
+                          | pybind11::array::forcecast> p(quantile_p);
+  pybind11::array_t<double> lower(p.size()), upper(p.size());
+  confseq::DoubleStitchingBound bound(t_opt, delta, s, eta);
+  bound.quantile_band(order_stats, p.data(), p.size(), alpha,
+                      lower.mutable_data(), upper.mutable_data());
+  return pybind11::make_tuple(lower, upper);
+}
+
+// (x, lower, upper) for the CDF band of bound on order_stats at x, or at the
+// distinct values of order_stats, in increasing order, if x is None.
+pybind11::tuple ecdf_band(const confseq::EmpiricalProcessLILBound& bound,
+                          const confseq::OrderStatisticInterface& order_stats,
+                          const pybind11::object x) {
+  if (x.is_none()) {
+    std::vector<double> values, lower, upper;
+    bound.ecdf_band(order_stats, &values, &lower, &upper);
+    return pybind11::make_tuple(
+        pybind11::array_t<double>(values.size(), values.data()),
+        pybind11::array_t<double>(lower.size(), lower.data()),
+        pybind11::array_t<double>(upper.size(), upper.data()));
+  }
+  const ContiguousArray points = x.cast<ContiguousArray>();
+  pybind11::array_t<double> lower(points.size()), upper(points.size());
+  bound.ecdf_band(order_stats, points.data(), points.size(),
+                  lower.mutable_data(), upper.mutable_data());
+  return pybind11::make_tuple(points, lower, upper);
+}
+
+using TimeArray = pybind11::array_t<
+    size_t, pybind11::array::c_style | pybind11::array::forcecast>;
+
+// (lower, upper) arrays of shape (len(t), len(quantile_p)) filled by
+// fill(x, t, p, lower, upper) with the GIL released, after checking that t
+// is nondecreasing and at most len(values).
+template <class Fill>
+pybind11::tuple quantile_band_matrix(const ContiguousArray values,
+                                     const TimeArray t,
+                                     const ContiguousArray quantile_p,
+                                     Fill fill) {
+  if (t.size() > 0 && t.data()[t.size() - 1] > size_t(values.size())) {
+    throw pybind11::value_error("t must not exceed len(values)");
+  }
+  const std::vector<pybind11::ssize_t> shape{
+      pybind11::ssize_t(t.size()), pybind11::ssize_t(quantile_p.size())};
+  pybind11::array_t<double> lower(shape), upper(shape);
+  const double* x = values.data();
+  const size_t* times = t.data();
+  const double* p = quantile_p.data();
+  double* lower_data = lower.mutable_data();
+  double* upper_data = upper.mutable_data();
+  {
+    pybind11::gil_scoped_release release;
+    try {
+      fill(x, times, p, lower_data, upper_data);
+    } catch (const std::invalid_argument& e) {
+      throw pybind11::value_error(e.what());
+    }
+  }
+  return pybind11::make_tuple(lower, upper);
+}
+
 PYBIND11_MODULE(quantiles, m) {
+  confseq::define_thread_settings(m);
+  confseq::define_solver_counters(m);
+  confseq::define_latency_tracing(m);
   m.def("empirical_process_lil_bound",
-        pybind11::vectorize(confseq::empirical_process_lil_bound),
+        confseq::parallel_vectorize(confseq::empirical_process_lil_bound),
         R"pbdoc(
           Empirical process finite LIL bound.
 
@@ -36,10 +414,24 @@ PYBIND11_MODULE(quantiles, m) {
           uniform over quantiles and time (Corollary 2 of the quantile paper).
 
           * `A`: leading constant in the bound
+
+          A C-contiguous float32 `t` with scalar other arguments gives float32
+          bounds, each rounded up from the float64 bound.
         )pbdoc",
-        "t"_a, "alpha"_a, "t_min"_a, "A"_a=0.85);
+        "t"_a, "alpha"_a, "t_min"_a, "A"_a=0.85,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("empirical_process_lil_bound",
+        [](const confseq::Float32Array t, const double alpha,
+           const double t_min, const double A) {
+          const confseq::EmpiricalProcessLILBound bound(alpha, t_min, A);
+          return confseq::float32_blocks(
+              t, [&](const float* t, const size_t n, float* out) {
+                bound.bound_sequence(t, n, out);
+              });
+        },
+        "t"_a.noconvert(), "alpha"_a, "t_min"_a, "A"_a=0.85);
   m.def("double_stitching_bound",
-        pybind11::vectorize(confseq::double_stitching_bound),
+        confseq::parallel_vectorize(confseq::double_stitching_bound),
         R"pbdoc(
           "Double stitching" bound (Theorem 3 of the quantile paper).
 
@@ -50,18 +442,728 @@ PYBIND11_MODULE(quantiles, m) {
             construction of the bound
           * `s`: controls how crossing probability is distribted over epochs
           * `eta`: controls the spacing of epochs
+
+          A C-contiguous float32 `quantile_p` with scalar other arguments
+          gives float32 bounds, each rounded up from the float64 bound.
         )pbdoc",
         "quantile_p"_a, "t"_a, "alpha"_a, "t_opt"_a, "delta"_a=0.5, "s"_a=1.4,
-        "eta"_a=2);
+        "eta"_a=2,
+        "out"_a=pybind11::none(), "where"_a=true);
+  m.def("double_stitching_bound",
+        [](const confseq::Float32Array quantile_p, const double t,
+           const double alpha, const double t_opt, const double delta,
+           const double s, const double eta) {
+          const confseq::DoubleStitchingBound bound(t_opt, delta, s, eta);
+          return confseq::float32_blocks(
+              quantile_p, [&](const float* p, const size_t n, float* out) {
+                bound.band(p, n, t, alpha, out);
+              });
+        },
+        "quantile_p"_a.noconvert(), "t"_a, "alpha"_a, "t_opt"_a,
+        "delta"_a=0.5, "s"_a=1.4, "eta"_a=2);
+  m.def("double_stitching_quantile_band",
+        &double_stitching_quantile_band,
+        R"pbdoc(
+          Confidence band over many quantiles from the double stitching bound.
+
+          Returns arrays `(lower, upper)` of confidence bounds for each level in
+          `quantile_p`, taken as order statistics of `values` at t =
+          len(values). Bounds are -inf or inf when the corresponding order
+          statistic has not been observed. Per-t terms of the bound are
+          computed once for the whole band.
+        )pbdoc",
+        "values"_a, "quantile_p"_a, "alpha"_a, "t_opt"_a, "delta"_a=0.5,
+        "s"_a=1.4, "eta"_a=2);
+  m.def("ecdf_confidence_band",
+        [](const ContiguousArray values, const double alpha,
+           const double t_min, const double A, const pybind11::object x) {
+          const confseq::EmpiricalProcessLILBound bound(alpha, t_min, A);
+          const confseq::StaticOrderStatistics order_stats(
+              values.data(), values.data() + values.size());
+          return ecdf_band(bound, order_stats, x);
+        },
+        R"pbdoc(
+          Confidence band for the CDF from `empirical_process_lil_bound()`,
+          uniform over x and time. Returns `(x, lower, upper)`: the empirical
+          CDF of `values` at each point of `x` minus and plus the bound at
+          t = len(values), clipped to [0, 1]. If `x` is None, the band is
+          given at the distinct values, in increasing order, between which
+          it is constant. The values are sorted once and C is found once.
+        )pbdoc",
+        "values"_a, "alpha"_a, "t_min"_a, "A"_a=0.85,
+        "x"_a=pybind11::none());
+  m.def("double_stitching_band_matrix",
+        [](const ContiguousArray t, const ContiguousArray quantile_p,
+           const double alpha, const double t_opt, const double delta,
+           const double s, const double eta, const int num_threads) {
+          const confseq::DoubleStitchingBound bound(t_opt, delta, s, eta);
+          const std::vector<pybind11::ssize_t> shape{
+              pybind11::ssize_t(t.size()),
+              pybind11::ssize_t(quantile_p.size())};
+          pybind11::array_t<double> out(shape);
+          const double* t_data = t.data();
+          const double* p_data = quantile_p.data();
+          double* out_data = out.mutable_data();
+          {
+            pybind11::gil_scoped_release release;
+            bound.band_matrix(t_data, t.size(), p_data, quantile_p.size(),
+                              alpha, out_data, num_threads);
+          }
+          return out;
+        },
+        R"pbdoc(
+          `double_stitching_bound()` at every time in `t` and level in
+          `quantile_p`, as an array of shape `(len(t), len(quantile_p))`.
+          Rows are computed across threads with the GIL released, each
+          computing its per-t terms once.
+        )pbdoc",
+        "t"_a, "quantile_p"_a, "alpha"_a, "t_opt"_a, "delta"_a=0.5,
+        "s"_a=1.4, "eta"_a=2, "num_threads"_a=0);
+  m.def("double_stitching_quantile_band_matrix",
+        [](const ContiguousArray values, const TimeArray t,
+           const ContiguousArray quantile_p, const double alpha,
+           const double t_opt, const double delta, const double s,
+           const double eta, const int num_threads) {
+          const confseq::DoubleStitchingBound bound(t_opt, delta, s, eta);
+          return quantile_band_matrix(
+              values, t, quantile_p,
+              [&](const double* x, const size_t* times, const double* p,
+                  double* lower, double* upper) {
+                bound.quantile_band_matrix(x, times, t.size(), p,
+                                           quantile_p.size(), alpha, lower,
+                                           upper, num_threads);
+              });
+        },
+        R"pbdoc(
+          `double_stitching_quantile_band()` on each prefix
+          `values[:t[i]]`, for nondecreasing `t`, as `(lower, upper)` arrays
+          of shape `(len(t), len(quantile_p))` for time-by-quantile heatmaps.
+          The order statistic indices come from one computation of the bound
+          per time, across threads, and the values from one pass over
+          `values`, inserting each value once instead of sorting each prefix.
+        )pbdoc",
+        "values"_a, "t"_a, "quantile_p"_a, "alpha"_a, "t_opt"_a,
+        "delta"_a=0.5, "s"_a=1.4, "eta"_a=2, "num_threads"_a=0);
+  m.def("empirical_process_lil_quantile_band_matrix",
+        [](const ContiguousArray values, const TimeArray t,
+           const ContiguousArray quantile_p, const double alpha,
+           const double t_min, const double A, const int num_threads) {
+          const confseq::EmpiricalProcessLILBound bound(alpha, t_min, A);
+          return quantile_band_matrix(
+              values, t, quantile_p,
+              [&](const double* x, const size_t* times, const double* p,
+                  double* lower, double* upper) {
+                bound.quantile_band_matrix(x, times, t.size(), p,
+                                           quantile_p.size(), lower, upper,
+                                           num_threads);
+              });
+        },
+        R"pbdoc(
+          As `double_stitching_quantile_band_matrix()`, with the constant
+          quantile-space radius of `empirical_process_lil_bound()`: the
+          bounds for level p after t values are the floor(t (p - bound) + 1)th
+          and ceil(t (p + bound))th smallest, or -inf and inf outside the
+          sample.
+        )pbdoc",
+        "values"_a, "t"_a, "quantile_p"_a, "alpha"_a, "t_min"_a, "A"_a=0.85,
+        "num_threads"_a=0);
+  pybind11::class_<confseq::OrderStatisticInterface,
+                   std::shared_ptr<confseq::OrderStatisticInterface>>(
+      m, "OrderStatisticInterface",
+      R"pbdoc(
+        Base class for order statistics of one arm, accepted by
+        `quantile_ab_p_value()` in place of an array of values.
+      )pbdoc")
+      .def("get_order_statistic",
+           &confseq::OrderStatisticInterface::get_order_statistic,
+           "order_index"_a)
+      .def("count_less", &confseq::OrderStatisticInterface::count_less,
+           "value"_a)
+      .def("count_less_or_equal",
+           &confseq::OrderStatisticInterface::count_less_or_equal, "value"_a)
+      .def("count_less_batch",
+           [](const confseq::OrderStatisticInterface& os,
+              const ContiguousArray values, const int num_threads) {
+             pybind11::array_t<int> counts(values.size());
+             int* out = counts.mutable_data();
+             pybind11::gil_scoped_release release;
+             os.count_less_batch(values.data(), values.size(), out,
+                                 num_threads);
+             return counts;
+           },
+           R"pbdoc(
+             `count_less()` of each of `values`, in one merge pass when
+             `values` are nondecreasing and the arm is held as a sorted
+             array, and across `num_threads` threads otherwise.
+           )pbdoc",
+           "values"_a, "num_threads"_a=0)
+      .def("count_less_or_equal_batch",
+           [](const confseq::OrderStatisticInterface& os,
+              const ContiguousArray values, const int num_threads) {
+             pybind11::array_t<int> counts(values.size());
+             int* out = counts.mutable_data();
+             pybind11::gil_scoped_release release;
+             os.count_less_or_equal_batch(values.data(), values.size(), out,
+                                          num_threads);
+             return counts;
+           },
+           R"pbdoc(
+             As `count_less_batch()`, for `count_less_or_equal()`.
+           )pbdoc",
+           "values"_a, "num_threads"_a=0)
+      .def("__len__", &confseq::OrderStatisticInterface::size)
+      .def_property_readonly("rank_error",
+                             &confseq::OrderStatisticInterface::rank_error);
+  pybind11::class_<confseq::DynamicOrderStatistics,
+                   confseq::OrderStatisticInterface,
+                   std::shared_ptr<confseq::DynamicOrderStatistics>>(
+      m, "DynamicOrderStatistics",
+      R"pbdoc(
+        Order statistics over a growing sample, for re-running
+        `quantile_ab_p_value()` as data arrives without re-sorting each arm.
+        Samples can be pickled.
+      )pbdoc")
+      .def(pybind11::init<>())
+      .def(pybind11::init([](const pybind11::array_t<double> values) {
+             const pybind11::buffer_info buffer = values.request();
+             return std::make_shared<confseq::DynamicOrderStatistics>(
+                 (double*) buffer.ptr, (double*) buffer.ptr + buffer.shape[0]);
+           }),
+           "values"_a)
+      .def("insert",
+           [](confseq::DynamicOrderStatistics& os,
+              const pybind11::array_t<double> values) {
+             const pybind11::buffer_info buffer = values.request();
+             os.insert((double*) buffer.ptr,
+                       (double*) buffer.ptr + buffer.shape[0]);
+           },
+           R"pbdoc(
+             Add the values of a 1-D array to the sample.
+           )pbdoc",
+           "values"_a)
+      .def("save",
+           [](const confseq::DynamicOrderStatistics& os,
+              const std::string path) {
+             std::ofstream out(path, std::ios::binary);
+             os.save(out);
+             if (!out) {
+               throw std::runtime_error("Unable to write " + path);
+             }
+           },
+           R"pbdoc(
+             Write the sample to `path` as a sorted column, which
+             `MappedOrderStatistics.map_file()` maps without copying.
+           )pbdoc",
+           "path"_a)
+      .def(confseq::checkpoint_pickle<confseq::DynamicOrderStatistics>());
+  pybind11::class_<confseq::HistogramOrderStatistics,
+                   confseq::OrderStatisticInterface,
+                   std::shared_ptr<confseq::HistogramOrderStatistics>>(
+      m, "HistogramOrderStatistics",
+      R"pbdoc(
+        Exact order statistics of a sample with few distinct values, such as
+        integer milliseconds or counts, built from `values` and, optionally,
+        the number of copies `counts` of each. Memory grows with the number of
+        distinct values rather than the sample size, and queries take time
+        logarithmic in it. Samples can be pickled.
+      )pbdoc")
+      .def(pybind11::init<>())
+      .def(pybind11::init([](const pybind11::array_t<
+                                 double, pybind11::array::c_style
+                                             | pybind11::array::forcecast>
+                                 values,
+                             const pybind11::object counts) {
+             pybind11::array_t<int64_t, pybind11::array::c_style
+                                            | pybind11::array::forcecast>
+                 count_array;
+             if (counts.is_none()) {
+               count_array = pybind11::array_t<int64_t>(values.size());
+               std::fill_n(count_array.mutable_data(), values.size(), 1);
+             } else {
+               count_array = pybind11::cast<decltype(count_array)>(counts);
+             }
+             if (values.ndim() != 1 || count_array.size() != values.size()) {
+               throw pybind11::value_error(
+                   "values and counts must be 1-D and the same length");
+             }
+             return std::make_shared<confseq::HistogramOrderStatistics>(
+                 values.data(), count_array.data(), values.size());
+           }),
+           "values"_a, "counts"_a=pybind11::none())
+      .def("insert",
+           [](confseq::HistogramOrderStatistics& os, const double value,
+              const int64_t count) { os.insert(value, count); },
+           R"pbdoc(
+             Add `count` copies of `value` to the sample.
+           )pbdoc",
+           "value"_a, "count"_a=1)
+      .def_property_readonly(
+          "values",
+          [](const confseq::HistogramOrderStatistics& os) {
+            return pybind11::array_t<double>(os.values().size(),
+                                             os.values().data());
+          },
+          "The distinct values in ascending order.")
+      .def_property_readonly(
+          "counts",
+          [](const confseq::HistogramOrderStatistics& os) {
+            return pybind11::array_t<int>(os.counts().size(),
+                                          os.counts().data());
+          },
+          "The number of copies of each of `values`.")
+      .def(pybind11::pickle(
+          [](const confseq::HistogramOrderStatistics& os) {
+            return pybind11::make_tuple(
+                pybind11::array_t<double>(os.values().size(),
+                                          os.values().data()),
+                std::vector<int64_t>(os.counts().begin(), os.counts().end()));
+          },
+          [](const pybind11::tuple state) {
+            const auto values =
+                state[0].cast<pybind11::array_t<double>>();
+            const auto counts = state[1].cast<std::vector<int64_t>>();
+            return std::make_shared<confseq::HistogramOrderStatistics>(
+                values.data(), counts.data(), counts.size());
+          }));
+  pybind11::class_<confseq::SketchOrderStatistics,
+                   confseq::OrderStatisticInterface,
+                   std::shared_ptr<confseq::SketchOrderStatistics>>(
+      m, "SketchOrderStatistics",
+      R"pbdoc(
+        Order statistics from a deterministic quantile sketch holding about
+        `k log2(n / k)` values. Counts are within `rank_error` of the full
+        sample, at most `2 n log2(n / k) / k`, and `quantile_ab_p_value()`
+        widens them by that amount so its p-values stay conservative.
+      )pbdoc")
+      .def(pybind11::init<int>(), "k"_a=4096)
+      .def("insert",
+           [](confseq::SketchOrderStatistics& os,
+              const pybind11::array_t<double> values) {
+             const pybind11::buffer_info buffer = values.request();
+             os.insert((double*) buffer.ptr,
+                       (double*) buffer.ptr + buffer.shape[0]);
+           },
+           R"pbdoc(
+             Add the values of a 1-D array to the sketch.
+           )pbdoc",
+           "values"_a)
+      .def("merge", &confseq::SketchOrderStatistics::merge,
+           R"pbdoc(
+             Add the sample summarized by `other`, a sketch with the same `k`,
+             such as one built on another node from a disjoint shard of the
+             arm. `rank_error` grows to cover both.
+           )pbdoc",
+           "other"_a)
+      .def("to_bytes",
+           [](const confseq::SketchOrderStatistics& os) {
+             std::ostringstream out;
+             os.save(out);
+             return pybind11::bytes(out.str());
+           },
+           "Serialize the sketch, for `from_bytes()` on another node.")
+      .def_static("from_bytes",
+                  [](const std::string& data) {
+                    std::istringstream in(data);
+                    return std::make_shared<confseq::SketchOrderStatistics>(
+                        confseq::SketchOrderStatistics::load(in));
+                  },
+                  "data"_a)
+      .def_property_readonly("k", &confseq::SketchOrderStatistics::k)
+      .def_property_readonly("num_retained",
+                             &confseq::SketchOrderStatistics::num_retained)
+      .def(confseq::checkpoint_pickle<confseq::SketchOrderStatistics>());
+  pybind11::class_<confseq::MappedOrderStatistics,
+                   confseq::OrderStatisticInterface,
+                   std::shared_ptr<confseq::MappedOrderStatistics>>(
+      m, "MappedOrderStatistics",
+      R"pbdoc(
+        Order statistics over a sorted column file written by
+        `build_sorted_column()`. `map_file()` memory-maps the column, so
+        `quantile_ab_p_value()` reads only the pages it needs through the page
+        cache, and samples need not fit in memory.
+      )pbdoc")
+      .def_static("map_file",
+                  [](const std::string path) {
+                    return std::make_shared<confseq::MappedOrderStatistics>(
+                        confseq::MappedOrderStatistics::map_file(path));
+                  },
+                  "path"_a);
+  m.def("build_sorted_column",
+        &confseq::build_sorted_column,
+        R"pbdoc(
+          Write a sorted column file for `MappedOrderStatistics.map_file()`
+          from `input_path`, a file of raw native-endian float64 values such as
+          one written by `ndarray.tofile()`. Values are sorted by external merge
+          sort, holding at most `max_values_in_memory` values in memory at once
+          and writing temporary runs next to `output_path`.
+        )pbdoc",
+        "input_path"_a, "output_path"_a,
+        "max_values_in_memory"_a=size_t(1) << 27,
+        pybind11::call_guard<pybind11::gil_scoped_release>());
+  pybind11::class_<confseq::CDFConfidenceSequence>(
+      m, "CDFConfidenceSequence",
+      R"pbdoc(
+        Confidence sequence for the CDF of a stream, as
+        `ecdf_confidence_band()` gives on all values so far. Batches arrive
+        through `add()` into dynamic order statistics, and `band()` reads the
+        band off them without re-sorting, so it can be redrawn often.
+
+        Parameters are as for `empirical_process_lil_bound()`.
+      )pbdoc")
+      .def(pybind11::init<double, double, double>(), "alpha"_a, "t_min"_a,
+           "A"_a=0.85)
+      .def("add",
+           [](confseq::CDFConfidenceSequence& sequence,
+              const ContiguousArray values) {
+             sequence.add(values.data(), values.data() + values.size());
+           },
+           R"pbdoc(
+             Add the values of a 1-D array to the stream.
+           )pbdoc",
+           "values"_a)
+      .def("band",
+           [](const confseq::CDFConfidenceSequence& sequence,
+              const pybind11::object x) {
+             return ecdf_band(sequence.bound(), sequence.order_stats(), x);
+           },
+           R"pbdoc(
+             `(x, lower, upper)` as for `ecdf_confidence_band()` on the values
+             so far.
+           )pbdoc",
+           "x"_a=pybind11::none())
+      .def("__len__", &confseq::CDFConfidenceSequence::size);
+  pybind11::class_<confseq::QuantileConfidenceSequence>(
+      m, "QuantileConfidenceSequence",
+      R"pbdoc(
+        Confidence sequence for quantiles of a stream, from the double
+        stitching bound. Batches of values arrive through `add()`, and
+        `interval()` reads bounds at the current time off the sorted values
+        so far, without re-sorting.
+
+        Parameters are as for `double_stitching_bound()`.
+      )pbdoc")
+      .def(pybind11::init<double, int, double, double, double>(), "alpha"_a,
+           "t_opt"_a, "delta"_a=0.5, "s"_a=1.4, "eta"_a=2)
+      .def("add",
+           [](confseq::QuantileConfidenceSequence& sequence,
+              const ContiguousArray values) {
+             sequence.add(values.data(), values.data() + values.size());
+           },
+           R"pbdoc(
+             Add the values of a 1-D array to the stream.
+           )pbdoc",
+           "values"_a)
+      .def("interval",
+           [](const confseq::QuantileConfidenceSequence& sequence,
+              const ContiguousArray quantile_p) {
+             pybind11::array_t<double> lower(quantile_p.size()),
+                 upper(quantile_p.size());
+             sequence.intervals(quantile_p.data(), quantile_p.size(),
+                                lower.mutable_data(), upper.mutable_data());
+             if (quantile_p.ndim() == 0) {
+               return pybind11::make_tuple(lower.at(0), upper.at(0));
+             }
+             return pybind11::make_tuple(lower, upper);
+           },
+           R"pbdoc(
+             Lower and upper confidence bounds for the quantiles at levels
+             `quantile_p`, which may be a scalar or 1-D array. Bounds are
+             -inf or inf until enough values have been seen.
+           )pbdoc",
+           "quantile_p"_a)
+      .def("__len__", &confseq::QuantileConfidenceSequence::size);
+  pybind11::class_<confseq::SequentialQuantileABTest>(
+      m, "SequentialQuantileABTest",
+      R"pbdoc(
+        Two-sample test of equal quantiles over arms that grow as data
+        arrives. Refreshing the p-value after each batch reuses the sorted
+        arms and the previous search, rather than starting from scratch.
+        Tests can be pickled, saving both arms and the search state.
+
+        * `quantile_p`: designates which quantile we wish to test
+      )pbdoc")
+      .def(pybind11::init<double, int, double>(), "quantile_p"_a, "t_opt"_a,
+           "alpha_opt"_a=0.05)
+      .def("add",
+           [](confseq::SequentialQuantileABTest& test, const int arm,
+              const ContiguousArray values) {
+             if (arm != 1 && arm != 2) {
+               throw pybind11::value_error("arm must be 1 or 2");
+             }
+             test.add(arm, values.data(), values.data() + values.size());
+           },
+           R"pbdoc(
+             Add the values of a 1-D array to arm 1 or 2.
+           )pbdoc",
+           "arm"_a, "values"_a)
+      .def("p_value", &confseq::SequentialQuantileABTest::p_value,
+           R"pbdoc(
+             p-value given all observations so far.
+           )pbdoc")
+      .def("running_p_value",
+           &confseq::SequentialQuantileABTest::running_p_value,
+           R"pbdoc(
+             Minimum p-value over all refreshes so far, including now. This is
+             also always valid, and is usually cheaper than `p_value()`.
+           )pbdoc")
+      .def("arm_size",
+           [](const confseq::SequentialQuantileABTest& test, const int arm) {
+             if (arm != 1 && arm != 2) {
+               throw pybind11::value_error("arm must be 1 or 2");
+             }
+             return test.order_stats(arm).size();
+           },
+           "arm"_a)
+      .def(confseq::checkpoint_pickle<confseq::SequentialQuantileABTest>());
+  pybind11::class_<confseq::QuantileABTestConfig,
+                   std::shared_ptr<confseq::QuantileABTestConfig>>(
+      m, "QuantileABTestConfig",
+      R"pbdoc(
+        Reusable parameters of the two-sample test of equal quantiles, for
+        refreshing the p-values of one metric many times. The beta-binomial
+        mixture is built once, and the G minimizers are cached by arm size,
+        so each `p_value()` pays only for the scan over the arms. p-values
+        match `quantile_ab_p_value()` with the same parameters.
+
+        * `quantile_p`: designates which quantile we wish to test
+      )pbdoc")
+      .def(pybind11::init<double, int, double>(), "quantile_p"_a, "t_opt"_a,
+           "alpha_opt"_a=0.05)
+      .def_property_readonly("quantile_p",
+                             &confseq::QuantileABTestConfig::quantile_p)
+      .def_property_readonly("t_opt", &confseq::QuantileABTestConfig::t_opt)
+      .def_property_readonly("alpha_opt",
+                             &confseq::QuantileABTestConfig::alpha_opt)
+      .def("p_value",
+           [](const std::shared_ptr<confseq::QuantileABTestConfig>& config,
+              std::shared_ptr<confseq::OrderStatisticInterface> a_os,
+              std::shared_ptr<confseq::OrderStatisticInterface> b_os) {
+             pybind11::gil_scoped_release release;
+             const confseq::QuantileABTest test(config, a_os, b_os);
+             return test.p_value();
+           },
+           "a_values"_a, "b_values"_a)
+      .def("p_value", &config_quantile_ab_p_value,
+           R"pbdoc(
+             p-value of the test of `a_values` against `b_values`, arrays or
+             `OrderStatisticInterface` instances, with other arguments as for
+             `quantile_ab_p_value()`.
+           )pbdoc",
+           "a_values"_a, "b_values"_a, "assume_sorted"_a=false,
+           "check_sorted"_a=true, "a_weights"_a=pybind11::none(),
+           "b_weights"_a=pybind11::none(), "compress_ties"_a=false);
+  pybind11::class_<confseq::MultiArmQuantileTest>(
+      m, "MultiArmQuantileTest",
+      R"pbdoc(
+        Two-sample tests of equal quantiles between pairs of several arms,
+        such as each treatment against a control, or all pairs. Each arm is
+        sorted and its G function minimized once, however many pairs it is
+        in, and pairs are tested across threads with the GIL released.
+        p-values match `quantile_ab_p_value()` on the same two arms, and are
+        1 for pairs with an empty arm.
+
+        * `arms`: sequence of 1-D arrays, or of order statistics objects,
+          one per arm
+      )pbdoc")
+      .def(pybind11::init([](const pybind11::sequence arms,
+                             const double quantile_p, const int t_opt,
+                             const double alpha_opt) {
+             if (!(0 < quantile_p && quantile_p < 1)) {
+               throw pybind11::value_error("quantile_p must be in (0, 1)");
+             }
+             if (arms.size() == 0) {
+               throw pybind11::value_error("arms must not be empty");
+             }
+             bool all_arrays = true;
+             for (const pybind11::handle arm : arms) {
+               all_arrays = all_arrays
+                   && !pybind11::isinstance<confseq::OrderStatisticInterface>(
+                       arm);
+             }
+             if (all_arrays) {
+               const RaggedArms ragged = ragged_arms(arms, pybind11::none());
+               pybind11::gil_scoped_release release;
+               return std::unique_ptr<confseq::MultiArmQuantileTest>(
+                   new confseq::MultiArmQuantileTest(
+                       quantile_p, t_opt, alpha_opt, ragged.values(),
+                       ragged.offsets.data(), ragged.offsets.size() - 1));
+             }
+             std::vector<std::shared_ptr<confseq::OrderStatisticInterface>>
+                 order_stats;
+             for (const pybind11::handle arm : arms) {
+               order_stats.push_back(
+                   arm.cast<std::shared_ptr<
+                       confseq::OrderStatisticInterface>>());
+             }
+             return std::unique_ptr<confseq::MultiArmQuantileTest>(
+                 new confseq::MultiArmQuantileTest(quantile_p, t_opt,
+                                                   alpha_opt,
+                                                   std::move(order_stats)));
+           }),
+           "arms"_a, "quantile_p"_a, "t_opt"_a, "alpha_opt"_a=0.05)
+      .def("p_value",
+           [](const confseq::MultiArmQuantileTest& test, const size_t arm1,
+              const size_t arm2) {
+             if (arm1 >= test.num_arms() || arm2 >= test.num_arms()) {
+               throw pybind11::index_error("arm index out of range");
+             }
+             return test.p_value(arm1, arm2);
+           },
+           "p-value of the test between arms `arm1` and `arm2`.",
+           "arm1"_a, "arm2"_a)
+      .def("p_values",
+           [](const confseq::MultiArmQuantileTest& test,
+              const pybind11::array_t<
+                  size_t, pybind11::array::c_style
+                              | pybind11::array::forcecast> pairs) {
+             if (pairs.ndim() != 2 || pairs.shape(1) != 2) {
+               throw pybind11::value_error("pairs must have shape (n, 2)");
+             }
+             const size_t num_pairs = pairs.shape(0);
+             std::vector<size_t> arm1(num_pairs), arm2(num_pairs);
+             for (size_t k = 0; k < num_pairs; k++) {
+               arm1[k] = pairs.data()[2 * k];
+               arm2[k] = pairs.data()[2 * k + 1];
+               if (arm1[k] >= test.num_arms() || arm2[k] >= test.num_arms()) {
+                 throw pybind11::index_error("arm index out of range");
+               }
+             }
+             pybind11::array_t<double> p_values(num_pairs);
+             double* p_values_data = p_values.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               test.p_values(arm1.data(), arm2.data(), num_pairs,
+                             p_values_data);
+             }
+             return p_values;
+           },
+           R"pbdoc(
+             p-values for each row `(arm1, arm2)` of the integer array
+             `pairs`, of shape `(n, 2)`, tested across threads.
+           )pbdoc",
+           "pairs"_a)
+      .def("p_values_against",
+           [](const confseq::MultiArmQuantileTest& test,
+              const size_t control) {
+             if (control >= test.num_arms()) {
+               throw pybind11::index_error("arm index out of range");
+             }
+             pybind11::array_t<double> p_values(test.num_arms());
+             double* p_values_data = p_values.mutable_data();
+             {
+               pybind11::gil_scoped_release release;
+               test.p_values_against(control, p_values_data);
+             }
+             return p_values;
+           },
+           R"pbdoc(
+             p-values of every arm against arm `control`, with 1 for the
+             control itself.
+           )pbdoc",
+           "control"_a)
+      .def("__len__", &confseq::MultiArmQuantileTest::num_arms);
+  m.def("quantile_ab_p_value",
+        &order_statistics_quantile_ab_p_value,
+        "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a,
+        "alpha_opt"_a=0.05);
   m.def("quantile_ab_p_value",
         &quantile_ab_p_value,
         R"pbdoc(
           Get two-sided p-value for two-sample test of equal quantiles.
 
           * `a_values` and `b_values`: NumPy arrays containing observed values
-            from each of the two arms
+            from each of the two arms, or `OrderStatisticInterface` instances
+            such as `DynamicOrderStatistics`, `HistogramOrderStatistics`,
+            `SketchOrderStatistics` or `MappedOrderStatistics`
           * `quantile_p`: designates which quantile we wish to test
+          * `assume_sorted`: if true, value arrays are already in ascending
+            order and are read in place, without copying or sorting
+          * `check_sorted`: with `assume_sorted`, verify the order in a single
+            pass and raise `ValueError` if it does not hold
+          * `a_weights` and `b_weights`: optional integer arrays giving the
+            number of observations of each of `a_values` and `b_values`, for
+            arms given as (value, count) columns
+          * `compress_ties`: hold both arms as runs of tied values, which
+            makes heavily tied arms much cheaper to test. Implied by weights,
+            and exact either way
         )pbdoc",
         "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a,
-        "alpha_opt"_a=0.05);
+        "alpha_opt"_a=0.05, "assume_sorted"_a=false, "check_sorted"_a=true,
+        "a_weights"_a=pybind11::none(), "b_weights"_a=pybind11::none(),
+        "compress_ties"_a=false);
+  m.def("quantile_ab_p_values",
+        &quantile_ab_p_values,
+        R"pbdoc(
+          p-values of `quantile_ab_p_value()` for each level in the 1-D array
+          `quantile_p`, sorting each arm once and testing the levels across
+          threads.
+
+          Other arguments are as for `quantile_ab_p_value()`.
+        )pbdoc",
+        "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a,
+        "alpha_opt"_a=0.05, "assume_sorted"_a=false, "check_sorted"_a=true,
+        "a_weights"_a=pybind11::none(), "b_weights"_a=pybind11::none(),
+        "compress_ties"_a=false);
+  m.def("batch_quantile_ab_p_values",
+        &batch_quantile_ab_p_values,
+        R"pbdoc(
+          p-values of `quantile_ab_p_value()` for many independent pairs of
+          arms, such as metrics by variants, in one call with the GIL
+          released.
+
+          `a_values` and `b_values` are sequences of 1-D arrays, one per
+          pair, or, with `a_offsets` and `b_offsets`, flat arrays whose arm
+          i is `values[offsets[i]:offsets[i + 1]]`. `quantile_p` and `t_opt`
+          are scalars or arrays with one entry per pair. Each pair is sorted
+          and scanned on one thread, and threads take the largest remaining
+          pair as they finish, so arms of very different sizes balance.
+          Pairs with an empty arm get p-value 1.
+        )pbdoc",
+        "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a,
+        "alpha_opt"_a=0.05, "a_offsets"_a=pybind11::none(),
+        "b_offsets"_a=pybind11::none());
+  m.def("quantile_ab_rejects",
+        &quantile_ab_rejects,
+        R"pbdoc(
+          Whether the two-sample test of equal quantiles rejects at level
+          `alpha`, that is, whether `quantile_ab_p_value()` is at most
+          `alpha`. The search stops at the first point ruling out rejection,
+          so tests far from rejecting return quickly.
+
+          Arguments are as for `quantile_ab_p_value()`.
+        )pbdoc",
+        "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a, "alpha"_a,
+        "alpha_opt"_a=0.05, "assume_sorted"_a=false, "check_sorted"_a=true,
+        "a_weights"_a=pybind11::none(), "b_weights"_a=pybind11::none(),
+        "compress_ties"_a=false);
+  m.def("quantile_ab_shifted_p_value",
+        &quantile_ab_shifted_p_value,
+        R"pbdoc(
+          p-value of `quantile_ab_p_value()` for the hypothesis that the
+          `quantile_p` quantile of arm a exceeds that of arm b by `delta`,
+          that is, the test of `a_values` against `b_values + delta`, with
+          the shift applied inside the rank queries rather than by copying.
+
+          Other arguments are as for `quantile_ab_p_value()`.
+        )pbdoc",
+        "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a, "delta"_a,
+        "alpha_opt"_a=0.05, "assume_sorted"_a=false, "check_sorted"_a=true,
+        "a_weights"_a=pybind11::none(), "b_weights"_a=pybind11::none(),
+        "compress_ties"_a=false);
+  m.def("quantile_difference_cs",
+        &quantile_difference_cs,
+        R"pbdoc(
+          Confidence sequence `(lower, upper)` at level `alpha` for the
+          difference of the `quantile_p` quantiles of arm a minus arm b: the
+          shifts `delta` not rejected by `quantile_ab_shifted_p_value()`.
+          Each end is found by bisection to within `tolerance` times the
+          range of the pooled values and rounded outward. An end is infinite
+          if no shift beyond the data is rejected.
+
+          Other arguments are as for `quantile_ab_p_value()`.
+        )pbdoc",
+        "a_values"_a, "b_values"_a, "quantile_p"_a, "t_opt"_a, "alpha"_a,
+        "alpha_opt"_a=0.05, "tolerance"_a=1e-9, "assume_sorted"_a=false,
+        "check_sorted"_a=true, "a_weights"_a=pybind11::none(),
+        "b_weights"_a=pybind11::none(), "compress_ties"_a=false);
 }
@@ -2,21 +2,301 @@
 #define CONFIDENCESEQUENCES_UNIFORM_BOUNDARIES_H_
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <exception>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <ostream>
+#include <queue>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/cstdint.hpp>
+#include <boost/math/constants/constants.hpp>
 #include <boost/math/distributions/normal.hpp>
+#include <boost/math/policies/policy.hpp>
 #include <boost/math/special_functions/beta.hpp>
+#include <boost/math/special_functions/digamma.hpp>
 #include <boost/math/special_functions/gamma.hpp>
+#include <boost/math/special_functions/trigamma.hpp>
 #include <boost/math/special_functions/zeta.hpp>
 #include <boost/math/tools/minima.hpp>
 #include <boost/math/tools/roots.hpp>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CONFSEQ_HAVE_MMAP 1
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#define CONFSEQ_HAVE_SCHED_AFFINITY 1
+#endif
+
+// The normal mixture batch kernels use the GCC vector extensions, with
+// per-function instruction sets on x86-64.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) \
+    && !defined(__FAST_MATH__)
+#define CONFSEQ_HAVE_VECTOR_KERNELS 1
+#endif
+
+// The library is header-only by default. With CONFSEQ_SEPARATE_COMPILATION,
+// which the confseq_core CMake target defines for its users, this header
+// supplies only declarations, classes and templates: non-template functions
+// are compiled once into confseq_core from confseq_core.cpp, which also
+// instantiates the mixture bound solvers for each concrete mixture.
+#if !defined(CONFSEQ_SEPARATE_COMPILATION)
+#define CONFSEQ_INLINE inline
+#define CONFSEQ_DEFINE_IMPLEMENTATIONS
+#elif defined(CONFSEQ_CORE_IMPLEMENTATION)
+#define CONFSEQ_INLINE
+#define CONFSEQ_DEFINE_IMPLEMENTATIONS
+#else
+#define CONFSEQ_INLINE
+#endif
+
 namespace confseq {
 
+// Error policy for the Boost.Math special functions and root finders behind
+// boundaries and intervals. Domain, pole, overflow, rounding and evaluation
+// errors return NaN or infinity and set errno instead of throwing, so a
+// degenerate input yields NaN rather than unwinding through a batch loop.
+typedef boost::math::policies::policy<
+    boost::math::policies::domain_error<boost::math::policies::errno_on_error>,
+    boost::math::policies::pole_error<boost::math::policies::errno_on_error>,
+    boost::math::policies::overflow_error<
+        boost::math::policies::errno_on_error>,
+    boost::math::policies::rounding_error<
+        boost::math::policies::errno_on_error>,
+    boost::math::policies::evaluation_error<
+        boost::math::policies::errno_on_error>>
+    MathPolicy;
+
+// Accuracy of the special functions evaluated by the mixtures' log_superMG and
+// its derivatives. FULL is double precision. BALANCED and FAST ask Boost.Math
+// for 40 and 24 bits and skip its internal promotion to long double, which
+// shortens the incomplete gamma and beta series and selects cheaper Lanczos
+// approximations to lgamma. FAST also replaces most incomplete gamma
+// evaluations with the tables of IncompleteGammaApproximation.
+enum class SpecialFunctionPrecision : uint8_t {
+  FULL = 0,
+  BALANCED = 1,
+  FAST = 2,
+};
+
+template <int Digits>
+using ReducedMathPolicy = typename boost::math::policies::normalise<
+    MathPolicy, boost::math::policies::digits2<Digits>,
+    boost::math::policies::promote_double<false>>::type;
+
+// Returns fn(policy) with the Boost.Math policy for precision, so that a
+// generic lambda is instantiated once per precision and the choice costs one
+// branch per call.
+template <class Fn>
+auto with_math_policy(const SpecialFunctionPrecision precision, Fn fn)
+    -> decltype(fn(MathPolicy())) {
+  switch (precision) {
+    case SpecialFunctionPrecision::BALANCED:
+      return fn(ReducedMathPolicy<40>());
+    case SpecialFunctionPrecision::FAST:
+      return fn(ReducedMathPolicy<24>());
+    default:
+      return fn(MathPolicy());
+  }
+}
+
+// Precision of the root searches behind mixture bounds and confidence
+// intervals, in bits of relative accuracy. With conservative set, searches
+// return the end of their final bracket on the safe side, so that reduced
+// precision can widen boundaries and intervals but never narrow them.
+struct SolverPrecision {
+  int bits = 40;
+  bool conservative = false;
+  SpecialFunctionPrecision special_functions = SpecialFunctionPrecision::FULL;
+
+  static SolverPrecision exact() {
+    return SolverPrecision();
+  }
+
+  // About 1e-9 relative precision with 40-bit special functions, rounded
+  // conservatively.
+  static SolverPrecision balanced() {
+    SolverPrecision precision;
+    precision.bits = 30;
+    precision.conservative = true;
+    precision.special_functions = SpecialFunctionPrecision::BALANCED;
+    return precision;
+  }
+
+  // About 1e-6 relative precision with 24-bit special functions, rounded
+  // conservatively.
+  static SolverPrecision fast() {
+    SolverPrecision precision;
+    precision.bits = 20;
+    precision.conservative = true;
+    precision.special_functions = SpecialFunctionPrecision::FAST;
+    return precision;
+  }
+
+  double tolerance() const {
+    return ldexp(1.0, 1 - bits);
+  }
+
+  // Bound on the absolute error in log_superMG due to special_functions, for
+  // special-function arguments of magnitude scale (see
+  // MixtureSupermartingale::special_function_scale), as measured for the
+  // gamma and beta-binomial mixtures: about 2^-digits times (1 + sqrt(scale))
+  // from the shortened series and Lanczos sums, plus a term linear in scale
+  // from rounding the large cancelling lgamma terms without long double
+  // promotion. An error d in log_superMG moves the boundary by about
+  // d / (d log_superMG / ds), or equivalently scales its crossing probability
+  // by at most exp(d). Conservative searches raise the threshold by this
+  // amount, so that reduced precision still only widens bounds.
+  double log_superMG_error(const double scale) const {
+    double scale_error = 0;
+    switch (special_functions) {
+      case SpecialFunctionPrecision::BALANCED:
+        scale_error = ldexp(1.0, -33);
+        break;
+      case SpecialFunctionPrecision::FAST:
+        scale_error = ldexp(1.0, -24);
+        break;
+      default:
+        return 0;
+    }
+    return scale_error * (1 + sqrt(scale)) + ldexp(scale, -43);
+  }
+
+  // Identifies the precision within BoundaryCache keys.
+  double cache_key() const {
+    const double key = bits + 64 * int(special_functions);
+    return conservative ? -key : key;
+  }
+};
+
+// Work done by the root searches on the calling thread, for tuning v_opt,
+// alpha_opt and precision. Counting is compiled in only when CONFSEQ_INSTRUMENT
+// is defined; otherwise the counters stay zero. Work run by parallel_for is
+// counted on the worker threads, so measure with one thread.
+struct SolverCounters {
+  // find_mixture_bound calls and Bernoulli confidence interval endpoints.
+  uint64_t solves = 0;
+  // Evaluations of log_superMG or of the Bernoulli interval objective.
+  uint64_t objective_evaluations = 0;
+  // Doubling steps of find_s_upper_bound and bracket growth steps of the
+  // warm-started Bernoulli interval search.
+  uint64_t bracket_expansions = 0;
+  uint64_t halley_steps = 0;
+  uint64_t bisection_steps = 0;
+  // Incomplete gamma and beta evaluations.
+  uint64_t special_function_calls = 0;
+  // Most objective evaluations made by any one solve.
+  uint64_t max_evaluations_per_solve = 0;
+};
+
+constexpr bool instrumentation_enabled() {
+#ifdef CONFSEQ_INSTRUMENT
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Counters of the calling thread.
+SolverCounters& solver_counters();
+void reset_solver_counters();
+
+#ifdef CONFSEQ_INSTRUMENT
+#define CONFSEQ_COUNT(counter) (++::confseq::solver_counters().counter)
+#define CONFSEQ_COUNT_SOLVE() \
+  const ::confseq::SolveCounter confseq_solve_counter_
+#else
+#define CONFSEQ_COUNT(counter) ((void) 0)
+#define CONFSEQ_COUNT_SOLVE() ((void) 0)
+#endif
+
+// Limits on the root-search work of a latency-critical request: a number of
+// objective evaluations and a steady-clock deadline. Zero means no limit.
+struct SolveBudget {
+  uint64_t max_evaluations = 0;
+  std::chrono::steady_clock::time_point deadline{};
+};
+
+// While in scope, bounds the root searches of find_mixture_bound, and so of
+// every mixture's bound(), of bernoulli_confidence_interval and of the
+// EmpiricalProcessLILBound constructor on the calling thread. A search that
+// runs out of budget stops and returns the end of its current bracket on the
+// conservative side: a valid but looser boundary, or an infinite one (the
+// whole of [0, 1] for an interval endpoint) if it had no bracket yet.
+// Results of searches cut short are not stored in boundary caches. Work that
+// parallel_for runs on other threads is not bounded. Scopes nest, the inner
+// one applying until it ends.
+class SolveBudgetScope {
+ public:
+  explicit SolveBudgetScope(const SolveBudget& budget);
+  ~SolveBudgetScope();
+  SolveBudgetScope(const SolveBudgetScope&) = delete;
+  SolveBudgetScope& operator=(const SolveBudgetScope&) = delete;
+
+  // Whether any search in the scope returned a truncated result.
+  bool truncated() const {
+    return truncations_ > 0;
+  }
+  // Searches cut short, and objective evaluations charged, in the scope.
+  uint64_t truncations() const {
+    return truncations_;
+  }
+  uint64_t evaluations() const {
+    return evaluations_;
+  }
+
+ private:
+  friend bool solve_budget_exhausted();
+  friend uint64_t solve_budget_truncations();
+
+  SolveBudget budget_;
+  SolveBudgetScope* outer_;
+  uint64_t evaluations_ = 0;
+  uint64_t truncations_ = 0;
+};
+
+// Charges one objective evaluation to the calling thread's SolveBudgetScope
+// and returns whether its budget is spent, in which case the caller must stop
+// and the truncation is counted. Always false outside a scope.
+bool solve_budget_exhausted();
+// Truncations so far in the calling thread's scope, or 0 outside one.
+uint64_t solve_budget_truncations();
+// Thrown by root-search objectives when the budget is spent, and caught by
+// the search, which then returns its conservative bracket end.
+struct SolveBudgetExhausted {};
+
 //////////////////////////////////////////////////////////////////////
 // Simplified interface
 //////////////////////////////////////////////////////////////////////
@@ -35,7 +315,8 @@ double gamma_exponential_log_mixture(
 
 double gamma_exponential_mixture_bound(
     const double v, const double alpha, const double v_opt,
-    const double c, const double alpha_opt=0.05);
+    const double c, const double alpha_opt=0.05,
+    const SolverPrecision& precision=SolverPrecision());
 
 double gamma_poisson_log_mixture(
     const double s, const double v, const double v_opt, const double c,
@@ -43,7 +324,8 @@ double gamma_poisson_log_mixture(
 
 double gamma_poisson_mixture_bound(
     const double v, const double alpha, const double v_opt, const double c,
-    const double alpha_opt=0.05);
+    const double alpha_opt=0.05,
+    const SolverPrecision& precision=SolverPrecision());
 
 double beta_binomial_log_mixture(
     const double s, const double v, const double v_opt, const double g,
@@ -53,7 +335,8 @@ double beta_binomial_log_mixture(
 double beta_binomial_mixture_bound(
     const double v, const double alpha, const double v_opt, const double g,
     const double h, const double alpha_opt=0.05,
-    const bool is_one_sided=true);
+    const bool is_one_sided=true,
+    const SolverPrecision& precision=SolverPrecision());
 
 double poly_stitching_bound(const double v, const double alpha,
                             const double v_min, const double c=0,
@@ -69,14 +352,172 @@ double double_stitching_bound(const double quantile_p, const double t,
 
 std::pair<double, double> bernoulli_confidence_interval(
     const double num_successes, const int num_trials, const double alpha,
-    const double t_opt, const double alpha_opt=0.05);
+    const double t_opt, const double alpha_opt=0.05,
+    const SolverPrecision& precision=SolverPrecision());
+
+//////////////////////////////////////////////////////////////////////
+// Precomputed constants
+//////////////////////////////////////////////////////////////////////
+
+// Constants that constructors compute from their hyperparameters alone, by
+// special functions or nested root searches, with the parameters they are
+// keyed by.
+enum class BundledConstant : uint32_t {
+  // EmpiricalProcessLILBound's C, by (alpha, A, precision.cache_key()).
+  EMPIRICAL_PROCESS_LIL_C = 1,
+  // The gamma mixtures' leading constants, by (rho, c).
+  GAMMA_EXPONENTIAL_LEADING_CONSTANT = 2,
+  GAMMA_POISSON_LEADING_CONSTANT = 3,
+  // The beta-binomial mixtures' log normalizer, by (r, g, h, is_one_sided).
+  BETA_BINOMIAL_LOG_NORMALIZER = 4,
+};
+
+// Hyperparameter grids for which ConstantsBundle::build() precomputes
+// constants. Each list is crossed with the others of its family; the
+// defaults cover the settings in common use.
+struct ConstantsBundleGrid {
+  // EmpiricalProcessLILBound(alpha, t_min, A) at the default precision.
+  std::vector<double> lil_alpha = {0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.2};
+  std::vector<double> lil_A = {0.85, 1, 1.1, 1.5, 2};
+  // The gamma mixtures (v_opt, alpha_opt, c), and the beta-binomial mixtures
+  // (v_opt, alpha_opt, p, 1 - p) of either sidedness, also at v_opt =
+  // t_opt * p * (1 - p) for each t_opt as the quantile tests construct them.
+  std::vector<double> v_opt = {10, 20, 50, 100, 200, 500, 1e3, 2e3, 5e3, 1e4,
+                               1e5, 1e6};
+  std::vector<double> alpha_opt = {0.01, 0.025, 0.05, 0.1, 0.2};
+  std::vector<double> gamma_c = {0.1, 0.2, 0.5, 1, 2, 5, 10};
+  std::vector<double> beta_binomial_p = {0.01, 0.05, 0.1, 0.2, 0.25, 0.3, 0.4,
+                                         0.5, 0.6, 0.7, 0.75, 0.8, 0.9, 0.95,
+                                         0.99};
+  std::vector<double> t_opt = {10, 20, 50, 100, 200, 500, 1e3, 1e4, 1e5};
+};
+
+// A sorted table of precomputed constants, so that services constructing
+// hundreds of boundaries at startup read them rather than compute them.
+// Constants are looked up by exact parameters, and constructors compute any
+// that are missing, so a bundle only ever saves work. build() computes the
+// constants for a grid with the same code the constructors run, so bundled
+// and computed values are identical. The file format is a header of magic,
+// version, padding and entry count, then the entries as written in memory,
+// 8-byte aligned, so map_file() can memory-map a bundle that processes on a
+// host then share.
+class ConstantsBundle {
+ public:
+  struct Entry {
+    uint32_t kind;
+    uint32_t reserved;
+    double parameters[4];
+    double value;
+  };
+
+  // Sorts the entries, keeping the first of any with the same key.
+  explicit ConstantsBundle(std::vector<Entry> entries);
+
+  // Computes every constant of grid across threads.
+  static ConstantsBundle build(const ConstantsBundleGrid& grid,
+                               const int num_threads=0);
+
+  // Looks up the constant kind at parameters, unused ones zero.
+  bool find(const BundledConstant kind,
+            const std::array<double, 4>& parameters, double& value) const;
+  size_t size() const { return size_; }
+
+  void save(std::ostream& out) const;
+  static ConstantsBundle load(std::istream& in);
+  // Maps a file written by save() read-only. Throws std::runtime_error if
+  // the file cannot be read or is invalid.
+  static ConstantsBundle map_file(const std::string& path);
+
+ private:
+  ConstantsBundle(std::shared_ptr<const Entry> storage, const size_t size);
+
+  std::shared_ptr<const Entry> storage_;
+  size_t size_;
+};
+
+// The bundle constructors consult, or empty. On first use it is mapped from
+// the file named by the CONFSEQ_CONSTANTS_BUNDLE environment variable if that
+// is set, and left empty if the file cannot be mapped. Access with
+// std::atomic_load.
+std::shared_ptr<const ConstantsBundle>& constants_bundle_instance();
+// Replaces the bundle in use; an empty pointer removes it.
+void set_constants_bundle(std::shared_ptr<const ConstantsBundle> bundle);
+// ConstantsBundle::find() on the bundle in use, false without one.
+bool find_bundled_constant(const BundledConstant kind,
+                           const std::array<double, 4>& parameters,
+                           double& value);
 
 //////////////////////////////////////////////////////////////////////
 // Object-oriented interface
 //////////////////////////////////////////////////////////////////////
 
-double log_beta(const double a, const double b);
-double log_incomplete_beta(const double a, const double b, const double x);
+double log_beta(const double a, const double b,
+                const SpecialFunctionPrecision precision=
+                    SpecialFunctionPrecision::FULL);
+double log_incomplete_beta(const double a, const double b, const double x,
+                           const SpecialFunctionPrecision precision=
+                               SpecialFunctionPrecision::FULL);
+double log_normal_cdf(const double z);
+// log_normal_cdf(z[i]) into out[i] for i < n, vector_width() values at a time.
+void log_normal_cdf(const double* z, const size_t n, double* out);
+// The number of doubles per vector in the batch log_normal_cdf and normal
+// mixture log_superMG kernels, chosen once from the running CPU: 8 with
+// AVX-512F, 4 with AVX2 and FMA, and otherwise 1, a loop over the scalar
+// functions.
+int vector_width();
+
+double pair_average(std::pair<double, double> values);
+// The least float not below value, so that boundaries stored as floats stay
+// conservative.
+float round_up_to_float(const double value);
+
+// Piecewise Chebyshev approximation of log P(a, a + w sqrt(a)) (LOWER) or
+// log Q(b + w sqrt(b), b) (UPPER) for the regularized incomplete gamma
+// functions P and Q, as a function of t = 1 / sqrt(a) or 1 / sqrt(b) and w.
+// In these standardized coordinates both are smooth and bounded, tending to
+// log Phi(w) as t -> 0, so one table serves every mixture parameter. Each
+// piece is a tensor Chebyshev series fitted to FULL precision Boost.Math
+// values on first use. The table covers a, b >= 4 and -6 <= w <= 10, except
+// near the singularity at x = 0 or y = 0; elsewhere it returns NaN.
+class IncompleteGammaApproximation {
+ public:
+  enum class Kind : uint8_t {
+    LOWER = 0,
+    UPPER = 1,
+  };
+
+  explicit IncompleteGammaApproximation(const Kind kind);
+
+  double operator()(const double t, const double w) const;
+
+  // Largest absolute error against Boost.Math allowed by the unit tests.
+  static double max_error() { return 1e-9; }
+
+  static const IncompleteGammaApproximation& lower();
+  static const IncompleteGammaApproximation& upper();
+
+ private:
+  static constexpr int NUM_T_PIECES = 8;
+  static constexpr int NUM_W_PIECES = 16;
+  static constexpr int NUM_TERMS = 10;
+
+  static double t_max() { return 0.5; }
+  static double w_min() { return -6; }
+  static double w_max() { return 10; }
+
+  // NUM_TERMS^2 coefficients per piece, or NaN for pieces outside the table.
+  std::vector<double> coefficients_;
+};
+
+// log P(a, x) and log Q(y, b). FAST precision evaluates the
+// IncompleteGammaApproximation where it applies, which is far more accurate
+// than FAST requires and avoids the incomplete gamma series altogether.
+double log_gamma_p(const double a, const double x,
+                   const SpecialFunctionPrecision precision=
+                       SpecialFunctionPrecision::FULL);
+double log_gamma_q(const double y, const double b,
+                   const SpecialFunctionPrecision precision=
+                       SpecialFunctionPrecision::FULL);
 
 // (v, alpha) -> boundary value
 using UniformBoundary = std::function<double(const double, const double)>;
@@ -85,14 +526,107 @@ class MixtureSupermartingale {
 public:
   virtual ~MixtureSupermartingale() {}
   virtual double log_superMG(const double s, const double v) const = 0;
+  // Evaluates log_superMG(s[i], v[i]) into out[i] for i < n, with one virtual
+  // call per batch. The normal mixtures override it with vector kernels.
+  virtual void log_superMG(const double* s, const double* v, const size_t n,
+                           double* out) const;
   virtual double s_upper_bound(const double v) const = 0;
   virtual double bound(const double v, const double log_threshold) const = 0;
+
+  // A cheaply computed s at which log_superMG(s, v) is expected to exceed
+  // log_threshold, used to bracket the bound without a doubling search.
+  // find_s_upper_bound checks the value before use. Returns infinity when no
+  // such estimate is available.
+  virtual double s_upper_bracket(const double /*v*/,
+                                 const double /*log_threshold*/) const {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  // First and second derivatives of log_superMG with respect to s. Mixtures
+  // without closed-form derivatives leave these returning NaN, in which case
+  // find_mixture_bound falls back to bisection.
+  virtual double d_log_superMG_ds(const double /*s*/, const double /*v*/)
+      const {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  virtual double d2_log_superMG_ds2(const double /*s*/, const double /*v*/)
+      const {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  // Magnitude of the special-function arguments in log_superMG near the
+  // bound at v, which scales the error of reduced-precision evaluation; see
+  // SolverPrecision::log_superMG_error. Zero for mixtures computed without
+  // special functions.
+  virtual double special_function_scale(const double /*v*/) const {
+    return 0;
+  }
+
+  // Evaluates bound(v[i], log_threshold) into out[i] for i < n, warm-starting
+  // each root search from the previous one. Fastest when v is sorted.
+  virtual void bound_sequence(const double* v, const size_t n,
+                              const double log_threshold, double* out) const;
+
+  // Evaluates bound(v[i], log_thresholds[j]) into out[i * num_thresholds + j]
+  // for i < num_v and j < num_thresholds, solving the thresholds at each v
+  // together with nested brackets, as find_mixture_bounds does.
+  virtual void bound_multi(const double* v, const size_t num_v,
+                           const double* log_thresholds,
+                           const size_t num_thresholds, double* out) const;
+
+  // Writes an identifier for the mixture type followed by its tuning
+  // parameters into the first entries of parameters, which BoundaryCache uses
+  // as a key. Mixtures returning false are never cached.
+  virtual bool cache_parameters(std::array<double, 5>& /*parameters*/) const {
+    return false;
+  }
+
+  // Precision used by find_mixture_bound for this mixture.
+  void set_precision(const SolverPrecision& precision) {
+    precision_ = precision;
+  }
+  const SolverPrecision& precision() const {
+    return precision_;
+  }
+
+ private:
+  SolverPrecision precision_;
 };
 
-double find_mixture_bound(const MixtureSupermartingale& mixture_superMG,
-                          const double v, const double log_threshold);
+// The root-finding routines are templated on the mixture type. Concrete
+// mixtures are final, so when called with one the compiler can inline
+// log_superMG and its derivatives into the solver loop. Called with a
+// MixtureSupermartingale they dispatch virtually. Under MathPolicy, a bound
+// that cannot be computed, for instance at a NaN or negative v, is NaN rather
+// than an exception.
+template <class Mixture>
+double find_mixture_bound(const Mixture& mixture_superMG, const double v,
+                          const double log_threshold);
+template <class Mixture>
+double find_mixture_bound(const Mixture& mixture_superMG, const double v,
+                          const double log_threshold,
+                          const double s_lower_hint,
+                          const double s_upper_hint);
+// bound(v, log_threshold), warm-started from bound_previous = bound(
+// v_previous, log_threshold). Each step of find_mixture_bound_sequence.
+template <class Mixture>
+double find_next_mixture_bound(const Mixture& mixture_superMG,
+                               const double v_previous,
+                               const double bound_previous, const double v,
+                               const double log_threshold);
+template <class Mixture>
+void find_mixture_bound_sequence(const Mixture& mixture_superMG,
+                                 const double* v, const size_t n,
+                                 const double log_threshold, double* out);
+// out[j] = bound(v, log_thresholds[j]) for j < num_thresholds. Only the
+// largest threshold is searched from scratch; each smaller one is then
+// bracketed by the roots of its neighbors.
+template <class Mixture>
+void find_mixture_bounds(const Mixture& mixture_superMG, const double v,
+                         const double* log_thresholds,
+                         const size_t num_thresholds, double* out);
 
-class TwoSidedNormalMixture : public MixtureSupermartingale {
+class TwoSidedNormalMixture final : public MixtureSupermartingale {
  public:
   TwoSidedNormalMixture(double v_opt, double alpha_opt)
     : rho_(best_rho(v_opt, alpha_opt)) {
@@ -100,17 +634,50 @@ class TwoSidedNormalMixture : public MixtureSupermartingale {
   }
 
   double log_superMG(const double s, const double v) const override;
+  void log_superMG(const double* s, const double* v, const size_t n,
+                   double* out) const override;
   double s_upper_bound(const double /*v*/) const override {
     return std::numeric_limits<double>::infinity();
   }
   double bound(const double v, const double log_threshold) const override;
+  double s_upper_bracket(const double v, const double log_threshold)
+      const override {
+    return bound(v, log_threshold) * (1 + 1e-10);
+  }
+  double d_log_superMG_ds(const double s, const double v) const override;
+  double d2_log_superMG_ds2(const double s, const double v) const override;
+  void bound_sequence(const double* v, const size_t n,
+                      const double log_threshold, double* out) const override {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = bound(v[i], log_threshold);
+    }
+  }
+  // As bound_sequence, into floats for large grids where about seven
+  // significant digits suffice. Each bound is computed in double and rounded
+  // up to the next float, so it never falls below the double bound.
+  void bound_sequence(const float* v, const size_t n,
+                      const double log_threshold, float* out) const;
+  void bound_multi(const double* v, const size_t num_v,
+                   const double* log_thresholds, const size_t num_thresholds,
+                   double* out) const override {
+    for (size_t i = 0; i < num_v; i++) {
+      for (size_t j = 0; j < num_thresholds; j++) {
+        out[i * num_thresholds + j] = bound(v[i], log_thresholds[j]);
+      }
+    }
+  }
+  bool cache_parameters(std::array<double, 5>& parameters) const override {
+    parameters = {1, rho_, 0, 0, 0};
+    return true;
+  }
+  double rho() const { return rho_; }
   static double best_rho(double v, double alpha);
 
  private:
   const double rho_;
 };
 
-class OneSidedNormalMixture : public MixtureSupermartingale {
+class OneSidedNormalMixture final : public MixtureSupermartingale {
  public:
   OneSidedNormalMixture(double v_opt, double alpha_opt)
     : rho_(best_rho(v_opt, alpha_opt)) {
@@ -118,92 +685,386 @@ class OneSidedNormalMixture : public MixtureSupermartingale {
   }
 
   double log_superMG(const double s, const double v) const override;
+  void log_superMG(const double* s, const double* v, const size_t n,
+                   double* out) const override;
   double s_upper_bound(const double /*v*/) const override {
     return std::numeric_limits<double>::infinity();
   }
   double bound(const double v, const double log_threshold) const override {
     return find_mixture_bound(*this, v, log_threshold);
   }
+  double s_upper_bracket(const double v, const double log_threshold)
+      const override;
+  double d_log_superMG_ds(const double s, const double v) const override;
+  double d2_log_superMG_ds2(const double s, const double v) const override;
+  void bound_sequence(const double* v, const size_t n,
+                      const double log_threshold, double* out) const override {
+    find_mixture_bound_sequence(*this, v, n, log_threshold, out);
+  }
+  void bound_multi(const double* v, const size_t num_v,
+                   const double* log_thresholds, const size_t num_thresholds,
+                   double* out) const override {
+    for (size_t i = 0; i < num_v; i++) {
+      find_mixture_bounds(*this, v[i], log_thresholds, num_thresholds,
+                          out + i * num_thresholds);
+    }
+  }
+  bool cache_parameters(std::array<double, 5>& parameters) const override {
+    parameters = {2, rho_, 0, 0, 0};
+    return true;
+  }
+  double rho() const { return rho_; }
   static double best_rho(double v, double alpha);
 
  private:
   const double rho_;
 };
 
-class GammaExponentialMixture : public MixtureSupermartingale {
+// The batch kernels at a given width, one of 1, 4 or 8 and at most
+// vector_width(). Wider kernels agree with the scalar functions to within a
+// few units in the last place of each term, and fall back to them for
+// elements outside the range they handle, such as non-finite ones.
+namespace vector_kernels {
+void log_normal_cdf(const int width, const double* z, const size_t n,
+                    double* out);
+void normal_log_superMG(const int width, const TwoSidedNormalMixture& mixture,
+                        const double* s, const double* v, const size_t n,
+                        double* out);
+void normal_log_superMG(const int width, const OneSidedNormalMixture& mixture,
+                        const double* s, const double* v, const size_t n,
+                        double* out);
+};
+
+class GammaExponentialMixture final : public MixtureSupermartingale {
  public:
   GammaExponentialMixture(double v_opt, double alpha_opt, double c)
       : rho_(OneSidedNormalMixture::best_rho(v_opt, alpha_opt)),
         c_(c), leading_constant_(get_leading_constant(rho_, c_)) {}
 
   double log_superMG(const double s, const double v) const override;
+  using MixtureSupermartingale::log_superMG;
+  // out[i] = log_superMG(s[i], v_start + i * v_step) for i < n, for
+  // intrinsic times advancing by a constant step, such as one per
+  // observation. When v_step / c^2 is a positive integer k of at most 8,
+  // lgamma((v + rho) / c^2) is carried along by lgamma(a + k) = lgamma(a) +
+  // log(a (a + 1) ... (a + k - 1)), re-evaluated directly every 256 values to
+  // bound the accumulated rounding, so each value costs a logarithm in place
+  // of an lgamma. Other steps evaluate every term directly.
+  void log_superMG_spaced(const double* s, const double v_start,
+                          const double v_step, const size_t n,
+                          double* out) const;
   double s_upper_bound(const double /*v*/) const override {
     return std::numeric_limits<double>::infinity();
   }
   double bound(const double v, const double log_threshold) const override {
     return find_mixture_bound(*this, v, log_threshold);
   }
+  double s_upper_bracket(const double v, const double log_threshold)
+      const override;
+  double special_function_scale(const double v) const override {
+    return (v + rho_) / (c_ * c_);
+  }
+  double d_log_superMG_ds(const double s, const double v) const override;
+  double d2_log_superMG_ds2(const double s, const double v) const override;
+  void bound_sequence(const double* v, const size_t n,
+                      const double log_threshold, double* out) const override {
+    find_mixture_bound_sequence(*this, v, n, log_threshold, out);
+  }
+  void bound_multi(const double* v, const size_t num_v,
+                   const double* log_thresholds, const size_t num_thresholds,
+                   double* out) const override {
+    for (size_t i = 0; i < num_v; i++) {
+      find_mixture_bounds(*this, v[i], log_thresholds, num_thresholds,
+                          out + i * num_thresholds);
+    }
+  }
+  bool cache_parameters(std::array<double, 5>& parameters) const override {
+    parameters = {3, rho_, c_, 0, 0};
+    return true;
+  }
 
  private:
+  friend class GammaExponentialMixtureBatch;
+
+  GammaExponentialMixture(const double rho, const double c,
+                          const double leading_constant,
+                          const SolverPrecision& precision)
+      : rho_(rho), c_(c), leading_constant_(leading_constant) {
+    set_precision(precision);
+  }
+
+  friend class ConstantsBundle;
+
+  // The bundled constant if there is one, else compute_leading_constant().
   static double get_leading_constant(double rho, double c);
+  static double compute_leading_constant(double rho, double c);
 
   const double rho_;
   const double c_;
   const double leading_constant_;
 };
 
-class GammaPoissonMixture : public MixtureSupermartingale {
+// Many gamma-exponential mixtures, such as one per metric each with its own
+// v_opt, alpha_opt and c, held as contiguous columns of their rho, c and
+// leading constants rather than as separate objects behind virtual calls. The
+// kernels take one (s, v) or v per mixture and run over blocks of mixtures
+// across threads, with the special function policy chosen once per block.
+class GammaExponentialMixtureBatch {
+ public:
+  // Mixture i is GammaExponentialMixture(v_opt[i], alpha_opt[i], c[i]) for
+  // i < size. The columns are filled across threads.
+  GammaExponentialMixtureBatch(const double* v_opt, const double* alpha_opt,
+                               const double* c, const size_t size,
+                               const int num_threads=0);
+
+  // out[i] = mixture(i).log_superMG(s[i], v[i]) for i < size().
+  void log_superMG(const double* s, const double* v, double* out,
+                   const int num_threads=0) const;
+  // out[i] = mixture(i).bound(v[i], log_threshold) for i < size().
+  void bound(const double* v, const double log_threshold, double* out,
+             const int num_threads=0) const;
+
+  GammaExponentialMixture mixture(const size_t i) const {
+    return GammaExponentialMixture(rho_[i], c_[i], leading_constant_[i],
+                                   precision_);
+  }
+  size_t size() const { return rho_.size(); }
+
+  // Precision of every mixture's special functions and bound searches.
+  void set_precision(const SolverPrecision& precision) {
+    precision_ = precision;
+  }
+  const SolverPrecision& precision() const { return precision_; }
+
+ private:
+  std::vector<double> rho_;
+  std::vector<double> c_;
+  std::vector<double> leading_constant_;
+  SolverPrecision precision_;
+};
+
+class GammaPoissonMixture final : public MixtureSupermartingale {
  public:
   GammaPoissonMixture(double v_opt, double alpha_opt, double c)
       : rho_(OneSidedNormalMixture::best_rho(v_opt, alpha_opt)),
         c_(c), leading_constant_(get_leading_constant(rho_, c_)) {}
 
   double log_superMG(const double s, const double v) const override;
+  using MixtureSupermartingale::log_superMG;
   double s_upper_bound(const double /*v*/) const override {
     return std::numeric_limits<double>::infinity();
   }
   double bound(const double v, const double log_threshold) const override {
     return find_mixture_bound(*this, v, log_threshold);
   }
+  double s_upper_bracket(const double v, const double log_threshold)
+      const override;
+  double special_function_scale(const double v) const override {
+    return (v + rho_) / (c_ * c_);
+  }
+  void bound_sequence(const double* v, const size_t n,
+                      const double log_threshold, double* out) const override {
+    find_mixture_bound_sequence(*this, v, n, log_threshold, out);
+  }
+  void bound_multi(const double* v, const size_t num_v,
+                   const double* log_thresholds, const size_t num_thresholds,
+                   double* out) const override {
+    for (size_t i = 0; i < num_v; i++) {
+      find_mixture_bounds(*this, v[i], log_thresholds, num_thresholds,
+                          out + i * num_thresholds);
+    }
+  }
+  bool cache_parameters(std::array<double, 5>& parameters) const override {
+    parameters = {4, rho_, c_, 0, 0};
+    return true;
+  }
 
  private:
+  friend class ConstantsBundle;
+
+  // The bundled constant if there is one, else compute_leading_constant().
   static double get_leading_constant(double rho, double c);
+  static double compute_leading_constant(double rho, double c);
 
   const double rho_;
   const double c_;
   const double leading_constant_;
 };
 
-class BetaBinomialMixture : public MixtureSupermartingale {
+// BetaBinomialMixture with its sidedness fixed at compile time. The one-sided
+// mixture integrates the incomplete beta function up to x = h / (g + h); the
+// two-sided mixture integrates over the whole mixing distribution, x = 1, so
+// its log_superMG needs only log_beta and its derivatives are closed-form. The
+// templated solvers therefore inline either case without a runtime branch.
+template <bool IsOneSided>
+class SidedBetaBinomialMixture final : public MixtureSupermartingale {
+ public:
+  SidedBetaBinomialMixture(double v_opt, double alpha_opt, double g, double h)
+      : SidedBetaBinomialMixture(optimal_r(v_opt, alpha_opt, g, h), g, h) {}
+
+  double log_superMG(const double s, const double v) const override;
+  using MixtureSupermartingale::log_superMG;
+  double s_upper_bound(const double v) const override {
+    return v / g_;
+  }
+  double bound(const double v, const double log_threshold) const override {
+    return find_mixture_bound(*this, v, log_threshold);
+  }
+  double special_function_scale(const double v) const override {
+    return (r_ + v) / (std::min(g_, h_) * (g_ + h_));
+  }
+  double d_log_superMG_ds(const double s, const double v) const override;
+  double d2_log_superMG_ds2(const double s, const double v) const override;
+  void bound_sequence(const double* v, const size_t n,
+                      const double log_threshold, double* out) const override {
+    find_mixture_bound_sequence(*this, v, n, log_threshold, out);
+  }
+  void bound_multi(const double* v, const size_t num_v,
+                   const double* log_thresholds, const size_t num_thresholds,
+                   double* out) const override {
+    for (size_t i = 0; i < num_v; i++) {
+      find_mixture_bounds(*this, v[i], log_thresholds, num_thresholds,
+                          out + i * num_thresholds);
+    }
+  }
+  // Shares cache entries with the equivalent BetaBinomialMixture.
+  bool cache_parameters(std::array<double, 5>& parameters) const override {
+    parameters = {5, r_, g_, h_, IsOneSided ? 1.0 : 0.0};
+    return true;
+  }
+
+  double g() const { return g_; }
+  double h() const { return h_; }
+
+  static double optimal_r(const double v_opt, const double alpha_opt,
+                          const double g, const double h) {
+    double rho = IsOneSided
+        ? OneSidedNormalMixture::best_rho(v_opt, alpha_opt)
+        : TwoSidedNormalMixture::best_rho(v_opt, alpha_opt);
+    return std::max(rho - g * h, 1e-3 * g * h);
+  }
+  // Logarithm of the mixing distribution's normalizing constant, from the
+  // installed ConstantsBundle if it has it.
+  static double log_normalizer(const double r, const double g,
+                               const double h) {
+    double normalizer;
+    return find_bundled_constant(
+               BundledConstant::BETA_BINOMIAL_LOG_NORMALIZER,
+               {r, g, h, IsOneSided ? 1.0 : 0.0}, normalizer)
+        ? normalizer : compute_log_normalizer(r, g, h);
+  }
+  static double compute_log_normalizer(const double r, const double g,
+                                       const double h) {
+    return IsOneSided
+        ? log_incomplete_beta(r / (g * (g + h)), r / (h * (g + h)),
+                              h / (g + h))
+        : log_beta(r / (g * (g + h)), r / (h * (g + h)));
+  }
+
+ private:
+  friend class BetaBinomialMixture;
+
+  SidedBetaBinomialMixture(const double r, const double g, const double h)
+      : SidedBetaBinomialMixture(r, g, h, log_normalizer(r, g, h),
+                                 SolverPrecision()) {}
+  SidedBetaBinomialMixture(const double r, const double g, const double h,
+                           const double normalizer,
+                           const SolverPrecision& precision)
+      : r_(r), g_(g), h_(h), normalizer_(normalizer) {
+    assert(g > 0);
+    assert(h > 0);
+    assert(r > 0);
+    set_precision(precision);
+  }
+
+  const double r_;
+  const double g_;
+  const double h_;
+  const double normalizer_;
+};
+
+using OneSidedBetaBinomialMixture = SidedBetaBinomialMixture<true>;
+using TwoSidedBetaBinomialMixture = SidedBetaBinomialMixture<false>;
+
+// Beta-binomial mixture whose sidedness is chosen at run time. Each call
+// dispatches once to the SidedBetaBinomialMixture of that sidedness, so root
+// searches run entirely in the specialized solver.
+class BetaBinomialMixture final : public MixtureSupermartingale {
  public:
 
   BetaBinomialMixture(double v_opt, double alpha_opt, double g, double h,
                       bool is_one_sided)
-      : r_(optimal_r(v_opt, alpha_opt, g, h, is_one_sided)), g_(g), h_(h),
-        is_one_sided_(is_one_sided),
-        normalizer_(log_incomplete_beta(r_ / (g_ * (g_ + h_)),
-                                        r_ / (h_ * (g_ + h_)),
-                                        is_one_sided_ ? h_ / (g_ + h_) : 1)) {
+      : r_(is_one_sided
+               ? OneSidedBetaBinomialMixture::optimal_r(v_opt, alpha_opt, g, h)
+               : TwoSidedBetaBinomialMixture::optimal_r(v_opt, alpha_opt, g,
+                                                        h)),
+        g_(g), h_(h), is_one_sided_(is_one_sided),
+        normalizer_(is_one_sided
+                        ? OneSidedBetaBinomialMixture::log_normalizer(r_, g, h)
+                        : TwoSidedBetaBinomialMixture::log_normalizer(r_, g,
+                                                                      h)) {
     assert(g > 0);
     assert(h > 0);
     assert(r_ > 0);
   }
 
-  double log_superMG(const double s, const double v) const override;
-  double s_upper_bound(const double v) const override;
+  double log_superMG(const double s, const double v) const override {
+    return is_one_sided_ ? sided<true>().log_superMG(s, v)
+        : sided<false>().log_superMG(s, v);
+  }
+  using MixtureSupermartingale::log_superMG;
+  double s_upper_bound(const double v) const override {
+    return v / g_;
+  }
   double bound(const double v, const double log_threshold) const override {
-    return find_mixture_bound(*this, v, log_threshold);
+    return is_one_sided_ ? find_mixture_bound(sided<true>(), v, log_threshold)
+        : find_mixture_bound(sided<false>(), v, log_threshold);
+  }
+  double special_function_scale(const double v) const override {
+    return (r_ + v) / (std::min(g_, h_) * (g_ + h_));
+  }
+  double d_log_superMG_ds(const double s, const double v) const override {
+    return is_one_sided_ ? sided<true>().d_log_superMG_ds(s, v)
+        : sided<false>().d_log_superMG_ds(s, v);
+  }
+  double d2_log_superMG_ds2(const double s, const double v) const override {
+    return is_one_sided_ ? sided<true>().d2_log_superMG_ds2(s, v)
+        : sided<false>().d2_log_superMG_ds2(s, v);
+  }
+  void bound_sequence(const double* v, const size_t n,
+                      const double log_threshold, double* out) const override {
+    if (is_one_sided_) {
+      sided<true>().bound_sequence(v, n, log_threshold, out);
+    } else {
+      sided<false>().bound_sequence(v, n, log_threshold, out);
+    }
+  }
+  void bound_multi(const double* v, const size_t num_v,
+                   const double* log_thresholds, const size_t num_thresholds,
+                   double* out) const override {
+    if (is_one_sided_) {
+      sided<true>().bound_multi(v, num_v, log_thresholds, num_thresholds, out);
+    } else {
+      sided<false>().bound_multi(v, num_v, log_thresholds, num_thresholds,
+                                 out);
+    }
+  }
+  bool cache_parameters(std::array<double, 5>& parameters) const override {
+    parameters = {5, r_, g_, h_, is_one_sided_ ? 1.0 : 0.0};
+    return true;
   }
 
+  double g() const { return g_; }
+  double h() const { return h_; }
+  bool is_one_sided() const { return is_one_sided_; }
+
  private:
 
-  static double optimal_r(const double v_opt, const double alpha_opt,
-                          const double g, const double h,
-                          const bool is_one_sided) {
-    double rho = is_one_sided
-        ? OneSidedNormalMixture::best_rho(v_opt, alpha_opt)
-        : TwoSidedNormalMixture::best_rho(v_opt, alpha_opt);
-    return std::max(rho - g * h, 1e-3 * g * h);
+  // This mixture as its specialization, at the current precision.
+  template <bool IsOneSided>
+  SidedBetaBinomialMixture<IsOneSided> sided() const {
+    return SidedBetaBinomialMixture<IsOneSided>(r_, g_, h_, normalizer_,
+                                                precision());
   }
 
   const double r_;
@@ -213,17 +1074,58 @@ class BetaBinomialMixture : public MixtureSupermartingale {
   const double normalizer_;
 };
 
+// Solver instantiations compiled into confseq_core, declared extern below so
+// that its users do not instantiate them again.
+#define CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, Mixture)                 \
+  EXTERN template double find_mixture_bound(const Mixture&, const double,      \
+                                            const double);                     \
+  EXTERN template double find_mixture_bound(const Mixture&, const double,      \
+                                            const double, const double,        \
+                                            const double);                     \
+  EXTERN template double find_next_mixture_bound(                              \
+      const Mixture&, const double, const double, const double,                \
+      const double);                                                           \
+  EXTERN template void find_mixture_bound_sequence(                            \
+      const Mixture&, const double*, const size_t, const double, double*);     \
+  EXTERN template void find_mixture_bounds(                                    \
+      const Mixture&, const double, const double*, const size_t, double*)
+
+#define CONFSEQ_ALL_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN)                      \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, MixtureSupermartingale);       \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, TwoSidedNormalMixture);        \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, OneSidedNormalMixture);        \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, GammaExponentialMixture);      \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, GammaPoissonMixture);          \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, BetaBinomialMixture);          \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, OneSidedBetaBinomialMixture);  \
+  CONFSEQ_MIXTURE_SOLVER_INSTANTIATIONS(EXTERN, TwoSidedBetaBinomialMixture)
+
+#ifdef CONFSEQ_SEPARATE_COMPILATION
+CONFSEQ_ALL_MIXTURE_SOLVER_INSTANTIATIONS(extern);
+#endif
+
 class PolyStitchingBound {
  public:
   PolyStitchingBound(double v_min, double c, double s, double eta)
     : v_min_(v_min), c_(c), s_(s), eta_(eta),
       k1_((pow(eta, .25) + pow(eta, -.25)) / sqrt(2)),
       k2_((sqrt(eta) + 1) / 2),
-      A_(log(boost::math::zeta(s) / pow(log(eta), s))) {
+      A_(log(boost::math::zeta(s, MathPolicy()) / pow(log(eta), s))) {
     assert(v_min > 0);
   }
 
   double operator()(const double v, const double alpha) const;
+  // Evaluates operator()(v[i], alpha) into out[i] for i < n, agreeing to
+  // within rounding. log(1 / alpha) is folded into the constant term, leaving
+  // two logs and a square root per element.
+  void bound_sequence(const double* v, const size_t n, const double alpha,
+                      double* out) const;
+  // Evaluates operator()(v[i], alpha[i]) into out[i] for i < n, likewise.
+  void bounds(const double* v, const double* alpha, const size_t n,
+              double* out) const;
+  // As bound_sequence, into floats, each rounded up from the double bound.
+  void bound_sequence(const float* v, const size_t n, const double alpha,
+                      float* out) const;
 
   const double v_min_;
   const double c_;
@@ -239,29 +1141,260 @@ public:
   MixtureBoundary(std::unique_ptr<MixtureSupermartingale>&& mixture_superMG)
       : mixture_superMG_(std::move(mixture_superMG)) {}
 
+  // Consults the process-wide BoundaryCache when it is enabled.
+  double operator()(const double v, const double alpha) const;
+
+  void bound_sequence(const double* v, const size_t n, const double alpha,
+                      double* out) const {
+    mixture_superMG_->bound_sequence(v, n, log(1 / alpha), out);
+  }
+
+private:
+  std::unique_ptr<MixtureSupermartingale> mixture_superMG_;
+};
+
+// MixtureBoundary holding its mixture by value, so that bound evaluation is
+// resolved at compile time. Unlike MixtureBoundary, it bypasses the
+// process-wide BoundaryCache.
+template <class Mixture>
+class MixtureBoundaryT {
+public:
+  explicit MixtureBoundaryT(const Mixture& mixture_superMG)
+      : mixture_superMG_(mixture_superMG) {}
+
   double operator()(const double v, const double alpha) const {
-    return mixture_superMG_->bound(v, log(1 / alpha));
+    return mixture_superMG_.bound(v, log(1 / alpha));
+  }
+
+  void bound_sequence(const double* v, const size_t n, const double alpha,
+                      double* out) const {
+    mixture_superMG_.bound_sequence(v, n, log(1 / alpha), out);
+  }
+
+  const Mixture& mixture() const {
+    return mixture_superMG_;
   }
 
 private:
+  const Mixture mixture_superMG_;
+};
+
+// Precomputed mixture boundary for a fixed alpha on a log-spaced grid of v.
+//
+// The log mixture is jointly convex in (s, v), so the boundary is concave in v.
+// Extending the chords of the neighboring grid cells therefore gives an upper
+// envelope of the boundary within each cell, and the envelope is what
+// queries return, so tabulated values are never below the exact boundary.
+// Below v_min the value at v_min is returned; above v_max the last chord is
+// extended. Queries are O(1) and do not allocate. Copies share the table.
+class TabulatedBoundary {
+ public:
+  TabulatedBoundary(const MixtureSupermartingale& mixture_superMG,
+                    const double alpha, const double v_min,
+                    const double v_max, const size_t num_points);
+
+  double operator()(const double v) const;
+  // Evaluates operator()(v[i]) into out[i] for i < n, rounded up to the
+  // next float so that the envelope stays above the exact boundary.
+  void bound_sequence(const float* v, const size_t n, float* out) const;
+
+  double alpha() const { return alpha_; }
+  double v_min() const { return grid_[0]; }
+  double v_max() const { return grid_[num_points_ - 1]; }
+  size_t num_points() const { return num_points_; }
+
+  // Versioned binary format: a fixed header of magic, version, alpha and the
+  // grid size, then the grid, the tabulated boundary values and the chord
+  // slopes, 8-byte aligned, so map_file() can memory-map a saved table.
+  // load() also reads version 1 files, which have no slopes.
+  void save(std::ostream& out) const;
+  // Throws std::runtime_error on malformed input, including a grid that is
+  // not finite, positive and strictly increasing, or values or slopes that
+  // are not finite.
+  static TabulatedBoundary load(std::istream& in);
+  // Memory-maps a file written by save() where mmap is available, and reads
+  // it with load() otherwise. Processes mapping the same file share one copy
+  // of the table in the page cache. The table is checked as load() checks
+  // it, which reads every page once.
+  static TabulatedBoundary map_file(const std::string& path);
+
+ private:
+  // data holds the grid, values and slopes, num_points each, with the last
+  // slope unused.
+  TabulatedBoundary(const double alpha, const size_t num_points,
+                    std::shared_ptr<const double> storage,
+                    const double* data);
+  // A table of num_points entries in storage of its own, for the grid and
+  // values to be written to grid_storage() and values_storage() before
+  // compute_slopes().
+  TabulatedBoundary(const double alpha, const size_t num_points);
+  double* grid_storage() { return const_cast<double*>(grid_); }
+  double* values_storage() { return const_cast<double*>(values_); }
+  void compute_slopes();
+  // Throws std::runtime_error unless the table is one operator() can read.
+  void check_table() const;
+
+  double alpha_;
+  double log_v_min_;
+  double log_step_;
+  size_t num_points_;
+  // Owns either a heap array or a memory mapping containing the table.
+  std::shared_ptr<const double> storage_;
+  const double* grid_;
+  const double* values_;
+  const double* slopes_;
+};
+
+// Mixture boundary at v = v_scale * t + v_offset for t = 1, ..., size,
+// evaluated on demand. Accessing entry i, at t = i + 1, computes the chunk of
+// chunk_size entries holding it with one warm-started bound_sequence() call
+// and caches it, so reading a few entries of a long sequence never builds an
+// array of its full length. discard_before() drops the chunks behind a
+// sliding read position. Access updates the cache, so objects are not
+// thread-safe.
+class BoundarySequence {
+ public:
+  BoundarySequence(std::unique_ptr<MixtureSupermartingale>&& mixture_superMG,
+                   const double alpha, const size_t size,
+                   const double v_scale=1, const double v_offset=0,
+                   const size_t chunk_size=1024);
+
+  // Throws std::out_of_range unless i < size().
+  double operator[](const size_t i);
+  // Writes entries [begin, end) into out. Chunks already cached are copied;
+  // the rest are evaluated directly into out without being cached.
+  void values(const size_t begin, const size_t end, double* out) const;
+  // Drops cached chunks lying entirely before entry i. They are recomputed
+  // if accessed again.
+  void discard_before(const size_t i);
+
+  double v(const size_t i) const { return v_scale_ * (i + 1) + v_offset_; }
+  double alpha() const { return alpha_; }
+  size_t size() const { return size_; }
+  size_t chunk_size() const { return chunk_size_; }
+  size_t num_cached_chunks() const { return chunks_.size(); }
+
+ private:
+  void evaluate(const size_t begin, const size_t end, double* out) const;
+
   std::unique_ptr<MixtureSupermartingale> mixture_superMG_;
+  const double alpha_;
+  const double log_threshold_;
+  const size_t size_;
+  const double v_scale_;
+  const double v_offset_;
+  const size_t chunk_size_;
+  std::map<size_t, std::vector<double>> chunks_;
 };
 
+// BetaBinomialMixture with log_superMG precomputed on a grid, for callers that
+// evaluate one fixed mixture many times, such as QuantileABTest.
+//
+// Rows are num_v log-spaced values of v between v_min and v_max. Row v holds
+// num_z evenly spaced values of z = s / sqrt(v) with |z| <= z_max, clipped to
+// the support -v / h <= s <= v / g. Along each row the log mixture is convex
+// in s, and as it is jointly convex in (s, v), it is also convex in v along
+// each ray s = u v. Chords of the table are therefore upper bounds, and
+// extended chords of neighboring cells are lower bounds, first along the rows
+// at u = s / v and then across the rows. log_superMG returns the certified
+// lower bound, less a margin for rounding in the tabulated values, so p-values
+// and bounds computed from it are conservative. Queries outside the table
+// fall back to the exact mixture. Queries are O(1) and do not allocate.
+class TabulatedBetaBinomialMixture final : public MixtureSupermartingale {
+ public:
+  TabulatedBetaBinomialMixture(const BetaBinomialMixture& mixture_superMG,
+                               const double v_min, const double v_max,
+                               const size_t num_v=128, const size_t num_z=257,
+                               const double z_max=16);
+
+  double log_superMG(const double s, const double v) const override;
+  using MixtureSupermartingale::log_superMG;
+  // Certified (lower, upper) bounds on the exact log mixture. The upper bound
+  // is infinite where the table does not determine one.
+  std::pair<double, double> log_superMG_bounds(const double s,
+                                               const double v) const;
+  double s_upper_bound(const double v) const override {
+    return mixture_superMG_.s_upper_bound(v);
+  }
+  double bound(const double v, const double log_threshold) const override {
+    return find_mixture_bound(*this, v, log_threshold);
+  }
+  const BetaBinomialMixture& mixture() const { return mixture_superMG_; }
+  double v_min() const { return v_.front(); }
+  double v_max() const { return v_.back(); }
+
+ private:
+  // Bounds along row k at u = s / v.
+  std::pair<double, double> row_bounds(const size_t k, const double u) const;
+
+  const BetaBinomialMixture mixture_superMG_;
+  const size_t num_z_;
+  double log_v_min_;
+  double log_step_;
+  std::vector<double> v_;
+  std::vector<double> sqrt_v_;
+  std::vector<double> z_min_;
+  std::vector<double> z_step_;
+  // Rounding margin for bounds computed from rows up to k.
+  std::vector<double> slack_;
+  // num_z_ values and num_z_ - 1 chord slopes per row.
+  std::vector<double> values_;
+  std::vector<double> slopes_;
+};
+
+class OrderStatisticInterface;
+
 class EmpiricalProcessLILBound {
  public:
   EmpiricalProcessLILBound(const double alpha, const double t_min,
-                           const double A)
+                           const double A,
+                           const SolverPrecision& precision=SolverPrecision())
       : t_min_(t_min), A_(A) {
     assert(A > 1 / sqrt(2));
     assert(t_min >= 1);
     assert(0 < alpha && alpha < 1);
-    C_ = find_optimal_C(alpha, A);
+    C_ = find_optimal_C(alpha, A, precision);
   }
 
   double operator()(const double t) const;
+  // Evaluates operator()(t[i]) into out[i] for i < n, rounded up to the next
+  // float so that it never falls below the double bound.
+  void bound_sequence(const float* t, const size_t n, float* out) const;
+
+  // Confidence bounds for the quantiles p[j] given the first t[i] values of
+  // x, into lower and upper at i * num_p + j: the floor(t (p - bound) + 1)th
+  // and ceil(t (p + bound))th smallest values, or -/+ infinity outside
+  // [1, t]. Read out as DoubleStitchingBound::quantile_band_matrix does.
+  void quantile_band_matrix(const double* x, const size_t* t,
+                            const size_t num_times, const double* p,
+                            const size_t num_p, double* lower, double* upper,
+                            const int num_threads=0) const;
+
+  // Confidence band for the CDF at x[i], i < n, given the values of
+  // order_stats: the empirical CDF at x[i] minus and plus operator()(t) at
+  // t = order_stats.size(), clipped to [0, 1], into lower[i] and upper[i].
+  // The band is [0, 1] while t < t_min. Increasing x are counted in one
+  // merge pass.
+  void ecdf_band(const OrderStatisticInterface& order_stats, const double* x,
+                 const size_t n, double* lower, double* upper) const;
+  // The band at each distinct value of order_stats, in increasing order,
+  // into values, lower and upper, which are resized to match. Between
+  // distinct values the empirical CDF, and so the band, is constant. Takes
+  // one pass over the distinct values.
+  void ecdf_band(const OrderStatisticInterface& order_stats,
+                 std::vector<double>* values, std::vector<double>* lower,
+                 std::vector<double>* upper) const;
 
  private:
-  static double find_optimal_C(const double alpha, const double A);
+  friend class ConstantsBundle;
+
+  // Memoized per (alpha, A), since the optimization is a three-level nested
+  // root search and minimization, and read from the installed
+  // ConstantsBundle if it has it.
+  static double find_optimal_C(const double alpha, const double A,
+                               const SolverPrecision& precision);
+  static double compute_optimal_C(const double alpha, const double A,
+                                  const SolverPrecision& precision);
 
   const double t_min_;
   const double A_;
@@ -274,7 +1407,8 @@ class DoubleStitchingBound {
                        const double eta)
       : t_opt_(t_opt), delta_(delta), s_(s), eta_(eta),
         k1_((pow(eta, .25) + pow(eta, -.25)) / sqrt(2)),
-        k2_((sqrt(eta) + 1) / 2)
+        k2_((sqrt(eta) + 1) / 2),
+        log_epoch_constant_(get_log_epoch_constant(s, eta))
   {
     assert(t_opt_ >= 1);
     assert(delta_ > 0);
@@ -284,13 +1418,56 @@ class DoubleStitchingBound {
 
   double operator()(const double p, const double t, const double alpha) const;
 
+  // Evaluates the bound at quantile levels p[i], i < n, for a fixed t into
+  // out[i], computing the t-dependent terms once.
+  void band(const double* p, const size_t n, const double t,
+            const double alpha, double* out) const;
+  // As band, into floats, each rounded up from the double bound.
+  void band(const float* p, const size_t n, const double t,
+            const double alpha, float* out) const;
+
+  // Confidence bounds for the quantiles p[i] at t = order_stats.size(),
+  // taken directly as order statistics: the floor(t p - bound(1 - p) + 1)th
+  // and ceil(t p + bound(p))th smallest values, or -/+ infinity when the
+  // index falls outside [1, t].
+  void quantile_band(const OrderStatisticInterface& order_stats,
+                     const double* p, const size_t n, const double alpha,
+                     double* lower, double* upper) const;
+
+  // The bound at each time t[i] and level p[j] into out[i * num_p + j].
+  // Rows are spread across threads, each computing its t-dependent terms
+  // once, as band() does.
+  void band_matrix(const double* t, const size_t num_times, const double* p,
+                   const size_t num_p, const double alpha, double* out,
+                   const int num_threads=0) const;
+  // quantile_band() on each prefix x[0..t[i]), for nondecreasing t, into
+  // lower and upper at i * num_p + j. The order statistic indices of all
+  // rows are found across threads, then the values are read out in one pass
+  // over x, each inserted once into a DynamicOrderStatistics rather than
+  // each prefix being sorted. Throws std::invalid_argument unless t is
+  // nondecreasing.
+  void quantile_band_matrix(const double* x, const size_t* t,
+                            const size_t num_times, const double* p,
+                            const size_t num_p, const double alpha,
+                            double* lower, double* upper,
+                            const int num_threads=0) const;
+
  private:
+  static double get_log_epoch_constant(const double s, const double eta);
+  // The order statistic indices of quantile_band() at time t.
+  void band_indices(const double* p, const size_t n, const double t,
+                    const double alpha, double* lower_index,
+                    double* upper_index) const;
+  double evaluate(const double p, const double t_max_m, const double sqrt_t,
+                  const double log_log_t, const double log_alpha) const;
+
   const double t_opt_;
   const double delta_;
   const double s_;
   const double eta_;
   const double k1_;
   const double k2_;
+  const double log_epoch_constant_;
 };
 
 class OrderStatisticInterface {
@@ -300,519 +1477,13960 @@ class OrderStatisticInterface {
   virtual int count_less(const double value) const = 0;
   virtual int count_less_or_equal(const double value) const = 0;
   virtual int size() const = 0;
-};
-
-class StaticOrderStatistics : public OrderStatisticInterface {
- public:
-  template <class InputIt> StaticOrderStatistics(InputIt first, InputIt last)
-      : sorted_values_(first, last) {
-    std::sort(sorted_values_.begin(), sorted_values_.end());
+  // Bound on the absolute difference between the counts reported above and
+  // the counts over the full sample, for summaries that do not keep every
+  // value.
+  virtual int rank_error() const {
+    return 0;
   }
-
-  virtual double get_order_statistic(const int order_index) const override {
-    return sorted_values_[order_index - 1];
+  // All values in ascending order, for implementations that store them
+  // contiguously, or nullptr. Lets QuantileABTest scan arms directly.
+  virtual const double* sorted_values() const {
+    return nullptr;
   }
 
-  virtual int count_less(const double value) const override {
-    return std::lower_bound(sorted_values_.begin(), sorted_values_.end(), value)
-        - sorted_values_.begin();
-  }
-  virtual int count_less_or_equal(const double value) const override {
-    return std::upper_bound(sorted_values_.begin(), sorted_values_.end(), value)
-        - sorted_values_.begin();
+  // The sample as size runs of equal values: values[j] in strictly
+  // ascending order, and ends[j] the number of values up to and including
+  // the run of values[j].
+  struct SortedRuns {
+    const double* values = nullptr;
+    const int* ends = nullptr;
+    int size = 0;
+  };
+  // The runs of implementations that store them contiguously, with null
+  // pointers otherwise. Lets QuantileABTest scan tie-compressed arms one run
+  // at a time.
+  virtual SortedRuns sorted_runs() const {
+    return SortedRuns();
   }
 
-  virtual int size() const override {
-    return sorted_values_.size();
+  // count_less(queries[i]) into out[i] for i < n. Nondecreasing queries on
+  // implementations with sorted_values() or sorted_runs() take one merge
+  // pass, galloping from each answer to the next, so nearby queries cost
+  // O(1) each. Other queries are answered one at a time, across num_threads
+  // threads.
+  void count_less_batch(const double* queries, const size_t n, int* out,
+                        const int num_threads=0) const;
+  // As count_less_batch(), for count_less_or_equal().
+  void count_less_or_equal_batch(const double* queries, const size_t n,
+                                 int* out, const int num_threads=0) const;
+
+ private:
+  void count_batch(const double* queries, const size_t n,
+                   const bool or_equal, int* out, const int num_threads) const;
+};
+
+// Contiguous storage in double, for OrderStatisticInterface::sorted_values().
+inline const double* as_double_values(const double* values) {
+  return values;
+}
+template <class Value> const double* as_double_values(const Value*) {
+  return nullptr;
+}
+
+// Search index over a sorted array of Value compared as double, giving the
+// same positions as std::lower_bound and std::upper_bound. The first value of
+// every block of BLOCK_SIZE is kept in Eytzinger (breadth-first) order, so the
+// first levels of a descent share a few cache lines, each step prefetches the
+// node four levels below and no step branches on the comparison. A query then
+// scans the one block of the array holding its answer. The index takes at
+// most 16 bytes per block; the sorted array itself is left untouched for
+// order statistics.
+class SortedSearchIndex {
+ public:
+  static const size_t BLOCK_SIZE = 16;
+
+  SortedSearchIndex() {}
+  template <class Value>
+  SortedSearchIndex(const Value* sorted, const size_t n);
+
+  template <class Value>
+  size_t lower_bound(const Value* sorted, const size_t n,
+                     const double value) const {
+    return search(sorted, n, [value](const double x) { return x < value; });
+  }
+  template <class Value>
+  size_t upper_bound(const Value* sorted, const size_t n,
+                     const double value) const {
+    return search(sorted, n, [value](const double x) { return !(value < x); });
+  }
+
+ private:
+  template <class Value, class Before>
+  size_t search(const Value* sorted, const size_t n, Before before) const;
+  template <class Value>
+  size_t build(const Value* sorted, size_t block, const size_t node);
+
+  size_t num_blocks_ = 0;
+  int height_ = 0;
+  // The first values of the blocks in Eytzinger order, from keys_[1], with
+  // the children of node k at 2k and 2k + 1; keys_[0] is unused.
+  std::vector<double> keys_ = std::vector<double>(1);
+};
+
+// Order statistics over a copy of the sample, stored as Value (double, float,
+// or an integer type) and compared as double. Integers beyond 2^53 in
+// magnitude may compare inexactly.
+//
+// A tie-compressed sample keeps each distinct value once, as a double, with
+// the number of values up to and including it, so memory and QuantileABTest
+// scans grow with the number of distinct values and heavily tied samples are
+// much cheaper to test. Queries stay exact.
+template <class Value>
+class StaticOrderStatisticsT : public OrderStatisticInterface {
+ public:
+  // Values are sorted across num_threads threads, by default all of them, and
+  // then tie-compressed if compress_ties is set.
+  template <class InputIt>
+  StaticOrderStatisticsT(InputIt first, InputIt last, const int num_threads=0,
+                         const bool compress_ties=false);
+  // The tie-compressed sample holding counts[i] copies of values[i] for
+  // i < n, which need not be sorted or distinct. Throws
+  // std::invalid_argument on NaN values, negative counts or more than
+  // INT_MAX values in all.
+  StaticOrderStatisticsT(const Value* values, const int64_t* counts,
+                         const size_t n);
+
+  virtual double get_order_statistic(const int order_index) const override {
+    if (compressed_) {
+      return run_values_[std::lower_bound(run_ends_.begin(), run_ends_.end(),
+                                          order_index) - run_ends_.begin()];
+    }
+    return sorted_values_[order_index - 1];
+  }
+
+  virtual int count_less(const double value) const override {
+    if (compressed_) {
+      return count_runs_before(index_.lower_bound(
+          run_values_.data(), run_values_.size(), value));
+    }
+    return index_.lower_bound(sorted_values_.data(), sorted_values_.size(),
+                              value);
+  }
+  virtual int count_less_or_equal(const double value) const override {
+    if (compressed_) {
+      return count_runs_before(index_.upper_bound(
+          run_values_.data(), run_values_.size(), value));
+    }
+    return index_.upper_bound(sorted_values_.data(), sorted_values_.size(),
+                              value);
+  }
+
+  virtual int size() const override {
+    if (compressed_) {
+      return run_ends_.empty() ? 0 : run_ends_.back();
+    }
+    return sorted_values_.size();
+  }
+
+  virtual const double* sorted_values() const override {
+    return compressed_ ? nullptr : as_double_values(sorted_values_.data());
+  }
+
+  virtual SortedRuns sorted_runs() const override {
+    SortedRuns runs;
+    if (compressed_) {
+      runs.values = run_values_.data();
+      runs.ends = run_ends_.data();
+      runs.size = run_values_.size();
+    }
+    return runs;
+  }
+
+  bool compressed() const { return compressed_; }
+
+ private:
+  int count_runs_before(const size_t run) const {
+    return run == 0 ? 0 : run_ends_[run - 1];
+  }
+
+  bool compressed_ = false;
+  std::vector<Value> sorted_values_;
+  std::vector<double> run_values_;
+  std::vector<int> run_ends_;
+  // Over run_values_ when compressed_, and over sorted_values_ otherwise.
+  SortedSearchIndex index_;
+};
+
+using StaticOrderStatistics = StaticOrderStatisticsT<double>;
+
+// Order statistics over an externally owned buffer of values already in
+// ascending order, such as a NumPy array or R vector, stored as Value. Nothing
+// is copied, so the buffer must outlive the view; sortedness is not checked.
+template <class Value>
+class SortedOrderStatisticsViewT : public OrderStatisticInterface {
+ public:
+  SortedOrderStatisticsViewT(const Value* first, const Value* last)
+      : first_(first), last_(last) {}
+
+  virtual double get_order_statistic(const int order_index) const override {
+    return first_[order_index - 1];
+  }
+
+  virtual int count_less(const double value) const override {
+    return std::lower_bound(first_, last_, value) - first_;
+  }
+  virtual int count_less_or_equal(const double value) const override {
+    return std::upper_bound(first_, last_, value) - first_;
+  }
+
+  virtual int size() const override {
+    return last_ - first_;
+  }
+
+  virtual const double* sorted_values() const override {
+    return as_double_values(first_);
+  }
+
+ private:
+  const Value* const first_;
+  const Value* const last_;
+};
+
+using SortedOrderStatisticsView = SortedOrderStatisticsViewT<double>;
+
+// Order statistics over a sorted column file, a fixed header followed by the
+// values as ascending doubles, written by build_sorted_column(). map_file()
+// memory-maps the column where mmap is available, so QuantileABTest reads only
+// the pages around the quantiles it tests, through the page cache, and scans
+// them in place through sorted_values(). Sortedness is not
+// checked when mapping. Columns hold at most INT_MAX values, the limit of
+// OrderStatisticInterface counts.
+class MappedOrderStatistics : public OrderStatisticInterface {
+ public:
+  virtual double get_order_statistic(const int order_index) const override {
+    return values_[order_index - 1];
+  }
+
+  virtual int count_less(const double value) const override {
+    return std::lower_bound(values_, values_ + size_, value) - values_;
+  }
+  virtual int count_less_or_equal(const double value) const override {
+    return std::upper_bound(values_, values_ + size_, value) - values_;
+  }
+
+  virtual int size() const override {
+    return size_;
+  }
+
+  virtual const double* sorted_values() const override {
+    return values_;
+  }
+
+  // Throws std::runtime_error on malformed input.
+  static MappedOrderStatistics load(std::istream& in);
+  // Memory-maps a file written by build_sorted_column() where mmap is
+  // available, and reads it with load() otherwise.
+  static MappedOrderStatistics map_file(const std::string& path);
+
+ private:
+  MappedOrderStatistics(std::shared_ptr<const double> storage,
+                        const double* values, const int size)
+      : storage_(std::move(storage)), values_(values), size_(size) {}
+
+  // Owns either a heap array or a memory mapping containing values_.
+  std::shared_ptr<const double> storage_;
+  const double* values_;
+  int size_;
+};
+
+// Writes a sorted column file for MappedOrderStatistics from input_path, a
+// file of raw native-endian doubles, by external merge sort: runs of at most
+// max_values_in_memory values are sorted across threads and written to
+// output_path + ".run<i>", then merged into output_path and removed. Throws
+// std::runtime_error on I/O errors or NaN values.
+void build_sorted_column(const std::string& input_path,
+                         const std::string& output_path,
+                         const size_t max_values_in_memory=size_t(1) << 27);
+
+// Order statistics over a growing sample. Values are kept in sorted blocks of
+// at most 2 * BLOCK_SIZE values, split in half when full, with a Fenwick index
+// over block sizes, so inserts and queries take O(log n + BLOCK_SIZE)
+// operations and never re-sort the sample.
+class DynamicOrderStatistics : public OrderStatisticInterface {
+ public:
+  static const int BLOCK_SIZE = 512;
+
+  DynamicOrderStatistics() {}
+  template <class InputIt> DynamicOrderStatistics(InputIt first, InputIt last) {
+    insert(first, last);
+  }
+
+  void insert(const double value);
+  // Inserts a range of values. Large ranges relative to the current sample
+  // are merged and re-blocked in a single pass.
+  template <class InputIt> void insert(InputIt first, InputIt last);
+
+  virtual double get_order_statistic(const int order_index) const override;
+  virtual int count_less(const double value) const override;
+  virtual int count_less_or_equal(const double value) const override;
+
+  virtual int size() const override {
+    return size_;
+  }
+
+  // Writes the values as a sorted column file, which load() reads back and
+  // MappedOrderStatistics::map_file() maps without copying.
+  void save(std::ostream& out) const;
+  // Throws std::runtime_error on malformed input.
+  static DynamicOrderStatistics load(std::istream& in);
+
+ private:
+  void rebuild(const std::vector<double>& sorted_values);
+  void rebuild_index();
+  int count_blocks_before(const size_t block) const;
+
+  std::vector<std::vector<double>> blocks_;
+  // Largest value in each block.
+  std::vector<double> block_max_;
+  // Fenwick tree over block sizes, one-based.
+  std::vector<int> block_index_;
+  int size_ = 0;
+};
+
+// Exact order statistics over a sample with few distinct values, such as
+// integer milliseconds or counts, held as its distinct values in ascending
+// order with a Fenwick index over their counts. Memory is O(d) in the number
+// d of distinct values rather than O(n), and queries take O(log d).
+// Inserting a value already present takes O(log d); a new value rebuilds the
+// index in O(d).
+class HistogramOrderStatistics : public OrderStatisticInterface {
+ public:
+  HistogramOrderStatistics() {}
+  // The sample holding counts[i] copies of values[i] for i < n. Values need
+  // not be sorted or distinct. Throws std::invalid_argument on NaN values,
+  // negative counts or more than INT_MAX values in all.
+  HistogramOrderStatistics(const double* values, const int64_t* counts,
+                           const size_t n);
+
+  // Adds count copies of value, with the errors of the constructor.
+  void insert(const double value, const int64_t count=1);
+
+  virtual double get_order_statistic(const int order_index) const override;
+  virtual int count_less(const double value) const override;
+  virtual int count_less_or_equal(const double value) const override;
+
+  virtual int size() const override {
+    return size_;
+  }
+
+  // The distinct values in ascending order and the count of each.
+  const std::vector<double>& values() const { return values_; }
+  const std::vector<int>& counts() const { return counts_; }
+
+ private:
+  void rebuild_index();
+  // Total count of the num_values smallest distinct values.
+  int count_values_before(const size_t num_values) const;
+
+  std::vector<double> values_;
+  std::vector<int> counts_;
+  // Fenwick tree over counts_, one-based.
+  std::vector<int> index_;
+  int size_ = 0;
+};
+
+// Order statistics from a deterministic compactor sketch, holding about
+// k log2(n / k) values rather than the whole sample. Level h holds values of
+// weight 2^h; when it reaches k values they are sorted and every other one is
+// promoted to level h + 1. Each such compaction changes any count by at most
+// 2^h, and rank_error() reports the sum over compactions so far, which is at
+// most 2 n log2(n / k) / k.
+//
+// Sketches of disjoint samples, such as the shards of an arm held by
+// separate nodes, merge() into a sketch of their union whose rank_error()
+// adds the errors of the parts to those of the compactions the merge needs,
+// so quantile tests on the merged sketch stay conservative. save() writes the
+// retained values and their levels for shipping between nodes.
+//
+// Queries build a sorted summary on first use after an insert, so instances
+// should not be queried concurrently with inserts or with each other while
+// the summary is stale.
+class SketchOrderStatistics : public OrderStatisticInterface {
+ public:
+  explicit SketchOrderStatistics(const int k=4096) : k_(k) {
+    assert(k >= 2);
+  }
+  template <class InputIt>
+  SketchOrderStatistics(InputIt first, InputIt last, const int k=4096)
+      : SketchOrderStatistics(k) {
+    insert(first, last);
+  }
+
+  void insert(const double value);
+  template <class InputIt> void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  virtual double get_order_statistic(const int order_index) const override;
+  virtual int count_less(const double value) const override;
+  virtual int count_less_or_equal(const double value) const override;
+
+  virtual int size() const override {
+    return size_;
+  }
+  virtual int rank_error() const override {
+    return rank_error_;
+  }
+
+  // Adds the sample summarized by other, which must have the same k.
+  // Throws std::invalid_argument otherwise.
+  void merge(const SketchOrderStatistics& other);
+
+  int k() const { return k_; }
+  size_t num_retained() const;
+
+  // Throws std::runtime_error on malformed input.
+  void save(std::ostream& out) const;
+  static SketchOrderStatistics load(std::istream& in);
+
+ private:
+  void compact(const size_t level);
+  // Compacts every level holding k or more values, lowest first.
+  void compact_full_levels();
+  void update_summary() const;
+
+  const int k_;
+  int size_ = 0;
+  int rank_error_ = 0;
+  std::vector<std::vector<double>> levels_;
+  // Alternates which half of each level is promoted, to limit bias.
+  std::vector<bool> level_offsets_;
+
+  mutable bool summary_valid_ = false;
+  mutable std::vector<double> summary_values_;
+  // Total weight of summary values up to and including each one.
+  mutable std::vector<int64_t> summary_ranks_;
+};
+
+// The part of a QuantileABTest fixed by (quantile_p, t_opt, alpha_opt): the
+// beta-binomial mixture, an optional table of it, and the G minimizers found
+// so far for each arm size. Constructing the mixture costs an optimal_r
+// search and an incomplete beta normalizer, so a config built once per metric
+// leaves each test on it only the scan over the arms. The minimizer cache is
+// guarded by a mutex; otherwise a config is immutable, and may be shared by
+// tests on any threads.
+class QuantileABTestConfig {
+ public:
+  // Given a table of the mixture, the G functions are evaluated from its
+  // certified lower bound, so p-values are slightly conservative but need no
+  // special functions. Throws std::invalid_argument if the table was built
+  // for other parameters.
+  QuantileABTestConfig(const double quantile_p, const int t_opt,
+                       const double alpha_opt,
+                       std::shared_ptr<const TabulatedBetaBinomialMixture>
+                           table=nullptr);
+
+  double quantile_p() const { return quantile_p_; }
+  int t_opt() const { return t_opt_; }
+  double alpha_opt() const { return alpha_opt_; }
+  const BetaBinomialMixture& mixture() const { return mixture_; }
+  const std::shared_ptr<const TabulatedBetaBinomialMixture>& table() const {
+    return table_;
   }
 
+  // Proportion below the hypothesized quantile minimizing the log mixture of
+  // an arm of arm_size observations.
+  double G_minimizer(const int arm_size) const;
+  // Number of arm sizes whose minimizers are held.
+  size_t num_cached_minimizers() const;
+
  private:
-  std::vector<double> sorted_values_;
+  // Bounds the cache for arms that grow one observation at a time. Sizes
+  // beyond it fall back to the process-wide minimizer cache.
+  static constexpr size_t max_cached_minimizers = 4096;
+
+  const double quantile_p_;
+  const int t_opt_;
+  const double alpha_opt_;
+  const BetaBinomialMixture mixture_;
+  const std::shared_ptr<const TabulatedBetaBinomialMixture> table_;
+  mutable std::mutex mutex_;
+  mutable std::unordered_map<int, double> minimizers_;
 };
 
 class QuantileABTest {
  public:
+  // A test of the two arms under config, which they share with any other
+  // tests of the same metric.
+  QuantileABTest(std::shared_ptr<const QuantileABTestConfig> config,
+                 std::shared_ptr<OrderStatisticInterface> arm1_os,
+                 std::shared_ptr<OrderStatisticInterface> arm2_os)
+      : config_(std::move(config)), quantile_p_(config_->quantile_p()),
+        mixture_(config_->mixture()), arm1_os_(std::move(arm1_os)),
+        arm2_os_(std::move(arm2_os)), table_(config_->table()) {}
+  // As above, with a config of its own. One table serves every test with the
+  // same quantile_p, t_opt and alpha_opt; see QuantileABTestConfig.
   QuantileABTest(const double quantile_p, const int t_opt,
                  const double alpha_opt,
                  std::shared_ptr<OrderStatisticInterface> arm1_os,
-                 std::shared_ptr<OrderStatisticInterface> arm2_os)
-      : quantile_p_(quantile_p),
-        mixture_(std::make_unique<BetaBinomialMixture>(
-            t_opt * quantile_p * (1 - quantile_p), alpha_opt, quantile_p,
-            1 - quantile_p, false)),
-        arm1_os_(arm1_os), arm2_os_(arm2_os) {
-    assert(0 < quantile_p && quantile_p < 1);
+                 std::shared_ptr<OrderStatisticInterface> arm2_os,
+                 std::shared_ptr<const TabulatedBetaBinomialMixture> table=
+                     nullptr)
+      : QuantileABTest(std::make_shared<const QuantileABTestConfig>(
+                           quantile_p, t_opt, alpha_opt, std::move(table)),
+                       std::move(arm1_os), std::move(arm2_os)) {}
+
+  const std::shared_ptr<const QuantileABTestConfig>& config() const {
+    return config_;
+  }
+
+  // Table of the mixture for tests with these parameters and arms of up to
+  // max_arm_size observations. Larger arms fall back to exact evaluation.
+  static std::shared_ptr<const TabulatedBetaBinomialMixture> tabulate_mixture(
+      const double quantile_p, const int t_opt, const double alpha_opt,
+      const int max_arm_size);
+
+  double p_value() const;
+  // Whether the test rejects at level alpha, that is, p_value() <= alpha.
+  bool rejects(const double alpha) const;
+  // p_value() if it is at most max_p, and 1 otherwise. The search stops at the
+  // first point showing the p-value exceeds max_p, which for tests far from
+  // rejection is usually the first point tried.
+  double capped_p_value(const double max_p) const;
+
+  // Minimizers of each arm's G function. The overloads below set them to the
+  // minimizers found by the search; the values passed in are not read.
+  using Minimizers = std::array<double, 2>;
+  double p_value(Minimizers& minimizers) const;
+  double capped_p_value(const double max_p, Minimizers& minimizers) const;
+
+  // The test of arm 1 against arm 2 with delta added to each of its values,
+  // that is, of whether arm 1's quantile exceeds arm 2's by delta. The shift
+  // is applied inside the rank queries, so neither arm is copied or re-sorted,
+  // and the result matches the test on the shifted values except where
+  // rounding in the shift changes ties.
+  double shifted_p_value(const double delta) const;
+  bool shifted_rejects(const double delta, const double alpha) const;
+  // Confidence sequence for arm 1's quantile minus arm 2's: an interval
+  // holding every delta that shifted_rejects(delta, alpha) does not reject.
+  // Those deltas form an interval, whose ends are found by bisection to within
+  // tolerance times the range of the pooled values, rounding outward. An end
+  // is infinite when no shift, however large, is rejected, and both are while
+  // either arm is empty. The G minimizers depend only on the arm sizes, so
+  // they are found once for every shift. Throws std::invalid_argument unless
+  // 0 < alpha < 1 and tolerance > 0.
+  std::pair<double, double> quantile_difference_cs(
+      const double alpha, const double tolerance=1e-9) const;
+
+ private:
+  // G for one arm is arm_log_superMG at the proportion of values below x,
+  // except on [minimum_start_x, minimum_end_x], where it takes its minimum.
+  // The arm's order statistics and size are resolved once here, so that
+  // evaluating G neither selects an arm nor makes virtual calls beyond the
+  // rank queries of G itself.
+  struct GFunction {
+    const OrderStatisticInterface* os;
+    int size;
+    double minimizer;
+    double minimum_start_x;
+    double minimum_end_x;
+    // Rank error of the arm's counts, as a proportion.
+    double slack;
+    // Added to each of the arm's values. The minimum bounds above include it.
+    double shift;
+  };
+
+  // Infimum over x of the summed G functions. The search returns early with
+  // the first value found below stop_below, if any.
+  double log_superMG_lower_bound(
+      const double stop_below=-std::numeric_limits<double>::infinity(),
+      Minimizers* minimizers=nullptr) const;
+  // As log_superMG_lower_bound, for arms with G functions arm_1_G and
+  // arm_2_G whose empirical quantiles average to middle.
+  double pair_log_superMG_lower_bound(const GFunction& arm_1_G,
+                                      const GFunction& arm_2_G,
+                                      const double middle,
+                                      const double stop_below) const;
+  GFunction get_G_fn(const OrderStatisticInterface& os,
+                     double* minimizer_out=nullptr) const;
+  static GFunction shifted_G_fn(GFunction G_fn, const double delta);
+  // Whether the test of arm_1_G against arm_2_G shifted by delta rejects at
+  // log_threshold.
+  bool shifted_rejects(const GFunction& arm_1_G, const GFunction& arm_2_G,
+                       const double delta, const double log_threshold) const;
+  double find_G_minimizer(const int arm_size) const;
+  double G(const GFunction& G_fn, const double x) const;
+  double G_from_counts(const GFunction& G_fn, const double x,
+                       const int count_less, const int count_less_or_equal)
+      const;
+  double G_from_proportion(const GFunction& G_fn, double prop_below) const;
+  double empirical_quantile(const OrderStatisticInterface& os) const;
+  double find_log_superMG_lower_bound(const GFunction& first_arm_G,
+                                      const GFunction& second_arm_G,
+                                      const double stop_below) const;
+  // Log mixture for an arm of arm_size observations, of which a proportion
+  // prop_below lie below the hypothesized quantile.
+  double arm_log_superMG(const int arm_size, const double prop_below,
+                          const bool tabulated=false) const;
+  friend class MultiArmQuantileTest;
+
+  const std::shared_ptr<const QuantileABTestConfig> config_;
+  const double quantile_p_;
+  const BetaBinomialMixture& mixture_;
+  const std::shared_ptr<OrderStatisticInterface> arm1_os_;
+  const std::shared_ptr<OrderStatisticInterface> arm2_os_;
+  const std::shared_ptr<const TabulatedBetaBinomialMixture> table_;
+};
+
+// QuantileABTests between pairs of K arms, such as each treatment against a
+// control, or all pairs. Each arm's order statistics and G function are
+// computed once, however many pairs it is in, and the pairwise scans share
+// them across threads. p-values match QuantileABTest's on the same two arms.
+// Pairs with an empty arm get p-value 1.
+class MultiArmQuantileTest {
+ public:
+  MultiArmQuantileTest(const double quantile_p, const int t_opt,
+                       const double alpha_opt,
+                       std::vector<std::shared_ptr<OrderStatisticInterface>>
+                           arms,
+                       std::shared_ptr<const TabulatedBetaBinomialMixture>
+                           table=nullptr);
+  // Arm i holds values[offsets[i]..offsets[i + 1]), sorted once into
+  // StaticOrderStatistics, arms across threads.
+  MultiArmQuantileTest(const double quantile_p, const int t_opt,
+                       const double alpha_opt, const double* values,
+                       const size_t* offsets, const size_t num_arms,
+                       std::shared_ptr<const TabulatedBetaBinomialMixture>
+                           table=nullptr);
+
+  size_t num_arms() const { return arms_.size(); }
+  const std::shared_ptr<OrderStatisticInterface>& arm(const size_t i) const {
+    return arms_.at(i);
+  }
+
+  // Throws std::out_of_range for arms beyond num_arms().
+  double p_value(const size_t arm1, const size_t arm2) const;
+  // p_values[k] = p_value(arm1[k], arm2[k]) for k < num_pairs, across
+  // threads.
+  void p_values(const size_t* arm1, const size_t* arm2,
+                const size_t num_pairs, double* p_values,
+                int num_threads=0) const;
+  // p_values[i] = p_value(i, control) for each arm i, with 1 for the control
+  // itself.
+  void p_values_against(const size_t control, double* p_values,
+                        int num_threads=0) const;
+
+ private:
+  void prepare_arms();
+
+  // Supplies the mixture and pairwise scan, which depend only on the
+  // parameters; its own arms are the first arm twice.
+  std::unique_ptr<QuantileABTest> scorer_;
+  std::vector<std::shared_ptr<OrderStatisticInterface>> arms_;
+  std::vector<QuantileABTest::GFunction> G_fns_;
+};
+
+// QuantileABTest over arms that grow as data arrives. Observations are added
+// to dynamic order statistics for each arm, and the G minimizers, which
+// depend only on the arm sizes, are memoized across searches. Since the
+// p-values are valid uniformly over time, so is their running minimum.
+class SequentialQuantileABTest {
+ public:
+  SequentialQuantileABTest(const double quantile_p, const int t_opt,
+                           const double alpha_opt=0.05)
+      : arms_{{std::make_shared<DynamicOrderStatistics>(),
+               std::make_shared<DynamicOrderStatistics>()}},
+        test_(quantile_p, t_opt, alpha_opt, arms_[0], arms_[1]),
+        quantile_p_(quantile_p), t_opt_(t_opt), alpha_opt_(alpha_opt) {}
+
+  void add(const int arm, const double value);
+  template <class InputIt> void add(const int arm, InputIt first, InputIt last);
+
+  // p-value given all observations so far, or 1 while either arm is empty.
+  double p_value();
+  // Minimum of the p-value over every time it has been evaluated, including
+  // now. Only whether the current p-value is below the running minimum
+  // matters, so the search usually stops early.
+  double running_p_value();
+
+  const DynamicOrderStatistics& order_stats(const int arm) const {
+    assert(arm == 1 || arm == 2);
+    return *arms_[arm - 1];
+  }
+
+  // Writes a checkpoint of the parameters, both arms and the search state,
+  // from which load() resumes with identical p-values. Throws
+  // std::runtime_error on malformed input.
+  void save(std::ostream& out) const;
+  static SequentialQuantileABTest load(std::istream& in);
+
+ private:
+  void invalidate() {
+    p_value_current_ = false;
+    running_p_value_current_ = false;
+  }
+  bool has_empty_arm() const {
+    return arms_[0]->size() == 0 || arms_[1]->size() == 0;
+  }
+
+  const std::array<std::shared_ptr<DynamicOrderStatistics>, 2> arms_;
+  const QuantileABTest test_;
+  const double quantile_p_;
+  const int t_opt_;
+  const double alpha_opt_;
+  QuantileABTest::Minimizers minimizers_ = {{0, 0}};
+  double p_value_ = 1;
+  bool p_value_current_ = true;
+  double running_p_value_ = 1;
+  bool running_p_value_current_ = true;
+};
+
+// Confidence sequence for the CDF of a stream, uniform over x and time, from
+// the empirical process LIL bound. C is found once at construction, and
+// values arrive through add() into dynamic order statistics, so each band is
+// read off the sorted values so far without re-sorting.
+class CDFConfidenceSequence {
+ public:
+  CDFConfidenceSequence(const double alpha, const double t_min,
+                        const double A=0.85)
+      : bound_(alpha, t_min, A) {}
+
+  void add(const double value) {
+    order_stats_.insert(value);
+  }
+  template <class InputIt> void add(InputIt first, InputIt last) {
+    order_stats_.insert(first, last);
+  }
+
+  // Lower and upper confidence bounds for the CDF at x.
+  std::pair<double, double> interval(const double x) const {
+    std::pair<double, double> bounds;
+    band(&x, 1, &bounds.first, &bounds.second);
+    return bounds;
+  }
+  // As EmpiricalProcessLILBound::ecdf_band() on the values so far.
+  void band(const double* x, const size_t n, double* lower,
+            double* upper) const {
+    bound_.ecdf_band(order_stats_, x, n, lower, upper);
+  }
+  void band(std::vector<double>* values, std::vector<double>* lower,
+            std::vector<double>* upper) const {
+    bound_.ecdf_band(order_stats_, values, lower, upper);
+  }
+
+  int size() const { return order_stats_.size(); }
+  const DynamicOrderStatistics& order_stats() const { return order_stats_; }
+  const EmpiricalProcessLILBound& bound() const { return bound_; }
+
+ private:
+  const EmpiricalProcessLILBound bound_;
+  DynamicOrderStatistics order_stats_;
+};
+
+// Confidence sequence for quantiles of a stream, from the double stitching
+// bound. Values arrive through add() into dynamic order statistics, and bounds
+// at the current t are read off as order statistics, taking O(log t) per
+// quantile level with no re-sorting.
+class QuantileConfidenceSequence {
+ public:
+  QuantileConfidenceSequence(const double alpha, const int t_opt,
+                             const double delta=0.5, const double s=1.4,
+                             const double eta=2)
+      : alpha_(alpha), bound_(t_opt, delta, s, eta) {
+    assert(0 < alpha && alpha < 1);
+  }
+
+  void add(const double value) {
+    order_stats_.insert(value);
+  }
+  template <class InputIt> void add(InputIt first, InputIt last) {
+    order_stats_.insert(first, last);
+  }
+
+  // Lower and upper confidence bounds for the p-quantile given all values so
+  // far, which are -/+ infinity until enough values have been seen.
+  std::pair<double, double> interval(const double p) const {
+    std::pair<double, double> bounds;
+    intervals(&p, 1, &bounds.first, &bounds.second);
+    return bounds;
+  }
+  // Bounds for each of the n levels p[i] into lower[i] and upper[i].
+  void intervals(const double* p, const size_t n, double* lower,
+                 double* upper) const {
+    bound_.quantile_band(order_stats_, p, n, alpha_, lower, upper);
+  }
+
+  int size() const { return order_stats_.size(); }
+  const DynamicOrderStatistics& order_stats() const { return order_stats_; }
+
+ private:
+  const double alpha_;
+  const DoubleStitchingBound bound_;
+  DynamicOrderStatistics order_stats_;
+};
+
+// Order statistics for the two arms of a test, from contiguous ranges of
+// values of any type supported by StaticOrderStatisticsT. With assume_sorted,
+// ranges are viewed in place; otherwise both are copied and sorted
+// concurrently, splitting the threads between them.
+template <class Value1, class Value2>
+std::array<std::shared_ptr<OrderStatisticInterface>, 2>
+two_arm_order_statistics(const Value1* arm1_first, const Value1* arm1_last,
+                         const Value2* arm2_first, const Value2* arm2_last,
+                         const bool assume_sorted);
+
+// QuantileABTest p-values for each of the n levels quantile_p[i] on the same
+// pair of arms, computed across threads.
+void quantile_ab_p_values(
+    const std::shared_ptr<OrderStatisticInterface>& arm1_os,
+    const std::shared_ptr<OrderStatisticInterface>& arm2_os,
+    const double* quantile_p, const size_t n, const int t_opt,
+    const double alpha_opt, double* p_values);
+
+// QuantileABTest p-values for num_pairs independent pairs of arms, pair i
+// comparing arm1_values[arm1_offsets[i]..arm1_offsets[i + 1]) with
+// arm2_values[arm2_offsets[i]..arm2_offsets[i + 1]) at level quantile_p[i]
+// with t_opt[i]. Each pair is sorted and scanned as one task, and threads
+// claim the tasks one at a time, largest pair first, so arms of very
+// different sizes still balance. Pairs with an empty arm get p-value 1.
+void batch_quantile_ab_p_values(
+    const double* arm1_values, const size_t* arm1_offsets,
+    const double* arm2_values, const size_t* arm2_offsets,
+    const size_t num_pairs, const double* quantile_p, const int* t_opt,
+    const double alpha_opt, double* p_values, int num_threads=0);
+
+// Streaming form of bernoulli_confidence_interval. Observations arrive through
+// update(), and each endpoint is re-solved from a narrow bracket around its
+// previous value, which moves little per update. Optionally reports the
+// running intersection of all intervals so far.
+class BernoulliConfidenceSequence {
+ public:
+  BernoulliConfidenceSequence(
+      const double alpha, const double t_opt, const double alpha_opt=0.05,
+      const bool running_intersection=false,
+      const SolverPrecision& precision=SolverPrecision())
+      : alpha_(alpha), t_opt_(t_opt), alpha_opt_(alpha_opt),
+        running_intersection_(running_intersection), precision_(precision) {
+    assert(0 < alpha && alpha < 1);
+    assert(t_opt > 0);
+  }
+
+  // Adds num_trials observations summing to num_successes, and returns the
+  // updated interval.
+  std::pair<double, double> update(const double num_successes,
+                                   const int num_trials);
+
+  std::pair<double, double> interval() const {
+    return interval_;
+  }
+  double num_successes() const {
+    return num_successes_;
+  }
+  int num_trials() const {
+    return num_trials_;
+  }
+
+  // Writes a checkpoint of the parameters, counts, warm-start brackets and
+  // running intersection, from which load() resumes with identical intervals.
+  // Throws std::runtime_error on malformed input.
+  void save(std::ostream& out) const;
+  static BernoulliConfidenceSequence load(std::istream& in);
+
+ private:
+  double solve(const double lower_limit, const double upper_limit,
+               const double lower_limit_value,
+               const double upper_limit_value, const double guess,
+               const double width) const;
+
+  const double alpha_;
+  const double t_opt_;
+  const double alpha_opt_;
+  const bool running_intersection_;
+  const SolverPrecision precision_;
+  double num_successes_ = 0;
+  int num_trials_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+  double lower_step_ = 0;
+  double upper_step_ = 0;
+  std::pair<double, double> interval_ = {0, 1};
+};
+
+// bernoulli_confidence_interval for every num_successes <= num_trials <=
+// n_max, with fixed alpha, t_opt and alpha_opt. Lookups are O(1). Tables are
+// built across threads, warm-starting each interval from its neighbour with
+// one fewer success. The save() format is a fixed header followed by the raw
+// bounds, so map_file() can memory-map a saved table in place of reading it.
+class BernoulliCSTable {
+ public:
+  BernoulliCSTable(const int n_max, const double alpha, const double t_opt,
+                   const double alpha_opt=0.05);
+
+  std::pair<double, double> operator()(const int num_successes,
+                                       const int num_trials) const {
+    assert(0 <= num_successes && num_successes <= num_trials);
+    assert(num_trials <= n_max_);
+    const double* entry = bounds_
+        + 2 * (size_t(num_trials) * (num_trials + 1) / 2 + num_successes);
+    return std::make_pair(entry[0], entry[1]);
+  }
+
+  bool contains(const int num_successes, const int num_trials) const {
+    return 0 <= num_successes && num_successes <= num_trials
+        && num_trials <= n_max_;
+  }
+
+  int n_max() const {
+    return n_max_;
+  }
+  double alpha() const {
+    return alpha_;
+  }
+  double t_opt() const {
+    return t_opt_;
+  }
+  double alpha_opt() const {
+    return alpha_opt_;
+  }
+
+  void save(std::ostream& out) const;
+  // Throws std::runtime_error on malformed input.
+  static BernoulliCSTable load(std::istream& in);
+  // Memory-maps a file written by save() where mmap is available, and reads
+  // it with load() otherwise.
+  static BernoulliCSTable map_file(const std::string& path);
+
+ private:
+  BernoulliCSTable(const int n_max, const double alpha, const double t_opt,
+                   const double alpha_opt,
+                   std::shared_ptr<const double> storage,
+                   const double* bounds)
+      : n_max_(n_max), alpha_(alpha), t_opt_(t_opt), alpha_opt_(alpha_opt),
+        storage_(std::move(storage)), bounds_(bounds) {}
+
+  static size_t num_entries(const int n_max) {
+    return size_t(n_max + 1) * (n_max + 2) / 2;
   }
 
-  double p_value() const;
+  int n_max_;
+  double alpha_;
+  double t_opt_;
+  double alpha_opt_;
+  // Owns either a heap array or a memory mapping containing bounds_.
+  std::shared_ptr<const double> storage_;
+  const double* bounds_;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Two-sample sequential tests of means
+//////////////////////////////////////////////////////////////////////
+
+// Mixture boundary of a TwoSampleMeanTest. Both are applied to the
+// differences D_k = Y_k - X_k of the k-th treatment and control observations,
+// which have mean Delta, the difference in arm means, however the arms
+// interleave.
+enum class TwoSampleMixture {
+  // For outcomes in [lower_bd, upper_bd]: the beta-binomial mixture of
+  // bernoulli_confidence_interval on D_k rescaled to [0, 1], tuned for t_opt
+  // pairs.
+  BETA_BINOMIAL,
+  // For differences within c of the mean of the earlier ones, e.g. c =
+  // 2 (upper_bd - lower_bd) for bounded outcomes: the gamma-exponential mixture
+  // with the empirical variance process of conjmix_empbern_cs, tuned for
+  // intrinsic time v_opt.
+  GAMMA_EXPONENTIAL,
+};
+
+// The mixture named "beta_binomial" or "gamma_exponential". Throws
+// std::invalid_argument for other names.
+TwoSampleMixture two_sample_mixture(const std::string& name);
+
+// Arguments of a TwoSampleMeanTest, each used only by the mixtures that take
+// it.
+struct TwoSampleMeanTestParams {
+  TwoSampleMixture mixture = TwoSampleMixture::BETA_BINOMIAL;
+  // Error probability of the confidence sequence on Delta.
+  double alpha = 0.05;
+  double alpha_opt = 0.05;
+  // The p-value tests Delta = null_difference.
+  double null_difference = 0;
+  bool running_intersection = false;
+  // BETA_BINOMIAL
+  double t_opt = 100;
+  double lower_bd = 0;
+  double upper_bd = 1;
+  // GAMMA_EXPONENTIAL
+  double v_opt = 100;
+  double c = 1;
+  // 0 evaluates the boundary and p-value after every pair. Otherwise they are
+  // evaluated only when the number of pairs reaches one of the
+  // geometric_readout_times with ratio readout_eta > 1, or at readout(),
+  // while the sums still take every pair, so that interval() and p_value()
+  // are those of the latest readout and their running intersection and
+  // minimum run over readouts.
+  double readout_eta = 0;
+};
+
+// Sequential test of the difference in means of a control and a treatment
+// arm. Observations are paired in arrival order within each arm, and only
+// the sums of the pairs and, for GAMMA_EXPONENTIAL, the empirical variance
+// are kept, along with the unpaired observations of whichever arm is ahead.
+// Each pair costs O(1): the confidence sequence is warm-started from the
+// previous one and the p-value is one mixture evaluation. The always-valid
+// p-value is the running minimum of 1 / M_t at the null, so it falls below
+// alpha when the running intersection of the confidence sequence excludes
+// the null. The constructor throws std::invalid_argument for invalid
+// parameters.
+class TwoSampleMeanTest {
+ public:
+  explicit TwoSampleMeanTest(
+      const TwoSampleMeanTestParams& params=TwoSampleMeanTestParams());
+
+  // Adds control observations x[0..num_control) and treatment observations
+  // y[0..num_treatment), and returns the confidence interval for Delta.
+  // Throws std::invalid_argument, leaving the state unchanged, for
+  // BETA_BINOMIAL observations outside [lower_bd, upper_bd].
+  std::pair<double, double> update(const double* x, const size_t num_control,
+                                   const double* y,
+                                   const size_t num_treatment);
+  // Evaluates the boundary and p-value for all pairs so far, if they have
+  // not been since the last pair, and returns the interval.
+  std::pair<double, double> readout();
+
+  // The confidence interval for Delta, the whole outcome range before any
+  // pairs for BETA_BINOMIAL and the real line for GAMMA_EXPONENTIAL.
+  std::pair<double, double> interval() const {
+    return interval_;
+  }
+  double p_value() const {
+    return p_value_;
+  }
+  // Mean of the paired differences, or NaN before the first pair.
+  double estimate() const;
+  size_t num_pairs() const {
+    return num_pairs_;
+  }
+  size_t num_control() const {
+    return num_pairs_ + (backlog_is_treatment_ ? 0 : backlog_.size());
+  }
+  size_t num_treatment() const {
+    return num_pairs_ + (backlog_is_treatment_ ? backlog_.size() : 0);
+  }
+  const TwoSampleMeanTestParams& params() const {
+    return params_;
+  }
+
+ private:
+  static const TwoSampleMeanTestParams& validate(
+      const TwoSampleMeanTestParams& params);
+  void add_pair(const double difference);
+
+  TwoSampleMeanTestParams params_;
+  // BETA_BINOMIAL differences are rescaled from [-width, width] to [0, 1].
+  double width_;
+  double null_p_;
+  BernoulliConfidenceSequence bernoulli_cs_;
+  GammaExponentialMixture mixture_;
+  double log_threshold_;
+  // Unpaired observations, all from one arm.
+  std::deque<double> backlog_;
+  bool backlog_is_treatment_ = false;
+  size_t num_pairs_ = 0;
+  double sum_ = 0;
+  double variance_ = 0;
+  // BETA_BINOMIAL pairs not yet passed to bernoulli_cs_.
+  double pending_successes_ = 0;
+  int pending_trials_ = 0;
+  // Pairs at the last readout and at the next geometric one, which is
+  // ceil(readout_scale_).
+  size_t readout_pairs_ = 0;
+  size_t next_readout_ = 1;
+  double readout_scale_ = 1;
+  // Bound at intrinsic time bound_variance_, the last readout.
+  double bound_variance_ = 0;
+  double bound_ = 0;
+  double p_value_ = 1;
+  std::pair<double, double> interval_;
+};
+
+// TwoSampleMeanTest over num_experiments independent experiments, for
+// instance one per metric or segment, held back to back: experiment e has
+// control observations control[control_offsets[e]..control_offsets[e + 1])
+// and treatment observations likewise. Writes the final interval and p-value
+// of each experiment to lower[e], upper[e] and p_value[e]. Experiments are
+// spread across threads.
+void two_sample_mean_tests(const TwoSampleMeanTestParams& params,
+                           const double* control,
+                           const size_t* control_offsets,
+                           const double* treatment,
+                           const size_t* treatment_offsets,
+                           const size_t num_experiments, double* lower,
+                           double* upper, double* p_value,
+                           const int num_threads=0);
+
+//////////////////////////////////////////////////////////////////////
+// Average treatment effect confidence sequences
+//////////////////////////////////////////////////////////////////////
+
+// Arguments of an AverageTreatmentEffectCS.
+struct AverageTreatmentEffectParams {
+  // Error probability of the confidence sequence.
+  double alpha = 0.05;
+  double alpha_opt = 0.05;
+  // Intrinsic time for which the boundary is tuned. demo/ate_demo.py uses
+  // t_opt * noise * (1 / p + 1 / (1 - p)) for t_opt units, outcome variance
+  // noise and propensity p.
+  double v_opt = 100;
+  // Support of the potential outcomes.
+  double lower_bd = 0;
+  double upper_bd = 1;
+  // Propensities must lie in [min_propensity, 1 - min_propensity].
+  double min_propensity = 0.5;
+  // An estimate is emitted after every cadence-th unit. Each costs a warm
+  // started root search; above about 10^5 rows per second, use a larger
+  // cadence or a reduced precision.
+  size_t cadence = 1;
+  SolverPrecision precision;
+};
+
+// One row of AverageTreatmentEffectCS output, the columns of
+// demo/ate_demo.py.
+struct AverageTreatmentEffectEstimate {
+  size_t t;
+  double point_estimate;
+  double upper_confidence_bound;
+  double lower_confidence_bound;
+  double p_value;
+};
+
+// Confidence sequence for the average treatment effect in a randomized
+// experiment with bounded potential outcomes, following Corollary 2 of the
+// confidence sequences paper as demo/ate_demo.py does. Unit t has outcome
+// y_t, treatment indicator T_t and known propensity p_t. Its inverse
+// propensity weighted estimate X_t = tau_hat_t + w_t (y_t - yhat_t), with
+// w_t = (T_t - p_t) / (p_t (1 - p_t)), is unbiased for the unit's effect
+// given predictions of both potential outcomes made before it arrived.
+// Only S_t, the sum of X_t, and V_t, the sum of (X_t - tau_hat_t)^2, are
+// kept, so each unit costs O(1). The gamma-exponential mixture bound on S_t,
+// with scale c = 2 (upper_bd - lower_bd) / min_propensity, is evaluated only
+// at emitted rows, warm-started from the previous row. The p-value at each
+// row is 1 / M(S_t, V_t) for the same mixture, as in the demo. The
+// constructor throws std::invalid_argument for invalid parameters.
+class AverageTreatmentEffectCS {
+ public:
+  explicit AverageTreatmentEffectCS(
+      const AverageTreatmentEffectParams& params=AverageTreatmentEffectParams());
+
+  // Adds n units with outcomes y, treatment indicators treatment, each 0 or
+  // 1, and propensities propensity. Predictions of the treated and control
+  // outcomes of each unit default to the running mean outcome of each arm,
+  // or the middle of the support before the arm's first unit; pass
+  // y1_prediction and y0_prediction to supply them instead. Writes a row to
+  // out for each unit completing a multiple of cadence units, at most
+  // num_rows(n) of them, and returns the number written. Throws
+  // std::invalid_argument, leaving the state unchanged, for invalid units.
+  size_t update(const double* y, const double* treatment,
+                const double* propensity, const size_t n,
+                AverageTreatmentEffectEstimate* out,
+                const double* y1_prediction=nullptr,
+                const double* y0_prediction=nullptr);
+
+  // Number of rows update() emits for the next n units.
+  size_t num_rows(const size_t n) const {
+    return (t_ % params_.cadence + n) / params_.cadence;
+  }
+  // The row for the units so far, whether or not it was emitted.
+  AverageTreatmentEffectEstimate estimate() const;
+  size_t t() const {
+    return t_;
+  }
+  double sum() const {
+    return sum_;
+  }
+  double intrinsic_time() const {
+    return variance_;
+  }
+  const AverageTreatmentEffectParams& params() const {
+    return params_;
+  }
+
+ private:
+  static const AverageTreatmentEffectParams& validate(
+      const AverageTreatmentEffectParams& params);
+  AverageTreatmentEffectEstimate row(const double bound) const;
+
+  AverageTreatmentEffectParams params_;
+  GammaExponentialMixture mixture_;
+  double log_threshold_;
+  double diameter_;
+  double sum_ = 0;
+  double variance_ = 0;
+  size_t t_ = 0;
+  // Running sums and counts of each arm's outcomes.
+  double treated_sum_ = 0;
+  double control_sum_ = 0;
+  size_t num_treated_ = 0;
+  size_t num_control_ = 0;
+  // Bound at intrinsic time bound_variance_, the last emitted row.
+  double bound_variance_ = 0;
+  double bound_ = 0;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Parallel evaluation
+//////////////////////////////////////////////////////////////////////
+
+// The NUMA nodes of the machine, each as the CPUs on it that this process
+// may run on, read from /sys/devices/system/node on Linux. Nodes without such
+// CPUs are left out. Elsewhere, where the topology cannot be read, on
+// single-node machines and when the CONFSEQ_NUMA environment variable is
+// "0", there is one node with an empty CPU list, and threads are not pinned.
+struct NumaTopology {
+  std::vector<std::vector<int>> node_cpus;
+
+  size_t num_nodes() const { return node_cpus.size(); }
+};
+
+// Read once, on first use.
+const NumaTopology& numa_topology();
+
+// The CPUs of a Linux CPU list such as "0-3,8,10-11". Throws
+// std::invalid_argument if it is malformed.
+std::vector<int> parse_cpu_list(const std::string& list);
+
+// Persistent worker threads shared by all parallel work, so that threading
+// costs a queue push and a wakeup per call rather than thread creation.
+// Threads that submit work run tasks of their own job too, so nested calls,
+// from tasks or from several threads at once, cannot deadlock waiting for
+// busy workers.
+//
+// On a machine with several NUMA nodes, the calling thread and the workers
+// are spread over the nodes in contiguous blocks, and each worker is pinned
+// to its node's CPUs. A job's tasks are then cut into one contiguous range
+// per node, and threads claim tasks from their own node's range before
+// stealing from the other nodes' ones. Memory that tasks first touch, such as
+// the outputs of a batch of streams and each thread's scratch arena, is
+// thereby placed on the node that processes it.
+class ThreadPool {
+ public:
+  explicit ThreadPool(const int num_workers);
+  ThreadPool(const int num_workers, const NumaTopology& topology);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int num_workers() const { return workers_.size(); }
+  size_t num_nodes() const { return num_nodes_; }
+
+  // Calls task(k) for each k in [0, num_tasks) on the calling thread and at
+  // most max_helpers workers, each claiming the next unstarted task as it
+  // finishes one. Once a task throws, unstarted tasks are skipped, and the
+  // first exception is rethrown when all started tasks have finished.
+  void run(const size_t num_tasks, const std::function<void(size_t)>& task,
+           const int max_helpers);
+
+ private:
+  // Tasks [next, end) of one node, padded to a cache line of its own.
+  struct TaskRange {
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+    char padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  };
+
+  struct Job {
+    const std::function<void(size_t)>* task;
+    size_t num_tasks;
+    int helpers_wanted;
+    std::unique_ptr<TaskRange[]> ranges;
+    size_t num_ranges;
+    std::atomic<size_t> finished_tasks{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+
+  // Runs tasks of job, starting from the range of the given node.
+  static void run_tasks(Job& job, const size_t node);
+  void work(const size_t node, const std::vector<int>& cpus);
+  // The calling thread's node: its worker's, or else the one of the CPU it is
+  // running on.
+  size_t current_node() const;
+
+  size_t num_nodes_ = 1;
+  // Node of each CPU, or -1.
+  std::vector<int> cpu_nodes_;
+  std::mutex mutex_;
+  std::condition_variable available_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+// Thread count used by parallel_for when none is given. Defaults to the
+// hardware concurrency; set to 1 to disable threading. The count is atomic,
+// so any thread may read it while another sets it. Setting it resizes the
+// shared pool, with num_threads - 1 workers beside the calling thread, and
+// must not happen while parallel work is running.
+int get_num_threads();
+void set_num_threads(const int num_threads);
+
+// The pool parallel_for runs on, sized by set_num_threads().
+ThreadPool& thread_pool();
+
+// Calls fn(i) for each i in [0, n) on up to num_threads threads of the shared
+// pool, including the calling one. Ranges shorter than min_chunk_size per
+// thread run serially. Otherwise the range is cut into contiguous chunks,
+// several per thread, which threads claim as they go, so uneven work
+// balances. The first exception thrown by any call is rethrown after all
+// started chunks finish.
+template <class Fn>
+void parallel_for(const size_t n, Fn fn, int num_threads=0,
+                  const size_t min_chunk_size=1024);
+
+// Sorts [first, last) in ascending order, as std::sort does, by sorting
+// contiguous chunks across threads and merging them pairwise. Ranges shorter
+// than min_chunk_size per thread are sorted serially.
+template <class RandomIt>
+void parallel_sort(RandomIt first, RandomIt last, int num_threads=0,
+                   const size_t min_chunk_size=1 << 16);
+
+//////////////////////////////////////////////////////////////////////
+// Scratch memory
+//////////////////////////////////////////////////////////////////////
+
+struct ScratchArenaStats {
+  // Most bytes of call-length scratch in use at once on any one thread since
+  // the last reset_scratch_arena_stats(): the arena size a thread needs.
+  size_t high_water_bytes;
+  // Bytes currently allocated from the heap for scratch, in use or held for
+  // reuse, over all threads.
+  size_t reserved_bytes;
+  // Heap allocations made for scratch since the last reset. Once a workload
+  // has run on every thread, repeating it leaves this unchanged.
+  uint64_t heap_allocations;
+};
+
+// Scratch memory of one thread, reused across calls by the native engines so
+// that repeated calls, and the streams of a batch, allocate nothing once the
+// memory has grown to what the largest call needs. Temporaries living for a
+// call are bump-allocated within ScratchScopes, which nest as calls do;
+// containers that may outlive a call take blocks from per-size free lists
+// through ScratchAllocator.
+class ScratchArena {
+ public:
+  ScratchArena() = default;
+  ~ScratchArena();
+
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  // The calling thread's arena, or null while the thread is destroying it at
+  // exit.
+  static ScratchArena* local();
+
+  // bytes of memory aligned to a cache line, valid until the innermost
+  // ScratchScope open at the call ends.
+  void* allocate(const size_t bytes);
+  // A block of at least bytes from the calling thread's free lists, or from
+  // the heap if they have none, to be handed back to release() with the same
+  // bytes on any thread.
+  static void* acquire(const size_t bytes);
+  static void release(void* block, const size_t bytes);
+
+ private:
+  friend class ScratchScope;
+
+  struct Block {
+    std::unique_ptr<char[]> memory;
+    char* data;
+    size_t size;
+  };
+  struct Mark {
+    size_t block;
+    size_t offset;
+    size_t in_use;
+  };
+
+  void add_block(const size_t position, const size_t size);
+  void rewind(const Mark& mark);
+
+  std::vector<Block> blocks_;
+  Mark top_ = {0, 0, 0};
+  size_t high_water_ = 0;
+  uint64_t stats_epoch_ = 0;
+  // Free blocks of 2^k bytes, and the bytes they hold.
+  std::array<std::vector<void*>, 64> free_lists_;
+  size_t free_bytes_ = 0;
+};
+
+// Call-length scratch from the calling thread's arena, released when the
+// scope ends. Values must be trivially destructible.
+class ScratchScope {
+ public:
+  ScratchScope();
+  ~ScratchScope();
+
+  ScratchScope(const ScratchScope&) = delete;
+  ScratchScope& operator=(const ScratchScope&) = delete;
+
+  // n uninitialized values, or n copies of value.
+  template <class T>
+  T* allocate(const size_t n);
+  template <class T>
+  T* allocate(const size_t n, const T& value);
+
+ private:
+  ScratchArena* arena_;
+  // Stands in for the thread's arena while it is being destroyed.
+  std::unique_ptr<ScratchArena> owned_;
+  ScratchArena::Mark mark_;
+};
+
+// Allocator drawing from the free lists of the calling thread's arena, for
+// the state of sequences that are rebuilt per stream or per call. Blocks go
+// back to the arena of whichever thread frees them.
+template <class T>
+struct ScratchAllocator {
+  using value_type = T;
+
+  ScratchAllocator() = default;
+  template <class U>
+  ScratchAllocator(const ScratchAllocator<U>&) {}
+
+  T* allocate(const size_t n);
+  void deallocate(T* block, const size_t n);
+
+  template <class U>
+  bool operator==(const ScratchAllocator<U>&) const { return true; }
+  template <class U>
+  bool operator!=(const ScratchAllocator<U>&) const { return false; }
+};
+
+template <class T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+ScratchArenaStats scratch_arena_stats();
+// Restarts the high-water mark and the heap allocation count.
+void reset_scratch_arena_stats();
+
+//////////////////////////////////////////////////////////////////////
+// Always-valid p-values
+//////////////////////////////////////////////////////////////////////
+
+// out[i] = min(1, exp(-mixture_superMG.log_superMG(s[i], v[i]))) for i < n,
+// the p-value of a sequential test rejecting when the mixture crosses 1 /
+// alpha, evaluated with the mixture's batch log_superMG kernel across
+// threads. No root search is needed, so this is much cheaper than comparing s
+// against bounds. With running_min, (s[i], v[i]) are successive values of one
+// martingale and its intrinsic time, and out[i] is the minimum over j <= i,
+// the always-valid p-value after observation i. NaN p-values propagate into
+// the running minimum.
+void mixture_p_values(const MixtureSupermartingale& mixture_superMG,
+                      const double* s, const double* v, const size_t n,
+                      const bool running_min, double* out,
+                      const int num_threads=0);
+
+// The first time a sequential test stops, and its state then.
+struct FirstCrossing {
+  // Number of observations at the first crossing, or 0 if there is none.
+  size_t time = 0;
+  // The always-valid p-value, or the confidence bounds, after time
+  // observations, or after the last one if there is no crossing. Tests leave
+  // the fields they do not produce at their defaults.
+  double p_value = 1;
+  double lower = 0;
+  double upper = 1;
+};
+
+// For num_streams martingales held back to back, stream k being
+// (s, v)[offsets[k]..offsets[k + 1]), the first observation at which the
+// running minimum p-value of mixture_p_values falls to alpha or below. Each
+// stream evaluates the batch log_superMG kernel over blocks, doubling from 64
+// to 4096 values, and stops at the block holding its crossing. Streams run
+// across threads.
+void mixture_first_crossings(const MixtureSupermartingale& mixture_superMG,
+                             const double* s, const double* v,
+                             const size_t* offsets, const size_t num_streams,
+                             const double alpha, FirstCrossing* out,
+                             const int num_threads=0);
+
+//////////////////////////////////////////////////////////////////////
+// Tuning sweeps
+//////////////////////////////////////////////////////////////////////
+
+struct MixtureTuningResult {
+  // Index of the candidate with the smallest loss, ignoring NaN losses, or
+  // the number of candidates if every loss is NaN.
+  size_t best_index = 0;
+  // losses[k] = sum over i of weights[i] * bounds[k * num_v + i].
+  std::vector<double> losses;
+  // bounds[k * num_v + i] = candidates[k]->bound(v[i], log(1 / alpha)).
+  std::vector<double> bounds;
+};
+
+// Evaluates the boundary of each candidate mixture, typically one mixture
+// type over a grid of v_opt, alpha_opt or t_opt, at the intrinsic times v[i],
+// i < num_v, and scores it by the weighted sum of the boundary values. With
+// weights[i] the probability of stopping at v[i] under a prior, and the
+// boundary divided by v[i] in the weights for a mean, the loss is the expected
+// confidence radius at stopping. A null weights averages over v. Each
+// candidate's bounds are computed by bound_sequence over blocks of v, so that
+// root searches are warm-started along v, and candidates and blocks run
+// across threads.
+MixtureTuningResult tune_mixture(
+    const std::vector<const MixtureSupermartingale*>& candidates,
+    const double* v, const double* weights, const size_t num_v,
+    const double alpha, const int num_threads=0);
+
+//////////////////////////////////////////////////////////////////////
+// Multiple testing
+//////////////////////////////////////////////////////////////////////
+
+// The e-BH procedure of Wang and Ramdas (2022) over num_tests e-values, kept
+// up to date as some of them change. It rejects the k largest e-values for
+// the largest k such that k of them are at least num_tests / (alpha k), which
+// controls the false discovery rate at alpha under any dependence between the
+// tests. Each e-value is held as the smallest such k it clears, so an update
+// moves one count of a histogram, and the rejections follow from one pass
+// over the histogram rather than a sort. E-values are passed as logs, such as
+// the log_superMG of a mixture at each test's current (s, v); NaN counts as
+// zero. All e-values start at 1.
+class EBHProcedure {
+ public:
+  EBHProcedure(const size_t num_tests, const double alpha);
+
+  // Sets the log e-value of test indices[j] to log_e_values[j], j < count.
+  void update(const size_t* indices, const double* log_e_values,
+              const size_t count);
+  // Sets the log e-value of every test.
+  void update_all(const double* log_e_values);
+  // As update() and update_all() with log_e_values[j] =
+  // mixture_superMG.log_superMG(s[j], v[j]), evaluated with the batch kernel
+  // across threads. A null indices updates tests 0 .. count - 1.
+  void update_from_mixture(const MixtureSupermartingale& mixture_superMG,
+                           const size_t* indices, const double* s,
+                           const double* v, const size_t count,
+                           const int num_threads=0);
+
+  size_t num_rejections() const { return num_rejections_; }
+  bool rejected(const size_t test) const {
+    return thresholds_[test] <= num_rejections_;
+  }
+  // out[i] = rejected(i) for i < num_tests().
+  void rejections(bool* out) const;
+
+  double log_e_value(const size_t test) const { return log_e_values_[test]; }
+  size_t num_tests() const { return log_e_values_.size(); }
+  double alpha() const { return alpha_; }
+
+ private:
+  // Smallest k <= num_tests with log_e_value >= log(num_tests / (alpha k)),
+  // or num_tests + 1 if there is none.
+  size_t threshold_index(const double log_e_value) const;
+  void set(const size_t test, const double log_e_value);
+  void update_num_rejections();
+
+  const double alpha_;
+  const double log_scale_;
+  std::vector<double> log_e_values_;
+  std::vector<size_t> thresholds_;
+  // counts_[k] is the number of tests whose threshold index is k.
+  std::vector<size_t> counts_;
+  size_t num_rejections_ = 0;
+};
+
+// Chooses which of many sequential tests to refresh when there is not time to
+// recompute every log_superMG each tick. A test's priority is a prediction of
+// how far its log_superMG will be from the rejection threshold log(1 / alpha)
+// at its current intrinsic time: the last refreshed value, plus its growth
+// per unit of v since the refresh before, if positive, plus one standard
+// deviation of the change a test at that value could see under the null,
+// sqrt(2 max(log_superMG, 1) dv / v). run() refreshes the stale tests in
+// decreasing priority until a deadline, so the work goes to tests near
+// rejection rather than those far below it. A deferred test keeps its last
+// readout, which is stale but still valid: the boundaries hold uniformly over
+// time, so a bound or p-value from an earlier time stays conservative. Tests
+// that have crossed the threshold have rejected for good and are not
+// refreshed again.
+class RefreshScheduler {
+ public:
+  // Refreshes one test, returning its current (log_superMG, v).
+  using RefreshFunction = std::function<std::pair<double, double>(size_t)>;
+
+  RefreshScheduler(const size_t num_tests, const double alpha);
+
+  // Records that the intrinsic time of test has reached v, which makes it
+  // stale if it was last refreshed at a smaller v.
+  void observe(const size_t test, const double v);
+  // Records the log_superMG of test at intrinsic time v, as from a refresh.
+  void record_refresh(const size_t test, const double log_superMG,
+                      const double v);
+  // Predicted log_superMG - log(1 / alpha) at the observed v: infinite if the
+  // test has never been refreshed, and -infinity once it has rejected.
+  double priority(const size_t test) const;
+  // Calls refresh on the stale tests in decreasing priority, recording each
+  // result, until none is left or deadline passes, and returns how many were
+  // refreshed. A default deadline means no limit.
+  size_t run(const RefreshFunction& refresh,
+             const std::chrono::steady_clock::time_point deadline={});
+
+  // True if test has not been refreshed at its observed v.
+  bool stale(const size_t test) const;
+  bool rejected(const size_t test) const {
+    return log_superMG(test) >= log_threshold_;
+  }
+  // The last refreshed log_superMG of test, zero before the first refresh.
+  double log_superMG(const size_t test) const {
+    return states_[test].log_superMG;
+  }
+  // Intrinsic time of the last refresh of test.
+  double refreshed_v(const size_t test) const { return states_[test].v; }
+  double observed_v(const size_t test) const {
+    return states_[test].observed_v;
+  }
+  size_t num_tests() const { return states_.size(); }
+  double alpha() const { return alpha_; }
+
+ private:
+  struct TestState {
+    double log_superMG = 0;
+    double v = 0;
+    double previous_log_superMG = 0;
+    double previous_v = 0;
+    double observed_v = 0;
+    int num_refreshes = 0;
+  };
+
+  void check_test(const size_t test) const;
+
+  const double alpha_;
+  const double log_threshold_;
+  std::vector<TestState> states_;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Batch evaluation with per-element status
+//////////////////////////////////////////////////////////////////////
+
+// Outcome of one element of a status-reporting batch evaluation.
+enum class EvaluationStatus : uint8_t {
+  OK = 0,
+  // The element's inputs are outside the function's domain.
+  INVALID_ARGUMENT = 1,
+  // A special function or root search failed for the element.
+  NUMERICAL_ERROR = 2,
+};
+
+// out[i] = mixture_superMG.bound(v[i], log(1 / alpha[i])) for i < n, across
+// threads. Instead of throwing, an element that cannot be evaluated gets NaN
+// in out[i] and a failing status[i], so one degenerate input does not discard
+// the rest of the batch.
+void mixture_bounds(const MixtureSupermartingale& mixture_superMG,
+                    const double* v, const double* alpha, const size_t n,
+                    double* out, EvaluationStatus* status,
+                    int num_threads=0);
+
+// bernoulli_confidence_interval for each (num_successes[i], num_trials[i]),
+// i < n, across threads, reporting failures as mixture_bounds does with NaN
+// endpoints.
+void bernoulli_confidence_intervals(
+    const double* num_successes, const int* num_trials, const size_t n,
+    const double alpha, const double t_opt, const double alpha_opt,
+    double* lower, double* upper, EvaluationStatus* status,
+    int num_threads=0);
+
+//////////////////////////////////////////////////////////////////////
+// Boundary cache
+//////////////////////////////////////////////////////////////////////
+
+// Identifies a cached computation: a kind tag, parameters, and arguments, with
+// unused entries set to zero.
+using BoundaryCacheKey = std::array<double, 8>;
+
+struct BoundaryCacheKeyHash {
+  size_t operator()(const BoundaryCacheKey& key) const;
+};
+
+struct BoundaryCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+  size_t size;
+  size_t capacity;
+};
+
+// Thread-safe, fixed-capacity memo of boundary and confidence interval
+// results with least-recently-used eviction.
+class BoundaryCache {
+ public:
+  explicit BoundaryCache(const size_t capacity) : capacity_(capacity) {
+    assert(capacity > 0);
+  }
+
+  // Returns the cached value for key, or computes, stores and returns it.
+  // compute() runs without holding the lock. Keys containing NaN never
+  // compare equal, so they are computed as misses and never stored.
+  template <class Fn>
+  std::pair<double, double> get_or_compute(const BoundaryCacheKey& key,
+                                           Fn compute);
+  void clear();
+  BoundaryCacheStats stats() const;
+
+ private:
+  using Entry = std::pair<BoundaryCacheKey, std::pair<double, double>>;
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::list<Entry> entries_;
+  std::unordered_map<BoundaryCacheKey, std::list<Entry>::iterator,
+                     BoundaryCacheKeyHash> index_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+// The process-wide cache is off by default. When enabled, it memoizes
+// MixtureBoundary::operator(), the simplified *_mixture_bound functions and
+// bernoulli_confidence_interval. Enabling again replaces the cache. Results
+// cut short by a SolveBudgetScope are never stored.
+void enable_boundary_cache(const size_t capacity);
+void disable_boundary_cache();
+void clear_boundary_cache();
+BoundaryCacheStats boundary_cache_stats();
+// The cache in use, empty when disabled. Access with std::atomic_load.
+std::shared_ptr<BoundaryCache>& boundary_cache_instance();
+
+//////////////////////////////////////////////////////////////////////
+// Latency tracing
+//////////////////////////////////////////////////////////////////////
+
+// Entry points reporting to the trace hook.
+enum class TracedFunction {
+  NORMAL_MIXTURE_BOUND,
+  GAMMA_EXPONENTIAL_MIXTURE_BOUND,
+  GAMMA_POISSON_MIXTURE_BOUND,
+  BETA_BINOMIAL_MIXTURE_BOUND,
+  BERNOULLI_CONFIDENCE_INTERVAL,
+  QUANTILE_AB_P_VALUE,
+  PREDMIX_EMPBERN_CS,
+  PREDMIX_HOEFFDING_CS,
+  PREDMIX_EMPBERN_CS_WOR,
+  PREDMIX_HOEFFDING_CS_WOR,
+  CONJMIX_HOEFFDING_CS,
+  CONJMIX_EMPBERN_CS,
+  HEDGED_CS,
+  BETTING_CS_BISECTION,
+  BATCH_CONFIDENCE_SEQUENCES,
+  SIMULATE_CROSSINGS,
+  TWO_SAMPLE_MEAN_TESTS,
+  AVERAGE_TREATMENT_EFFECT_CS,
+  MIXTURE_P_VALUES,
+  TUNE_MIXTURE,
+  E_BH_UPDATE,
+  CONFIDENCE_SEQUENCE_READOUTS,
+  MIXTURE_FIRST_CROSSINGS,
+  BETTING_FIRST_REJECTIONS,
+  CS_FIRST_EXCLUSIONS,
+  INTERSECTED_CS,
+  NUM_TRACED_FUNCTIONS
+};
+
+// Lowercase name of the C++ function, e.g. "normal_mixture_bound".
+const char* traced_function_name(const TracedFunction function);
+
+// Called around each traced call, from whichever thread makes it, so
+// implementations must be thread-safe. input_size is the intrinsic time for
+// bounds, the number of trials for Bernoulli intervals, the total arm size for
+// quantile tests, the number of observations for confidence sequences and
+// p-values and the number of replicates for crossing simulations.
+class TraceHook {
+ public:
+  virtual ~TraceHook() {}
+
+  virtual void begin(const TracedFunction /*function*/,
+                     const size_t /*input_size*/) {}
+  virtual void end(const TracedFunction function, const size_t input_size,
+                   const uint64_t elapsed_ns) = 0;
+};
+
+// Installs hook process-wide, replacing any previous one. nullptr, the
+// default, disables tracing, leaving each traced call one relaxed atomic load.
+void set_trace_hook(std::shared_ptr<TraceHook> hook);
+std::shared_ptr<TraceHook> trace_hook();
+
+struct LatencySummary {
+  uint64_t count;
+  double mean_ns;
+  double p50_ns;
+  double p90_ns;
+  double p99_ns;
+  double p999_ns;
+  uint64_t max_ns;
+};
+
+// Latency distribution of each traced function, recorded lock-free into
+// log-linear buckets: SUB_BUCKETS per power of two nanoseconds, so quantiles
+// are reported within 1 / SUB_BUCKETS relative error.
+class LatencyHistogram final : public TraceHook {
+ public:
+  static const int SUB_BUCKET_BITS = 5;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int NUM_BUCKETS = SUB_BUCKETS * (65 - SUB_BUCKET_BITS);
+
+  LatencyHistogram() {
+    reset();
+  }
+
+  void end(const TracedFunction function, const size_t input_size,
+           const uint64_t elapsed_ns) override;
+  void record(const TracedFunction function, const uint64_t elapsed_ns);
+
+  // Latency at quantile q in [0, 1], as the upper edge of its bucket, or zero
+  // if there are no calls.
+  double quantile(const TracedFunction function, const double q) const;
+  LatencySummary summary(const TracedFunction function) const;
+  // Zeroes all counts. Calls recorded concurrently may be partly kept.
+  void reset();
+  // One line per function with calls: name, count, then mean, p50, p90, p99,
+  // p99.9 and max latency in microseconds.
+  void dump(std::ostream& out) const;
+
+  static int bucket_index(const uint64_t ns);
+  static double bucket_upper_edge(const int index);
+
+ private:
+  struct FunctionHistogram {
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+  };
+
+  std::array<FunctionHistogram,
+             size_t(TracedFunction::NUM_TRACED_FUNCTIONS)> functions_;
+};
+
+// Installs a new LatencyHistogram as the trace hook and returns it.
+std::shared_ptr<LatencyHistogram> enable_latency_histogram();
+
+// Reports the enclosing call to the trace hook, if one is installed, for its
+// lifetime.
+class TraceScope {
+ public:
+  TraceScope(const TracedFunction function, const size_t input_size);
+  ~TraceScope();
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  const TracedFunction function_;
+  const size_t input_size_;
+  std::shared_ptr<TraceHook> hook_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Betting capital processes
+//////////////////////////////////////////////////////////////////////
+
+// Which bounds a confidence sequence reports. A two-sided CS splits alpha
+// between its bounds; a one-sided CS spends all of alpha on its one bound
+// and skips the capital process or margin that only the other bound needs,
+// reporting the other bound as 0 or 1.
+enum class CSSide {
+  BOTH,
+  LOWER,
+  UPPER,
+};
+
+// The side named "both", "lower" or "upper". Throws std::invalid_argument
+// for other names.
+CSSide cs_side(const std::string& name);
+
+// The level of each reported bound of a CS of level alpha: alpha / 2 for
+// both sides and alpha for one.
+double cs_side_alpha(const CSSide side, const double alpha);
+
+// The weight theta of the positive capital process in a hedged betting CS
+// for side: theta itself for both sides, 1 for the lower bound, which only
+// the positive process moves, and 0 for the upper bound.
+double cs_side_theta(const CSSide side, const double theta);
+
+// Sets the bound that side does not report to 0 or 1.
+void clear_unreported_bound(const CSSide side, double& lower, double& upper);
+
+// Options of betting.betting_mart: the without-replacement population size N
+// (0 for sampling with replacement), how the positive and negative capital
+// processes are weighted by theta and combined, and how bets are truncated.
+struct BettingOptions {
+  double N = 0;
+  bool convex_comb = false;
+  // With theta 1 (0), as for one-sided CSs, only the positive (negative)
+  // process is advanced.
+  double theta = 0.5;
+  double trunc_scale = 0.5;
+  bool m_trunc = true;
+  // Write log capital rather than capital.
+  bool log_space = false;
+  // Cap negative bets at m before truncation, as hedged_cs does by passing
+  // lambda_predmix_eb, whose second argument is its truncation, as the
+  // negative bets function.
+  bool cap_negative_bets_at_m = false;
+  // Bound on the importance weights of off-policy observations x = w y, with
+  // outcomes y in [0, 1] and weights 0 <= w <= max_weight, such as target
+  // over logging propensities, so that the mean of x is that of y under the
+  // target policy. Observations then lie in [0, max_weight], and bets that
+  // lose when x is large are truncated by max_weight - mu rather than
+  // 1 - mu, which keeps capital nonnegative. 1 for observations in [0, 1];
+  // other values require N = 0.
+  double max_weight = 1;
+};
+
+// Capital as log|capital| and a sign, so products of negative multiplicands
+// behave as they do for raw capital.
+struct SignedLogCapital {
+  double log_abs;
+  bool negative;
+
+  // Multiplies capital by 1 + delta, accumulating log1p(delta) so small bets
+  // lose no precision.
+  void multiply_by_one_plus(const double delta);
+  // Capital stuck at NaN after a product of 0 and inf is 0.
+  SignedLogCapital patched() const;
+  // Capital times exp(log_weight).
+  SignedLogCapital scaled(const double log_weight) const;
+  bool operator<(const SignedLogCapital& other) const;
+};
+
+// Running state of betting_capital_process for one null mean m. Each update
+// takes O(1) time, so several means can be followed through a stream.
+class BettingCapital {
+ public:
+  BettingCapital(const double m, const BettingOptions& options)
+      : m_(m), options_(options), log_theta_(log(options.theta)),
+        log_one_minus_theta_(log(1 - options.theta)) {}
+
+  // Bets on observation x at index i, where sum is the sum of the earlier
+  // observations, and returns the capital, or its log with log_space.
+  double update(const size_t i, const double x, const double sum,
+                double lambda_positive, double lambda_negative);
+
+  double m() const {
+    return m_;
+  }
+
+ private:
+  double m_;
+  BettingOptions options_;
+  // The log weights of the two processes, taken once rather than per update.
+  double log_theta_;
+  double log_one_minus_theta_;
+  double positive_ = 1;
+  double negative_ = 1;
+  SignedLogCapital log_positive_ = {0, false};
+  SignedLogCapital log_negative_ = {0, false};
+};
+
+// Hedged capital process against the null mean m for observations x[0..n),
+// with predictable bets lambdas_positive and lambdas_negative, computed in a
+// single pass. Matches betting.betting_mart, including its conventions that
+// inf * 0 bets multiply capital by 1, products of 0 and inf are 0, and
+// capital is inf wherever the without-replacement mean is outside [0, 1].
+// Throws std::invalid_argument if the combined capital is negative or NaN.
+void betting_capital_process(const double* x, const size_t n, const double m,
+                             const double* lambdas_positive,
+                             const double* lambdas_negative,
+                             const BettingOptions& options, double* capital);
+
+// For each time t < n, the first and last indices i < grid_size for which
+// capital_fn(i, capital), writing the capital process at grid value i for all
+// n times, is at most threshold, or -1 where there are none. Grid values are
+// split into contiguous ranges across threads, each with its own capital
+// buffer, so memory is O(n * num_threads) rather than O(n * grid_size).
+// Buffers come from the threads' scratch arenas.
+template <class CapitalFn>
+void grid_accepted_range(const size_t grid_size, const size_t n,
+                         const double threshold, CapitalFn capital_fn,
+                         int* first_accepted, int* last_accepted,
+                         int num_threads=0);
+// grid_accepted_range for each of thresholds[0..num_thresholds) from a single
+// evaluation of each capital process, with the range for thresholds[k] at
+// time t written to first_accepted[k * n + t] and last_accepted[k * n + t].
+template <class CapitalFn>
+void grid_accepted_range(const size_t grid_size, const size_t n,
+                         const double* thresholds,
+                         const size_t num_thresholds, CapitalFn capital_fn,
+                         int* first_accepted, int* last_accepted,
+                         int num_threads=0);
+// The multi-threshold grid_accepted_range for capital processes kept as
+// states, where update(j, i, sum) advances that of grid value j by
+// observation x[i], sum being the sum of x[0..i), and returns its capital.
+// Rather than computing each grid value's process over all n times, which
+// re-reads x once per grid value and then reduces the endpoints column by
+// column, each thread takes tiles of a block of times by a few grid values:
+// x and the sums of the block stay in L1, the grid values of a tile are
+// advanced together at each time, and their accepted range is reduced within
+// the tile. No capital buffer is kept.
+template <class UpdateFn>
+void tiled_grid_accepted_range(const double* x, const size_t n,
+                               const size_t grid_size,
+                               const double* thresholds,
+                               const size_t num_thresholds, UpdateFn update,
+                               int* first_accepted, int* last_accepted,
+                               int num_threads=0);
+
+// The grid CS over grid[0..grid_size) = betting_grid(breaks) in which a mean,
+// once rejected, stays out: the CS at time t spans the means whose capital
+// has not exceeded threshold by t, widened by a grid step and clipped to the
+// logical CS if N > 0, as grid_cs_interval does, and intersected over time.
+// By Ville's inequality the true mean is never rejected with probability at
+// least 1 - 1 / threshold, and the intervals lie within those of
+// accepted_range_cs with running intersection. update(j, i, sum) advances
+// the capital process of grid mean j by observation x[i], where sum is the
+// sum of the earlier observations, and returns its capital. Observations are
+// taken in blocks and rejected means are dropped from the working set after
+// each, across threads, so the cost per observation is proportional to the
+// width of the CS rather than to grid_size.
+template <class UpdateFn>
+void pruned_grid_cs(const double* x, const size_t n, const double* grid,
+                    const size_t grid_size, const int breaks,
+                    const double threshold, const double N, UpdateFn update,
+                    double* lower, double* upper, int num_threads=0);
+// For each null mean j < num_nulls, the number of observations after which
+// its capital process first exceeds threshold, written to times[j], or 0 if
+// it never does. update(j, i, sum) is as for pruned_grid_cs. Observations
+// are taken in blocks, and only the nulls not yet rejected are carried
+// through each block, across threads, so the scan stops once every null is
+// rejected.
+template <class UpdateFn>
+void grid_first_rejections(const double* x, const size_t n,
+                           const size_t num_nulls, const double threshold,
+                           UpdateFn update, size_t* times,
+                           int num_threads=0);
+
+// Confidence sequence for the mean by bisection on the null mean, assuming the
+// accepted means {m in [0, 1] : capital <= threshold} form an interval at each
+// time, with bets that do not otherwise depend on the mean. Each endpoint is
+// bracketed by an accepted and a rejected mean at most tolerance apart, and
+// the brackets are carried from one time to the next as BettingCapital
+// states, at O(1) cost per observation. Only when an observation moves an
+// endpoint out of its bracket are means re-evaluated from the start of the
+// stream, at O(t) cost each, galloping from the old bracket and bisecting.
+// lower[t] and upper[t] are the rejected ends of the brackets, or 0 and 1 at
+// edges where no mean beyond is rejected and where no mean is accepted at
+// resolution tolerance.
+void betting_cs_bisection(const double* x, const size_t n,
+                          const double* lambdas_positive,
+                          const double* lambdas_negative,
+                          const BettingOptions& options,
+                          const double threshold, const double tolerance,
+                          double* lower, double* upper);
+
+// grid_accepted_range for betting_capital_process over the null means
+// grid[0..grid_size), with bets that do not otherwise depend on the mean.
+// With log_space, log capital is compared with log(threshold).
+void betting_grid_accepted_range(const double* x, const size_t n,
+                                 const double* grid, const size_t grid_size,
+                                 const double* lambdas_positive,
+                                 const double* lambdas_negative,
+                                 const BettingOptions& options,
+                                 const double threshold, int* first_accepted,
+                                 int* last_accepted, const int num_threads=0);
+
+// For each null mean nulls[j], j < num_nulls, the number of observations of
+// x[0..n) after which its betting_capital_process first exceeds threshold,
+// when the sequential test of that mean rejects, or 0 if it never does.
+// Observations are taken in blocks, and only the nulls not yet rejected are
+// carried through each block, across threads, so the scan stops once every
+// null is rejected. With log_space, log capital is compared with
+// log(threshold).
+void betting_first_rejections(const double* x, const size_t n,
+                              const double* nulls, const size_t num_nulls,
+                              const double* lambdas_positive,
+                              const double* lambdas_negative,
+                              const BettingOptions& options,
+                              const double threshold, size_t* times,
+                              const int num_threads=0);
+
+// Betting strategies of betting_strategies.py, computed without calling back
+// into Python.
+enum class BettingStrategyKind {
+  PREDMIX_EB,      // lambda_predmix_eb
+  AKELLY,          // lambda_aKelly
+  LBOW,            // lambda_LBOW
+  FIXED_FRACTION,  // the constant bets of betting.dKelly_cs
+};
+
+// The kind named "predmix_eb", "aKelly", "LBOW" or "fixed_fraction". Throws
+// std::invalid_argument for other names.
+BettingStrategyKind betting_strategy_kind(const std::string& name);
+
+// Arguments of the strategy functions, each used only by the kinds that take
+// it. Defaults match betting_strategies.py.
+struct BettingStrategyParams {
+  BettingStrategyKind kind = BettingStrategyKind::PREDMIX_EB;
+  // lambda_predmix_eb; fixed_n = 0 scales bets like 1/sqrt(t log t). With
+  // fixed_horizon, fixed_n is the number of observations of each fixed-time
+  // interval, as lambda_predmix_eb(x, fixed_n=len(x)) in a betting_ci bets
+  // function.
+  double alpha = 0.05;
+  double truncation = std::numeric_limits<double>::infinity();
+  double fixed_n = 0;
+  bool fixed_horizon = false;
+  double scale = 1;
+  // Regularization of the running mean, for all kinds but FIXED_FRACTION,
+  // and of the running variance, for PREDMIX_EB and AKELLY.
+  double prior_mean = 0.5;
+  double prior_variance = 0.25;
+  double fake_obs = 1;
+  // lambda_aKelly
+  double trunc_scale = 1;
+  // FIXED_FRACTION bets fraction / mu on the positive capital process and
+  // fraction / (1 - mu) on the negative one, for the conditional mean mu.
+  double fraction = 0.5;
+};
+
+// Fields of the checkpoints written by the streaming classes' save().
+class CheckpointWriter;
+class CheckpointReader;
+
+// Running state of lambda_predmix_eb, from the regularized variance of the
+// observations so far.
+class PredmixBets {
+ public:
+  explicit PredmixBets(const BettingStrategyParams& params)
+      : params_(params), log_inverse_alpha_(log(1 / params.alpha)) {}
+
+  // Bet on the next observation.
+  double bet() const;
+  void add(const double x);
+
+  void save(CheckpointWriter& out) const;
+  void load(CheckpointReader& in);
+
+ private:
+  BettingStrategyParams params_;
+  double log_inverse_alpha_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double regularized_squares_ = 0;
+};
+
+// Running state of lambda_Kelly for one null mean m: after the observations
+// so far, the bet l solving sum_j (x_j - m) / (1 + l (x_j - m)) = 0, or
+// 1 / m or -1 / (1 - m) when every observation lies on one side of m. Each
+// update solves by safeguarded Newton, warm-started from the previous bet and
+// bracketed by the running minimum and maximum. Residuals are kept as
+// distinct values with counts while there are at most max_distinct of them,
+// so each update on discrete data costs O(max_distinct) rather than O(t).
+class KellyBets {
+ public:
+  explicit KellyBets(const double m, const size_t max_distinct=64)
+      : m_(m), max_distinct_(max_distinct) {}
+
+  // Bet on the next observation.
+  double bet() const { return bet_; }
+  void add(const double x);
+
+ private:
+  // f(l) = sum_j (x_j - m) / (1 + l (x_j - m)) and its derivative.
+  void kelly_condition(const double l, double* value, double* slope) const;
+  double solve(double lower, double upper, const double start) const;
+
+  double m_;
+  size_t max_distinct_;
+  size_t t_ = 0;
+  double min_ = std::numeric_limits<double>::infinity();
+  double max_ = -std::numeric_limits<double>::infinity();
+  double bet_ = 0;
+  // x_j - m for the observations so far, with multiplicities. Once there
+  // are more than max_distinct distinct residuals, each new one is appended
+  // with count 1.
+  std::vector<double> residuals_;
+  std::vector<double> counts_;
+};
+
+// lambda_Kelly(x[0..n), m), written to bets[0..n).
+void kelly_bets(const double* x, const size_t n, const double m,
+                double* bets);
+
+// Bets of one strategy on observations x[0..n), sampled without replacement
+// from a population of size N if N > 0. Prefix statistics that do not depend
+// on the null mean, such as the regularized mean and variance, are computed
+// once on construction, so one strategy serves a whole grid of means and may
+// be shared across threads.
+class BettingStrategy {
+ public:
+  BettingStrategy(const double* x, const size_t n,
+                  const BettingStrategyParams& params, const double N=0);
+
+  // Bet on observation i against the null mean m, on the negative capital
+  // process with negative.
+  double bet(const size_t i, const double m, const bool negative) const;
+
+  // Whether bets depend on the horizon, through fixed_horizon.
+  bool horizon_dependent() const {
+    return params_.kind == BettingStrategyKind::PREDMIX_EB
+        && params_.fixed_horizon;
+  }
+  // The strategy on x[0..horizon), with bets optimized for horizon if
+  // horizon_dependent(). Reuses the prefix statistics, so costs O(horizon)
+  // arithmetic.
+  BettingStrategy at_horizon(const size_t horizon) const;
+
+ private:
+  BettingStrategyParams params_;
+  double N_ = 0;
+  // Statistics of x[0..i) at index i: the sum, the regularized mean and
+  // variance, and the sum of squared deviations from the unregularized mean.
+  // Each is kept only for kinds that use it.
+  std::vector<double> sums_;
+  std::vector<double> means_;
+  std::vector<double> variances_;
+  std::vector<double> squared_deviations_;
+  // Bets that do not depend on the null mean.
+  std::vector<double> bets_;
+};
+
+// Running state of diversified_betting_capital_process for one null mean m,
+// taking O(1) time per strategy for each update. The strategies and weights
+// must outlive it.
+class DiversifiedBettingCapital {
+ public:
+  DiversifiedBettingCapital(
+      const double m, const std::vector<BettingStrategy>& strategies_positive,
+      const std::vector<BettingStrategy>& strategies_negative,
+      const std::vector<double>& weights, const BettingOptions& options);
+
+  // Bets on observation x at index i, where sum is the sum of the earlier
+  // observations, and returns the capital, or its log with log_space.
+  double update(const size_t i, const double x, const double sum);
+
+ private:
+  double m_;
+  const std::vector<BettingStrategy>* strategies_positive_;
+  const std::vector<BettingStrategy>* strategies_negative_;
+  BettingOptions options_;
+  double log_theta_;
+  double log_one_minus_theta_;
+  // Strategies with nonzero weight, with their weights, or log weights with
+  // log_space, and the bets and capital of all their positive and of all
+  // their negative processes in contiguous arrays.
+  ScratchVector<size_t> strategies_;
+  ScratchVector<double> weights_;
+  ScratchVector<double> lambdas_positive_;
+  ScratchVector<double> lambdas_negative_;
+  ScratchVector<double> positive_;
+  ScratchVector<double> negative_;
+  ScratchVector<SignedLogCapital> log_positive_;
+  ScratchVector<SignedLogCapital> log_negative_;
+};
+
+// betting.diversified_betting_mart against the null mean m with native
+// strategies: the weights-averaged positive and negative capital processes of
+// the strategies, combined as in BettingOptions. With log_space, strategies
+// are mixed by log-sum-exp.
+void diversified_betting_capital_process(
+    const double* x, const size_t n, const double m,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    double* capital);
+
+// grid_accepted_range for diversified_betting_capital_process over the null
+// means grid[0..grid_size). With log_space, log capital is compared with
+// log(threshold).
+void diversified_betting_grid_accepted_range(
+    const double* x, const size_t n, const double* grid,
+    const size_t grid_size,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, int* first_accepted, int* last_accepted,
+    const int num_threads=0);
+// As above for each of thresholds[0..num_thresholds), laid out as by the
+// multi-threshold grid_accepted_range, from one pass over the grid.
+void diversified_betting_grid_accepted_range(
+    const double* x, const size_t n, const double* grid,
+    const size_t grid_size,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double* thresholds, const size_t num_thresholds,
+    int* first_accepted, int* last_accepted, const int num_threads=0);
+
+// Streaming form of betting.hedged_cs. The log capital at each of the breaks
+// + 1 grid means and the running statistics of the predictable-mixture bets
+// are kept, so each observation costs O(breaks) regardless of how many came
+// before, and observations need not be kept.
+class HedgedConfidenceSequence {
+ public:
+  HedgedConfidenceSequence(const double alpha, const double N=0,
+                           const int breaks=1000,
+                           const bool running_intersection=true,
+                           const double theta=0.5,
+                           const double trunc_scale=0.5,
+                           const double prior_mean=0.5,
+                           const double prior_variance=0.25,
+                           const double fake_obs=1,
+                           const double max_weight=1);
+
+  // Adds observations x[0..n), which must lie in [0, max_weight], such as
+  // importance-weighted outcomes as in BettingOptions, and returns the
+  // updated interval. Throws std::invalid_argument, leaving the state
+  // unchanged, for observations outside [0, max_weight] or beyond the
+  // population size.
+  // Large batches are spread across threads by grid mean.
+  std::pair<double, double> update(const double* x, const size_t n);
+  // As update(x, n), also writing the interval after each observation to
+  // lower[0..n) and upper[0..n). Every grid mean takes each observation in
+  // turn and the accepted range is reduced as each time is reached, so no
+  // capital buffer is kept and nothing is allocated per observation.
+  std::pair<double, double> update(const double* x, const size_t n,
+                                   double* lower, double* upper);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+ private:
+  void check_observations(const double* x, const size_t n) const;
+  // The time-major update, on one thread, writing per-time intervals where
+  // lower and upper are not null.
+  void sweep(const double* x, const size_t n, double* lower, double* upper);
+  void record_interval(const int first_accepted, const int last_accepted,
+                       const size_t t, const double sum);
+
+  BettingOptions options_;
+  double N_;
+  int breaks_;
+  bool running_intersection_;
+  double log_threshold_;
+  // Per-stream state comes from the scratch free lists, so the streams of a
+  // batch reuse one another's memory.
+  ScratchVector<double> grid_;
+  ScratchVector<BettingCapital> capital_;
+  PredmixBets positive_bets_;
+  PredmixBets negative_bets_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+};
+
+// The grid of null means np.arange(0, 1 + 1 / breaks, step=1 / breaks) of
+// betting.cs_from_martingale.
+std::vector<double> betting_grid(const int breaks);
+// betting_grid(breaks) written to grid, reusing its memory.
+void betting_grid(const int breaks, ScratchVector<double>& grid);
+
+// Confidence interval at time t, after observations summing to sum, from the
+// first and last accepted indices into betting_grid(breaks), or -1 where none
+// is: widened by a grid step and clipped to the logical CS if N > 0, as
+// betting.cs_from_accepted_range does without running intersection.
+std::pair<double, double> grid_cs_interval(const double* grid,
+                                           const int breaks,
+                                           const int first_accepted,
+                                           const int last_accepted,
+                                           const double N, const size_t t,
+                                           const double sum);
+// The interval after t observations of the pruned_grid_cs over
+// grid[0..grid_size) = betting_grid(breaks) with N = 0, from the first
+// rejection times of its means as written by grid_first_rejections. As
+// rejected means are never readmitted, the whole history of the CS is held
+// in grid_size times, and the interval at any t is recovered in
+// O(grid_size).
+std::pair<double, double> first_rejection_interval(const double* grid,
+                                                   const size_t grid_size,
+                                                   const int breaks,
+                                                   const size_t* times,
+                                                   const size_t t);
+
+// betting.cs_from_accepted_range on x[0..n) in a single pass: the
+// grid_cs_interval at each time, intersected with the earlier ones if
+// running_intersection, written to lower[t] and upper[t]. The sum for the
+// logical CS is accumulated along the way rather than by a separate cumsum.
+void accepted_range_cs(const double* x, const size_t n,
+                       const double* grid, const int breaks,
+                       const int* first_accepted, const int* last_accepted,
+                       const double N, const bool running_intersection,
+                       double* lower, double* upper);
+
+// betting.intersect_cs in place on lower[0..n) and upper[0..n): the logical
+// CS of sampling x without replacement from a population of size N if N > 0,
+// then the running intersection if running_intersection.
+void intersect_cs(const double* x, const size_t n, const double N,
+                  const bool running_intersection, double* lower,
+                  double* upper);
+
+// The grid betting_cs on x[0..n) with bets that do not otherwise depend on
+// the mean: betting_grid_accepted_range over betting_grid(breaks) followed by
+// accepted_range_cs, with the conditional means of sampling without
+// replacement evaluated inside the capital processes.
+void betting_grid_cs(const double* x, const size_t n, const int breaks,
+                     const double* lambdas_positive,
+                     const double* lambdas_negative,
+                     const BettingOptions& options, const double threshold,
+                     const bool running_intersection, double* lower,
+                     double* upper, const int num_threads=0);
+
+// pruned_grid_cs over betting_grid(breaks) for betting_capital_process, with
+// bets that do not otherwise depend on the mean. With log_space, log capital
+// is compared with log(threshold).
+void betting_pruned_grid_cs(const double* x, const size_t n, const int breaks,
+                            const double* lambdas_positive,
+                            const double* lambdas_negative,
+                            const BettingOptions& options,
+                            const double threshold, double* lower,
+                            double* upper, const int num_threads=0);
+
+// betting_grid_cs for diversified_betting_capital_process with native
+// strategies.
+void diversified_betting_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, const bool running_intersection, double* lower,
+    double* upper, const int num_threads=0);
+// diversified_betting_grid_cs at each of thresholds[0..num_thresholds), such
+// as 1 / alpha for several levels, written to lower[k * n..(k + 1) * n) and
+// upper[k * n..(k + 1) * n) for thresholds[k]. The bets must not depend on
+// the threshold: the capital processes are computed once and compared with
+// every threshold.
+void diversified_betting_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double* thresholds, const size_t num_thresholds,
+    const bool running_intersection, double* lower, double* upper,
+    const int num_threads=0);
+
+// betting_pruned_grid_cs for diversified_betting_capital_process with native
+// strategies.
+void diversified_betting_pruned_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, double* lower, double* upper,
+    const int num_threads=0);
+// betting_first_rejections for diversified_betting_capital_process with
+// native strategies. Over nulls = betting_grid(breaks), times is the
+// O(breaks) form of diversified_betting_pruned_grid_cs with N = 0, read
+// back by first_rejection_interval.
+void diversified_betting_first_rejections(
+    const double* x, const size_t n, const double* nulls,
+    const size_t num_nulls,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, size_t* times, const int num_threads=0);
+
+// betting.betting_ci on x[0..n) with native strategies: the interval at time
+// n of the grid betting_cs with the given breaks, intersected over time if
+// running_intersection. threshold is as for
+// diversified_betting_grid_accepted_range. Grid means are advanced together
+// through blocks of observations, keeping only their current capital and the
+// running interval, so memory is O(breaks) rather than O(n * breaks) however
+// long x is.
+std::pair<double, double> diversified_betting_ci(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, const bool running_intersection,
+    int num_threads=0);
+
+// betting.betting_ci_seq: diversified_betting_ci on x[0..times[h]) for each
+// of num_times horizons, written to lower[h] and upper[h], with strategies on
+// x[0..max(times)). Unless a strategy is horizon_dependent(), the interval
+// of several horizons is read from a single confidence sequence over the
+// longest prefix, since predictable bets do not depend on later observations.
+// A single horizon, or several with horizon-dependent strategies, streams
+// through diversified_betting_ci; several horizons are split across threads,
+// sharing the strategies' prefix statistics.
+void diversified_betting_ci_sequence(
+    const double* x, const size_t* times, const size_t num_times,
+    const int breaks, const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, const bool running_intersection,
+    double* lower, double* upper, const int num_threads=0);
+
+//////////////////////////////////////////////////////////////////////
+// Confidence sequences for the mean of [0, 1]-bounded streams
+//////////////////////////////////////////////////////////////////////
+
+// Streaming form of predmix.predmix_empbern_cs, with the bets of
+// lambda_predmix_eb at level cs_side_alpha(side, alpha) (optimized for
+// fixed_n if positive).
+// Only running sums are kept, so memory is constant however many
+// observations are added, and intervals match the batch function's.
+class PredmixEmpBernAccumulator {
+ public:
+  explicit PredmixEmpBernAccumulator(const double alpha=0.05,
+                                     const double truncation=0.5,
+                                     const bool running_intersection=false,
+                                     const double fixed_n=0,
+                                     const CSSide side=CSSide::BOTH);
+
+  // Adds observations x[0..n) and returns the updated interval.
+  std::pair<double, double> update(const double* x, const size_t n);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+  // Writes a checkpoint of the full state, from which load() resumes with
+  // identical intervals. Throws std::runtime_error on malformed input.
+  void save(std::ostream& out) const;
+  static PredmixEmpBernAccumulator load(std::istream& in);
+
+ private:
+  bool running_intersection_;
+  CSSide side_;
+  double log_threshold_;
+  PredmixBets bets_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double psi_sum_ = 0;
+  double lambda_sum_ = 0;
+  double weighted_sum_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+};
+
+// Streaming form of predmix.predmix_hoeffding_cs, as
+// PredmixEmpBernAccumulator is of predmix_empbern_cs.
+class PredmixHoeffdingAccumulator {
+ public:
+  explicit PredmixHoeffdingAccumulator(const double alpha=0.05,
+                                       const bool running_intersection=false);
+
+  std::pair<double, double> update(const double* x, const size_t n);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+  // As PredmixEmpBernAccumulator::save() and load().
+  void save(std::ostream& out) const;
+  static PredmixHoeffdingAccumulator load(std::istream& in);
+
+ private:
+  bool running_intersection_;
+  double log_threshold_;
+  size_t t_ = 0;
+  double psi_sum_ = 0;
+  double lambda_sum_ = 0;
+  double weighted_sum_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+};
+
+// predmix.predmix_empbern_cs on x[0..n) in one pass.
+void predmix_empbern_cs(const double* x, const size_t n, const double alpha,
+                        const double truncation, const double fixed_n,
+                        const bool running_intersection, double* lower,
+                        double* upper, const CSSide side=CSSide::BOTH);
+
+// predmix.predmix_hoeffding_cs on x[0..n) in one pass.
+void predmix_hoeffding_cs(const double* x, const size_t n, const double alpha,
+                          const bool running_intersection, double* lower,
+                          double* upper);
+
+// Streaming form of conjmix_bounded.conjmix_empbern_cs. The gamma-exponential
+// mixture is built once, and each boundary solve is warm-started from the
+// previous root, as in GammaExponentialMixture::bound_sequence, so intervals
+// agree with the batch function.
+class ConjmixEmpBernAccumulator {
+ public:
+  explicit ConjmixEmpBernAccumulator(const double v_opt,
+                                     const double alpha=0.05,
+                                     const bool running_intersection=false,
+                                     const CSSide side=CSSide::BOTH);
+
+  std::pair<double, double> update(const double* x, const size_t n);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+  // As PredmixEmpBernAccumulator::save() and load().
+  void save(std::ostream& out) const;
+  static ConjmixEmpBernAccumulator load(std::istream& in);
+
+ private:
+  double v_opt_;
+  double alpha_;
+  bool running_intersection_;
+  CSSide side_;
+  double log_threshold_;
+  GammaExponentialMixture mixture_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double variance_ = 0;
+  double bound_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+};
+
+// Streaming form of predmix.predmix_empbern_cs_wor, for observations in
+// [lower_bd, upper_bd] sampled without replacement from a population of size
+// N. The finite-population corrections enter running sums, so memory is
+// constant and intervals match the batch function.
+class PredmixEmpBernWoRAccumulator {
+ public:
+  explicit PredmixEmpBernWoRAccumulator(
+      const double N, const double alpha=0.05, const double lower_bd=0,
+      const double upper_bd=1, const bool running_intersection=false);
+
+  // Adds observations x[0..n), bet on with lambdas[0..n) if given and the
+  // default bets of predmix_empbern_cs_wor otherwise, and returns the
+  // updated interval. Throws std::invalid_argument, leaving the state
+  // unchanged, for more than N observations in all.
+  std::pair<double, double> update(const double* x, const size_t n,
+                                   const double* lambdas=nullptr);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+  // As PredmixEmpBernAccumulator::save() and load().
+  void save(std::ostream& out) const;
+  static PredmixEmpBernWoRAccumulator load(std::istream& in);
+
+ private:
+  double N_;
+  double lower_bd_;
+  double upper_bd_;
+  bool running_intersection_;
+  double log_threshold_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double variance_ = 0;
+  double psi_sum_ = 0;
+  double lambda_sum_ = 0;
+  double weighted_sum_ = 0;
+  double lower_;
+  double upper_;
+};
+
+// Streaming form of predmix.predmix_hoeffding_cs_wor, as
+// PredmixEmpBernWoRAccumulator is of predmix_empbern_cs_wor.
+class PredmixHoeffdingWoRAccumulator {
+ public:
+  explicit PredmixHoeffdingWoRAccumulator(
+      const double N, const double alpha=0.05, const double lower_bd=0,
+      const double upper_bd=1, const bool running_intersection=false);
+
+  std::pair<double, double> update(const double* x, const size_t n,
+                                   const double* lambdas=nullptr);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+  // As PredmixEmpBernAccumulator::save() and load().
+  void save(std::ostream& out) const;
+  static PredmixHoeffdingWoRAccumulator load(std::istream& in);
+
+ private:
+  double N_;
+  double lower_bd_;
+  double upper_bd_;
+  bool running_intersection_;
+  double log_threshold_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double psi_sum_ = 0;
+  double lambda_sum_ = 0;
+  double weighted_sum_ = 0;
+  double lower_;
+  double upper_;
+};
+
+// predmix.predmix_empbern_cs_wor and predmix.predmix_hoeffding_cs_wor on
+// x[0..n) in one pass, with the default bets if lambdas is null.
+void predmix_empbern_cs_wor(const double* x, const size_t n, const double N,
+                            const double alpha, const double lower_bd,
+                            const double upper_bd,
+                            const bool running_intersection, double* lower,
+                            double* upper, const double* lambdas=nullptr);
+void predmix_hoeffding_cs_wor(const double* x, const size_t n, const double N,
+                              const double alpha, const double lower_bd,
+                              const double upper_bd,
+                              const bool running_intersection, double* lower,
+                              double* upper, const double* lambdas=nullptr);
+
+// Streaming form of conjmix_bounded.conjmix_hoeffding_cs. The boundary is
+// TwoSidedNormalMixture's closed form at v = t / 4, with rho and the
+// threshold fixed at construction.
+class ConjmixHoeffdingAccumulator {
+ public:
+  explicit ConjmixHoeffdingAccumulator(const double t_opt,
+                                       const double alpha=0.05,
+                                       const bool running_intersection=false);
+
+  std::pair<double, double> update(const double* x, const size_t n);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+  // As PredmixEmpBernAccumulator::save() and load().
+  void save(std::ostream& out) const;
+  static ConjmixHoeffdingAccumulator load(std::istream& in);
+
+  // The boundary on the mean after t observations.
+  double boundary(const double t) const {
+    return mixture_.bound(t / 4, log_threshold_) / t;
+  }
+
+ private:
+  double t_opt_;
+  double alpha_;
+  bool running_intersection_;
+  double log_threshold_;
+  TwoSidedNormalMixture mixture_;
+  size_t t_ = 0;
+  double sum_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+};
+
+// conjmix_bounded.conjmix_hoeffding_cs on x[0..n). The boundaries, which do
+// not depend on x, are filled in a branch-free loop before the running mean
+// is applied.
+void conjmix_hoeffding_cs(const double* x, const size_t n, const double t_opt,
+                          const double alpha, const bool running_intersection,
+                          double* lower, double* upper);
+
+// conjmix_bounded.conjmix_empbern_cs on x[0..n) in one pass.
+void conjmix_empbern_cs(const double* x, const size_t n, const double v_opt,
+                        const double alpha, const bool running_intersection,
+                        double* lower, double* upper,
+                        const CSSide side=CSSide::BOTH);
+
+// betting.hedged_cs on x[0..n) with default regularization, one observation
+// at a time through a HedgedConfidenceSequence. A one-sided side replaces
+// theta by cs_side_theta(side, theta).
+void hedged_cs(const double* x, const size_t n, const double alpha,
+               const double N, const int breaks,
+               const bool running_intersection, const double theta,
+               const double trunc_scale, double* lower, double* upper,
+               const CSSide side=CSSide::BOTH);
+
+// Confidence sequence kinds of batch_confidence_sequences.
+enum class StreamCSKind {
+  PREDMIX_EMPBERN,        // predmix_empbern_cs
+  PREDMIX_HOEFFDING,      // predmix_hoeffding_cs
+  PREDMIX_EMPBERN_WOR,    // predmix_empbern_cs_wor
+  PREDMIX_HOEFFDING_WOR,  // predmix_hoeffding_cs_wor
+  CONJMIX_HOEFFDING,      // conjmix_hoeffding_cs
+  CONJMIX_EMPBERN,        // conjmix_empbern_cs
+  HEDGED,                 // hedged_cs
+};
+
+// The kind named "predmix_empbern", "predmix_hoeffding",
+// "predmix_empbern_wor", "predmix_hoeffding_wor", "conjmix_hoeffding",
+// "conjmix_empbern" or "hedged". Throws std::invalid_argument for other
+// names.
+StreamCSKind stream_cs_kind(const std::string& name);
+
+// Arguments of the confidence sequence functions, each used only by the
+// kinds that take it.
+struct StreamCSParams {
+  StreamCSKind kind = StreamCSKind::PREDMIX_EMPBERN;
+  double alpha = 0.05;
+  bool running_intersection = false;
+  // PREDMIX_EMPBERN, CONJMIX_EMPBERN and HEDGED
+  CSSide side = CSSide::BOTH;
+  // PREDMIX_EMPBERN
+  double truncation = 0.5;
+  double fixed_n = 0;
+  // CONJMIX_HOEFFDING
+  double t_opt = 1;
+  // CONJMIX_EMPBERN
+  double v_opt = 1;
+  // PREDMIX_EMPBERN_WOR and PREDMIX_HOEFFDING_WOR
+  double lower_bd = 0;
+  double upper_bd = 1;
+  // HEDGED, PREDMIX_EMPBERN_WOR and PREDMIX_HOEFFDING_WOR; N = 0 samples
+  // with replacement, and population_sizes, if set, holds one N per stream.
+  double N = 0;
+  const double* population_sizes = nullptr;
+  // HEDGED
+  int breaks = 1000;
+  double theta = 0.5;
+  double trunc_scale = 0.5;
+};
+
+// Destination for the bounds of long streams, written in blocks as they are
+// computed, so that an engine writing to a sink holds one block of bounds
+// per thread however long its streams are. write() receives the intervals of
+// rows offset, ..., offset + n - 1 of the output, laid out as the arrays the
+// engine would otherwise fill. Blocks of one stream arrive in order, but
+// blocks of different streams may arrive from several threads at once.
+class BoundsSink {
+ public:
+  virtual ~BoundsSink() {}
+  virtual void write(const size_t offset, const double* lower,
+                     const double* upper, const size_t n) = 0;
+};
+
+// A sink passing each block to callback, one block at a time, so callback
+// need not be thread-safe. The arrays are valid only during the call.
+class CallbackBoundsSink : public BoundsSink {
+ public:
+  using Callback = std::function<void(size_t offset, const double* lower,
+                                      const double* upper, size_t n)>;
+
+  explicit CallbackBoundsSink(Callback callback)
+      : callback_(std::move(callback)) {}
+
+  void write(const size_t offset, const double* lower, const double* upper,
+             const size_t n) override;
+
+ private:
+  Callback callback_;
+  std::mutex mutex_;
+};
+
+// A sink into a binary file of num_rows rows, created at its full size, or
+// truncated to it, when the sink is constructed. The file holds a header,
+// then each row's lower and upper bound as native-endian doubles, 8-byte
+// aligned, so that it can be memory-mapped as a num_rows x 2 array, as
+// batch.read_bounds_file() does with numpy.memmap. Blocks are written in
+// place as they arrive, with positional writes where available, and nothing
+// is buffered beyond one block; rows never written read as zeros. Throws
+// std::runtime_error if the file cannot be created or written.
+class BoundsFileSink : public BoundsSink {
+ public:
+  BoundsFileSink(const std::string& path, const size_t num_rows);
+  ~BoundsFileSink();
+
+  // Throws std::invalid_argument for rows past num_rows.
+  void write(const size_t offset, const double* lower, const double* upper,
+             const size_t n) override;
+
+  size_t num_rows() const {
+    return num_rows_;
+  }
+
+ private:
+  void write_at(const size_t position, const char* data, const size_t size);
+
+  size_t num_rows_;
+#ifdef CONFSEQ_HAVE_MMAP
+  int fd_ = -1;
+#else
+  std::fstream file_;
+  std::mutex mutex_;
+#endif
+};
+
+namespace bounds_file_format {
+const char MAGIC[8] = {'C', 'S', 'B', 'O', 'U', 'N', 'D', '\0'};
+const uint32_t VERSION = 1;
+// Header: magic, version, 4 bytes of padding, num_rows.
+const size_t HEADER_SIZE = 24;
+};
+
+// Confidence sequences of one kind for num_streams independent streams held
+// back to back: stream s is values[offsets[s]..offsets[s + 1]), and its
+// bounds go to the same range of lower and upper. Streams are claimed by
+// threads as they finish earlier ones, so uneven lengths balance, and each
+// is computed in a single pass without temporaries beyond its own bounds.
+void batch_confidence_sequences(const double* values, const size_t* offsets,
+                                const size_t num_streams,
+                                const StreamCSParams& params, double* lower,
+                                double* upper, const int num_threads=0);
+// As above, writing the bounds to rows offsets[0], ..., offsets[num_streams]
+// - 1 of sink instead, in blocks of up to block_size per stream, so memory
+// stays bounded by num_threads blocks however long the streams are. Each
+// stream runs through an IntersectedConfidenceSequence of params alone,
+// giving the same intervals as above.
+void batch_confidence_sequences(const double* values, const size_t* offsets,
+                                const size_t num_streams,
+                                const StreamCSParams& params,
+                                BoundsSink& sink, const int num_threads=0,
+                                const size_t block_size=4096);
+
+// Observation counts at which to read out a sequence of n observations
+// geometrically, as the epochs of the stitched boundaries are spaced: each
+// distinct ceil(first * eta^k) below n, then n itself. Reading out only at
+// these times costs O(log(n) / log(eta)) boundary evaluations. Throws
+// std::invalid_argument unless eta > 1 and first > 0.
+std::vector<size_t> geometric_readout_times(const size_t n,
+                                            const double eta=2,
+                                            const size_t first=1);
+
+// The confidence sequence of kind params.kind on x[0..times[num_times - 1]),
+// read out only after times[i] observations into lower[i] and upper[i].
+// Every observation still enters the sufficient statistics, but
+// CONJMIX_EMPBERN, whose boundary is a root search, solves only at the
+// readouts, each warm-started from the one before, so n observations cost
+// O(n) flops and num_times solves; its running intersection runs over the
+// readouts. The other kinds have closed-form boundaries and intersect after
+// every observation, as in batch_confidence_sequences. population_sizes is
+// not used. Throws std::invalid_argument unless times increase from 1 or
+// more.
+void confidence_sequence_readouts(const double* x, const size_t* times,
+                                  const size_t num_times,
+                                  const StreamCSParams& params, double* lower,
+                                  double* upper);
+
+// For each stream of batch_confidence_sequences, the first time its
+// confidence sequence excludes the null mean, null_means[k] for stream k or
+// null_mean if null_means is null, with the bounds then. A stream stops at
+// its exclusion and keeps no bounds at other times. With
+// running_intersection an excluded mean stays excluded, so observations are
+// added in blocks of 64 and only the block holding the exclusion is replayed
+// one observation at a time. Streams run across threads.
+void cs_first_exclusions(const double* values, const size_t* offsets,
+                         const size_t num_streams,
+                         const StreamCSParams& params, const double null_mean,
+                         const double* null_means, FirstCrossing* out,
+                         const int num_threads=0);
+
+// The intersection of the confidence sequences of several kinds on one
+// stream, methods[k] giving the kind and arguments of the k-th; each keeps
+// its own alpha, so for the intersection to have level alpha the levels
+// must be split beforehand, e.g. alpha / num_methods each by Bonferroni.
+// Observations go through every method in blocks that stay in cache, each
+// block's bounds folded into the intersection as they are written, so the
+// stream is read once and no per-method bounds are kept. Intersecting
+// running intersections gives the running intersection of the
+// intersection, so with running_intersection each method just keeps its own
+// and nothing more is done. population_sizes is not used. Each method carries
+// its running sums, bets and grid of log capital between updates exactly, so
+// a stream may arrive in chunks of any sizes, such as the row groups of a
+// file too large for memory, and a single method's intervals are bit for bit
+// those of batch_confidence_sequences on the whole stream.
+class IntersectedConfidenceSequence {
+ public:
+  // Throws std::invalid_argument if num_methods is 0.
+  IntersectedConfidenceSequence(const StreamCSParams* methods,
+                                const size_t num_methods,
+                                const bool running_intersection=false);
+  ~IntersectedConfidenceSequence();
+
+  // Adds observations x[0..n) and returns the updated interval. Throws
+  // std::invalid_argument, leaving the state unchanged, for observations
+  // that any method rejects: outside [0, 1] for HEDGED or beyond a
+  // population size.
+  std::pair<double, double> update(const double* x, const size_t n);
+  // As update(x, n), also writing the interval after each observation to
+  // lower[0..n) and upper[0..n).
+  std::pair<double, double> update(const double* x, const size_t n,
+                                   double* lower, double* upper);
+  // As update(x, n, lower, upper), writing the intervals to rows first_row,
+  // ..., first_row + n - 1 of sink in blocks of up to block_size.
+  std::pair<double, double> update(const double* x, const size_t n,
+                                   BoundsSink& sink, const size_t first_row,
+                                   const size_t block_size=4096);
+
+  std::pair<double, double> interval() const {
+    return {lower_, upper_};
+  }
+  size_t num_observations() const {
+    return t_;
+  }
+
+ private:
+  class Method;
+  template <class Accumulator>
+  class AccumulatorMethod;
+
+  void check_observations(const double* x, const size_t n) const;
+
+  std::vector<StreamCSParams> params_;
+  std::vector<std::unique_ptr<Method>> methods_;
+  size_t t_ = 0;
+  double lower_ = 0;
+  double upper_ = 1;
+};
+
+// IntersectedConfidenceSequence on x[0..n), writing the interval after each
+// observation to lower[0..n) and upper[0..n).
+void intersected_cs(const double* x, const size_t n,
+                    const StreamCSParams* methods, const size_t num_methods,
+                    const bool running_intersection, double* lower,
+                    double* upper);
+// As above, writing the intervals to rows 0, ..., n - 1 of sink in blocks of
+// up to block_size.
+void intersected_cs(const double* x, const size_t n,
+                    const StreamCSParams* methods, const size_t num_methods,
+                    const bool running_intersection, BoundsSink& sink,
+                    const size_t block_size=4096);
+
+//////////////////////////////////////////////////////////////////////
+// Concurrent ingestion
+//////////////////////////////////////////////////////////////////////
+
+// Small index fixed for the life of the calling thread, distinct for the
+// first threads to ask, for spreading threads over shards.
+size_t ingestion_thread_slot();
+
+// K running sums added to from many threads at once and merged on read. Each
+// thread adds into one of num_shards shards, chosen by its
+// ingestion_thread_slot(), under a flag of that shard alone, so that threads
+// contend only when they outnumber the shards. The flag keeps the K sums of
+// one add() together, which separate atomics would not: a reader never sees
+// num_successes without its num_trials, or s without its v. Sums are
+// order-free sufficient statistics, so the merged result matches adding
+// everything from one thread. take() hands the sums added since the previous
+// take() to a single consumer, which applies them to a single-threaded
+// accumulator: (num_successes, num_trials) to
+// BernoulliConfidenceSequence::update, or increments of (S_t, V_t) for a
+// MixtureSupermartingale.
+template <size_t K>
+class ShardedSums {
+ public:
+  // num_shards = 0 uses twice the number of hardware threads.
+  explicit ShardedSums(size_t num_shards=0);
+
+  void add(const std::array<double, K>& values);
+  // Sums over all shards. Adds made concurrently may be partly included,
+  // though each add() is either all in or all out.
+  std::array<double, K> total() const;
+  // As total(), zeroing the sums.
+  std::array<double, K> take();
+
+  size_t num_shards() const { return num_shards_; }
+
+ private:
+  struct Shard {
+    mutable std::atomic<bool> busy{false};
+    std::array<double, K> sums{};
+    // Keeps neighbouring shards off one cache line.
+    char padding[64];
+  };
+
+  Shard& shard() { return shards_[ingestion_thread_slot() % num_shards_]; }
+  static void lock(const Shard& shard);
+  static void unlock(const Shard& shard) {
+    shard.busy.store(false, std::memory_order_release);
+  }
+
+  size_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+// Observations added from many threads at once, for accumulators whose
+// statistics depend on the order of the observations, such as the predictable
+// bets of PredmixEmpBernAccumulator and the running means of
+// ConjmixEmpBernAccumulator, and so cannot be summed per shard. Threads
+// append to shards as in ShardedSums, and drain() moves everything added so
+// far, each thread's observations in the order it added them, to a single
+// consumer that passes them to the accumulator's update().
+class ShardedObservations {
+ public:
+  explicit ShardedObservations(size_t num_shards=0);
+
+  void add(const double* x, const size_t n);
+  void add(const double x) { add(&x, 1); }
+  // Appends all observations added since the last drain() to out and
+  // returns how many there were.
+  size_t drain(std::vector<double>& out);
+
+ private:
+  struct Shard {
+    std::atomic<bool> busy{false};
+    std::vector<double> values;
+    char padding[64];
+  };
+
+  size_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+struct IngestionPipelineOptions {
+  // Events the queue holds before push() blocks its producer.
+  size_t queue_capacity = 1 << 16;
+  // A stream's pending events are applied once this many have accumulated.
+  size_t max_batch = 1024;
+  // Pending events are applied at most this long after the oldest arrived.
+  std::chrono::microseconds flush_interval{1000};
+  // Threads applying batches. 0 uses the number of hardware threads.
+  size_t num_workers = 0;
+};
+
+// Interval of one stream of an IngestionPipeline as of its latest applied
+// batch.
+struct StreamSnapshot {
+  double lower = 0;
+  double upper = 1;
+  size_t num_observations = 0;
+  // Observations in batches the accumulator rejected.
+  size_t num_rejected = 0;
+};
+
+// Front end that feeds small, irregular event batches from many producers to
+// one streaming accumulator per stream, such as HedgedConfidenceSequence or
+// PredmixEmpBernAccumulator, so that each update(x, n) call covers many
+// events. push() appends to a bounded queue, blocking while it is full, and
+// a dispatcher thread, its single consumer, coalesces events into pending
+// batches per stream. A stream's batch is applied once it reaches
+// max_batch events, or flush_interval after the oldest pending event
+// arrived, by one of num_workers worker threads. Stream j is always applied
+// by worker j % num_workers, so each accumulator is touched by one thread,
+// and each producer's events for a stream are applied in the order it
+// pushed them. After each batch the worker publishes the interval to one of
+// two snapshot slots and flips to it, and snapshot() reads the current slot,
+// retrying if a write lands mid-read, so readouts never block ingestion. A
+// batch the accumulator rejects with std::invalid_argument leaves the stream
+// unchanged and is counted in num_rejected.
+template <class Accumulator>
+class IngestionPipeline {
+ public:
+  IngestionPipeline(std::vector<Accumulator> streams,
+                    const IngestionPipelineOptions& options=
+                        IngestionPipelineOptions());
+  // Applies every pushed event, then stops the threads.
+  ~IngestionPipeline();
+
+  IngestionPipeline(const IngestionPipeline&) = delete;
+  IngestionPipeline& operator=(const IngestionPipeline&) = delete;
+
+  // Queues observations x[0..n) for stream. Throws std::out_of_range for an
+  // unknown stream.
+  void push(const size_t stream, const double* x, const size_t n);
+  void push(const size_t stream, const double x) { push(stream, &x, 1); }
+  // Applies every event pushed before the call, waiting until all are
+  // reflected in the snapshots.
+  void flush();
+
+  StreamSnapshot snapshot(const size_t stream) const;
+  size_t num_streams() const { return num_streams_; }
+
+ private:
+  struct Event {
+    size_t stream;
+    double value;
+  };
+  struct Batch {
+    size_t stream;
+    std::vector<double> values;
+  };
+  struct SnapshotSlot {
+    // Odd while the slot is being written.
+    std::atomic<uint64_t> version{0};
+    std::atomic<double> lower{0};
+    std::atomic<double> upper{1};
+    std::atomic<size_t> num_observations{0};
+    std::atomic<size_t> num_rejected{0};
+  };
+  struct Stream {
+    SnapshotSlot slots[2];
+    std::atomic<unsigned> current{0};
+    size_t num_rejected = 0;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<Batch> inbox;
+    bool stopping = false;
+    std::thread thread;
+  };
+
+  void dispatch_loop();
+  void work_loop(Worker& worker);
+  void publish(const size_t stream);
+
+  IngestionPipelineOptions options_;
+  size_t num_streams_;
+  std::vector<Accumulator> accumulators_;
+  std::unique_ptr<Stream[]> streams_;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_not_full_;
+  std::condition_variable queue_not_empty_;
+  std::vector<Event> queue_;
+  uint64_t num_pushed_ = 0;
+  bool flush_requested_ = false;
+  bool stopping_ = false;
+
+  std::mutex applied_mutex_;
+  std::condition_variable applied_changed_;
+  uint64_t num_applied_ = 0;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::thread dispatcher_;
+};
+
+// Running S_t and V_t of a mixture test, with the number of observations
+// behind them, as a value that shards of one stream can compute separately
+// and merge. The normal, gamma-exponential, gamma-Poisson and beta-binomial
+// mixtures depend on the data only through S_t and V_t, sums of
+// per-observation increments, so the merge of the shards' states is the state
+// of the pooled data. A central aggregator then evaluates one
+// MixtureSupermartingale or MixtureBoundary on it, rather than receiving the
+// raw observations. save() writes a 40-byte checkpoint suitable as a wire
+// format.
+class MixtureSufficientStatistics {
+ public:
+  MixtureSufficientStatistics() {}
+  // Throws std::invalid_argument if v < 0.
+  MixtureSufficientStatistics(const double s, const double v,
+                              const uint64_t num_observations);
+
+  // Adds the increments of num_observations observations. Throws
+  // std::invalid_argument if v_increment < 0.
+  void add(const double s_increment, const double v_increment,
+           const uint64_t num_observations=1);
+  // Adds n observations with the given increments.
+  void add(const double* s_increments, const double* v_increments,
+           const size_t n);
+  void merge(const MixtureSufficientStatistics& other);
+
+  double s() const { return s_; }
+  double v() const { return v_; }
+  uint64_t num_observations() const { return num_observations_; }
+
+  double log_superMG(const MixtureSupermartingale& mixture_superMG) const {
+    return mixture_superMG.log_superMG(s_, v_);
+  }
+  // min(1, 1 / the mixture supermartingale) at the merged (S_t, V_t).
+  double p_value(const MixtureSupermartingale& mixture_superMG) const;
+  double bound(const MixtureBoundary& boundary, const double alpha) const {
+    return boundary(v_, alpha);
+  }
+
+  // Throws std::runtime_error on malformed input.
+  void save(std::ostream& out) const;
+  static MixtureSufficientStatistics load(std::istream& in);
+
+ private:
+  double s_ = 0;
+  double v_ = 0;
+  uint64_t num_observations_ = 0;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Keyed state stores
+//////////////////////////////////////////////////////////////////////
+
+// Open-addressing hash table from uint64_t keys to small, trivially copyable
+// states, for monitoring millions of streams, one per user or entity, whose
+// states as separate objects would cost many times their size. Keys and
+// states are packed side by side in one array of a power-of-two number of
+// slots, probed linearly from a mixed hash of the key, which doubles when it
+// would pass 3/4 full, so a lookup usually touches one cache line. Key 0
+// marks empty slots, so its state is held beside the array. States are
+// value-initialized when their key is first inserted, and keys are never
+// removed.
+template <class State>
+class KeyedStateTable {
+ public:
+  struct Slot {
+    uint64_t key;
+    State state;
+  };
+
+  // Room for capacity keys without growing.
+  explicit KeyedStateTable(const size_t capacity=0);
+
+  // The returned reference is valid until the next insertion.
+  State& find_or_insert(const uint64_t key);
+  // nullptr for keys never inserted.
+  const State* find(const uint64_t key) const;
+
+  // Calls fn(key, state) for every key, in no particular order.
+  template <class Fn>
+  void for_each(Fn fn) const;
+
+  size_t size() const {
+    return size_ + (has_zero_key_ ? 1 : 0);
+  }
+  size_t memory_bytes() const {
+    return slots_.capacity() * sizeof(Slot);
+  }
+
+ private:
+  static uint64_t hash(const uint64_t key);
+  void grow();
+
+  std::vector<Slot> slots_;
+  size_t mask_;
+  size_t size_ = 0;
+  bool has_zero_key_ = false;
+  State zero_state_{};
+};
+
+// Per-key state of a KeyedBernoulliCS.
+struct KeyedBernoulliState {
+  uint32_t num_successes;
+  uint32_t num_trials;
+};
+
+// bernoulli_confidence_interval for the 0/1 observations of many keyed
+// streams, at 16 bytes per key. Intervals come from a BernoulliCSTable for
+// keys with at most n_max trials, and from bernoulli_confidence_interval
+// beyond it. Unlike BernoulliConfidenceSequence, no running intersection or
+// warm-start brackets are kept per key; each interval is the confidence
+// sequence's own interval at the key's counts.
+class KeyedBernoulliCS {
+ public:
+  // n_max = 0 builds no table.
+  KeyedBernoulliCS(const double alpha, const double t_opt,
+                   const double alpha_opt=0.05, const int n_max=0,
+                   const size_t capacity=0);
+  // Looks up table, whose alpha, t_opt and alpha_opt are used. Copies of
+  // the table, such as one from BernoulliCSTable::map_file(), share it.
+  explicit KeyedBernoulliCS(const BernoulliCSTable& table,
+                            const size_t capacity=0);
+
+  // Adds observation x[i] to the stream of keys[i], for i < n. Throws
+  // std::invalid_argument, leaving the store unchanged, unless every x[i] is
+  // 0 or 1, and std::overflow_error, with the observations before it added,
+  // if a key would pass INT_MAX observations.
+  void update(const uint64_t* keys, const double* x, const size_t n);
+  // Writes the interval of keys[i] to lower[i] and upper[i], for i < n; keys
+  // never updated get [0, 1].
+  void query(const uint64_t* keys, const size_t n, double* lower,
+             double* upper, const int num_threads=0) const;
+
+  std::pair<double, double> interval(const uint64_t key) const;
+  size_t num_observations(const uint64_t key) const;
+  size_t size() const {
+    return states_.size();
+  }
+  size_t memory_bytes() const {
+    return states_.memory_bytes();
+  }
+
+  // Checkpoints the parameters and every key's counts, so that a store can
+  // be spilled to disk and reloaded. The table is not written: load()
+  // rebuilds one of the same n_max.
+  void save(std::ostream& out) const;
+  static KeyedBernoulliCS load(std::istream& in);
+
+ private:
+  std::pair<double, double> interval(const KeyedBernoulliState& state) const;
+
+  double alpha_;
+  double t_opt_;
+  double alpha_opt_;
+  std::shared_ptr<const BernoulliCSTable> table_;
+  KeyedStateTable<KeyedBernoulliState> states_;
+};
+
+// Per-key state of a KeyedConjmixEmpBernCS. The sums are kept as doubles:
+// float sums would round the mean, and rounding V_t up in float to stay
+// conservative would add up to an ulp per observation.
+struct KeyedConjmixEmpBernState {
+  double sum;
+  double variance;
+  uint64_t num_observations;
+};
+
+// ConjmixEmpBernAccumulator for the observations in [0, 1] of many keyed
+// streams, at 32 bytes per key. Each key keeps the sum of its observations
+// and the V_t of conjmix_empbern_cs, and queries read the boundary at V_t
+// from one TabulatedBoundary in O(1), in place of the accumulator's
+// warm-started solve, so intervals agree with the accumulator's up to the
+// table's upper envelope and are never narrower. Running intersections are
+// not kept.
+class KeyedConjmixEmpBernCS {
+ public:
+  // Tabulates the boundary of GammaExponentialMixture(v_opt,
+  // cs_side_alpha(side, alpha), 1) at num_points values of V_t up to v_max,
+  // whose last chord extends beyond it.
+  KeyedConjmixEmpBernCS(const double v_opt, const double alpha=0.05,
+                        const CSSide side=CSSide::BOTH,
+                        const double v_max=1e7,
+                        const size_t num_points=1000,
+                        const size_t capacity=0);
+  // Looks up boundary, tabulated at level cs_side_alpha(side, alpha) for
+  // the confidence level alpha. Copies of the table, such as one from
+  // TabulatedBoundary::map_file(), share it.
+  explicit KeyedConjmixEmpBernCS(const TabulatedBoundary& boundary,
+                                 const CSSide side=CSSide::BOTH,
+                                 const size_t capacity=0);
+
+  // Adds observation x[i] to the stream of keys[i], for i < n. Throws
+  // std::invalid_argument, leaving the store unchanged, unless every x[i] is
+  // in [0, 1].
+  void update(const uint64_t* keys, const double* x, const size_t n);
+  // Writes the interval of keys[i] to lower[i] and upper[i], for i < n; keys
+  // never updated get [0, 1].
+  void query(const uint64_t* keys, const size_t n, double* lower,
+             double* upper, const int num_threads=0) const;
+
+  std::pair<double, double> interval(const uint64_t key) const;
+  size_t num_observations(const uint64_t key) const;
+  size_t size() const {
+    return states_.size();
+  }
+  size_t memory_bytes() const {
+    return states_.memory_bytes();
+  }
+  const TabulatedBoundary& boundary() const {
+    return boundary_;
+  }
+
+  // Checkpoints the side, every key's state and then the table, so that a
+  // store can be spilled to disk and reloaded.
+  void save(std::ostream& out) const;
+  static KeyedConjmixEmpBernCS load(std::istream& in);
+
+ private:
+  static TabulatedBoundary tabulate(const double v_opt, const double alpha,
+                                    const CSSide side, const double v_max,
+                                    const size_t num_points);
+  std::pair<double, double> interval(
+      const KeyedConjmixEmpBernState& state) const;
+
+  TabulatedBoundary boundary_;
+  CSSide side_;
+  KeyedStateTable<KeyedConjmixEmpBernState> states_;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Multi-granularity rollups
+//////////////////////////////////////////////////////////////////////
+
+// Confidence sequence kinds of RollupConfidenceSequences.
+enum class RollupCSKind {
+  BERNOULLI,          // bernoulli_confidence_interval
+  CONJMIX_HOEFFDING,  // conjmix_hoeffding_cs
+  PREDMIX_EMPBERN,    // predmix_empbern_cs
+};
+
+// The kind named "bernoulli", "conjmix_hoeffding" or "predmix_empbern".
+// Throws std::invalid_argument for other names.
+RollupCSKind rollup_cs_kind(const std::string& name);
+
+// Arguments of the rollup kinds, each used only by the kinds that take it.
+struct RollupCSParams {
+  RollupCSKind kind = RollupCSKind::BERNOULLI;
+  double alpha = 0.05;
+  // BERNOULLI and CONJMIX_HOEFFDING
+  double t_opt = 100;
+  // BERNOULLI
+  double alpha_opt = 0.05;
+  // PREDMIX_EMPBERN
+  double truncation = 0.5;
+  double fixed_n = 0;
+};
+
+// The interval of one closed bucket of a RollupConfidenceSequences.
+struct RollupReadout {
+  // The bucket's width, one of the grains, and its first timestamp.
+  int64_t grain;
+  int64_t start;
+  size_t num_observations;
+  double mean;
+  double lower;
+  double upper;
+};
+
+// Confidence sequences of one metric over the buckets of several reporting
+// grains at once, such as minutes, hours and days, from a single pass over
+// timestamped observations. Each bucket's interval is that of the kind on
+// the bucket's observations alone, and is read out when the first later
+// observation leaves the bucket, or on flush(). Grains nest, each a multiple
+// of the one before, so a bucket closes only with those it contains.
+//
+// BERNOULLI and CONJMIX_HOEFFDING depend on a bucket's observations only
+// through their sum and count, so only the finest bucket takes observations,
+// and each closing bucket adds its sums into the enclosing one. Their
+// boundaries depend on the count alone (with the successes, for BERNOULLI),
+// so buckets of different grains, or of one grain, with the same counts
+// share one boundary evaluation. PREDMIX_EMPBERN bets depend on the order of
+// the observations, so each grain's open bucket keeps a
+// PredmixEmpBernAccumulator that takes every observation.
+class RollupConfidenceSequences {
+ public:
+  // grains are bucket widths in the units of the timestamps, such as 60,
+  // 3600 and 86400 for timestamps in seconds. Throws std::invalid_argument
+  // unless they are positive and each is a multiple of the one before.
+  RollupConfidenceSequences(const RollupCSParams& params,
+                            std::vector<int64_t> grains);
+
+  // Adds observations x[0..n) at timestamps[0..n), which must not decrease,
+  // appending the readouts of the buckets they close to out, finest first
+  // for buckets closing together, and returns how many were appended.
+  // Throws std::invalid_argument, leaving the state unchanged, for
+  // decreasing timestamps or observations outside [0, 1], or other than 0
+  // or 1 for BERNOULLI.
+  size_t update(const int64_t* timestamps, const double* x, const size_t n,
+                std::vector<RollupReadout>& out);
+  // Closes every open bucket, appending its readout to out, and returns how
+  // many were appended.
+  size_t flush(std::vector<RollupReadout>& out);
+
+  const std::vector<int64_t>& grains() const {
+    return grains_;
+  }
+  // Boundaries evaluated so far, excluding those shared between buckets.
+  size_t num_boundary_evaluations() const {
+    return num_boundary_evaluations_;
+  }
+
+ private:
+  struct Bucket {
+    bool open = false;
+    int64_t start = 0;
+    size_t num_observations = 0;
+    double sum = 0;
+  };
+
+  static int64_t bucket_start(const int64_t timestamp, const int64_t grain);
+  void close(const size_t level, std::vector<RollupReadout>& out);
+  std::pair<double, double> interval(const size_t level);
+
+  RollupCSParams params_;
+  std::vector<int64_t> grains_;
+  std::vector<Bucket> buckets_;
+  // PREDMIX_EMPBERN: the open bucket's accumulator, per grain.
+  std::vector<PredmixEmpBernAccumulator> accumulators_;
+  ConjmixHoeffdingAccumulator hoeffding_;
+  bool has_timestamp_ = false;
+  int64_t last_timestamp_ = 0;
+  // Boundaries by count, and BERNOULLI intervals by (successes, count).
+  std::map<size_t, double> hoeffding_boundaries_;
+  std::map<std::pair<size_t, size_t>, std::pair<double, double>>
+      bernoulli_intervals_;
+  size_t num_boundary_evaluations_ = 0;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Monte Carlo validation of crossing probabilities
+//////////////////////////////////////////////////////////////////////
+
+// Philox4x32-10 counter-based generator (Salmon et al., 2011). Its output is
+// a pure function of the seed, the stream and the position within the stream,
+// so replicate r of a simulation, drawn from stream r, is the same however
+// replicates are spread across threads. Satisfies UniformRandomBitGenerator.
+class CounterRng {
+ public:
+  typedef uint64_t result_type;
+
+  CounterRng(const uint64_t seed, const uint64_t stream);
+
+  static constexpr result_type min() {
+    return 0;
+  }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+  result_type operator()();
+
+  // Uniform on (0, 1), with 53 random bits.
+  double uniform();
+  // Standard normal, by the Box-Muller transform.
+  double normal();
+
+  // The four words of the Philox4x32-10 block for this counter and key.
+  static std::array<uint32_t, 4> philox(std::array<uint32_t, 4> counter,
+                                        std::array<uint32_t, 2> key);
+
+ private:
+  std::array<uint32_t, 2> key_;
+  // Block index in the first two words, stream in the last two.
+  std::array<uint32_t, 4> counter_;
+  std::array<uint32_t, 4> block_;
+  int next_word_ = 4;
+  bool has_spare_normal_ = false;
+  double spare_normal_ = 0;
+};
+
+// Distribution of the i.i.d. observations of simulated streams.
+class SimulatedData {
+ public:
+  // 1 with probability p, otherwise 0.
+  static SimulatedData bernoulli(const double p);
+  static SimulatedData uniform(const double low, const double high);
+  static SimulatedData gaussian(const double mean, const double sd);
+  // Draws from a copy of values[0..n), with replacement for resample() and
+  // without for permutation(), under which streams end after n observations.
+  // Means and variances are those of the n values.
+  static SimulatedData resample(const double* values, const size_t n);
+  static SimulatedData permutation(const double* values, const size_t n);
+
+  double mean() const {
+    return mean_;
+  }
+  double variance() const {
+    return variance_;
+  }
+  bool without_replacement() const {
+    return kind_ == Kind::PERMUTATION;
+  }
+  // The population size under permutation(), otherwise unlimited.
+  size_t max_length() const;
+
+ private:
+  friend class SimulatedStream;
+
+  enum class Kind { BERNOULLI, UNIFORM, GAUSSIAN, RESAMPLE, PERMUTATION };
+
+  SimulatedData(const Kind kind, const double a, const double b,
+                const double mean, const double variance)
+      : kind_(kind), a_(a), b_(b), mean_(mean), variance_(variance) {}
+  static SimulatedData from_values(const Kind kind, const double* values,
+                                   const size_t n);
+
+  Kind kind_;
+  double a_;
+  double b_;
+  double mean_;
+  double variance_;
+  std::shared_ptr<const std::vector<double>> values_;
+};
+
+// Observations of one replicate of a SimulatedData, drawn from stream
+// replicate of a CounterRng seeded with seed.
+class SimulatedStream {
+ public:
+  SimulatedStream(const SimulatedData& data, const uint64_t seed,
+                  const uint64_t replicate);
+
+  double next();
+
+ private:
+  const SimulatedData& data_;
+  CounterRng rng_;
+  // Under permutation(), the undrawn values are population_[drawn_..).
+  std::vector<double> population_;
+  size_t drawn_ = 0;
+};
+
+struct CrossingSimulationResult {
+  size_t replicates = 0;
+  size_t crossings = 0;
+  // For each replicate, the number of observations at its first crossing,
+  // or 0 if it stayed within the boundary up to the horizon.
+  std::vector<size_t> crossing_times;
+
+  double crossing_fraction() const {
+    return replicates == 0 ? std::numeric_limits<double>::quiet_NaN()
+        : double(crossings) / replicates;
+  }
+  // Monte Carlo standard error of crossing_fraction().
+  double standard_error() const {
+    const double p = crossing_fraction();
+    return sqrt(p * (1 - p) / replicates);
+  }
+};
+
+// Simulates replicates independent streams of up to horizon observations from
+// data, spread across threads. make_monitor() is called once per replicate
+// and returns a callable that takes each observation in turn and returns true
+// once the stream has crossed its boundary, which ends the replicate.
+template <class MakeMonitor>
+CrossingSimulationResult simulate_crossings(const SimulatedData& data,
+                                            const size_t horizon,
+                                            const size_t replicates,
+                                            const uint64_t seed,
+                                            MakeMonitor make_monitor,
+                                            const int num_threads=0);
+
+// misc.superMG_crossing_fraction natively: the fraction of replicates whose
+// mixture supermartingale reaches 1 / alpha, with S_t the sum of the centered
+// observations and V_t = t * v_per_observation, e.g. the variance for normal
+// mixtures or g * h for beta-binomial ones.
+CrossingSimulationResult simulate_mixture_crossings(
+    const MixtureSupermartingale& mixture, const SimulatedData& data,
+    const double alpha, const double v_per_observation, const size_t horizon,
+    const size_t replicates, const uint64_t seed=0, const int num_threads=0);
+
+// As simulate_mixture_crossings for a uniform boundary v -> boundary(v),
+// crossed where S_t, or |S_t| if two_sided, exceeds it. V_t does not depend on
+// the observations, so the boundary is evaluated once per time, across
+// threads, before the replicates run.
+CrossingSimulationResult simulate_boundary_crossings(
+    const std::function<double(double)>& boundary, const SimulatedData& data,
+    const double v_per_observation, const size_t horizon,
+    const size_t replicates, const bool two_sided=false,
+    const uint64_t seed=0, const int num_threads=0);
+
+// The fraction of replicates at which a confidence sequence of params.kind
+// ever excludes data.mean(), updated one observation at a time through its
+// streaming accumulator. Under data.permutation(), the population size
+// replaces params.N; the sampling-without-replacement kinds throw
+// std::invalid_argument for other data.
+CrossingSimulationResult simulate_cs_miscoverage(
+    const StreamCSParams& params, const SimulatedData& data,
+    const size_t horizon, const size_t replicates, const uint64_t seed=0,
+    const int num_threads=0);
+
+//////////////////////////////////////////////////////////////////////
+// Implementation
+//////////////////////////////////////////////////////////////////////
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE SolverCounters& solver_counters() {
+  thread_local SolverCounters counters;
+  return counters;
+}
+
+CONFSEQ_INLINE void reset_solver_counters() {
+  solver_counters() = SolverCounters();
+}
+
+CONFSEQ_INLINE SolveBudgetScope*& active_solve_budget() {
+  thread_local SolveBudgetScope* scope = nullptr;
+  return scope;
+}
+
+CONFSEQ_INLINE SolveBudgetScope::SolveBudgetScope(const SolveBudget& budget)
+    : budget_(budget), outer_(active_solve_budget()) {
+  active_solve_budget() = this;
+}
+
+CONFSEQ_INLINE SolveBudgetScope::~SolveBudgetScope() {
+  active_solve_budget() = outer_;
+}
+
+CONFSEQ_INLINE bool solve_budget_exhausted() {
+  SolveBudgetScope* scope = active_solve_budget();
+  if (!scope) {
+    return false;
+  }
+  const SolveBudget& budget = scope->budget_;
+  const bool exhausted =
+      (budget.max_evaluations > 0
+       && scope->evaluations_ >= budget.max_evaluations)
+      || (budget.deadline != std::chrono::steady_clock::time_point()
+          && std::chrono::steady_clock::now() >= budget.deadline);
+  if (exhausted) {
+    scope->truncations_++;
+  } else {
+    scope->evaluations_++;
+  }
+  return exhausted;
+}
+
+CONFSEQ_INLINE uint64_t solve_budget_truncations() {
+  const SolveBudgetScope* scope = active_solve_budget();
+  return scope ? scope->truncations_ : 0;
+}
+
+// Counts one solve for its lifetime, recording the evaluations made meanwhile.
+class SolveCounter {
+ public:
+  SolveCounter()
+      : start_evaluations_(solver_counters().objective_evaluations) {
+    solver_counters().solves++;
+  }
+
+  ~SolveCounter() {
+    SolverCounters& counters = solver_counters();
+    counters.max_evaluations_per_solve = std::max(
+        counters.max_evaluations_per_solve,
+        counters.objective_evaluations - start_evaluations_);
+  }
+
+ private:
+  const uint64_t start_evaluations_;
+};
+
+CONFSEQ_INLINE std::vector<int> parse_cpu_list(const std::string& list) {
+  auto parse_cpu = [&list](const std::string& text) {
+    if (text.empty() || text.size() > 9
+        || text.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::invalid_argument("Malformed CPU list: " + list);
+    }
+    return std::stoi(text);
+  };
+  std::vector<int> cpus;
+  const std::string trimmed = list.substr(
+      0, list.find_last_not_of(" \n") + 1);
+  for (size_t begin = 0; begin < trimmed.size();) {
+    size_t end = trimmed.find(',', begin);
+    if (end == std::string::npos) {
+      end = trimmed.size();
+    }
+    const std::string item = trimmed.substr(begin, end - begin);
+    const size_t dash = item.find('-');
+    const int first = parse_cpu(item.substr(0, dash));
+    const int last = dash == std::string::npos ? first
+        : parse_cpu(item.substr(dash + 1));
+    if (last < first) {
+      throw std::invalid_argument("Malformed CPU list: " + list);
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+    begin = end + 1;
+  }
+  return cpus;
+}
+
+CONFSEQ_INLINE NumaTopology read_numa_topology() {
+  NumaTopology topology;
+#ifdef CONFSEQ_HAVE_SCHED_AFFINITY
+  const char* setting = std::getenv("CONFSEQ_NUMA");
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string nodes;
+  if (!(setting != nullptr && std::string(setting) == "0")
+      && sched_getaffinity(0, sizeof(allowed), &allowed) == 0
+      && std::getline(online, nodes)) {
+    try {
+      for (const int node : parse_cpu_list(nodes)) {
+        std::ifstream file("/sys/devices/system/node/node"
+                           + std::to_string(node) + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (const int cpu : parse_cpu_list(list)) {
+          if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+            cpus.push_back(cpu);
+          }
+        }
+        if (!cpus.empty()) {
+          topology.node_cpus.push_back(cpus);
+        }
+      }
+    } catch (const std::invalid_argument&) {
+      topology.node_cpus.clear();
+    }
+  }
+#endif
+  if (topology.num_nodes() <= 1) {
+    topology.node_cpus.assign(1, std::vector<int>());
+  }
+  return topology;
+}
+
+CONFSEQ_INLINE const NumaTopology& numa_topology() {
+  static const NumaTopology topology = read_numa_topology();
+  return topology;
+}
+
+// Node of the pool worker running on this thread, or -1 on other threads.
+CONFSEQ_INLINE int& thread_pool_node() {
+  static thread_local int node = -1;
+  return node;
+}
+
+CONFSEQ_INLINE ThreadPool::ThreadPool(const int num_workers)
+    : ThreadPool(num_workers, numa_topology()) {}
+
+CONFSEQ_INLINE ThreadPool::ThreadPool(const int num_workers,
+                                      const NumaTopology& topology)
+    : num_nodes_(std::max<size_t>(1, topology.num_nodes())) {
+  for (size_t node = 0; node < topology.num_nodes(); node++) {
+    for (const int cpu : topology.node_cpus[node]) {
+      if (cpu >= int(cpu_nodes_.size())) {
+        cpu_nodes_.resize(cpu + 1, -1);
+      }
+      if (cpu_nodes_[cpu] < 0) {
+        cpu_nodes_[cpu] = int(node);
+      }
+    }
+  }
+  // Thread 0 is the caller and thread i > 0 is worker i - 1, spread over the
+  // nodes in contiguous blocks.
+  const size_t num_threads = num_workers + 1;
+  for (int i = 0; i < num_workers; i++) {
+    const size_t node = (i + 1) * num_nodes_ / num_threads;
+    const std::vector<int> cpus = num_nodes_ > 1 ? topology.node_cpus[node]
+        : std::vector<int>();
+    workers_.emplace_back([this, node, cpus]() { work(node, cpus); });
+  }
+}
+
+CONFSEQ_INLINE ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  available_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+CONFSEQ_INLINE void ThreadPool::run_tasks(Job& job, const size_t node) {
+  for (size_t r = 0; r < job.num_ranges; r++) {
+    TaskRange& range = job.ranges[(node + r) % job.num_ranges];
+    for (size_t k = range.next++; k < range.end; k = range.next++) {
+      if (!job.failed) {
+        try {
+          (*job.task)(k);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(job.mutex);
+          if (!job.error) {
+            job.error = std::current_exception();
+          }
+          job.failed = true;
+        }
+      }
+      if (++job.finished_tasks == job.num_tasks) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished.notify_all();
+      }
+    }
+  }
+}
+
+CONFSEQ_INLINE size_t ThreadPool::current_node() const {
+  if (num_nodes_ == 1) {
+    return 0;
+  }
+  if (thread_pool_node() >= 0) {
+    return size_t(thread_pool_node()) % num_nodes_;
+  }
+#ifdef CONFSEQ_HAVE_SCHED_AFFINITY
+  const int cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < int(cpu_nodes_.size()) && cpu_nodes_[cpu] >= 0) {
+    return size_t(cpu_nodes_[cpu]);
+  }
+#endif
+  return 0;
+}
+
+CONFSEQ_INLINE void ThreadPool::work(const size_t node,
+                                     const std::vector<int>& cpus) {
+  thread_pool_node() = int(node);
+#ifdef CONFSEQ_HAVE_SCHED_AFFINITY
+  if (!cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    // A worker that cannot be pinned still runs, only without locality.
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#else
+  (void)cpus;
+#endif
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      available_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      job = jobs_.front();
+      if (--job->helpers_wanted == 0) {
+        jobs_.pop_front();
+      }
+    }
+    run_tasks(*job, node);
+  }
+}
+
+CONFSEQ_INLINE void ThreadPool::run(const size_t num_tasks,
+                                    const std::function<void(size_t)>& task,
+                                    const int max_helpers) {
+  if (num_tasks == 0) {
+    return;
+  }
+  auto job = std::make_shared<Job>();
+  job->task = &task;
+  job->num_tasks = num_tasks;
+  const int helpers = int(std::min<size_t>(
+      {size_t(std::max(0, max_helpers)), workers_.size(), num_tasks - 1}));
+  job->helpers_wanted = helpers;
+  // One range per node that can take part.
+  job->num_ranges = std::min<size_t>({num_nodes_, num_tasks,
+                                      size_t(helpers) + 1});
+  job->ranges.reset(new TaskRange[job->num_ranges]());
+  for (size_t r = 0; r < job->num_ranges; r++) {
+    job->ranges[r].next = num_tasks * r / job->num_ranges;
+    job->ranges[r].end = num_tasks * (r + 1) / job->num_ranges;
+  }
+  if (helpers > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(job);
+    }
+    if (helpers == 1) {
+      available_.notify_one();
+    } else {
+      available_.notify_all();
+    }
+  }
+  run_tasks(*job, current_node());
+  if (helpers > 0) {
+    // Every task is claimed, so workers still to take the job would find
+    // nothing to do.
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto queued = std::find(jobs_.begin(), jobs_.end(), job);
+    if (queued != jobs_.end()) {
+      jobs_.erase(queued);
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() {
+      return job->finished_tasks == job->num_tasks;
+    });
+  }
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+}
+
+CONFSEQ_INLINE std::atomic<int>& num_threads_setting() {
+  static std::atomic<int> num_threads(
+      std::max(1u, std::thread::hardware_concurrency()));
+  return num_threads;
+}
+
+CONFSEQ_INLINE std::unique_ptr<ThreadPool>& thread_pool_setting() {
+  static std::unique_ptr<ThreadPool> pool(
+      new ThreadPool(num_threads_setting() - 1));
+  return pool;
+}
+
+CONFSEQ_INLINE int get_num_threads() {
+  return num_threads_setting().load(std::memory_order_relaxed);
+}
+
+CONFSEQ_INLINE void set_num_threads(const int num_threads) {
+  assert(num_threads >= 1);
+  // Serializes setters, which replace the pool.
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (num_threads != get_num_threads()) {
+    thread_pool_setting().reset(new ThreadPool(num_threads - 1));
+    num_threads_setting().store(num_threads, std::memory_order_relaxed);
+  }
+}
+
+CONFSEQ_INLINE ThreadPool& thread_pool() {
+  return *thread_pool_setting();
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class Fn>
+void parallel_for(const size_t n, Fn fn, int num_threads,
+                  const size_t min_chunk_size) {
+  if (num_threads <= 0) {
+    num_threads = get_num_threads();
+  }
+  const size_t max_chunks = std::max<size_t>(
+      1, n / std::max<size_t>(1, min_chunk_size));
+  const size_t num_chunks = std::min<size_t>(num_threads, max_chunks);
+  if (num_chunks <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  const size_t chunks_per_thread = 4;
+  const size_t num_tasks = std::min(max_chunks, chunks_per_thread * num_chunks);
+  const std::function<void(size_t)> task = [n, num_tasks, &fn](
+      const size_t k) {
+    const size_t end = n * (k + 1) / num_tasks;
+    for (size_t i = n * k / num_tasks; i < end; i++) {
+      fn(i);
+    }
+  };
+  thread_pool().run(num_tasks, task, num_chunks - 1);
+}
+
+template <class RandomIt>
+void parallel_sort(RandomIt first, RandomIt last, int num_threads,
+                   const size_t min_chunk_size) {
+  if (num_threads <= 0) {
+    num_threads = get_num_threads();
+  }
+  const size_t n = last - first;
+  const size_t num_chunks = std::min<size_t>(
+      num_threads, std::max<size_t>(1, n / std::max<size_t>(1, min_chunk_size)));
+  if (num_chunks <= 1) {
+    std::sort(first, last);
+    return;
+  }
+  auto chunk_begin = [first, n, num_chunks](const size_t chunk) {
+    return first + n * std::min(chunk, num_chunks) / num_chunks;
+  };
+  parallel_for(num_chunks, [&chunk_begin](const size_t chunk) {
+    std::sort(chunk_begin(chunk), chunk_begin(chunk + 1));
+  }, num_chunks, 1);
+  for (size_t width = 1; width < num_chunks; width *= 2) {
+    const size_t num_merges = (num_chunks + 2 * width - 1) / (2 * width);
+    parallel_for(num_merges, [&chunk_begin, width](const size_t merge) {
+      const size_t chunk = 2 * width * merge;
+      std::inplace_merge(chunk_begin(chunk), chunk_begin(chunk + width),
+                         chunk_begin(chunk + 2 * width));
+    }, num_merges, 1);
+  }
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+struct ScratchCounters {
+  std::atomic<size_t> high_water{0};
+  std::atomic<size_t> reserved{0};
+  std::atomic<uint64_t> heap_allocations{0};
+  // Bumped by reset_scratch_arena_stats(), so arenas restart their own
+  // high-water marks.
+  std::atomic<uint64_t> epoch{0};
+};
+
+CONFSEQ_INLINE ScratchCounters& scratch_counters() {
+  static ScratchCounters counters;
+  return counters;
+}
+
+// Set once the thread's arena starts being destroyed. A bool has no
+// destructor, so it can still be read by later thread_local destructors.
+CONFSEQ_INLINE bool& scratch_arena_destroyed() {
+  static thread_local bool destroyed = false;
+  return destroyed;
+}
+
+struct LocalScratchArena {
+  ~LocalScratchArena() {
+    scratch_arena_destroyed() = true;
+  }
+
+  ScratchArena arena;
+};
+
+// Index k of the free list of 2^k-byte blocks that holds bytes, at least a
+// cache line.
+CONFSEQ_INLINE size_t scratch_size_class(const size_t bytes) {
+  size_t k = 6;
+  while (k < 63 && (size_t(1) << k) < bytes) {
+    k++;
+  }
+  return k;
+}
+
+CONFSEQ_INLINE ScratchArena::~ScratchArena() {
+  ScratchCounters& counters = scratch_counters();
+  for (size_t k = 0; k < free_lists_.size(); k++) {
+    for (void* block : free_lists_[k]) {
+      ::operator delete(block);
+    }
+  }
+  counters.reserved -= free_bytes_;
+  for (const Block& block : blocks_) {
+    counters.reserved -= block.size + 63;
+  }
+}
+
+CONFSEQ_INLINE ScratchArena* ScratchArena::local() {
+  if (scratch_arena_destroyed()) {
+    return nullptr;
+  }
+  static thread_local LocalScratchArena thread_arena;
+  return &thread_arena.arena;
+}
+
+CONFSEQ_INLINE void ScratchArena::add_block(const size_t position,
+                                            const size_t size) {
+  Block block;
+  block.memory.reset(new char[size + 63]);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(block.memory.get());
+  block.data = block.memory.get() + (64 - address % 64) % 64;
+  block.size = size;
+  blocks_.insert(blocks_.begin() + position, std::move(block));
+  ScratchCounters& counters = scratch_counters();
+  counters.reserved += size + 63;
+  counters.heap_allocations++;
+}
+
+CONFSEQ_INLINE void* ScratchArena::allocate(const size_t bytes) {
+  const size_t size = (std::max<size_t>(bytes, 1) + 63) / 64 * 64;
+  if (top_.block < blocks_.size()
+      && top_.offset + size > blocks_[top_.block].size) {
+    top_.block++;
+    top_.offset = 0;
+  }
+  if (top_.block == blocks_.size() || blocks_[top_.block].size < size) {
+    // Blocks grow geometrically, so a thread's scratch settles after a few
+    // calls and into one block once rewound.
+    const size_t last = blocks_.empty() ? 0 : blocks_.back().size;
+    add_block(top_.block,
+              std::max(size, std::max<size_t>(size_t(1) << 16, 2 * last)));
+    top_.offset = 0;
+  }
+  void* memory = blocks_[top_.block].data + top_.offset;
+  top_.offset += size;
+  top_.in_use += size;
+  ScratchCounters& counters = scratch_counters();
+  const uint64_t epoch = counters.epoch.load(std::memory_order_relaxed);
+  if (epoch != stats_epoch_) {
+    stats_epoch_ = epoch;
+    high_water_ = 0;
+  }
+  if (top_.in_use > high_water_) {
+    high_water_ = top_.in_use;
+    size_t high_water = counters.high_water.load(std::memory_order_relaxed);
+    while (high_water < high_water_
+           && !counters.high_water.compare_exchange_weak(high_water,
+                                                         high_water_)) {
+    }
+  }
+  return memory;
+}
+
+CONFSEQ_INLINE void ScratchArena::rewind(const Mark& mark) {
+  top_ = mark;
+  if (mark.in_use == 0 && blocks_.size() > 1) {
+    // Nothing is live, so the blocks are merged into one that fits them all.
+    size_t total = 0;
+    for (const Block& block : blocks_) {
+      total += block.size;
+      scratch_counters().reserved -= block.size + 63;
+    }
+    blocks_.clear();
+    add_block(0, total);
+  }
+}
+
+CONFSEQ_INLINE void* ScratchArena::acquire(const size_t bytes) {
+  const size_t k = scratch_size_class(bytes);
+  ScratchArena* arena = local();
+  if (arena != nullptr && !arena->free_lists_[k].empty()) {
+    void* block = arena->free_lists_[k].back();
+    arena->free_lists_[k].pop_back();
+    arena->free_bytes_ -= size_t(1) << k;
+    return block;
+  }
+  ScratchCounters& counters = scratch_counters();
+  counters.reserved += size_t(1) << k;
+  counters.heap_allocations++;
+  return ::operator new(size_t(1) << k);
+}
+
+CONFSEQ_INLINE void ScratchArena::release(void* block, const size_t bytes) {
+  if (block == nullptr) {
+    return;
+  }
+  // Free lists keep at most this many bytes per thread.
+  const size_t max_free_bytes = size_t(1) << 26;
+  const size_t k = scratch_size_class(bytes);
+  ScratchArena* arena = local();
+  if (arena != nullptr
+      && arena->free_bytes_ + (size_t(1) << k) <= max_free_bytes) {
+    arena->free_lists_[k].push_back(block);
+    arena->free_bytes_ += size_t(1) << k;
+    return;
+  }
+  scratch_counters().reserved -= size_t(1) << k;
+  ::operator delete(block);
+}
+
+CONFSEQ_INLINE ScratchScope::ScratchScope() : arena_(ScratchArena::local()) {
+  if (arena_ == nullptr) {
+    owned_.reset(new ScratchArena);
+    arena_ = owned_.get();
+  }
+  mark_ = arena_->top_;
+}
+
+CONFSEQ_INLINE ScratchScope::~ScratchScope() {
+  arena_->rewind(mark_);
+}
+
+CONFSEQ_INLINE ScratchArenaStats scratch_arena_stats() {
+  const ScratchCounters& counters = scratch_counters();
+  return {counters.high_water.load(), counters.reserved.load(),
+          counters.heap_allocations.load()};
+}
+
+CONFSEQ_INLINE void reset_scratch_arena_stats() {
+  ScratchCounters& counters = scratch_counters();
+  counters.epoch++;
+  counters.high_water = 0;
+  counters.heap_allocations = 0;
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class T>
+T* ScratchScope::allocate(const size_t n) {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "scratch values are never destroyed");
+  return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+}
+
+template <class T>
+T* ScratchScope::allocate(const size_t n, const T& value) {
+  T* values = allocate<T>(n);
+  std::uninitialized_fill_n(values, n, value);
+  return values;
+}
+
+template <class T>
+T* ScratchAllocator<T>::allocate(const size_t n) {
+  return static_cast<T*>(ScratchArena::acquire(n * sizeof(T)));
+}
+
+template <class T>
+void ScratchAllocator<T>::deallocate(T* block, const size_t n) {
+  ScratchArena::release(block, n * sizeof(T));
+}
+
+template <class Value>
+SortedSearchIndex::SortedSearchIndex(const Value* sorted, const size_t n)
+    : num_blocks_((n + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+  // A perfect tree, padded with infinities, so that the path of a descent
+  // spells out the number of blocks before the query.
+  while ((size_t(1) << height_) <= num_blocks_) {
+    height_++;
+  }
+  keys_.assign(size_t(1) << height_, std::numeric_limits<double>::infinity());
+  build(sorted, 0, 1);
+}
+
+// Fills the subtree at node in order, from the block numbered block, and
+// returns the number of the block after it.
+template <class Value>
+size_t SortedSearchIndex::build(const Value* sorted, size_t block,
+                                const size_t node) {
+  if (node >= keys_.size()) {
+    return block;
+  }
+  block = build(sorted, block, 2 * node);
+  if (block < num_blocks_) {
+    keys_[node] = sorted[block * BLOCK_SIZE];
+  }
+  return build(sorted, block + 1, 2 * node + 1);
+}
+
+template <class Value, class Before>
+size_t SortedSearchIndex::search(const Value* sorted, const size_t n,
+                                 Before before) const {
+  size_t node = 1;
+  for (int level = 0; level < height_; level++) {
+#if defined(__GNUC__) || defined(__clang__)
+    // Node 16 * node and its 15 neighbours are its descendants four levels
+    // down, typically two cache lines.
+    __builtin_prefetch(keys_.data() + std::min(16 * node, keys_.size() - 1));
+#endif
+    node = 2 * node + before(keys_[node]);
+  }
+  // The number of blocks whose first value is before the query. Padding is
+  // before only NaN and infinite queries of upper_bound.
+  const size_t block = std::min(node - keys_.size(), num_blocks_);
+  if (block == 0) {
+    return 0;
+  }
+  // The answer lies in the last of those blocks, whose values before the
+  // query form a prefix.
+  const size_t begin = (block - 1) * BLOCK_SIZE;
+  const size_t end = begin + BLOCK_SIZE < n ? begin + BLOCK_SIZE : n;
+  size_t count = begin;
+  for (size_t i = begin; i < end; i++) {
+    count += before(sorted[i]);
+  }
+  return count;
+}
+
+template <class Value>
+template <class InputIt>
+StaticOrderStatisticsT<Value>::StaticOrderStatisticsT(InputIt first,
+                                                      InputIt last,
+                                                      const int num_threads,
+                                                      const bool compress_ties)
+    : sorted_values_(first, last) {
+  parallel_sort(sorted_values_.begin(), sorted_values_.end(), num_threads);
+  if (!compress_ties) {
+    index_ = SortedSearchIndex(sorted_values_.data(), sorted_values_.size());
+    return;
+  }
+  compressed_ = true;
+  for (size_t i = 0; i < sorted_values_.size(); i++) {
+    if (i == 0 || sorted_values_[i] != sorted_values_[i - 1]) {
+      run_values_.push_back(sorted_values_[i]);
+      run_ends_.push_back(i);
+    }
+    run_ends_.back()++;
+  }
+  std::vector<Value>().swap(sorted_values_);
+  index_ = SortedSearchIndex(run_values_.data(), run_values_.size());
+}
+
+template <class Value>
+StaticOrderStatisticsT<Value>::StaticOrderStatisticsT(const Value* values,
+                                                      const int64_t* counts,
+                                                      const size_t n)
+    : compressed_(true) {
+  std::vector<std::pair<double, int64_t>> entries;
+  entries.reserve(n);
+  int64_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (std::isnan(double(values[i])) || counts[i] < 0) {
+      throw std::invalid_argument(
+          "Values must not be NaN and counts must be nonnegative");
+    }
+    total += counts[i];
+    if (total > std::numeric_limits<int>::max()) {
+      throw std::invalid_argument("Samples hold at most INT_MAX values");
+    }
+    if (counts[i] > 0) {
+      entries.emplace_back(values[i], counts[i]);
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  int end = 0;
+  for (const auto& entry : entries) {
+    end += entry.second;
+    if (!run_values_.empty() && run_values_.back() == entry.first) {
+      run_ends_.back() = end;
+    } else {
+      run_values_.push_back(entry.first);
+      run_ends_.push_back(end);
+    }
+  }
+  index_ = SortedSearchIndex(run_values_.data(), run_values_.size());
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE size_t BoundaryCacheKeyHash::operator()(
+    const BoundaryCacheKey& key) const {
+  size_t hash = 0;
+  for (const double value : key) {
+    hash ^= std::hash<double>()(value) + 0x9e3779b97f4a7c15ULL + (hash << 6)
+        + (hash >> 2);
+  }
+  return hash;
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class Fn>
+std::pair<double, double> BoundaryCache::get_or_compute(
+    const BoundaryCacheKey& key, Fn compute) {
+  const bool storable = std::none_of(
+      key.begin(), key.end(),
+      [](const double value) { return std::isnan(value); });
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = storable ? index_.find(key) : index_.end();
+    if (found != index_.end()) {
+      hits_++;
+      entries_.splice(entries_.begin(), entries_, found->second);
+      return found->second->second;
+    }
+    misses_++;
+  }
+  const uint64_t truncations = solve_budget_truncations();
+  const std::pair<double, double> value = compute();
+  if (!storable || solve_budget_truncations() != truncations) {
+    return value;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index_.find(key) == index_.end()) {
+    entries_.emplace_front(key, value);
+    index_[key] = entries_.begin();
+    if (entries_.size() > capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+  return value;
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE void BoundaryCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+CONFSEQ_INLINE BoundaryCacheStats BoundaryCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return BoundaryCacheStats{hits_, misses_, entries_.size(), capacity_};
+}
+
+CONFSEQ_INLINE std::shared_ptr<BoundaryCache>& boundary_cache_instance() {
+  static std::shared_ptr<BoundaryCache> cache;
+  return cache;
+}
+
+CONFSEQ_INLINE void enable_boundary_cache(const size_t capacity) {
+  std::atomic_store(&boundary_cache_instance(),
+                    std::make_shared<BoundaryCache>(capacity));
+}
+
+CONFSEQ_INLINE void disable_boundary_cache() {
+  std::atomic_store(&boundary_cache_instance(),
+                    std::shared_ptr<BoundaryCache>());
+}
+
+CONFSEQ_INLINE void clear_boundary_cache() {
+  auto cache = std::atomic_load(&boundary_cache_instance());
+  if (cache) {
+    cache->clear();
+  }
+}
+
+CONFSEQ_INLINE BoundaryCacheStats boundary_cache_stats() {
+  auto cache = std::atomic_load(&boundary_cache_instance());
+  return cache ? cache->stats() : BoundaryCacheStats{0, 0, 0, 0};
+}
+
+// Reads up to size values of T from in, stopping early and leaving in failed
+// if it runs out. The buffer grows with the data read, at most doubling, so a
+// size from a corrupt header fails as truncated input rather than allocating
+// for that size up front.
+template <class T>
+std::vector<T> read_array(std::istream& in, const size_t size) {
+  const size_t min_chunk = (size_t(1) << 20) / sizeof(T);
+  std::vector<T> values;
+  while (values.size() < size) {
+    const size_t begin = values.size();
+    const size_t end = std::min(size, std::max(2 * begin, min_chunk));
+    values.reserve(end);
+    values.resize(end);
+    in.read(reinterpret_cast<char*>(values.data() + begin),
+            (end - begin) * sizeof(T));
+    if (!in) {
+      values.resize(begin);
+      break;
+    }
+  }
+  return values;
+}
+
+namespace constants_bundle_format {
+const char MAGIC[8] = {'C', 'S', 'C', 'O', 'N', 'S', 'T', '\0'};
+const uint32_t VERSION = 1;
+// Header: magic, version, 4 bytes of padding, num_entries. Entries follow as
+// ConstantsBundle::Entry in native byte order, sorted by key and 8-byte
+// aligned.
+const size_t HEADER_SIZE = 24;
+};
+
+static_assert(sizeof(ConstantsBundle::Entry) == 48,
+              "ConstantsBundle entries must have no padding");
+
+CONFSEQ_INLINE bool constants_bundle_key_less(
+    const ConstantsBundle::Entry& a, const ConstantsBundle::Entry& b) {
+  if (a.kind != b.kind) {
+    return a.kind < b.kind;
+  }
+  return std::lexicographical_compare(a.parameters, a.parameters + 4,
+                                      b.parameters, b.parameters + 4);
+}
+
+CONFSEQ_INLINE ConstantsBundle::ConstantsBundle(std::vector<Entry> entries) {
+  std::stable_sort(entries.begin(), entries.end(), constants_bundle_key_less);
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const Entry& a, const Entry& b) {
+                              return !constants_bundle_key_less(a, b);
+                            }),
+                entries.end());
+  Entry* data = new Entry[entries.size()];
+  std::copy(entries.begin(), entries.end(), data);
+  storage_ = std::shared_ptr<const Entry>(data, std::default_delete<Entry[]>());
+  size_ = entries.size();
+}
+
+CONFSEQ_INLINE ConstantsBundle::ConstantsBundle(
+    std::shared_ptr<const Entry> storage, const size_t size)
+    : storage_(std::move(storage)), size_(size) {
+  const Entry* entries = storage_.get();
+  for (size_t i = 1; i < size_; i++) {
+    if (!constants_bundle_key_less(entries[i - 1], entries[i])) {
+      throw std::runtime_error("Unsorted constants bundle data");
+    }
+  }
+}
+
+CONFSEQ_INLINE ConstantsBundle ConstantsBundle::build(
+    const ConstantsBundleGrid& grid, const int num_threads) {
+  std::vector<Entry> entries;
+  const auto add = [&entries](const BundledConstant kind,
+                              const std::array<double, 4>& parameters) {
+    Entry entry = {uint32_t(kind), 0, {}, 0};
+    std::copy(parameters.begin(), parameters.end(), entry.parameters);
+    entries.push_back(entry);
+  };
+  const double precision_key = SolverPrecision().cache_key();
+  for (const double alpha : grid.lil_alpha) {
+    for (const double A : grid.lil_A) {
+      add(BundledConstant::EMPIRICAL_PROCESS_LIL_C,
+          {alpha, A, precision_key, 0});
+    }
+  }
+  for (const double alpha_opt : grid.alpha_opt) {
+    for (const double v_opt : grid.v_opt) {
+      const double rho = OneSidedNormalMixture::best_rho(v_opt, alpha_opt);
+      for (const double c : grid.gamma_c) {
+        add(BundledConstant::GAMMA_EXPONENTIAL_LEADING_CONSTANT,
+            {rho, c, 0, 0});
+        add(BundledConstant::GAMMA_POISSON_LEADING_CONSTANT, {rho, c, 0, 0});
+      }
+    }
+    for (const double p : grid.beta_binomial_p) {
+      const double g = p, h = 1 - p;
+      std::vector<double> v_opts = grid.v_opt;
+      for (const double t_opt : grid.t_opt) {
+        v_opts.push_back(t_opt * p * (1 - p));
+      }
+      for (const double v_opt : v_opts) {
+        add(BundledConstant::BETA_BINOMIAL_LOG_NORMALIZER,
+            {OneSidedBetaBinomialMixture::optimal_r(v_opt, alpha_opt, g, h),
+             g, h, 1});
+        add(BundledConstant::BETA_BINOMIAL_LOG_NORMALIZER,
+            {TwoSidedBetaBinomialMixture::optimal_r(v_opt, alpha_opt, g, h),
+             g, h, 0});
+      }
+    }
+  }
+  // The root searches dominate, and vary in cost, so entries are taken one
+  // at a time.
+  parallel_for(entries.size(), [&entries](const size_t i) {
+    Entry& entry = entries[i];
+    const double* p = entry.parameters;
+    switch (BundledConstant(entry.kind)) {
+      case BundledConstant::EMPIRICAL_PROCESS_LIL_C:
+        entry.value = EmpiricalProcessLILBound::compute_optimal_C(
+            p[0], p[1], SolverPrecision());
+        break;
+      case BundledConstant::GAMMA_EXPONENTIAL_LEADING_CONSTANT:
+        entry.value =
+            GammaExponentialMixture::compute_leading_constant(p[0], p[1]);
+        break;
+      case BundledConstant::GAMMA_POISSON_LEADING_CONSTANT:
+        entry.value = GammaPoissonMixture::compute_leading_constant(p[0], p[1]);
+        break;
+      case BundledConstant::BETA_BINOMIAL_LOG_NORMALIZER:
+        entry.value = p[3] == 1
+            ? OneSidedBetaBinomialMixture::compute_log_normalizer(p[0], p[1],
+                                                                  p[2])
+            : TwoSidedBetaBinomialMixture::compute_log_normalizer(p[0], p[1],
+                                                                  p[2]);
+        break;
+    }
+  }, num_threads, 1);
+  return ConstantsBundle(std::move(entries));
+}
+
+CONFSEQ_INLINE bool ConstantsBundle::find(
+    const BundledConstant kind, const std::array<double, 4>& parameters,
+    double& value) const {
+  Entry key = {uint32_t(kind), 0, {}, 0};
+  std::copy(parameters.begin(), parameters.end(), key.parameters);
+  const Entry* begin = storage_.get();
+  const Entry* entry = std::lower_bound(begin, begin + size_, key,
+                                        constants_bundle_key_less);
+  if (entry == begin + size_ || constants_bundle_key_less(key, *entry)) {
+    return false;
+  }
+  value = entry->value;
+  return true;
+}
+
+CONFSEQ_INLINE void ConstantsBundle::save(std::ostream& out) const {
+  const uint32_t padding = 0;
+  const uint64_t num_entries = size_;
+  out.write(constants_bundle_format::MAGIC,
+            sizeof(constants_bundle_format::MAGIC));
+  out.write(reinterpret_cast<const char*>(&constants_bundle_format::VERSION),
+            sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&padding), sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&num_entries), sizeof(uint64_t));
+  out.write(reinterpret_cast<const char*>(storage_.get()),
+            size_ * sizeof(Entry));
+}
+
+CONFSEQ_INLINE size_t parse_constants_bundle_header(const char* header) {
+  uint32_t version;
+  uint64_t num_entries;
+  memcpy(&version, header + 8, sizeof(uint32_t));
+  memcpy(&num_entries, header + 16, sizeof(uint64_t));
+  if (memcmp(header, constants_bundle_format::MAGIC,
+             sizeof(constants_bundle_format::MAGIC))
+      || version != constants_bundle_format::VERSION
+      || num_entries > (uint64_t(1) << 40)) {
+    throw std::runtime_error("Invalid constants bundle data");
+  }
+  return size_t(num_entries);
+}
+
+CONFSEQ_INLINE ConstantsBundle ConstantsBundle::load(std::istream& in) {
+  char header[constants_bundle_format::HEADER_SIZE];
+  in.read(header, sizeof(header));
+  if (!in) {
+    throw std::runtime_error("Invalid constants bundle data");
+  }
+  const size_t size = parse_constants_bundle_header(header);
+  const auto entries = std::make_shared<std::vector<Entry>>(
+      read_array<Entry>(in, size));
+  if (!in) {
+    throw std::runtime_error("Truncated constants bundle data");
+  }
+  return ConstantsBundle(
+      std::shared_ptr<const Entry>(entries, entries->data()), size);
+}
+
+CONFSEQ_INLINE ConstantsBundle ConstantsBundle::map_file(
+    const std::string& path) {
+#ifdef CONFSEQ_HAVE_MMAP
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || size_t(file_stat.st_size) < constants_bundle_format::HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Invalid constants bundle data");
+  }
+  const size_t file_size = file_stat.st_size;
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + path);
+  }
+  const std::shared_ptr<const char> owner(
+      static_cast<const char*>(mapping), [file_size](const char* data) {
+        munmap(const_cast<char*>(data), file_size);
+      });
+  const size_t size = parse_constants_bundle_header(owner.get());
+  if (file_size < constants_bundle_format::HEADER_SIZE + size * sizeof(Entry)) {
+    throw std::runtime_error("Truncated constants bundle data");
+  }
+  return ConstantsBundle(
+      std::shared_ptr<const Entry>(
+          owner, reinterpret_cast<const Entry*>(
+                     owner.get() + constants_bundle_format::HEADER_SIZE)),
+      size);
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  return load(in);
+#endif
+}
+
+CONFSEQ_INLINE std::shared_ptr<const ConstantsBundle>&
+constants_bundle_instance() {
+  static std::shared_ptr<const ConstantsBundle> bundle = []() {
+    const char* path = std::getenv("CONFSEQ_CONSTANTS_BUNDLE");
+    if (path == nullptr || *path == '\0') {
+      return std::shared_ptr<const ConstantsBundle>();
+    }
+    try {
+      return std::make_shared<const ConstantsBundle>(
+          ConstantsBundle::map_file(path));
+    } catch (const std::runtime_error&) {
+      // Constructors then compute every constant, as without a bundle.
+      return std::shared_ptr<const ConstantsBundle>();
+    }
+  }();
+  return bundle;
+}
+
+CONFSEQ_INLINE void set_constants_bundle(
+    std::shared_ptr<const ConstantsBundle> bundle) {
+  std::atomic_store(&constants_bundle_instance(), std::move(bundle));
+}
+
+CONFSEQ_INLINE bool find_bundled_constant(
+    const BundledConstant kind, const std::array<double, 4>& parameters,
+    double& value) {
+  const auto bundle = std::atomic_load(&constants_bundle_instance());
+  return bundle && bundle->find(kind, parameters, value);
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+// Runs compute() through the process-wide cache if it is enabled.
+template <class Fn>
+std::pair<double, double> cached_pair(const BoundaryCacheKey& key,
+                                      Fn compute) {
+  auto cache = std::atomic_load(&boundary_cache_instance());
+  return cache ? cache->get_or_compute(key, compute) : compute();
+}
+
+template <class Fn>
+double cached_value(const BoundaryCacheKey& key, Fn compute) {
+  return cached_pair(key, [&compute]() {
+    return std::make_pair(compute(), 0.0);
+  }).first;
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE const char* traced_function_name(const TracedFunction function) {
+  static const char* const names[] = {
+      "normal_mixture_bound", "gamma_exponential_mixture_bound",
+      "gamma_poisson_mixture_bound", "beta_binomial_mixture_bound",
+      "bernoulli_confidence_interval", "quantile_ab_p_value",
+      "predmix_empbern_cs", "predmix_hoeffding_cs", "predmix_empbern_cs_wor",
+      "predmix_hoeffding_cs_wor", "conjmix_hoeffding_cs", "conjmix_empbern_cs",
+      "hedged_cs", "betting_cs_bisection", "batch_confidence_sequences",
+      "simulate_crossings", "two_sample_mean_tests",
+      "average_treatment_effect_cs", "mixture_p_values", "tune_mixture",
+      "e_bh_update", "confidence_sequence_readouts",
+      "mixture_first_crossings", "betting_first_rejections",
+      "cs_first_exclusions", "intersected_cs"};
+  static_assert(sizeof(names) / sizeof(names[0])
+                    == size_t(TracedFunction::NUM_TRACED_FUNCTIONS),
+                "one name per traced function");
+  return names[size_t(function)];
+}
+
+CONFSEQ_INLINE std::shared_ptr<TraceHook>& trace_hook_instance() {
+  static std::shared_ptr<TraceHook> hook;
+  return hook;
+}
+
+// Set exactly when a hook is installed, so that untraced calls skip the
+// shared_ptr load.
+CONFSEQ_INLINE std::atomic<bool>& trace_hook_installed() {
+  static std::atomic<bool> installed(false);
+  return installed;
+}
+
+CONFSEQ_INLINE void set_trace_hook(std::shared_ptr<TraceHook> hook) {
+  const bool installed = bool(hook);
+  std::atomic_store(&trace_hook_instance(), std::move(hook));
+  trace_hook_installed().store(installed);
+}
+
+CONFSEQ_INLINE std::shared_ptr<TraceHook> trace_hook() {
+  return std::atomic_load(&trace_hook_instance());
+}
+
+CONFSEQ_INLINE void LatencyHistogram::end(const TracedFunction function,
+                                          const size_t /*input_size*/,
+                                          const uint64_t elapsed_ns) {
+  record(function, elapsed_ns);
+}
+
+CONFSEQ_INLINE void LatencyHistogram::record(const TracedFunction function,
+                                             const uint64_t elapsed_ns) {
+  FunctionHistogram& histogram = functions_[size_t(function)];
+  histogram.buckets[bucket_index(elapsed_ns)].fetch_add(
+      1, std::memory_order_relaxed);
+  histogram.count.fetch_add(1, std::memory_order_relaxed);
+  histogram.total_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+  uint64_t max_ns = histogram.max_ns.load(std::memory_order_relaxed);
+  while (elapsed_ns > max_ns
+         && !histogram.max_ns.compare_exchange_weak(
+             max_ns, elapsed_ns, std::memory_order_relaxed)) {}
+}
+
+// Values below SUB_BUCKETS get a bucket each. Above, the bucket is the power
+// of two followed by the next SUB_BUCKET_BITS bits of the value.
+CONFSEQ_INLINE int LatencyHistogram::bucket_index(const uint64_t ns) {
+  if (ns < uint64_t(SUB_BUCKETS)) {
+    return int(ns);
+  }
+  int exponent = 0;
+  frexp(double(ns), &exponent);
+  // frexp rounds ns to a double first, which can carry into the next power.
+  exponent = std::min(exponent - 1, 63);
+  if (ns >> exponent == 0) {
+    exponent--;
+  }
+  const int shift = exponent - SUB_BUCKET_BITS;
+  return SUB_BUCKETS * (shift + 1) + int(ns >> shift) - SUB_BUCKETS;
+}
+
+CONFSEQ_INLINE double LatencyHistogram::bucket_upper_edge(const int index) {
+  if (index < SUB_BUCKETS) {
+    return index + 1;
+  }
+  const double width = ldexp(1.0, index / SUB_BUCKETS - 1);
+  return (SUB_BUCKETS + index % SUB_BUCKETS + 1) * width;
+}
+
+CONFSEQ_INLINE double LatencyHistogram::quantile(const TracedFunction function,
+                                                 const double q) const {
+  const FunctionHistogram& histogram = functions_[size_t(function)];
+  uint64_t total = 0;
+  for (const auto& bucket : histogram.buckets) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+  const double rank = std::max(1.0, ceil(q * total));
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    seen += histogram.buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return bucket_upper_edge(i);
+    }
+  }
+  return bucket_upper_edge(NUM_BUCKETS - 1);
+}
+
+CONFSEQ_INLINE LatencySummary LatencyHistogram::summary(
+    const TracedFunction function) const {
+  const FunctionHistogram& histogram = functions_[size_t(function)];
+  const uint64_t count = histogram.count.load(std::memory_order_relaxed);
+  return LatencySummary{
+      count,
+      count > 0 ? double(histogram.total_ns.load(std::memory_order_relaxed))
+          / count : 0,
+      quantile(function, 0.5), quantile(function, 0.9),
+      quantile(function, 0.99), quantile(function, 0.999),
+      histogram.max_ns.load(std::memory_order_relaxed)};
+}
+
+CONFSEQ_INLINE void LatencyHistogram::reset() {
+  for (FunctionHistogram& histogram : functions_) {
+    for (auto& bucket : histogram.buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    histogram.count.store(0, std::memory_order_relaxed);
+    histogram.total_ns.store(0, std::memory_order_relaxed);
+    histogram.max_ns.store(0, std::memory_order_relaxed);
+  }
+}
+
+CONFSEQ_INLINE void LatencyHistogram::dump(std::ostream& out) const {
+  char line[256];
+  snprintf(line, sizeof(line), "%-32s %10s %10s %10s %10s %10s %10s %10s\n",
+           "function", "count", "mean_us", "p50_us", "p90_us", "p99_us",
+           "p999_us", "max_us");
+  out << line;
+  for (size_t i = 0; i < functions_.size(); i++) {
+    const TracedFunction function = TracedFunction(i);
+    const LatencySummary s = summary(function);
+    if (s.count == 0) {
+      continue;
+    }
+    snprintf(line, sizeof(line),
+             "%-32s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+             traced_function_name(function), (unsigned long long) s.count,
+             s.mean_ns / 1e3, s.p50_ns / 1e3, s.p90_ns / 1e3, s.p99_ns / 1e3,
+             s.p999_ns / 1e3, s.max_ns / 1e3);
+    out << line;
+  }
+}
+
+CONFSEQ_INLINE std::shared_ptr<LatencyHistogram> enable_latency_histogram() {
+  auto histogram = std::make_shared<LatencyHistogram>();
+  set_trace_hook(histogram);
+  return histogram;
+}
+
+// Nonnegative, finite values rounded down; anything else as zero.
+CONFSEQ_INLINE size_t trace_input_size(const double value) {
+  return value >= 0 && value < 1e18 ? size_t(value) : 0;
+}
+
+CONFSEQ_INLINE TraceScope::TraceScope(const TracedFunction function,
+                                      const size_t input_size)
+    : function_(function), input_size_(input_size) {
+  if (trace_hook_installed().load(std::memory_order_relaxed)) {
+    hook_ = trace_hook();
+    if (hook_) {
+      hook_->begin(function_, input_size_);
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+CONFSEQ_INLINE TraceScope::~TraceScope() {
+  if (hook_) {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    hook_->end(function_, input_size_,
+               std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                   .count());
+  }
+}
+
+CONFSEQ_INLINE double MixtureBoundary::operator()(const double v,
+                                                  const double alpha) const {
+  std::array<double, 5> parameters;
+  if (!std::atomic_load(&boundary_cache_instance())
+      || !mixture_superMG_->cache_parameters(parameters)) {
+    return mixture_superMG_->bound(v, log(1 / alpha));
+  }
+  const BoundaryCacheKey key = {parameters[0], parameters[1], parameters[2],
+                                parameters[3], parameters[4], v, alpha,
+                                mixture_superMG_->precision().cache_key()};
+  return cached_value(key, [this, v, alpha]() {
+    return mixture_superMG_->bound(v, log(1 / alpha));
+  });
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class Mixture>
+double find_s_upper_bound(const Mixture& mixture_superMG, const double v,
+                          const double log_threshold, const double start) {
+  double trial_upper_bound = start;
+  for (int i = 0; i < 50; i++) {
+    if (solve_budget_exhausted()) {
+      return std::numeric_limits<double>::infinity();
+    }
+    CONFSEQ_COUNT(objective_evaluations);
+    if (mixture_superMG.log_superMG(trial_upper_bound, v) > log_threshold) {
+      return trial_upper_bound;
+    }
+    CONFSEQ_COUNT(bracket_expansions);
+    trial_upper_bound *= 2;
+  }
+  // No upper limit was found, typically because log_superMG is NaN here.
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+template <class Mixture>
+double find_s_upper_bound(const Mixture& mixture_superMG, const double v,
+                          const double log_threshold) {
+  const double bracket = mixture_superMG.s_upper_bracket(v, log_threshold);
+  return find_s_upper_bound(
+      mixture_superMG, v, log_threshold,
+      bracket > 0 && bracket < std::numeric_limits<double>::infinity()
+          ? bracket : v);
+}
+
+// Safeguarded Halley iteration for the root of log_superMG(s, v) =
+// log_threshold on [s_lower, s_upper], where the objective is negative at
+// s_lower and equals upper_value > 0 at s_upper. Any step leaving the current
+// bracket is replaced by a bisection step. Falls back to Newton's method when
+// the second derivative is unavailable.
+template <class Mixture>
+double find_mixture_bound_halley(
+    const Mixture& mixture_superMG, const double v,
+    const double log_threshold, double s_lower, double s_upper,
+    const double upper_value) {
+  const SolverPrecision& precision = mixture_superMG.precision();
+  const double tolerance = precision.tolerance();
+  // Conservative results must be checked to lie above the root. The final
+  // estimate, nudged up by the tolerance, usually does; otherwise fall back to
+  // the lowest point known to lie above the root.
+  auto finish = [&](const double estimate) {
+    if (!precision.conservative) {
+      return estimate;
+    }
+    const double candidate = std::min(estimate * (1 + tolerance), s_upper);
+    CONFSEQ_COUNT(objective_evaluations);
+    return mixture_superMG.log_superMG(candidate, v) - log_threshold >= 0
+        ? candidate : s_upper;
+  };
+  double s = s_upper;
+  double value = upper_value;
+  for (int i = 0; i < 100; i++) {
+    if (i > 0) {
+      // The objective is positive at s_upper, so it bounds the root.
+      if (solve_budget_exhausted()) {
+        return s_upper;
+      }
+      CONFSEQ_COUNT(objective_evaluations);
+      value = mixture_superMG.log_superMG(s, v) - log_threshold;
+    }
+    if (value == 0) {
+      return s;
+    } else if (value > 0) {
+      s_upper = s;
+    } else {
+      s_lower = s;
+    }
+    const double first = mixture_superMG.d_log_superMG_ds(s, v);
+    const double second = mixture_superMG.d2_log_superMG_ds2(s, v);
+    double next_s = std::numeric_limits<double>::quiet_NaN();
+    if (std::isfinite(first) && first > 0) {
+      double step = value / first;
+      const double denominator = 1 - step * second / (2 * first);
+      if (std::isfinite(second) && denominator > 0.5) {
+        step /= denominator;
+      }
+      next_s = s - step;
+    }
+    // A step within tolerance may round onto the end of the bracket when s
+    // starts at the root, as with warm-started searches, and is accepted.
+    const bool converged = s_lower <= next_s && next_s <= s_upper
+        && fabs(next_s - s) <= tolerance * fabs(next_s);
+    if (!converged && !(s_lower < next_s && next_s < s_upper)) {
+      CONFSEQ_COUNT(bisection_steps);
+      next_s = (s_lower + s_upper) / 2;
+    } else {
+      CONFSEQ_COUNT(halley_steps);
+    }
+    if (fabs(next_s - s) <= tolerance * fabs(next_s)
+        || s_upper - s_lower <= tolerance * fabs(s_upper)) {
+      return finish(next_s);
+    }
+    s = next_s;
+  }
+  // Steps stalled at the noise floor of the objective, possibly with s_lower
+  // never raised, so the bracket midpoint may lie far below the root. s_upper
+  // is the lowest point known to lie above it.
+  return s_upper;
+}
+
+template <class Mixture>
+double find_mixture_bound(const Mixture& mixture_superMG, const double v,
+                          const double log_threshold) {
+  return find_mixture_bound(mixture_superMG, v, log_threshold, 0.0,
+                            std::numeric_limits<double>::infinity());
+}
+
+// As above, but starting from a guessed bracket [s_lower_hint, s_upper_hint]
+// around the root. Hints are checked before use, so a wrong guess costs extra
+// evaluations but never changes the result beyond solver tolerance.
+// Conservative searches with reduced-precision special functions solve for
+// the threshold raised by the possible error in log_superMG.
+template <class Mixture>
+double find_mixture_bound(const Mixture& mixture_superMG, const double v,
+                          const double requested_log_threshold,
+                          const double s_lower_hint,
+                          const double s_upper_hint) {
+  CONFSEQ_COUNT_SOLVE();
+  const double scale = mixture_superMG.special_function_scale(v);
+  const double log_threshold = requested_log_threshold
+      + (mixture_superMG.precision().conservative && scale > 0
+         ? mixture_superMG.precision().log_superMG_error(scale) : 0);
+  auto root_fn = [&mixture_superMG, v, log_threshold](const double s) {
+    CONFSEQ_COUNT(objective_evaluations);
+    return mixture_superMG.log_superMG(s, v) - log_threshold;
+  };
+  const double s_max = mixture_superMG.s_upper_bound(v);
+  double s_upper_bound = std::min(s_upper_hint, s_max);
+  double upper_value;
+  // An infinite upper bracket from find_s_upper_bound means the budget ran
+  // out before the root was bracketed.
+  if (s_upper_bound == std::numeric_limits<double>::infinity()) {
+    s_upper_bound = find_s_upper_bound(mixture_superMG, v, log_threshold);
+    if (s_upper_bound == std::numeric_limits<double>::infinity()) {
+      return s_upper_bound;
+    }
+    upper_value = root_fn(s_upper_bound);
+  } else {
+    upper_value = root_fn(s_upper_bound);
+    if (s_upper_bound < s_max && !(upper_value > 0)) {
+      s_upper_bound = s_max < std::numeric_limits<double>::infinity() ? s_max
+          : find_s_upper_bound(mixture_superMG, v, log_threshold,
+                               s_upper_bound > 0 ? 2 * s_upper_bound : v);
+      if (s_upper_bound == std::numeric_limits<double>::infinity()) {
+        return s_upper_bound;
+      }
+      upper_value = root_fn(s_upper_bound);
+    }
+  }
+  if (std::isnan(upper_value)) {
+    return std::numeric_limits<double>::quiet_NaN();
+  } else if (upper_value < 0) {
+    return s_upper_bound;
+  }
+  double s_lower_bound = 0.0;
+  if (0 < s_lower_hint && s_lower_hint < s_upper_bound
+      && root_fn(s_lower_hint) < 0) {
+    s_lower_bound = s_lower_hint;
+  }
+  if (!std::isnan(mixture_superMG.d_log_superMG_ds(s_upper_bound, v))) {
+    return find_mixture_bound_halley(mixture_superMG, v, log_threshold,
+                                     s_lower_bound, s_upper_bound,
+                                     upper_value);
+  } else {
+    const SolverPrecision& precision = mixture_superMG.precision();
+    // Under MathPolicy an unbracketed bisection returns f(min) rather than
+    // throwing, so check the sign change first.
+    if (!(root_fn(s_lower_bound) < 0)) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    // The least s known to lie above the root, returned if the budget runs
+    // out.
+    double above_root = s_upper_bound;
+    auto bisection_fn = [&root_fn, &above_root](const double s) {
+      if (solve_budget_exhausted()) {
+        throw SolveBudgetExhausted();
+      }
+      CONFSEQ_COUNT(bisection_steps);
+      const double value = root_fn(s);
+      if (value > 0) {
+        above_root = std::min(above_root, s);
+      }
+      return value;
+    };
+    boost::uintmax_t max_iter = std::numeric_limits<boost::uintmax_t>::max();
+    try {
+      auto result = boost::math::tools::bisect(
+          bisection_fn, s_lower_bound, s_upper_bound,
+          boost::math::tools::eps_tolerance<double>(precision.bits), max_iter,
+          MathPolicy());
+      return precision.conservative ? result.second
+          : (result.first + result.second) / 2;
+    } catch (const SolveBudgetExhausted&) {
+      return above_root;
+    }
+  }
+}
+
+// Mixture bounds are increasing in v while bound(v) / v is decreasing, so the
+// previous root and its rescaling by the ratio of v values bracket the next
+// root, in whichever direction v moves.
+template <class Mixture>
+double find_next_mixture_bound(const Mixture& mixture_superMG,
+                               const double v_previous,
+                               const double bound_previous, const double v,
+                               const double log_threshold) {
+  if (!(bound_previous > 0) || !(v_previous > 0)) {
+    return mixture_superMG.bound(v, log_threshold);
+  } else if (v == v_previous) {
+    return bound_previous;
+  }
+  const double scaled = bound_previous * v / v_previous;
+  return v > v_previous
+      ? find_mixture_bound(mixture_superMG, v, log_threshold, bound_previous,
+                           scaled)
+      : find_mixture_bound(mixture_superMG, v, log_threshold, scaled,
+                           bound_previous);
+}
+
+template <class Mixture>
+void find_mixture_bound_sequence(const Mixture& mixture_superMG,
+                                 const double* v, const size_t n,
+                                 const double log_threshold, double* out) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = i == 0 ? mixture_superMG.bound(v[i], log_threshold)
+        : find_next_mixture_bound(mixture_superMG, v[i - 1], out[i - 1], v[i],
+                                  log_threshold);
+  }
+}
+
+// log_superMG is convex in s, so the bound, its inverse in s, is concave in
+// the threshold and nonnegative at threshold zero. The bound for a smaller
+// threshold therefore lies above the chord from the origin to the previous
+// root, and below the tangent at the previous root, a Newton step of
+// log_superMG, or when derivatives are unavailable, below the extension of
+// the chord through the previous two roots.
+template <class Mixture>
+void find_mixture_bounds(const Mixture& mixture_superMG, const double v,
+                         const double* log_thresholds,
+                         const size_t num_thresholds, double* out) {
+  std::vector<size_t> order(num_thresholds);
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::sort(order.begin(), order.end(), [log_thresholds](const size_t a,
+                                                         const size_t b) {
+    return log_thresholds[a] > log_thresholds[b];
+  });
+  // d bound / d log_threshold at the previous root, or NaN if unknown.
+  double slope = std::numeric_limits<double>::quiet_NaN();
+  for (size_t k = 0; k < num_thresholds; k++) {
+    const size_t j = order[k];
+    const double log_threshold = log_thresholds[j];
+    if (k == 0) {
+      out[j] = mixture_superMG.bound(v, log_threshold);
+      continue;
+    }
+    const size_t previous = order[k - 1];
+    const double bound_previous = out[previous];
+    const double log_threshold_previous = log_thresholds[previous];
+    const double derivative =
+        mixture_superMG.d_log_superMG_ds(bound_previous, v);
+    if (derivative > 0) {
+      slope = 1 / derivative;
+    }
+    if (log_threshold == log_threshold_previous) {
+      out[j] = bound_previous;
+      continue;
+    } else if (!(bound_previous > 0) || !(log_threshold_previous > 0)) {
+      out[j] = mixture_superMG.bound(v, log_threshold);
+    } else {
+      const double upper = slope > 0
+          ? bound_previous - (log_threshold_previous - log_threshold) * slope
+          : bound_previous;
+      out[j] = find_mixture_bound(
+          mixture_superMG, v, log_threshold,
+          bound_previous * log_threshold / log_threshold_previous,
+          upper > 0 ? upper : bound_previous);
+    }
+    if (!(derivative > 0)) {
+      slope = (bound_previous - out[j])
+          / (log_threshold_previous - log_threshold);
+    }
+  }
+}
+
+template <bool IsOneSided>
+double SidedBetaBinomialMixture<IsOneSided>::log_superMG(
+    const double s, const double v) const {
+  const double a = (r_ + v - g_ * s) / (g_ * (g_ + h_));
+  const double b = (r_ + v + h_ * s) / (h_ * (g_ + h_));
+  const SpecialFunctionPrecision special_functions =
+      precision().special_functions;
+  return
+      v / (g_ * h_) * log(g_ + h_)
+      - ((v + h_ * s) / (h_ * (g_ + h_))) * log(g_)
+      - ((v - g_ * s) / (g_ * (g_ + h_))) * log(h_)
+      + (IsOneSided
+             ? log_incomplete_beta(a, b, h_ / (g_ + h_), special_functions)
+             : log_beta(a, b, special_functions))
+      - normalizer_;
+}
+
+// Only the two-sided mixture has closed-form derivatives: there the incomplete
+// beta is complete, and a + b does not depend on s, so the derivatives reduce
+// to digamma and trigamma differences. The one-sided derivative would need the
+// shape-parameter derivative of ibeta, so it falls back to bisection.
+template <bool IsOneSided>
+double SidedBetaBinomialMixture<IsOneSided>::d_log_superMG_ds(
+    const double s, const double v) const {
+  if (IsOneSided) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  const double a = (r_ + v - g_ * s) / (g_ * (g_ + h_));
+  const double b = (r_ + v + h_ * s) / (h_ * (g_ + h_));
+  return with_math_policy(precision().special_functions, [&](const auto pol) {
+    return (log(h_) - log(g_) + boost::math::digamma(b, pol)
+            - boost::math::digamma(a, pol)) / (g_ + h_);
+  });
+}
+
+template <bool IsOneSided>
+double SidedBetaBinomialMixture<IsOneSided>::d2_log_superMG_ds2(
+    const double s, const double v) const {
+  if (IsOneSided) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  const double a = (r_ + v - g_ * s) / (g_ * (g_ + h_));
+  const double b = (r_ + v + h_ * s) / (h_ * (g_ + h_));
+  return with_math_policy(precision().special_functions, [&](const auto pol) {
+    return (boost::math::trigamma(a, pol) + boost::math::trigamma(b, pol))
+        / ((g_ + h_) * (g_ + h_));
+  });
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE void MixtureSupermartingale::bound_sequence(
+    const double* v, const size_t n, const double log_threshold,
+    double* out) const {
+  find_mixture_bound_sequence(*this, v, n, log_threshold, out);
+}
+
+CONFSEQ_INLINE void MixtureSupermartingale::bound_multi(
+    const double* v, const size_t num_v, const double* log_thresholds,
+    const size_t num_thresholds, double* out) const {
+  for (size_t i = 0; i < num_v; i++) {
+    find_mixture_bounds(*this, v[i], log_thresholds, num_thresholds,
+                        out + i * num_thresholds);
+  }
+}
+
+CONFSEQ_INLINE void MixtureSupermartingale::log_superMG(const double* s,
+                                                        const double* v,
+                                                        const size_t n,
+                                                        double* out) const {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = log_superMG(s[i], v[i]);
+  }
+}
+
+CONFSEQ_INLINE double TwoSidedNormalMixture::log_superMG(
+    const double s, const double v) const {
+  return (1 / 2.0) * log(rho_ / (v + rho_)) + s * s / (2 * (v + rho_));
+}
+
+CONFSEQ_INLINE void TwoSidedNormalMixture::log_superMG(const double* s,
+                                                       const double* v,
+                                                       const size_t n,
+                                                       double* out) const {
+  vector_kernels::normal_log_superMG(vector_width(), *this, s, v, n, out);
+}
+
+CONFSEQ_INLINE double TwoSidedNormalMixture::bound(
+    const double v, const double log_threshold) const {
+  return sqrt((v + rho_) * (log(1 + v / rho_) + 2 * log_threshold));
+}
+
+CONFSEQ_INLINE float round_up_to_float(const double value) {
+  const float rounded = value;
+  return rounded < value
+      ? std::nextafter(rounded, std::numeric_limits<float>::infinity())
+      : rounded;
+}
+
+CONFSEQ_INLINE void TwoSidedNormalMixture::bound_sequence(
+    const float* v, const size_t n, const double log_threshold,
+    float* out) const {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = round_up_to_float(bound(v[i], log_threshold));
+  }
+}
+
+CONFSEQ_INLINE double TwoSidedNormalMixture::d_log_superMG_ds(
+    const double s, const double v) const {
+  return s / (v + rho_);
+}
+
+CONFSEQ_INLINE double TwoSidedNormalMixture::d2_log_superMG_ds2(
+    const double /*s*/, const double v) const {
+  return 1 / (v + rho_);
+}
+
+CONFSEQ_INLINE double TwoSidedNormalMixture::best_rho(double v, double alpha) {
+  assert(v > 0);
+  assert(0 < alpha && alpha < 1);
+  return v / (2 * log(1 / alpha) + log(1 + 2 * log(1 / alpha)));
+}
+
+// log Phi(z) for the standard normal CDF Phi, finite for all finite z. Uses
+// erfc directly in the bulk, log1p in the right tail, and the asymptotic
+// series Phi(z) ~ phi(z) / -z * sum_k (-1)^k (2k - 1)!! / z^(2k) in the left
+// tail, where erfc would underflow.
+CONFSEQ_INLINE double log_normal_cdf(const double z) {
+  if (z > 5) {
+    return log1p(-0.5 * std::erfc(z / sqrt(2.0)));
+  } else if (z > -20) {
+    return log(0.5 * std::erfc(-z / sqrt(2.0)));
+  }
+  const double inverse_z_sq = 1 / (z * z);
+  double term = 1;
+  double series = 1;
+  for (int k = 1; k <= 10; k++) {
+    term *= -(2 * k - 1) * inverse_z_sq;
+    series += term;
+  }
+  return -z * z / 2 - log(-z)
+      - 0.5 * log(2 * boost::math::constants::pi<double>()) + log(series);
+}
+
+// d/dz log Phi(z) = phi(z) / Phi(z), computed in log space so that it stays
+// finite in the left tail.
+CONFSEQ_INLINE double normal_cdf_log_derivative(const double z) {
+  return exp(-z * z / 2 - 0.5 * log(2 * boost::math::constants::pi<double>())
+             - log_normal_cdf(z));
+}
+
+CONFSEQ_INLINE int vector_width() {
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+  static const int width = __builtin_cpu_supports("avx512f") ? 8
+      : __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? 4
+      : 1;
+  return width;
+#else
+  return 1;
+#endif
+}
+
+CONFSEQ_INLINE void log_normal_cdf(const double* z, const size_t n,
+                                   double* out) {
+  vector_kernels::log_normal_cdf(vector_width(), z, n, out);
+}
+
+namespace vector_kernels {
+
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+#define CONFSEQ_ALWAYS_INLINE inline __attribute__((always_inline))
+
+const double SQRT_2 = 1.41421356237309504880;
+const double LOG2_E = 1.44269504088896340736;
+// ln 2 split as in fdlibm, so that n * LN2_HI is exact for |n| < 2^11.
+const double LN2_HI = 6.93147180369123816490e-01;
+const double LN2_LO = 1.90821492927058770002e-10;
+// Adding 1.5 * 2^52 to a double of magnitude below 2^51 rounds it to an
+// integer, which the low bits of the sum then hold.
+const double ROUNDING_SHIFT = 6755399441055744.0;
+const int64_t ROUNDING_SHIFT_BITS = 0x4338000000000000;
+// The bits of 2^52, below which an integer k in the mantissa bits makes
+// 2^52 + k.
+const int64_t TWO_POW_52_BITS = 0x4330000000000000;
+const double TWO_POW_52 = 4503599627370496.0;
+const int64_t EXPONENT_BIAS = 1023;
+const int64_t MANTISSA_MASK = (int64_t(1) << 52) - 1;
+// 2 / (2 k + 1), the coefficients of 2 atanh(f) / f in f^2, and 1 / k!.
+const double ATANH_SERIES[12] = {2.0,      2.0 / 3,  2.0 / 5,  2.0 / 7,
+                                 2.0 / 9,  2.0 / 11, 2.0 / 13, 2.0 / 15,
+                                 2.0 / 17, 2.0 / 19, 2.0 / 21, 2.0 / 23};
+const double EXP_SERIES[15] = {
+    1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+    1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800,
+    1.0 / 479001600, 1.0 / 6227020800, 1.0 / 87178291200};
+
+// Boost.Math's double precision rational approximations R = Y + P / Q, as
+// ERFC_P[k][piece] for the coefficient of t^k, on five pieces of a >= 0: for
+// a < 0.5, erf(a) = a R(a^2), and on [0.5, 1.5), [1.5, 2.5), [2.5, 4.5) and
+// [4.5, inf), erfc(a) = exp(-a^2) R / a with t = a - 0.5, a - 1.5, a - 3.5
+// and a respectively. The last piece is Boost's P(1 / a) / Q(1 / a) with
+// both multiplied through by a^6, which saves a division. The columns are
+// padded to eight for Permute.
+const double ERFC_Y[8] = {1.044948577880859375, 0.405935764312744140625,
+                          0.50672817230224609375, 0.5405750274658203125,
+                          0.5579090118408203125, 0, 0, 0};
+const double ERFC_T_OFFSET[8] = {0, 0.5, 1.5, 3.5, 0, 0, 0, 0};
+const double ERFC_P[7][8] = {
+    {0.0834305892146531832907, -0.098090592216281240205,
+     -0.0243500476207698441272, 0.00295276716530971662634,
+     -2.8175401114513378771, 0, 0, 0},
+    {-0.338165134459360935041, 0.178114665841120341155,
+     0.0386540375035707201728, 0.0137384425896355332126,
+     -3.22729451764143718517, 0, 0, 0},
+    {-0.0509990735146777432841, 0.191003695796775433986, 0.04394818964209516296,
+     0.00840807615555585383007, -2.5518551727311523996, 0, 0, 0},
+    {-0.00772758345802133288487, 0.0888900368967884466578,
+     0.0175679436311802092299, 0.00212825620914618649141,
+     -0.687717681153649930619, 0, 0, 0},
+    {-0.000322780120964605683831, 0.0195049001251218801359,
+     0.00323962406290842133584, 0.000250269961544794627958,
+     -0.212652252872804219852, 0, 0, 0},
+    {0, 0.00180424538297014223957, 0.000235839115596880717416,
+     0.113212406648847561139e-4, 0.0175389834052493308818, 0, 0, 0},
+    {0, 0, 0, 0, 0.00628057170626964891937, 0, 0, 0},
+};
+const double ERFC_Q[7][8] = {
+    {1.0, 1.0, 1.0, 1.0, 5.48409182238641741584, 0, 0, 0},
+    {0.455004033050794024546, 1.84759070983002217845, 1.53991494948552447182,
+     1.04217814166938418171, 13.5064170191802889145, 0, 0, 0},
+    {0.0875222600142252549554, 1.42628004845511324508, 0.982403709157920235114,
+     0.442597659481563127003, 22.9367376522880577224, 0, 0, 0},
+    {0.00858571925074406212772, 0.578052804889902404909,
+     0.325732924782444448493, 0.0958492726301061423444, 15.930646027911794143,
+     0, 0, 0},
+    {0.000370900071787748000569, 0.12385097467900864233,
+     0.0563921837420478160373, 0.0105982906484876531489, 11.0567237927800161565,
+     0, 0, 0},
+    {0, 0.0113385233577001411017, 0.00410369723978904575884,
+     0.000479411269521714493907, 2.79257750980575282228, 0, 0, 0},
+    {0, 0.337511472483094676155e-5, 0, 0, 1.0, 0, 0, 0},
+};
+
+// The entries of an eight-entry table at a 64-bit index per lane, for the
+// vector types of VectorMath<Width>: __builtin_shuffle needs the concrete
+// types, which GCC does not resolve from the width inside that template.
+// index() prepares the indices for any number of lookup() calls.
+template <int Width>
+struct Permute;
+template <>
+struct Permute<4> {
+  typedef double Double __attribute__((vector_size(32)));
+  typedef int64_t Int __attribute__((vector_size(32)));
+  typedef uint64_t UInt __attribute__((vector_size(32)));
+  typedef int32_t Word __attribute__((vector_size(32)));
+  // The 32-bit halves of each lane's entry in either half of the table, and
+  // the lanes that take theirs from the upper half. Each half permutes into
+  // place in one instruction; a permutation of both would be expanded with
+  // these steps repeated on every lookup.
+  struct Index {
+    Word words;
+    Int upper;
+  };
+  static CONFSEQ_ALWAYS_INLINE void index(const Int& entry, Index& out) {
+    out.words = (Word)((entry & 3) * 0x200000002 + 0x100000000);
+    out.upper = -(Int)(((UInt)entry >> 2) & 1);
+  }
+  static CONFSEQ_ALWAYS_INLINE void lookup(const double (&table)[8],
+                                           const Index& index, Double& out) {
+    Word lower, upper;
+    memcpy(&lower, table, sizeof(lower));
+    memcpy(&upper, table + 4, sizeof(upper));
+    out = (Double)(((Int)__builtin_shuffle(upper, index.words) & index.upper)
+                   | ((Int)__builtin_shuffle(lower, index.words)
+                      & ~index.upper));
+  }
+};
+template <>
+struct Permute<8> {
+  typedef double Double __attribute__((vector_size(64)));
+  typedef int64_t Int __attribute__((vector_size(64)));
+  typedef Int Index;
+  static CONFSEQ_ALWAYS_INLINE void index(const Int& entry, Index& out) {
+    out = entry;
+  }
+  static CONFSEQ_ALWAYS_INLINE void lookup(const double (&table)[8],
+                                           const Index& index, Double& out) {
+    Double entries;
+    memcpy(&entries, table, sizeof(entries));
+    out = __builtin_shuffle(entries, index);
+  }
+};
+
+// Width doubles, and the 64-bit integers their comparisons yield, in the
+// vector extensions. The compiler lowers their arithmetic to the instruction
+// set of the function it is inlined into, so the functions below are always
+// inlined and take vectors by reference: passing them by value from code
+// built for another instruction set would change the calling convention.
+// They use only operations that AVX2 has for 64-bit lanes, with no
+// conversions between integers and doubles.
+template <int Width>
+struct VectorMath {
+  typedef double Double __attribute__((vector_size(8 * Width)));
+  typedef int64_t Int __attribute__((vector_size(8 * Width)));
+  typedef uint64_t UInt __attribute__((vector_size(8 * Width)));
+
+  // a in the lanes where mask is set and b elsewhere, bitwise.
+  static CONFSEQ_ALWAYS_INLINE void select(const Int& mask, const Double& a,
+                                           const Double& b, Double& out) {
+    out = (Double)(((Int)a & mask) | ((Int)b & ~mask));
+  }
+
+  // The lanes where lo <= x <= hi, none of them NaN. Comparison masks are
+  // only ever combined by exclusive or: other combinations of two of them
+  // are split into lanes with AVX-512, whose comparisons yield mask
+  // registers.
+  static CONFSEQ_ALWAYS_INLINE void in_range(const Double& x, const double lo,
+                                             const double hi, Int& out) {
+    out = (Int)(x >= lo) ^ (Int)(x > hi);
+  }
+
+  // The coefficients of a polynomial: entries of a table, the same in every
+  // lane, and the rows of ERFC_P and ERFC_Q for the piece of each lane.
+  struct Coefficients {
+    CONFSEQ_ALWAYS_INLINE void operator()(const int k, Double& out) const {
+      out = table[k] - Double{};
+    }
+    const double* table;
+  };
+  struct PieceCoefficients {
+    CONFSEQ_ALWAYS_INLINE void operator()(const int k, Double& out) const {
+      Permute<Width>::lookup(rows[k], piece, out);
+    }
+    const double (*rows)[8];
+    const typename Permute<Width>::Index& piece;
+  };
+
+  // The largest power of two below count > 1, and the exponent of a power
+  // of two.
+  static constexpr int estrin_split(const int count) {
+    return count <= 2 ? 1 : 2 * estrin_split((count + 1) / 2);
+  }
+  static constexpr int exponent_of(const int h) {
+    return h == 1 ? 0 : 1 + exponent_of(h / 2);
+  }
+
+  // sum_k c(k) t^k over first <= k < first + Count by Estrin's scheme, as
+  // P(t) + t^h Q(t) for h = estrin_split(Count), with t_powers[j] =
+  // t^(2^j). The dependency chains grow with log2(Count) rather than with
+  // Count, as they would by Horner's rule.
+  template <class C>
+  static CONFSEQ_ALWAYS_INLINE void polynomial(
+      std::integral_constant<int, 1>, const C& c, const int first,
+      const Double* /*t_powers*/, Double& out) {
+    c(first, out);
+  }
+  template <int Count, class C>
+  static CONFSEQ_ALWAYS_INLINE void polynomial(
+      std::integral_constant<int, Count>, const C& c, const int first,
+      const Double* t_powers, Double& out) {
+    const int h = estrin_split(Count);
+    Double low, high;
+    polynomial(std::integral_constant<int, h>(), c, first, t_powers, low);
+    polynomial(std::integral_constant<int, Count - h>(), c, first + h,
+               t_powers, high);
+    out = low + t_powers[exponent_of(h)] * high;
+  }
+
+  // log x for positive normal x. With x = 2^e m and 1 / sqrt(2) <= m <
+  // sqrt(2), log m = 2 atanh(f) for f = (m - 1) / (m + 1), |f| < 0.172, from
+  // its Taylor series through f^23.
+  static CONFSEQ_ALWAYS_INLINE void log(const Double& x, Double& out) {
+    const UInt bits = (UInt)x;
+    Double e = (Double)((bits >> 52) | TWO_POW_52_BITS)
+        - (TWO_POW_52 + EXPONENT_BIAS);
+    Double m = (Double)((bits & MANTISSA_MASK) | (EXPONENT_BIAS << 52));
+    const Int high = (Int)(m > SQRT_2);
+    select(high, m * 0.5, m, m);
+    select(high, e + 1, e, e);
+    const Double f = (m - 1) / (m + 1);
+    Double f_powers[4] = {f * f};
+    for (int j = 1; j < 4; j++) {
+      f_powers[j] = f_powers[j - 1] * f_powers[j - 1];
+    }
+    Double series;
+    polynomial(std::integral_constant<int, 12>(), Coefficients{ATANH_SERIES},
+               0, f_powers, series);
+    out = e * LN2_HI + (f * series + e * LN2_LO);
+  }
+
+  // exp y for y <= 0. With y = n ln 2 + r and |r| <= ln(2) / 2, exp r comes
+  // from its Taylor series through r^14 and 2^n from its exponent bits.
+  // Below -708, where exp y is subnormal, the result is 0.
+  static CONFSEQ_ALWAYS_INLINE void exp(const Double& y, Double& out) {
+    const Int underflow = (Int)(y < -708);
+    Double clamped;
+    select(underflow, Double{} - 708, y, clamped);
+    const Double shifted = clamped * LOG2_E + ROUNDING_SHIFT;
+    const Double n = shifted - ROUNDING_SHIFT;
+    const Double r = (clamped - n * LN2_HI) - n * LN2_LO;
+    Double r_powers[4] = {r};
+    for (int j = 1; j < 4; j++) {
+      r_powers[j] = r_powers[j - 1] * r_powers[j - 1];
+    }
+    Double series;
+    polynomial(std::integral_constant<int, 15>(), Coefficients{EXP_SERIES}, 0,
+               r_powers, series);
+    const Int exponent = (Int)shifted - ROUNDING_SHIFT_BITS + EXPONENT_BIAS;
+    out = (Double)((Int)(series * (Double)(exponent << 52)) & ~underflow);
+  }
+
+  // 1 / sqrt(x) for positive normal x: the bit-level estimate, within 3.5%,
+  // refined by four Newton steps.
+  static CONFSEQ_ALWAYS_INLINE void rsqrt(const Double& x, Double& out) {
+    Double y = (Double)(uint64_t(0x5fe6eb50c7b537a9) - ((UInt)x >> 1));
+    for (int k = 0; k < 4; k++) {
+      y = y * (1.5 - 0.5 * x * y * y);
+    }
+    out = y;
+  }
+
+  // log Phi(x) for |x| <= 1e40, from the erf and erfc approximations at
+  // a = |x| / sqrt(2). In the left tail log Phi(x) = -x^2 / 2 +
+  // log(R / (2 a)), which never underflows, and in the right tail it is
+  // log1p(-q) for q = exp(-x^2 / 2) R / (2 a).
+  static CONFSEQ_ALWAYS_INLINE void log_normal_cdf(const Double& x,
+                                                   Double& out) {
+    const Double u = x * (1 / SQRT_2);
+    const Double a = (Double)((Int)u & std::numeric_limits<int64_t>::max());
+    const Int tail_lanes = (Int)(a >= 0.5);
+    const Int beyond_1_5 = (Int)(a >= 1.5);
+    const Int beyond_2_5 = (Int)(a >= 2.5);
+    const Int beyond_4_5 = (Int)(a >= 4.5);
+    typename Permute<Width>::Index piece;
+    Permute<Width>::index(
+        -(tail_lanes + beyond_1_5 + beyond_2_5 + beyond_4_5), piece);
+    Double t_offset, t;
+    Permute<Width>::lookup(ERFC_T_OFFSET, piece, t_offset);
+    select(tail_lanes, 1 - Double{}, a, t);
+    t = t * a - t_offset;
+    const Double t_powers[3] = {t, t * t, t * t * (t * t)};
+    Double p, q;
+    polynomial(std::integral_constant<int, 7>(),
+               PieceCoefficients{ERFC_P, piece}, 0, t_powers, p);
+    polynomial(std::integral_constant<int, 7>(),
+               PieceCoefficients{ERFC_Q, piece}, 0, t_powers, q);
+    // R itself for a < 0.5, and R / (2 a) in the tails.
+    Double y, scale;
+    Permute<Width>::lookup(ERFC_Y, piece, y);
+    select(tail_lanes, 2 * a, 1 - Double{}, scale);
+    const Double r = (y * q + p) / (scale * q);
+
+    const Int negative = -(Int)((UInt)x >> 63);
+    const Int left = tail_lanes & negative;
+    const Int right = tail_lanes & ~negative;
+    const Double half_x_sq = 0.5 * x * x;
+    // x^2 = 2 half_x_sq + x_sq_error exactly, by Dekker's product, so that q
+    // keeps its relative accuracy as exp(-x^2 / 2) falls.
+    const Double split = x * 134217729.0;
+    const Double x_high = split - (split - x);
+    const Double x_low = x - x_high;
+    const Double x_sq_error = ((x_high * x_high - 2 * half_x_sq)
+                               + 2 * x_high * x_low) + x_low * x_low;
+    Double right_q;
+    exp(-half_x_sq, right_q);
+    right_q *= r * (1 - 0.5 * x_sq_error);
+    Double w = 0.5 + 0.5 * u * r;
+    select(left, r, w, w);
+    select(right, 1 - right_q, w, w);
+    Double log_w;
+    log(w, log_w);
+    select(left, log_w - half_x_sq, log_w, out);
+    // log1p(-q) as log w corrected for the rounding of w = 1 - q, dividing
+    // by w > 0.76 as multiplying by 2 - w, to within (1 - w)^2 of it.
+    select(right, log_w - ((w - 1) + right_q) * (2 - w), out, out);
+  }
+};
+#endif
+
+// The batch kernels: evaluate() on vectors, where the vector extensions are
+// available, and exact() on one element.
+struct LogNormalCdfKernel {
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+  template <class M>
+  CONFSEQ_ALWAYS_INLINE void evaluate(const typename M::Double& z,
+                                      const typename M::Double& /*unused*/,
+                                      typename M::Double& out,
+                                      typename M::Int& valid) const {
+    M::in_range(z, -1e40, 1e40, valid);
+    M::log_normal_cdf(z, out);
+  }
+#endif
+  double exact(const double z, const double /*unused*/) const {
+    return confseq::log_normal_cdf(z);
+  }
+};
+
+struct TwoSidedNormalKernel {
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+  template <class M>
+  CONFSEQ_ALWAYS_INLINE void evaluate(const typename M::Double& s,
+                                      const typename M::Double& v,
+                                      typename M::Double& out,
+                                      typename M::Int& valid) const {
+    typedef typename M::Double Double;
+    const double rho = mixture.rho();
+    const Double v_rho = v + rho;
+    const Double ratio = rho / v_rho;
+    M::in_range(ratio, std::numeric_limits<double>::min(),
+                std::numeric_limits<double>::max(), valid);
+    Double log_ratio;
+    M::log(ratio, log_ratio);
+    out = (1 / 2.0) * log_ratio + s * s / (2 * v_rho);
+  }
+#endif
+  double exact(const double s, const double v) const {
+    return mixture.log_superMG(s, v);
+  }
+
+  const TwoSidedNormalMixture& mixture;
+};
+
+struct OneSidedNormalKernel {
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+  template <class M>
+  CONFSEQ_ALWAYS_INLINE void evaluate(const typename M::Double& s,
+                                      const typename M::Double& v,
+                                      typename M::Double& out,
+                                      typename M::Int& valid) const {
+    typedef typename M::Double Double;
+    typedef typename M::Int Int;
+    const double rho = mixture.rho();
+    const Double v_rho = v + rho;
+    const Double ratio = 4 * rho / v_rho;
+    Double inverse_sd;
+    M::rsqrt(v_rho, inverse_sd);
+    const Double z = s * inverse_sd;
+    Int ratio_valid, v_rho_valid, z_valid;
+    M::in_range(ratio, std::numeric_limits<double>::min(),
+                std::numeric_limits<double>::max(), ratio_valid);
+    M::in_range(v_rho, std::numeric_limits<double>::min(),
+                std::numeric_limits<double>::max(), v_rho_valid);
+    M::in_range(z, -1e40, 1e40, z_valid);
+    valid = ratio_valid & v_rho_valid & z_valid;
+    Double log_ratio, log_phi;
+    M::log(ratio, log_ratio);
+    M::log_normal_cdf(z, log_phi);
+    out = (1 / 2.0) * log_ratio + s * s / (2 * v_rho) + log_phi;
+  }
+#endif
+  double exact(const double s, const double v) const {
+    return mixture.log_superMG(s, v);
+  }
+
+  const OneSidedNormalMixture& mixture;
+};
+
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+// kernel.evaluate() on the Width elements of s and v, taking kernel.exact()
+// instead for those it marks invalid.
+template <int Width, class Kernel>
+CONFSEQ_ALWAYS_INLINE void map_block(const Kernel& kernel, const double* s,
+                                     const double* v, double* out) {
+  typedef VectorMath<Width> M;
+  typename M::Double s_block, v_block, result;
+  typename M::Int valid;
+  memcpy(&s_block, s, sizeof(s_block));
+  memcpy(&v_block, v, sizeof(v_block));
+  kernel.template evaluate<M>(s_block, v_block, result, valid);
+  memcpy(out, &result, sizeof(result));
+  typename M::Int all_valid = valid;
+  for (int j = 1; j < Width; j++) {
+    all_valid &= valid[j];
+  }
+  if (!all_valid[0]) {
+    for (int j = 0; j < Width; j++) {
+      if (!valid[j]) {
+        out[j] = kernel.exact(s[j], v[j]);
+      }
+    }
+  }
+}
+
+// map_block() over s and v, the last block padded with zeros.
+template <int Width, class Kernel>
+CONFSEQ_ALWAYS_INLINE void map_lanes(const Kernel& kernel, const double* s,
+                                     const double* v, const size_t n,
+                                     double* out) {
+  size_t begin = 0;
+  for (; begin + Width <= n; begin += Width) {
+    map_block<Width>(kernel, s + begin, v + begin, out + begin);
+  }
+  if (begin < n) {
+    double s_tail[Width] = {}, v_tail[Width] = {}, out_tail[Width];
+    std::copy(s + begin, s + n, s_tail);
+    std::copy(v + begin, v + n, v_tail);
+    map_block<Width>(kernel, s_tail, v_tail, out_tail);
+    std::copy(out_tail, out_tail + (n - begin), out + begin);
+  }
+}
+
+// The kernels for each width, instantiated in functions built for the
+// instruction set that width needs.
+#define CONFSEQ_VECTOR_KERNEL(Kernel)                                        \
+  __attribute__((target("avx2,fma"))) CONFSEQ_INLINE void map_avx2(          \
+      const Kernel& kernel, const double* s, const double* v, const size_t n, \
+      double* out) {                                                         \
+    map_lanes<4>(kernel, s, v, n, out);                                      \
+  }                                                                          \
+  __attribute__((target("avx512f"))) CONFSEQ_INLINE void map_avx512(         \
+      const Kernel& kernel, const double* s, const double* v, const size_t n, \
+      double* out) {                                                         \
+    map_lanes<8>(kernel, s, v, n, out);                                      \
+  }
+CONFSEQ_VECTOR_KERNEL(LogNormalCdfKernel)
+CONFSEQ_VECTOR_KERNEL(TwoSidedNormalKernel)
+CONFSEQ_VECTOR_KERNEL(OneSidedNormalKernel)
+#undef CONFSEQ_VECTOR_KERNEL
+
+#undef CONFSEQ_ALWAYS_INLINE
+#endif
+
+// Runs kernel at width, which vector_width() must allow.
+template <class Kernel>
+void map_width(const int width, const Kernel& kernel, const double* s,
+               const double* v, const size_t n, double* out) {
+  switch (width) {
+#ifdef CONFSEQ_HAVE_VECTOR_KERNELS
+    case 8:
+      map_avx512(kernel, s, v, n, out);
+      return;
+    case 4:
+      map_avx2(kernel, s, v, n, out);
+      return;
+#endif
+    default:
+      for (size_t i = 0; i < n; i++) {
+        out[i] = kernel.exact(s[i], v[i]);
+      }
+  }
+}
+
+CONFSEQ_INLINE void log_normal_cdf(const int width, const double* z,
+                                   const size_t n, double* out) {
+  map_width(width, LogNormalCdfKernel(), z, z, n, out);
+}
+
+CONFSEQ_INLINE void normal_log_superMG(const int width,
+                                       const TwoSidedNormalMixture& mixture,
+                                       const double* s, const double* v,
+                                       const size_t n, double* out) {
+  map_width(width, TwoSidedNormalKernel{mixture}, s, v, n, out);
+}
+
+CONFSEQ_INLINE void normal_log_superMG(const int width,
+                                       const OneSidedNormalMixture& mixture,
+                                       const double* s, const double* v,
+                                       const size_t n, double* out) {
+  map_width(width, OneSidedNormalKernel{mixture}, s, v, n, out);
+}
+
+};
+
+CONFSEQ_INLINE double OneSidedNormalMixture::log_superMG(
+    const double s, const double v) const {
+  return (1 / 2.0) * log(4 * rho_ / (v + rho_)) + s * s / (2 * (v + rho_))
+      + log_normal_cdf(s / sqrt(v + rho_));
+}
+
+CONFSEQ_INLINE void OneSidedNormalMixture::log_superMG(const double* s,
+                                                       const double* v,
+                                                       const size_t n,
+                                                       double* out) const {
+  vector_kernels::normal_log_superMG(vector_width(), *this, s, v, n, out);
+}
+
+CONFSEQ_INLINE double OneSidedNormalMixture::d_log_superMG_ds(
+    const double s, const double v) const {
+  const double sd = sqrt(v + rho_);
+  return s / (v + rho_) + normal_cdf_log_derivative(s / sd) / sd;
+}
+
+CONFSEQ_INLINE double OneSidedNormalMixture::d2_log_superMG_ds2(
+    const double s, const double v) const {
+  const double z = s / sqrt(v + rho_);
+  const double ratio = normal_cdf_log_derivative(z);
+  return (1 - z * ratio - ratio * ratio) / (v + rho_);
+}
+
+// Phi(z) >= 1/2 for s >= 0, so the one-sided mixture dominates the two-sided
+// mixture with the same rho there, and the two-sided closed form brackets the
+// bound.
+CONFSEQ_INLINE double OneSidedNormalMixture::s_upper_bracket(
+    const double v, const double log_threshold) const {
+  return sqrt((v + rho_) * (log(1 + v / rho_) + 2 * log_threshold))
+      * (1 + 1e-10);
+}
+
+CONFSEQ_INLINE double OneSidedNormalMixture::best_rho(double v, double alpha) {
+  return TwoSidedNormalMixture::best_rho(v, 2 * alpha);
+}
+
+CONFSEQ_INLINE IncompleteGammaApproximation::IncompleteGammaApproximation(
+    const Kind kind)
+    : coefficients_(NUM_T_PIECES * NUM_W_PIECES * NUM_TERMS * NUM_TERMS,
+                    std::numeric_limits<double>::quiet_NaN()) {
+  const int n = NUM_TERMS;
+  const double pi = boost::math::constants::pi<double>();
+  const double t_step = t_max() / NUM_T_PIECES;
+  const double w_step = (w_max() - w_min()) / NUM_W_PIECES;
+  // cosines[k * n + j] = T_k at the jth Chebyshev node
+  std::vector<double> cosines(n * n);
+  for (int k = 0; k < n; k++) {
+    for (int j = 0; j < n; j++) {
+      cosines[k * n + j] = cos(pi * k * (j + 0.5) / n);
+    }
+  }
+  std::vector<double> values(n * n), partial(n * n);
+  for (int i = 0; i < NUM_T_PIECES; i++) {
+    for (int j = 0; j < NUM_W_PIECES; j++) {
+      const double t_start = i * t_step;
+      const double w_start = w_min() + j * w_step;
+      // Keep x or y above 3 / 4 of a or b, away from the singularity at 0.
+      if (w_start < -0.25 / (t_start + t_step)) {
+        continue;
+      }
+      for (int p = 0; p < n; p++) {
+        const double t = t_start + (cosines[n + p] + 1) / 2 * t_step;
+        const double a = 1 / (t * t);
+        for (int q = 0; q < n; q++) {
+          const double w = w_start + (cosines[n + q] + 1) / 2 * w_step;
+          values[p * n + q] = kind == Kind::LOWER
+              ? log(boost::math::gamma_p(a, a + w / t, MathPolicy()))
+              : log(boost::math::gamma_q(a + w / t, a, MathPolicy()));
+        }
+      }
+      // Separable discrete cosine transform, first along w, then along t.
+      for (int p = 0; p < n; p++) {
+        for (int s = 0; s < n; s++) {
+          double sum = 0;
+          for (int q = 0; q < n; q++) {
+            sum += values[p * n + q] * cosines[s * n + q];
+          }
+          partial[p * n + s] = sum * (s > 0 ? 2.0 : 1.0) / n;
+        }
+      }
+      double* coefficients =
+          &coefficients_[(i * NUM_W_PIECES + j) * n * n];
+      for (int r = 0; r < n; r++) {
+        for (int s = 0; s < n; s++) {
+          double sum = 0;
+          for (int p = 0; p < n; p++) {
+            sum += partial[p * n + s] * cosines[r * n + p];
+          }
+          coefficients[r * n + s] = sum * (r > 0 ? 2.0 : 1.0) / n;
+        }
+      }
+    }
+  }
+}
+
+CONFSEQ_INLINE double IncompleteGammaApproximation::operator()(
+    const double t, const double w) const {
+  const double t_step = t_max() / NUM_T_PIECES;
+  const double w_step = (w_max() - w_min()) / NUM_W_PIECES;
+  if (!(0 <= t && t <= t_max() && w_min() <= w && w <= w_max())) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  const int i = std::min(int(t / t_step), NUM_T_PIECES - 1);
+  const int j = std::min(int((w - w_min()) / w_step), NUM_W_PIECES - 1);
+  const double* coefficients =
+      &coefficients_[(i * NUM_W_PIECES + j) * NUM_TERMS * NUM_TERMS];
+  // Chebyshev polynomials at the position within the piece, scaled to
+  // [-1, 1].
+  const double x = 2 * (t - i * t_step) / t_step - 1;
+  const double y = 2 * (w - w_min() - j * w_step) / w_step - 1;
+  double t_polynomials[NUM_TERMS], w_polynomials[NUM_TERMS];
+  t_polynomials[0] = w_polynomials[0] = 1;
+  t_polynomials[1] = x;
+  w_polynomials[1] = y;
+  for (int k = 2; k < NUM_TERMS; k++) {
+    t_polynomials[k] = 2 * x * t_polynomials[k - 1] - t_polynomials[k - 2];
+    w_polynomials[k] = 2 * y * w_polynomials[k - 1] - w_polynomials[k - 2];
+  }
+  double value = 0;
+  for (int r = 0; r < NUM_TERMS; r++) {
+    double row = 0;
+    for (int s = 0; s < NUM_TERMS; s++) {
+      row += coefficients[r * NUM_TERMS + s] * w_polynomials[s];
+    }
+    value += t_polynomials[r] * row;
+  }
+  return value;
+}
+
+CONFSEQ_INLINE const IncompleteGammaApproximation&
+IncompleteGammaApproximation::lower() {
+  static const IncompleteGammaApproximation approximation(Kind::LOWER);
+  return approximation;
+}
+
+CONFSEQ_INLINE const IncompleteGammaApproximation&
+IncompleteGammaApproximation::upper() {
+  static const IncompleteGammaApproximation approximation(Kind::UPPER);
+  return approximation;
+}
+
+CONFSEQ_INLINE double log_gamma_p(const double a, const double x,
+                                  const SpecialFunctionPrecision precision) {
+  if (precision == SpecialFunctionPrecision::FAST && a >= 4) {
+    const double t = 1 / sqrt(a);
+    const double value = IncompleteGammaApproximation::lower()(t, (x - a) * t);
+    if (!std::isnan(value)) {
+      return value;
+    }
+  }
+  return with_math_policy(precision, [a, x](const auto pol) {
+    return log(boost::math::gamma_p(a, x, pol));
+  });
+}
+
+CONFSEQ_INLINE double log_gamma_q(const double y, const double b,
+                                  const SpecialFunctionPrecision precision) {
+  if (precision == SpecialFunctionPrecision::FAST && b >= 4) {
+    const double t = 1 / sqrt(b);
+    const double value = IncompleteGammaApproximation::upper()(t, (y - b) * t);
+    if (!std::isnan(value)) {
+      return value;
+    }
+  }
+  return with_math_policy(precision, [y, b](const auto pol) {
+    return log(boost::math::gamma_q(y, b, pol));
+  });
+}
+
+CONFSEQ_INLINE double GammaExponentialMixture::get_leading_constant(double rho,
+                                                                    double c) {
+  double constant;
+  return find_bundled_constant(
+             BundledConstant::GAMMA_EXPONENTIAL_LEADING_CONSTANT,
+             {rho, c, 0, 0}, constant)
+      ? constant : compute_leading_constant(rho, c);
+}
+
+CONFSEQ_INLINE double GammaExponentialMixture::compute_leading_constant(
+    double rho, double c) {
+  const double rho_c_sq = rho / (c * c);
+  return rho_c_sq * log(rho_c_sq)
+      - boost::math::lgamma(rho_c_sq, MathPolicy())
+      - log(boost::math::gamma_p(rho_c_sq, rho_c_sq, MathPolicy()));
+}
+
+CONFSEQ_INLINE double GammaExponentialMixture::log_superMG(const double s,
+                                                           const double v)
+    const {
+  const double c_sq = c_ * c_;
+  const double cs_v_csq = (c_ * s + v) / c_sq;
+  const double v_rho_csq = (v + rho_) / c_sq;
+  CONFSEQ_COUNT(special_function_calls);
+  const SpecialFunctionPrecision special_functions =
+      precision().special_functions;
+  return with_math_policy(special_functions, [&](const auto pol) {
+    return leading_constant_
+        + boost::math::lgamma(v_rho_csq, pol)
+        + log_gamma_p(v_rho_csq, cs_v_csq + rho_ / c_sq, special_functions)
+        - v_rho_csq * log(cs_v_csq + rho_ / c_sq)
+        + cs_v_csq;
+  });
+}
+
+CONFSEQ_INLINE void GammaExponentialMixture::log_superMG_spaced(
+    const double* s, const double v_start, const double v_step,
+    const size_t n, double* out) const {
+  const double c_sq = c_ * c_;
+  const double a_step = v_step / c_sq;
+  const double k = std::round(a_step);
+  if (!(1 <= k && k <= 8
+        && std::abs(a_step - k) <= 4 * std::numeric_limits<double>::epsilon()
+               * k)) {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = log_superMG(s[i], v_start + double(i) * v_step);
+    }
+    return;
+  }
+  const size_t anchor_interval = 256;
+  const SpecialFunctionPrecision special_functions =
+      precision().special_functions;
+  with_math_policy(special_functions, [&](const auto pol) {
+    double lgamma_a = 0;
+    double a_previous = 0;
+    for (size_t i = 0; i < n; i++) {
+      const double v = v_start + double(i) * v_step;
+      const double cs_v_csq = (c_ * s[i] + v) / c_sq;
+      const double v_rho_csq = (v + rho_) / c_sq;
+      if (i % anchor_interval == 0) {
+        lgamma_a = boost::math::lgamma(v_rho_csq, pol);
+      } else {
+        double rising = a_previous;
+        for (int j = 1; j < int(k); j++) {
+          rising *= a_previous + j;
+        }
+        lgamma_a += log(rising);
+      }
+      a_previous = v_rho_csq;
+      CONFSEQ_COUNT(special_function_calls);
+      out[i] = leading_constant_
+          + lgamma_a
+          + log_gamma_p(v_rho_csq, cs_v_csq + rho_ / c_sq, special_functions)
+          - v_rho_csq * log(cs_v_csq + rho_ / c_sq)
+          + cs_v_csq;
+    }
+  });
+}
+
+// With a = (v + rho) / c^2 and x = (cs + v + rho) / c^2, the Gamma(a) median
+// lies below its mean, so P(a, x) >= 1/2 for s >= 0. Writing x = a (1 + u) and
+// using u - log(1 + u) >= u^2 / (2 (1 + u)) leaves a quadratic in u.
+CONFSEQ_INLINE double GammaExponentialMixture::s_upper_bracket(
+    const double v, const double log_threshold) const {
+  const double c_sq = c_ * c_;
+  const double a = (v + rho_) / c_sq;
+  const double excess = log_threshold + log(2.0) + rho_ / c_sq
+      - leading_constant_ - boost::math::lgamma(a, MathPolicy()) - a
+      + a * log(a);
+  if (!(excess > 0)) {
+    return std::numeric_limits<double>::infinity();
+  }
+  const double u = (excess + sqrt(excess * excess + 2 * a * excess)) / a;
+  return c_ * a * u * (1 + 1e-10);
+}
+
+CONFSEQ_INLINE double GammaExponentialMixture::d_log_superMG_ds(
+    const double s, const double v) const {
+  const double c_sq = c_ * c_;
+  const double a = (v + rho_) / c_sq;
+  const double x = (c_ * s + v + rho_) / c_sq;
+  CONFSEQ_COUNT(special_function_calls);
+  const SpecialFunctionPrecision special_functions =
+      precision().special_functions;
+  const double ratio = with_math_policy(
+      special_functions, [&](const auto pol) {
+        return boost::math::gamma_p_derivative(a, x, pol)
+            / exp(log_gamma_p(a, x, special_functions));
+      });
+  return (ratio + 1 - a / x) / c_;
+}
+
+CONFSEQ_INLINE double GammaExponentialMixture::d2_log_superMG_ds2(
+    const double s, const double v) const {
+  const double c_sq = c_ * c_;
+  const double a = (v + rho_) / c_sq;
+  const double x = (c_ * s + v + rho_) / c_sq;
+  CONFSEQ_COUNT(special_function_calls);
+  const SpecialFunctionPrecision special_functions =
+      precision().special_functions;
+  const double ratio = with_math_policy(
+      special_functions, [&](const auto pol) {
+        return boost::math::gamma_p_derivative(a, x, pol)
+            / exp(log_gamma_p(a, x, special_functions));
+      });
+  return (ratio * ((a - 1) / x - 1) - ratio * ratio + a / (x * x)) / c_sq;
+}
+
+CONFSEQ_INLINE GammaExponentialMixtureBatch::GammaExponentialMixtureBatch(
+    const double* v_opt, const double* alpha_opt, const double* c,
+    const size_t size, const int num_threads)
+    : rho_(size), c_(c, c + size), leading_constant_(size) {
+  parallel_for(size, [&](const size_t i) {
+    rho_[i] = OneSidedNormalMixture::best_rho(v_opt[i], alpha_opt[i]);
+    leading_constant_[i] =
+        GammaExponentialMixture::get_leading_constant(rho_[i], c_[i]);
+  }, num_threads, 64);
+}
+
+// GammaExponentialMixture::log_superMG, term for term, reading the columns
+// in order.
+CONFSEQ_INLINE void GammaExponentialMixtureBatch::log_superMG(
+    const double* s, const double* v, double* out,
+    const int num_threads) const {
+  const size_t n = size();
+  const size_t block_size = 1024;
+  const SpecialFunctionPrecision special_functions =
+      precision_.special_functions;
+  parallel_for((n + block_size - 1) / block_size, [&](const size_t block) {
+    const size_t begin = block * block_size;
+    const size_t end = std::min(n, begin + block_size);
+    with_math_policy(special_functions, [&](const auto pol) {
+      for (size_t i = begin; i < end; i++) {
+        const double c_sq = c_[i] * c_[i];
+        const double cs_v_csq = (c_[i] * s[i] + v[i]) / c_sq;
+        const double v_rho_csq = (v[i] + rho_[i]) / c_sq;
+        CONFSEQ_COUNT(special_function_calls);
+        out[i] = leading_constant_[i]
+            + boost::math::lgamma(v_rho_csq, pol)
+            + log_gamma_p(v_rho_csq, cs_v_csq + rho_[i] / c_sq,
+                          special_functions)
+            - v_rho_csq * log(cs_v_csq + rho_[i] / c_sq)
+            + cs_v_csq;
+      }
+    });
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE void GammaExponentialMixtureBatch::bound(
+    const double* v, const double log_threshold, double* out,
+    const int num_threads) const {
+  parallel_for(size(), [&](const size_t i) {
+    out[i] = find_mixture_bound(mixture(i), v[i], log_threshold);
+  }, num_threads, 16);
+}
+
+CONFSEQ_INLINE double GammaPoissonMixture::get_leading_constant(
+    double rho, double c) {
+  double constant;
+  return find_bundled_constant(
+             BundledConstant::GAMMA_POISSON_LEADING_CONSTANT, {rho, c, 0, 0},
+             constant)
+      ? constant : compute_leading_constant(rho, c);
+}
+
+CONFSEQ_INLINE double GammaPoissonMixture::compute_leading_constant(
+    double rho, double c) {
+  const double rho_c_sq = rho / (c * c);
+  return rho_c_sq * log(rho_c_sq)
+      - boost::math::lgamma(rho_c_sq, MathPolicy())
+      - log(boost::math::gamma_q(rho_c_sq, rho_c_sq, MathPolicy()));
+}
+
+CONFSEQ_INLINE double GammaPoissonMixture::log_superMG(
+    const double s, const double v) const {
+  const double c_sq = c_ * c_;
+  const double v_rho_csq = (v + rho_) / c_sq;
+  const double cs_v_rho_csq = s / c_ + v_rho_csq;
+  CONFSEQ_COUNT(special_function_calls);
+  const SpecialFunctionPrecision special_functions =
+      precision().special_functions;
+  return with_math_policy(special_functions, [&](const auto pol) {
+    return leading_constant_
+        + boost::math::lgamma(cs_v_rho_csq, pol)
+        + log_gamma_q(cs_v_rho_csq, v_rho_csq, special_functions)
+        - cs_v_rho_csq * log(v_rho_csq)
+        + v / c_sq;
+  });
+}
+
+// With a = (v + rho) / c^2 and y = s / c + a, the Gamma(y) median exceeds
+// y - 1/3, so Q(y, a) >= 1/2 once y >= a + 1. Replacing lgamma by its Stirling
+// lower bound then gives a minorant of log_superMG needing only logarithms,
+// which is searched by doubling in place of the incomplete gamma.
+CONFSEQ_INLINE double GammaPoissonMixture::s_upper_bracket(
+    const double v, const double log_threshold) const {
+  const double c_sq = c_ * c_;
+  const double a = (v + rho_) / c_sq;
+  const double constant = leading_constant_ - log(2.0)
+      + 0.5 * log(2 * boost::math::constants::pi<double>()) + v / c_sq;
+  double s = c_;
+  for (int i = 0; i < 100; i++) {
+    const double y = s / c_ + a;
+    if (constant + (y - 0.5) * log(y) - y - y * log(a) > log_threshold) {
+      return s;
+    }
+    s *= 2;
+  }
+  return std::numeric_limits<double>::infinity();
+}
+
+CONFSEQ_INLINE double log_beta(const double a, const double b,
+                               const SpecialFunctionPrecision precision) {
+  return with_math_policy(precision, [a, b](const auto pol) {
+    return boost::math::lgamma(a, pol) + boost::math::lgamma(b, pol)
+        - boost::math::lgamma(a + b, pol);
+  });
+}
+
+// Evaluates the continued fraction for the incomplete beta function by the
+// modified Lentz method, so that B_x(a, b) = x^a (1 - x)^b fraction / a.
+// Converges quickly for x < (a + 1) / (a + b + 2); stops once a step changes
+// the fraction by a relative epsilon, and returns false if it has not
+// converged within the iteration limit.
+CONFSEQ_INLINE bool incomplete_beta_fraction(const double a, const double b,
+                                             const double x, double& fraction,
+                                             const double epsilon=1e-15) {
+  const double tiny = 1e-300;
+  double c = 1;
+  double d = 1 - (a + b) * x / (a + 1);
+  d = 1 / (std::abs(d) < tiny ? tiny : d);
+  fraction = d;
+  for (int m = 1; m <= 300; m++) {
+    const double even = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+    d = 1 + even * d;
+    d = 1 / (std::abs(d) < tiny ? tiny : d);
+    c = 1 + even / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    fraction *= d * c;
+    const double odd = -(a + m) * (a + b + m) * x
+        / ((a + 2 * m) * (a + 2 * m + 1));
+    d = 1 + odd * d;
+    d = 1 / (std::abs(d) < tiny ? tiny : d);
+    c = 1 + odd / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    const double delta = d * c;
+    fraction *= delta;
+    if (std::abs(delta - 1) < epsilon) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Logarithm of the unregularized incomplete beta function B_x(a, b), computed
+// in log space so that it does not underflow. Below the mean the continued
+// fraction needs no lgamma calls at all; above it, the complement is used.
+// Falls back to boost::math::ibeta for parameters where the fraction converges
+// slowly.
+CONFSEQ_INLINE double log_incomplete_beta(
+    const double a, const double b, const double x,
+    const SpecialFunctionPrecision precision) {
+  if (x == 1) {
+    return log_beta(a, b, precision);
+  }
+  CONFSEQ_COUNT(special_function_calls);
+  const double log_power = a * log(x) + b * log1p(-x);
+  // The fraction's stopping rule follows the requested precision.
+  const double epsilon = precision == SpecialFunctionPrecision::FAST ? 1e-7
+      : precision == SpecialFunctionPrecision::BALANCED ? 1e-12 : 1e-15;
+  double fraction;
+  if (x < (a + 1) / (a + b + 2)) {
+    if (incomplete_beta_fraction(a, b, x, fraction, epsilon)) {
+      return log_power + log(fraction) - log(a);
+    }
+  } else if (incomplete_beta_fraction(b, a, 1 - x, fraction, epsilon)) {
+    const double log_complete = log_beta(a, b, precision);
+    return log_complete
+        + log1p(-exp(log_power + log(fraction) - log(b) - log_complete));
+  }
+  return with_math_policy(precision, [a, b, x](const auto pol) {
+    return log(boost::math::ibeta(a, b, x, pol));
+  }) + log_beta(a, b, precision);
+}
+
+CONFSEQ_INLINE double PolyStitchingBound::operator()(double v, double alpha)
+    const {
+  double use_v = std::max(v, v_min_);
+  double ell = s_ * log(log(eta_ * use_v / v_min_)) + A_ + log(1 / alpha);
+  double term2 = k2_ * c_ * ell;
+  return sqrt(k1_ * k1_ * use_v * ell + term2 * term2) + term2;
+}
+
+CONFSEQ_INLINE void PolyStitchingBound::bound_sequence(const double* v,
+                                                       const size_t n,
+                                                       const double alpha,
+                                                       double* out) const {
+  const double ell_constant = A_ + log(1 / alpha);
+  const double v_scale = eta_ / v_min_;
+  const double k1_squared = k1_ * k1_;
+  const double k2_c = k2_ * c_;
+  for (size_t i = 0; i < n; i++) {
+    const double use_v = std::max(v[i], v_min_);
+    const double ell = s_ * log(log(v_scale * use_v)) + ell_constant;
+    const double term2 = k2_c * ell;
+    out[i] = sqrt(k1_squared * use_v * ell + term2 * term2) + term2;
+  }
+}
+
+CONFSEQ_INLINE void PolyStitchingBound::bounds(const double* v,
+                                               const double* alpha,
+                                               const size_t n,
+                                               double* out) const {
+  const double v_scale = eta_ / v_min_;
+  const double k1_squared = k1_ * k1_;
+  const double k2_c = k2_ * c_;
+  for (size_t i = 0; i < n; i++) {
+    const double use_v = std::max(v[i], v_min_);
+    const double ell = s_ * log(log(v_scale * use_v)) + A_ - log(alpha[i]);
+    const double term2 = k2_c * ell;
+    out[i] = sqrt(k1_squared * use_v * ell + term2 * term2) + term2;
+  }
+}
+
+CONFSEQ_INLINE void PolyStitchingBound::bound_sequence(const float* v,
+                                                       const size_t n,
+                                                       const double alpha,
+                                                       float* out) const {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = round_up_to_float((*this)(v[i], alpha));
+  }
+}
+
+CONFSEQ_INLINE TabulatedBoundary::TabulatedBoundary(
+    const MixtureSupermartingale& mixture_superMG, const double alpha,
+    const double v_min, const double v_max, const size_t num_points)
+    : TabulatedBoundary(alpha, num_points) {
+  assert(0 < v_min && v_min < v_max);
+  assert(num_points >= 2);
+  assert(0 < alpha && alpha < 1);
+  double* grid = grid_storage();
+  double* values = values_storage();
+  const double log_step = log(v_max / v_min) / (num_points - 1);
+  for (size_t i = 0; i < num_points; i++) {
+    grid[i] = v_min * exp(i * log_step);
+  }
+  grid[num_points - 1] = v_max;
+  mixture_superMG.bound_sequence(grid, num_points, log(1 / alpha), values);
+  // Round up past the root-finding tolerance, then enforce monotonicity in
+  // case of solver noise.
+  for (size_t i = 0; i < num_points; i++) {
+    values[i] *= 1 + 1e-10;
+    if (i > 0) {
+      values[i] = std::max(values[i], values[i - 1]);
+    }
+  }
+  compute_slopes();
+}
+
+CONFSEQ_INLINE TabulatedBoundary::TabulatedBoundary(const double alpha,
+                                                    const size_t num_points)
+    : alpha_(alpha), num_points_(num_points) {
+  double* data = new double[3 * num_points];
+  storage_.reset(data, std::default_delete<double[]>());
+  grid_ = data;
+  values_ = data + num_points;
+  slopes_ = data + 2 * num_points;
+}
+
+CONFSEQ_INLINE TabulatedBoundary::TabulatedBoundary(
+    const double alpha, const size_t num_points,
+    std::shared_ptr<const double> storage, const double* data)
+    : alpha_(alpha), num_points_(num_points), storage_(std::move(storage)),
+      grid_(data), values_(data + num_points),
+      slopes_(data + 2 * num_points) {
+  log_v_min_ = log(grid_[0]);
+  log_step_ = log(grid_[num_points - 1] / grid_[0]) / (num_points - 1);
+}
+
+CONFSEQ_INLINE void TabulatedBoundary::compute_slopes() {
+  log_v_min_ = log(grid_[0]);
+  log_step_ = log(grid_[num_points_ - 1] / grid_[0]) / (num_points_ - 1);
+  double* slopes = const_cast<double*>(slopes_);
+  for (size_t i = 0; i + 1 < num_points_; i++) {
+    slopes[i] = (values_[i + 1] - values_[i]) / (grid_[i + 1] - grid_[i]);
+  }
+  slopes[num_points_ - 1] = 0;
+}
+
+CONFSEQ_INLINE void TabulatedBoundary::check_table() const {
+  if (!(grid_[0] > 0)) {
+    throw std::runtime_error("Invalid tabulated boundary data");
+  }
+  for (size_t i = 0; i < num_points_; i++) {
+    if (!(std::isfinite(grid_[i]) && std::isfinite(values_[i])
+          && (i == 0 || grid_[i] > grid_[i - 1])
+          && (i + 1 == num_points_ || std::isfinite(slopes_[i])))) {
+      throw std::runtime_error("Invalid tabulated boundary data");
+    }
+  }
+}
+
+CONFSEQ_INLINE double TabulatedBoundary::operator()(const double v) const {
+  const size_t last = num_points_ - 1;
+  if (v <= grid_[0]) {
+    return values_[0];
+  } else if (v >= grid_[last]) {
+    return values_[last] + slopes_[last - 1] * (v - grid_[last]);
+  }
+  size_t i = std::min<size_t>((log(v) - log_v_min_) / log_step_, last - 1);
+  // guard against rounding in the index computation
+  if (v < grid_[i]) {
+    i--;
+  } else if (v > grid_[i + 1]) {
+    i++;
+  }
+  double envelope = values_[i + 1];
+  if (i > 0) {
+    envelope = std::min(envelope,
+                        values_[i] + slopes_[i - 1] * (v - grid_[i]));
+  }
+  if (i + 1 < last) {
+    envelope = std::min(envelope,
+                        values_[i + 1] + slopes_[i + 1] * (v - grid_[i + 1]));
+  }
+  return envelope;
+}
+
+CONFSEQ_INLINE void TabulatedBoundary::bound_sequence(const float* v,
+                                                      const size_t n,
+                                                      float* out) const {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = round_up_to_float((*this)(v[i]));
+  }
+}
+
+CONFSEQ_INLINE BoundarySequence::BoundarySequence(
+    std::unique_ptr<MixtureSupermartingale>&& mixture_superMG,
+    const double alpha, const size_t size, const double v_scale,
+    const double v_offset, const size_t chunk_size)
+    : mixture_superMG_(std::move(mixture_superMG)), alpha_(alpha),
+      log_threshold_(log(1 / alpha)), size_(size), v_scale_(v_scale),
+      v_offset_(v_offset), chunk_size_(chunk_size) {
+  if (!(0 < alpha && alpha < 1)) {
+    throw std::invalid_argument("alpha must be in (0, 1)");
+  }
+  if (!(v_scale > 0 && v_scale + v_offset > 0)) {
+    throw std::invalid_argument(
+        "v_scale must be positive and v_scale + v_offset, the first v, must "
+        "be positive");
+  }
+  if (chunk_size == 0) {
+    throw std::invalid_argument("chunk_size must be positive");
+  }
+}
+
+CONFSEQ_INLINE double BoundarySequence::operator[](const size_t i) {
+  if (i >= size_) {
+    throw std::out_of_range("BoundarySequence index out of range");
+  }
+  const size_t index = i / chunk_size_;
+  auto found = chunks_.find(index);
+  if (found == chunks_.end()) {
+    const size_t begin = index * chunk_size_;
+    std::vector<double> chunk(std::min(chunk_size_, size_ - begin));
+    evaluate(begin, begin + chunk.size(), chunk.data());
+    found = chunks_.emplace(index, std::move(chunk)).first;
+  }
+  return found->second[i - index * chunk_size_];
+}
+
+CONFSEQ_INLINE void BoundarySequence::values(const size_t begin,
+                                             const size_t end,
+                                             double* out) const {
+  if (begin > end || end > size_) {
+    throw std::out_of_range("BoundarySequence range out of range");
+  }
+  size_t i = begin;
+  while (i < end) {
+    const size_t index = i / chunk_size_;
+    const size_t chunk_end = std::min((index + 1) * chunk_size_, end);
+    const auto found = chunks_.find(index);
+    if (found != chunks_.end()) {
+      std::copy(found->second.begin() + (i - index * chunk_size_),
+                found->second.begin() + (chunk_end - index * chunk_size_),
+                out + (i - begin));
+      i = chunk_end;
+      continue;
+    }
+    // Evaluate up to the next cached chunk in one warm-started pass.
+    const auto next = chunks_.lower_bound(index);
+    const size_t stop = next == chunks_.end()
+        ? end : std::min(end, next->first * chunk_size_);
+    evaluate(i, stop, out + (i - begin));
+    i = stop;
+  }
+}
+
+CONFSEQ_INLINE void BoundarySequence::discard_before(const size_t i) {
+  chunks_.erase(chunks_.begin(), chunks_.lower_bound(i / chunk_size_));
+}
+
+CONFSEQ_INLINE void BoundarySequence::evaluate(const size_t begin,
+                                               const size_t end,
+                                               double* out) const {
+  std::vector<double> v(std::min(chunk_size_, end - begin));
+  for (size_t first = begin; first < end; first += v.size()) {
+    const size_t n = std::min(v.size(), end - first);
+    for (size_t i = 0; i < n; i++) {
+      v[i] = this->v(first + i);
+    }
+    mixture_superMG_->bound_sequence(v.data(), n, log_threshold_,
+                                     out + (first - begin));
+  }
+}
+
+namespace tabulated_boundary_format {
+const char MAGIC[8] = {'C', 'S', 'T', 'A', 'B', 'L', 'E', '\0'};
+const uint32_t VERSION = 2;
+// Version 1 header: magic, version, alpha, num_points, unaligned, followed by
+// the grid and values.
+const size_t V1_HEADER_SIZE = 28;
+// Version 2 header: magic, version, 4 bytes of padding, alpha, num_points.
+// The grid, values and slopes follow, num_points each, in native byte order
+// and 8-byte aligned.
+const size_t HEADER_SIZE = 32;
+const uint64_t MAX_POINTS = uint64_t(1) << 40;
+};
+
+CONFSEQ_INLINE void TabulatedBoundary::save(std::ostream& out) const {
+  const uint32_t padding = 0;
+  const uint64_t num_points = num_points_;
+  out.write(tabulated_boundary_format::MAGIC,
+            sizeof(tabulated_boundary_format::MAGIC));
+  out.write(reinterpret_cast<const char*>(&tabulated_boundary_format::VERSION),
+            sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&padding), sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&alpha_), sizeof(double));
+  out.write(reinterpret_cast<const char*>(&num_points), sizeof(uint64_t));
+  for (const double* column : {grid_, values_, slopes_}) {
+    out.write(reinterpret_cast<const char*>(column),
+              num_points * sizeof(double));
+  }
+}
+
+CONFSEQ_INLINE TabulatedBoundary TabulatedBoundary::load(std::istream& in) {
+  char header[tabulated_boundary_format::HEADER_SIZE] = {};
+  uint32_t version;
+  double alpha;
+  uint64_t num_points;
+  in.read(header, tabulated_boundary_format::V1_HEADER_SIZE);
+  memcpy(&version, header + 8, sizeof(uint32_t));
+  if (in && version == 1) {
+    memcpy(&alpha, header + 12, sizeof(double));
+    memcpy(&num_points, header + 20, sizeof(uint64_t));
+  } else {
+    in.read(header + tabulated_boundary_format::V1_HEADER_SIZE,
+            tabulated_boundary_format::HEADER_SIZE
+            - tabulated_boundary_format::V1_HEADER_SIZE);
+    memcpy(&alpha, header + 16, sizeof(double));
+    memcpy(&num_points, header + 24, sizeof(uint64_t));
+  }
+  if (!in || memcmp(header, tabulated_boundary_format::MAGIC,
+                    sizeof(tabulated_boundary_format::MAGIC))
+      || (version != 1 && version != tabulated_boundary_format::VERSION)
+      || !(0 < alpha && alpha < 1) || num_points < 2
+      || num_points > tabulated_boundary_format::MAX_POINTS) {
+    throw std::runtime_error("Invalid tabulated boundary data");
+  }
+  // The grid is read before the table is allocated, so that a corrupt
+  // num_points fails as truncated data.
+  const std::vector<double> grid = read_array<double>(in, num_points);
+  if (!in) {
+    throw std::runtime_error("Truncated tabulated boundary data");
+  }
+  TabulatedBoundary table(alpha, num_points);
+  std::copy(grid.begin(), grid.end(), table.grid_storage());
+  in.read(reinterpret_cast<char*>(table.values_storage()),
+          num_points * sizeof(double));
+  if (!in) {
+    throw std::runtime_error("Truncated tabulated boundary data");
+  }
+  // Slopes are recomputed rather than read, giving the same values.
+  table.compute_slopes();
+  table.check_table();
+  if (version != 1) {
+    in.ignore(num_points * sizeof(double));
+    if (!in) {
+      throw std::runtime_error("Truncated tabulated boundary data");
+    }
+  }
+  return table;
+}
+
+CONFSEQ_INLINE TabulatedBoundary TabulatedBoundary::map_file(
+    const std::string& path) {
+#ifdef CONFSEQ_HAVE_MMAP
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || size_t(file_stat.st_size) < tabulated_boundary_format::HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Invalid tabulated boundary data");
+  }
+  const size_t file_size = file_stat.st_size;
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + path);
+  }
+  std::shared_ptr<const double> storage(
+      static_cast<const double*>(mapping),
+      [file_size](const double* data) {
+        munmap(const_cast<double*>(data), file_size);
+      });
+  const char* header = static_cast<const char*>(mapping);
+  uint32_t version;
+  double alpha;
+  uint64_t num_points;
+  memcpy(&version, header + 8, sizeof(uint32_t));
+  memcpy(&alpha, header + 16, sizeof(double));
+  memcpy(&num_points, header + 24, sizeof(uint64_t));
+  if (version == 1) {
+    // Unaligned and without slopes, so read rather than mapped.
+    std::ifstream in(path, std::ios::binary);
+    return load(in);
+  }
+  if (memcmp(header, tabulated_boundary_format::MAGIC,
+             sizeof(tabulated_boundary_format::MAGIC))
+      || version != tabulated_boundary_format::VERSION
+      || !(0 < alpha && alpha < 1) || num_points < 2
+      || num_points > tabulated_boundary_format::MAX_POINTS) {
+    throw std::runtime_error("Invalid tabulated boundary data");
+  }
+  if (file_size < tabulated_boundary_format::HEADER_SIZE
+      + 3 * num_points * sizeof(double)) {
+    throw std::runtime_error("Truncated tabulated boundary data");
+  }
+  const double* data = storage.get()
+      + tabulated_boundary_format::HEADER_SIZE / sizeof(double);
+  TabulatedBoundary table(alpha, num_points, std::move(storage), data);
+  table.check_table();
+  return table;
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  return load(in);
+#endif
+}
+
+CONFSEQ_INLINE TabulatedBetaBinomialMixture::TabulatedBetaBinomialMixture(
+    const BetaBinomialMixture& mixture_superMG, const double v_min,
+    const double v_max, const size_t num_v, const size_t num_z,
+    const double z_max)
+    : mixture_superMG_(mixture_superMG), num_z_(num_z),
+      log_v_min_(log(v_min)), log_step_(log(v_max / v_min) / (num_v - 1)) {
+  if (!(0 < v_min && v_min < v_max) || num_v < 3 || num_z < 3
+      || !(z_max > 0)) {
+    throw std::invalid_argument(
+        "Need 0 < v_min < v_max, num_v >= 3, num_z >= 3 and z_max > 0");
+  }
+  v_.resize(num_v);
+  sqrt_v_.resize(num_v);
+  z_min_.resize(num_v);
+  z_step_.resize(num_v);
+  slack_.resize(num_v);
+  values_.resize(num_v * num_z);
+  slopes_.resize(num_v * (num_z - 1));
+  const double g = mixture_superMG_.g(), h = mixture_superMG_.h();
+  // Extending a chord across a row or across rows weights table values by at
+  // most 3 and 1 + 2 exp(log_step) in absolute value.
+  const double weight = 3 * (1 + 2 * exp(log_step_));
+  double row_error = 0;
+  for (size_t k = 0; k < num_v; k++) {
+    v_[k] = k + 1 < num_v ? v_min * exp(k * log_step_) : v_max;
+    sqrt_v_[k] = sqrt(v_[k]);
+    z_min_[k] = std::max(-z_max, -sqrt_v_[k] / h);
+    const double z_end = std::min(z_max, sqrt_v_[k] / g);
+    z_step_[k] = (z_end - z_min_[k]) / (num_z - 1);
+    double* values = &values_[k * num_z];
+    for (size_t i = 0; i < num_z; i++) {
+      const double z = i + 1 < num_z ? z_min_[k] + i * z_step_[k] : z_end;
+      values[i] = mixture_superMG_.log_superMG(z * sqrt_v_[k], v_[k]);
+    }
+    for (size_t i = 0; i + 1 < num_z; i++) {
+      slopes_[k * (num_z - 1) + i] = (values[i + 1] - values[i]) / z_step_[k];
+    }
+    // Rounding in the log mixture grows with its special-function arguments.
+    const double scale = mixture_superMG_.special_function_scale(v_[k]);
+    row_error = std::max(
+        row_error,
+        mixture_superMG_.precision().log_superMG_error(scale)
+            + 64 * std::numeric_limits<double>::epsilon()
+                * (1 + scale * (1 + log1p(scale))));
+    slack_[k] = weight * row_error;
+  }
+}
+
+CONFSEQ_INLINE std::pair<double, double>
+TabulatedBetaBinomialMixture::row_bounds(const size_t k, const double u)
+    const {
+  const double infinity = std::numeric_limits<double>::infinity();
+  const double* values = &values_[k * num_z_];
+  const double* slopes = &slopes_[k * (num_z_ - 1)];
+  const size_t last = num_z_ - 1;
+  const double z = u * sqrt_v_[k];
+  const double t = (z - z_min_[k]) / z_step_[k];
+  // Past either end of the row, only the extended end chord is known.
+  if (!(t > 0)) {
+    return {values[0] + slopes[0] * (z - z_min_[k]),
+            t == 0 ? values[0] : infinity};
+  } else if (!(t < last)) {
+    const double z_last = z_min_[k] + (last - 1) * z_step_[k];
+    return {values[last - 1] + slopes[last - 1] * (z - z_last),
+            t == last ? values[last] : infinity};
+  }
+  const size_t i = std::min<size_t>(t, last - 1);
+  const double offset = z - (z_min_[k] + i * z_step_[k]);
+  double lower = -infinity;
+  if (i > 0) {
+    lower = values[i] + slopes[i - 1] * offset;
+  }
+  if (i + 1 < last) {
+    lower = std::max(lower, values[i + 1]
+                                + slopes[i + 1] * (offset - z_step_[k]));
+  }
+  return {lower, values[i] + slopes[i] * offset};
+}
+
+CONFSEQ_INLINE std::pair<double, double>
+TabulatedBetaBinomialMixture::log_superMG_bounds(const double s,
+                                                 const double v) const {
+  const double infinity = std::numeric_limits<double>::infinity();
+  const size_t last = v_.size() - 1;
+  if (!(v_.front() <= v && v <= v_.back()
+        && -v / mixture_superMG_.h() <= s && s <= v / mixture_superMG_.g())) {
+    const double exact = mixture_superMG_.log_superMG(s, v);
+    return {exact, exact};
+  }
+  size_t j = std::min<size_t>((log(v) - log_v_min_) / log_step_, last - 1);
+  // guard against rounding in the index computation
+  if (v < v_[j]) {
+    j--;
+  } else if (v > v_[j + 1]) {
+    j++;
+  }
+  const double u = s / v;
+  const std::pair<double, double> row = row_bounds(j, u);
+  const std::pair<double, double> next_row = row_bounds(j + 1, u);
+  // Extend the chords across the rows on either side. Each needs an upper
+  // bound on its outer row.
+  double lower = -infinity;
+  if (j > 0) {
+    const double previous_upper = row_bounds(j - 1, u).second;
+    if (previous_upper < infinity) {
+      lower = row.first
+          + (row.first - previous_upper) / (v_[j] - v_[j - 1]) * (v - v_[j]);
+    }
+  }
+  if (j + 1 < last) {
+    const double following_upper = row_bounds(j + 2, u).second;
+    if (following_upper < infinity) {
+      lower = std::max(lower, next_row.first
+          + (following_upper - next_row.first) / (v_[j + 2] - v_[j + 1])
+              * (v - v_[j + 1]));
+    }
+  }
+  if (lower == -infinity) {
+    const double exact = mixture_superMG_.log_superMG(s, v);
+    return {exact, exact};
+  }
+  const double upper = row.second < infinity && next_row.second < infinity
+      ? row.second
+          + (next_row.second - row.second) / (v_[j + 1] - v_[j]) * (v - v_[j])
+      : infinity;
+  const double slack = slack_[std::min(j + 2, last)];
+  return {lower - slack, upper + slack};
+}
+
+CONFSEQ_INLINE double TabulatedBetaBinomialMixture::log_superMG(
+    const double s, const double v) const {
+  return log_superMG_bounds(s, v).first;
+}
+
+CONFSEQ_INLINE double EmpiricalProcessLILBound::operator()(const double t)
+    const {
+  if (t < t_min_) {
+    return std::numeric_limits<double>::infinity();
+  } else {
+    return A_ * sqrt((log(1 + log(t / t_min_)) + C_) / t);
+  }
+}
+
+CONFSEQ_INLINE void EmpiricalProcessLILBound::bound_sequence(
+    const float* t, const size_t n, float* out) const {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = round_up_to_float((*this)(t[i]));
+  }
+}
+
+CONFSEQ_INLINE double EmpiricalProcessLILBound::find_optimal_C(
+    const double alpha, const double A, const SolverPrecision& precision) {
+  double C;
+  if (find_bundled_constant(BundledConstant::EMPIRICAL_PROCESS_LIL_C,
+                            {alpha, A, precision.cache_key(), 0}, C)) {
+    return C;
+  }
+  static BoundaryCache cache(1024);
+  return cache.get_or_compute({alpha, A, precision.cache_key()}, [&]() {
+    return std::make_pair(compute_optimal_C(alpha, A, precision), 0.0);
+  }).first;
+}
+
+// A larger C gives a larger bound, so the conservative end of the final
+// bracket is its upper end.
+CONFSEQ_INLINE double EmpiricalProcessLILBound::compute_optimal_C(
+    const double alpha, const double A, const SolverPrecision& precision) {
+  auto error_bound = [A](const double C, const double eta) {
+    const double gamma_sq = 2 / eta * pow(A - sqrt(2 * (eta - 1) / C), 2);
+    if (gamma_sq <= 1) {
+      return std::numeric_limits<double>::infinity();
+    } else {
+      return 4 * exp(-gamma_sq * C) * (1 + 1 / ((gamma_sq - 1) * log(eta)));
+    }
+  };
+
+  auto charged = [](const double value) {
+    if (solve_budget_exhausted()) {
+      throw SolveBudgetExhausted();
+    }
+    return value;
+  };
+  auto optimum_error = [A, error_bound, charged](const double C) {
+    auto eta_upper_result = boost::math::tools::bisect(
+        [A, C, charged](const double eta) {
+          return charged(sqrt(eta / 2) + sqrt(2 * (eta - 1) / C) - A);
+        },
+        1.0, 2 * A * A, boost::math::tools::eps_tolerance<double>(40));
+    double eta_upper = (eta_upper_result.first + eta_upper_result.second) / 2;
+    return boost::math::tools::brent_find_minima(
+        [C, error_bound, charged](const double eta) {
+          return charged(error_bound(C, eta));
+        },
+        1.0, eta_upper, 24);
+  };
+
+  // The error bound at any eta is valid, so the least C whose bound was
+  // found within alpha is returned if the budget runs out.
+  double valid_C = std::numeric_limits<double>::infinity();
+  boost::uintmax_t max_iter = 50;
+  try {
+    auto C_result = boost::math::tools::bracket_and_solve_root(
+        [alpha, optimum_error, &valid_C](const double C) {
+          const double excess = optimum_error(C).second - alpha;
+          if (excess <= 0) {
+            valid_C = std::min(valid_C, C);
+          }
+          return excess;
+        },
+        5.0,
+        2.0,
+        false,
+        boost::math::tools::eps_tolerance<double>(precision.bits),
+        max_iter);
+    return precision.conservative ? C_result.second
+        : (C_result.first + C_result.second) / 2;
+  } catch (const SolveBudgetExhausted&) {
+    return valid_C;
+  }
+}
+
+CONFSEQ_INLINE double logit(const double p) {
+  assert(0 < 1 && p < 1);
+  return log(p / (1 - p));
+}
+
+CONFSEQ_INLINE double expit(const double l) {
+  return 1 / (1 + exp(-l));
+}
+
+// log(2 zeta(s) (2 zeta(s) + 1) / log(eta)^s), the part of ell that depends
+// on neither p, t nor alpha.
+CONFSEQ_INLINE double DoubleStitchingBound::get_log_epoch_constant(
+    const double s, const double eta) {
+  const double zeta_s = boost::math::zeta(s, MathPolicy());
+  return log(2 * zeta_s * (2 * zeta_s + 1) / pow(log(eta), s));
+}
+
+CONFSEQ_INLINE double DoubleStitchingBound::evaluate(
+    const double p, const double t_max_m, const double sqrt_t,
+    const double log_log_t, const double log_alpha) const {
+  const double logit_p = logit(p);
+  const double r = p >= 0.5 ? p
+      : std::min(0.5, expit(logit_p + 2 * delta_ * sqrt(eta_) / sqrt_t));
+  const double sigma_sq = r * (1 - r);
+  const double j = sqrt_t * std::abs(logit_p) / (2 * delta_) + 1;
+  const double ell = s_ * log_log_t + s_ * log(j) + log_epoch_constant_
+      - log_alpha;
+  const double cp = (1 - 2 * p) / 3;
+  const double term2 = k2_ * cp * ell;
+  return delta_ * sqrt(eta_ * t_max_m * sigma_sq / t_opt_)
+      + sqrt(k1_ * k1_ * sigma_sq * t_max_m * ell + term2 * term2) + term2;
+}
+
+CONFSEQ_INLINE double DoubleStitchingBound::operator()(const double p,
+                                                       const double t,
+                                                       const double alpha)
+    const {
+  double out;
+  band(&p, 1, t, alpha, &out);
+  return out;
+}
+
+CONFSEQ_INLINE void DoubleStitchingBound::band(
+    const double* p, const size_t n, const double t, const double alpha,
+    double* out) const {
+  const double t_max_m = std::max(t, t_opt_);
+  const double sqrt_t = sqrt(t_max_m / t_opt_);
+  const double log_log_t = log(log(eta_ * t_max_m / t_opt_));
+  const double log_alpha = log(alpha);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = evaluate(p[i], t_max_m, sqrt_t, log_log_t, log_alpha);
+  }
+}
+
+CONFSEQ_INLINE void DoubleStitchingBound::band(
+    const float* p, const size_t n, const double t, const double alpha,
+    float* out) const {
+  const double t_max_m = std::max(t, t_opt_);
+  const double sqrt_t = sqrt(t_max_m / t_opt_);
+  const double log_log_t = log(log(eta_ * t_max_m / t_opt_));
+  const double log_alpha = log(alpha);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = round_up_to_float(
+        evaluate(p[i], t_max_m, sqrt_t, log_log_t, log_alpha));
+  }
+}
+
+CONFSEQ_INLINE void DoubleStitchingBound::band_indices(
+    const double* p, const size_t n, const double t, const double alpha,
+    double* lower_index, double* upper_index) const {
+  const double t_max_m = std::max(t, t_opt_);
+  const double sqrt_t = sqrt(t_max_m / t_opt_);
+  const double log_log_t = log(log(eta_ * t_max_m / t_opt_));
+  const double log_alpha = log(alpha);
+  for (size_t i = 0; i < n; i++) {
+    lower_index[i] = floor(
+        t * p[i] - evaluate(1 - p[i], t_max_m, sqrt_t, log_log_t, log_alpha)
+        + 1);
+    upper_index[i] = ceil(
+        t * p[i] + evaluate(p[i], t_max_m, sqrt_t, log_log_t, log_alpha));
+  }
+}
+
+// The order statistic of order_stats at index, or -/+ infinity when the index
+// is below 1 or above the sample size.
+CONFSEQ_INLINE double order_statistic_or_infinity(
+    const OrderStatisticInterface& order_stats, const double index) {
+  if (index < 1) {
+    return -std::numeric_limits<double>::infinity();
+  } else if (index > order_stats.size()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return order_stats.get_order_statistic(int(index));
+}
+
+CONFSEQ_INLINE void DoubleStitchingBound::quantile_band(
+    const OrderStatisticInterface& order_stats, const double* p,
+    const size_t n, const double alpha, double* lower, double* upper) const {
+  band_indices(p, n, order_stats.size(), alpha, lower, upper);
+  for (size_t i = 0; i < n; i++) {
+    lower[i] = order_statistic_or_infinity(order_stats, lower[i]);
+    upper[i] = order_statistic_or_infinity(order_stats, upper[i]);
+  }
+}
+
+CONFSEQ_INLINE void DoubleStitchingBound::band_matrix(
+    const double* t, const size_t num_times, const double* p,
+    const size_t num_p, const double alpha, double* out,
+    const int num_threads) const {
+  parallel_for(num_times, [&](const size_t i) {
+    band(p, num_p, t[i], alpha, out + i * num_p);
+  }, num_threads, std::max<size_t>(1, 4096 / std::max<size_t>(num_p, 1)));
+}
+
+// Replaces the order statistic indices in rows i < num_times of lower and
+// upper, num_p to a row, by the order statistics of x[0..t[i]), inserting
+// each value of x once as t grows.
+CONFSEQ_INLINE void read_out_band_matrix(
+    const double* x, const size_t* t, const size_t num_times,
+    const size_t num_p, double* lower, double* upper) {
+  DynamicOrderStatistics order_stats;
+  size_t inserted = 0;
+  for (size_t i = 0; i < num_times; i++) {
+    order_stats.insert(x + inserted, x + t[i]);
+    inserted = t[i];
+    for (size_t j = i * num_p; j < (i + 1) * num_p; j++) {
+      lower[j] = order_statistic_or_infinity(order_stats, lower[j]);
+      upper[j] = order_statistic_or_infinity(order_stats, upper[j]);
+    }
+  }
+}
+
+CONFSEQ_INLINE void check_band_matrix_times(const size_t* t,
+                                            const size_t num_times) {
+  for (size_t i = 1; i < num_times; i++) {
+    if (t[i] < t[i - 1]) {
+      throw std::invalid_argument("times must be nondecreasing");
+    }
+  }
+}
+
+CONFSEQ_INLINE void DoubleStitchingBound::quantile_band_matrix(
+    const double* x, const size_t* t, const size_t num_times, const double* p,
+    const size_t num_p, const double alpha, double* lower, double* upper,
+    const int num_threads) const {
+  check_band_matrix_times(t, num_times);
+  parallel_for(num_times, [&](const size_t i) {
+    band_indices(p, num_p, t[i], alpha, lower + i * num_p,
+                 upper + i * num_p);
+  }, num_threads, std::max<size_t>(1, 4096 / std::max<size_t>(num_p, 1)));
+  read_out_band_matrix(x, t, num_times, num_p, lower, upper);
+}
+
+CONFSEQ_INLINE void EmpiricalProcessLILBound::ecdf_band(
+    const OrderStatisticInterface& order_stats, const double* x,
+    const size_t n, double* lower, double* upper) const {
+  const int t = order_stats.size();
+  const double radius = t == 0 ? std::numeric_limits<double>::infinity()
+      : (*this)(t);
+  std::vector<int> counts(radius < 1 ? n : 0);
+  order_stats.count_less_or_equal_batch(x, counts.size(), counts.data(), 1);
+  for (size_t i = 0; i < n; i++) {
+    const double cdf = radius < 1 ? double(counts[i]) / t : 0;
+    lower[i] = std::max(0.0, cdf - radius);
+    upper[i] = std::min(1.0, cdf + radius);
+  }
+}
+
+CONFSEQ_INLINE void EmpiricalProcessLILBound::ecdf_band(
+    const OrderStatisticInterface& order_stats, std::vector<double>* values,
+    std::vector<double>* lower, std::vector<double>* upper) const {
+  const int t = order_stats.size();
+  const double radius = t == 0 ? std::numeric_limits<double>::infinity()
+      : (*this)(t);
+  values->clear();
+  lower->clear();
+  upper->clear();
+  for (int k = 1; k <= t;) {
+    const double value = order_stats.get_order_statistic(k);
+    const int count = std::max(k, order_stats.count_less_or_equal(value));
+    const double cdf = double(count) / t;
+    values->push_back(value);
+    lower->push_back(std::max(0.0, cdf - radius));
+    upper->push_back(std::min(1.0, cdf + radius));
+    k = count + 1;
+  }
+}
+
+CONFSEQ_INLINE void EmpiricalProcessLILBound::quantile_band_matrix(
+    const double* x, const size_t* t, const size_t num_times, const double* p,
+    const size_t num_p, double* lower, double* upper,
+    const int num_threads) const {
+  check_band_matrix_times(t, num_times);
+  parallel_for(num_times, [&](const size_t i) {
+    const double n = t[i];
+    const double radius = n < t_min_ ? std::numeric_limits<double>::infinity()
+        : n * (*this)(n);
+    for (size_t j = i * num_p; j < (i + 1) * num_p; j++) {
+      lower[j] = floor(n * p[j - i * num_p] - radius + 1);
+      upper[j] = ceil(n * p[j - i * num_p] + radius);
+    }
+  }, num_threads, std::max<size_t>(1, 4096 / std::max<size_t>(num_p, 1)));
+  read_out_band_matrix(x, t, num_times, num_p, lower, upper);
+}
+
+CONFSEQ_INLINE double QuantileABTest::p_value() const {
+  const TraceScope trace(TracedFunction::QUANTILE_AB_P_VALUE,
+                         arm1_os_->size() + arm2_os_->size());
+  return std::min(1.0, exp(-log_superMG_lower_bound()));
+}
+
+CONFSEQ_INLINE double QuantileABTest::p_value(Minimizers& minimizers) const {
+  const TraceScope trace(TracedFunction::QUANTILE_AB_P_VALUE,
+                         arm1_os_->size() + arm2_os_->size());
+  return std::min(1.0, exp(-log_superMG_lower_bound(
+      -std::numeric_limits<double>::infinity(), &minimizers)));
+}
+
+CONFSEQ_INLINE bool QuantileABTest::rejects(const double alpha) const {
+  const double log_threshold = log(1 / alpha);
+  return log_superMG_lower_bound(log_threshold) >= log_threshold;
+}
+
+CONFSEQ_INLINE double QuantileABTest::capped_p_value(const double max_p) const {
+  Minimizers minimizers = {0, 0};
+  return capped_p_value(max_p, minimizers);
+}
+
+CONFSEQ_INLINE double QuantileABTest::capped_p_value(
+    const double max_p, Minimizers& minimizers) const {
+  const double log_threshold = log(1 / max_p);
+  const double lower_bound = log_superMG_lower_bound(log_threshold,
+                                                     &minimizers);
+  return lower_bound < log_threshold ? 1
+      : std::min(1.0, exp(-lower_bound));
+}
+
+CONFSEQ_INLINE double QuantileABTest::shifted_p_value(const double delta)
+    const {
+  const TraceScope trace(TracedFunction::QUANTILE_AB_P_VALUE,
+                         arm1_os_->size() + arm2_os_->size());
+  return std::min(1.0, exp(-pair_log_superMG_lower_bound(
+      get_G_fn(*arm1_os_), shifted_G_fn(get_G_fn(*arm2_os_), delta), 0,
+      -std::numeric_limits<double>::infinity())));
+}
+
+CONFSEQ_INLINE bool QuantileABTest::shifted_rejects(const double delta,
+                                                    const double alpha) const {
+  return shifted_rejects(get_G_fn(*arm1_os_), get_G_fn(*arm2_os_), delta,
+                         log(1 / alpha));
+}
+
+CONFSEQ_INLINE bool QuantileABTest::shifted_rejects(
+    const GFunction& arm_1_G, const GFunction& arm_2_G, const double delta,
+    const double log_threshold) const {
+  const double middle = (empirical_quantile(*arm1_os_)
+                         + empirical_quantile(*arm2_os_) + delta) / 2;
+  return pair_log_superMG_lower_bound(arm_1_G, shifted_G_fn(arm_2_G, delta),
+                                      middle, log_threshold)
+      >= log_threshold;
+}
+
+// Away from the shifts at which the arms' minimum intervals overlap, the
+// infimum of G_1(x) + G_2(x - delta) can only grow with the distance, as each
+// G is monotone outside its minimum interval. So the rejected shifts are two
+// half-lines, and each end of the interval between them is bracketed by a
+// shift in the overlap, where the infimum is the sum of the minima and never
+// rejects, and one beyond the pooled range, past which the two arms no longer
+// interleave and the infimum stops changing.
+CONFSEQ_INLINE std::pair<double, double>
+QuantileABTest::quantile_difference_cs(const double alpha,
+                                       const double tolerance) const {
+  if (!(0 < alpha && alpha < 1) || !(tolerance > 0)) {
+    throw std::invalid_argument(
+        "alpha must be in (0, 1) and tolerance positive");
+  }
+  const double infinity = std::numeric_limits<double>::infinity();
+  const int arm1_size = arm1_os_->size(), arm2_size = arm2_os_->size();
+  if (arm1_size == 0 || arm2_size == 0) {
+    return {-infinity, infinity};
+  }
+  const GFunction arm_1_G = get_G_fn(*arm1_os_);
+  const GFunction arm_2_G = get_G_fn(*arm2_os_);
+  const double log_threshold = log(1 / alpha);
+  const auto rejects = [&](const double delta) {
+    return shifted_rejects(arm_1_G, arm_2_G, delta, log_threshold);
+  };
+
+  const double arm1_min = arm1_os_->get_order_statistic(1);
+  const double arm1_max = arm1_os_->get_order_statistic(arm1_size);
+  const double arm2_min = arm2_os_->get_order_statistic(1);
+  const double arm2_max = arm2_os_->get_order_statistic(arm2_size);
+  double range = std::max(arm1_max, arm2_max) - std::min(arm1_min, arm2_min);
+  if (!(range > 0)) {
+    range = 1;
+  }
+  const double center =
+      (arm_1_G.minimum_start_x + arm_1_G.minimum_end_x) / 2
+      - (arm_2_G.minimum_start_x + arm_2_G.minimum_end_x) / 2;
+  // Bisects between a shift that is not rejected and one that is, returning
+  // the rejected end so that the interval only widens.
+  const auto end = [&](double accepted, double rejected) {
+    while (std::abs(rejected - accepted) > tolerance * range) {
+      const double middle = accepted + (rejected - accepted) / 2;
+      if (middle == accepted || middle == rejected) {
+        break;
+      }
+      (rejects(middle) ? rejected : accepted) = middle;
+    }
+    return rejected;
+  };
+  const double lower_far = arm1_min - arm2_max - range;
+  const double upper_far = arm1_max - arm2_min + range;
+  return {rejects(lower_far) ? end(center, lower_far) : -infinity,
+          rejects(upper_far) ? end(center, upper_far) : infinity};
+}
+
+CONFSEQ_INLINE double QuantileABTest::log_superMG_lower_bound(
+    const double stop_below, Minimizers* minimizers) const {
+  const GFunction arm_1_G =
+      get_G_fn(*arm1_os_, minimizers ? &(*minimizers)[0] : nullptr);
+  const GFunction arm_2_G =
+      get_G_fn(*arm2_os_, minimizers ? &(*minimizers)[1] : nullptr);
+  const double middle =
+      stop_below > -std::numeric_limits<double>::infinity()
+      ? (empirical_quantile(*arm1_os_) + empirical_quantile(*arm2_os_)) / 2
+      : 0;
+  return pair_log_superMG_lower_bound(arm_1_G, arm_2_G, middle, stop_below);
+}
+
+CONFSEQ_INLINE double QuantileABTest::pair_log_superMG_lower_bound(
+    const GFunction& arm_1_G, const GFunction& arm_2_G, const double middle,
+    const double stop_below) const {
+  // Between the two empirical quantiles G is usually near its infimum, so
+  // with a stopping threshold this point alone often settles the search.
+  if (stop_below > -std::numeric_limits<double>::infinity()) {
+    const double mid_value = G(arm_1_G, middle) + G(arm_2_G, middle);
+    if (mid_value < stop_below) {
+      return mid_value;
+    }
+  }
+  if (arm_1_G.minimum_end_x <= arm_2_G.minimum_end_x) {
+    return find_log_superMG_lower_bound(arm_1_G, arm_2_G, stop_below);
+  } else {
+    return find_log_superMG_lower_bound(arm_2_G, arm_1_G, stop_below);
+  }
+}
+
+CONFSEQ_INLINE double QuantileABTest::empirical_quantile(
+    const OrderStatisticInterface& os) const {
+  int position = floor(os.size() * quantile_p_) + 1;
+  return os.get_order_statistic(position);
+}
+
+CONFSEQ_INLINE std::shared_ptr<const TabulatedBetaBinomialMixture>
+QuantileABTest::tabulate_mixture(const double quantile_p, const int t_opt,
+                                 const double alpha_opt,
+                                 const int max_arm_size) {
+  // Constructed exactly as in the constructor, so that the parameters match.
+  const BetaBinomialMixture mixture(t_opt * quantile_p * (1 - quantile_p),
+                                    alpha_opt, quantile_p, 1 - quantile_p,
+                                    false);
+  const double v_scale = quantile_p * (1 - quantile_p);
+  return std::make_shared<const TabulatedBetaBinomialMixture>(
+      mixture, v_scale, v_scale * std::max(max_arm_size, 2));
+}
+
+CONFSEQ_INLINE double QuantileABTest::arm_log_superMG(
+    const int arm_size, const double prop_below, const bool tabulated) const {
+  double s = (prop_below - quantile_p_) * arm_size;
+  double v = quantile_p_ * (1 - quantile_p_) * arm_size;
+  return tabulated ? table_->log_superMG(s, v) : mixture_.log_superMG(s, v);
+}
+
+CONFSEQ_INLINE QuantileABTest::GFunction QuantileABTest::get_G_fn(
+    const OrderStatisticInterface& os, double* minimizer_out) const {
+  int N = os.size();
+  const double minimizer = find_G_minimizer(N);
+  if (minimizer_out) {
+    *minimizer_out = minimizer;
+  }
+
+  double x_lower = os.get_order_statistic(ceil(minimizer * N));
+  double x_upper = os.get_order_statistic(floor(minimizer * N) + 1);
+  const double slack = double(os.rank_error()) / N;
+  return GFunction{&os, N, minimizer, x_lower, x_upper, slack, 0};
+}
+
+CONFSEQ_INLINE QuantileABTest::GFunction QuantileABTest::shifted_G_fn(
+    GFunction G_fn, const double delta) {
+  G_fn.minimum_start_x += delta;
+  G_fn.minimum_end_x += delta;
+  G_fn.shift += delta;
+  return G_fn;
+}
+
+CONFSEQ_INLINE QuantileABTestConfig::QuantileABTestConfig(
+    const double quantile_p, const int t_opt, const double alpha_opt,
+    std::shared_ptr<const TabulatedBetaBinomialMixture> table)
+    : quantile_p_(quantile_p), t_opt_(t_opt), alpha_opt_(alpha_opt),
+      mixture_(t_opt * quantile_p * (1 - quantile_p), alpha_opt, quantile_p,
+               1 - quantile_p, false),
+      table_(std::move(table)) {
+  assert(0 < quantile_p && quantile_p < 1);
+  if (table_) {
+    std::array<double, 5> parameters, table_parameters;
+    mixture_.cache_parameters(parameters);
+    table_->mixture().cache_parameters(table_parameters);
+    if (parameters != table_parameters) {
+      throw std::invalid_argument(
+          "The table does not match the test's mixture");
+    }
+  }
+}
+
+// The minimizer depends on the arm only through its size, so it is memoized
+// per config, and across configs with the same mixture and arm size. It tends
+// to quantile_p as N grows, and the log mixture is convex in prop_below, so
+// quantile_p brackets it once its value lies below the values at both ends of
+// a small interval around it. The search depends on N and the mixture alone,
+// so the memoized value does not depend on which caller computed it.
+CONFSEQ_INLINE double QuantileABTestConfig::G_minimizer(const int N) const {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found = minimizers_.find(N);
+    if (found != minimizers_.end()) {
+      return found->second;
+    }
+  }
+  std::array<double, 5> parameters;
+  mixture_.cache_parameters(parameters);
+  static BoundaryCache cache(4096);
+  const BoundaryCacheKey key = {parameters[1], parameters[2], parameters[3],
+                                parameters[4], double(N)};
+  const double minimizer = cache.get_or_compute(key, [this, N]() {
+    auto objective = [this, N](double a) {
+      return mixture_.log_superMG((a - quantile_p_) * N,
+                                  quantile_p_ * (1 - quantile_p_) * N);
+    };
+    const double width = 0.05 * std::min(quantile_p_, 1 - quantile_p_);
+    const double lower = quantile_p_ - width, upper = quantile_p_ + width;
+    const double center_value = objective(quantile_p_);
+    if (center_value <= objective(lower) && center_value <= objective(upper)) {
+      return std::make_pair(boost::math::tools::brent_find_minima(
+          objective, lower, upper, 20).first, 0.0);
+    }
+    return std::make_pair(boost::math::tools::brent_find_minima(
+        objective, 0.0, 1.0, 20).first, 0.0);
+  }).first;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (minimizers_.size() < max_cached_minimizers) {
+    minimizers_.emplace(N, minimizer);
+  }
+  return minimizer;
+}
+
+CONFSEQ_INLINE size_t QuantileABTestConfig::num_cached_minimizers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return minimizers_.size();
+}
+
+CONFSEQ_INLINE double QuantileABTest::find_G_minimizer(const int N) const {
+  return config_->G_minimizer(N);
+}
+
+CONFSEQ_INLINE double QuantileABTest::G(
+    const GFunction& G_fn, const double x) const {
+  double prop_below;
+  if (x < G_fn.minimum_start_x) {
+    prop_below =
+        double(G_fn.os->count_less_or_equal(x - G_fn.shift)) / G_fn.size;
+  } else if (x > G_fn.minimum_end_x) {
+    prop_below = double(G_fn.os->count_less(x - G_fn.shift)) / G_fn.size;
+  } else {
+    prop_below = G_fn.minimizer;
+  }
+  return G_from_proportion(G_fn, prop_below);
+}
+
+CONFSEQ_INLINE double QuantileABTest::G_from_counts(
+    const GFunction& G_fn, const double x, const int count_less,
+    const int count_less_or_equal) const {
+  const int N = G_fn.size;
+  double prop_below;
+  if (x < G_fn.minimum_start_x) {
+    prop_below = double(count_less_or_equal) / N;
+  } else if (x > G_fn.minimum_end_x) {
+    prop_below = double(count_less) / N;
+  } else {
+    prop_below = G_fn.minimizer;
+  }
+  return G_from_proportion(G_fn, prop_below);
+}
+
+// With approximate counts, each proportion is moved toward the minimizer by
+// the rank error, which can only lower G since arm_log_superMG is convex in
+// prop_below. This keeps the p-value conservative.
+CONFSEQ_INLINE double QuantileABTest::G_from_proportion(
+    const GFunction& G_fn, double prop_below) const {
+  if (prop_below > G_fn.minimizer) {
+    prop_below = std::max(G_fn.minimizer, prop_below - G_fn.slack);
+  } else {
+    prop_below = std::min(G_fn.minimizer, prop_below + G_fn.slack);
+  }
+  return arm_log_superMG(G_fn.size, prop_below, table_ != nullptr);
+}
+
+CONFSEQ_INLINE double QuantileABTest::find_log_superMG_lower_bound(
+    const GFunction& first_arm_G, const GFunction& second_arm_G,
+    const double stop_below) const {
+  assert(first_arm_G.minimum_end_x <= second_arm_G.minimum_end_x);
+  auto objective = [this, &first_arm_G, &second_arm_G](double x) {
+    return G(first_arm_G, x) + G(second_arm_G, x);
+  };
+  double min_value = std::min(
+      objective(first_arm_G.minimum_end_x),
+      objective(second_arm_G.minimum_start_x));
+  if (min_value < stop_below) {
+    return min_value;
+  }
+  const OrderStatisticInterface& first_os = *first_arm_G.os;
+  const OrderStatisticInterface& second_os = *second_arm_G.os;
+  // Candidate x are the second arm's shifted values. Within an arm, values
+  // are compared unshifted.
+  const double first_shift = first_arm_G.shift;
+  const double second_shift = second_arm_G.shift;
+  const auto first_below = [first_shift](const double value, const double x) {
+    return value + first_shift < x;
+  };
+  int start_index = second_os.count_less_or_equal(
+      first_arm_G.minimum_end_x - second_shift);
+  int end_index = second_os.count_less_or_equal(
+      second_arm_G.minimum_start_x - second_shift);
+  assert(start_index <= end_index);
+  assert(end_index >= 1);
+
+  const OrderStatisticInterface::SortedRuns first_runs =
+      first_os.sorted_runs();
+  const OrderStatisticInterface::SortedRuns second_runs =
+      second_os.sorted_runs();
+  if (first_runs.values != nullptr && second_runs.values != nullptr) {
+    // Merge scan over the runs of both arms, one run of the second arm per
+    // candidate x, with the counts read from the run ends.
+    int j = std::lower_bound(second_runs.ends,
+                             second_runs.ends + second_runs.size,
+                             std::max(1, start_index)) - second_runs.ends;
+    int first_run = j < second_runs.size
+        ? std::lower_bound(first_runs.values,
+                           first_runs.values + first_runs.size,
+                           second_runs.values[j] + second_shift, first_below)
+            - first_runs.values
+        : 0;
+    for (; j < second_runs.size
+           && (j == 0 ? 0 : second_runs.ends[j - 1]) < end_index; j++) {
+      const double x = second_runs.values[j] + second_shift;
+      while (first_run < first_runs.size
+             && first_below(first_runs.values[first_run], x)) {
+        first_run++;
+      }
+      const int first_less =
+          first_run == 0 ? 0 : first_runs.ends[first_run - 1];
+      const int first_less_or_equal =
+          first_run < first_runs.size
+              && first_runs.values[first_run] + first_shift == x
+          ? first_runs.ends[first_run] : first_less;
+      const double value =
+          G_from_counts(first_arm_G, x, first_less, first_less_or_equal)
+          + G_from_counts(second_arm_G, x,
+                          j == 0 ? 0 : second_runs.ends[j - 1],
+                          second_runs.ends[j]);
+      if (value < min_value) {
+        min_value = value;
+        if (min_value < stop_below) {
+          return min_value;
+        }
+      }
+    }
+    return min_value;
+  }
+
+  const double* first_values = first_os.sorted_values();
+  const double* second_values = second_os.sorted_values();
+  if (first_values == nullptr || second_values == nullptr) {
+    for (int i = std::max(1, start_index); i <= end_index; i++) {
+      const double second_value = second_os.get_order_statistic(i);
+      i = second_os.count_less_or_equal(second_value);
+      double value = objective(second_value + second_shift);
+      if (value < min_value) {
+        min_value = value;
+        if (min_value < stop_below) {
+          return min_value;
+        }
+      }
+    }
+    return min_value;
+  }
+
+  // Merge scan over both sorted arms, advancing each count as x increases.
+  const int first_size = first_os.size(), second_size = second_os.size();
+  int i = std::max(1, start_index);
+  const double start_x = second_values[i - 1];
+  int first_less = std::lower_bound(first_values, first_values + first_size,
+                                    start_x + second_shift, first_below)
+      - first_values;
+  int first_less_or_equal = first_less;
+  int second_less = std::lower_bound(second_values, second_values + i - 1,
+                                     start_x) - second_values;
+  while (i <= end_index) {
+    const double second_value = second_values[i - 1];
+    const double x = second_value + second_shift;
+    int second_less_or_equal = i;
+    while (second_less_or_equal < second_size
+           && second_values[second_less_or_equal] == second_value) {
+      second_less_or_equal++;
+    }
+    while (second_values[second_less] < second_value) {
+      second_less++;
+    }
+    while (first_less < first_size
+           && first_below(first_values[first_less], x)) {
+      first_less++;
+    }
+    if (first_less_or_equal < first_less) {
+      first_less_or_equal = first_less;
+    }
+    while (first_less_or_equal < first_size
+           && first_values[first_less_or_equal] + first_shift <= x) {
+      first_less_or_equal++;
+    }
+    const double value =
+        G_from_counts(first_arm_G, x, first_less, first_less_or_equal)
+        + G_from_counts(second_arm_G, x, second_less, second_less_or_equal);
+    if (value < min_value) {
+      min_value = value;
+      if (min_value < stop_below) {
+        return min_value;
+      }
+    }
+    i = second_less_or_equal + 1;
+  }
+  return min_value;
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class InputIt>
+void DynamicOrderStatistics::insert(InputIt first, InputIt last) {
+  std::vector<double> values(first, last);
+  if (values.size() < size_t(size_) / 16 + BLOCK_SIZE) {
+    for (const double value : values) {
+      insert(value);
+    }
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  std::vector<double> merged;
+  merged.reserve(size_ + values.size());
+  for (const std::vector<double>& block : blocks_) {
+    merged.insert(merged.end(), block.begin(), block.end());
+  }
+  const size_t middle = merged.size();
+  merged.insert(merged.end(), values.begin(), values.end());
+  std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end());
+  rebuild(merged);
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE void OrderStatisticInterface::count_less_batch(
+    const double* queries, const size_t n, int* out,
+    const int num_threads) const {
+  count_batch(queries, n, false, out, num_threads);
+}
+
+CONFSEQ_INLINE void OrderStatisticInterface::count_less_or_equal_batch(
+    const double* queries, const size_t n, int* out,
+    const int num_threads) const {
+  count_batch(queries, n, true, out, num_threads);
+}
+
+CONFSEQ_INLINE void OrderStatisticInterface::count_batch(
+    const double* queries, const size_t n, const bool or_equal, int* out,
+    const int num_threads) const {
+  bool sorted = true;
+  for (size_t i = 1; i < n && sorted; i++) {
+    sorted = queries[i - 1] <= queries[i];
+  }
+  const SortedRuns runs = sorted_runs();
+  const double* values = runs.values != nullptr ? runs.values
+      : sorted_values();
+  if (values != nullptr && sorted && (n == 0 || !std::isnan(queries[0]))) {
+    const size_t num_values = runs.values != nullptr ? runs.size : size();
+    size_t position = 0;
+    for (size_t i = 0; i < n; i++) {
+      const double query = queries[i];
+      const auto before = [query, or_equal](const double value) {
+        return or_equal ? value <= query : value < query;
+      };
+      // Gallop from the last answer: values below begin are before the
+      // query, and the answer lies in [begin, end].
+      size_t begin = position, end = position, step = 1;
+      while (end < num_values && before(values[end])) {
+        begin = end + 1;
+        end += step;
+        step *= 2;
+      }
+      end = std::min(end, num_values);
+      position = std::partition_point(values + begin, values + end, before)
+          - values;
+      out[i] = runs.values == nullptr ? position
+          : position == 0 ? 0 : runs.ends[position - 1];
+    }
+    return;
+  }
+  if (n == 0) {
+    return;
+  }
+  // A first query builds any lazily computed summary, here rather than from
+  // several threads at once.
+  out[0] = or_equal ? count_less_or_equal(queries[0]) : count_less(queries[0]);
+  parallel_for(n - 1, [&](const size_t i) {
+    out[i + 1] = or_equal ? count_less_or_equal(queries[i + 1])
+        : count_less(queries[i + 1]);
+  }, num_threads);
+}
+
+CONFSEQ_INLINE void DynamicOrderStatistics::insert(const double value) {
+  if (blocks_.empty()) {
+    blocks_.emplace_back(1, value);
+    block_max_.push_back(value);
+    size_ = 1;
+    rebuild_index();
+    return;
+  }
+  size_t block = std::lower_bound(block_max_.begin(), block_max_.end(), value)
+      - block_max_.begin();
+  if (block == blocks_.size()) {
+    block--;
+  }
+  std::vector<double>& values = blocks_[block];
+  values.insert(std::upper_bound(values.begin(), values.end(), value), value);
+  block_max_[block] = values.back();
+  size_++;
+  if (values.size() > 2 * BLOCK_SIZE) {
+    std::vector<double> upper_half(values.begin() + BLOCK_SIZE, values.end());
+    values.resize(BLOCK_SIZE);
+    block_max_[block] = values.back();
+    blocks_.insert(blocks_.begin() + block + 1, std::move(upper_half));
+    block_max_.insert(block_max_.begin() + block + 1,
+                      blocks_[block + 1].back());
+    rebuild_index();
+  } else {
+    for (size_t i = block + 1; i < block_index_.size(); i += i & -i) {
+      block_index_[i]++;
+    }
+  }
+}
+
+CONFSEQ_INLINE double DynamicOrderStatistics::get_order_statistic(
+    const int order_index) const {
+  assert(1 <= order_index && order_index <= size_);
+  // Descend the Fenwick tree to the block holding the order statistic.
+  size_t block = 0;
+  int remaining = order_index;
+  size_t step = 1;
+  while (2 * step < block_index_.size()) {
+    step *= 2;
+  }
+  for (; step > 0; step /= 2) {
+    if (block + step < block_index_.size()
+        && block_index_[block + step] < remaining) {
+      block += step;
+      remaining -= block_index_[block];
+    }
+  }
+  return blocks_[block][remaining - 1];
+}
+
+CONFSEQ_INLINE int DynamicOrderStatistics::count_less(
+    const double value) const {
+  const size_t block =
+      std::lower_bound(block_max_.begin(), block_max_.end(), value)
+      - block_max_.begin();
+  if (block == blocks_.size()) {
+    return size_;
+  }
+  const std::vector<double>& values = blocks_[block];
+  return count_blocks_before(block)
+      + (std::lower_bound(values.begin(), values.end(), value) - values.begin());
+}
+
+CONFSEQ_INLINE int DynamicOrderStatistics::count_less_or_equal(
+    const double value) const {
+  const size_t block =
+      std::upper_bound(block_max_.begin(), block_max_.end(), value)
+      - block_max_.begin();
+  if (block == blocks_.size()) {
+    return size_;
+  }
+  const std::vector<double>& values = blocks_[block];
+  return count_blocks_before(block)
+      + (std::upper_bound(values.begin(), values.end(), value) - values.begin());
+}
+
+CONFSEQ_INLINE void DynamicOrderStatistics::rebuild(
+    const std::vector<double>& sorted_values) {
+  blocks_.clear();
+  block_max_.clear();
+  for (size_t start = 0; start < sorted_values.size(); start += BLOCK_SIZE) {
+    const size_t end = std::min(start + BLOCK_SIZE, sorted_values.size());
+    blocks_.emplace_back(sorted_values.begin() + start,
+                         sorted_values.begin() + end);
+    block_max_.push_back(sorted_values[end - 1]);
+  }
+  size_ = sorted_values.size();
+  rebuild_index();
+}
+
+CONFSEQ_INLINE void DynamicOrderStatistics::rebuild_index() {
+  block_index_.assign(blocks_.size() + 1, 0);
+  for (size_t i = 1; i < block_index_.size(); i++) {
+    block_index_[i] += blocks_[i - 1].size();
+    const size_t parent = i + (i & -i);
+    if (parent < block_index_.size()) {
+      block_index_[parent] += block_index_[i];
+    }
+  }
+}
+
+CONFSEQ_INLINE int DynamicOrderStatistics::count_blocks_before(
+    const size_t block) const {
+  int count = 0;
+  for (size_t i = block; i > 0; i -= i & -i) {
+    count += block_index_[i];
+  }
+  return count;
+}
+
+CONFSEQ_INLINE HistogramOrderStatistics::HistogramOrderStatistics(
+    const double* values, const int64_t* counts, const size_t n) {
+  std::vector<std::pair<double, int64_t>> entries;
+  entries.reserve(n);
+  int64_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (std::isnan(values[i]) || counts[i] < 0) {
+      throw std::invalid_argument(
+          "Histogram values must not be NaN and counts must be nonnegative");
+    }
+    total += counts[i];
+    if (total > std::numeric_limits<int>::max()) {
+      throw std::invalid_argument("Histograms hold at most INT_MAX values");
+    }
+    if (counts[i] > 0) {
+      entries.emplace_back(values[i], counts[i]);
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  for (const auto& entry : entries) {
+    if (!values_.empty() && values_.back() == entry.first) {
+      counts_.back() += entry.second;
+    } else {
+      values_.push_back(entry.first);
+      counts_.push_back(entry.second);
+    }
+  }
+  size_ = total;
+  rebuild_index();
+}
+
+CONFSEQ_INLINE void HistogramOrderStatistics::insert(const double value,
+                                                     const int64_t count) {
+  if (std::isnan(value) || count < 0) {
+    throw std::invalid_argument(
+        "Histogram values must not be NaN and counts must be nonnegative");
+  }
+  if (size_ + count > std::numeric_limits<int>::max()) {
+    throw std::invalid_argument("Histograms hold at most INT_MAX values");
+  }
+  if (count == 0) {
+    return;
+  }
+  const size_t i = std::lower_bound(values_.begin(), values_.end(), value)
+      - values_.begin();
+  size_ += count;
+  if (i < values_.size() && values_[i] == value) {
+    counts_[i] += count;
+    for (size_t j = i + 1; j < index_.size(); j += j & -j) {
+      index_[j] += count;
+    }
+    return;
+  }
+  values_.insert(values_.begin() + i, value);
+  counts_.insert(counts_.begin() + i, count);
+  rebuild_index();
+}
+
+// Descends the Fenwick tree to the first value whose cumulative count
+// reaches order_index.
+CONFSEQ_INLINE double HistogramOrderStatistics::get_order_statistic(
+    const int order_index) const {
+  size_t position = 0;
+  int remaining = order_index;
+  size_t step = 1;
+  while (2 * step < index_.size()) {
+    step *= 2;
+  }
+  for (; step > 0; step /= 2) {
+    if (position + step < index_.size()
+        && index_[position + step] < remaining) {
+      position += step;
+      remaining -= index_[position];
+    }
+  }
+  return values_[std::min(position, values_.size() - 1)];
+}
+
+CONFSEQ_INLINE int HistogramOrderStatistics::count_less(
+    const double value) const {
+  return count_values_before(
+      std::lower_bound(values_.begin(), values_.end(), value)
+      - values_.begin());
+}
+
+CONFSEQ_INLINE int HistogramOrderStatistics::count_less_or_equal(
+    const double value) const {
+  return count_values_before(
+      std::upper_bound(values_.begin(), values_.end(), value)
+      - values_.begin());
+}
+
+CONFSEQ_INLINE void HistogramOrderStatistics::rebuild_index() {
+  index_.assign(values_.size() + 1, 0);
+  for (size_t i = 1; i < index_.size(); i++) {
+    index_[i] += counts_[i - 1];
+    const size_t parent = i + (i & -i);
+    if (parent < index_.size()) {
+      index_[parent] += index_[i];
+    }
+  }
+}
+
+CONFSEQ_INLINE int HistogramOrderStatistics::count_values_before(
+    const size_t num_values) const {
+  int count = 0;
+  for (size_t i = num_values; i > 0; i -= i & -i) {
+    count += index_[i];
+  }
+  return count;
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class Value1, class Value2>
+std::array<std::shared_ptr<OrderStatisticInterface>, 2>
+two_arm_order_statistics(const Value1* arm1_first, const Value1* arm1_last,
+                         const Value2* arm2_first, const Value2* arm2_last,
+                         const bool assume_sorted) {
+  std::array<std::shared_ptr<OrderStatisticInterface>, 2> arms;
+  if (assume_sorted) {
+    arms[0] = std::make_shared<SortedOrderStatisticsViewT<Value1>>(arm1_first,
+                                                                   arm1_last);
+    arms[1] = std::make_shared<SortedOrderStatisticsViewT<Value2>>(arm2_first,
+                                                                   arm2_last);
+    return arms;
+  }
+  const int num_threads = std::max(1, get_num_threads() / 2);
+  parallel_for(2, [&](const size_t arm) {
+    if (arm == 0) {
+      arms[0] = std::make_shared<StaticOrderStatisticsT<Value1>>(
+          arm1_first, arm1_last, num_threads);
+    } else {
+      arms[1] = std::make_shared<StaticOrderStatisticsT<Value2>>(
+          arm2_first, arm2_last, num_threads);
+    }
+  }, 2, 1);
+  return arms;
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE void quantile_ab_p_values(
+    const std::shared_ptr<OrderStatisticInterface>& arm1_os,
+    const std::shared_ptr<OrderStatisticInterface>& arm2_os,
+    const double* quantile_p, const size_t n, const int t_opt,
+    const double alpha_opt, double* p_values) {
+  // A first query builds any lazily computed summary, here rather than from
+  // several threads at once.
+  arm1_os->count_less(0);
+  arm2_os->count_less(0);
+  parallel_for(n, [&](const size_t i) {
+    const QuantileABTest test(quantile_p[i], t_opt, alpha_opt, arm1_os,
+                              arm2_os);
+    p_values[i] = test.p_value();
+  }, 0, 1);
+}
+
+CONFSEQ_INLINE void batch_quantile_ab_p_values(
+    const double* arm1_values, const size_t* arm1_offsets,
+    const double* arm2_values, const size_t* arm2_offsets,
+    const size_t num_pairs, const double* quantile_p, const int* t_opt,
+    const double alpha_opt, double* p_values, int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = get_num_threads();
+  }
+  const auto pair_size = [&](const size_t i) {
+    return arm1_offsets[i + 1] - arm1_offsets[i] + arm2_offsets[i + 1]
+        - arm2_offsets[i];
+  };
+  std::vector<size_t> order(num_pairs);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const size_t i, const size_t j) {
+                     return pair_size(i) > pair_size(j);
+                   });
+  const std::function<void(size_t)> task = [&](const size_t k) {
+    const size_t i = order[k];
+    const double* arm1_first = arm1_values + arm1_offsets[i];
+    const double* arm1_last = arm1_values + arm1_offsets[i + 1];
+    const double* arm2_first = arm2_values + arm2_offsets[i];
+    const double* arm2_last = arm2_values + arm2_offsets[i + 1];
+    if (arm1_first == arm1_last || arm2_first == arm2_last) {
+      p_values[i] = 1;
+      return;
+    }
+    const QuantileABTest test(
+        quantile_p[i], t_opt[i], alpha_opt,
+        std::make_shared<StaticOrderStatistics>(arm1_first, arm1_last, 1),
+        std::make_shared<StaticOrderStatistics>(arm2_first, arm2_last, 1));
+    p_values[i] = test.p_value();
+  };
+  if (num_threads <= 1 || num_pairs <= 1) {
+    for (size_t k = 0; k < num_pairs; k++) {
+      task(k);
+    }
+    return;
+  }
+  thread_pool().run(num_pairs, task, num_threads - 1);
+}
+
+CONFSEQ_INLINE MultiArmQuantileTest::MultiArmQuantileTest(
+    const double quantile_p, const int t_opt, const double alpha_opt,
+    std::vector<std::shared_ptr<OrderStatisticInterface>> arms,
+    std::shared_ptr<const TabulatedBetaBinomialMixture> table)
+    : arms_(std::move(arms)) {
+  if (arms_.empty()) {
+    throw std::invalid_argument("A multi-arm test needs at least one arm");
+  }
+  scorer_.reset(new QuantileABTest(quantile_p, t_opt, alpha_opt, arms_[0],
+                                   arms_[0], std::move(table)));
+  prepare_arms();
+}
+
+CONFSEQ_INLINE MultiArmQuantileTest::MultiArmQuantileTest(
+    const double quantile_p, const int t_opt, const double alpha_opt,
+    const double* values, const size_t* offsets, const size_t num_arms,
+    std::shared_ptr<const TabulatedBetaBinomialMixture> table)
+    : arms_(num_arms) {
+  if (num_arms == 0) {
+    throw std::invalid_argument("A multi-arm test needs at least one arm");
+  }
+  parallel_for(num_arms, [&](const size_t i) {
+    arms_[i] = std::make_shared<StaticOrderStatistics>(
+        values + offsets[i], values + offsets[i + 1], 1);
+  }, 0, 1);
+  scorer_.reset(new QuantileABTest(quantile_p, t_opt, alpha_opt, arms_[0],
+                                   arms_[0], std::move(table)));
+  prepare_arms();
+}
+
+// Serially, so any lazily computed summaries are built before the arms are
+// shared across threads.
+CONFSEQ_INLINE void MultiArmQuantileTest::prepare_arms() {
+  G_fns_.resize(arms_.size());
+  for (size_t i = 0; i < arms_.size(); i++) {
+    const OrderStatisticInterface& os = *arms_[i];
+    os.count_less(0);
+    if (os.size() > 0) {
+      G_fns_[i] = scorer_->get_G_fn(os);
+    }
+  }
+}
+
+CONFSEQ_INLINE double MultiArmQuantileTest::p_value(const size_t arm1,
+                                                    const size_t arm2) const {
+  if (arm1 >= arms_.size() || arm2 >= arms_.size()) {
+    throw std::out_of_range("Arm index out of range");
+  }
+  if (arms_[arm1]->size() == 0 || arms_[arm2]->size() == 0) {
+    return 1;
+  }
+  const TraceScope trace(TracedFunction::QUANTILE_AB_P_VALUE,
+                         arms_[arm1]->size() + arms_[arm2]->size());
+  return std::min(1.0, exp(-scorer_->pair_log_superMG_lower_bound(
+      G_fns_[arm1], G_fns_[arm2], 0,
+      -std::numeric_limits<double>::infinity())));
+}
+
+CONFSEQ_INLINE void MultiArmQuantileTest::p_values(
+    const size_t* arm1, const size_t* arm2, const size_t num_pairs,
+    double* p_values, int num_threads) const {
+  for (size_t k = 0; k < num_pairs; k++) {
+    if (arm1[k] >= arms_.size() || arm2[k] >= arms_.size()) {
+      throw std::out_of_range("Arm index out of range");
+    }
+  }
+  parallel_for(num_pairs, [&](const size_t k) {
+    p_values[k] = p_value(arm1[k], arm2[k]);
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE void MultiArmQuantileTest::p_values_against(
+    const size_t control, double* p_values, int num_threads) const {
+  if (control >= arms_.size()) {
+    throw std::out_of_range("Arm index out of range");
+  }
+  parallel_for(arms_.size(), [&](const size_t i) {
+    p_values[i] = i == control ? 1 : p_value(i, control);
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE void SequentialQuantileABTest::add(
+    const int arm, const double value) {
+  assert(arm == 1 || arm == 2);
+  arms_[arm - 1]->insert(value);
+  invalidate();
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class InputIt>
+void SequentialQuantileABTest::add(const int arm, InputIt first,
+                                   InputIt last) {
+  assert(arm == 1 || arm == 2);
+  arms_[arm - 1]->insert(first, last);
+  invalidate();
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE double SequentialQuantileABTest::p_value() {
+  if (!p_value_current_) {
+    p_value_ = has_empty_arm() ? 1 : test_.p_value(minimizers_);
+    p_value_current_ = true;
+    running_p_value_ = std::min(running_p_value_, p_value_);
+    running_p_value_current_ = true;
+  }
+  return p_value_;
+}
+
+CONFSEQ_INLINE double SequentialQuantileABTest::running_p_value() {
+  if (!running_p_value_current_) {
+    if (!has_empty_arm()) {
+      // capped_p_value gives the exact p-value when it is at most the cap.
+      const double p_value =
+          running_p_value_ < 1
+          ? test_.capped_p_value(running_p_value_, minimizers_)
+          : test_.p_value(minimizers_);
+      if (p_value <= running_p_value_) {
+        running_p_value_ = p_value;
+        p_value_ = p_value;
+        p_value_current_ = true;
+      }
+    }
+    running_p_value_current_ = true;
+  }
+  return running_p_value_;
+}
+
+CONFSEQ_INLINE void SketchOrderStatistics::insert(const double value) {
+  if (levels_.empty()) {
+    levels_.emplace_back();
+    level_offsets_.push_back(false);
+  }
+  levels_[0].push_back(value);
+  size_++;
+  summary_valid_ = false;
+  for (size_t level = 0;
+       level < levels_.size() && levels_[level].size() >= size_t(k_);
+       level++) {
+    compact(level);
+  }
+}
+
+CONFSEQ_INLINE void SketchOrderStatistics::compact_full_levels() {
+  // Compacting a level only adds to the levels above it.
+  for (size_t level = 0; level < levels_.size(); level++) {
+    if (levels_[level].size() >= size_t(k_)) {
+      compact(level);
+    }
+  }
+}
+
+CONFSEQ_INLINE void SketchOrderStatistics::merge(
+    const SketchOrderStatistics& other) {
+  if (other.k_ != k_) {
+    throw std::invalid_argument("Sketches must have the same k to merge");
+  }
+  while (levels_.size() < other.levels_.size()) {
+    levels_.emplace_back();
+    level_offsets_.push_back(false);
+  }
+  for (size_t level = 0; level < other.levels_.size(); level++) {
+    levels_[level].insert(levels_[level].end(), other.levels_[level].begin(),
+                          other.levels_[level].end());
+  }
+  size_ += other.size_;
+  rank_error_ += other.rank_error_;
+  summary_valid_ = false;
+  compact_full_levels();
+}
+
+CONFSEQ_INLINE void SketchOrderStatistics::compact(const size_t level) {
+  if (level + 1 == levels_.size()) {
+    levels_.emplace_back();
+    level_offsets_.push_back(false);
+  }
+  std::vector<double>& values = levels_[level];
+  std::sort(values.begin(), values.end());
+  // An odd value out stays behind at this level.
+  const size_t num_compacted = values.size() - values.size() % 2;
+  std::vector<double>& next = levels_[level + 1];
+  for (size_t i = level_offsets_[level]; i < num_compacted; i += 2) {
+    next.push_back(values[i]);
+  }
+  values.erase(values.begin(), values.begin() + num_compacted);
+  level_offsets_[level] = !level_offsets_[level];
+  rank_error_ += 1 << level;
+}
+
+CONFSEQ_INLINE size_t SketchOrderStatistics::num_retained() const {
+  size_t count = 0;
+  for (const std::vector<double>& values : levels_) {
+    count += values.size();
+  }
+  return count;
+}
+
+CONFSEQ_INLINE void SketchOrderStatistics::update_summary() const {
+  if (summary_valid_) {
+    return;
+  }
+  std::vector<std::pair<double, int64_t>> weighted;
+  weighted.reserve(num_retained());
+  for (size_t level = 0; level < levels_.size(); level++) {
+    for (const double value : levels_[level]) {
+      weighted.emplace_back(value, int64_t(1) << level);
+    }
+  }
+  std::sort(weighted.begin(), weighted.end());
+  summary_values_.resize(weighted.size());
+  summary_ranks_.resize(weighted.size());
+  int64_t rank = 0;
+  for (size_t i = 0; i < weighted.size(); i++) {
+    rank += weighted[i].second;
+    summary_values_[i] = weighted[i].first;
+    summary_ranks_[i] = rank;
+  }
+  summary_valid_ = true;
+}
+
+CONFSEQ_INLINE double SketchOrderStatistics::get_order_statistic(
+    const int order_index) const {
+  assert(1 <= order_index && order_index <= size_);
+  update_summary();
+  const size_t index =
+      std::lower_bound(summary_ranks_.begin(), summary_ranks_.end(),
+                       int64_t(order_index)) - summary_ranks_.begin();
+  return summary_values_[std::min(index, summary_values_.size() - 1)];
+}
+
+CONFSEQ_INLINE int SketchOrderStatistics::count_less(const double value) const {
+  update_summary();
+  const size_t index =
+      std::lower_bound(summary_values_.begin(), summary_values_.end(), value)
+      - summary_values_.begin();
+  return index == 0 ? 0 : summary_ranks_[index - 1];
+}
+
+CONFSEQ_INLINE int SketchOrderStatistics::count_less_or_equal(
+    const double value) const {
+  update_summary();
+  const size_t index =
+      std::upper_bound(summary_values_.begin(), summary_values_.end(), value)
+      - summary_values_.begin();
+  return index == 0 ? 0 : summary_ranks_[index - 1];
+}
+
+//////////////////////////////////////////////////////////////////////
+// Simplified interface implementation
+//////////////////////////////////////////////////////////////////////
+
+CONFSEQ_INLINE double normal_log_mixture(
+    const double s, const double v, const double v_opt, const double alpha_opt,
+    const bool is_one_sided) {
+  if (is_one_sided) {
+    OneSidedNormalMixture mixture(v_opt, alpha_opt);
+    return mixture.log_superMG(s, v);
+  } else {
+    TwoSidedNormalMixture mixture(v_opt, alpha_opt);
+    return mixture.log_superMG(s, v);
+  }
+}
+
+CONFSEQ_INLINE double normal_mixture_bound(
+    const double v, const double alpha, const double v_opt,
+    const double alpha_opt, const bool is_one_sided) {
+  const TraceScope trace(TracedFunction::NORMAL_MIXTURE_BOUND,
+                         trace_input_size(v));
+  const BoundaryCacheKey key = {11, v_opt, alpha_opt, double(is_one_sided), 0,
+                                v, alpha, 0};
+  return cached_value(key, [=]() {
+    if (is_one_sided) {
+      OneSidedNormalMixture mixture(v_opt, alpha_opt);
+      return mixture.bound(v, log(1 / alpha));
+    } else {
+      TwoSidedNormalMixture mixture(v_opt, alpha_opt);
+      return mixture.bound(v, log(1 / alpha));
+    }
+  });
+}
+
+CONFSEQ_INLINE double gamma_exponential_log_mixture(
+    const double s, const double v, const double v_opt,
+    const double c, const double alpha_opt) {
+  GammaExponentialMixture mixture(v_opt, alpha_opt, c);
+  return mixture.log_superMG(s, v);
+}
+
+CONFSEQ_INLINE double gamma_exponential_mixture_bound(
+    const double v, const double alpha, const double v_opt,
+    const double c, const double alpha_opt,
+    const SolverPrecision& precision) {
+  const TraceScope trace(TracedFunction::GAMMA_EXPONENTIAL_MIXTURE_BOUND,
+                         trace_input_size(v));
+  const BoundaryCacheKey key = {12, v_opt, c, alpha_opt, 0, v, alpha,
+                                precision.cache_key()};
+  return cached_value(key, [&]() {
+    GammaExponentialMixture mixture(v_opt, alpha_opt, c);
+    mixture.set_precision(precision);
+    return mixture.bound(v, log(1 / alpha));
+  });
+}
+
+CONFSEQ_INLINE double gamma_poisson_log_mixture(
+    const double s, const double v, const double v_opt, const double c,
+    const double alpha_opt) {
+  GammaPoissonMixture mixture(v_opt, alpha_opt, c);
+  return mixture.log_superMG(s, v);
+}
+
+CONFSEQ_INLINE double gamma_poisson_mixture_bound(
+    const double v, const double alpha, const double v_opt, const double c,
+    const double alpha_opt, const SolverPrecision& precision) {
+  const TraceScope trace(TracedFunction::GAMMA_POISSON_MIXTURE_BOUND,
+                         trace_input_size(v));
+  const BoundaryCacheKey key = {13, v_opt, c, alpha_opt, 0, v, alpha,
+                                precision.cache_key()};
+  return cached_value(key, [&]() {
+    GammaPoissonMixture mixture(v_opt, alpha_opt, c);
+    mixture.set_precision(precision);
+    return mixture.bound(v, log(1 / alpha));
+  });
+}
+
+CONFSEQ_INLINE double beta_binomial_log_mixture(
+    const double s, const double v, const double v_opt, const double g,
+    const double h, const double alpha_opt,
+    const bool is_one_sided) {
+  BetaBinomialMixture mixture(v_opt, alpha_opt, g, h, is_one_sided);
+  return mixture.log_superMG(s, v);
+}
+
+CONFSEQ_INLINE double beta_binomial_mixture_bound(
+    const double v, const double alpha, const double v_opt, const double g,
+    const double h, const double alpha_opt,
+    const bool is_one_sided, const SolverPrecision& precision) {
+  const TraceScope trace(TracedFunction::BETA_BINOMIAL_MIXTURE_BOUND,
+                         trace_input_size(v));
+  // Cache keys are integral, so the sidedness fits beside the precision.
+  const BoundaryCacheKey key = {14, v_opt, g, h, alpha_opt, v, alpha,
+                                2 * precision.cache_key()
+                                    + double(is_one_sided)};
+  return cached_value(key, [&]() {
+    BetaBinomialMixture mixture(v_opt, alpha_opt, g, h, is_one_sided);
+    mixture.set_precision(precision);
+    return mixture.bound(v, log(1 / alpha));
+  });
+}
+
+CONFSEQ_INLINE double poly_stitching_bound(const double v, const double alpha,
+                                    const double v_min, const double c,
+                                    const double s, const double eta) {
+  PolyStitchingBound bound(v_min, c, s, eta);
+  return bound(v, alpha);
+}
+
+CONFSEQ_INLINE double empirical_process_lil_bound(
+    const int t, const double alpha, const double t_min, const double A) {
+  EmpiricalProcessLILBound bound(alpha, t_min, A);
+  return bound(t);
+}
+
+CONFSEQ_INLINE double double_stitching_bound(
+    const double quantile_p, const double t, const double alpha,
+    const double t_opt, const double delta, const double s, const double eta) {
+  DoubleStitchingBound bound(t_opt, delta, s, eta);
+  return bound(quantile_p, t, alpha);
+}
+
+CONFSEQ_INLINE double pair_average(std::pair<double, double> values) {
+  return (values.first + values.second) / 2;
+}
+
+// Excess of the two-sided beta-binomial log mixture over threshold when
+// testing mean p, as a function of 0 < p < 1. Confidence intervals are the
+// sets where it is negative.
+//
+// With g = p, h = 1 - p, s = (p_hat - p) n and v = p (1 - p) n, the mixture
+// reduces to
+//   log B(k (1 - p) + F, k p + S) - log B(k (1 - p), k p)
+//       - S log p - F log(1 - p),
+// for S successes and F failures. Here k = r / (p (1 - p)) does not depend on
+// p, so the sums of the beta arguments are constant, and their lgamma terms
+// are computed once. Each evaluation then costs four lgamma calls, with no
+// mixture construction.
+class BernoulliIntervalObjective {
+ public:
+  BernoulliIntervalObjective(const double num_successes, const int num_trials,
+                             const double t_opt, const double alpha_opt,
+                             const double threshold)
+      : successes_(num_successes), failures_(num_trials - num_successes),
+        k_(get_k(t_opt, alpha_opt)),
+        constant_(boost::math::lgamma(k_, MathPolicy())
+                  - boost::math::lgamma(k_ + num_trials, MathPolicy())
+                  - threshold) {}
+
+  double operator()(const double p) const {
+    CONFSEQ_COUNT(objective_evaluations);
+    const double a = k_ * (1 - p);
+    const double b = k_ * p;
+    return boost::math::lgamma(a + failures_, MathPolicy())
+        + boost::math::lgamma(b + successes_, MathPolicy())
+        - boost::math::lgamma(a, MathPolicy())
+        - boost::math::lgamma(b, MathPolicy()) + constant_
+        - successes_ * log(p) - failures_ * log1p(-p);
+  }
+
+  // Derivative of operator() in p, through both the beta-binomial
+  // parameters a = k (1 - p) and b = k p and the likelihood terms.
+  double derivative(const double p) const {
+    const double a = k_ * (1 - p);
+    const double b = k_ * p;
+    return k_ * (boost::math::digamma(b + successes_, MathPolicy())
+                 - boost::math::digamma(b, MathPolicy())
+                 - boost::math::digamma(a + failures_, MathPolicy())
+                 + boost::math::digamma(a, MathPolicy()))
+        - successes_ / p + failures_ / (1 - p);
+  }
+
+ private:
+  // Matches BetaBinomialMixture's r for v_opt = p (1 - p) t_opt, divided by
+  // p (1 - p).
+  static double get_k(const double t_opt, const double alpha_opt) {
+    const double log_inverse_alpha = log(1 / alpha_opt);
+    return std::max(
+        t_opt / (2 * log_inverse_alpha + log(1 + 2 * log_inverse_alpha)) - 1,
+        1e-3);
+  }
+
+  const double successes_;
+  const double failures_;
+  const double k_;
+  const double constant_;
+};
+
+// Safeguarded Newton iteration on the logit scale for the root of an
+// interval objective on (lower_limit, upper_limit), where it is positive
+// below the root if positive_below and above it otherwise, starting from
+// guess. fn(p) returns the objective and its derivative in p. A step leaving
+// the current bracket is replaced by a bisection step, also on the logit
+// scale. With a single success
+// or failure the objective may not change sign before the limit beyond the
+// root, so an iteration that heads to within the tolerance of that limit is
+// checked for there and, if absent, taken as the limit itself. Conservative
+// results must lie on the positive side of the root: the final estimate,
+// nudged outward by the tolerance, usually does; otherwise the bracket end
+// there is returned.
+template <class Fn>
+double find_bernoulli_interval_newton(Fn fn, const double lower_limit,
+                                      const double upper_limit,
+                                      const bool positive_below,
+                                      const double guess,
+                                      const SolverPrecision& precision) {
+  CONFSEQ_COUNT_SOLVE();
+  const double tolerance = precision.tolerance();
+  const double outer_limit = positive_below ? lower_limit : upper_limit;
+  const double sliver = std::max(
+      tolerance * (upper_limit - lower_limit),
+      2 * std::numeric_limits<double>::epsilon() * outer_limit);
+  double a = lower_limit, b = upper_limit;
+  // Bisects on the logit scale, standing in for the limits by points a
+  // tolerance inside them.
+  auto midpoint = [&] {
+    const double lo = std::max(a, lower_limit + sliver);
+    const double hi = std::min(b, upper_limit - sliver);
+    return lo < hi ? expit((logit(lo) + logit(hi)) / 2) : (a + b) / 2;
+  };
+  auto finish = [&](const double estimate) {
+    if (!precision.conservative) {
+      return estimate;
+    }
+    const double outside = positive_below ? a : b;
+    const double candidate = positive_below
+        ? std::max(estimate * (1 - tolerance), a)
+        : std::min(estimate * (1 + tolerance), b);
+    return candidate != outside && fn(candidate).first > 0 ? candidate
+        : outside;
+  };
+  double p = a < guess && guess < b ? guess : (a + b) / 2;
+  for (int i = 0; i < 100; i++) {
+    const std::pair<double, double> value = fn(p);
+    if (value.first == 0) {
+      return finish(p);
+    } else if ((value.first > 0) == positive_below) {
+      a = p;
+    } else {
+      b = p;
+    }
+    // The objective's derivative in logit(p) is p (1 - p) times that in p.
+    const double slope = value.second * p * (1 - p);
+    double next = std::numeric_limits<double>::quiet_NaN();
+    if (std::isfinite(slope) && slope != 0) {
+      next = expit(logit(p) - value.first / slope);
+    }
+    const bool converged = a <= next && next <= b
+        && fabs(next - p) <= tolerance * fabs(next);
+    if (!converged && !(a < next && next < b)) {
+      CONFSEQ_COUNT(bisection_steps);
+      next = midpoint();
+    } else {
+      CONFSEQ_COUNT(halley_steps);
+    }
+    double& outer = positive_below ? a : b;
+    if (outer == outer_limit && fabs(next - outer_limit) <= 2 * sliver) {
+      const double edge = positive_below ? lower_limit + sliver
+          : upper_limit - sliver;
+      if (!(fn(edge).first > 0)) {
+        return outer_limit;
+      }
+      outer = edge;
+      next = midpoint();
+    }
+    if (fabs(next - p) <= tolerance * fabs(next)
+        || b - a <= tolerance * fabs(b)) {
+      return finish(next);
+    }
+    p = next;
+  }
+  return finish(p);
+}
+
+// Conservative results lie outside the interval.
+CONFSEQ_INLINE std::pair<double, double> uncached_bernoulli_confidence_interval(
+    const double num_successes, const int num_trials, const double alpha,
+    const double t_opt, const double alpha_opt,
+    const SolverPrecision& precision) {
+  const double threshold = log(1 / alpha);
+  const double empirical_p = 1.0 * num_successes / num_trials;
+
+  const BernoulliIntervalObjective interval_objective(
+      num_successes, num_trials, t_opt, alpha_opt, threshold);
+  // The rejected p nearest the empirical p on each side, the endpoint
+  // returned if the budget runs out.
+  double rejected_below = 0, rejected_above = 1;
+  auto objective = [&](const double p, const double zero_value,
+                       const double one_value) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (p <= 0) {
+      return std::make_pair(zero_value, nan);
+    } else if (p >= 1) {
+      return std::make_pair(one_value, nan);
+    }
+    if (solve_budget_exhausted()) {
+      throw SolveBudgetExhausted();
+    }
+    const double value = interval_objective(p);
+    if (value > 0 && p < empirical_p) {
+      rejected_below = std::max(rejected_below, p);
+    } else if (value > 0) {
+      rejected_above = std::min(rejected_above, p);
+    }
+    return std::make_pair(value, interval_objective.derivative(p));
+  };
+
+  // Seeds from the normal mixture interval with v = p (1 - p) n and v_opt =
+  // p (1 - p) t_opt, with the variance floored for p near 0 or 1.
+  const double variance = std::max(empirical_p * (1 - empirical_p),
+                                   1.0 / num_trials);
+  const double radius = sqrt(
+      variance * (num_trials + t_opt)
+      * (2 * threshold + log1p(num_trials / t_opt))) / num_trials;
+  double lower_bound = 0.0;
+  if (empirical_p > 0) {
+    try {
+      lower_bound = find_bernoulli_interval_newton(
+          [&](const double p) { return objective(p, 1.0, -1.0); }, 0.0,
+          empirical_p, true, empirical_p - radius, precision);
+    } catch (const SolveBudgetExhausted&) {
+      lower_bound = rejected_below;
+    }
+  }
+  double upper_bound = 1.0;
+  if (empirical_p < 1) {
+    try {
+      upper_bound = find_bernoulli_interval_newton(
+          [&](const double p) { return objective(p, -1.0, 1.0); },
+          empirical_p, 1.0, false, empirical_p + radius, precision);
+    } catch (const SolveBudgetExhausted&) {
+      upper_bound = rejected_above;
+    }
+  }
+  return std::make_pair(lower_bound, upper_bound);
+}
+
+CONFSEQ_INLINE std::pair<double, double> bernoulli_confidence_interval(
+    const double num_successes, const int num_trials, const double alpha,
+    const double t_opt, const double alpha_opt,
+    const SolverPrecision& precision) {
+  const TraceScope trace(TracedFunction::BERNOULLI_CONFIDENCE_INTERVAL,
+                         trace_input_size(num_trials));
+  const BoundaryCacheKey key = {21, t_opt, alpha_opt, precision.cache_key(), 0,
+                                num_successes, double(num_trials), alpha};
+  return cached_pair(key, [&]() {
+    return uncached_bernoulli_confidence_interval(num_successes, num_trials,
+                                                  alpha, t_opt, alpha_opt,
+                                                  precision);
+  });
+}
+
+CONFSEQ_INLINE std::pair<double, double> BernoulliConfidenceSequence::update(
+    const double num_successes, const int num_trials) {
+  assert(num_trials >= 0);
+  assert(0 <= num_successes && num_successes <= num_trials);
+  num_successes_ += num_successes;
+  num_trials_ += num_trials;
+  if (num_trials_ == 0) {
+    return interval_;
+  }
+  const double empirical_p = num_successes_ / num_trials_;
+  const double previous_lower = lower_;
+  const double previous_upper = upper_;
+  lower_ = empirical_p > 0
+      ? solve(0, empirical_p, 1, -1, previous_lower, 2 * lower_step_) : 0;
+  upper_ = empirical_p < 1
+      ? solve(empirical_p, 1, -1, 1, previous_upper, 2 * upper_step_) : 1;
+  lower_step_ = std::abs(lower_ - previous_lower);
+  upper_step_ = std::abs(upper_ - previous_upper);
+  if (running_intersection_) {
+    interval_ = std::make_pair(std::max(interval_.first, lower_),
+                               std::min(interval_.second, upper_));
+  } else {
+    interval_ = std::make_pair(lower_, upper_);
+  }
+  return interval_;
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+// Finds the root of objective on [lower_limit, upper_limit], where it takes
+// the given signs at the limits. The bracket starts at guess and grows outward
+// by width, quadrupling, until the sign changes, after which TOMS 748
+// converges in a handful of evaluations. Conservative results take the final
+// bracket end where the objective is positive, outside the interval.
+template <class Objective>
+double find_bernoulli_interval_root(
+    const Objective& objective, const double lower_limit,
+    const double upper_limit, const double lower_limit_value,
+    const double upper_limit_value, const double guess, const double width,
+    const SolverPrecision& precision=SolverPrecision()) {
+  CONFSEQ_COUNT_SOLVE();
+  double a = lower_limit, a_value = lower_limit_value;
+  double b = upper_limit, b_value = upper_limit_value;
+  if (lower_limit < guess && guess < upper_limit) {
+    double step = std::max(width, 1e-6 * (upper_limit - lower_limit));
+    const double guess_value = objective(guess);
+    if ((guess_value > 0) == (lower_limit_value > 0)) {
+      a = guess;
+      a_value = guess_value;
+      for (double next = guess + step; next < upper_limit;
+           step *= 4, next = a + step) {
+        const double next_value = objective(next);
+        if ((next_value > 0) == (upper_limit_value > 0)) {
+          b = next;
+          b_value = next_value;
+          break;
+        }
+        CONFSEQ_COUNT(bracket_expansions);
+        a = next;
+        a_value = next_value;
+      }
+    } else {
+      b = guess;
+      b_value = guess_value;
+      for (double next = guess - step; next > lower_limit;
+           step *= 4, next = b - step) {
+        const double next_value = objective(next);
+        if ((next_value > 0) == (lower_limit_value > 0)) {
+          a = next;
+          a_value = next_value;
+          break;
+        }
+        CONFSEQ_COUNT(bracket_expansions);
+        b = next;
+        b_value = next_value;
+      }
+    }
+  }
+  if (a_value == 0) {
+    return a;
+  } else if (b_value == 0) {
+    return b;
+  }
+  boost::uintmax_t max_iter = 100;
+  const std::pair<double, double> result = boost::math::tools::toms748_solve(
+      objective, a, b, a_value, b_value,
+      boost::math::tools::eps_tolerance<double>(precision.bits), max_iter,
+      MathPolicy());
+  if (!precision.conservative) {
+    return pair_average(result);
+  }
+  return lower_limit_value > 0 ? result.first : result.second;
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE double BernoulliConfidenceSequence::solve(
+    const double lower_limit, const double upper_limit,
+    const double lower_limit_value, const double upper_limit_value,
+    const double guess, const double width) const {
+  const BernoulliIntervalObjective objective(
+      num_successes_, num_trials_, t_opt_, alpha_opt_, log(1 / alpha_));
+  return find_bernoulli_interval_root(objective, lower_limit, upper_limit,
+                                      lower_limit_value, upper_limit_value,
+                                      guess, width, precision_);
+}
+
+// Intervals are computed from the bisection-free warm-started solver, so they
+// agree with bernoulli_confidence_interval to solver tolerance. For fixed n,
+// both endpoints increase with the number of successes.
+CONFSEQ_INLINE BernoulliCSTable::BernoulliCSTable(
+    const int n_max, const double alpha, const double t_opt,
+    const double alpha_opt)
+    : n_max_(n_max), alpha_(alpha), t_opt_(t_opt), alpha_opt_(alpha_opt) {
+  assert(n_max >= 0);
+  assert(0 < alpha && alpha < 1);
+  assert(t_opt > 0);
+  double* bounds = new double[2 * num_entries(n_max)];
+  storage_.reset(bounds, std::default_delete<double[]>());
+  bounds_ = bounds;
+  bounds[0] = 0;
+  bounds[1] = 1;
+  parallel_for(n_max, [=](const size_t i) {
+    const int n = i + 1;
+    double* row = bounds + 2 * (size_t(n) * (n + 1) / 2);
+    double lower_step = 0, upper_step = 0;
+    for (int k = 0; k <= n; k++) {
+      const BernoulliIntervalObjective objective(k, n, t_opt, alpha_opt,
+                                                 log(1 / alpha));
+      const double empirical_p = double(k) / n;
+      const double lower_guess = k > 0 ? row[2 * (k - 1)] : 0;
+      const double upper_guess = k > 0 ? row[2 * (k - 1) + 1] : 0;
+      row[2 * k] = k > 0
+          ? find_bernoulli_interval_root(objective, 0, empirical_p, 1, -1,
+                                         lower_guess, 2 * lower_step)
+          : 0;
+      row[2 * k + 1] = k < n
+          ? find_bernoulli_interval_root(objective, empirical_p, 1, -1, 1,
+                                         upper_guess, 2 * upper_step)
+          : 1;
+      if (k > 1) {
+        lower_step = row[2 * k] - lower_guess;
+      }
+      if (k > 0) {
+        upper_step = row[2 * k + 1] - upper_guess;
+      }
+    }
+  }, 0, 1);
+}
+
+namespace bernoulli_cs_table_format {
+const char MAGIC[8] = {'C', 'S', 'B', 'E', 'R', 'N', 'T', '\0'};
+const uint32_t VERSION = 1;
+// Header: magic, version, 4 bytes of padding, alpha, t_opt, alpha_opt, n_max.
+// Bounds follow as (lower, upper) pairs ordered by num_trials, then
+// num_successes, in native byte order and 8-byte aligned.
+const size_t HEADER_SIZE = 48;
+};
+
+CONFSEQ_INLINE void BernoulliCSTable::save(std::ostream& out) const {
+  const uint32_t padding = 0;
+  const uint64_t n_max = n_max_;
+  out.write(bernoulli_cs_table_format::MAGIC,
+            sizeof(bernoulli_cs_table_format::MAGIC));
+  out.write(reinterpret_cast<const char*>(&bernoulli_cs_table_format::VERSION),
+            sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&padding), sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&alpha_), sizeof(double));
+  out.write(reinterpret_cast<const char*>(&t_opt_), sizeof(double));
+  out.write(reinterpret_cast<const char*>(&alpha_opt_), sizeof(double));
+  out.write(reinterpret_cast<const char*>(&n_max), sizeof(uint64_t));
+  out.write(reinterpret_cast<const char*>(bounds_),
+            2 * num_entries(n_max_) * sizeof(double));
+}
+
+// Parses and validates a header, returning n_max.
+CONFSEQ_INLINE int parse_bernoulli_cs_table_header(
+    const char* header, double& alpha, double& t_opt, double& alpha_opt) {
+  uint32_t version;
+  uint64_t n_max;
+  memcpy(&version, header + 8, sizeof(uint32_t));
+  memcpy(&alpha, header + 16, sizeof(double));
+  memcpy(&t_opt, header + 24, sizeof(double));
+  memcpy(&alpha_opt, header + 32, sizeof(double));
+  memcpy(&n_max, header + 40, sizeof(uint64_t));
+  if (memcmp(header, bernoulli_cs_table_format::MAGIC,
+             sizeof(bernoulli_cs_table_format::MAGIC))
+      || version != bernoulli_cs_table_format::VERSION
+      || n_max > uint64_t(std::numeric_limits<int>::max() / 2)) {
+    throw std::runtime_error("Invalid Bernoulli CS table data");
+  }
+  return int(n_max);
+}
+
+CONFSEQ_INLINE BernoulliCSTable BernoulliCSTable::load(std::istream& in) {
+  char header[bernoulli_cs_table_format::HEADER_SIZE];
+  in.read(header, sizeof(header));
+  if (!in) {
+    throw std::runtime_error("Invalid Bernoulli CS table data");
+  }
+  double alpha, t_opt, alpha_opt;
+  const int n_max = parse_bernoulli_cs_table_header(header, alpha, t_opt,
+                                                    alpha_opt);
+  const auto bounds = std::make_shared<std::vector<double>>(
+      read_array<double>(in, 2 * num_entries(n_max)));
+  if (!in) {
+    throw std::runtime_error("Truncated Bernoulli CS table data");
+  }
+  return BernoulliCSTable(n_max, alpha, t_opt, alpha_opt,
+                          std::shared_ptr<const double>(bounds,
+                                                        bounds->data()),
+                          bounds->data());
+}
+
+CONFSEQ_INLINE BernoulliCSTable BernoulliCSTable::map_file(
+    const std::string& path) {
+#ifdef CONFSEQ_HAVE_MMAP
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || size_t(file_stat.st_size) < bernoulli_cs_table_format::HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Invalid Bernoulli CS table data");
+  }
+  const size_t file_size = file_stat.st_size;
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + path);
+  }
+  std::shared_ptr<const double> storage(
+      static_cast<const double*>(mapping),
+      [file_size](const double* data) {
+        munmap(const_cast<double*>(data), file_size);
+      });
+  double alpha, t_opt, alpha_opt;
+  const int n_max = parse_bernoulli_cs_table_header(
+      static_cast<const char*>(mapping), alpha, t_opt, alpha_opt);
+  if (file_size < bernoulli_cs_table_format::HEADER_SIZE
+      + 2 * num_entries(n_max) * sizeof(double)) {
+    throw std::runtime_error("Truncated Bernoulli CS table data");
+  }
+  const double* bounds = storage.get()
+      + bernoulli_cs_table_format::HEADER_SIZE / sizeof(double);
+  return BernoulliCSTable(n_max, alpha, t_opt, alpha_opt, std::move(storage),
+                          bounds);
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  return load(in);
+#endif
+}
+
+namespace sorted_column_format {
+const char MAGIC[8] = {'C', 'S', 'C', 'O', 'L', 'U', 'M', '\0'};
+const uint32_t VERSION = 1;
+// Header: magic, version, 4 bytes of padding, num_values. Values follow as
+// ascending doubles in native byte order, 8-byte aligned.
+const size_t HEADER_SIZE = 24;
+};
+
+// Parses and validates a header, returning num_values.
+CONFSEQ_INLINE int parse_sorted_column_header(const char* header) {
+  uint32_t version;
+  uint64_t num_values;
+  memcpy(&version, header + 8, sizeof(uint32_t));
+  memcpy(&num_values, header + 16, sizeof(uint64_t));
+  if (memcmp(header, sorted_column_format::MAGIC,
+             sizeof(sorted_column_format::MAGIC))
+      || version != sorted_column_format::VERSION
+      || num_values > uint64_t(std::numeric_limits<int>::max())) {
+    throw std::runtime_error("Invalid sorted column data");
+  }
+  return int(num_values);
+}
+
+CONFSEQ_INLINE MappedOrderStatistics MappedOrderStatistics::load(
+    std::istream& in) {
+  char header[sorted_column_format::HEADER_SIZE];
+  in.read(header, sizeof(header));
+  if (!in) {
+    throw std::runtime_error("Invalid sorted column data");
+  }
+  const int size = parse_sorted_column_header(header);
+  const auto values = std::make_shared<std::vector<double>>(
+      read_array<double>(in, size));
+  if (!in) {
+    throw std::runtime_error("Truncated sorted column data");
+  }
+  return MappedOrderStatistics(
+      std::shared_ptr<const double>(values, values->data()), values->data(),
+      size);
+}
+
+CONFSEQ_INLINE MappedOrderStatistics MappedOrderStatistics::map_file(
+    const std::string& path) {
+#ifdef CONFSEQ_HAVE_MMAP
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || size_t(file_stat.st_size) < sorted_column_format::HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Invalid sorted column data");
+  }
+  const size_t file_size = file_stat.st_size;
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + path);
+  }
+  std::shared_ptr<const double> storage(
+      static_cast<const double*>(mapping),
+      [file_size](const double* data) {
+        munmap(const_cast<double*>(data), file_size);
+      });
+  const int size = parse_sorted_column_header(
+      static_cast<const char*>(mapping));
+  if (file_size < sorted_column_format::HEADER_SIZE
+      + size_t(size) * sizeof(double)) {
+    throw std::runtime_error("Truncated sorted column data");
+  }
+  const double* values = storage.get()
+      + sorted_column_format::HEADER_SIZE / sizeof(double);
+  return MappedOrderStatistics(std::move(storage), values, size);
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  return load(in);
+#endif
+}
+
+CONFSEQ_INLINE void build_sorted_column(const std::string& input_path,
+                                        const std::string& output_path,
+                                        const size_t max_values_in_memory) {
+  std::ifstream in(input_path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Unable to open " + input_path);
+  }
+  const size_t run_size = std::max<size_t>(1, max_values_in_memory);
+  std::vector<std::string> run_paths;
+  try {
+    // Sort runs that fit in memory.
+    uint64_t num_values = 0;
+    std::vector<double> buffer;
+    while (in) {
+      buffer.resize(run_size);
+      in.read(reinterpret_cast<char*>(buffer.data()),
+              run_size * sizeof(double));
+      if (in.gcount() % sizeof(double) != 0) {
+        throw std::runtime_error("Truncated value in " + input_path);
+      }
+      buffer.resize(in.gcount() / sizeof(double));
+      if (buffer.empty()) {
+        break;
+      }
+      num_values += buffer.size();
+      if (num_values > uint64_t(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("Too many values in " + input_path);
+      }
+      if (std::any_of(buffer.begin(), buffer.end(),
+                      [](const double value) { return std::isnan(value); })) {
+        throw std::runtime_error("NaN value in " + input_path);
+      }
+      parallel_sort(buffer.begin(), buffer.end());
+      run_paths.push_back(output_path + ".run"
+                          + std::to_string(run_paths.size()));
+      std::ofstream run(run_paths.back(), std::ios::binary);
+      run.write(reinterpret_cast<const char*>(buffer.data()),
+                buffer.size() * sizeof(double));
+      if (!run) {
+        throw std::runtime_error("Unable to write " + run_paths.back());
+      }
+    }
+    if (in.bad()) {
+      throw std::runtime_error("Unable to read " + input_path);
+    }
+    buffer = std::vector<double>();
+
+    // Merge the runs, splitting the memory budget between a read buffer for
+    // each run and the output buffer.
+    struct RunReader {
+      std::ifstream in;
+      std::vector<double> buffer;
+      size_t buffer_size;
+      size_t position;
+
+      bool refill() {
+        buffer.resize(buffer_size);
+        in.read(reinterpret_cast<char*>(buffer.data()),
+                buffer_size * sizeof(double));
+        buffer.resize(in.gcount() / sizeof(double));
+        position = 0;
+        return !buffer.empty();
+      }
+    };
+    const size_t buffer_size = std::max<size_t>(
+        1, run_size / (run_paths.size() + 1));
+    std::vector<std::unique_ptr<RunReader>> runs;
+    using Head = std::pair<double, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (const std::string& run_path : run_paths) {
+      runs.emplace_back(new RunReader());
+      RunReader& run = *runs.back();
+      run.in.open(run_path, std::ios::binary);
+      run.buffer_size = buffer_size;
+      if (!run.in || !run.refill()) {
+        throw std::runtime_error("Unable to read " + run_path);
+      }
+      heads.push(Head(run.buffer[0], runs.size() - 1));
+    }
+
+    std::ofstream out(output_path, std::ios::binary);
+    const uint32_t padding = 0;
+    out.write(sorted_column_format::MAGIC,
+              sizeof(sorted_column_format::MAGIC));
+    out.write(reinterpret_cast<const char*>(&sorted_column_format::VERSION),
+              sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&padding), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&num_values), sizeof(uint64_t));
+    std::vector<double> output;
+    output.reserve(buffer_size);
+    auto flush = [&out, &output]() {
+      out.write(reinterpret_cast<const char*>(output.data()),
+                output.size() * sizeof(double));
+      output.clear();
+    };
+    while (!heads.empty()) {
+      const Head head = heads.top();
+      heads.pop();
+      output.push_back(head.first);
+      if (output.size() == buffer_size) {
+        flush();
+      }
+      RunReader& run = *runs[head.second];
+      if (++run.position < run.buffer.size() || run.refill()) {
+        heads.push(Head(run.buffer[run.position], head.second));
+      }
+    }
+    flush();
+    if (!out) {
+      throw std::runtime_error("Unable to write " + output_path);
+    }
+  } catch (...) {
+    for (const std::string& run_path : run_paths) {
+      std::remove(run_path.c_str());
+    }
+    throw;
+  }
+  for (const std::string& run_path : run_paths) {
+    std::remove(run_path.c_str());
+  }
+}
+
+// np.minimum and np.maximum, which propagate NaN from either argument.
+CONFSEQ_INLINE double nan_propagating_min(const double a, const double b) {
+  return (a < b || std::isnan(a)) ? a : b;
+}
+CONFSEQ_INLINE double nan_propagating_max(const double a, const double b) {
+  return (a > b || std::isnan(a)) ? a : b;
+}
+
+CONFSEQ_INLINE void SignedLogCapital::multiply_by_one_plus(const double delta) {
+  if (delta < -1) {
+    log_abs += log(-1 - delta);
+    negative = !negative;
+  } else {
+    log_abs += log1p(delta);
+  }
+}
+
+CONFSEQ_INLINE SignedLogCapital SignedLogCapital::patched() const {
+  return std::isnan(log_abs)
+      ? SignedLogCapital{-std::numeric_limits<double>::infinity(), false}
+      : *this;
+}
+
+CONFSEQ_INLINE SignedLogCapital SignedLogCapital::scaled(
+    const double log_weight) const {
+  return SignedLogCapital{log_abs + log_weight, negative};
+}
+
+CONFSEQ_INLINE bool SignedLogCapital::operator<(
+    const SignedLogCapital& other) const {
+  if (negative != other.negative) {
+    return negative && !(log_abs == other.log_abs && std::isinf(log_abs)
+                         && log_abs < 0);
+  }
+  return negative ? log_abs > other.log_abs : log_abs < other.log_abs;
+}
+
+CONFSEQ_INLINE SignedLogCapital operator+(const SignedLogCapital& a,
+                                          const SignedLogCapital& b) {
+  const SignedLogCapital& larger = a.log_abs >= b.log_abs ? a : b;
+  const SignedLogCapital& smaller = a.log_abs >= b.log_abs ? b : a;
+  if (std::isinf(larger.log_abs)) {
+    return larger.log_abs < 0 || larger.negative == smaller.negative
+        || smaller.log_abs != larger.log_abs
+        ? larger
+        : SignedLogCapital{std::numeric_limits<double>::quiet_NaN(), false};
+  }
+  const double ratio = exp(smaller.log_abs - larger.log_abs);
+  return SignedLogCapital{
+      larger.log_abs + log1p(larger.negative == smaller.negative ? ratio
+                                                                 : -ratio),
+      larger.negative};
+}
+
+// The conditional mean of observation i given the sum of the earlier ones.
+CONFSEQ_INLINE double betting_conditional_mean(const BettingOptions& options,
+                                               const double m, const size_t i,
+                                               const double sum) {
+  return options.N > 0 ? (options.N * m - sum) / (options.N - double(i)) : m;
+}
+
+// Truncates bets against the null mean m as options specify, where mu is the
+// conditional mean.
+CONFSEQ_INLINE void truncate_bets(const BettingOptions& options, const double m,
+                                  const double mu, double& lambda_positive,
+                                  double& lambda_negative) {
+  const double trunc_scale = options.trunc_scale;
+  if (options.cap_negative_bets_at_m) {
+    lambda_negative = nan_propagating_min(m, lambda_negative);
+  }
+  if (options.m_trunc) {
+    // Observations lie in [0, max_weight], so x - mu >= -mu and
+    // x - mu <= max_weight - mu.
+    const double headroom = options.max_weight - mu;
+    lambda_positive = nan_propagating_max(
+        nan_propagating_min(lambda_positive, trunc_scale / mu),
+        -trunc_scale / headroom);
+    lambda_negative = nan_propagating_max(
+        nan_propagating_min(lambda_negative, trunc_scale / headroom),
+        -trunc_scale / mu);
+  } else {
+    const double truncation = trunc_scale / options.max_weight;
+    lambda_positive = nan_propagating_max(
+        nan_propagating_min(lambda_positive, truncation), -truncation);
+    lambda_negative = nan_propagating_max(
+        nan_propagating_min(lambda_negative, truncation), -truncation);
+  }
+}
+
+// lambda * centered, the relative change in capital, except that infinite
+// bets on observations at the mean leave capital unchanged.
+CONFSEQ_INLINE double bet_return(const double lambda, const double centered) {
+  return lambda == std::numeric_limits<double>::infinity() && centered == 0
+      ? 0 : lambda * centered;
+}
+
+CONFSEQ_INLINE double BettingCapital::update(const size_t i, const double x,
+                                             const double sum,
+                                             double lambda_positive,
+                                             double lambda_negative) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const double theta = options_.theta;
+  const double mu = betting_conditional_mean(options_, m_, i, sum);
+  truncate_bets(options_, m_, mu, lambda_positive, lambda_negative);
+  const double centered = x - mu;
+  const double delta_positive = bet_return(lambda_positive, centered);
+  const double delta_negative = -bet_return(lambda_negative, centered);
+
+  double capital;
+  bool is_negative;
+  if (options_.log_space) {
+    if (theta != 0) {
+      log_positive_.multiply_by_one_plus(delta_positive);
+    }
+    if (theta != 1) {
+      log_negative_.multiply_by_one_plus(delta_negative);
+    }
+    const SignedLogCapital weighted_positive =
+        log_positive_.patched().scaled(log_theta_);
+    const SignedLogCapital weighted_negative =
+        log_negative_.patched().scaled(log_one_minus_theta_);
+    SignedLogCapital combined;
+    if (theta == 1) {
+      combined = weighted_positive;
+    } else if (theta == 0) {
+      combined = weighted_negative;
+    } else if (options_.convex_comb) {
+      combined = weighted_positive + weighted_negative;
+    } else {
+      combined = weighted_positive < weighted_negative
+          ? weighted_negative : weighted_positive;
+    }
+    capital = combined.log_abs;
+    is_negative = std::isnan(combined.log_abs)
+        || (combined.negative && combined.log_abs > -inf);
+  } else {
+    if (theta != 0) {
+      positive_ *= 1 + delta_positive;
+    }
+    if (theta != 1) {
+      negative_ *= 1 + delta_negative;
+    }
+    const double weighted_positive =
+        theta * (std::isnan(positive_) ? 0 : positive_);
+    const double weighted_negative =
+        (1 - theta) * (std::isnan(negative_) ? 0 : negative_);
+    if (theta == 1) {
+      capital = weighted_positive;
+    } else if (theta == 0) {
+      capital = weighted_negative;
+    } else if (options_.convex_comb) {
+      capital = weighted_positive + weighted_negative;
+    } else {
+      capital = std::max(weighted_positive, weighted_negative);
+    }
+    is_negative = !(capital >= 0);
+  }
+  // If mu < 0 or mu > 1, we cannot be under the null.
+  if (mu < 0 || mu > 1) {
+    return inf;
+  } else if (is_negative) {
+    throw std::invalid_argument("Betting capital process is negative");
+  }
+  return capital;
+}
+
+CONFSEQ_INLINE void betting_capital_process(const double* x, const size_t n,
+                                            const double m,
+                                            const double* lambdas_positive,
+                                            const double* lambdas_negative,
+                                            const BettingOptions& options,
+                                            double* capital) {
+  assert(0 < options.trunc_scale && options.trunc_scale <= 1);
+  BettingCapital process(m, options);
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    capital[i] = process.update(i, x[i], sum, lambdas_positive[i],
+                                lambdas_negative[i]);
+    sum += x[i];
+  }
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class CapitalFn>
+void grid_accepted_range(const size_t grid_size, const size_t n,
+                         const double threshold, CapitalFn capital_fn,
+                         int* first_accepted, int* last_accepted,
+                         int num_threads) {
+  grid_accepted_range(grid_size, n, &threshold, 1, capital_fn, first_accepted,
+                      last_accepted, num_threads);
+}
+
+template <class CapitalFn>
+void grid_accepted_range(const size_t grid_size, const size_t n,
+                         const double* thresholds,
+                         const size_t num_thresholds, CapitalFn capital_fn,
+                         int* first_accepted, int* last_accepted,
+                         int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = get_num_threads();
+  }
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(num_threads, grid_size));
+  const size_t size = num_thresholds * n;
+  ScratchScope scratch;
+  int* chunk_first = scratch.allocate<int>(num_chunks * size, -1);
+  int* chunk_last = scratch.allocate<int>(num_chunks * size, -1);
+  parallel_for(num_chunks, [&](const size_t chunk) {
+    int* first = chunk_first + chunk * size;
+    int* last = chunk_last + chunk * size;
+    ScratchScope chunk_scratch;
+    double* capital = chunk_scratch.allocate<double>(n);
+    const size_t end = grid_size * (chunk + 1) / num_chunks;
+    for (size_t i = grid_size * chunk / num_chunks; i < end; i++) {
+      capital_fn(i, capital);
+      for (size_t k = 0; k < num_thresholds; k++) {
+        const double threshold = thresholds[k];
+        int* threshold_first = first + k * n;
+        int* threshold_last = last + k * n;
+        for (size_t t = 0; t < n; t++) {
+          if (capital[t] <= threshold) {
+            if (threshold_first[t] < 0) {
+              threshold_first[t] = i;
+            }
+            threshold_last[t] = i;
+          }
+        }
+      }
+    }
+  }, num_chunks, 1);
+  for (size_t j = 0; j < size; j++) {
+    first_accepted[j] = -1;
+    last_accepted[j] = -1;
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+      if (first_accepted[j] < 0) {
+        first_accepted[j] = chunk_first[chunk * size + j];
+      }
+      last_accepted[j] = std::max(last_accepted[j],
+                                  chunk_last[chunk * size + j]);
+    }
+  }
+}
+
+template <class UpdateFn>
+void tiled_grid_accepted_range(const double* x, const size_t n,
+                               const size_t grid_size,
+                               const double* thresholds,
+                               const size_t num_thresholds, UpdateFn update,
+                               int* first_accepted, int* last_accepted,
+                               int num_threads) {
+  const size_t block_size = 256;
+  const size_t tile_size = 8;
+  if (num_threads <= 0) {
+    num_threads = get_num_threads();
+  }
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(num_threads, grid_size));
+  const size_t size = num_thresholds * n;
+  ScratchScope scratch;
+  int* chunk_first = scratch.allocate<int>(num_chunks * size, -1);
+  int* chunk_last = scratch.allocate<int>(num_chunks * size, -1);
+  parallel_for(num_chunks, [&](const size_t chunk) {
+    int* first = chunk_first + chunk * size;
+    int* last = chunk_last + chunk * size;
+    ScratchScope chunk_scratch;
+    double* sums = chunk_scratch.allocate<double>(block_size);
+    const size_t chunk_begin = grid_size * chunk / num_chunks;
+    const size_t chunk_end = grid_size * (chunk + 1) / num_chunks;
+    double sum = 0;
+    for (size_t begin = 0; begin < n; begin += block_size) {
+      const size_t end = std::min(n, begin + block_size);
+      for (size_t i = begin; i < end; i++) {
+        sums[i - begin] = sum;
+        sum += x[i];
+      }
+      for (size_t tile = chunk_begin; tile < chunk_end; tile += tile_size) {
+        const size_t tile_end = std::min(chunk_end, tile + tile_size);
+        for (size_t i = begin; i < end; i++) {
+          double capital[tile_size];
+          for (size_t j = tile; j < tile_end; j++) {
+            capital[j - tile] = update(j, i, sums[i - begin]);
+          }
+          for (size_t k = 0; k < num_thresholds; k++) {
+            int tile_first = -1, tile_last = -1;
+            for (size_t j = tile; j < tile_end; j++) {
+              if (capital[j - tile] <= thresholds[k]) {
+                tile_first = tile_first < 0 ? int(j) : tile_first;
+                tile_last = int(j);
+              }
+            }
+            if (tile_last >= 0) {
+              if (first[k * n + i] < 0) {
+                first[k * n + i] = tile_first;
+              }
+              last[k * n + i] = tile_last;
+            }
+          }
+        }
+      }
+    }
+  }, num_chunks, 1);
+  for (size_t j = 0; j < size; j++) {
+    first_accepted[j] = -1;
+    last_accepted[j] = -1;
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+      if (first_accepted[j] < 0) {
+        first_accepted[j] = chunk_first[chunk * size + j];
+      }
+      last_accepted[j] = std::max(last_accepted[j],
+                                  chunk_last[chunk * size + j]);
+    }
+  }
+}
+
+template <class UpdateFn>
+void pruned_grid_cs(const double* x, const size_t n, const double* grid,
+                    const size_t grid_size, const int breaks,
+                    const double threshold, const double N, UpdateFn update,
+                    double* lower, double* upper, int num_threads) {
+  const size_t block_size = 256;
+  ScratchVector<size_t> active(grid_size);
+  for (size_t j = 0; j < grid_size; j++) {
+    active[j] = j;
+  }
+  // rejected[k] is the time at which active[k] is rejected within the block,
+  // or the end of the block if it is not.
+  ScratchVector<size_t> rejected(grid_size);
+  ScratchScope scratch;
+  double* sums = scratch.allocate<double>(block_size);
+  int* first = scratch.allocate<int>(block_size);
+  int* last = scratch.allocate<int>(block_size);
+  double sum = 0;
+  std::pair<double, double> interval(0, 1);
+  for (size_t begin = 0; begin < n; begin += block_size) {
+    const size_t end = std::min(n, begin + block_size);
+    for (size_t i = begin; i < end; i++) {
+      sums[i - begin] = sum;
+      sum += x[i];
+    }
+    parallel_for(active.size(), [&](const size_t k) {
+      rejected[k] = end;
+      for (size_t i = begin; i < end; i++) {
+        if (update(active[k], i, sums[i - begin]) > threshold) {
+          rejected[k] = i;
+          break;
+        }
+      }
+    }, num_threads, 16);
+    // Means surviving to time i are those rejected after it, so the first
+    // (last) of them is found by one ascending (descending) pass.
+    std::fill_n(first, end - begin, -1);
+    std::fill_n(last, end - begin, -1);
+    size_t filled = begin;
+    for (size_t k = 0; k < active.size() && filled < end; k++) {
+      for (; filled < rejected[k]; filled++) {
+        first[filled - begin] = int(active[k]);
+      }
+    }
+    filled = begin;
+    for (size_t k = active.size(); k > 0 && filled < end; k--) {
+      for (; filled < rejected[k - 1]; filled++) {
+        last[filled - begin] = int(active[k - 1]);
+      }
+    }
+    for (size_t i = begin; i < end; i++) {
+      const std::pair<double, double> current = grid_cs_interval(
+          grid, breaks, first[i - begin], last[i - begin], N, i,
+          sums[i - begin] + x[i]);
+      interval.first = std::max(interval.first, current.first);
+      interval.second = std::min(interval.second, current.second);
+      lower[i] = interval.first;
+      upper[i] = interval.second;
+    }
+    size_t kept = 0;
+    for (size_t k = 0; k < active.size(); k++) {
+      if (rejected[k] == end) {
+        active[kept++] = active[k];
+      }
+    }
+    active.resize(kept);
+  }
+}
+
+template <class UpdateFn>
+void grid_first_rejections(const double* x, const size_t n,
+                           const size_t num_nulls, const double threshold,
+                           UpdateFn update, size_t* times, int num_threads) {
+  ScratchVector<size_t> active(num_nulls);
+  for (size_t j = 0; j < num_nulls; j++) {
+    active[j] = j;
+    times[j] = 0;
+  }
+  const size_t block_size = 256;
+  // sums[i] is the sum of the observations before x[begin + i].
+  ScratchScope scratch;
+  double* sums = scratch.allocate<double>(block_size);
+  double sum = 0;
+  for (size_t begin = 0; begin < n && !active.empty(); begin += block_size) {
+    const size_t end = std::min(n, begin + block_size);
+    for (size_t i = begin; i < end; i++) {
+      sums[i - begin] = sum;
+      sum += x[i];
+    }
+    parallel_for(active.size(), [&](const size_t k) {
+      const size_t j = active[k];
+      for (size_t i = begin; i < end; i++) {
+        if (update(j, i, sums[i - begin]) > threshold) {
+          times[j] = i + 1;
+          break;
+        }
+      }
+    }, num_threads, 16);
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [times](const size_t j) {
+                                  return times[j] != 0;
+                                }),
+                 active.end());
+  }
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE void betting_grid_accepted_range(const double* x, const size_t n,
+                                                const double* grid,
+                                                const size_t grid_size,
+                                                const double* lambdas_positive,
+                                                const double* lambdas_negative,
+                                                const BettingOptions& options,
+                                                const double threshold,
+                                                int* first_accepted,
+                                                int* last_accepted,
+                                                const int num_threads) {
+  assert(0 < options.trunc_scale && options.trunc_scale <= 1);
+  ScratchVector<BettingCapital> capital;
+  capital.reserve(grid_size);
+  for (size_t j = 0; j < grid_size; j++) {
+    capital.emplace_back(grid[j], options);
+  }
+  const double limit = options.log_space ? log(threshold) : threshold;
+  tiled_grid_accepted_range(
+      x, n, grid_size, &limit, 1,
+      [&](const size_t j, const size_t i, const double sum) {
+        return capital[j].update(i, x[i], sum, lambdas_positive[i],
+                                 lambdas_negative[i]);
+      },
+      first_accepted, last_accepted, num_threads);
+}
+
+CONFSEQ_INLINE void betting_first_rejections(
+    const double* x, const size_t n, const double* nulls,
+    const size_t num_nulls, const double* lambdas_positive,
+    const double* lambdas_negative, const BettingOptions& options,
+    const double threshold, size_t* times, const int num_threads) {
+  const TraceScope trace(TracedFunction::BETTING_FIRST_REJECTIONS, n);
+  ScratchVector<BettingCapital> capital;
+  capital.reserve(num_nulls);
+  for (size_t j = 0; j < num_nulls; j++) {
+    capital.emplace_back(nulls[j], options);
+  }
+  grid_first_rejections(
+      x, n, num_nulls, options.log_space ? log(threshold) : threshold,
+      [&](const size_t j, const size_t i, const double sum) {
+        return capital[j].update(i, x[i], sum, lambdas_positive[i],
+                                 lambdas_negative[i]);
+      },
+      times, num_threads);
+}
+
+CONFSEQ_INLINE void betting_cs_bisection(const double* x, const size_t n,
+                                         const double* lambdas_positive,
+                                         const double* lambdas_negative,
+                                         const BettingOptions& options,
+                                         const double threshold,
+                                         const double tolerance, double* lower,
+                                         double* upper) {
+  const TraceScope trace(TracedFunction::BETTING_CS_BISECTION, n);
+  assert(tolerance > 0);
+  const double limit = options.log_space ? log(threshold) : threshold;
+  struct Tracked {
+    BettingCapital capital;
+    double value;
+  };
+  auto accepted = [limit](const Tracked& tracked) {
+    return tracked.value <= limit;
+  };
+  // sums[i] is the sum of x[0..i).
+  std::vector<double> sums(n + 1, 0);
+  size_t t = 0;
+  // Capital at m after observations 0..t, from the start of the stream.
+  auto evaluate = [&](const double m) {
+    Tracked tracked = {BettingCapital(m, options), 0};
+    for (size_t i = 0; i <= t; i++) {
+      tracked.value = tracked.capital.update(
+          i, x[i], sums[i], lambdas_positive[i], lambdas_negative[i]);
+    }
+    return tracked;
+  };
+  // Searches (lo, hi) for an accepted mean, halving the spacing between
+  // probes down to tolerance.
+  auto find_accepted = [&](const double lo, const double hi, Tracked& found) {
+    for (double h = (hi - lo) / 2; h > 0; h /= 2) {
+      for (double m = lo + h; m < hi; m += 2 * h) {
+        found = evaluate(m);
+        if (accepted(found)) {
+          return true;
+        }
+      }
+      if (h <= tolerance) {
+        break;
+      }
+    }
+    return false;
+  };
+  // Restores the bracket on the side of the interval toward edge, 0 or 1:
+  // inside accepted and outside rejected, at most tolerance apart, or inside
+  // at edge and accepted with has_outside false. With known, the states are
+  // carried from the previous time; otherwise only anchor is known to be
+  // accepted.
+  auto restore_bracket = [&](Tracked& inside, Tracked& outside,
+                             bool& has_outside, const double edge,
+                             const Tracked& anchor, const bool known) {
+    const double direction = edge == 0 ? -1 : 1;
+    if (known && accepted(inside)) {
+      if (!has_outside || !accepted(outside)) {
+        return;
+      }
+      // The endpoint moved outward, so gallop toward edge.
+      inside = outside;
+      for (double step = tolerance; ; step *= 2) {
+        const double m = inside.capital.m() + direction * step;
+        outside = evaluate(direction * (m - edge) >= 0 ? edge : m);
+        if (!accepted(outside)) {
+          break;
+        }
+        inside = outside;
+        if (inside.capital.m() == edge) {
+          has_outside = false;
+          return;
+        }
+      }
+    } else {
+      if (known) {
+        outside = inside;
+      } else {
+        outside = evaluate(edge);
+        if (accepted(outside)) {
+          inside = outside;
+          has_outside = false;
+          return;
+        }
+      }
+      has_outside = true;
+      // The endpoint moved inward, so gallop toward the anchor.
+      inside = anchor;
+      for (double step = tolerance; ; step *= 2) {
+        const double m = outside.capital.m() - direction * step;
+        if (direction * (m - anchor.capital.m()) <= 0) {
+          break;
+        }
+        const Tracked probe = evaluate(m);
+        if (accepted(probe)) {
+          inside = probe;
+          break;
+        }
+        outside = probe;
+      }
+    }
+    while (std::abs(inside.capital.m() - outside.capital.m()) > tolerance) {
+      const Tracked middle = evaluate(
+          (inside.capital.m() + outside.capital.m()) / 2);
+      (accepted(middle) ? inside : outside) = middle;
+    }
+  };
+
+  Tracked lower_inside = {BettingCapital(0, options), 0};
+  Tracked lower_outside = lower_inside;
+  Tracked upper_inside = {BettingCapital(1, options), 0};
+  Tracked upper_outside = upper_inside;
+  bool has_lower_outside = false, has_upper_outside = false;
+  bool known = true;
+  for (t = 0; t < n; t++) {
+    sums[t + 1] = sums[t] + x[t];
+    if (known) {
+      for (Tracked* tracked : {&lower_inside, &lower_outside, &upper_inside,
+                               &upper_outside}) {
+        tracked->value = tracked->capital.update(
+            t, x[t], sums[t], lambdas_positive[t], lambdas_negative[t]);
+      }
+    }
+    Tracked anchor = lower_inside;
+    bool found = known && accepted(lower_inside);
+    if (!found && known && accepted(upper_inside)) {
+      anchor = upper_inside;
+      found = true;
+    }
+    if (!found && known) {
+      found = find_accepted(lower_inside.capital.m(),
+                            upper_inside.capital.m(), anchor);
+    }
+    if (!found) {
+      for (const double m : {0.0, 1.0}) {
+        anchor = evaluate(m);
+        if (accepted(anchor)) {
+          found = true;
+          break;
+        }
+      }
+    }
+    if (!found && !find_accepted(0, 1, anchor)) {
+      known = false;
+      lower[t] = 0;
+      upper[t] = 1;
+      continue;
+    }
+    restore_bracket(lower_inside, lower_outside, has_lower_outside, 0, anchor,
+                    known);
+    restore_bracket(upper_inside, upper_outside, has_upper_outside, 1, anchor,
+                    known);
+    known = true;
+    lower[t] = has_lower_outside ? lower_outside.capital.m() : 0;
+    upper[t] = has_upper_outside ? upper_outside.capital.m() : 1;
+  }
+}
+
+CONFSEQ_INLINE BettingStrategyKind betting_strategy_kind(
+    const std::string& name) {
+  if (name == "predmix_eb") {
+    return BettingStrategyKind::PREDMIX_EB;
+  } else if (name == "aKelly") {
+    return BettingStrategyKind::AKELLY;
+  } else if (name == "LBOW") {
+    return BettingStrategyKind::LBOW;
+  } else if (name == "fixed_fraction") {
+    return BettingStrategyKind::FIXED_FRACTION;
+  }
+  throw std::invalid_argument("Unknown betting strategy: " + name);
+}
+
+// lambda_predmix_eb at time t from the regularized variance of the earlier
+// observations, optimized for fixed_n if positive.
+CONFSEQ_INLINE double predmix_bet(
+    const BettingStrategyParams& params, const double log_inverse_alpha,
+    const double t, const double fixed_n, const double variance) {
+  double bet = fixed_n > 0
+      ? sqrt(2 * log_inverse_alpha / (fixed_n * variance))
+      : sqrt(2 * log_inverse_alpha / (t * log(1 + t) * variance));
+  if (std::isnan(bet)) {
+    bet = 0;
+  }
+  return std::min(params.truncation, bet) * params.scale;
+}
+
+CONFSEQ_INLINE double PredmixBets::bet() const {
+  const double fake_obs = params_.fake_obs;
+  const double variance = t_ == 0
+      ? params_.prior_variance
+      : (fake_obs * params_.prior_variance + regularized_squares_)
+          / (t_ + fake_obs);
+  return predmix_bet(params_, log_inverse_alpha_, t_ + 1, params_.fixed_n,
+                     variance);
+}
+
+CONFSEQ_INLINE void PredmixBets::add(const double x) {
+  sum_ += x;
+  t_++;
+  const double deviation = x - (params_.fake_obs * params_.prior_mean + sum_)
+      / (t_ + params_.fake_obs);
+  regularized_squares_ += deviation * deviation;
+}
+
+CONFSEQ_INLINE void KellyBets::kelly_condition(const double l, double* value,
+                                               double* slope) const {
+  // Four independent accumulators, so that successive divisions need not
+  // wait on a single running sum, which the compiler may not reassociate.
+  double values[4] = {0, 0, 0, 0};
+  double slopes[4] = {0, 0, 0, 0};
+  const size_t size = residuals_.size();
+  const double* residuals = residuals_.data();
+  const double* counts = counts_.data();
+  size_t j = 0;
+  for (; j + 4 <= size; j += 4) {
+    for (size_t k = 0; k < 4; k++) {
+      const double ratio = residuals[j + k] / (1 + l * residuals[j + k]);
+      values[k] += counts[j + k] * ratio;
+      slopes[k] -= counts[j + k] * ratio * ratio;
+    }
+  }
+  for (; j < size; j++) {
+    const double ratio = residuals[j] / (1 + l * residuals[j]);
+    values[0] += counts[j] * ratio;
+    slopes[0] -= counts[j] * ratio * ratio;
+  }
+  *value = (values[0] + values[1]) + (values[2] + values[3]);
+  *slope = (slopes[0] + slopes[1]) + (slopes[2] + slopes[3]);
+}
+
+// The Kelly condition decreases strictly on (lower, upper) from +inf to
+// -inf, so it has a single root there. Newton steps leaving the shrinking
+// bracket are replaced by bisection.
+CONFSEQ_INLINE double KellyBets::solve(
+    double lower, double upper, const double start) const {
+  const int max_iterations = 100;
+  const double tolerance = 1e-12;
+  double l = start;
+  if (!(l > lower && l < upper)) {
+    l = (lower + upper) / 2;
+  }
+  for (int iteration = 0; iteration < max_iterations; iteration++) {
+    double value, slope;
+    kelly_condition(l, &value, &slope);
+    if (value == 0 || std::isnan(value)) {
+      break;
+    }
+    if (value > 0) {
+      lower = l;
+    } else {
+      upper = l;
+    }
+    double next = l - value / slope;
+    if (!(next > lower && next < upper)) {
+      next = (lower + upper) / 2;
+    }
+    const bool converged =
+        std::abs(next - l) <= tolerance * std::max(1.0, std::abs(l));
+    l = next;
+    if (converged) {
+      break;
+    }
+  }
+  return l;
+}
+
+CONFSEQ_INLINE void KellyBets::add(const double x) {
+  const double residual = x - m_;
+  t_++;
+  min_ = std::min(min_, x);
+  max_ = std::max(max_, x);
+  bool found = false;
+  if (residuals_.size() <= max_distinct_) {
+    for (size_t j = 0; j < residuals_.size(); j++) {
+      if (residuals_[j] == residual) {
+        counts_[j]++;
+        found = true;
+        break;
+      }
+    }
+  }
+  if (!found) {
+    residuals_.push_back(residual);
+    counts_.push_back(1);
+  }
+  if (max_ <= m_) {
+    bet_ = -1 / (1 - m_);
+  } else if (min_ >= m_) {
+    bet_ = 1 / m_;
+  } else {
+    bet_ = solve(-1 / (max_ - m_), 1 / (m_ - min_), bet_);
+  }
+  if (std::isnan(bet_)) {
+    bet_ = 0;
+  }
+}
+
+CONFSEQ_INLINE void kelly_bets(const double* x, const size_t n, const double m,
+                               double* bets) {
+  KellyBets kelly(m);
+  for (size_t i = 0; i < n; i++) {
+    bets[i] = kelly.bet();
+    kelly.add(x[i]);
+  }
+}
+
+// Running statistics follow the cumsums of betting_strategies.py term by term,
+// so native bets match the Python ones to rounding.
+CONFSEQ_INLINE BettingStrategy::BettingStrategy(
+    const double* x, const size_t n, const BettingStrategyParams& params,
+    const double N)
+    : params_(params), N_(N) {
+  const BettingStrategyKind kind = params.kind;
+  const double fake_obs = params.fake_obs;
+  const double prior_mean = params.prior_mean;
+  const double prior_variance = params.prior_variance;
+  if (kind == BettingStrategyKind::PREDMIX_EB) {
+    bets_.resize(n);
+  } else {
+    sums_.resize(n);
+  }
+  if (kind == BettingStrategyKind::AKELLY
+      || kind == BettingStrategyKind::LBOW) {
+    means_.resize(n);
+  }
+  if (kind == BettingStrategyKind::AKELLY || horizon_dependent()) {
+    variances_.resize(n);
+  } else if (kind == BettingStrategyKind::LBOW) {
+    squared_deviations_.resize(n);
+  }
+  PredmixBets predmix(params);
+  double sum = 0, regularized_squares = 0, mean = 0, squared_deviations = 0;
+  for (size_t i = 0; i < n; i++) {
+    const double regularized_mean = i == 0
+        ? prior_mean : (fake_obs * prior_mean + sum) / (i + fake_obs);
+    const double variance = i == 0
+        ? prior_variance
+        : (fake_obs * prior_variance + regularized_squares) / (i + fake_obs);
+    if (kind == BettingStrategyKind::PREDMIX_EB) {
+      bets_[i] = predmix.bet();
+      predmix.add(x[i]);
+    } else {
+      sums_[i] = sum;
+    }
+    if (!means_.empty()) {
+      means_[i] = regularized_mean;
+    }
+    if (!variances_.empty()) {
+      variances_[i] = variance;
+    }
+    if (!squared_deviations_.empty()) {
+      squared_deviations_[i] = squared_deviations;
+    }
+    sum += x[i];
+    const double deviation = x[i] - (fake_obs * prior_mean + sum)
+        / (i + 1 + fake_obs);
+    regularized_squares += deviation * deviation;
+    const double delta = x[i] - mean;
+    mean += delta / (i + 1);
+    squared_deviations += delta * (x[i] - mean);
+  }
+}
+
+CONFSEQ_INLINE double BettingStrategy::bet(const size_t i, const double m,
+                                           const bool negative) const {
+  switch (params_.kind) {
+    case BettingStrategyKind::PREDMIX_EB:
+      return bets_[i];
+    case BettingStrategyKind::AKELLY: {
+      double mean = means_[i];
+      double mu = m;
+      if (N_ > 0) {
+        mean = (N_ * mean - sums_[i]) / (N_ - i);
+        mu = (N_ * m - sums_[i]) / (N_ - i);
+      }
+      const double gap = mean - mu;
+      const double bet = gap / (variances_[i] + gap * gap);
+      return nan_propagating_min(
+          params_.trunc_scale / mu,
+          nan_propagating_max(-params_.trunc_scale / (1 - mu), bet));
+    }
+    case BettingStrategyKind::LBOW: {
+      // The sum of (x[j] - m)^2 over j < i, from deviations about the mean.
+      double variance = params_.prior_variance;
+      if (i > 0) {
+        const double gap = sums_[i] / i - m;
+        variance = squared_deviations_[i] + i * gap * gap;
+      }
+      variance /= i + 1 + params_.fake_obs;
+      const double gap = means_[i] - m;
+      const double M = gap > 0 ? m : 1 - m;
+      return gap / (M * std::abs(gap) + variance + gap * gap);
+    }
+    case BettingStrategyKind::FIXED_FRACTION: {
+      const double mu = N_ > 0 ? (N_ * m - sums_[i]) / (N_ - i) : m;
+      return params_.fraction / (negative ? 1 - mu : mu);
+    }
+  }
+  return 0;
+}
+
+CONFSEQ_INLINE BettingStrategy BettingStrategy::at_horizon(const size_t horizon)
+    const {
+  BettingStrategy strategy = *this;
+  if (horizon_dependent()) {
+    strategy.params_.fixed_n = horizon;
+    strategy.bets_.resize(horizon);
+    const double log_inverse_alpha = log(1 / params_.alpha);
+    for (size_t i = 0; i < horizon; i++) {
+      strategy.bets_[i] = predmix_bet(params_, log_inverse_alpha, i + 1,
+                                      horizon, variances_[i]);
+    }
+  }
+  return strategy;
+}
+
+CONFSEQ_INLINE double log_add_exp(const double a, const double b) {
+  const double larger = std::max(a, b);
+  if (std::isinf(larger)) {
+    return larger;
+  }
+  return larger + log1p(exp(std::min(a, b) - larger));
+}
+
+// Fused over strategies: each strategy's bets are evaluated once per
+// observation for both processes, and held with the capital in contiguous
+// arrays that the truncation and capital updates sweep in order.
+CONFSEQ_INLINE DiversifiedBettingCapital::DiversifiedBettingCapital(
+    const double m, const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options)
+    : m_(m), strategies_positive_(&strategies_positive),
+      strategies_negative_(&strategies_negative), options_(options),
+      log_theta_(log(options.theta)),
+      log_one_minus_theta_(log(1 - options.theta)) {
+  assert(strategies_positive.size() == weights.size());
+  assert(strategies_negative.size() == weights.size());
+  for (size_t k = 0; k < weights.size(); k++) {
+    if (weights[k] != 0) {
+      strategies_.push_back(k);
+      weights_.push_back(options.log_space ? log(weights[k]) : weights[k]);
+    }
+  }
+  const size_t K = strategies_.size();
+  lambdas_positive_.resize(K);
+  lambdas_negative_.resize(K);
+  if (options.log_space) {
+    log_positive_.assign(K, SignedLogCapital{0, false});
+    log_negative_.assign(K, SignedLogCapital{0, false});
+  } else {
+    positive_.assign(K, 1);
+    negative_.assign(K, 1);
+  }
+}
+
+CONFSEQ_INLINE double DiversifiedBettingCapital::update(const size_t i,
+                                                        const double x,
+                                                        const double sum) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const bool log_space = options_.log_space;
+  const double theta = options_.theta;
+  const size_t K = strategies_.size();
+  const double mu = betting_conditional_mean(options_, m_, i, sum);
+  const double centered = x - mu;
+  // If mu < 0 or mu > 1, we cannot be under the null.
+  const bool outside = mu < 0 || mu > 1;
+  // A process without weight is neither bet on nor advanced: its bets are 0.
+  for (size_t j = 0; j < K; j++) {
+    lambdas_positive_[j] = theta == 0 ? 0
+        : (*strategies_positive_)[strategies_[j]].bet(i, m_, false);
+    lambdas_negative_[j] = theta == 1 ? 0
+        : (*strategies_negative_)[strategies_[j]].bet(i, m_, true);
+  }
+  for (size_t j = 0; j < K; j++) {
+    truncate_bets(options_, m_, mu, lambdas_positive_[j],
+                  lambdas_negative_[j]);
+  }
+  double mixed_positive = log_space ? -inf : 0;
+  double mixed_negative = log_space ? -inf : 0;
+  bool is_negative = false;
+  if (log_space) {
+    for (size_t j = 0; j < K; j++) {
+      log_positive_[j].multiply_by_one_plus(
+          bet_return(lambdas_positive_[j], centered));
+      log_negative_[j].multiply_by_one_plus(
+          -bet_return(lambdas_negative_[j], centered));
+      const SignedLogCapital summand_positive = log_positive_[j].patched();
+      const SignedLogCapital summand_negative = log_negative_[j].patched();
+      is_negative = is_negative
+          || (summand_positive.negative && summand_positive.log_abs > -inf)
+          || (summand_negative.negative && summand_negative.log_abs > -inf);
+      mixed_positive = log_add_exp(
+          mixed_positive,
+          weights_[j] + (outside ? inf : summand_positive.log_abs));
+      mixed_negative = log_add_exp(
+          mixed_negative,
+          weights_[j] + (outside ? inf : summand_negative.log_abs));
+    }
+  } else {
+    for (size_t j = 0; j < K; j++) {
+      positive_[j] *= 1 + bet_return(lambdas_positive_[j], centered);
+      negative_[j] *= 1 - bet_return(lambdas_negative_[j], centered);
+    }
+    for (size_t j = 0; j < K; j++) {
+      const double summand_positive =
+          std::isnan(positive_[j]) ? 0 : positive_[j];
+      const double summand_negative =
+          std::isnan(negative_[j]) ? 0 : negative_[j];
+      is_negative = is_negative || summand_positive < 0
+          || summand_negative < 0;
+      mixed_positive += weights_[j] * (outside ? inf : summand_positive);
+      mixed_negative += weights_[j] * (outside ? inf : summand_negative);
+    }
+  }
+  if (is_negative && !outside) {
+    throw std::invalid_argument("Betting capital process is negative");
+  }
+  if (theta == 1) {
+    return mixed_positive;
+  } else if (theta == 0) {
+    return mixed_negative;
+  } else if (log_space) {
+    const double log_positive_mixture = log_theta_ + mixed_positive;
+    const double log_negative_mixture = log_one_minus_theta_ + mixed_negative;
+    return options_.convex_comb
+        ? log_add_exp(log_positive_mixture, log_negative_mixture)
+        : std::max(log_positive_mixture, log_negative_mixture);
+  }
+  return options_.convex_comb
+      ? theta * mixed_positive + (1 - theta) * mixed_negative
+      : std::max(theta * mixed_positive, (1 - theta) * mixed_negative);
+}
+
+CONFSEQ_INLINE void diversified_betting_capital_process(
+    const double* x, const size_t n, const double m,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    double* capital) {
+  DiversifiedBettingCapital process(m, strategies_positive,
+                                    strategies_negative, weights, options);
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    capital[i] = process.update(i, x[i], sum);
+    sum += x[i];
+  }
+}
+
+CONFSEQ_INLINE void diversified_betting_grid_accepted_range(
+    const double* x, const size_t n, const double* grid,
+    const size_t grid_size,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, int* first_accepted, int* last_accepted,
+    const int num_threads) {
+  diversified_betting_grid_accepted_range(
+      x, n, grid, grid_size, strategies_positive, strategies_negative,
+      weights, options, &threshold, 1, first_accepted, last_accepted,
+      num_threads);
+}
+
+CONFSEQ_INLINE void diversified_betting_grid_accepted_range(
+    const double* x, const size_t n, const double* grid,
+    const size_t grid_size,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double* thresholds, const size_t num_thresholds,
+    int* first_accepted, int* last_accepted, const int num_threads) {
+  std::vector<double> limits(thresholds, thresholds + num_thresholds);
+  if (options.log_space) {
+    for (double& limit : limits) {
+      limit = log(limit);
+    }
+  }
+  ScratchVector<DiversifiedBettingCapital> capital;
+  capital.reserve(grid_size);
+  for (size_t j = 0; j < grid_size; j++) {
+    capital.emplace_back(grid[j], strategies_positive, strategies_negative,
+                         weights, options);
+  }
+  tiled_grid_accepted_range(
+      x, n, grid_size, limits.data(), num_thresholds,
+      [&](const size_t j, const size_t i, const double sum) {
+        return capital[j].update(i, x[i], sum);
+      },
+      first_accepted, last_accepted, num_threads);
+}
+
+// The positive bets of hedged_cs, lambda_predmix_eb with the CS's alpha and
+// regularization.
+CONFSEQ_INLINE BettingStrategyParams hedged_positive_bets(
+    const double alpha, const double prior_mean, const double prior_variance,
+    const double fake_obs) {
+  BettingStrategyParams params;
+  params.alpha = alpha;
+  params.prior_mean = prior_mean;
+  params.prior_variance = prior_variance;
+  params.fake_obs = fake_obs;
+  return params;
+}
+
+// The negative bets are lambda_predmix_eb with its defaults, capped at each
+// grid mean through cap_negative_bets_at_m, as in hedged_cs.
+CONFSEQ_INLINE HedgedConfidenceSequence::HedgedConfidenceSequence(
+    const double alpha, const double N, const int breaks,
+    const bool running_intersection, const double theta,
+    const double trunc_scale, const double prior_mean,
+    const double prior_variance, const double fake_obs,
+    const double max_weight)
+    : N_(N), breaks_(breaks), running_intersection_(running_intersection),
+      log_threshold_(log(1 / alpha)),
+      positive_bets_(hedged_positive_bets(alpha, prior_mean, prior_variance,
+                                          fake_obs)),
+      negative_bets_(BettingStrategyParams()) {
+  assert(0 < alpha && alpha < 1);
+  assert(breaks > 0);
+  assert(0 < trunc_scale && trunc_scale <= 1);
+  assert(max_weight >= 1 && (N == 0 || max_weight == 1));
+  options_.N = N;
+  options_.theta = theta;
+  options_.trunc_scale = trunc_scale;
+  options_.cap_negative_bets_at_m = true;
+  options_.max_weight = max_weight;
+  options_.log_space = true;
+  betting_grid(breaks, grid_);
+  capital_.reserve(grid_.size());
+  for (const double m : grid_) {
+    capital_.emplace_back(m, options_);
+  }
+}
+
+CONFSEQ_INLINE void HedgedConfidenceSequence::check_observations(
+    const double* x, const size_t n) const {
+  for (size_t i = 0; i < n; i++) {
+    if (!(0 <= x[i] && x[i] <= options_.max_weight)) {
+      throw std::invalid_argument(
+          options_.max_weight == 1
+              ? "Observations must lie in [0, 1]"
+              : "Observations must lie in [0, max_weight]");
+    }
+  }
+  if (N_ > 0 && t_ + n > N_) {
+    throw std::invalid_argument(
+        "More observations than the population size");
+  }
+}
+
+CONFSEQ_INLINE void HedgedConfidenceSequence::record_interval(
+    const int first_accepted, const int last_accepted, const size_t t,
+    const double sum) {
+  const std::pair<double, double> interval = grid_cs_interval(
+      grid_.data(), breaks_, first_accepted, last_accepted, N_, t, sum);
+  if (running_intersection_) {
+    lower_ = std::max(lower_, interval.first);
+    upper_ = std::min(upper_, interval.second);
+  } else {
+    lower_ = interval.first;
+    upper_ = interval.second;
+  }
+}
+
+CONFSEQ_INLINE void HedgedConfidenceSequence::sweep(const double* x,
+                                                    const size_t n,
+                                                    double* lower,
+                                                    double* upper) {
+  for (size_t i = 0; i < n; i++) {
+    const double lambda_positive = positive_bets_.bet();
+    const double lambda_negative = negative_bets_.bet();
+    int first = -1, last = -1;
+    for (size_t j = 0; j < capital_.size(); j++) {
+      if (capital_[j].update(t_, x[i], sum_, lambda_positive,
+                             lambda_negative) <= log_threshold_) {
+        if (first < 0) {
+          first = int(j);
+        }
+        last = int(j);
+      }
+    }
+    positive_bets_.add(x[i]);
+    negative_bets_.add(x[i]);
+    sum_ += x[i];
+    record_interval(first, last, t_, sum_);
+    t_++;
+    if (lower) {
+      lower[i] = lower_;
+      upper[i] = upper_;
+    }
+  }
+}
+
+CONFSEQ_INLINE std::pair<double, double> HedgedConfidenceSequence::update(
+    const double* x, const size_t n, double* lower, double* upper) {
+  check_observations(x, n);
+  sweep(x, n, lower, upper);
+  return interval();
+}
+
+CONFSEQ_INLINE std::pair<double, double> HedgedConfidenceSequence::update(
+    const double* x, const size_t n) {
+  check_observations(x, n);
+  // Threads pay off only for batches with enough work per grid mean.
+  if (n * grid_.size() < (size_t(1) << 20)) {
+    sweep(x, n, nullptr, nullptr);
+    return interval();
+  }
+  // Bets and sums do not depend on the mean, so they are computed once for
+  // the batch, and the grid means are split across threads.
+  ScratchScope scratch;
+  double* lambdas_positive = scratch.allocate<double>(n);
+  double* lambdas_negative = scratch.allocate<double>(n);
+  double* sums = scratch.allocate<double>(n);
+  for (size_t i = 0; i < n; i++) {
+    lambdas_positive[i] = positive_bets_.bet();
+    lambdas_negative[i] = negative_bets_.bet();
+    sums[i] = sum_;
+    positive_bets_.add(x[i]);
+    negative_bets_.add(x[i]);
+    sum_ += x[i];
+  }
+  const size_t start = t_;
+  int* first = scratch.allocate<int>(n);
+  int* last = scratch.allocate<int>(n);
+  grid_accepted_range(
+      grid_.size(), n, log_threshold_,
+      [&](const size_t j, double* capital) {
+        for (size_t i = 0; i < n; i++) {
+          capital[i] = capital_[j].update(start + i, x[i], sums[i],
+                                          lambdas_positive[i],
+                                          lambdas_negative[i]);
+        }
+      },
+      first, last);
+  for (size_t i = 0; i < n; i++) {
+    record_interval(first[i], last[i], start + i, sums[i] + x[i]);
+  }
+  t_ += n;
+  return interval();
+}
+
+CONFSEQ_INLINE std::vector<double> betting_grid(const int breaks) {
+  ScratchVector<double> grid;
+  betting_grid(breaks, grid);
+  return std::vector<double>(grid.begin(), grid.end());
+}
+
+CONFSEQ_INLINE void betting_grid(const int breaks,
+                                 ScratchVector<double>& grid) {
+  const double step = 1.0 / breaks;
+  grid.resize(size_t(ceil((1 + step) / step)));
+  for (size_t i = 0; i < grid.size(); i++) {
+    grid[i] = i * step;
+  }
+}
+
+CONFSEQ_INLINE std::pair<double, double> grid_cs_interval(
+    const double* grid, const int breaks,
+    const int first_accepted, const int last_accepted, const double N,
+    const size_t t, const double sum) {
+  double lower = std::max(
+      0.0, (first_accepted >= 0 ? grid[first_accepted] : 0) - 1.0 / breaks);
+  double upper = std::min(
+      1.0, (last_accepted >= 0 ? grid[last_accepted] : 1) + 1.0 / breaks);
+  if (N > 0) {
+    lower = std::max(lower, sum / N);
+    upper = std::min(upper, 1 - (double(t + 1) - sum) / N);
+  }
+  return {lower, upper};
+}
+
+CONFSEQ_INLINE std::pair<double, double> first_rejection_interval(
+    const double* grid, const size_t grid_size, const int breaks,
+    const size_t* times, const size_t t) {
+  // Mean j is in the CS after s observations while times[j] is 0 or above
+  // s. Once every mean is out, the CS keeps its interval from the last time
+  // any was in.
+  size_t last_in = 0;
+  for (size_t j = 0; j < grid_size; j++) {
+    last_in = std::max(last_in, times[j] == 0 ? t : times[j] - 1);
+  }
+  const size_t s = std::min(t, last_in);
+  int first_accepted = -1;
+  int last_accepted = -1;
+  for (size_t j = 0; j < grid_size; j++) {
+    if (times[j] == 0 || times[j] > s) {
+      if (first_accepted < 0) {
+        first_accepted = int(j);
+      }
+      last_accepted = int(j);
+    }
+  }
+  return grid_cs_interval(grid, breaks, first_accepted, last_accepted, 0,
+                          s, 0);
+}
+
+CONFSEQ_INLINE void accepted_range_cs(
+    const double* x, const size_t n, const double* grid,
+    const int breaks, const int* first_accepted, const int* last_accepted,
+    const double N, const bool running_intersection, double* lower,
+    double* upper) {
+  double sum = 0;
+  for (size_t t = 0; t < n; t++) {
+    sum += x[t];
+    const std::pair<double, double> interval = grid_cs_interval(
+        grid, breaks, first_accepted[t], last_accepted[t], N, t, sum);
+    lower[t] = interval.first;
+    upper[t] = interval.second;
+    if (running_intersection && t > 0) {
+      lower[t] = std::max(lower[t - 1], lower[t]);
+      upper[t] = std::min(upper[t - 1], upper[t]);
+    }
+  }
+}
+
+CONFSEQ_INLINE void intersect_cs(
+    const double* x, const size_t n, const double N,
+    const bool running_intersection, double* lower, double* upper) {
+  double sum = 0;
+  for (size_t t = 0; t < n; t++) {
+    sum += x[t];
+    if (N > 0) {
+      lower[t] = std::max(lower[t], sum / N);
+      upper[t] = std::min(upper[t], 1 - (double(t + 1) - sum) / N);
+    }
+    if (running_intersection && t > 0) {
+      lower[t] = std::max(lower[t - 1], lower[t]);
+      upper[t] = std::min(upper[t - 1], upper[t]);
+    }
+  }
+}
+
+CONFSEQ_INLINE void betting_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const double* lambdas_positive, const double* lambdas_negative,
+    const BettingOptions& options, const double threshold,
+    const bool running_intersection, double* lower, double* upper,
+    const int num_threads) {
+  ScratchVector<double> grid;
+  betting_grid(breaks, grid);
+  ScratchScope scratch;
+  int* first = scratch.allocate<int>(n);
+  int* last = scratch.allocate<int>(n);
+  betting_grid_accepted_range(x, n, grid.data(), grid.size(),
+                              lambdas_positive, lambdas_negative, options,
+                              threshold, first, last, num_threads);
+  accepted_range_cs(x, n, grid.data(), breaks, first, last, options.N,
+                    running_intersection, lower, upper);
+}
+
+CONFSEQ_INLINE void diversified_betting_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, const bool running_intersection, double* lower,
+    double* upper, const int num_threads) {
+  diversified_betting_grid_cs(x, n, breaks, strategies_positive,
+                              strategies_negative, weights, options,
+                              &threshold, 1, running_intersection, lower,
+                              upper, num_threads);
+}
+
+CONFSEQ_INLINE void diversified_betting_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double* thresholds, const size_t num_thresholds,
+    const bool running_intersection, double* lower, double* upper,
+    const int num_threads) {
+  ScratchVector<double> grid;
+  betting_grid(breaks, grid);
+  ScratchScope scratch;
+  int* first = scratch.allocate<int>(num_thresholds * n);
+  int* last = scratch.allocate<int>(num_thresholds * n);
+  diversified_betting_grid_accepted_range(
+      x, n, grid.data(), grid.size(), strategies_positive,
+      strategies_negative, weights, options, thresholds, num_thresholds,
+      first, last, num_threads);
+  for (size_t k = 0; k < num_thresholds; k++) {
+    accepted_range_cs(x, n, grid.data(), breaks, first + k * n, last + k * n,
+                      options.N, running_intersection, lower + k * n,
+                      upper + k * n);
+  }
+}
+
+CONFSEQ_INLINE void betting_pruned_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const double* lambdas_positive, const double* lambdas_negative,
+    const BettingOptions& options, const double threshold, double* lower,
+    double* upper, const int num_threads) {
+  assert(0 < options.trunc_scale && options.trunc_scale <= 1);
+  ScratchVector<double> grid;
+  betting_grid(breaks, grid);
+  ScratchVector<BettingCapital> capital;
+  capital.reserve(grid.size());
+  for (const double m : grid) {
+    capital.emplace_back(m, options);
+  }
+  pruned_grid_cs(
+      x, n, grid.data(), grid.size(), breaks,
+      options.log_space ? log(threshold) : threshold, options.N,
+      [&](const size_t j, const size_t i, const double sum) {
+        return capital[j].update(i, x[i], sum, lambdas_positive[i],
+                                 lambdas_negative[i]);
+      },
+      lower, upper, num_threads);
+}
+
+CONFSEQ_INLINE void diversified_betting_pruned_grid_cs(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, double* lower, double* upper,
+    const int num_threads) {
+  ScratchVector<double> grid;
+  betting_grid(breaks, grid);
+  ScratchVector<DiversifiedBettingCapital> capital;
+  capital.reserve(grid.size());
+  for (const double m : grid) {
+    capital.emplace_back(m, strategies_positive, strategies_negative, weights,
+                         options);
+  }
+  pruned_grid_cs(
+      x, n, grid.data(), grid.size(), breaks,
+      options.log_space ? log(threshold) : threshold, options.N,
+      [&](const size_t j, const size_t i, const double sum) {
+        return capital[j].update(i, x[i], sum);
+      },
+      lower, upper, num_threads);
+}
+
+CONFSEQ_INLINE void diversified_betting_first_rejections(
+    const double* x, const size_t n, const double* nulls,
+    const size_t num_nulls,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, size_t* times, const int num_threads) {
+  const TraceScope trace(TracedFunction::BETTING_FIRST_REJECTIONS, n);
+  ScratchVector<DiversifiedBettingCapital> capital;
+  capital.reserve(num_nulls);
+  for (size_t j = 0; j < num_nulls; j++) {
+    capital.emplace_back(nulls[j], strategies_positive, strategies_negative,
+                         weights, options);
+  }
+  grid_first_rejections(
+      x, n, num_nulls, options.log_space ? log(threshold) : threshold,
+      [&](const size_t j, const size_t i, const double sum) {
+        return capital[j].update(i, x[i], sum);
+      },
+      times, num_threads);
+}
+
+CONFSEQ_INLINE std::pair<double, double> diversified_betting_ci(
+    const double* x, const size_t n, const int breaks,
+    const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, const bool running_intersection,
+    int num_threads) {
+  assert(n > 0);
+  const size_t block_size = 4096;
+  const double limit = options.log_space ? log(threshold) : threshold;
+  ScratchVector<double> grid;
+  betting_grid(breaks, grid);
+  ScratchVector<DiversifiedBettingCapital> capital;
+  capital.reserve(grid.size());
+  for (const double m : grid) {
+    capital.emplace_back(m, strategies_positive, strategies_negative, weights,
+                         options);
+  }
+  if (num_threads <= 0) {
+    num_threads = get_num_threads();
+  }
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(num_threads, grid.size()));
+  ScratchScope scratch;
+  int* chunk_first = scratch.allocate<int>(num_chunks * block_size);
+  int* chunk_last = scratch.allocate<int>(num_chunks * block_size);
+  double* sums = scratch.allocate<double>(block_size);
+  double sum = 0;
+  std::pair<double, double> interval(0, 1);
+  for (size_t start = 0; start < n; start += block_size) {
+    const size_t size = std::min(block_size, n - start);
+    for (size_t i = 0; i < size; i++) {
+      sums[i] = sum;
+      sum += x[start + i];
+    }
+    // Without running intersection, only the last time's endpoints matter.
+    auto recorded = [&](const size_t i) {
+      return running_intersection || start + i + 1 == n;
+    };
+    parallel_for(num_chunks, [&](const size_t chunk) {
+      int* first = chunk_first + chunk * block_size;
+      int* last = chunk_last + chunk * block_size;
+      std::fill_n(first, size, -1);
+      std::fill_n(last, size, -1);
+      const size_t end = grid.size() * (chunk + 1) / num_chunks;
+      for (size_t j = grid.size() * chunk / num_chunks; j < end; j++) {
+        for (size_t i = 0; i < size; i++) {
+          const double value = capital[j].update(start + i, x[start + i],
+                                                 sums[i]);
+          if (value <= limit && recorded(i)) {
+            if (first[i] < 0) {
+              first[i] = j;
+            }
+            last[i] = j;
+          }
+        }
+      }
+    }, num_chunks, 1);
+    for (size_t i = 0; i < size; i++) {
+      if (!recorded(i)) {
+        continue;
+      }
+      int first = -1, last = -1;
+      for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+        if (first < 0) {
+          first = chunk_first[chunk * block_size + i];
+        }
+        last = std::max(last, chunk_last[chunk * block_size + i]);
+      }
+      const std::pair<double, double> current = grid_cs_interval(
+          grid.data(), breaks, first, last, options.N, start + i,
+          sums[i] + x[start + i]);
+      if (running_intersection) {
+        interval.first = std::max(interval.first, current.first);
+        interval.second = std::min(interval.second, current.second);
+      } else {
+        interval = current;
+      }
+    }
+  }
+  return interval;
+}
+
+CONFSEQ_INLINE void diversified_betting_ci_sequence(
+    const double* x, const size_t* times, const size_t num_times,
+    const int breaks, const std::vector<BettingStrategy>& strategies_positive,
+    const std::vector<BettingStrategy>& strategies_negative,
+    const std::vector<double>& weights, const BettingOptions& options,
+    const double threshold, const bool running_intersection, double* lower,
+    double* upper, const int num_threads) {
+  if (num_times == 0) {
+    return;
+  }
+  const size_t n = *std::max_element(times, times + num_times);
+  bool horizon_dependent = false;
+  for (size_t k = 0; k < weights.size(); k++) {
+    horizon_dependent = horizon_dependent
+        || strategies_positive[k].horizon_dependent()
+        || strategies_negative[k].horizon_dependent();
+  }
+  if (!horizon_dependent && num_times > 1) {
+    ScratchScope scratch;
+    double* cs_lower = scratch.allocate<double>(n);
+    double* cs_upper = scratch.allocate<double>(n);
+    diversified_betting_grid_cs(x, n, breaks, strategies_positive,
+                                strategies_negative, weights, options,
+                                threshold, running_intersection, cs_lower,
+                                cs_upper, num_threads);
+    for (size_t h = 0; h < num_times; h++) {
+      assert(times[h] > 0);
+      lower[h] = cs_lower[times[h] - 1];
+      upper[h] = cs_upper[times[h] - 1];
+    }
+    return;
+  }
+  // A single horizon (the fixed-horizon betting_ci) threads over the grid
+  // and keeps only the current capital; several horizons thread over those.
+  const int ci_threads = num_times == 1 ? num_threads : 1;
+  parallel_for(num_times, [&](const size_t h) {
+    std::vector<BettingStrategy> positive, negative;
+    for (size_t k = 0; k < weights.size(); k++) {
+      positive.push_back(strategies_positive[k].at_horizon(times[h]));
+      negative.push_back(strategies_negative[k].at_horizon(times[h]));
+    }
+    const std::pair<double, double> interval = diversified_betting_ci(
+        x, times[h], breaks, positive, negative, weights, options, threshold,
+        running_intersection, ci_threads);
+    lower[h] = interval.first;
+    upper[h] = interval.second;
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE BettingStrategyParams predmix_empbern_bets(
+    const double alpha, const double truncation, const double fixed_n,
+    const CSSide side) {
+  BettingStrategyParams params;
+  params.alpha = cs_side_alpha(side, alpha);
+  params.truncation = truncation;
+  params.fixed_n = fixed_n;
+  return params;
+}
+
+CONFSEQ_INLINE PredmixEmpBernAccumulator::PredmixEmpBernAccumulator(
+    const double alpha, const double truncation,
+    const bool running_intersection, const double fixed_n,
+    const CSSide side)
+    : running_intersection_(running_intersection), side_(side),
+      log_threshold_(log(1 / cs_side_alpha(side, alpha))),
+      bets_(predmix_empbern_bets(alpha, truncation, fixed_n, side)) {}
+
+CONFSEQ_INLINE std::pair<double, double> PredmixEmpBernAccumulator::update(
+    const double* x, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const double mean = t_ == 0 ? 0 : sum_ / t_;
+    const double lambda = bets_.bet();
+    bets_.add(x[i]);
+    psi_sum_ += (x[i] - mean) * (x[i] - mean) * (-log1p(-lambda) - lambda);
+    lambda_sum_ += lambda;
+    weighted_sum_ += x[i] * lambda;
+    sum_ += x[i];
+    const double margin = (log_threshold_ + psi_sum_) / lambda_sum_;
+    const double weighted_mean = weighted_sum_ / lambda_sum_;
+    double lower = nan_propagating_max(weighted_mean - margin, 0);
+    double upper = nan_propagating_min(weighted_mean + margin, 1);
+    clear_unreported_bound(side_, lower, upper);
+    if (running_intersection_ && t_ > 0) {
+      lower_ = nan_propagating_max(lower_, lower);
+      upper_ = nan_propagating_min(upper_, upper);
+    } else {
+      lower_ = lower;
+      upper_ = upper;
+    }
+    t_++;
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE PredmixHoeffdingAccumulator::PredmixHoeffdingAccumulator(
+    const double alpha, const bool running_intersection)
+    : running_intersection_(running_intersection),
+      log_threshold_(log(2 / alpha)) {}
+
+CONFSEQ_INLINE std::pair<double, double> PredmixHoeffdingAccumulator::update(
+    const double* x, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const double t = t_ + 1;
+    const double lambda = std::min(
+        1.0, sqrt(8 * log_threshold_ / (t * log(t + 1))));
+    psi_sum_ += lambda * lambda;
+    lambda_sum_ += lambda;
+    weighted_sum_ += x[i] * lambda;
+    const double margin = (psi_sum_ / 8 + log_threshold_) / lambda_sum_;
+    double weighted_mean = weighted_sum_ / lambda_sum_;
+    if (std::isnan(weighted_mean)) {
+      weighted_mean = 0.5;
+    }
+    const double lower = nan_propagating_max(weighted_mean - margin, 0);
+    const double upper = nan_propagating_min(weighted_mean + margin, 1);
+    if (running_intersection_ && t_ > 0) {
+      lower_ = nan_propagating_max(lower_, lower);
+      upper_ = nan_propagating_min(upper_, upper);
+    } else {
+      lower_ = lower;
+      upper_ = upper;
+    }
+    t_++;
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE void predmix_empbern_cs(
+    const double* x, const size_t n, const double alpha,
+    const double truncation, const double fixed_n,
+    const bool running_intersection, double* lower, double* upper,
+    const CSSide side) {
+  const TraceScope trace(TracedFunction::PREDMIX_EMPBERN_CS, n);
+  PredmixEmpBernAccumulator cs(alpha, truncation, running_intersection,
+                               fixed_n, side);
+  for (size_t t = 0; t < n; t++) {
+    std::tie(lower[t], upper[t]) = cs.update(x + t, 1);
+  }
+}
+
+CONFSEQ_INLINE void predmix_hoeffding_cs(const double* x, const size_t n,
+                                         const double alpha,
+                                         const bool running_intersection,
+                                         double* lower, double* upper) {
+  const TraceScope trace(TracedFunction::PREDMIX_HOEFFDING_CS, n);
+  PredmixHoeffdingAccumulator cs(alpha, running_intersection);
+  for (size_t t = 0; t < n; t++) {
+    std::tie(lower[t], upper[t]) = cs.update(x + t, 1);
+  }
+}
+
+CONFSEQ_INLINE PredmixEmpBernWoRAccumulator::PredmixEmpBernWoRAccumulator(
+    const double N, const double alpha, const double lower_bd,
+    const double upper_bd, const bool running_intersection)
+    : N_(N), lower_bd_(lower_bd), upper_bd_(upper_bd),
+      running_intersection_(running_intersection),
+      log_threshold_(log(2 / alpha)), lower_(lower_bd), upper_(upper_bd) {}
+
+CONFSEQ_INLINE std::pair<double, double> PredmixEmpBernWoRAccumulator::update(
+    const double* x, const size_t n, const double* lambdas) {
+  if (t_ + n > N_) {
+    throw std::invalid_argument(
+        "More observations than the population size");
+  }
+  const double c = upper_bd_ - lower_bd_;
+  const double scale = pow(c / 2, -2);
+  for (size_t i = 0; i < n; i++) {
+    const double t = t_ + 1;
+    const double previous_mean = (0.5 + sum_) / t;
+    const double z = sum_ / (N_ - t + 1);
+    const double w = (t - 1) / (N_ - t + 1);
+    double lambda;
+    if (lambdas != nullptr) {
+      lambda = lambdas[i];
+    } else {
+      const double previous_variance = t_ == 0 ? scale : variance_ * scale;
+      lambda = sqrt(8 * log_threshold_
+                    / (previous_variance * log(1 + t) * (c * c)));
+      if (std::isnan(lambda) || std::isinf(lambda)) {
+        lambda = 0;
+      }
+      lambda = std::min(1 / (2 * c), lambda);
+    }
+    const double squared = (x[i] - previous_mean) * (x[i] - previous_mean);
+    variance_ += 0.25 + squared;
+    psi_sum_ += scale * squared
+        * ((-log(1 - c * lambda) - c * lambda) / 4);
+    lambda_sum_ += lambda * (1 + w);
+    weighted_sum_ += lambda * (x[i] + z);
+    sum_ += x[i];
+    const double weighted_mean = weighted_sum_ / lambda_sum_;
+    const double margin = (psi_sum_ + log_threshold_) / lambda_sum_;
+    const double lower = nan_propagating_max(weighted_mean - margin,
+                                             lower_bd_);
+    const double upper = nan_propagating_min(weighted_mean + margin,
+                                             upper_bd_);
+    if (running_intersection_ && t_ > 0) {
+      lower_ = nan_propagating_max(lower_, lower);
+      upper_ = nan_propagating_min(upper_, upper);
+    } else {
+      lower_ = lower;
+      upper_ = upper;
+    }
+    t_++;
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE PredmixHoeffdingWoRAccumulator::PredmixHoeffdingWoRAccumulator(
+    const double N, const double alpha, const double lower_bd,
+    const double upper_bd, const bool running_intersection)
+    : N_(N), lower_bd_(lower_bd), upper_bd_(upper_bd),
+      running_intersection_(running_intersection),
+      log_threshold_(log(2 / alpha)), lower_(lower_bd), upper_(upper_bd) {}
+
+CONFSEQ_INLINE std::pair<double, double> PredmixHoeffdingWoRAccumulator::update(
+    const double* x, const size_t n, const double* lambdas) {
+  if (t_ + n > N_) {
+    throw std::invalid_argument(
+        "More observations than the population size");
+  }
+  const double c = upper_bd_ - lower_bd_;
+  for (size_t i = 0; i < n; i++) {
+    const double t = t_ + 1;
+    const double z = sum_ / (N_ - t + 1);
+    const double w = (t - 1) / (N_ - t + 1);
+    double lambda;
+    if (lambdas != nullptr) {
+      lambda = lambdas[i];
+    } else {
+      lambda = sqrt(8 * log_threshold_ / (t * log(1 + t) * (c * c)));
+      if (std::isnan(lambda) || std::isinf(lambda)) {
+        lambda = 0;
+      }
+      lambda = std::min(1 / sqrt(c * c), lambda);
+    }
+    psi_sum_ += lambda * lambda;
+    lambda_sum_ += lambda * (1 + w);
+    weighted_sum_ += lambda * (x[i] + z);
+    sum_ += x[i];
+    const double weighted_mean = weighted_sum_ / lambda_sum_;
+    const double margin = (psi_sum_ * (c * c) / 8 + log_threshold_)
+        / lambda_sum_;
+    const double lower = nan_propagating_max(weighted_mean - margin,
+                                             lower_bd_);
+    const double upper = nan_propagating_min(weighted_mean + margin,
+                                             upper_bd_);
+    if (running_intersection_ && t_ > 0) {
+      lower_ = nan_propagating_max(lower_, lower);
+      upper_ = nan_propagating_min(upper_, upper);
+    } else {
+      lower_ = lower;
+      upper_ = upper;
+    }
+    t_++;
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE void predmix_empbern_cs_wor(const double* x, const size_t n,
+                                           const double N, const double alpha,
+                                           const double lower_bd,
+                                           const double upper_bd,
+                                           const bool running_intersection,
+                                           double* lower, double* upper,
+                                           const double* lambdas) {
+  const TraceScope trace(TracedFunction::PREDMIX_EMPBERN_CS_WOR, n);
+  PredmixEmpBernWoRAccumulator cs(N, alpha, lower_bd, upper_bd,
+                                  running_intersection);
+  for (size_t t = 0; t < n; t++) {
+    std::tie(lower[t], upper[t]) = cs.update(
+        x + t, 1, lambdas == nullptr ? nullptr : lambdas + t);
+  }
+}
+
+CONFSEQ_INLINE void predmix_hoeffding_cs_wor(const double* x, const size_t n,
+                                             const double N, const double alpha,
+                                             const double lower_bd,
+                                             const double upper_bd,
+                                             const bool running_intersection,
+                                             double* lower, double* upper,
+                                             const double* lambdas) {
+  const TraceScope trace(TracedFunction::PREDMIX_HOEFFDING_CS_WOR, n);
+  PredmixHoeffdingWoRAccumulator cs(N, alpha, lower_bd, upper_bd,
+                                    running_intersection);
+  for (size_t t = 0; t < n; t++) {
+    std::tie(lower[t], upper[t]) = cs.update(
+        x + t, 1, lambdas == nullptr ? nullptr : lambdas + t);
+  }
+}
+
+CONFSEQ_INLINE ConjmixHoeffdingAccumulator::ConjmixHoeffdingAccumulator(
+    const double t_opt, const double alpha, const bool running_intersection)
+    : t_opt_(t_opt), alpha_(alpha), running_intersection_(running_intersection),
+      log_threshold_(log(1 / alpha)), mixture_(t_opt / 4, alpha) {}
+
+CONFSEQ_INLINE std::pair<double, double> ConjmixHoeffdingAccumulator::update(
+    const double* x, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    sum_ += x[i];
+    t_++;
+    const double bound = boundary(t_);
+    const double lower = nan_propagating_max(sum_ / t_ - bound, 0);
+    const double upper = nan_propagating_min(sum_ / t_ + bound, 1);
+    if (running_intersection_ && t_ > 1) {
+      lower_ = nan_propagating_max(lower_, lower);
+      upper_ = nan_propagating_min(upper_, upper);
+    } else {
+      lower_ = lower;
+      upper_ = upper;
+    }
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE void conjmix_hoeffding_cs(const double* x, const size_t n,
+                                         const double t_opt, const double alpha,
+                                         const bool running_intersection,
+                                         double* lower, double* upper) {
+  const TraceScope trace(TracedFunction::CONJMIX_HOEFFDING_CS, n);
+  const ConjmixHoeffdingAccumulator cs(t_opt, alpha, running_intersection);
+  for (size_t t = 0; t < n; t++) {
+    upper[t] = cs.boundary(t + 1);
+  }
+  double sum = 0;
+  for (size_t t = 0; t < n; t++) {
+    sum += x[t];
+    const double mean = sum / (t + 1);
+    lower[t] = nan_propagating_max(mean - upper[t], 0);
+    upper[t] = nan_propagating_min(mean + upper[t], 1);
+    if (running_intersection && t > 0) {
+      lower[t] = nan_propagating_max(lower[t - 1], lower[t]);
+      upper[t] = nan_propagating_min(upper[t - 1], upper[t]);
+    }
+  }
+}
+
+CONFSEQ_INLINE ConjmixEmpBernAccumulator::ConjmixEmpBernAccumulator(
+    const double v_opt, const double alpha, const bool running_intersection,
+    const CSSide side)
+    : v_opt_(v_opt), alpha_(alpha), running_intersection_(running_intersection),
+      side_(side), log_threshold_(log(1 / cs_side_alpha(side, alpha))),
+      mixture_(v_opt, cs_side_alpha(side, alpha), 1) {}
+
+CONFSEQ_INLINE std::pair<double, double> ConjmixEmpBernAccumulator::update(
+    const double* x, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const double mean = t_ == 0 ? 0.5 : sum_ / t_;
+    const double variance = variance_ + (x[i] - mean) * (x[i] - mean);
+    bound_ = t_ == 0 ? mixture_.bound(variance, log_threshold_)
+        : find_next_mixture_bound(mixture_, variance_, bound_, variance,
+                                  log_threshold_);
+    variance_ = variance;
+    sum_ += x[i];
+    t_++;
+    const double boundary = bound_ / t_;
+    double lower = nan_propagating_max(sum_ / t_ - boundary, 0);
+    double upper = nan_propagating_min(sum_ / t_ + boundary, 1);
+    clear_unreported_bound(side_, lower, upper);
+    if (running_intersection_ && t_ > 1) {
+      lower_ = nan_propagating_max(lower_, lower);
+      upper_ = nan_propagating_min(upper_, upper);
+    } else {
+      lower_ = lower;
+      upper_ = upper;
+    }
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE void conjmix_empbern_cs(
+    const double* x, const size_t n, const double v_opt, const double alpha,
+    const bool running_intersection, double* lower, double* upper,
+    const CSSide side) {
+  const TraceScope trace(TracedFunction::CONJMIX_EMPBERN_CS, n);
+  ConjmixEmpBernAccumulator cs(v_opt, alpha, running_intersection, side);
+  for (size_t t = 0; t < n; t++) {
+    std::tie(lower[t], upper[t]) = cs.update(x + t, 1);
+  }
+}
+
+CONFSEQ_INLINE void hedged_cs(
+    const double* x, const size_t n, const double alpha, const double N,
+    const int breaks, const bool running_intersection, const double theta,
+    const double trunc_scale, double* lower, double* upper,
+    const CSSide side) {
+  const TraceScope trace(TracedFunction::HEDGED_CS, n);
+  HedgedConfidenceSequence cs(alpha, N, breaks, running_intersection,
+                              cs_side_theta(side, theta), trunc_scale);
+  cs.update(x, n, lower, upper);
+}
+
+CONFSEQ_INLINE CSSide cs_side(const std::string& name) {
+  if (name == "both") {
+    return CSSide::BOTH;
+  } else if (name == "lower") {
+    return CSSide::LOWER;
+  } else if (name == "upper") {
+    return CSSide::UPPER;
+  }
+  throw std::invalid_argument("side must be 'both', 'lower' or 'upper'");
+}
+
+CONFSEQ_INLINE double cs_side_alpha(const CSSide side, const double alpha) {
+  return side == CSSide::BOTH ? alpha / 2 : alpha;
+}
+
+CONFSEQ_INLINE double cs_side_theta(const CSSide side, const double theta) {
+  return side == CSSide::LOWER ? 1 : side == CSSide::UPPER ? 0 : theta;
+}
+
+CONFSEQ_INLINE void clear_unreported_bound(const CSSide side, double& lower,
+                                           double& upper) {
+  if (side == CSSide::LOWER) {
+    upper = 1;
+  } else if (side == CSSide::UPPER) {
+    lower = 0;
+  }
+}
+
+CONFSEQ_INLINE StreamCSKind stream_cs_kind(const std::string& name) {
+  if (name == "predmix_empbern") {
+    return StreamCSKind::PREDMIX_EMPBERN;
+  } else if (name == "predmix_hoeffding") {
+    return StreamCSKind::PREDMIX_HOEFFDING;
+  } else if (name == "predmix_empbern_wor") {
+    return StreamCSKind::PREDMIX_EMPBERN_WOR;
+  } else if (name == "predmix_hoeffding_wor") {
+    return StreamCSKind::PREDMIX_HOEFFDING_WOR;
+  } else if (name == "conjmix_hoeffding") {
+    return StreamCSKind::CONJMIX_HOEFFDING;
+  } else if (name == "conjmix_empbern") {
+    return StreamCSKind::CONJMIX_EMPBERN;
+  } else if (name == "hedged") {
+    return StreamCSKind::HEDGED;
+  }
+  throw std::invalid_argument("Unknown confidence sequence: " + name);
+}
+
+CONFSEQ_INLINE void batch_confidence_sequences(const double* values,
+                                               const size_t* offsets,
+                                               const size_t num_streams,
+                                               const StreamCSParams& params,
+                                               double* lower, double* upper,
+                                               const int num_threads) {
+  const TraceScope trace(TracedFunction::BATCH_CONFIDENCE_SEQUENCES,
+                         offsets[num_streams] - offsets[0]);
+  parallel_for(num_streams, [&](const size_t stream) {
+    const size_t begin = offsets[stream];
+    const size_t n = offsets[stream + 1] - begin;
+    const double N = params.population_sizes == nullptr ? params.N
+        : params.population_sizes[stream];
+    switch (params.kind) {
+      case StreamCSKind::PREDMIX_EMPBERN:
+        predmix_empbern_cs(values + begin, n, params.alpha, params.truncation,
+                           params.fixed_n, params.running_intersection,
+                           lower + begin, upper + begin, params.side);
+        break;
+      case StreamCSKind::PREDMIX_HOEFFDING:
+        predmix_hoeffding_cs(values + begin, n, params.alpha,
+                             params.running_intersection, lower + begin,
+                             upper + begin);
+        break;
+      case StreamCSKind::PREDMIX_EMPBERN_WOR:
+        predmix_empbern_cs_wor(values + begin, n, N, params.alpha,
+                               params.lower_bd, params.upper_bd,
+                               params.running_intersection, lower + begin,
+                               upper + begin);
+        break;
+      case StreamCSKind::PREDMIX_HOEFFDING_WOR:
+        predmix_hoeffding_cs_wor(values + begin, n, N, params.alpha,
+                                 params.lower_bd, params.upper_bd,
+                                 params.running_intersection, lower + begin,
+                                 upper + begin);
+        break;
+      case StreamCSKind::CONJMIX_HOEFFDING:
+        conjmix_hoeffding_cs(values + begin, n, params.t_opt, params.alpha,
+                             params.running_intersection, lower + begin,
+                             upper + begin);
+        break;
+      case StreamCSKind::CONJMIX_EMPBERN:
+        conjmix_empbern_cs(values + begin, n, params.v_opt, params.alpha,
+                           params.running_intersection, lower + begin,
+                           upper + begin, params.side);
+        break;
+      case StreamCSKind::HEDGED:
+        hedged_cs(values + begin, n, params.alpha, N, params.breaks,
+                  params.running_intersection, params.theta,
+                  params.trunc_scale, lower + begin, upper + begin,
+                  params.side);
+        break;
+    }
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE std::vector<size_t> geometric_readout_times(
+    const size_t n, const double eta, const size_t first) {
+  if (!(eta > 1) || first == 0) {
+    throw std::invalid_argument("eta must exceed 1 and first must be positive");
+  }
+  std::vector<size_t> times;
+  for (double scale = first; scale < n; scale *= eta) {
+    const size_t time = size_t(ceil(scale));
+    if (time < n && (times.empty() || time > times.back())) {
+      times.push_back(time);
+    }
+  }
+  if (n > 0) {
+    times.push_back(n);
+  }
+  return times;
+}
+
+CONFSEQ_INLINE void confidence_sequence_readouts(
+    const double* x, const size_t* times, const size_t num_times,
+    const StreamCSParams& params, double* lower, double* upper) {
+  for (size_t i = 0; i < num_times; i++) {
+    if (times[i] == 0 || (i > 0 && times[i] <= times[i - 1])) {
+      throw std::invalid_argument("times must increase from 1 or more");
+    }
+  }
+  const size_t n = num_times == 0 ? 0 : times[num_times - 1];
+  const TraceScope trace(TracedFunction::CONFIDENCE_SEQUENCE_READOUTS, n);
+  if (params.kind == StreamCSKind::CONJMIX_EMPBERN) {
+    // ConjmixEmpBernAccumulator::update with the solves taken out of the
+    // loop.
+    const double alpha = cs_side_alpha(params.side, params.alpha);
+    const GammaExponentialMixture mixture(params.v_opt, alpha, 1);
+    const double log_threshold = log(1 / alpha);
+    double sum = 0, variance = 0, bound = 0, bound_variance = 0;
+    size_t t = 0;
+    for (size_t i = 0; i < num_times; i++) {
+      for (; t < times[i]; t++) {
+        const double mean = t == 0 ? 0.5 : sum / t;
+        variance += (x[t] - mean) * (x[t] - mean);
+        sum += x[t];
+      }
+      bound = i == 0 ? mixture.bound(variance, log_threshold)
+          : find_next_mixture_bound(mixture, bound_variance, bound, variance,
+                                    log_threshold);
+      bound_variance = variance;
+      lower[i] = nan_propagating_max(sum / t - bound / t, 0);
+      upper[i] = nan_propagating_min(sum / t + bound / t, 1);
+      clear_unreported_bound(params.side, lower[i], upper[i]);
+      if (params.running_intersection && i > 0) {
+        lower[i] = nan_propagating_max(lower[i - 1], lower[i]);
+        upper[i] = nan_propagating_min(upper[i - 1], upper[i]);
+      }
+    }
+    return;
+  }
+  auto read_out = [&](auto accumulator) {
+    size_t t = 0;
+    for (size_t i = 0; i < num_times; i++) {
+      std::tie(lower[i], upper[i]) = accumulator.update(x + t, times[i] - t);
+      t = times[i];
+    }
+  };
+  switch (params.kind) {
+    case StreamCSKind::PREDMIX_EMPBERN:
+      read_out(PredmixEmpBernAccumulator(params.alpha, params.truncation,
+                                         params.running_intersection,
+                                         params.fixed_n, params.side));
+      break;
+    case StreamCSKind::PREDMIX_HOEFFDING:
+      read_out(PredmixHoeffdingAccumulator(params.alpha,
+                                           params.running_intersection));
+      break;
+    case StreamCSKind::PREDMIX_EMPBERN_WOR:
+      read_out(PredmixEmpBernWoRAccumulator(
+          params.N, params.alpha, params.lower_bd, params.upper_bd,
+          params.running_intersection));
+      break;
+    case StreamCSKind::PREDMIX_HOEFFDING_WOR:
+      read_out(PredmixHoeffdingWoRAccumulator(
+          params.N, params.alpha, params.lower_bd, params.upper_bd,
+          params.running_intersection));
+      break;
+    case StreamCSKind::CONJMIX_HOEFFDING:
+      read_out(ConjmixHoeffdingAccumulator(params.t_opt, params.alpha,
+                                           params.running_intersection));
+      break;
+    case StreamCSKind::CONJMIX_EMPBERN:
+      break;
+    case StreamCSKind::HEDGED:
+      read_out(HedgedConfidenceSequence(
+          params.alpha, params.N, params.breaks, params.running_intersection,
+          cs_side_theta(params.side, params.theta), params.trunc_scale));
+      break;
+  }
+}
+
+// The first exclusion of null_mean by accumulator on x[0..n). monotone says
+// that exclusions are permanent, as under running intersection.
+template <class Accumulator>
+FirstCrossing accumulator_first_exclusion(Accumulator accumulator,
+                                          const double* x, const size_t n,
+                                          const double null_mean,
+                                          const bool monotone) {
+  auto excludes = [null_mean](const std::pair<double, double>& interval) {
+    return interval.first > null_mean || interval.second < null_mean;
+  };
+  const size_t block_size = monotone ? 64 : 1;
+  FirstCrossing result;
+  std::pair<double, double> interval(result.lower, result.upper);
+  for (size_t t = 0; t < n && result.time == 0;) {
+    const size_t count = std::min(block_size, n - t);
+    if (count == 1) {
+      interval = accumulator.update(x + t, 1);
+      t++;
+      if (excludes(interval)) {
+        result.time = t;
+      }
+      continue;
+    }
+    Accumulator replay(accumulator);
+    interval = accumulator.update(x + t, count);
+    if (excludes(interval)) {
+      for (size_t i = t; i < t + count; i++) {
+        interval = replay.update(x + i, 1);
+        if (excludes(interval) || i + 1 == t + count) {
+          result.time = i + 1;
+          break;
+        }
+      }
+    }
+    t += count;
+  }
+  result.lower = interval.first;
+  result.upper = interval.second;
+  return result;
+}
+
+CONFSEQ_INLINE void cs_first_exclusions(const double* values,
+                                        const size_t* offsets,
+                                        const size_t num_streams,
+                                        const StreamCSParams& params,
+                                        const double null_mean,
+                                        const double* null_means,
+                                        FirstCrossing* out,
+                                        const int num_threads) {
+  const TraceScope trace(TracedFunction::CS_FIRST_EXCLUSIONS,
+                         offsets[num_streams] - offsets[0]);
+  const bool monotone = params.running_intersection;
+  parallel_for(num_streams, [&](const size_t stream) {
+    const double* x = values + offsets[stream];
+    const size_t n = offsets[stream + 1] - offsets[stream];
+    const double N = params.population_sizes == nullptr ? params.N
+        : params.population_sizes[stream];
+    const double null = null_means == nullptr ? null_mean
+        : null_means[stream];
+    switch (params.kind) {
+      case StreamCSKind::PREDMIX_EMPBERN:
+        out[stream] = accumulator_first_exclusion(
+            PredmixEmpBernAccumulator(params.alpha, params.truncation,
+                                      params.running_intersection,
+                                      params.fixed_n, params.side),
+            x, n, null, monotone);
+        break;
+      case StreamCSKind::PREDMIX_HOEFFDING:
+        out[stream] = accumulator_first_exclusion(
+            PredmixHoeffdingAccumulator(params.alpha,
+                                        params.running_intersection),
+            x, n, null, monotone);
+        break;
+      case StreamCSKind::PREDMIX_EMPBERN_WOR:
+        out[stream] = accumulator_first_exclusion(
+            PredmixEmpBernWoRAccumulator(N, params.alpha, params.lower_bd,
+                                         params.upper_bd,
+                                         params.running_intersection),
+            x, n, null, monotone);
+        break;
+      case StreamCSKind::PREDMIX_HOEFFDING_WOR:
+        out[stream] = accumulator_first_exclusion(
+            PredmixHoeffdingWoRAccumulator(N, params.alpha, params.lower_bd,
+                                           params.upper_bd,
+                                           params.running_intersection),
+            x, n, null, monotone);
+        break;
+      case StreamCSKind::CONJMIX_HOEFFDING:
+        out[stream] = accumulator_first_exclusion(
+            ConjmixHoeffdingAccumulator(params.t_opt, params.alpha,
+                                        params.running_intersection),
+            x, n, null, monotone);
+        break;
+      case StreamCSKind::CONJMIX_EMPBERN:
+        out[stream] = accumulator_first_exclusion(
+            ConjmixEmpBernAccumulator(params.v_opt, params.alpha,
+                                      params.running_intersection,
+                                      params.side),
+            x, n, null, monotone);
+        break;
+      case StreamCSKind::HEDGED:
+        out[stream] = accumulator_first_exclusion(
+            HedgedConfidenceSequence(params.alpha, N, params.breaks,
+                                     params.running_intersection,
+                                     cs_side_theta(params.side, params.theta),
+                                     params.trunc_scale),
+            x, n, null, monotone);
+        break;
+    }
+  }, num_threads, 1);
+}
+
+// One method of an IntersectedConfidenceSequence.
+class IntersectedConfidenceSequence::Method {
+ public:
+  virtual ~Method() {}
+
+  virtual std::pair<double, double> update(const double* x,
+                                           const size_t n) = 0;
+  virtual void update(const double* x, const size_t n, double* lower,
+                      double* upper) = 0;
+};
+
+template <class Accumulator>
+class IntersectedConfidenceSequence::AccumulatorMethod
+    : public IntersectedConfidenceSequence::Method {
+ public:
+  explicit AccumulatorMethod(Accumulator accumulator)
+      : accumulator_(std::move(accumulator)) {}
+
+  std::pair<double, double> update(const double* x, const size_t n) override {
+    return accumulator_.update(x, n);
+  }
+  void update(const double* x, const size_t n, double* lower,
+              double* upper) override {
+    for (size_t t = 0; t < n; t++) {
+      std::tie(lower[t], upper[t]) = accumulator_.update(x + t, 1);
+    }
+  }
+
+ private:
+  Accumulator accumulator_;
+};
+
+// The grid sweep writes the bounds after each observation itself.
+template <>
+CONFSEQ_INLINE void IntersectedConfidenceSequence::AccumulatorMethod<
+    HedgedConfidenceSequence>::update(const double* x, const size_t n,
+                                      double* lower, double* upper) {
+  accumulator_.update(x, n, lower, upper);
+}
+
+CONFSEQ_INLINE IntersectedConfidenceSequence::IntersectedConfidenceSequence(
+    const StreamCSParams* methods, const size_t num_methods,
+    const bool running_intersection)
+    : params_(methods, methods + num_methods) {
+  if (num_methods == 0) {
+    throw std::invalid_argument("at least one method is needed");
+  }
+  for (StreamCSParams& params : params_) {
+    params.running_intersection =
+        params.running_intersection || running_intersection;
+    const bool running = params.running_intersection;
+    switch (params.kind) {
+      case StreamCSKind::PREDMIX_EMPBERN:
+        methods_.emplace_back(new AccumulatorMethod<PredmixEmpBernAccumulator>(
+            PredmixEmpBernAccumulator(params.alpha, params.truncation,
+                                      running, params.fixed_n, params.side)));
+        break;
+      case StreamCSKind::PREDMIX_HOEFFDING:
+        methods_.emplace_back(
+            new AccumulatorMethod<PredmixHoeffdingAccumulator>(
+                PredmixHoeffdingAccumulator(params.alpha, running)));
+        break;
+      case StreamCSKind::PREDMIX_EMPBERN_WOR:
+        methods_.emplace_back(
+            new AccumulatorMethod<PredmixEmpBernWoRAccumulator>(
+                PredmixEmpBernWoRAccumulator(params.N, params.alpha,
+                                             params.lower_bd, params.upper_bd,
+                                             running)));
+        break;
+      case StreamCSKind::PREDMIX_HOEFFDING_WOR:
+        methods_.emplace_back(
+            new AccumulatorMethod<PredmixHoeffdingWoRAccumulator>(
+                PredmixHoeffdingWoRAccumulator(params.N, params.alpha,
+                                               params.lower_bd,
+                                               params.upper_bd, running)));
+        break;
+      case StreamCSKind::CONJMIX_HOEFFDING:
+        methods_.emplace_back(
+            new AccumulatorMethod<ConjmixHoeffdingAccumulator>(
+                ConjmixHoeffdingAccumulator(params.t_opt, params.alpha,
+                                            running)));
+        break;
+      case StreamCSKind::CONJMIX_EMPBERN:
+        methods_.emplace_back(new AccumulatorMethod<ConjmixEmpBernAccumulator>(
+            ConjmixEmpBernAccumulator(params.v_opt, params.alpha, running,
+                                      params.side)));
+        break;
+      case StreamCSKind::HEDGED:
+        methods_.emplace_back(new AccumulatorMethod<HedgedConfidenceSequence>(
+            HedgedConfidenceSequence(params.alpha, params.N, params.breaks,
+                                     running,
+                                     cs_side_theta(params.side, params.theta),
+                                     params.trunc_scale)));
+        break;
+    }
+  }
+}
+
+CONFSEQ_INLINE
+IntersectedConfidenceSequence::~IntersectedConfidenceSequence() {}
+
+CONFSEQ_INLINE void IntersectedConfidenceSequence::check_observations(
+    const double* x, const size_t n) const {
+  for (const StreamCSParams& params : params_) {
+    const bool hedged = params.kind == StreamCSKind::HEDGED;
+    const bool finite_population = (hedged && params.N > 0)
+        || params.kind == StreamCSKind::PREDMIX_EMPBERN_WOR
+        || params.kind == StreamCSKind::PREDMIX_HOEFFDING_WOR;
+    if (finite_population && t_ + n > params.N) {
+      throw std::invalid_argument(
+          "More observations than the population size");
+    }
+    for (size_t i = 0; hedged && i < n; i++) {
+      if (!(0 <= x[i] && x[i] <= 1)) {
+        throw std::invalid_argument("Observations must lie in [0, 1]");
+      }
+    }
+  }
+}
+
+CONFSEQ_INLINE std::pair<double, double> IntersectedConfidenceSequence::update(
+    const double* x, const size_t n) {
+  check_observations(x, n);
+  if (n == 0) {
+    return interval();
+  }
+  std::tie(lower_, upper_) = methods_[0]->update(x, n);
+  for (size_t k = 1; k < methods_.size(); k++) {
+    const std::pair<double, double> bounds = methods_[k]->update(x, n);
+    lower_ = nan_propagating_max(lower_, bounds.first);
+    upper_ = nan_propagating_min(upper_, bounds.second);
+  }
+  t_ += n;
+  return interval();
+}
+
+CONFSEQ_INLINE std::pair<double, double> IntersectedConfidenceSequence::update(
+    const double* x, const size_t n, double* lower, double* upper) {
+  check_observations(x, n);
+  constexpr size_t block_size = 256;
+  double method_lower[block_size], method_upper[block_size];
+  for (size_t begin = 0; begin < n; begin += block_size) {
+    const size_t count = std::min(block_size, n - begin);
+    methods_[0]->update(x + begin, count, lower + begin, upper + begin);
+    for (size_t k = 1; k < methods_.size(); k++) {
+      methods_[k]->update(x + begin, count, method_lower, method_upper);
+      for (size_t i = 0; i < count; i++) {
+        lower[begin + i] = nan_propagating_max(lower[begin + i],
+                                               method_lower[i]);
+        upper[begin + i] = nan_propagating_min(upper[begin + i],
+                                               method_upper[i]);
+      }
+    }
+  }
+  if (n > 0) {
+    lower_ = lower[n - 1];
+    upper_ = upper[n - 1];
+    t_ += n;
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE std::pair<double, double> IntersectedConfidenceSequence::update(
+    const double* x, const size_t n, BoundsSink& sink, const size_t first_row,
+    const size_t block_size) {
+  check_observations(x, n);
+  const size_t size = std::min(n, std::max<size_t>(block_size, 1));
+  std::vector<double> lower(size), upper(size);
+  for (size_t begin = 0; begin < n; begin += size) {
+    const size_t count = std::min(size, n - begin);
+    update(x + begin, count, lower.data(), upper.data());
+    sink.write(first_row + begin, lower.data(), upper.data(), count);
+  }
+  return interval();
+}
+
+CONFSEQ_INLINE void intersected_cs(const double* x, const size_t n,
+                                   const StreamCSParams* methods,
+                                   const size_t num_methods,
+                                   const bool running_intersection,
+                                   double* lower, double* upper) {
+  const TraceScope trace(TracedFunction::INTERSECTED_CS, n);
+  IntersectedConfidenceSequence cs(methods, num_methods, running_intersection);
+  cs.update(x, n, lower, upper);
+}
+
+CONFSEQ_INLINE void intersected_cs(const double* x, const size_t n,
+                                   const StreamCSParams* methods,
+                                   const size_t num_methods,
+                                   const bool running_intersection,
+                                   BoundsSink& sink, const size_t block_size) {
+  const TraceScope trace(TracedFunction::INTERSECTED_CS, n);
+  IntersectedConfidenceSequence cs(methods, num_methods, running_intersection);
+  cs.update(x, n, sink, 0, block_size);
+}
+
+CONFSEQ_INLINE void batch_confidence_sequences(const double* values,
+                                               const size_t* offsets,
+                                               const size_t num_streams,
+                                               const StreamCSParams& params,
+                                               BoundsSink& sink,
+                                               const int num_threads,
+                                               const size_t block_size) {
+  const TraceScope trace(TracedFunction::BATCH_CONFIDENCE_SEQUENCES,
+                         offsets[num_streams] - offsets[0]);
+  parallel_for(num_streams, [&](const size_t stream) {
+    StreamCSParams stream_params = params;
+    if (params.population_sizes != nullptr) {
+      stream_params.N = params.population_sizes[stream];
+    }
+    IntersectedConfidenceSequence cs(&stream_params, 1);
+    const size_t begin = offsets[stream];
+    cs.update(values + begin, offsets[stream + 1] - begin, sink, begin,
+              block_size);
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE void CallbackBoundsSink::write(const size_t offset,
+                                              const double* lower,
+                                              const double* upper,
+                                              const size_t n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  callback_(offset, lower, upper, n);
+}
+
+CONFSEQ_INLINE BoundsFileSink::BoundsFileSink(const std::string& path,
+                                              const size_t num_rows)
+    : num_rows_(num_rows) {
+  char header[bounds_file_format::HEADER_SIZE] = {};
+  memcpy(header, bounds_file_format::MAGIC, sizeof(bounds_file_format::MAGIC));
+  memcpy(header + 8, &bounds_file_format::VERSION, sizeof(uint32_t));
+  const uint64_t rows = num_rows;
+  memcpy(header + 16, &rows, sizeof(uint64_t));
+  const size_t file_size =
+      bounds_file_format::HEADER_SIZE + num_rows * 2 * sizeof(double);
+#ifdef CONFSEQ_HAVE_MMAP
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Unable to create " + path);
+  }
+  if (ftruncate(fd_, file_size) != 0) {
+    close(fd_);
+    throw std::runtime_error("Unable to size " + path);
+  }
+#else
+  file_.open(path, std::ios::binary | std::ios::in | std::ios::out
+                       | std::ios::trunc);
+  if (!file_) {
+    throw std::runtime_error("Unable to create " + path);
+  }
+  // Extends the file to its full size, zero-filled.
+  file_.seekp(file_size - 1);
+  file_.put('\0');
+#endif
+  try {
+    write_at(0, header, sizeof(header));
+  } catch (...) {
+#ifdef CONFSEQ_HAVE_MMAP
+    close(fd_);
+#endif
+    throw;
+  }
+}
+
+CONFSEQ_INLINE BoundsFileSink::~BoundsFileSink() {
+#ifdef CONFSEQ_HAVE_MMAP
+  close(fd_);
+#endif
+}
+
+CONFSEQ_INLINE void BoundsFileSink::write(const size_t offset,
+                                          const double* lower,
+                                          const double* upper,
+                                          const size_t n) {
+  if (offset > num_rows_ || n > num_rows_ - offset) {
+    throw std::invalid_argument("Rows past the end of the bounds file");
+  }
+  std::vector<double> rows(2 * n);
+  for (size_t i = 0; i < n; i++) {
+    rows[2 * i] = lower[i];
+    rows[2 * i + 1] = upper[i];
+  }
+  write_at(bounds_file_format::HEADER_SIZE + offset * 2 * sizeof(double),
+           reinterpret_cast<const char*>(rows.data()),
+           rows.size() * sizeof(double));
+}
+
+CONFSEQ_INLINE void BoundsFileSink::write_at(const size_t position,
+                                             const char* data,
+                                             const size_t size) {
+#ifdef CONFSEQ_HAVE_MMAP
+  // pwrite leaves no shared file position, so threads write concurrently.
+  for (size_t done = 0; done < size;) {
+    const ssize_t written = pwrite(fd_, data + done, size - done,
+                                   position + done);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      throw std::runtime_error("Unable to write the bounds file");
+    }
+    done += written;
+  }
+#else
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_.seekp(position);
+  file_.write(data, size);
+  if (!file_) {
+    throw std::runtime_error("Unable to write the bounds file");
+  }
+#endif
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <size_t K>
+ShardedSums<K>::ShardedSums(size_t num_shards) {
+  if (num_shards == 0) {
+    num_shards = 2 * std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_shards_ = num_shards;
+  shards_.reset(new Shard[num_shards]);
+}
+
+template <size_t K>
+void ShardedSums<K>::lock(const Shard& shard) {
+  while (shard.busy.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+template <size_t K>
+void ShardedSums<K>::add(const std::array<double, K>& values) {
+  Shard& s = shard();
+  lock(s);
+  for (size_t k = 0; k < K; k++) {
+    s.sums[k] += values[k];
+  }
+  unlock(s);
+}
+
+template <size_t K>
+std::array<double, K> ShardedSums<K>::total() const {
+  std::array<double, K> total{};
+  for (size_t i = 0; i < num_shards_; i++) {
+    const Shard& s = shards_[i];
+    lock(s);
+    for (size_t k = 0; k < K; k++) {
+      total[k] += s.sums[k];
+    }
+    unlock(s);
+  }
+  return total;
+}
+
+template <size_t K>
+std::array<double, K> ShardedSums<K>::take() {
+  std::array<double, K> total{};
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard& s = shards_[i];
+    lock(s);
+    for (size_t k = 0; k < K; k++) {
+      total[k] += s.sums[k];
+      s.sums[k] = 0;
+    }
+    unlock(s);
+  }
+  return total;
+}
+
+template <class Accumulator>
+IngestionPipeline<Accumulator>::IngestionPipeline(
+    std::vector<Accumulator> streams, const IngestionPipelineOptions& options)
+    : options_(options), num_streams_(streams.size()),
+      accumulators_(std::move(streams)),
+      streams_(new Stream[num_streams_]) {
+  options_.queue_capacity = std::max<size_t>(1, options_.queue_capacity);
+  options_.max_batch = std::max<size_t>(1, options_.max_batch);
+  if (options_.num_workers == 0) {
+    options_.num_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  queue_.reserve(options_.queue_capacity);
+  for (size_t j = 0; j < num_streams_; j++) {
+    publish(j);
+  }
+  for (size_t i = 0; i < options_.num_workers; i++) {
+    workers_.emplace_back(new Worker());
+  }
+  for (const auto& worker : workers_) {
+    Worker* w = worker.get();
+    w->thread = std::thread([this, w]() { work_loop(*w); });
+  }
+  dispatcher_ = std::thread([this]() { dispatch_loop(); });
+}
+
+template <class Accumulator>
+IngestionPipeline<Accumulator>::~IngestionPipeline() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stopping_ = true;
+  }
+  queue_not_empty_.notify_one();
+  // The dispatcher hands off everything queued before it returns, and
+  // workers drain their inboxes before they return.
+  dispatcher_.join();
+  for (const auto& worker : workers_) {
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->stopping = true;
+    }
+    worker->ready.notify_one();
+    worker->thread.join();
+  }
+}
+
+template <class Accumulator>
+void IngestionPipeline<Accumulator>::push(const size_t stream,
+                                          const double* x, const size_t n) {
+  if (stream >= num_streams_) {
+    throw std::out_of_range("Unknown stream");
+  }
+  size_t done = 0;
+  while (done < n) {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    queue_not_full_.wait(lock, [this]() {
+      return queue_.size() < options_.queue_capacity;
+    });
+    const size_t count =
+        std::min(n - done, options_.queue_capacity - queue_.size());
+    for (size_t i = 0; i < count; i++) {
+      queue_.push_back(Event{stream, x[done + i]});
+    }
+    num_pushed_ += count;
+    done += count;
+    lock.unlock();
+    queue_not_empty_.notify_one();
+  }
+}
+
+template <class Accumulator>
+void IngestionPipeline<Accumulator>::flush() {
+  uint64_t target;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    target = num_pushed_;
+    flush_requested_ = true;
+  }
+  queue_not_empty_.notify_one();
+  std::unique_lock<std::mutex> lock(applied_mutex_);
+  applied_changed_.wait(lock, [&]() { return num_applied_ >= target; });
+}
+
+template <class Accumulator>
+StreamSnapshot IngestionPipeline<Accumulator>::snapshot(
+    const size_t stream) const {
+  if (stream >= num_streams_) {
+    throw std::out_of_range("Unknown stream");
+  }
+  const Stream& s = streams_[stream];
+  while (true) {
+    const SnapshotSlot& slot = s.slots[s.current.load(
+        std::memory_order_acquire)];
+    const uint64_t version = slot.version.load(std::memory_order_acquire);
+    if (version % 2 == 0) {
+      StreamSnapshot result;
+      result.lower = slot.lower.load(std::memory_order_relaxed);
+      result.upper = slot.upper.load(std::memory_order_relaxed);
+      result.num_observations =
+          slot.num_observations.load(std::memory_order_relaxed);
+      result.num_rejected = slot.num_rejected.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.version.load(std::memory_order_relaxed) == version) {
+        return result;
+      }
+    }
+    std::this_thread::yield();
+  }
+}
+
+template <class Accumulator>
+void IngestionPipeline<Accumulator>::publish(const size_t stream) {
+  Stream& s = streams_[stream];
+  const Accumulator& accumulator = accumulators_[stream];
+  const std::pair<double, double> interval = accumulator.interval();
+  // Only this stream's worker writes, so the slot not being read from is
+  // free to overwrite.
+  const unsigned next = 1 - s.current.load(std::memory_order_relaxed);
+  SnapshotSlot& slot = s.slots[next];
+  const uint64_t version = slot.version.load(std::memory_order_relaxed);
+  slot.version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.lower.store(interval.first, std::memory_order_relaxed);
+  slot.upper.store(interval.second, std::memory_order_relaxed);
+  slot.num_observations.store(accumulator.num_observations(),
+                              std::memory_order_relaxed);
+  slot.num_rejected.store(s.num_rejected, std::memory_order_relaxed);
+  slot.version.store(version + 2, std::memory_order_release);
+  s.current.store(next, std::memory_order_release);
+}
+
+template <class Accumulator>
+void IngestionPipeline<Accumulator>::dispatch_loop() {
+  using Clock = std::chrono::steady_clock;
+  std::vector<std::vector<double>> pending(num_streams_);
+  std::vector<size_t> pending_streams;
+  std::vector<Event> events;
+  events.reserve(options_.queue_capacity);
+  bool has_pending = false;
+  Clock::time_point deadline;
+  // Moves stream j's pending events to its worker.
+  const auto hand_off = [&](const size_t j) {
+    Worker& worker = *workers_[j % workers_.size()];
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.inbox.push_back(Batch{j, std::move(pending[j])});
+    }
+    worker.ready.notify_one();
+    pending[j].clear();
+  };
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  while (true) {
+    const auto wake = [this]() {
+      return !queue_.empty() || flush_requested_ || stopping_;
+    };
+    if (has_pending) {
+      queue_not_empty_.wait_until(lock, deadline, wake);
+    } else {
+      queue_not_empty_.wait(lock, wake);
+    }
+    events.swap(queue_);
+    const bool flush_all = flush_requested_ || stopping_;
+    const bool stop = stopping_;
+    flush_requested_ = false;
+    lock.unlock();
+    queue_not_full_.notify_all();
+
+    for (const Event& event : events) {
+      std::vector<double>& values = pending[event.stream];
+      if (values.empty()) {
+        pending_streams.push_back(event.stream);
+      }
+      values.push_back(event.value);
+      if (values.size() >= options_.max_batch) {
+        hand_off(event.stream);
+      }
+    }
+    if (!events.empty() && !has_pending) {
+      has_pending = true;
+      deadline = Clock::now() + options_.flush_interval;
+    }
+    events.clear();
+    if (has_pending && (flush_all || Clock::now() >= deadline)) {
+      for (const size_t j : pending_streams) {
+        if (!pending[j].empty()) {
+          hand_off(j);
+        }
+      }
+      pending_streams.clear();
+      has_pending = false;
+    }
+    lock.lock();
+    if (stop && queue_.empty()) {
+      break;
+    }
+  }
+}
+
+template <class Accumulator>
+void IngestionPipeline<Accumulator>::work_loop(Worker& worker) {
+  std::vector<Batch> batches;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      worker.ready.wait(lock, [&]() {
+        return !worker.inbox.empty() || worker.stopping;
+      });
+      if (worker.inbox.empty()) {
+        return;
+      }
+      batches.swap(worker.inbox);
+    }
+    uint64_t applied = 0;
+    for (Batch& batch : batches) {
+      try {
+        accumulators_[batch.stream].update(batch.values.data(),
+                                           batch.values.size());
+      } catch (const std::invalid_argument&) {
+        streams_[batch.stream].num_rejected += batch.values.size();
+      }
+      publish(batch.stream);
+      applied += batch.values.size();
+    }
+    batches.clear();
+    {
+      std::lock_guard<std::mutex> lock(applied_mutex_);
+      num_applied_ += applied;
+    }
+    applied_changed_.notify_all();
+  }
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE size_t ingestion_thread_slot() {
+  static std::atomic<size_t> next_slot(0);
+  thread_local const size_t slot = next_slot++;
+  return slot;
+}
+
+CONFSEQ_INLINE ShardedObservations::ShardedObservations(size_t num_shards) {
+  if (num_shards == 0) {
+    num_shards = 2 * std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_shards_ = num_shards;
+  shards_.reset(new Shard[num_shards]);
+}
+
+CONFSEQ_INLINE void ShardedObservations::add(const double* x,
+                                             const size_t n) {
+  Shard& shard = shards_[ingestion_thread_slot() % num_shards_];
+  while (shard.busy.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  shard.values.insert(shard.values.end(), x, x + n);
+  shard.busy.store(false, std::memory_order_release);
+}
+
+CONFSEQ_INLINE size_t ShardedObservations::drain(std::vector<double>& out) {
+  const size_t start = out.size();
+  std::vector<double> values;
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard& shard = shards_[i];
+    while (shard.busy.exchange(true, std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    // Swaps out the shard's buffer so that copying it to out happens
+    // outside the flag, and hands the shard back an empty buffer that keeps
+    // its capacity.
+    values.swap(shard.values);
+    shard.busy.store(false, std::memory_order_release);
+    out.insert(out.end(), values.begin(), values.end());
+    values.clear();
+  }
+  return out.size() - start;
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+namespace checkpoint_format {
+const char MAGIC[8] = {'C', 'S', 'S', 'T', 'A', 'T', 'E', '\0'};
+// Version 2 adds the side of the empirical Bernstein predmix and conjmix
+// accumulators; version 1 checkpoints still load, as two-sided.
+const uint32_t VERSION = 2;
+// Header: magic, version, kind. Fields follow as 8-byte doubles or unsigned
+// integers in native byte order, so the whole checkpoint stays 8-byte aligned,
+// order statistics are appended as sorted column files, and keyed stores
+// write their keys and states as raw slots.
+enum Kind : uint32_t {
+  BERNOULLI_CS = 1,
+  PREDMIX_EMPBERN = 2,
+  PREDMIX_HOEFFDING = 3,
+  PREDMIX_EMPBERN_WOR = 4,
+  PREDMIX_HOEFFDING_WOR = 5,
+  CONJMIX_EMPBERN = 6,
+  CONJMIX_HOEFFDING = 7,
+  SEQUENTIAL_QUANTILE_AB_TEST = 8,
+  MIXTURE_SUFFICIENT_STATISTICS = 9,
+  SKETCH_ORDER_STATISTICS = 10,
+  KEYED_BERNOULLI_CS = 11,
+  KEYED_CONJMIX_EMPBERN = 12,
+};
+};
+
+class CheckpointWriter {
+ public:
+  CheckpointWriter(std::ostream& out, const checkpoint_format::Kind kind)
+      : out_(out) {
+    const uint32_t kind_value = kind;
+    out_.write(checkpoint_format::MAGIC, sizeof(checkpoint_format::MAGIC));
+    out_.write(reinterpret_cast<const char*>(&checkpoint_format::VERSION),
+               sizeof(uint32_t));
+    out_.write(reinterpret_cast<const char*>(&kind_value), sizeof(uint32_t));
+  }
+
+  void put_double(const double value) {
+    out_.write(reinterpret_cast<const char*>(&value), sizeof(double));
+  }
+  void put_uint(const uint64_t value) {
+    out_.write(reinterpret_cast<const char*>(&value), sizeof(uint64_t));
+  }
+  void put_bool(const bool value) {
+    put_uint(value ? 1 : 0);
+  }
+  // Raw bytes, for arrays of fixed-layout records.
+  void put_bytes(const void* data, const size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+  }
+
+ private:
+  std::ostream& out_;
+};
+
+class CheckpointReader {
+ public:
+  // Throws std::runtime_error unless in starts with a header for kind.
+  CheckpointReader(std::istream& in, const checkpoint_format::Kind kind)
+      : in_(in) {
+    char magic[sizeof(checkpoint_format::MAGIC)];
+    uint32_t kind_value;
+    in_.read(magic, sizeof(magic));
+    in_.read(reinterpret_cast<char*>(&version_), sizeof(uint32_t));
+    in_.read(reinterpret_cast<char*>(&kind_value), sizeof(uint32_t));
+    check(in_ && !memcmp(magic, checkpoint_format::MAGIC, sizeof(magic))
+          && 1 <= version_ && version_ <= checkpoint_format::VERSION
+          && kind_value == kind);
+  }
+
+  uint32_t version() const {
+    return version_;
+  }
+
+  double get_double() {
+    double value;
+    in_.read(reinterpret_cast<char*>(&value), sizeof(double));
+    check_not_truncated();
+    return value;
+  }
+  uint64_t get_uint() {
+    uint64_t value;
+    in_.read(reinterpret_cast<char*>(&value), sizeof(uint64_t));
+    check_not_truncated();
+    return value;
+  }
+  bool get_bool() {
+    const uint64_t value = get_uint();
+    check(value <= 1);
+    return value == 1;
+  }
+  void get_bytes(void* data, const size_t size) {
+    in_.read(static_cast<char*>(data), size);
+    check_not_truncated();
+  }
+
+  static void check(const bool valid) {
+    if (!valid) {
+      throw std::runtime_error("Invalid checkpoint data");
+    }
+  }
+
+ private:
+  void check_not_truncated() const {
+    if (!in_) {
+      throw std::runtime_error("Truncated checkpoint data");
+    }
+  }
+
+  std::istream& in_;
+  uint32_t version_ = 0;
+};
+
+CONFSEQ_INLINE void DynamicOrderStatistics::save(std::ostream& out) const {
+  const uint32_t padding = 0;
+  const uint64_t num_values = size_;
+  out.write(sorted_column_format::MAGIC, sizeof(sorted_column_format::MAGIC));
+  out.write(reinterpret_cast<const char*>(&sorted_column_format::VERSION),
+            sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&padding), sizeof(uint32_t));
+  out.write(reinterpret_cast<const char*>(&num_values), sizeof(uint64_t));
+  for (const std::vector<double>& block : blocks_) {
+    out.write(reinterpret_cast<const char*>(block.data()),
+              block.size() * sizeof(double));
+  }
+}
+
+CONFSEQ_INLINE DynamicOrderStatistics DynamicOrderStatistics::load(
+    std::istream& in) {
+  char header[sorted_column_format::HEADER_SIZE];
+  in.read(header, sizeof(header));
+  if (!in) {
+    throw std::runtime_error("Invalid sorted column data");
+  }
+  std::vector<double> values(parse_sorted_column_header(header));
+  in.read(reinterpret_cast<char*>(values.data()),
+          values.size() * sizeof(double));
+  if (!in) {
+    throw std::runtime_error("Truncated sorted column data");
+  }
+  if (!std::is_sorted(values.begin(), values.end())) {
+    throw std::runtime_error("Invalid sorted column data");
+  }
+  DynamicOrderStatistics order_stats;
+  order_stats.rebuild(values);
+  return order_stats;
+}
+
+CONFSEQ_INLINE void SketchOrderStatistics::save(std::ostream& out) const {
+  CheckpointWriter writer(out, checkpoint_format::SKETCH_ORDER_STATISTICS);
+  writer.put_uint(k_);
+  writer.put_uint(size_);
+  writer.put_uint(rank_error_);
+  writer.put_uint(levels_.size());
+  for (size_t level = 0; level < levels_.size(); level++) {
+    writer.put_bool(level_offsets_[level]);
+    writer.put_uint(levels_[level].size());
+    for (const double value : levels_[level]) {
+      writer.put_double(value);
+    }
+  }
+}
+
+CONFSEQ_INLINE SketchOrderStatistics SketchOrderStatistics::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::SKETCH_ORDER_STATISTICS);
+  const uint64_t k = reader.get_uint();
+  const uint64_t size = reader.get_uint();
+  const uint64_t rank_error = reader.get_uint();
+  const uint64_t num_levels = reader.get_uint();
+  const uint64_t max_int = std::numeric_limits<int>::max();
+  CheckpointReader::check(k >= 2 && k <= max_int && size <= max_int
+                          && rank_error <= max_int && num_levels < 32);
+  SketchOrderStatistics sketch{int(k)};
+  sketch.size_ = int(size);
+  sketch.rank_error_ = int(rank_error);
+  // Every retained value carries the weight of its level, and the weights
+  // add up to the sample size.
+  uint64_t total_weight = 0;
+  for (uint64_t level = 0; level < num_levels; level++) {
+    sketch.level_offsets_.push_back(reader.get_bool());
+    const uint64_t count = reader.get_uint();
+    CheckpointReader::check(count < k);
+    sketch.levels_.emplace_back(count);
+    for (double& value : sketch.levels_.back()) {
+      value = reader.get_double();
+    }
+    total_weight += count << level;
+  }
+  CheckpointReader::check(total_weight == size);
+  return sketch;
+}
+
+CONFSEQ_INLINE void SequentialQuantileABTest::save(std::ostream& out) const {
+  CheckpointWriter writer(out,
+                          checkpoint_format::SEQUENTIAL_QUANTILE_AB_TEST);
+  writer.put_double(quantile_p_);
+  writer.put_uint(t_opt_);
+  writer.put_double(alpha_opt_);
+  writer.put_double(minimizers_[0]);
+  writer.put_double(minimizers_[1]);
+  writer.put_double(p_value_);
+  writer.put_bool(p_value_current_);
+  writer.put_double(running_p_value_);
+  writer.put_bool(running_p_value_current_);
+  arms_[0]->save(out);
+  arms_[1]->save(out);
+}
+
+CONFSEQ_INLINE SequentialQuantileABTest SequentialQuantileABTest::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::SEQUENTIAL_QUANTILE_AB_TEST);
+  const double quantile_p = reader.get_double();
+  const uint64_t t_opt = reader.get_uint();
+  const double alpha_opt = reader.get_double();
+  CheckpointReader::check(0 < quantile_p && quantile_p < 1 && t_opt >= 1
+                          && t_opt <= uint64_t(std::numeric_limits<int>::max())
+                          && 0 < alpha_opt && alpha_opt < 1);
+  SequentialQuantileABTest test(quantile_p, int(t_opt), alpha_opt);
+  test.minimizers_[0] = reader.get_double();
+  test.minimizers_[1] = reader.get_double();
+  test.p_value_ = reader.get_double();
+  test.p_value_current_ = reader.get_bool();
+  test.running_p_value_ = reader.get_double();
+  test.running_p_value_current_ = reader.get_bool();
+  *test.arms_[0] = DynamicOrderStatistics::load(in);
+  *test.arms_[1] = DynamicOrderStatistics::load(in);
+  return test;
+}
+
+CONFSEQ_INLINE void BernoulliConfidenceSequence::save(std::ostream& out)
+    const {
+  CheckpointWriter writer(out, checkpoint_format::BERNOULLI_CS);
+  writer.put_double(alpha_);
+  writer.put_double(t_opt_);
+  writer.put_double(alpha_opt_);
+  writer.put_bool(running_intersection_);
+  writer.put_uint(precision_.bits);
+  writer.put_bool(precision_.conservative);
+  writer.put_double(num_successes_);
+  writer.put_uint(num_trials_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+  writer.put_double(lower_step_);
+  writer.put_double(upper_step_);
+  writer.put_double(interval_.first);
+  writer.put_double(interval_.second);
+}
+
+CONFSEQ_INLINE BernoulliConfidenceSequence BernoulliConfidenceSequence::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::BERNOULLI_CS);
+  const double alpha = reader.get_double();
+  const double t_opt = reader.get_double();
+  const double alpha_opt = reader.get_double();
+  const bool running_intersection = reader.get_bool();
+  SolverPrecision precision;
+  const uint64_t bits = reader.get_uint();
+  precision.conservative = reader.get_bool();
+  CheckpointReader::check(0 < alpha && alpha < 1 && t_opt > 0 && bits >= 1
+                          && bits <= 64);
+  precision.bits = int(bits);
+  BernoulliConfidenceSequence cs(alpha, t_opt, alpha_opt, running_intersection,
+                                 precision);
+  cs.num_successes_ = reader.get_double();
+  const uint64_t num_trials = reader.get_uint();
+  CheckpointReader::check(
+      num_trials <= uint64_t(std::numeric_limits<int>::max()));
+  cs.num_trials_ = int(num_trials);
+  cs.lower_ = reader.get_double();
+  cs.upper_ = reader.get_double();
+  cs.lower_step_ = reader.get_double();
+  cs.upper_step_ = reader.get_double();
+  cs.interval_.first = reader.get_double();
+  cs.interval_.second = reader.get_double();
+  return cs;
+}
+
+CONFSEQ_INLINE void PredmixBets::save(CheckpointWriter& out) const {
+  out.put_uint(uint64_t(params_.kind));
+  out.put_double(params_.alpha);
+  out.put_double(params_.truncation);
+  out.put_double(params_.fixed_n);
+  out.put_bool(params_.fixed_horizon);
+  out.put_double(params_.scale);
+  out.put_double(params_.prior_mean);
+  out.put_double(params_.prior_variance);
+  out.put_double(params_.fake_obs);
+  out.put_double(params_.trunc_scale);
+  out.put_double(params_.fraction);
+  out.put_double(log_inverse_alpha_);
+  out.put_uint(t_);
+  out.put_double(sum_);
+  out.put_double(regularized_squares_);
+}
+
+CONFSEQ_INLINE void PredmixBets::load(CheckpointReader& in) {
+  params_.kind = BettingStrategyKind(in.get_uint());
+  params_.alpha = in.get_double();
+  params_.truncation = in.get_double();
+  params_.fixed_n = in.get_double();
+  params_.fixed_horizon = in.get_bool();
+  params_.scale = in.get_double();
+  params_.prior_mean = in.get_double();
+  params_.prior_variance = in.get_double();
+  params_.fake_obs = in.get_double();
+  params_.trunc_scale = in.get_double();
+  params_.fraction = in.get_double();
+  log_inverse_alpha_ = in.get_double();
+  t_ = in.get_uint();
+  sum_ = in.get_double();
+  regularized_squares_ = in.get_double();
+}
+
+// The side written last by the empirical Bernstein accumulators since
+// checkpoint version 2.
+CONFSEQ_INLINE CSSide read_cs_side(CheckpointReader& reader) {
+  if (reader.version() < 2) {
+    return CSSide::BOTH;
+  }
+  const uint64_t side = reader.get_uint();
+  CheckpointReader::check(side <= uint64_t(CSSide::UPPER));
+  return CSSide(side);
+}
+
+CONFSEQ_INLINE void PredmixEmpBernAccumulator::save(std::ostream& out) const {
+  CheckpointWriter writer(out, checkpoint_format::PREDMIX_EMPBERN);
+  writer.put_bool(running_intersection_);
+  writer.put_double(log_threshold_);
+  bets_.save(writer);
+  writer.put_uint(t_);
+  writer.put_double(sum_);
+  writer.put_double(psi_sum_);
+  writer.put_double(lambda_sum_);
+  writer.put_double(weighted_sum_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+  writer.put_uint(uint64_t(side_));
+}
+
+CONFSEQ_INLINE PredmixEmpBernAccumulator PredmixEmpBernAccumulator::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::PREDMIX_EMPBERN);
+  PredmixEmpBernAccumulator cs;
+  cs.running_intersection_ = reader.get_bool();
+  cs.log_threshold_ = reader.get_double();
+  cs.bets_.load(reader);
+  cs.t_ = reader.get_uint();
+  cs.sum_ = reader.get_double();
+  cs.psi_sum_ = reader.get_double();
+  cs.lambda_sum_ = reader.get_double();
+  cs.weighted_sum_ = reader.get_double();
+  cs.lower_ = reader.get_double();
+  cs.upper_ = reader.get_double();
+  cs.side_ = read_cs_side(reader);
+  return cs;
+}
+
+CONFSEQ_INLINE void PredmixHoeffdingAccumulator::save(std::ostream& out)
+    const {
+  CheckpointWriter writer(out, checkpoint_format::PREDMIX_HOEFFDING);
+  writer.put_bool(running_intersection_);
+  writer.put_double(log_threshold_);
+  writer.put_uint(t_);
+  writer.put_double(psi_sum_);
+  writer.put_double(lambda_sum_);
+  writer.put_double(weighted_sum_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+}
+
+CONFSEQ_INLINE PredmixHoeffdingAccumulator PredmixHoeffdingAccumulator::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::PREDMIX_HOEFFDING);
+  PredmixHoeffdingAccumulator cs;
+  cs.running_intersection_ = reader.get_bool();
+  cs.log_threshold_ = reader.get_double();
+  cs.t_ = reader.get_uint();
+  cs.psi_sum_ = reader.get_double();
+  cs.lambda_sum_ = reader.get_double();
+  cs.weighted_sum_ = reader.get_double();
+  cs.lower_ = reader.get_double();
+  cs.upper_ = reader.get_double();
+  return cs;
+}
+
+CONFSEQ_INLINE void PredmixEmpBernWoRAccumulator::save(std::ostream& out)
+    const {
+  CheckpointWriter writer(out, checkpoint_format::PREDMIX_EMPBERN_WOR);
+  writer.put_double(N_);
+  writer.put_double(lower_bd_);
+  writer.put_double(upper_bd_);
+  writer.put_bool(running_intersection_);
+  writer.put_double(log_threshold_);
+  writer.put_uint(t_);
+  writer.put_double(sum_);
+  writer.put_double(variance_);
+  writer.put_double(psi_sum_);
+  writer.put_double(lambda_sum_);
+  writer.put_double(weighted_sum_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+}
+
+CONFSEQ_INLINE PredmixEmpBernWoRAccumulator PredmixEmpBernWoRAccumulator::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::PREDMIX_EMPBERN_WOR);
+  const double N = reader.get_double();
+  PredmixEmpBernWoRAccumulator cs(N);
+  cs.lower_bd_ = reader.get_double();
+  cs.upper_bd_ = reader.get_double();
+  cs.running_intersection_ = reader.get_bool();
+  cs.log_threshold_ = reader.get_double();
+  cs.t_ = reader.get_uint();
+  cs.sum_ = reader.get_double();
+  cs.variance_ = reader.get_double();
+  cs.psi_sum_ = reader.get_double();
+  cs.lambda_sum_ = reader.get_double();
+  cs.weighted_sum_ = reader.get_double();
+  cs.lower_ = reader.get_double();
+  cs.upper_ = reader.get_double();
+  return cs;
+}
+
+CONFSEQ_INLINE void PredmixHoeffdingWoRAccumulator::save(std::ostream& out)
+    const {
+  CheckpointWriter writer(out, checkpoint_format::PREDMIX_HOEFFDING_WOR);
+  writer.put_double(N_);
+  writer.put_double(lower_bd_);
+  writer.put_double(upper_bd_);
+  writer.put_bool(running_intersection_);
+  writer.put_double(log_threshold_);
+  writer.put_uint(t_);
+  writer.put_double(sum_);
+  writer.put_double(psi_sum_);
+  writer.put_double(lambda_sum_);
+  writer.put_double(weighted_sum_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+}
+
+CONFSEQ_INLINE PredmixHoeffdingWoRAccumulator
+PredmixHoeffdingWoRAccumulator::load(std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::PREDMIX_HOEFFDING_WOR);
+  const double N = reader.get_double();
+  PredmixHoeffdingWoRAccumulator cs(N);
+  cs.lower_bd_ = reader.get_double();
+  cs.upper_bd_ = reader.get_double();
+  cs.running_intersection_ = reader.get_bool();
+  cs.log_threshold_ = reader.get_double();
+  cs.t_ = reader.get_uint();
+  cs.sum_ = reader.get_double();
+  cs.psi_sum_ = reader.get_double();
+  cs.lambda_sum_ = reader.get_double();
+  cs.weighted_sum_ = reader.get_double();
+  cs.lower_ = reader.get_double();
+  cs.upper_ = reader.get_double();
+  return cs;
+}
+
+// The conjugate mixture accumulators rebuild their mixtures from the saved
+// constructor arguments.
+CONFSEQ_INLINE void ConjmixEmpBernAccumulator::save(std::ostream& out) const {
+  CheckpointWriter writer(out, checkpoint_format::CONJMIX_EMPBERN);
+  writer.put_double(v_opt_);
+  writer.put_double(alpha_);
+  writer.put_bool(running_intersection_);
+  writer.put_uint(t_);
+  writer.put_double(sum_);
+  writer.put_double(variance_);
+  writer.put_double(bound_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+  writer.put_uint(uint64_t(side_));
+}
+
+CONFSEQ_INLINE ConjmixEmpBernAccumulator ConjmixEmpBernAccumulator::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::CONJMIX_EMPBERN);
+  const double v_opt = reader.get_double();
+  const double alpha = reader.get_double();
+  const bool running_intersection = reader.get_bool();
+  CheckpointReader::check(v_opt > 0 && 0 < alpha && alpha < 1);
+  const uint64_t t = reader.get_uint();
+  const double sum = reader.get_double();
+  const double variance = reader.get_double();
+  const double bound = reader.get_double();
+  const double lower = reader.get_double();
+  const double upper = reader.get_double();
+  ConjmixEmpBernAccumulator cs(v_opt, alpha, running_intersection,
+                               read_cs_side(reader));
+  cs.t_ = t;
+  cs.sum_ = sum;
+  cs.variance_ = variance;
+  cs.bound_ = bound;
+  cs.lower_ = lower;
+  cs.upper_ = upper;
+  return cs;
+}
+
+CONFSEQ_INLINE void ConjmixHoeffdingAccumulator::save(std::ostream& out)
+    const {
+  CheckpointWriter writer(out, checkpoint_format::CONJMIX_HOEFFDING);
+  writer.put_double(t_opt_);
+  writer.put_double(alpha_);
+  writer.put_bool(running_intersection_);
+  writer.put_uint(t_);
+  writer.put_double(sum_);
+  writer.put_double(lower_);
+  writer.put_double(upper_);
+}
+
+CONFSEQ_INLINE ConjmixHoeffdingAccumulator ConjmixHoeffdingAccumulator::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::CONJMIX_HOEFFDING);
+  const double t_opt = reader.get_double();
+  const double alpha = reader.get_double();
+  const bool running_intersection = reader.get_bool();
+  CheckpointReader::check(t_opt > 0 && 0 < alpha && alpha < 1);
+  ConjmixHoeffdingAccumulator cs(t_opt, alpha, running_intersection);
+  cs.t_ = reader.get_uint();
+  cs.sum_ = reader.get_double();
+  cs.lower_ = reader.get_double();
+  cs.upper_ = reader.get_double();
+  return cs;
+}
+
+CONFSEQ_INLINE MixtureSufficientStatistics::MixtureSufficientStatistics(
+    const double s, const double v, const uint64_t num_observations)
+    : s_(s), v_(v), num_observations_(num_observations) {
+  if (!(v >= 0)) {
+    throw std::invalid_argument("v must be nonnegative");
+  }
+}
+
+CONFSEQ_INLINE void MixtureSufficientStatistics::add(
+    const double s_increment, const double v_increment,
+    const uint64_t num_observations) {
+  if (!(v_increment >= 0)) {
+    throw std::invalid_argument("v increments must be nonnegative");
+  }
+  s_ += s_increment;
+  v_ += v_increment;
+  num_observations_ += num_observations;
+}
+
+CONFSEQ_INLINE void MixtureSufficientStatistics::add(
+    const double* s_increments, const double* v_increments, const size_t n) {
+  double s_sum = 0;
+  double v_sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    s_sum += s_increments[i];
+    v_sum += v_increments[i];
+  }
+  add(s_sum, v_sum, n);
+}
+
+CONFSEQ_INLINE void MixtureSufficientStatistics::merge(
+    const MixtureSufficientStatistics& other) {
+  s_ += other.s_;
+  v_ += other.v_;
+  num_observations_ += other.num_observations_;
+}
+
+CONFSEQ_INLINE double MixtureSufficientStatistics::p_value(
+    const MixtureSupermartingale& mixture_superMG) const {
+  return nan_propagating_min(1, exp(-log_superMG(mixture_superMG)));
+}
+
+CONFSEQ_INLINE void MixtureSufficientStatistics::save(std::ostream& out)
+    const {
+  CheckpointWriter writer(out,
+                          checkpoint_format::MIXTURE_SUFFICIENT_STATISTICS);
+  writer.put_double(s_);
+  writer.put_double(v_);
+  writer.put_uint(num_observations_);
+}
+
+CONFSEQ_INLINE MixtureSufficientStatistics MixtureSufficientStatistics::load(
+    std::istream& in) {
+  CheckpointReader reader(in,
+                          checkpoint_format::MIXTURE_SUFFICIENT_STATISTICS);
+  const double s = reader.get_double();
+  const double v = reader.get_double();
+  const uint64_t num_observations = reader.get_uint();
+  CheckpointReader::check(v >= 0);
+  return MixtureSufficientStatistics(s, v, num_observations);
+}
+
+CONFSEQ_INLINE void mixture_p_values(
+    const MixtureSupermartingale& mixture_superMG, const double* s,
+    const double* v, const size_t n, const bool running_min, double* out,
+    const int num_threads) {
+  const TraceScope trace(TracedFunction::MIXTURE_P_VALUES, n);
+  const size_t block_size = 4096;
+  parallel_for((n + block_size - 1) / block_size, [&](const size_t block) {
+    const size_t begin = block * block_size;
+    const size_t end = std::min(n, begin + block_size);
+    mixture_superMG.log_superMG(s + begin, v + begin, end - begin,
+                                out + begin);
+    for (size_t i = begin; i < end; i++) {
+      out[i] = nan_propagating_min(1, exp(-out[i]));
+    }
+  }, num_threads, 1);
+  if (running_min) {
+    for (size_t i = 1; i < n; i++) {
+      out[i] = nan_propagating_min(out[i - 1], out[i]);
+    }
+  }
+}
+
+CONFSEQ_INLINE void mixture_first_crossings(
+    const MixtureSupermartingale& mixture_superMG, const double* s,
+    const double* v, const size_t* offsets, const size_t num_streams,
+    const double alpha, FirstCrossing* out, const int num_threads) {
+  const TraceScope trace(TracedFunction::MIXTURE_FIRST_CROSSINGS,
+                         offsets[num_streams] - offsets[0]);
+  parallel_for(num_streams, [&](const size_t stream) {
+    const size_t begin = offsets[stream];
+    const size_t end = offsets[stream + 1];
+    FirstCrossing result;
+    std::vector<double> log_superMG;
+    size_t block_size = 64;
+    for (size_t i = begin; i < end && result.time == 0;) {
+      const size_t count = std::min(block_size, end - i);
+      log_superMG.resize(count);
+      mixture_superMG.log_superMG(s + i, v + i, count, log_superMG.data());
+      for (size_t j = 0; j < count; j++) {
+        result.p_value = nan_propagating_min(
+            result.p_value, nan_propagating_min(1, exp(-log_superMG[j])));
+        if (result.p_value <= alpha) {
+          result.time = i + j + 1 - begin;
+          break;
+        }
+      }
+      i += count;
+      block_size = std::min<size_t>(2 * block_size, 4096);
+    }
+    out[stream] = result;
+  }, num_threads, 1);
+}
+
+CONFSEQ_INLINE EBHProcedure::EBHProcedure(const size_t num_tests,
+                                          const double alpha)
+    : alpha_(alpha), log_scale_(log(num_tests / alpha)),
+      log_e_values_(num_tests, 0), counts_(num_tests + 2, 0) {
+  if (num_tests == 0 || !(0 < alpha && alpha < 1)) {
+    throw std::invalid_argument("Need num_tests > 0 and 0 < alpha < 1");
+  }
+  thresholds_.assign(num_tests, threshold_index(0));
+  counts_[thresholds_[0]] = num_tests;
+  update_num_rejections();
+}
+
+CONFSEQ_INLINE size_t EBHProcedure::threshold_index(
+    const double log_e_value) const {
+  const size_t n = num_tests();
+  if (!(log_e_value >= log_scale_ - log(double(n)))) {
+    return n + 1;
+  }
+  size_t k = size_t(std::max(1.0, ceil(exp(log_scale_ - log_e_value))));
+  k = std::min(k, n);
+  // Correct rounding in exp so that the index agrees with the comparison.
+  while (k > 1 && log_e_value >= log_scale_ - log(double(k - 1))) {
+    k--;
+  }
+  while (k <= n && log_e_value < log_scale_ - log(double(k))) {
+    k++;
+  }
+  return k;
+}
+
+CONFSEQ_INLINE void EBHProcedure::set(const size_t test,
+                                      const double log_e_value) {
+  if (test >= num_tests()) {
+    throw std::invalid_argument("Test index out of range");
+  }
+  const size_t k = threshold_index(log_e_value);
+  counts_[thresholds_[test]]--;
+  counts_[k]++;
+  thresholds_[test] = k;
+  log_e_values_[test] = log_e_value;
+}
+
+CONFSEQ_INLINE void EBHProcedure::update_num_rejections() {
+  // Scans k down from num_tests, keeping the number of thresholds <= k.
+  size_t at_most_k = num_tests() - counts_[num_tests() + 1];
+  size_t k = num_tests();
+  while (k > 0 && at_most_k < k) {
+    at_most_k -= counts_[k];
+    k--;
+  }
+  num_rejections_ = k;
+}
+
+CONFSEQ_INLINE void EBHProcedure::update(const size_t* indices,
+                                         const double* log_e_values,
+                                         const size_t count) {
+  const TraceScope trace(TracedFunction::E_BH_UPDATE, count);
+  for (size_t j = 0; j < count; j++) {
+    set(indices[j], log_e_values[j]);
+  }
+  update_num_rejections();
+}
+
+CONFSEQ_INLINE void EBHProcedure::update_all(const double* log_e_values) {
+  const TraceScope trace(TracedFunction::E_BH_UPDATE, num_tests());
+  std::fill(counts_.begin(), counts_.end(), 0);
+  for (size_t i = 0; i < num_tests(); i++) {
+    log_e_values_[i] = log_e_values[i];
+    thresholds_[i] = threshold_index(log_e_values[i]);
+    counts_[thresholds_[i]]++;
+  }
+  update_num_rejections();
+}
+
+CONFSEQ_INLINE void EBHProcedure::update_from_mixture(
+    const MixtureSupermartingale& mixture_superMG, const size_t* indices,
+    const double* s, const double* v, const size_t count,
+    const int num_threads) {
+  if (!indices && count > num_tests()) {
+    throw std::invalid_argument("More e-values than tests");
+  }
+  std::vector<double> log_e_values(count);
+  const size_t block_size = 4096;
+  parallel_for((count + block_size - 1) / block_size, [&](const size_t block) {
+    const size_t begin = block * block_size;
+    const size_t end = std::min(count, begin + block_size);
+    mixture_superMG.log_superMG(s + begin, v + begin, end - begin,
+                                log_e_values.data() + begin);
+  }, num_threads, 1);
+  if (indices) {
+    update(indices, log_e_values.data(), count);
+  } else if (count == num_tests()) {
+    update_all(log_e_values.data());
+  } else {
+    const TraceScope trace(TracedFunction::E_BH_UPDATE, count);
+    for (size_t i = 0; i < count; i++) {
+      set(i, log_e_values[i]);
+    }
+    update_num_rejections();
+  }
+}
+
+CONFSEQ_INLINE void EBHProcedure::rejections(bool* out) const {
+  for (size_t i = 0; i < num_tests(); i++) {
+    out[i] = rejected(i);
+  }
+}
+
+CONFSEQ_INLINE RefreshScheduler::RefreshScheduler(const size_t num_tests,
+                                                  const double alpha)
+    : alpha_(alpha), log_threshold_(log(1 / alpha)), states_(num_tests) {
+  if (num_tests == 0 || !(0 < alpha && alpha < 1)) {
+    throw std::invalid_argument("Need num_tests > 0 and 0 < alpha < 1");
+  }
+}
+
+CONFSEQ_INLINE void RefreshScheduler::check_test(const size_t test) const {
+  if (test >= num_tests()) {
+    throw std::invalid_argument("Test index out of range");
+  }
+}
+
+CONFSEQ_INLINE void RefreshScheduler::observe(const size_t test,
+                                              const double v) {
+  check_test(test);
+  states_[test].observed_v = std::max(states_[test].observed_v, v);
+}
+
+CONFSEQ_INLINE void RefreshScheduler::record_refresh(
+    const size_t test, const double log_superMG, const double v) {
+  check_test(test);
+  TestState& state = states_[test];
+  state.previous_log_superMG = state.log_superMG;
+  state.previous_v = state.v;
+  state.log_superMG = log_superMG;
+  state.v = v;
+  state.observed_v = std::max(state.observed_v, v);
+  state.num_refreshes++;
+}
+
+CONFSEQ_INLINE bool RefreshScheduler::stale(const size_t test) const {
+  const TestState& state = states_[test];
+  return state.num_refreshes == 0 || state.observed_v > state.v;
+}
+
+CONFSEQ_INLINE double RefreshScheduler::priority(const size_t test) const {
+  check_test(test);
+  const TestState& state = states_[test];
+  if (state.num_refreshes == 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  if (rejected(test)) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  const double dv = state.observed_v - state.v;
+  double predicted = state.log_superMG;
+  if (state.num_refreshes > 1 && state.v > state.previous_v) {
+    const double slope = (state.log_superMG - state.previous_log_superMG)
+        / (state.v - state.previous_v);
+    predicted += std::max(slope, 0.0) * dv;
+  }
+  if (dv > 0) {
+    predicted += state.v > 0
+        ? sqrt(2 * std::max(state.log_superMG, 1.0) * dv / state.v)
+        : std::numeric_limits<double>::infinity();
+  }
+  return predicted - log_threshold_;
+}
+
+CONFSEQ_INLINE size_t RefreshScheduler::run(
+    const RefreshFunction& refresh,
+    const std::chrono::steady_clock::time_point deadline) {
+  std::vector<std::pair<double, size_t>> queue;
+  for (size_t test = 0; test < num_tests(); test++) {
+    if (stale(test) && !rejected(test)) {
+      queue.emplace_back(priority(test), test);
+    }
+  }
+  // Ties go to the lower index, so that equal priorities refresh in order.
+  const auto lower_priority = [](const std::pair<double, size_t>& a,
+                                 const std::pair<double, size_t>& b) {
+    return a.first < b.first || (a.first == b.first && a.second > b.second);
+  };
+  std::make_heap(queue.begin(), queue.end(), lower_priority);
+  const bool limited = deadline != std::chrono::steady_clock::time_point{};
+  size_t num_refreshed = 0;
+  while (!queue.empty()) {
+    if (limited && std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    std::pop_heap(queue.begin(), queue.end(), lower_priority);
+    const size_t test = queue.back().second;
+    queue.pop_back();
+    const std::pair<double, double> result = refresh(test);
+    record_refresh(test, result.first, result.second);
+    num_refreshed++;
+  }
+  return num_refreshed;
+}
+
+CONFSEQ_INLINE MixtureTuningResult tune_mixture(
+    const std::vector<const MixtureSupermartingale*>& candidates,
+    const double* v, const double* weights, const size_t num_v,
+    const double alpha, const int num_threads) {
+  if (candidates.empty() || num_v == 0 || !(0 < alpha && alpha < 1)) {
+    throw std::invalid_argument(
+        "Need candidates, evaluation points and 0 < alpha < 1");
+  }
+  const TraceScope trace(TracedFunction::TUNE_MIXTURE,
+                         candidates.size() * num_v);
+  const size_t num_candidates = candidates.size();
+  MixtureTuningResult result;
+  result.losses.resize(num_candidates);
+  result.bounds.resize(num_candidates * num_v);
+  // Blocks long enough for warm starts to pay off, and numerous enough to
+  // occupy every thread when there are few candidates.
+  const size_t block_size = 256;
+  const size_t num_blocks = (num_v + block_size - 1) / block_size;
+  const double log_threshold = log(1 / alpha);
+  parallel_for(num_candidates * num_blocks, [&](const size_t task) {
+    const size_t k = task / num_blocks;
+    const size_t begin = (task % num_blocks) * block_size;
+    const size_t end = std::min(num_v, begin + block_size);
+    candidates[k]->bound_sequence(v + begin, end - begin, log_threshold,
+                                  &result.bounds[k * num_v + begin]);
+  }, num_threads, 1);
+
+  result.best_index = num_candidates;
+  for (size_t k = 0; k < num_candidates; k++) {
+    const double* bounds = &result.bounds[k * num_v];
+    double loss = 0;
+    for (size_t i = 0; i < num_v; i++) {
+      loss += (weights ? weights[i] : 1.0 / num_v) * bounds[i];
+    }
+    result.losses[k] = loss;
+    if (!std::isnan(loss) && (result.best_index == num_candidates
+                              || loss < result.losses[result.best_index])) {
+      result.best_index = k;
+    }
+  }
+  return result;
+}
+
+CONFSEQ_INLINE void mixture_bounds(
+    const MixtureSupermartingale& mixture_superMG, const double* v,
+    const double* alpha, const size_t n, double* out, EvaluationStatus* status,
+    int num_threads) {
+  parallel_for(n, [&](const size_t i) {
+    out[i] = std::numeric_limits<double>::quiet_NaN();
+    if (!(v[i] >= 0) || !(0 < alpha[i] && alpha[i] < 1)) {
+      status[i] = EvaluationStatus::INVALID_ARGUMENT;
+      return;
+    }
+    try {
+      out[i] = mixture_superMG.bound(v[i], log(1 / alpha[i]));
+    } catch (const std::exception&) {
+      out[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    status[i] = std::isnan(out[i]) ? EvaluationStatus::NUMERICAL_ERROR
+        : EvaluationStatus::OK;
+  }, num_threads, 64);
+}
+
+CONFSEQ_INLINE void bernoulli_confidence_intervals(
+    const double* num_successes, const int* num_trials, const size_t n,
+    const double alpha, const double t_opt, const double alpha_opt,
+    double* lower, double* upper, EvaluationStatus* status,
+    int num_threads) {
+  const bool valid_parameters = 0 < alpha && alpha < 1 && t_opt > 0
+      && 0 < alpha_opt && alpha_opt < 1;
+  parallel_for(n, [&](const size_t i) {
+    lower[i] = upper[i] = std::numeric_limits<double>::quiet_NaN();
+    if (!valid_parameters || !(num_trials[i] > 0)
+        || !(0 <= num_successes[i] && num_successes[i] <= num_trials[i])) {
+      status[i] = EvaluationStatus::INVALID_ARGUMENT;
+      return;
+    }
+    try {
+      const std::pair<double, double> interval = bernoulli_confidence_interval(
+          num_successes[i], num_trials[i], alpha, t_opt, alpha_opt);
+      lower[i] = interval.first;
+      upper[i] = interval.second;
+    } catch (const std::exception&) {
+      lower[i] = upper[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    status[i] = std::isnan(lower[i]) || std::isnan(upper[i])
+        ? EvaluationStatus::NUMERICAL_ERROR : EvaluationStatus::OK;
+  }, num_threads, 16);
+}
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
+
+template <class MakeMonitor>
+CrossingSimulationResult simulate_crossings(const SimulatedData& data,
+                                            const size_t horizon,
+                                            const size_t replicates,
+                                            const uint64_t seed,
+                                            MakeMonitor make_monitor,
+                                            const int num_threads) {
+  const TraceScope trace(TracedFunction::SIMULATE_CROSSINGS, replicates);
+  CrossingSimulationResult result;
+  result.replicates = replicates;
+  result.crossing_times.assign(replicates, 0);
+  const size_t length = std::min(horizon, data.max_length());
+  size_t* crossing_times = result.crossing_times.data();
+  parallel_for(replicates, [&](const size_t replicate) {
+    SimulatedStream stream(data, seed, replicate);
+    auto monitor = make_monitor();
+    for (size_t t = 1; t <= length; t++) {
+      if (monitor(stream.next())) {
+        crossing_times[replicate] = t;
+        return;
+      }
+    }
+  }, num_threads, 1);
+  result.crossings = replicates - std::count(result.crossing_times.begin(),
+                                             result.crossing_times.end(), 0);
+  return result;
+}
+
+template <class State>
+KeyedStateTable<State>::KeyedStateTable(const size_t capacity) {
+  size_t num_slots = 16;
+  while (num_slots / 4 * 3 < capacity) {
+    num_slots *= 2;
+  }
+  slots_.assign(num_slots, Slot());
+  mask_ = num_slots - 1;
+}
+
+template <class State>
+uint64_t KeyedStateTable<State>::hash(uint64_t key) {
+  // The MurmurHash3 finalizer, so that sequential keys spread over the
+  // table.
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+template <class State>
+State& KeyedStateTable<State>::find_or_insert(const uint64_t key) {
+  if (key == 0) {
+    has_zero_key_ = true;
+    return zero_state_;
+  }
+  for (size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+    Slot& slot = slots_[i];
+    if (slot.key == key) {
+      return slot.state;
+    }
+    if (slot.key == 0) {
+      if ((size_ + 1) * 4 > slots_.size() * 3) {
+        grow();
+        return find_or_insert(key);
+      }
+      slot.key = key;
+      size_++;
+      return slot.state;
+    }
+  }
+}
+
+template <class State>
+const State* KeyedStateTable<State>::find(const uint64_t key) const {
+  if (key == 0) {
+    return has_zero_key_ ? &zero_state_ : nullptr;
+  }
+  for (size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+    const Slot& slot = slots_[i];
+    if (slot.key == key) {
+      return &slot.state;
+    }
+    if (slot.key == 0) {
+      return nullptr;
+    }
+  }
+}
+
+template <class State>
+template <class Fn>
+void KeyedStateTable<State>::for_each(Fn fn) const {
+  if (has_zero_key_) {
+    fn(uint64_t(0), zero_state_);
+  }
+  for (const Slot& slot : slots_) {
+    if (slot.key != 0) {
+      fn(slot.key, slot.state);
+    }
+  }
+}
+
+template <class State>
+void KeyedStateTable<State>::grow() {
+  std::vector<Slot> slots(2 * slots_.size(), Slot());
+  slots_.swap(slots);
+  mask_ = slots_.size() - 1;
+  for (const Slot& slot : slots) {
+    if (slot.key != 0) {
+      size_t i = hash(slot.key) & mask_;
+      while (slots_[i].key != 0) {
+        i = (i + 1) & mask_;
+      }
+      slots_[i] = slot;
+    }
+  }
+}
+
+#ifdef CONFSEQ_DEFINE_IMPLEMENTATIONS
+CONFSEQ_INLINE CounterRng::CounterRng(const uint64_t seed,
+                                      const uint64_t stream)
+    : key_{{uint32_t(seed), uint32_t(seed >> 32)}},
+      counter_{{0, 0, uint32_t(stream), uint32_t(stream >> 32)}} {}
 
- private:
-  struct GFunction {
-    const std::function<double(const double)> G;
-    const double minimum_start_x;
-    const double minimum_end_x;
-  };
-
-  double log_superMG_lower_bound() const;
-  GFunction get_G_fn(const int arm) const;
-  double empirical_quantile(const int arm) const;
-  double find_log_superMG_lower_bound(const GFunction first_arm_G,
-                                      const GFunction second_arm_G,
-                                      const int second_arm) const;
-  double arm_log_superMG(const int arm, const double prop_below) const;
-  const std::shared_ptr<OrderStatisticInterface>& order_stats(const int arm)
-      const;
+CONFSEQ_INLINE std::array<uint32_t, 4> CounterRng::philox(
+    std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+  for (int round = 0; round < 10; round++) {
+    if (round > 0) {
+      key[0] += 0x9E3779B9;
+      key[1] += 0xBB67AE85;
+    }
+    const uint64_t product0 = uint64_t(0xD2511F53) * counter[0];
+    const uint64_t product1 = uint64_t(0xCD9E8D57) * counter[2];
+    counter = {{uint32_t(product1 >> 32) ^ counter[1] ^ key[0],
+                uint32_t(product1),
+                uint32_t(product0 >> 32) ^ counter[3] ^ key[1],
+                uint32_t(product0)}};
+  }
+  return counter;
+}
 
-  const double quantile_p_;
-  const std::unique_ptr<MixtureSupermartingale> mixture_;
-  const std::shared_ptr<OrderStatisticInterface> arm1_os_;
-  const std::shared_ptr<OrderStatisticInterface> arm2_os_;
-};
+CONFSEQ_INLINE CounterRng::result_type CounterRng::operator()() {
+  if (next_word_ == 4) {
+    block_ = philox(counter_, key_);
+    if (++counter_[0] == 0) {
+      counter_[1]++;
+    }
+    next_word_ = 0;
+  }
+  const uint64_t value =
+      uint64_t(block_[next_word_]) << 32 | block_[next_word_ + 1];
+  next_word_ += 2;
+  return value;
+}
 
-//////////////////////////////////////////////////////////////////////
-// Implementation
-//////////////////////////////////////////////////////////////////////
+CONFSEQ_INLINE double CounterRng::uniform() {
+  return ldexp(double((*this)() >> 11) + 0.5, -53);
+}
 
-inline double find_s_upper_bound(const MixtureSupermartingale& mixture_superMG,
-                                 const double v, const double log_threshold) {
-  double trial_upper_bound = v;
-  for (int i = 0; i < 50; i++) {
-    if (mixture_superMG.log_superMG(trial_upper_bound, v) > log_threshold) {
-      return trial_upper_bound;
-    }
-    trial_upper_bound *= 2;
+CONFSEQ_INLINE double CounterRng::normal() {
+  if (has_spare_normal_) {
+    has_spare_normal_ = false;
+    return spare_normal_;
   }
-  throw std::runtime_error(
-      "Failed to find an upper limit for the mixture bound");
+  const double radius = sqrt(-2 * log(uniform()));
+  const double angle = 2 * boost::math::constants::pi<double>() * uniform();
+  spare_normal_ = radius * sin(angle);
+  has_spare_normal_ = true;
+  return radius * cos(angle);
 }
 
-inline double find_mixture_bound(const MixtureSupermartingale& mixture_superMG,
-                                 const double v, const double log_threshold) {
-  auto root_fn = [&mixture_superMG, v, log_threshold](const double s) {
-    return mixture_superMG.log_superMG(s, v) - log_threshold;
-  };
-  double s_upper_bound = mixture_superMG.s_upper_bound(v);
-  if (s_upper_bound == std::numeric_limits<double>::infinity()) {
-    s_upper_bound = find_s_upper_bound(mixture_superMG, v, log_threshold);
+CONFSEQ_INLINE SimulatedData SimulatedData::bernoulli(const double p) {
+  if (!(0 <= p && p <= 1)) {
+    throw std::invalid_argument("p must lie in [0, 1]");
   }
-  if (root_fn(s_upper_bound) < 0) {
-    return s_upper_bound;
-  } else {
-    auto result = boost::math::tools::bisect(
-        root_fn, 0.0, s_upper_bound,
-        boost::math::tools::eps_tolerance<double>(40));
-    return (result.first + result.second) / 2;
+  return SimulatedData(Kind::BERNOULLI, p, 0, p, p * (1 - p));
+}
+
+CONFSEQ_INLINE SimulatedData SimulatedData::uniform(const double low,
+                                                    const double high) {
+  if (!(low <= high)) {
+    throw std::invalid_argument("low must not exceed high");
   }
+  return SimulatedData(Kind::UNIFORM, low, high, (low + high) / 2,
+                       (high - low) * (high - low) / 12);
 }
 
-inline double TwoSidedNormalMixture::log_superMG(const double s, const double v)
-    const {
-  return (1 / 2.0) * log(rho_ / (v + rho_)) + s * s / (2 * (v + rho_));
+CONFSEQ_INLINE SimulatedData SimulatedData::gaussian(const double mean,
+                                                     const double sd) {
+  if (!(sd >= 0)) {
+    throw std::invalid_argument("sd must be nonnegative");
+  }
+  return SimulatedData(Kind::GAUSSIAN, mean, sd, mean, sd * sd);
 }
 
-inline double TwoSidedNormalMixture::bound(const double v,
-                                           const double log_threshold) const {
-  return sqrt((v + rho_) * (log(1 + v / rho_) + 2 * log_threshold));
+CONFSEQ_INLINE SimulatedData SimulatedData::from_values(const Kind kind,
+                                                        const double* values,
+                                                        const size_t n) {
+  if (n == 0) {
+    throw std::invalid_argument("values must not be empty");
+  }
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += values[i];
+  }
+  const double mean = sum / n;
+  double sum_squares = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum_squares += (values[i] - mean) * (values[i] - mean);
+  }
+  SimulatedData data(kind, 0, 0, mean, sum_squares / n);
+  data.values_ = std::make_shared<const std::vector<double>>(values,
+                                                             values + n);
+  return data;
 }
 
-inline double TwoSidedNormalMixture::best_rho(double v, double alpha) {
-  assert(v > 0);
-  assert(0 < alpha && alpha < 1);
-  return v / (2 * log(1 / alpha) + log(1 + 2 * log(1 / alpha)));
+CONFSEQ_INLINE SimulatedData SimulatedData::resample(const double* values,
+                                                     const size_t n) {
+  return from_values(Kind::RESAMPLE, values, n);
 }
 
-inline double OneSidedNormalMixture::log_superMG(const double s, const double v)
-    const {
-  boost::math::normal_distribution<double> normal;
-  return (1 / 2.0) * log(4 * rho_ / (v + rho_)) + s * s / (2 * (v + rho_))
-      + log(boost::math::cdf(normal, s / sqrt(v + rho_)));
+CONFSEQ_INLINE SimulatedData SimulatedData::permutation(const double* values,
+                                                        const size_t n) {
+  return from_values(Kind::PERMUTATION, values, n);
 }
 
-inline double OneSidedNormalMixture::best_rho(double v, double alpha) {
-  return TwoSidedNormalMixture::best_rho(v, 2 * alpha);
+CONFSEQ_INLINE size_t SimulatedData::max_length() const {
+  return kind_ == Kind::PERMUTATION ? values_->size()
+      : std::numeric_limits<size_t>::max();
 }
 
-inline double GammaExponentialMixture::get_leading_constant(double rho,
-                                                            double c) {
-  const double rho_c_sq = rho / (c * c);
-  return rho_c_sq * log(rho_c_sq)
-      - boost::math::lgamma(rho_c_sq)
-      - log(boost::math::gamma_p(rho_c_sq, rho_c_sq));
+CONFSEQ_INLINE SimulatedStream::SimulatedStream(const SimulatedData& data,
+                                                const uint64_t seed,
+                                                const uint64_t replicate)
+    : data_(data), rng_(seed, replicate) {
+  if (data.kind_ == SimulatedData::Kind::PERMUTATION) {
+    population_ = *data.values_;
+  }
 }
 
-inline double GammaExponentialMixture::log_superMG(const double s,
-                                                   const double v)
-    const {
-  const double c_sq = c_ * c_;
-  const double cs_v_csq = (c_ * s + v) / c_sq;
-  const double v_rho_csq = (v + rho_) / c_sq;
-  return leading_constant_
-      + boost::math::lgamma(v_rho_csq)
-      + log(boost::math::gamma_p(v_rho_csq, cs_v_csq + rho_ / c_sq))
-      - v_rho_csq * log(cs_v_csq + rho_ / c_sq)
-      + cs_v_csq;
+CONFSEQ_INLINE double SimulatedStream::next() {
+  switch (data_.kind_) {
+    case SimulatedData::Kind::BERNOULLI:
+      return rng_.uniform() < data_.a_ ? 1 : 0;
+    case SimulatedData::Kind::UNIFORM:
+      return data_.a_ + (data_.b_ - data_.a_) * rng_.uniform();
+    case SimulatedData::Kind::GAUSSIAN:
+      return data_.a_ + data_.b_ * rng_.normal();
+    case SimulatedData::Kind::RESAMPLE: {
+      const std::vector<double>& values = *data_.values_;
+      return values[std::min(size_t(rng_.uniform() * values.size()),
+                             values.size() - 1)];
+    }
+    case SimulatedData::Kind::PERMUTATION: {
+      // One step of a Fisher-Yates shuffle, so only drawn values are moved.
+      const size_t remaining = population_.size() - drawn_;
+      assert(remaining > 0);
+      const size_t j = drawn_ + std::min(size_t(rng_.uniform() * remaining),
+                                         remaining - 1);
+      std::swap(population_[drawn_], population_[j]);
+      return population_[drawn_++];
+    }
+  }
+  return std::numeric_limits<double>::quiet_NaN();
 }
 
-inline double GammaPoissonMixture::get_leading_constant(double rho, double c) {
-  const double rho_c_sq = rho / (c * c);
-  return rho_c_sq * log(rho_c_sq)
-      - boost::math::lgamma(rho_c_sq)
-      - log(boost::math::gamma_q(rho_c_sq, rho_c_sq));
+CONFSEQ_INLINE CrossingSimulationResult simulate_mixture_crossings(
+    const MixtureSupermartingale& mixture, const SimulatedData& data,
+    const double alpha, const double v_per_observation, const size_t horizon,
+    const size_t replicates, const uint64_t seed, const int num_threads) {
+  const double mean = data.mean();
+  const double log_threshold = log(1 / alpha);
+  return simulate_crossings(data, horizon, replicates, seed, [&]() {
+    return [&mixture, mean, log_threshold, v_per_observation,
+            s = 0.0, t = size_t(0)](const double x) mutable {
+      s += x - mean;
+      t++;
+      return mixture.log_superMG(s, t * v_per_observation) > log_threshold;
+    };
+  }, num_threads);
 }
 
-inline double GammaPoissonMixture::log_superMG(const double s, const double v)
-    const {
-  const double c_sq = c_ * c_;
-  const double v_rho_csq = (v + rho_) / c_sq;
-  const double cs_v_rho_csq = s / c_ + v_rho_csq;
-  return leading_constant_
-      + boost::math::lgamma(cs_v_rho_csq)
-      + log(boost::math::gamma_q(cs_v_rho_csq, v_rho_csq))
-      - cs_v_rho_csq * log(v_rho_csq)
-      + v / c_sq;
+CONFSEQ_INLINE CrossingSimulationResult simulate_boundary_crossings(
+    const std::function<double(double)>& boundary, const SimulatedData& data,
+    const double v_per_observation, const size_t horizon,
+    const size_t replicates, const bool two_sided, const uint64_t seed,
+    const int num_threads) {
+  const size_t length = std::min(horizon, data.max_length());
+  std::vector<double> bounds(length);
+  parallel_for(length, [&](const size_t i) {
+    bounds[i] = boundary((i + 1) * v_per_observation);
+  }, num_threads, 64);
+  const double mean = data.mean();
+  const double* bounds_data = bounds.data();
+  return simulate_crossings(data, horizon, replicates, seed, [&]() {
+    return [bounds_data, mean, two_sided, s = 0.0, t = size_t(0)](
+        const double x) mutable {
+      s += x - mean;
+      return (two_sided ? fabs(s) : s) > bounds_data[t++];
+    };
+  }, num_threads);
 }
 
-inline double log_beta(const double a, const double b) {
-  return boost::math::lgamma(a) + boost::math::lgamma(b)
-      - boost::math::lgamma(a + b);
+// Miscoverage simulation through the accumulators make_accumulator() builds.
+template <class MakeAccumulator>
+CrossingSimulationResult simulate_accumulator_miscoverage(
+    const SimulatedData& data, const size_t horizon, const size_t replicates,
+    const uint64_t seed, const int num_threads,
+    MakeAccumulator make_accumulator) {
+  const double mean = data.mean();
+  return simulate_crossings(data, horizon, replicates, seed, [&]() {
+    return [accumulator = make_accumulator(), mean](const double x) mutable {
+      const std::pair<double, double> interval = accumulator.update(&x, 1);
+      return interval.first > mean || interval.second < mean;
+    };
+  }, num_threads);
 }
 
-inline double log_incomplete_beta(const double a, const double b,
-                                  const double x) {
-  if (x == 1) {
-    return log_beta(a, b);
-  } else {
-    return log(boost::math::ibeta(a, b, x)) + log_beta(a, b);
+CONFSEQ_INLINE CrossingSimulationResult simulate_cs_miscoverage(
+    const StreamCSParams& params, const SimulatedData& data,
+    const size_t horizon, const size_t replicates, const uint64_t seed,
+    const int num_threads) {
+  const double N = data.without_replacement() ? data.max_length() : params.N;
+  const bool needs_population = params.kind == StreamCSKind::PREDMIX_EMPBERN_WOR
+      || params.kind == StreamCSKind::PREDMIX_HOEFFDING_WOR;
+  if (needs_population && !data.without_replacement()) {
+    throw std::invalid_argument(
+        "sampling without replacement needs SimulatedData::permutation()");
+  }
+  switch (params.kind) {
+    case StreamCSKind::PREDMIX_EMPBERN:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return PredmixEmpBernAccumulator(params.alpha, params.truncation,
+                                             params.running_intersection,
+                                             params.fixed_n, params.side);
+          });
+    case StreamCSKind::PREDMIX_HOEFFDING:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return PredmixHoeffdingAccumulator(params.alpha,
+                                               params.running_intersection);
+          });
+    case StreamCSKind::PREDMIX_EMPBERN_WOR:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return PredmixEmpBernWoRAccumulator(
+                N, params.alpha, params.lower_bd, params.upper_bd,
+                params.running_intersection);
+          });
+    case StreamCSKind::PREDMIX_HOEFFDING_WOR:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return PredmixHoeffdingWoRAccumulator(
+                N, params.alpha, params.lower_bd, params.upper_bd,
+                params.running_intersection);
+          });
+    case StreamCSKind::CONJMIX_HOEFFDING:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return ConjmixHoeffdingAccumulator(params.t_opt, params.alpha,
+                                               params.running_intersection);
+          });
+    case StreamCSKind::CONJMIX_EMPBERN:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return ConjmixEmpBernAccumulator(params.v_opt, params.alpha,
+                                             params.running_intersection,
+                                             params.side);
+          });
+    case StreamCSKind::HEDGED:
+      return simulate_accumulator_miscoverage(
+          data, horizon, replicates, seed, num_threads, [&]() {
+            return HedgedConfidenceSequence(
+                params.alpha, N, params.breaks, params.running_intersection,
+                cs_side_theta(params.side, params.theta), params.trunc_scale);
+          });
   }
+  throw std::invalid_argument("unknown confidence sequence kind");
 }
 
-inline double BetaBinomialMixture::log_superMG(const double s, const double v)
-    const {
-  const double x = is_one_sided_ ? h_ / (g_ + h_) : 1;
-  return
-      v / (g_ * h_) * log(g_ + h_)
-      - ((v + h_ * s) / (h_ * (g_ + h_))) * log(g_)
-      - ((v - g_ * s) / (g_ * (g_ + h_))) * log(h_)
-      + log_incomplete_beta((r_ + v - g_ * s) /  (g_ * (g_ + h_)),
-                            (r_ + v + h_ * s) / (h_ * (g_ + h_)),
-                            x)
-      - normalizer_;
+CONFSEQ_INLINE TwoSampleMixture two_sample_mixture(const std::string& name) {
+  if (name == "beta_binomial") {
+    return TwoSampleMixture::BETA_BINOMIAL;
+  } else if (name == "gamma_exponential") {
+    return TwoSampleMixture::GAMMA_EXPONENTIAL;
+  }
+  throw std::invalid_argument("Unknown two-sample mixture: " + name);
 }
 
-inline double BetaBinomialMixture::s_upper_bound(const double v) const {
-  return v / g_;
+CONFSEQ_INLINE const TwoSampleMeanTestParams& TwoSampleMeanTest::validate(
+    const TwoSampleMeanTestParams& params) {
+  if (!(0 < params.alpha && params.alpha < 1)
+      || !(0 < params.alpha_opt && params.alpha_opt < 1)) {
+    throw std::invalid_argument("alpha and alpha_opt must lie in (0, 1)");
+  }
+  if (!(params.t_opt > 0) || !(params.v_opt > 0) || !(params.c > 0)) {
+    throw std::invalid_argument("t_opt, v_opt and c must be positive");
+  }
+  if (params.mixture == TwoSampleMixture::BETA_BINOMIAL) {
+    const double width = params.upper_bd - params.lower_bd;
+    if (!(width > 0)) {
+      throw std::invalid_argument("upper_bd must exceed lower_bd");
+    }
+    if (!(std::abs(params.null_difference) < width)) {
+      throw std::invalid_argument(
+          "null_difference must lie strictly within the outcome range");
+    }
+  }
+  if (!(params.readout_eta == 0 || params.readout_eta > 1)) {
+    throw std::invalid_argument("readout_eta must be 0 or exceed 1");
+  }
+  return params;
 }
 
-inline double PolyStitchingBound::operator()(double v, double alpha) const {
-  double use_v = std::max(v, v_min_);
-  double ell = s_ * log(log(eta_ * use_v / v_min_)) + A_ + log(1 / alpha);
-  double term2 = k2_ * c_ * ell;
-  return sqrt(k1_ * k1_ * use_v * ell + term2 * term2) + term2;
+CONFSEQ_INLINE TwoSampleMeanTest::TwoSampleMeanTest(
+    const TwoSampleMeanTestParams& params)
+    : params_(validate(params)),
+      width_(params.upper_bd - params.lower_bd),
+      null_p_((params.null_difference + width_) / (2 * width_)),
+      bernoulli_cs_(params.alpha, params.t_opt, params.alpha_opt,
+                    params.running_intersection),
+      mixture_(params.v_opt, params.alpha_opt / 2, params.c),
+      log_threshold_(log(2 / params.alpha)) {
+  const double limit = params.mixture == TwoSampleMixture::BETA_BINOMIAL
+      ? width_ : std::numeric_limits<double>::infinity();
+  interval_ = std::make_pair(-limit, limit);
 }
 
-inline double EmpiricalProcessLILBound::operator()(const double t) const {
-  if (t < t_min_) {
-    return std::numeric_limits<double>::infinity();
-  } else {
-    return A_ * sqrt((log(1 + log(t / t_min_)) + C_) / t);
+CONFSEQ_INLINE std::pair<double, double> TwoSampleMeanTest::update(
+    const double* x, const size_t num_control, const double* y,
+    const size_t num_treatment) {
+  if (params_.mixture == TwoSampleMixture::BETA_BINOMIAL) {
+    auto in_range = [this](const double value) {
+      return params_.lower_bd <= value && value <= params_.upper_bd;
+    };
+    if (!std::all_of(x, x + num_control, in_range)
+        || !std::all_of(y, y + num_treatment, in_range)) {
+      throw std::invalid_argument(
+          "Observations must lie in [lower_bd, upper_bd]");
+    }
+  }
+  size_t i = 0, j = 0;
+  while (!backlog_.empty()
+         && (backlog_is_treatment_ ? i < num_control : j < num_treatment)) {
+    add_pair(backlog_is_treatment_ ? backlog_.front() - x[i++]
+                                   : y[j++] - backlog_.front());
+    backlog_.pop_front();
+  }
+  for (; i < num_control && j < num_treatment; i++, j++) {
+    add_pair(y[j] - x[i]);
   }
+  if (i < num_control) {
+    backlog_is_treatment_ = false;
+    backlog_.insert(backlog_.end(), x + i, x + num_control);
+  }
+  if (j < num_treatment) {
+    backlog_is_treatment_ = true;
+    backlog_.insert(backlog_.end(), y + j, y + num_treatment);
+  }
+  return interval_;
 }
 
-inline double EmpiricalProcessLILBound::find_optimal_C(const double alpha,
-                                                const double A) {
-  using namespace std::placeholders;
+CONFSEQ_INLINE void TwoSampleMeanTest::add_pair(const double difference) {
+  if (params_.mixture == TwoSampleMixture::BETA_BINOMIAL) {
+    pending_successes_ += std::min(
+        std::max((difference + width_) / (2 * width_), 0.0), 1.0);
+    pending_trials_++;
+  } else {
+    const double prediction = num_pairs_ == 0 ? 0 : sum_ / num_pairs_;
+    variance_ += (difference - prediction) * (difference - prediction);
+  }
+  num_pairs_++;
+  sum_ += difference;
+  if (params_.readout_eta == 0) {
+    readout();
+  } else if (num_pairs_ >= next_readout_) {
+    readout();
+    while (next_readout_ <= num_pairs_) {
+      readout_scale_ *= params_.readout_eta;
+      next_readout_ = size_t(ceil(readout_scale_));
+    }
+  }
+}
 
-  auto error_bound = [A](const double C, const double eta) {
-    const double gamma_sq = 2 / eta * pow(A - sqrt(2 * (eta - 1) / C), 2);
-    if (gamma_sq <= 1) {
-      return std::numeric_limits<double>::infinity();
+CONFSEQ_INLINE std::pair<double, double> TwoSampleMeanTest::readout() {
+  if (readout_pairs_ == num_pairs_) {
+    return interval_;
+  }
+  double log_mixture, p_value_scale;
+  if (params_.mixture == TwoSampleMixture::BETA_BINOMIAL) {
+    const std::pair<double, double> p_interval =
+        bernoulli_cs_.update(pending_successes_, pending_trials_);
+    pending_successes_ = 0;
+    pending_trials_ = 0;
+    interval_ = std::make_pair(2 * width_ * p_interval.first - width_,
+                               2 * width_ * p_interval.second - width_);
+    log_mixture = BernoulliIntervalObjective(
+        bernoulli_cs_.num_successes(), bernoulli_cs_.num_trials(),
+        params_.t_opt, params_.alpha_opt, 0)(null_p_);
+    p_value_scale = 1;
+  } else {
+    bound_ = readout_pairs_ == 0 ? mixture_.bound(variance_, log_threshold_)
+        : find_next_mixture_bound(mixture_, bound_variance_, bound_,
+                                  variance_, log_threshold_);
+    bound_variance_ = variance_;
+    const double mean = sum_ / num_pairs_;
+    const double radius = bound_ / num_pairs_;
+    if (params_.running_intersection) {
+      interval_ = std::make_pair(
+          nan_propagating_max(interval_.first, mean - radius),
+          nan_propagating_min(interval_.second, mean + radius));
     } else {
-      return 4 * exp(-gamma_sq * C) * (1 + 1 / ((gamma_sq - 1) * log(eta)));
+      interval_ = std::make_pair(mean - radius, mean + radius);
     }
-  };
-
-  auto optimum_error = [A, error_bound](const double C) {
-    auto eta_upper_result = boost::math::tools::bisect(
-        [A, C](const double eta) {
-          return sqrt(eta / 2) + sqrt(2 * (eta - 1) / C) - A;
-        },
-        1.0, 2 * A * A, boost::math::tools::eps_tolerance<double>(40));
-    double eta_upper = (eta_upper_result.first + eta_upper_result.second) / 2;
-    return boost::math::tools::brent_find_minima(std::bind(error_bound, C, _1),
-                                                 1.0, eta_upper, 24);
-  };
+    // Each tail of the two-sided test is a one-sided mixture at alpha / 2.
+    log_mixture = mixture_.log_superMG(
+        std::abs(sum_ - num_pairs_ * params_.null_difference), variance_);
+    p_value_scale = 2;
+  }
+  readout_pairs_ = num_pairs_;
+  p_value_ = std::min(p_value_,
+                      std::min(1.0, p_value_scale * exp(-log_mixture)));
+  return interval_;
+}
 
-  boost::uintmax_t max_iter = 50;
-  auto C_result = boost::math::tools::bracket_and_solve_root(
-      [alpha, optimum_error](const double C) {
-        return optimum_error(C).second - alpha;
-      },
-      5.0,
-      2.0,
-      false,
-      boost::math::tools::eps_tolerance<double>(40),
-      max_iter);
-  return (C_result.first + C_result.second) / 2;
+CONFSEQ_INLINE double TwoSampleMeanTest::estimate() const {
+  return num_pairs_ == 0 ? std::numeric_limits<double>::quiet_NaN()
+      : sum_ / num_pairs_;
 }
 
-inline double logit(const double p) {
-  assert(0 < 1 && p < 1);
-  return log(p / (1 - p));
+CONFSEQ_INLINE void two_sample_mean_tests(
+    const TwoSampleMeanTestParams& params, const double* control,
+    const size_t* control_offsets, const double* treatment,
+    const size_t* treatment_offsets, const size_t num_experiments,
+    double* lower, double* upper, double* p_value, const int num_threads) {
+  const TraceScope trace(
+      TracedFunction::TWO_SAMPLE_MEAN_TESTS,
+      control_offsets[num_experiments] - control_offsets[0]
+          + treatment_offsets[num_experiments] - treatment_offsets[0]);
+  const TwoSampleMeanTest initial(params);
+  parallel_for(num_experiments, [&](const size_t e) {
+    TwoSampleMeanTest test = initial;
+    test.update(control + control_offsets[e],
+                control_offsets[e + 1] - control_offsets[e],
+                treatment + treatment_offsets[e],
+                treatment_offsets[e + 1] - treatment_offsets[e]);
+    std::tie(lower[e], upper[e]) = test.readout();
+    p_value[e] = test.p_value();
+  }, num_threads, 1);
 }
 
-inline double expit(const double l) {
-  return 1 / (1 + exp(-l));
+CONFSEQ_INLINE const AverageTreatmentEffectParams&
+AverageTreatmentEffectCS::validate(const AverageTreatmentEffectParams& params) {
+  if (!(0 < params.alpha && params.alpha < 1)
+      || !(0 < params.alpha_opt && params.alpha_opt < 1)) {
+    throw std::invalid_argument("alpha and alpha_opt must lie in (0, 1)");
+  }
+  if (!(params.v_opt > 0)) {
+    throw std::invalid_argument("v_opt must be positive");
+  }
+  if (!(params.upper_bd > params.lower_bd)) {
+    throw std::invalid_argument("upper_bd must exceed lower_bd");
+  }
+  if (!(0 < params.min_propensity && params.min_propensity <= 0.5)) {
+    throw std::invalid_argument("min_propensity must lie in (0, 0.5]");
+  }
+  if (params.cadence == 0) {
+    throw std::invalid_argument("cadence must be positive");
+  }
+  return params;
 }
 
-inline double DoubleStitchingBound::operator()(const double p, const double t,
-                                        const double alpha) const {
-  const double t_max_m = std::max(t, t_opt_);
-  const double r = p >= 0.5 ? p
-      : std::min(0.5, expit(logit(p) + 2 * delta_ *
-                            sqrt(t_opt_ * eta_ / t_max_m)));
-  const double sigma_sq = r * (1 - r);
-  const double j = sqrt(t_max_m / t_opt_) * abs(logit(p)) / (2 * delta_) + 1;
-  const double zeta_s = boost::math::zeta(s_);
-  const double ell = s_ * log(log(eta_ * t_max_m / t_opt_)) + s_ * log(j)
-       + log(2 * zeta_s * (2 * zeta_s + 1) / (alpha * pow(log(eta_), s_)));
-  const double cp = (1 - 2 * p) / 3;
-  const double term2 = k2_ * cp * ell;
-  return delta_ * sqrt(eta_ * t_max_m * sigma_sq / t_opt_)
-      + sqrt(k1_ * k1_ * sigma_sq * t_max_m * ell + term2 * term2) + term2;
+CONFSEQ_INLINE AverageTreatmentEffectCS::AverageTreatmentEffectCS(
+    const AverageTreatmentEffectParams& params)
+    : params_(validate(params)),
+      mixture_(params.v_opt, params.alpha_opt / 2,
+               2 * (params.upper_bd - params.lower_bd)
+                   / params.min_propensity),
+      log_threshold_(log(2 / params.alpha)),
+      diameter_(params.upper_bd - params.lower_bd) {
+  mixture_.set_precision(params.precision);
 }
 
-inline double QuantileABTest::p_value() const {
-  return std::min(1.0, exp(-log_superMG_lower_bound()));
+CONFSEQ_INLINE size_t AverageTreatmentEffectCS::update(
+    const double* y, const double* treatment, const double* propensity,
+    const size_t n, AverageTreatmentEffectEstimate* out,
+    const double* y1_prediction, const double* y0_prediction) {
+  const TraceScope trace(TracedFunction::AVERAGE_TREATMENT_EFFECT_CS, n);
+  auto in_support = [this](const double value) {
+    return params_.lower_bd <= value && value <= params_.upper_bd;
+  };
+  for (size_t i = 0; i < n; i++) {
+    if (!in_support(y[i])
+        || (y1_prediction != nullptr && !in_support(y1_prediction[i]))
+        || (y0_prediction != nullptr && !in_support(y0_prediction[i]))) {
+      throw std::invalid_argument(
+          "Outcomes and predictions must lie in [lower_bd, upper_bd]");
+    }
+    if (treatment[i] != 0 && treatment[i] != 1) {
+      throw std::invalid_argument("Treatment indicators must be 0 or 1");
+    }
+    if (!(params_.min_propensity <= propensity[i]
+          && propensity[i] <= 1 - params_.min_propensity)) {
+      throw std::invalid_argument(
+          "Propensities must lie in [min_propensity, 1 - min_propensity]");
+    }
+  }
+  const double center = (params_.lower_bd + params_.upper_bd) / 2;
+  size_t rows = 0;
+  for (size_t i = 0; i < n; i++) {
+    const double y1_hat = y1_prediction != nullptr ? y1_prediction[i]
+        : num_treated_ == 0 ? center : treated_sum_ / num_treated_;
+    const double y0_hat = y0_prediction != nullptr ? y0_prediction[i]
+        : num_control_ == 0 ? center : control_sum_ / num_control_;
+    const bool treated = treatment[i] == 1;
+    const double weight = (treatment[i] - propensity[i])
+        / (propensity[i] * (1 - propensity[i]));
+    const double residual = weight * (y[i] - (treated ? y1_hat : y0_hat));
+    sum_ += y1_hat - y0_hat + residual;
+    variance_ += residual * residual;
+    t_++;
+    if (treated) {
+      treated_sum_ += y[i];
+      num_treated_++;
+    } else {
+      control_sum_ += y[i];
+      num_control_++;
+    }
+    if (t_ % params_.cadence == 0) {
+      bound_ = find_next_mixture_bound(mixture_, bound_variance_, bound_,
+                                       variance_, log_threshold_);
+      bound_variance_ = variance_;
+      out[rows++] = row(bound_);
+    }
+  }
+  return rows;
 }
 
-inline double QuantileABTest::log_superMG_lower_bound() const {
-  const GFunction arm_1_G = get_G_fn(1);
-  const GFunction arm_2_G = get_G_fn(2);
-  /* An optimization for another day:
-  const double middle = (empirical_quantile(0) + empirical_quantile(1)) / 2;
-  const double mid_value = arm_1_G.G(middle) + arm_2_G.G(middle);
-  if (mid_value < log_alpha_inv_) {
-    return mid_value;
-  } else */
-  if (arm_1_G.minimum_end_x <= arm_2_G.minimum_end_x) {
-    return find_log_superMG_lower_bound(arm_1_G, arm_2_G, 2);
-  } else {
-    return find_log_superMG_lower_bound(arm_2_G, arm_1_G, 1);
+CONFSEQ_INLINE AverageTreatmentEffectEstimate
+AverageTreatmentEffectCS::estimate() const {
+  if (t_ == 0) {
+    return {0, std::numeric_limits<double>::quiet_NaN(), diameter_,
+            -diameter_, 1};
   }
+  return row(find_next_mixture_bound(mixture_, bound_variance_, bound_,
+                                     variance_, log_threshold_));
 }
 
-inline double QuantileABTest::empirical_quantile(const int arm) const {
-  int position = floor(order_stats(arm)->size() * quantile_p_) + 1;
-  return order_stats(arm)->get_order_statistic(position);
+CONFSEQ_INLINE AverageTreatmentEffectEstimate AverageTreatmentEffectCS::row(
+    const double bound) const {
+  const double mean = sum_ / t_;
+  const double radius = bound / t_;
+  return {t_, mean, nan_propagating_min(diameter_, mean + radius),
+          nan_propagating_max(-diameter_, mean - radius),
+          std::min(1.0, exp(-mixture_.log_superMG(sum_, variance_)))};
 }
 
-inline double QuantileABTest::arm_log_superMG(const int arm,
-                                              const double prop_below)
-    const {
-  int N = order_stats(arm)->size();
-  double s = (prop_below - quantile_p_) * N;
-  double v = quantile_p_ * (1 - quantile_p_) * N;
-  return mixture_->log_superMG(s, v);
-}
-
-inline QuantileABTest::GFunction QuantileABTest::get_G_fn(const int arm) const {
-  auto objective = [this, arm](double a) {return arm_log_superMG(arm, a);};
-  double minimizer = boost::math::tools::brent_find_minima(
-      objective, 0.0, 1.0, 20).first;
-
-  int N = order_stats(arm)->size();
-  double x_lower = order_stats(arm)->get_order_statistic(ceil(minimizer * N));
-  double x_upper =
-      order_stats(arm)->get_order_statistic(floor(minimizer * N) + 1);
-
-  auto G_callable = [this, arm, minimizer, x_lower, x_upper]
-      (const double x) {
-    double prop_below;
-    if (x < x_lower) {
-      prop_below = double(order_stats(arm)->count_less_or_equal(x))
-                   / order_stats(arm)->size();
-    } else if (x > x_upper) {
-      prop_below = double(order_stats(arm)->count_less(x))
-                   / order_stats(arm)->size();
-    } else {
-      prop_below = minimizer;
+// Writes the number of keys, then the keys and states as raw slots, in
+// chunks.
+template <class State>
+void save_keyed_states(const KeyedStateTable<State>& table,
+                       CheckpointWriter& writer) {
+  using Slot = typename KeyedStateTable<State>::Slot;
+  const size_t chunk_size = 4096;
+  std::vector<Slot> chunk;
+  chunk.reserve(chunk_size);
+  writer.put_uint(table.size());
+  table.for_each([&](const uint64_t key, const State& state) {
+    chunk.push_back(Slot{key, state});
+    if (chunk.size() == chunk_size) {
+      writer.put_bytes(chunk.data(), chunk.size() * sizeof(Slot));
+      chunk.clear();
     }
-    return arm_log_superMG(arm, prop_below);
-  };
-  return GFunction{G_callable, x_lower, x_upper};
+  });
+  writer.put_bytes(chunk.data(), chunk.size() * sizeof(Slot));
 }
 
-inline double QuantileABTest::find_log_superMG_lower_bound(
-    const GFunction first_arm_G, const GFunction second_arm_G,
-    const int second_arm) const {
-  assert(first_arm_G.minimum_end_x <= second_arm_G.minimum_end_x);
-  auto objective = [first_arm_G, second_arm_G](double x) {
-    return first_arm_G.G(x) + second_arm_G.G(x);
-  };
-  double min_value = std::min(
-      objective(first_arm_G.minimum_end_x),
-      objective(second_arm_G.minimum_start_x));
-  int start_index = order_stats(second_arm)->count_less_or_equal(
-      first_arm_G.minimum_end_x);
-  int end_index = order_stats(second_arm)->count_less_or_equal(
+// Reads what save_keyed_states() wrote into an empty table, passing each
+// state to check, which returns whether it is valid.
+template <class State, class Check>
+KeyedStateTable<State> load_keyed_states(CheckpointReader& reader,
+                                         Check check) {
+  using Slot = typename KeyedStateTable<State>::Slot;
+  const size_t num_keys = reader.get_uint();
+  // Reserves at most 2^20 keys up front, so that a corrupt count fails as
+  // truncated data rather than allocating.
+  KeyedStateTable<State> table(std::min<size_t>(num_keys, 1 << 20));
+  std::vector<Slot> chunk;
+  for (size_t begin = 0; begin < num_keys; begin += chunk.size()) {
+    chunk.resize(std::min<size_t>(4096, num_keys - begin));
+    reader.get_bytes(chunk.data(), chunk.size() * sizeof(Slot));
+    for (const Slot& slot : chunk) {
+      CheckpointReader::check(check(slot.state));
+      table.find_or_insert(slot.key) = slot.state;
+    }
+    // Repeated keys would have left fewer keys than slots read.
+    CheckpointReader::check(table.size() == begin + chunk.size());
+  }
+  return table;
+}
 
-      second_arm_G.minimum_start_x);
-  assert(start_index <= end_index);
-  assert(end_index >= 1);
+CONFSEQ_INLINE KeyedBernoulliCS::KeyedBernoulliCS(const double alpha,
+                                                  const double t_opt,
+                                                  const double alpha_opt,
+                                                  const int n_max,
+                                                  const size_t capacity)
+    : alpha_(alpha), t_opt_(t_opt), alpha_opt_(alpha_opt),
+      table_(n_max > 0 ? std::make_shared<const BernoulliCSTable>(
+                             n_max, alpha, t_opt, alpha_opt)
+                       : nullptr),
+      states_(capacity) {}
 
-  for (int i = std::max(1, start_index); i <= end_index; i++) {
-    double x = order_stats(second_arm)->get_order_statistic(i);
-    i = order_stats(second_arm)->count_less_or_equal(x);
-    double value = objective(x);
-    if (value < min_value) {
-      min_value = value;
+CONFSEQ_INLINE KeyedBernoulliCS::KeyedBernoulliCS(
+    const BernoulliCSTable& table, const size_t capacity)
+    : alpha_(table.alpha()), t_opt_(table.t_opt()),
+      alpha_opt_(table.alpha_opt()),
+      table_(std::make_shared<const BernoulliCSTable>(table)),
+      states_(capacity) {}
+
+CONFSEQ_INLINE void KeyedBernoulliCS::update(const uint64_t* keys,
+                                             const double* x,
+                                             const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (!(x[i] == 0 || x[i] == 1)) {
+      throw std::invalid_argument("Observations must be 0 or 1");
     }
   }
-  return min_value;
+  for (size_t i = 0; i < n; i++) {
+    KeyedBernoulliState& state = states_.find_or_insert(keys[i]);
+    if (state.num_trials == uint32_t(std::numeric_limits<int>::max())) {
+      throw std::overflow_error("Too many observations for one key");
+    }
+    state.num_trials++;
+    state.num_successes += x[i] == 1;
+  }
 }
 
-inline const std::shared_ptr<OrderStatisticInterface>&
-QuantileABTest::order_stats(
-    const int arm) const {
-  assert(arm == 1 || arm == 2);
-  return arm == 1 ? arm1_os_ : arm2_os_;
+CONFSEQ_INLINE void KeyedBernoulliCS::query(const uint64_t* keys,
+                                            const size_t n, double* lower,
+                                            double* upper,
+                                            const int num_threads) const {
+  parallel_for(n, [&](const size_t i) {
+    std::tie(lower[i], upper[i]) = interval(keys[i]);
+  }, num_threads, 256);
 }
 
-//////////////////////////////////////////////////////////////////////
-// Simplified interface implementation
-//////////////////////////////////////////////////////////////////////
+CONFSEQ_INLINE std::pair<double, double> KeyedBernoulliCS::interval(
+    const uint64_t key) const {
+  const KeyedBernoulliState* state = states_.find(key);
+  return state == nullptr ? std::make_pair(0.0, 1.0) : interval(*state);
+}
 
-inline double normal_log_mixture(
-    const double s, const double v, const double v_opt, const double alpha_opt,
-    const bool is_one_sided) {
-  if (is_one_sided) {
-    OneSidedNormalMixture mixture(v_opt, alpha_opt);
-    return mixture.log_superMG(s, v);
-  } else {
-    TwoSidedNormalMixture mixture(v_opt, alpha_opt);
-    return mixture.log_superMG(s, v);
+CONFSEQ_INLINE std::pair<double, double> KeyedBernoulliCS::interval(
+    const KeyedBernoulliState& state) const {
+  const int num_successes = state.num_successes;
+  const int num_trials = state.num_trials;
+  if (num_trials == 0) {
+    return {0, 1};
   }
+  if (table_ != nullptr && table_->contains(num_successes, num_trials)) {
+    return (*table_)(num_successes, num_trials);
+  }
+  return bernoulli_confidence_interval(num_successes, num_trials, alpha_,
+                                       t_opt_, alpha_opt_);
 }
 
-inline double normal_mixture_bound(
-    const double v, const double alpha, const double v_opt,
-    const double alpha_opt, const bool is_one_sided) {
-  if (is_one_sided) {
-    OneSidedNormalMixture mixture(v_opt, alpha_opt);
-    return mixture.bound(v, log(1 / alpha));
-  } else {
-    TwoSidedNormalMixture mixture(v_opt, alpha_opt);
-    return mixture.bound(v, log(1 / alpha));
-  }
+CONFSEQ_INLINE size_t KeyedBernoulliCS::num_observations(
+    const uint64_t key) const {
+  const KeyedBernoulliState* state = states_.find(key);
+  return state == nullptr ? 0 : state->num_trials;
 }
 
-inline double gamma_exponential_log_mixture(
-    const double s, const double v, const double v_opt,
-    const double c, const double alpha_opt) {
-  GammaExponentialMixture mixture(v_opt, alpha_opt, c);
-  return mixture.log_superMG(s, v);
+CONFSEQ_INLINE void KeyedBernoulliCS::save(std::ostream& out) const {
+  CheckpointWriter writer(out, checkpoint_format::KEYED_BERNOULLI_CS);
+  writer.put_double(alpha_);
+  writer.put_double(t_opt_);
+  writer.put_double(alpha_opt_);
+  writer.put_uint(table_ == nullptr ? 0 : table_->n_max());
+  save_keyed_states(states_, writer);
 }
 
-inline double gamma_exponential_mixture_bound(
-    const double v, const double alpha, const double v_opt,
-    const double c, const double alpha_opt) {
-  GammaExponentialMixture mixture(v_opt, alpha_opt, c);
-  return mixture.bound(v, log(1 / alpha));
+CONFSEQ_INLINE KeyedBernoulliCS KeyedBernoulliCS::load(std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::KEYED_BERNOULLI_CS);
+  const double alpha = reader.get_double();
+  const double t_opt = reader.get_double();
+  const double alpha_opt = reader.get_double();
+  const uint64_t n_max = reader.get_uint();
+  const uint64_t max_trials = std::numeric_limits<int>::max();
+  CheckpointReader::check(0 < alpha && alpha < 1 && t_opt > 0
+                          && 0 < alpha_opt && alpha_opt < 1
+                          && n_max <= max_trials);
+  KeyedStateTable<KeyedBernoulliState> states =
+      load_keyed_states<KeyedBernoulliState>(
+          reader, [](const KeyedBernoulliState& state) {
+            return state.num_successes <= state.num_trials
+                && state.num_trials
+                    <= uint32_t(std::numeric_limits<int>::max());
+          });
+  KeyedBernoulliCS cs(alpha, t_opt, alpha_opt, n_max);
+  cs.states_ = std::move(states);
+  return cs;
 }
 
-inline double gamma_poisson_log_mixture(
-    const double s, const double v, const double v_opt, const double c,
-    const double alpha_opt) {
-  GammaPoissonMixture mixture(v_opt, alpha_opt, c);
-  return mixture.log_superMG(s, v);
+CONFSEQ_INLINE KeyedConjmixEmpBernCS::KeyedConjmixEmpBernCS(
+    const double v_opt, const double alpha, const CSSide side,
+    const double v_max, const size_t num_points, const size_t capacity)
+    : KeyedConjmixEmpBernCS(tabulate(v_opt, alpha, side, v_max, num_points),
+                            side, capacity) {}
+
+CONFSEQ_INLINE KeyedConjmixEmpBernCS::KeyedConjmixEmpBernCS(
+    const TabulatedBoundary& boundary, const CSSide side,
+    const size_t capacity)
+    : boundary_(boundary), side_(side), states_(capacity) {}
+
+CONFSEQ_INLINE TabulatedBoundary KeyedConjmixEmpBernCS::tabulate(
+    const double v_opt, const double alpha, const CSSide side,
+    const double v_max, const size_t num_points) {
+  const double side_alpha = cs_side_alpha(side, alpha);
+  // V_t of observations in [0, 1] grows by at most one per observation, and
+  // below the grid the boundary at its first point is returned, which only
+  // widens the first few intervals.
+  return TabulatedBoundary(GammaExponentialMixture(v_opt, side_alpha, 1),
+                           side_alpha, 1e-2, v_max, num_points);
 }
 
-inline double gamma_poisson_mixture_bound(
-    const double v, const double alpha, const double v_opt, const double c,
-    const double alpha_opt) {
-  GammaPoissonMixture mixture(v_opt, alpha_opt, c);
-  return mixture.bound(v, log(1 / alpha));
+CONFSEQ_INLINE void KeyedConjmixEmpBernCS::update(const uint64_t* keys,
+                                                  const double* x,
+                                                  const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (!(0 <= x[i] && x[i] <= 1)) {
+      throw std::invalid_argument("Observations must be in [0, 1]");
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    // As ConjmixEmpBernAccumulator::update.
+    KeyedConjmixEmpBernState& state = states_.find_or_insert(keys[i]);
+    const double mean = state.num_observations == 0 ? 0.5
+        : state.sum / state.num_observations;
+    state.variance += (x[i] - mean) * (x[i] - mean);
+    state.sum += x[i];
+    state.num_observations++;
+  }
 }
 
-inline double beta_binomial_log_mixture(
-    const double s, const double v, const double v_opt, const double g,
-    const double h, const double alpha_opt,
-    const bool is_one_sided) {
-  BetaBinomialMixture mixture(v_opt, alpha_opt, g, h, is_one_sided);
-  return mixture.log_superMG(s, v);
+CONFSEQ_INLINE void KeyedConjmixEmpBernCS::query(
+    const uint64_t* keys, const size_t n, double* lower, double* upper,
+    const int num_threads) const {
+  parallel_for(n, [&](const size_t i) {
+    std::tie(lower[i], upper[i]) = interval(keys[i]);
+  }, num_threads);
 }
 
-inline double beta_binomial_mixture_bound(
-    const double v, const double alpha, const double v_opt, const double g,
-    const double h, const double alpha_opt,
-    const bool is_one_sided) {
-  BetaBinomialMixture mixture(v_opt, alpha_opt, g, h, is_one_sided);
-  return mixture.bound(v, log(1 / alpha));
+CONFSEQ_INLINE std::pair<double, double> KeyedConjmixEmpBernCS::interval(
+    const uint64_t key) const {
+  const KeyedConjmixEmpBernState* state = states_.find(key);
+  return state == nullptr ? std::make_pair(0.0, 1.0) : interval(*state);
 }
 
-inline double poly_stitching_bound(const double v, const double alpha,
-                            const double v_min, const double c,
-                            const double s, const double eta) {
-  PolyStitchingBound bound(v_min, c, s, eta);
-  return bound(v, alpha);
+CONFSEQ_INLINE std::pair<double, double> KeyedConjmixEmpBernCS::interval(
+    const KeyedConjmixEmpBernState& state) const {
+  const double t = state.num_observations;
+  if (t == 0) {
+    return {0, 1};
+  }
+  const double boundary = boundary_(state.variance) / t;
+  double lower = nan_propagating_max(state.sum / t - boundary, 0);
+  double upper = nan_propagating_min(state.sum / t + boundary, 1);
+  clear_unreported_bound(side_, lower, upper);
+  return {lower, upper};
 }
 
-inline double empirical_process_lil_bound(const int t, const double alpha,
-                                   const double t_min, const double A) {
-  EmpiricalProcessLILBound bound(alpha, t_min, A);
-  return bound(t);
+CONFSEQ_INLINE size_t KeyedConjmixEmpBernCS::num_observations(
+    const uint64_t key) const {
+  const KeyedConjmixEmpBernState* state = states_.find(key);
+  return state == nullptr ? 0 : state->num_observations;
 }
 
-inline double double_stitching_bound(const double quantile_p, const double t,
-                              const double alpha, const double t_opt,
-                              const double delta, const double s,
-                              const double eta) {
-  DoubleStitchingBound bound(t_opt, delta, s, eta);
-  return bound(quantile_p, t, alpha);
+CONFSEQ_INLINE void KeyedConjmixEmpBernCS::save(std::ostream& out) const {
+  CheckpointWriter writer(out, checkpoint_format::KEYED_CONJMIX_EMPBERN);
+  writer.put_uint(uint64_t(side_));
+  save_keyed_states(states_, writer);
+  boundary_.save(out);
 }
 
-inline double pair_average(std::pair<double, double> values) {
-  return (values.first + values.second) / 2;
+CONFSEQ_INLINE KeyedConjmixEmpBernCS KeyedConjmixEmpBernCS::load(
+    std::istream& in) {
+  CheckpointReader reader(in, checkpoint_format::KEYED_CONJMIX_EMPBERN);
+  const CSSide side = read_cs_side(reader);
+  KeyedStateTable<KeyedConjmixEmpBernState> states =
+      load_keyed_states<KeyedConjmixEmpBernState>(
+          reader, [](const KeyedConjmixEmpBernState& state) {
+            return state.variance >= 0 && 0 <= state.sum
+                && state.sum <= state.num_observations;
+          });
+  KeyedConjmixEmpBernCS cs(TabulatedBoundary::load(in), side);
+  cs.states_ = std::move(states);
+  return cs;
 }
 
-inline std::pair<double, double> bernoulli_confidence_interval(
-    const double num_successes, const int num_trials, const double alpha,
-    const double t_opt, const double alpha_opt) {
-  using namespace std::placeholders;
-  const double threshold = log(1 / alpha);
-  const double empirical_p = 1.0 * num_successes / num_trials;
+CONFSEQ_INLINE RollupCSKind rollup_cs_kind(const std::string& name) {
+  if (name == "bernoulli") {
+    return RollupCSKind::BERNOULLI;
+  } else if (name == "conjmix_hoeffding") {
+    return RollupCSKind::CONJMIX_HOEFFDING;
+  } else if (name == "predmix_empbern") {
+    return RollupCSKind::PREDMIX_EMPBERN;
+  }
+  throw std::invalid_argument("Unknown rollup confidence sequence: " + name);
+}
 
-  auto objective = [empirical_p, num_trials, t_opt, alpha_opt, threshold]
-                   (const double p, const double zero_value,
-                    const double one_value) {
-    if (p <= 0) {
-      return zero_value;
-    } else if (p >= 1) {
-      return one_value;
+CONFSEQ_INLINE RollupConfidenceSequences::RollupConfidenceSequences(
+    const RollupCSParams& params, std::vector<int64_t> grains)
+    : params_(params), grains_(std::move(grains)),
+      hoeffding_(params.t_opt, params.alpha) {
+  if (grains_.empty()) {
+    throw std::invalid_argument("Rollups need at least one grain");
+  }
+  for (size_t level = 0; level < grains_.size(); level++) {
+    if (grains_[level] <= 0
+        || (level > 0 && grains_[level] % grains_[level - 1] != 0)) {
+      throw std::invalid_argument(
+          "Grains must be positive, each a multiple of the one before");
+    }
+  }
+  buckets_.resize(grains_.size());
+  if (params_.kind == RollupCSKind::PREDMIX_EMPBERN) {
+    accumulators_.assign(grains_.size(), PredmixEmpBernAccumulator(
+        params_.alpha, params_.truncation, false, params_.fixed_n));
+  }
+}
+
+CONFSEQ_INLINE int64_t RollupConfidenceSequences::bucket_start(
+    const int64_t timestamp, const int64_t grain) {
+  // Rounds down, also for negative timestamps.
+  const int64_t remainder = timestamp % grain;
+  return timestamp - (remainder < 0 ? remainder + grain : remainder);
+}
+
+CONFSEQ_INLINE size_t RollupConfidenceSequences::update(
+    const int64_t* timestamps, const double* x, const size_t n,
+    std::vector<RollupReadout>& out) {
+  for (size_t i = 0; i < n; i++) {
+    const int64_t previous = i > 0 ? timestamps[i - 1] : last_timestamp_;
+    if ((i > 0 || has_timestamp_) && timestamps[i] < previous) {
+      throw std::invalid_argument("Timestamps must not decrease");
+    }
+    if (params_.kind == RollupCSKind::BERNOULLI ? x[i] != 0 && x[i] != 1
+                                                : !(0 <= x[i] && x[i] <= 1)) {
+      throw std::invalid_argument(
+          params_.kind == RollupCSKind::BERNOULLI
+              ? "Bernoulli observations must be 0 or 1"
+              : "Observations must lie in [0, 1]");
+    }
+  }
+  const size_t size = out.size();
+  const size_t num_levels = grains_.size();
+  for (size_t i = 0; i < n; i++) {
+    // Buckets nest, so the first open bucket still holding the timestamp
+    // holds it at every coarser grain too.
+    for (size_t level = 0; level < num_levels && buckets_[level].open
+             && buckets_[level].start
+                 != bucket_start(timestamps[i], grains_[level]);
+         level++) {
+      close(level, out);
+    }
+    for (size_t level = 0; level < num_levels; level++) {
+      if (!buckets_[level].open) {
+        buckets_[level].open = true;
+        buckets_[level].start = bucket_start(timestamps[i], grains_[level]);
+      }
+    }
+    if (params_.kind == RollupCSKind::PREDMIX_EMPBERN) {
+      for (size_t level = 0; level < num_levels; level++) {
+        accumulators_[level].update(x + i, 1);
+        buckets_[level].num_observations++;
+        buckets_[level].sum += x[i];
+      }
     } else {
-      const BetaBinomialMixture mixture(p * (1 - p) * t_opt, alpha_opt,
-                                        p, 1 - p, false);
-      const double log_superMG = mixture.log_superMG(
-          (empirical_p - p) * num_trials, p * (1 - p) * num_trials);
-      return log_superMG - threshold;
+      buckets_[0].num_observations++;
+      buckets_[0].sum += x[i];
     }
-  };
+  }
+  if (n > 0) {
+    has_timestamp_ = true;
+    last_timestamp_ = timestamps[n - 1];
+  }
+  return out.size() - size;
+}
 
-  boost::math::tools::eps_tolerance<double> tolerance(40);
-  double lower_bound = 0.0;
-  if (empirical_p > 0) {
-    auto lower_bound_pair = boost::math::tools::bisect(
-        std::bind(objective, _1, 1.0, -1.0), 0.0, empirical_p, tolerance);
-    lower_bound = pair_average(lower_bound_pair);
+CONFSEQ_INLINE size_t RollupConfidenceSequences::flush(
+    std::vector<RollupReadout>& out) {
+  const size_t size = out.size();
+  for (size_t level = 0; level < grains_.size(); level++) {
+    if (buckets_[level].open) {
+      close(level, out);
+    }
   }
-  double upper_bound = 1.0;
-  if (empirical_p < 1) {
-    auto upper_bound_pair = boost::math::tools::bisect(
-        std::bind(objective, _1, -1.0, 1.0), empirical_p, 1.0, tolerance);
-    upper_bound = pair_average(upper_bound_pair);
+  return out.size() - size;
+}
+
+CONFSEQ_INLINE void RollupConfidenceSequences::close(
+    const size_t level, std::vector<RollupReadout>& out) {
+  Bucket& bucket = buckets_[level];
+  const std::pair<double, double> bounds = interval(level);
+  out.push_back({grains_[level], bucket.start, bucket.num_observations,
+                 bucket.sum / bucket.num_observations, bounds.first,
+                 bounds.second});
+  if (params_.kind == RollupCSKind::PREDMIX_EMPBERN) {
+    accumulators_[level] = PredmixEmpBernAccumulator(
+        params_.alpha, params_.truncation, false, params_.fixed_n);
+  } else if (level + 1 < grains_.size()) {
+    buckets_[level + 1].num_observations += bucket.num_observations;
+    buckets_[level + 1].sum += bucket.sum;
   }
-  return std::make_pair(lower_bound, upper_bound);
+  bucket = Bucket();
+}
+
+CONFSEQ_INLINE std::pair<double, double> RollupConfidenceSequences::interval(
+    const size_t level) {
+  // Bounds the memoized boundaries; counts recur mostly among buckets
+  // closing together, so clearing loses little.
+  const size_t max_memoized = size_t(1) << 16;
+  const Bucket& bucket = buckets_[level];
+  switch (params_.kind) {
+    case RollupCSKind::BERNOULLI: {
+      assert(bucket.num_observations
+             <= size_t(std::numeric_limits<int>::max()));
+      const std::pair<size_t, size_t> key(size_t(bucket.sum),
+                                          bucket.num_observations);
+      auto it = bernoulli_intervals_.find(key);
+      if (it == bernoulli_intervals_.end()) {
+        if (bernoulli_intervals_.size() >= max_memoized) {
+          bernoulli_intervals_.clear();
+        }
+        num_boundary_evaluations_++;
+        it = bernoulli_intervals_.emplace(key, bernoulli_confidence_interval(
+            bucket.sum, int(bucket.num_observations), params_.alpha,
+            params_.t_opt, params_.alpha_opt)).first;
+      }
+      return it->second;
+    }
+    case RollupCSKind::CONJMIX_HOEFFDING: {
+      const size_t t = bucket.num_observations;
+      auto it = hoeffding_boundaries_.find(t);
+      if (it == hoeffding_boundaries_.end()) {
+        if (hoeffding_boundaries_.size() >= max_memoized) {
+          hoeffding_boundaries_.clear();
+        }
+        num_boundary_evaluations_++;
+        it = hoeffding_boundaries_.emplace(t, hoeffding_.boundary(t)).first;
+      }
+      const double mean = bucket.sum / t;
+      return {nan_propagating_max(mean - it->second, 0),
+              nan_propagating_min(mean + it->second, 1)};
+    }
+    case RollupCSKind::PREDMIX_EMPBERN:
+      break;
+  }
+  num_boundary_evaluations_++;
+  return accumulators_[level].interval();
 }
+#endif // CONFSEQ_DEFINE_IMPLEMENTATIONS
 
 }; // namespace confseq
 
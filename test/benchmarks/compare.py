@@ -0,0 +1,99 @@
+"""
+Compare a Google Benchmark JSON run against a baseline.
+
+    python3 compare.py baseline.json benchmark_results.json [--threshold 0.25]
+
+Benchmarks are matched by name (mean aggregates are used when the run has
+repetitions). Exits with status 1 if any benchmark's time grew by more than
+the threshold fraction relative to the baseline. Runs of python_benchmarks.py
+also record memory, which --metric peak_rss_growth_bytes or
+peak_traced_bytes compares instead.
+"""
+
+import argparse
+import json
+import sys
+
+TIME_UNITS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+def load_times(path, metric):
+    with open(path) as f:
+        benchmarks = json.load(f)["benchmarks"]
+    times = {}
+    for benchmark in benchmarks:
+        if benchmark.get("run_type") == "aggregate":
+            if benchmark.get("aggregate_name") != "mean":
+                continue
+            name = benchmark["run_name"]
+        elif benchmark.get("repetitions", 1) > 1:
+            continue
+        else:
+            name = benchmark["name"]
+        if metric.endswith("_bytes"):
+            times[name] = benchmark[metric]
+        else:
+            unit = TIME_UNITS[benchmark.get("time_unit", "ns")]
+            times[name] = benchmark[metric] * unit
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.25,
+        help="largest tolerated fractional slowdown (default 0.25)",
+    )
+    parser.add_argument(
+        "--metric",
+        choices=["real_time", "cpu_time", "peak_rss_growth_bytes", "peak_traced_bytes"],
+        default="cpu_time",
+    )
+    args = parser.parse_args()
+
+    baseline = load_times(args.baseline, args.metric)
+    contender = load_times(args.contender, args.metric)
+    regressions = []
+    print("%-56s %12s %12s %8s" % ("benchmark", "baseline", "contender", "ratio"))
+    if args.metric.endswith("_bytes"):
+        scale, unit = 1e-6, "MB"
+    else:
+        scale, unit = 1e6, "us"
+    for name in sorted(baseline.keys() & contender.keys()):
+        ratio = contender[name] / baseline[name] if baseline[name] else 1.0
+        flag = ""
+        if ratio > 1 + args.threshold:
+            regressions.append(name)
+            flag = "  REGRESSION"
+        print(
+            "%-56s %10.3g%s %10.3g%s %8.3f%s"
+            % (
+                name,
+                scale * baseline[name],
+                unit,
+                scale * contender[name],
+                unit,
+                ratio,
+                flag,
+            )
+        )
+    for name in sorted(baseline.keys() - contender.keys()):
+        print("%-56s missing from %s" % (name, args.contender))
+    for name in sorted(contender.keys() - baseline.keys()):
+        print("%-56s not in baseline" % name)
+
+    if regressions:
+        print(
+            "%d benchmark(s) regressed by more than %g%%"
+            % (len(regressions), 100 * args.threshold)
+        )
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
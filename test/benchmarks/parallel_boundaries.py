@@ -0,0 +1,53 @@
+"""Compare single- and multi-threaded boundary evaluation.
+
+Run with `python test/benchmarks/parallel_boundaries.py` after installing the
+package.
+"""
+from timeit import timeit
+
+import numpy as np
+
+from confseq import boundaries, quantiles
+
+N = 10 ** 5
+REPEATS = 3
+
+v = np.linspace(1, 10 ** 5, N)
+p = np.linspace(0.001, 0.999, N)
+
+CASES = [
+    (boundaries, "normal_mixture_bound", lambda: boundaries.normal_mixture_bound(v, 0.05, 100)),
+    (
+        boundaries,
+        "gamma_exponential_mixture_bound",
+        lambda: boundaries.gamma_exponential_mixture_bound(v, 0.05, 100, 1),
+    ),
+    (
+        boundaries,
+        "beta_binomial_mixture_bound",
+        lambda: boundaries.beta_binomial_mixture_bound(v, 0.05, 100, 0.5, 0.5),
+    ),
+    (
+        quantiles,
+        "double_stitching_bound",
+        lambda: quantiles.double_stitching_bound(p, 10 ** 4, 0.05, 100),
+    ),
+]
+
+
+def main():
+    for module, name, fn in CASES:
+        default_threads = module.get_num_threads()
+        module.set_num_threads(1)
+        serial = timeit(fn, number=REPEATS) / REPEATS
+        module.set_num_threads(default_threads)
+        threaded = timeit(fn, number=REPEATS) / REPEATS
+        print(
+            "{:35s} 1 thread: {:8.3f}s  {} threads: {:8.3f}s  speedup {:5.1f}x".format(
+                name, serial, default_threads, threaded, serial / threaded
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,161 @@
+"""
+Time the Python-facing confidence sequence functions across sample sizes.
+
+    python3 python_benchmarks.py [--sizes 1000 100000 10000000] [--out FILE]
+
+Each case runs in a forked child process, which reports its wall and CPU time
+per call, the peak of NumPy and Python allocations traced by tracemalloc, and
+the growth of its peak resident set size, which also covers native buffers.
+Results are written in the Google Benchmark JSON layout, so that
+
+    python3 compare.py baseline.json python_benchmark_results.json
+
+flags slowdowns as it does for the C++ suite. Cases whose cost grows with the
+betting grid are capped at --max-grid-n observations, since at n = 1e7 they
+would run for hours; pass --max-grid-n 0 to lift the cap.
+"""
+
+import argparse
+import json
+import multiprocessing
+import platform
+import resource
+import sys
+import time
+import tracemalloc
+from datetime import datetime, timezone
+
+import numpy as np
+
+from confseq.betting import betting_ci_seq, betting_cs, dKelly_cs, hedged_cs
+from confseq.conjmix_bounded import conjmix_empbern_cs
+from confseq.predmix import predmix_empbern_cs, predmix_empbern_cs_wor
+from confseq.quantiles import quantile_ab_p_value
+
+DEFAULT_SIZES = [10 ** 3, 10 ** 5, 10 ** 7]
+
+
+def observations(n):
+    return np.random.default_rng(n).beta(2, 5, n)
+
+
+# (name, runs over the betting grid, function of the observations)
+CASES = [
+    ("betting_cs", True, lambda x: betting_cs(x, breaks=1000)),
+    ("hedged_cs", True, lambda x: hedged_cs(x, breaks=1000)),
+    ("dKelly_cs", True, lambda x: dKelly_cs(x, breaks=1000)),
+    (
+        "betting_ci_seq",
+        True,
+        lambda x: betting_ci_seq(x, 0.05, [len(x) // 10, len(x)], breaks=1000),
+    ),
+    ("predmix_empbern_cs", False, lambda x: predmix_empbern_cs(x)),
+    (
+        "predmix_empbern_cs_wor",
+        False,
+        lambda x: predmix_empbern_cs_wor(x, N=2 * len(x)),
+    ),
+    ("conjmix_empbern_cs", False, lambda x: conjmix_empbern_cs(x, v_opt=100)),
+    (
+        "quantile_ab_p_value",
+        False,
+        lambda x: quantile_ab_p_value(x, x[::-1] + 0.01, 0.5, 100),
+    ),
+]
+
+
+def peak_rss_bytes():
+    # ru_maxrss is in kilobytes on Linux and bytes on macOS.
+    scale = 1 if sys.platform == "darwin" else 1024
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss * scale
+
+
+def run_case(fn, n, repetitions, results):
+    x = observations(n)
+    fn(x[: min(n, 100)])  # Imports and first-call setup.
+    rss_before = peak_rss_bytes()
+    tracemalloc.start()
+    wall = time.perf_counter()
+    cpu = time.process_time()
+    for _ in range(repetitions):
+        fn(x)
+    cpu = (time.process_time() - cpu) / repetitions
+    wall = (time.perf_counter() - wall) / repetitions
+    _, traced_peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    results.put((wall, cpu, traced_peak, peak_rss_bytes() - rss_before))
+
+
+def measure(fn, n, repetitions):
+    results = multiprocessing.get_context("fork").Queue()
+    child = multiprocessing.get_context("fork").Process(
+        target=run_case, args=(fn, n, repetitions, results)
+    )
+    child.start()
+    child.join()
+    if child.exitcode != 0:
+        raise RuntimeError("benchmark process exited with %d" % child.exitcode)
+    return results.get(timeout=10)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--sizes", type=int, nargs="+", default=DEFAULT_SIZES)
+    parser.add_argument(
+        "--max-grid-n",
+        type=int,
+        default=10 ** 5,
+        help="largest n for betting-grid cases, or 0 for no limit",
+    )
+    parser.add_argument("--repetitions", type=int, default=1)
+    parser.add_argument(
+        "--filter", default="", help="run only cases whose name contains this"
+    )
+    parser.add_argument("--out", default="python_benchmark_results.json")
+    args = parser.parse_args()
+
+    benchmarks = []
+    print(
+        "%-36s %12s %12s %14s %14s"
+        % ("benchmark", "wall", "cpu", "traced peak", "rss growth")
+    )
+    for name, uses_grid, fn in CASES:
+        if args.filter not in name:
+            continue
+        for n in args.sizes:
+            if uses_grid and 0 < args.max_grid_n < n:
+                continue
+            wall, cpu, traced_peak, rss_growth = measure(fn, n, args.repetitions)
+            run_name = "%s/%d" % (name, n)
+            print(
+                "%-36s %10.4gs %10.4gs %12.4gMB %12.4gMB"
+                % (run_name, wall, cpu, traced_peak / 1e6, rss_growth / 1e6)
+            )
+            benchmarks.append(
+                {
+                    "name": run_name,
+                    "run_name": run_name,
+                    "run_type": "iteration",
+                    "repetitions": 1,
+                    "iterations": args.repetitions,
+                    "real_time": wall,
+                    "cpu_time": cpu,
+                    "time_unit": "s",
+                    "peak_traced_bytes": traced_peak,
+                    "peak_rss_growth_bytes": rss_growth,
+                }
+            )
+    context = {
+        "date": datetime.now(timezone.utc).isoformat(timespec="seconds"),
+        "host_name": platform.node(),
+        "executable": "python_benchmarks.py",
+        "python_version": platform.python_version(),
+        "numpy_version": np.__version__,
+    }
+    with open(args.out, "w") as f:
+        json.dump({"context": context, "benchmarks": benchmarks}, f, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,459 @@
+// Google Benchmark suite for the hot paths of uniform_boundaries.h. Build with
+// `make benchmarks` in test/ or the CONFSEQ_BUILD_BENCHMARKS CMake option, and
+// compare runs against baseline.json with compare.py.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "uniform_boundaries.h"
+
+namespace {
+
+// Args are {log10(v), -log10(alpha)}.
+void mixture_regimes(benchmark::internal::Benchmark* benchmark) {
+  for (const int log_v : {1, 3, 6}) {
+    for (const int log_alpha : {2, 6}) {
+      benchmark->Args({log_v, log_alpha});
+    }
+  }
+}
+
+template <class Mixture>
+void BM_MixtureBound(benchmark::State& state, const Mixture& mixture) {
+  const double v = pow(10, state.range(0));
+  const double log_threshold = state.range(1) * log(10);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        confseq::find_mixture_bound(mixture, v, log_threshold));
+  }
+}
+
+void BM_TwoSidedNormalMixtureBound(benchmark::State& state) {
+  BM_MixtureBound(state, confseq::TwoSidedNormalMixture(100, 0.05));
+}
+BENCHMARK(BM_TwoSidedNormalMixtureBound)->Apply(mixture_regimes);
+
+void BM_OneSidedNormalMixtureBound(benchmark::State& state) {
+  BM_MixtureBound(state, confseq::OneSidedNormalMixture(100, 0.05));
+}
+BENCHMARK(BM_OneSidedNormalMixtureBound)->Apply(mixture_regimes);
+
+void BM_GammaExponentialMixtureBound(benchmark::State& state) {
+  BM_MixtureBound(state, confseq::GammaExponentialMixture(100, 0.05, 2));
+}
+BENCHMARK(BM_GammaExponentialMixtureBound)->Apply(mixture_regimes);
+
+void BM_GammaPoissonMixtureBound(benchmark::State& state) {
+  BM_MixtureBound(state, confseq::GammaPoissonMixture(100, 0.05, 2));
+}
+BENCHMARK(BM_GammaPoissonMixtureBound)->Apply(mixture_regimes);
+
+void BM_BetaBinomialMixtureBound(benchmark::State& state) {
+  BM_MixtureBound(state,
+                  confseq::BetaBinomialMixture(100, 0.05, 0.2, 0.8, false));
+}
+BENCHMARK(BM_BetaBinomialMixtureBound)->Apply(mixture_regimes);
+
+void BM_TwoSidedBetaBinomialMixtureBound(benchmark::State& state) {
+  BM_MixtureBound(state,
+                  confseq::TwoSidedBetaBinomialMixture(100, 0.05, 0.2, 0.8));
+}
+BENCHMARK(BM_TwoSidedBetaBinomialMixtureBound)->Apply(mixture_regimes);
+
+// log_superMG at 4096 points per iteration through a MixtureSupermartingale,
+// as the bindings call it: one virtual call to the batch kernel (argument 1)
+// or one per point (0).
+template <class Mixture>
+void BM_LogSuperMGBatch(benchmark::State& state, const Mixture& mixture) {
+  const size_t n = 4096;
+  std::vector<double> s(n), v(n), out(n);
+  for (size_t i = 0; i < n; i++) {
+    v[i] = 1 + i;
+    s[i] = (i % 7 - 3.0) * sqrt(v[i]);
+  }
+  const confseq::MixtureSupermartingale* base = &mixture;
+  benchmark::DoNotOptimize(base);
+  for (auto _ : state) {
+    if (state.range(0)) {
+      base->log_superMG(s.data(), v.data(), n, out.data());
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        out[i] = base->log_superMG(s[i], v[i]);
+      }
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+void BM_TwoSidedNormalLogSuperMGBatch(benchmark::State& state) {
+  BM_LogSuperMGBatch(state, confseq::TwoSidedNormalMixture(100, 0.05));
+}
+BENCHMARK(BM_TwoSidedNormalLogSuperMGBatch)->Arg(0)->Arg(1);
+
+void BM_OneSidedNormalLogSuperMGBatch(benchmark::State& state) {
+  BM_LogSuperMGBatch(state, confseq::OneSidedNormalMixture(100, 0.05));
+}
+BENCHMARK(BM_OneSidedNormalLogSuperMGBatch)->Arg(0)->Arg(1);
+
+// At each vector width, from the scalar loop at 1, over both tails.
+void BM_LogNormalCdfBatch(benchmark::State& state) {
+  const int width = state.range(0);
+  if (width > confseq::vector_width()) {
+    state.SkipWithError("vector width not supported by this CPU");
+    return;
+  }
+  const size_t n = 4096;
+  std::vector<double> z(n), out(n);
+  for (size_t i = 0; i < n; i++) {
+    z[i] = (i % 41 - 30.0) / 2;
+  }
+  for (auto _ : state) {
+    confseq::vector_kernels::log_normal_cdf(width, z.data(), n, out.data());
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_LogNormalCdfBatch)->Arg(1)->Arg(4)->Arg(8);
+
+void BM_BernoulliConfidenceInterval(benchmark::State& state) {
+  const int n = state.range(0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        confseq::bernoulli_confidence_interval(n / 3.0, n, 0.05, 1000));
+  }
+}
+BENCHMARK(BM_BernoulliConfidenceInterval)->RangeMultiplier(100)
+    ->Range(100, 1000000);
+
+void BM_QuantileABTestPValue(benchmark::State& state) {
+  const size_t n = state.range(0);
+  std::vector<double> arm1(n), arm2(n);
+  for (size_t i = 0; i < n; i++) {
+    arm1[i] = i;
+    arm2[i] = i + 0.01 * n;
+  }
+  const auto arms = confseq::two_arm_order_statistics(
+      arm1.data(), arm1.data() + n, arm2.data(), arm2.data() + n, true);
+  const confseq::QuantileABTest test(0.5, 1000, 0.05, arms[0], arms[1]);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(test.p_value());
+  }
+}
+BENCHMARK(BM_QuantileABTestPValue)->RangeMultiplier(10)
+    ->Range(1000, 1000000);
+
+// Random count_less queries on range(0) sorted values, through the
+// StaticOrderStatistics search index (argument 1) or std::lower_bound on the
+// sorted array (0).
+void BM_StaticOrderStatisticsCountLess(benchmark::State& state) {
+  const size_t n = state.range(0);
+  std::vector<double> values(n);
+  for (size_t i = 0; i < n; i++) {
+    values[i] = i;
+  }
+  const confseq::StaticOrderStatistics order_stats(values.begin(),
+                                                   values.end());
+  const double* sorted = order_stats.sorted_values();
+  std::vector<double> queries(1 << 16);
+  uint64_t state_bits = 1;
+  for (double& query : queries) {
+    state_bits = state_bits * 6364136223846793005ULL + 1442695040888963407ULL;
+    query = (state_bits >> 11) % n + 0.5;
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    const double query = queries[i++ & (queries.size() - 1)];
+    if (state.range(1)) {
+      benchmark::DoNotOptimize(order_stats.count_less(query));
+    } else {
+      benchmark::DoNotOptimize(std::lower_bound(sorted, sorted + n, query));
+    }
+  }
+}
+BENCHMARK(BM_StaticOrderStatisticsCountLess)
+    ->Args({1000, 0})->Args({1000, 1})
+    ->Args({10000000, 0})->Args({10000000, 1});
+
+// One p-value refresh per iteration, constructing the test each time, with a
+// shared QuantileABTestConfig (argument 1) or a config of its own (0).
+void BM_QuantileABTestRefresh(benchmark::State& state) {
+  const size_t n = 1000;
+  std::vector<double> arm1(n), arm2(n);
+  for (size_t i = 0; i < n; i++) {
+    arm1[i] = i;
+    arm2[i] = i + 0.01 * n;
+  }
+  const auto arms = confseq::two_arm_order_statistics(
+      arm1.data(), arm1.data() + n, arm2.data(), arm2.data() + n, true);
+  const auto config =
+      std::make_shared<const confseq::QuantileABTestConfig>(0.5, 1000, 0.05);
+  for (auto _ : state) {
+    if (state.range(0)) {
+      const confseq::QuantileABTest test(config, arms[0], arms[1]);
+      benchmark::DoNotOptimize(test.p_value());
+    } else {
+      const confseq::QuantileABTest test(0.5, 1000, 0.05, arms[0], arms[1]);
+      benchmark::DoNotOptimize(test.p_value());
+    }
+  }
+}
+BENCHMARK(BM_QuantileABTestRefresh)->Arg(0)->Arg(1);
+
+// Construction solves for the optimal C, which is memoized per alpha, so alpha
+// cycles through more values than the memo holds.
+void BM_EmpiricalProcessLILBoundConstruction(benchmark::State& state) {
+  size_t i = 0;
+  for (auto _ : state) {
+    const double alpha = 0.01 + 1e-7 * (i++ % 100000);
+    confseq::EmpiricalProcessLILBound bound(alpha, 100, 0.85);
+    benchmark::DoNotOptimize(bound(1000));
+  }
+}
+BENCHMARK(BM_EmpiricalProcessLILBoundConstruction);
+
+void BM_DoubleStitchingBound(benchmark::State& state) {
+  const confseq::DoubleStitchingBound bound(100, 0.5, 1.4, 2);
+  const double t = pow(10, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bound(0.5, t, 0.05));
+  }
+}
+BENCHMARK(BM_DoubleStitchingBound)->DenseRange(2, 6, 2);
+
+void BM_DoubleStitchingBand(benchmark::State& state) {
+  const confseq::DoubleStitchingBound bound(100, 0.5, 1.4, 2);
+  std::vector<double> p(state.range(0)), out(p.size());
+  for (size_t i = 0; i < p.size(); i++) {
+    p[i] = (i + 0.5) / p.size();
+  }
+  for (auto _ : state) {
+    bound.band(p.data(), p.size(), 1e4, 0.05, out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * p.size());
+}
+BENCHMARK(BM_DoubleStitchingBand)->Arg(1000);
+
+// A 100-time by 100-quantile heatmap of a 10^5-value stream, sorting each
+// prefix for quantile_band (state.range(0) = 0) or by quantile_band_matrix
+// (1).
+void BM_DoubleStitchingQuantileBandMatrix(benchmark::State& state) {
+  const confseq::DoubleStitchingBound bound(100, 0.5, 1.4, 2);
+  const size_t n = 100000, num_times = 100, num_p = 100;
+  std::vector<double> x(n), p(num_p);
+  confseq::CounterRng rng(17, 0);
+  for (double& value : x) {
+    value = rng.uniform();
+  }
+  for (size_t j = 0; j < num_p; j++) {
+    p[j] = (j + 0.5) / num_p;
+  }
+  std::vector<size_t> times(num_times);
+  for (size_t i = 0; i < num_times; i++) {
+    times[i] = (i + 1) * n / num_times;
+  }
+  std::vector<double> lower(num_times * num_p), upper(lower.size());
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      for (size_t i = 0; i < num_times; i++) {
+        const confseq::StaticOrderStatistics order_stats(
+            x.begin(), x.begin() + times[i], 1);
+        bound.quantile_band(order_stats, p.data(), num_p, 0.05,
+                            lower.data() + i * num_p,
+                            upper.data() + i * num_p);
+      }
+    } else {
+      bound.quantile_band_matrix(x.data(), times.data(), num_times,
+                                 p.data(), num_p, 0.05, lower.data(),
+                                 upper.data(), 1);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * lower.size());
+}
+BENCHMARK(BM_DoubleStitchingQuantileBandMatrix)->Arg(0)->Arg(1);
+
+// Thread scaling of the multi-stream and grid engines, with the shared pool
+// resized to the thread count under test. On NUMA hosts, compare runs with
+// CONFSEQ_NUMA=0 to see the effect of node-local pinning and task ranges.
+void thread_counts(benchmark::internal::Benchmark* benchmark) {
+  benchmark->RangeMultiplier(2)->Range(1, 128)->UseRealTime();
+}
+
+class PoolSize {
+ public:
+  explicit PoolSize(const int num_threads) {
+    confseq::set_num_threads(num_threads);
+  }
+  ~PoolSize() {
+    confseq::set_num_threads(
+        std::max(1u, std::thread::hardware_concurrency()));
+  }
+};
+
+void BM_BatchHedgedCSScaling(benchmark::State& state) {
+  const PoolSize pool(state.range(0));
+  const size_t num_streams = 256, stream_length = 1000;
+  std::vector<double> values(num_streams * stream_length);
+  std::vector<size_t> offsets(num_streams + 1);
+  confseq::CounterRng rng(7, 0);
+  for (double& value : values) {
+    value = rng.uniform();
+  }
+  for (size_t s = 0; s <= num_streams; s++) {
+    offsets[s] = s * stream_length;
+  }
+  confseq::StreamCSParams params;
+  params.kind = confseq::StreamCSKind::HEDGED;
+  params.breaks = 100;
+  std::vector<double> lower(values.size()), upper(values.size());
+  for (auto _ : state) {
+    confseq::batch_confidence_sequences(values.data(), offsets.data(),
+                                        num_streams, params, lower.data(),
+                                        upper.data(), state.range(0));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_BatchHedgedCSScaling)->Apply(thread_counts);
+
+void BM_BettingGridCSScaling(benchmark::State& state) {
+  const PoolSize pool(state.range(0));
+  const size_t n = 20000;
+  std::vector<double> x(n), lambdas(n, 0.5);
+  confseq::CounterRng rng(11, 0);
+  for (double& value : x) {
+    value = rng.uniform();
+  }
+  confseq::BettingOptions options;
+  options.log_space = true;
+  std::vector<double> lower(n), upper(n);
+  for (auto _ : state) {
+    confseq::betting_grid_cs(x.data(), n, 1000, lambdas.data(),
+                             lambdas.data(), options, log(20), true,
+                             lower.data(), upper.data(), state.range(0));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * n * 1001);
+}
+BENCHMARK(BM_BettingGridCSScaling)->Apply(thread_counts);
+
+// The accepted range of the grid of BM_BettingGridCSScaling on one thread,
+// computing each grid mean's capital over all times and then reducing the
+// endpoints column by column (state.range(0) = 0), or tiled by blocks of
+// times and a few means at a time, as betting_grid_accepted_range does (1).
+void BM_BettingGridAcceptedRangeTiling(benchmark::State& state) {
+  const size_t n = 20000;
+  std::vector<double> x(n), lambdas(n, 0.5);
+  confseq::CounterRng rng(11, 0);
+  for (double& value : x) {
+    value = rng.uniform();
+  }
+  confseq::BettingOptions options;
+  options.log_space = true;
+  const std::vector<double> grid = confseq::betting_grid(1000);
+  std::vector<int> first(n), last(n);
+  for (auto _ : state) {
+    if (state.range(0)) {
+      confseq::betting_grid_accepted_range(
+          x.data(), n, grid.data(), grid.size(), lambdas.data(),
+          lambdas.data(), options, 20, first.data(), last.data(), 1);
+    } else {
+      confseq::grid_accepted_range(
+          grid.size(), n, log(20),
+          [&](const size_t i, double* capital) {
+            confseq::betting_capital_process(x.data(), n, grid[i],
+                                             lambdas.data(), lambdas.data(),
+                                             options, capital);
+          },
+          first.data(), last.data(), 1);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * n * grid.size());
+}
+BENCHMARK(BM_BettingGridAcceptedRangeTiling)->Arg(0)->Arg(1);
+
+// The intersection of predmix_empbern, conjmix_empbern and hedged CSs at a
+// Bonferroni alpha / 3 each, by separate passes and a running intersection
+// of their bounds (state.range(0) = 0) or by intersected_cs (1).
+void BM_IntersectedCS(benchmark::State& state) {
+  const size_t n = 20000;
+  std::vector<double> x(n);
+  confseq::CounterRng rng(13, 0);
+  for (double& value : x) {
+    value = rng.uniform();
+  }
+  std::vector<confseq::StreamCSParams> methods(3);
+  methods[0].kind = confseq::StreamCSKind::PREDMIX_EMPBERN;
+  methods[1].kind = confseq::StreamCSKind::CONJMIX_EMPBERN;
+  methods[1].v_opt = 500;
+  methods[2].kind = confseq::StreamCSKind::HEDGED;
+  methods[2].breaks = 100;
+  for (confseq::StreamCSParams& params : methods) {
+    params.alpha = 0.05 / 3;
+  }
+  const size_t offsets[] = {0, n};
+  std::vector<double> lower(n), upper(n);
+  std::vector<std::vector<double>> method_lower(3, std::vector<double>(n)),
+      method_upper(3, std::vector<double>(n));
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      for (size_t k = 0; k < methods.size(); k++) {
+        confseq::batch_confidence_sequences(
+            x.data(), offsets, 1, methods[k], method_lower[k].data(),
+            method_upper[k].data(), 1);
+      }
+      double running_lower = 0, running_upper = 1;
+      for (size_t t = 0; t < n; t++) {
+        for (size_t k = 0; k < methods.size(); k++) {
+          running_lower = std::max(running_lower, method_lower[k][t]);
+          running_upper = std::min(running_upper, method_upper[k][t]);
+        }
+        lower[t] = running_lower;
+        upper[t] = running_upper;
+      }
+    } else {
+      confseq::intersected_cs(x.data(), n, methods.data(), methods.size(),
+                              true, lower.data(), upper.data());
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_IntersectedCS)->Arg(0)->Arg(1);
+
+// As BM_BettingGridCSScaling, dropping rejected means as the CS tightens.
+void BM_BettingPrunedGridCSScaling(benchmark::State& state) {
+  const PoolSize pool(state.range(0));
+  const size_t n = 20000;
+  std::vector<double> x(n), lambdas(n, 0.5);
+  confseq::CounterRng rng(11, 0);
+  for (double& value : x) {
+    value = rng.uniform();
+  }
+  confseq::BettingOptions options;
+  options.log_space = true;
+  std::vector<double> lower(n), upper(n);
+  for (auto _ : state) {
+    confseq::betting_pruned_grid_cs(x.data(), n, 1000, lambdas.data(),
+                                    lambdas.data(), options, 20,
+                                    lower.data(), upper.data(),
+                                    state.range(0));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * n * 1001);
+}
+BENCHMARK(BM_BettingPrunedGridCSScaling)->Apply(thread_counts);
+
+} // namespace
+
+BENCHMARK_MAIN();
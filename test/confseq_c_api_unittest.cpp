@@ -0,0 +1,435 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "confseq.h"
+#include "uniform_boundaries.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const double V_OPT = 100;
+const double ALPHA_OPT = 0.05;
+const double ALPHA = 0.05;
+
+TEST(CApiTest, VersionAndStatusStrings) {
+  EXPECT_EQ(confseq_api_version(), CONFSEQ_API_VERSION);
+  EXPECT_STREQ(confseq_status_string(CONFSEQ_OK), "ok");
+  EXPECT_STREQ(confseq_status_string(CONFSEQ_INVALID_ARGUMENT),
+               "invalid argument");
+}
+
+TEST(CApiTest, MixtureMatchesCppInterface) {
+  confseq_mixture* mixture = nullptr;
+  ASSERT_EQ(confseq_gamma_exponential_mixture_new(V_OPT, ALPHA_OPT, 2,
+                                                  &mixture),
+            CONFSEQ_OK);
+  const std::vector<double> v = {1, 10, 100, 1000, 10000};
+  const std::vector<double> s = {1, 5, 20, 60, 200};
+  std::vector<double> log_superMG(v.size()), bound(v.size()),
+      sequence(v.size());
+  ASSERT_EQ(confseq_mixture_log_superMG(mixture, s.data(), v.data(), v.size(),
+                                        log_superMG.data()),
+            CONFSEQ_OK);
+  ASSERT_EQ(confseq_mixture_bound(mixture, v.data(), v.size(), ALPHA,
+                                  bound.data()),
+            CONFSEQ_OK);
+  ASSERT_EQ(confseq_mixture_bound_sequence(mixture, v.data(), v.size(), ALPHA,
+                                           sequence.data()),
+            CONFSEQ_OK);
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_DOUBLE_EQ(log_superMG[i],
+                     confseq::gamma_exponential_log_mixture(
+                         s[i], v[i], V_OPT, 2, ALPHA_OPT));
+    EXPECT_NEAR(bound[i],
+                confseq::gamma_exponential_mixture_bound(v[i], ALPHA, V_OPT,
+                                                         2, ALPHA_OPT),
+                1e-8 * bound[i]);
+    EXPECT_NEAR(sequence[i], bound[i], 1e-8 * bound[i]);
+  }
+
+  confseq_boundary* boundary = nullptr;
+  ASSERT_EQ(confseq_mixture_boundary_new(mixture, &boundary), CONFSEQ_OK);
+  // The boundary holds its own copy of the mixture.
+  confseq_mixture_free(mixture);
+  std::vector<double> evaluated(v.size());
+  ASSERT_EQ(confseq_boundary_evaluate(boundary, v.data(), v.size(), ALPHA,
+                                      evaluated.data()),
+            CONFSEQ_OK);
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_NEAR(evaluated[i], bound[i], 1e-8 * bound[i]);
+  }
+  confseq_boundary_free(boundary);
+}
+
+TEST(CApiTest, PolyStitchingBoundary) {
+  confseq_boundary* boundary = nullptr;
+  ASSERT_EQ(confseq_poly_stitching_boundary_new(10, 0, 1.4, 2, &boundary),
+            CONFSEQ_OK);
+  const double v = 1000;
+  double out = 0;
+  ASSERT_EQ(confseq_boundary_evaluate(boundary, &v, 1, ALPHA, &out),
+            CONFSEQ_OK);
+  EXPECT_DOUBLE_EQ(out, confseq::poly_stitching_bound(v, ALPHA, 10));
+  confseq_boundary_free(boundary);
+}
+
+TEST(CApiTest, InvalidArgumentsReportStatus) {
+  confseq_mixture* mixture = nullptr;
+  EXPECT_EQ(confseq_one_sided_normal_mixture_new(-1, ALPHA_OPT, &mixture),
+            CONFSEQ_INVALID_ARGUMENT);
+  EXPECT_EQ(mixture, nullptr);
+  EXPECT_NE(std::strlen(confseq_last_error()), 0u);
+  EXPECT_EQ(confseq_one_sided_normal_mixture_new(V_OPT, ALPHA_OPT, nullptr),
+            CONFSEQ_INVALID_ARGUMENT);
+
+  ASSERT_EQ(confseq_one_sided_normal_mixture_new(V_OPT, ALPHA_OPT, &mixture),
+            CONFSEQ_OK);
+  const double v = 100;
+  double out = 0;
+  EXPECT_EQ(confseq_mixture_bound(mixture, &v, 1, 1.5, &out),
+            CONFSEQ_INVALID_ARGUMENT);
+  EXPECT_EQ(confseq_mixture_bound(mixture, &v, 1, ALPHA, nullptr),
+            CONFSEQ_INVALID_ARGUMENT);
+  EXPECT_EQ(confseq_mixture_bound(mixture, nullptr, 0, ALPHA, nullptr),
+            CONFSEQ_OK);
+  EXPECT_EQ(confseq_mixture_set_precision(mixture, 0, 1),
+            CONFSEQ_INVALID_ARGUMENT);
+  confseq_mixture_free(mixture);
+
+  confseq_quantile_ab_test* test = nullptr;
+  ASSERT_EQ(confseq_quantile_ab_test_new(0.5, 100, ALPHA_OPT, &test),
+            CONFSEQ_OK);
+  EXPECT_EQ(confseq_quantile_ab_test_add(test, 3, &v, 1),
+            CONFSEQ_INVALID_ARGUMENT);
+  confseq_quantile_ab_test_free(test);
+}
+
+TEST(CApiTest, BernoulliConfidenceSequence) {
+  confseq_bernoulli_cs* cs = nullptr;
+  ASSERT_EQ(confseq_bernoulli_cs_new(ALPHA, 100, ALPHA_OPT, 0, &cs),
+            CONFSEQ_OK);
+  confseq::BernoulliConfidenceSequence expected(ALPHA, 100, ALPHA_OPT);
+  const std::vector<double> successes = {3, 0, 7, 10};
+  const std::vector<int> trials = {10, 5, 10, 20};
+  std::vector<double> lower(successes.size()), upper(successes.size());
+  ASSERT_EQ(confseq_bernoulli_cs_update(cs, successes.data(), trials.data(),
+                                        successes.size(), lower.data(),
+                                        upper.data()),
+            CONFSEQ_OK);
+  for (size_t i = 0; i < successes.size(); i++) {
+    const std::pair<double, double> interval =
+        expected.update(successes[i], trials[i]);
+    EXPECT_DOUBLE_EQ(lower[i], interval.first);
+    EXPECT_DOUBLE_EQ(upper[i], interval.second);
+  }
+
+  // A bad entry rejects the whole batch.
+  const double bad_successes[] = {1, 5};
+  const int bad_trials[] = {2, 4};
+  double bad_lower[2], bad_upper[2];
+  EXPECT_EQ(confseq_bernoulli_cs_update(cs, bad_successes, bad_trials, 2,
+                                        bad_lower, bad_upper),
+            CONFSEQ_INVALID_ARGUMENT);
+  double current_lower = 0, current_upper = 0;
+  ASSERT_EQ(confseq_bernoulli_cs_interval(cs, &current_lower, &current_upper),
+            CONFSEQ_OK);
+  EXPECT_DOUBLE_EQ(current_lower, lower.back());
+  EXPECT_DOUBLE_EQ(current_upper, upper.back());
+  confseq_bernoulli_cs_free(cs);
+
+  std::vector<double> batch_lower(successes.size()),
+      batch_upper(successes.size());
+  ASSERT_EQ(confseq_bernoulli_confidence_intervals(
+                successes.data(), trials.data(), successes.size(), ALPHA, 100,
+                ALPHA_OPT, batch_lower.data(), batch_upper.data()),
+            CONFSEQ_OK);
+  for (size_t i = 0; i < successes.size(); i++) {
+    const std::pair<double, double> interval =
+        confseq::bernoulli_confidence_interval(successes[i], trials[i], ALPHA,
+                                               100, ALPHA_OPT);
+    EXPECT_DOUBLE_EQ(batch_lower[i], interval.first);
+    EXPECT_DOUBLE_EQ(batch_upper[i], interval.second);
+  }
+}
+
+TEST(CApiTest, QuantileABTest) {
+  confseq_quantile_ab_test* test = nullptr;
+  ASSERT_EQ(confseq_quantile_ab_test_new(0.5, 100, ALPHA_OPT, &test),
+            CONFSEQ_OK);
+  confseq::SequentialQuantileABTest expected(0.5, 100, ALPHA_OPT);
+  double p_value = 0;
+  ASSERT_EQ(confseq_quantile_ab_test_p_value(test, 0, &p_value), CONFSEQ_OK);
+  EXPECT_EQ(p_value, 1);
+
+  std::vector<double> arm1, arm2;
+  for (int i = 0; i < 200; i++) {
+    arm1.push_back(i);
+    arm2.push_back(i + 60);
+  }
+  ASSERT_EQ(confseq_quantile_ab_test_add(test, 1, arm1.data(), arm1.size()),
+            CONFSEQ_OK);
+  ASSERT_EQ(confseq_quantile_ab_test_add(test, 2, arm2.data(), arm2.size()),
+            CONFSEQ_OK);
+  expected.add(1, arm1.begin(), arm1.end());
+  expected.add(2, arm2.begin(), arm2.end());
+  ASSERT_EQ(confseq_quantile_ab_test_p_value(test, 0, &p_value), CONFSEQ_OK);
+  EXPECT_DOUBLE_EQ(p_value, expected.p_value());
+  EXPECT_LT(p_value, 1);
+  ASSERT_EQ(confseq_quantile_ab_test_p_value(test, 1, &p_value), CONFSEQ_OK);
+  EXPECT_DOUBLE_EQ(p_value, expected.running_p_value());
+  confseq_quantile_ab_test_free(test);
+}
+
+// Arrow arrays viewing test-owned buffers, released by the test itself.
+void release_view(ArrowArray* array) {
+  array->release = nullptr;
+}
+
+void release_schema_view(ArrowSchema* schema) {
+  schema->release = nullptr;
+}
+
+ArrowSchema schema_view(const char* format) {
+  return ArrowSchema{format, "", nullptr, ARROW_FLAG_NULLABLE, 0, nullptr,
+                     nullptr, &release_schema_view, nullptr};
+}
+
+struct ArrayView {
+  const void* buffers[2];
+  ArrowArray array;
+  ArrowArray* children[1];
+
+  ArrayView(const void* data, const uint8_t* validity, const int64_t offset,
+            const int64_t length, const int64_t null_count)
+      : buffers{validity, data},
+        array{length, null_count, offset, 2, 0, buffers, nullptr, nullptr,
+              &release_view, nullptr} {}
+
+  // A list array of lists at offsets over child.
+  ArrayView(const int32_t* offsets, const uint8_t* validity,
+            const int64_t length, const int64_t null_count, ArrowArray* child)
+      : ArrayView(offsets, validity, 0, length, null_count) {
+    children[0] = child;
+    array.n_children = 1;
+    array.children = children;
+  }
+};
+
+std::vector<double> result_values(const ArrowArray& array) {
+  const double* data = static_cast<const double*>(array.buffers[1]);
+  return std::vector<double>(data + array.offset,
+                             data + array.offset + array.length);
+}
+
+bool result_is_valid(const ArrowArray& array, const int64_t i) {
+  const uint8_t* validity = static_cast<const uint8_t*>(array.buffers[0]);
+  return !validity || ((validity[i >> 3] >> (i & 7)) & 1);
+}
+
+TEST(CApiTest, ArrowBoundaryEvaluate) {
+  confseq_mixture* mixture = nullptr;
+  ASSERT_EQ(confseq_two_sided_normal_mixture_new(V_OPT, ALPHA_OPT, &mixture),
+            CONFSEQ_OK);
+  confseq_boundary* boundary = nullptr;
+  ASSERT_EQ(confseq_mixture_boundary_new(mixture, &boundary), CONFSEQ_OK);
+
+  // Two float64 chunks, the second offset by 3 and with its second entry
+  // null.
+  std::vector<double> first(1000), second = {-1, -1, -1, 10, -1, 1000};
+  for (size_t i = 0; i < first.size(); i++) {
+    first[i] = i + 1;
+  }
+  const uint8_t validity[] = {0xff & ~(1 << 4)};
+  ArrayView first_view(first.data(), nullptr, 0, first.size(), 0);
+  ArrayView second_view(second.data(), validity, 3, 3, 1);
+  const ArrowSchema schema = schema_view("g");
+  const ArrowArray* chunks[] = {&first_view.array, &second_view.array};
+  const confseq_arrow_column v = {&schema, chunks, 2};
+
+  ArrowSchema out_schema;
+  ArrowArray out_chunks[2];
+  confseq_arrow_result out = {&out_schema, out_chunks};
+  ASSERT_EQ(confseq_arrow_boundary_evaluate(boundary, &v, ALPHA, &out),
+            CONFSEQ_OK);
+  EXPECT_STREQ(out_schema.format, "g");
+  ASSERT_EQ(out_chunks[0].length, 1000);
+  ASSERT_EQ(out_chunks[1].length, 3);
+  EXPECT_EQ(out_chunks[0].null_count, 0);
+  EXPECT_EQ(out_chunks[1].null_count, 1);
+  const std::vector<double> bounds = result_values(out_chunks[0]);
+  std::vector<double> expected(first.size());
+  ASSERT_EQ(confseq_boundary_evaluate(boundary, first.data(), first.size(),
+                                      ALPHA, expected.data()),
+            CONFSEQ_OK);
+  for (size_t i = 0; i < first.size(); i++) {
+    EXPECT_EQ(bounds[i], expected[i]) << i;
+  }
+  const std::vector<double> second_bounds = result_values(out_chunks[1]);
+  double bound_10 = 0, bound_1000 = 0;
+  confseq_boundary_evaluate(boundary, &second[3], 1, ALPHA, &bound_10);
+  confseq_boundary_evaluate(boundary, &second[5], 1, ALPHA, &bound_1000);
+  EXPECT_TRUE(result_is_valid(out_chunks[1], 0));
+  EXPECT_FALSE(result_is_valid(out_chunks[1], 1));
+  EXPECT_EQ(second_bounds[0], bound_10);
+  EXPECT_EQ(second_bounds[2], bound_1000);
+  out_schema.release(&out_schema);
+  out_chunks[0].release(&out_chunks[0]);
+  out_chunks[1].release(&out_chunks[1]);
+  EXPECT_EQ(out_chunks[0].release, nullptr);
+
+  const ArrowSchema string_schema = schema_view("u");
+  const confseq_arrow_column strings = {&string_schema, chunks, 2};
+  EXPECT_EQ(confseq_arrow_boundary_evaluate(boundary, &strings, ALPHA, &out),
+            CONFSEQ_INVALID_ARGUMENT);
+  confseq_boundary_free(boundary);
+  confseq_mixture_free(mixture);
+}
+
+TEST(CApiTest, ArrowBernoulliConfidenceIntervals) {
+  const std::vector<double> successes = {3, 0, 7, 10};
+  const std::vector<int32_t> trials = {10, 5, 10, 20};
+  const uint8_t validity[] = {0xff & ~(1 << 2)};
+  ArrayView successes_view(successes.data(), nullptr, 0, 4, 0);
+  ArrayView trials_view(trials.data(), validity, 0, 4, 1);
+  const ArrowSchema double_schema = schema_view("g");
+  const ArrowSchema int_schema = schema_view("i");
+  const ArrowArray* success_chunks[] = {&successes_view.array};
+  const ArrowArray* trial_chunks[] = {&trials_view.array};
+  const confseq_arrow_column successes_column = {&double_schema,
+                                                 success_chunks, 1};
+  const confseq_arrow_column trials_column = {&int_schema, trial_chunks, 1};
+
+  ArrowSchema lower_schema, upper_schema;
+  ArrowArray lower_chunk, upper_chunk;
+  confseq_arrow_result lower = {&lower_schema, &lower_chunk};
+  confseq_arrow_result upper = {&upper_schema, &upper_chunk};
+  ASSERT_EQ(confseq_arrow_bernoulli_confidence_intervals(
+                &successes_column, &trials_column, ALPHA, 100, ALPHA_OPT,
+                &lower, &upper),
+            CONFSEQ_OK);
+  const std::vector<double> lower_values = result_values(lower_chunk);
+  const std::vector<double> upper_values = result_values(upper_chunk);
+  EXPECT_EQ(lower_chunk.null_count, 1);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(result_is_valid(lower_chunk, i), i != 2);
+    if (i == 2) {
+      continue;
+    }
+    const std::pair<double, double> interval =
+        confseq::bernoulli_confidence_interval(successes[i], trials[i], ALPHA,
+                                               100, ALPHA_OPT);
+    EXPECT_DOUBLE_EQ(lower_values[i], interval.first);
+    EXPECT_DOUBLE_EQ(upper_values[i], interval.second);
+  }
+  for (ArrowArray* chunk : {&lower_chunk, &upper_chunk}) {
+    chunk->release(chunk);
+  }
+  lower_schema.release(&lower_schema);
+  upper_schema.release(&upper_schema);
+
+  ArrayView short_view(trials.data(), nullptr, 0, 3, 0);
+  const ArrowArray* short_chunks[] = {&short_view.array};
+  const confseq_arrow_column short_column = {&int_schema, short_chunks, 1};
+  EXPECT_EQ(confseq_arrow_bernoulli_confidence_intervals(
+                &successes_column, &short_column, ALPHA, 100, ALPHA_OPT,
+                &lower, &upper),
+            CONFSEQ_INVALID_ARGUMENT);
+}
+
+TEST(CApiTest, ArrowConfidenceSequences) {
+  // Streams of 5, 0 (null) and 7 observations in a list column.
+  std::vector<float> x(12);
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = float((i * 7 % 10) / 10.0);
+  }
+  const std::vector<int32_t> offsets = {0, 5, 5, 12};
+  const uint8_t validity[] = {0xff & ~(1 << 1)};
+  ArrayView values_view(x.data(), nullptr, 0, x.size(), 0);
+  ArrayView list_view(offsets.data(), validity, 3, 1, &values_view.array);
+  ArrowSchema child_schema = schema_view("f");
+  ArrowSchema* schema_children[] = {&child_schema};
+  ArrowSchema list_schema = schema_view("+l");
+  list_schema.n_children = 1;
+  list_schema.children = schema_children;
+  const ArrowArray* chunks[] = {&list_view.array};
+  const confseq_arrow_column streams = {&list_schema, chunks, 1};
+
+  confseq_stream_cs_params params;
+  confseq_stream_cs_params_init(&params);
+  params.kind = "conjmix_empbern";
+  params.v_opt = 5;
+  ArrowSchema lower_schema, upper_schema;
+  ArrowArray lower_chunk, upper_chunk;
+  confseq_arrow_result lower = {&lower_schema, &lower_chunk};
+  confseq_arrow_result upper = {&upper_schema, &upper_chunk};
+  ASSERT_EQ(confseq_arrow_confidence_sequences(&streams, &params, &lower,
+                                               &upper),
+            CONFSEQ_OK);
+  EXPECT_STREQ(lower_schema.format, "+l");
+  EXPECT_STREQ(lower_schema.children[0]->format, "g");
+  ASSERT_EQ(lower_chunk.length, 3);
+  EXPECT_EQ(lower_chunk.null_count, 1);
+  EXPECT_FALSE(result_is_valid(lower_chunk, 1));
+  const int32_t* lower_offsets =
+      static_cast<const int32_t*>(lower_chunk.buffers[1]);
+  EXPECT_EQ(std::vector<int32_t>(lower_offsets, lower_offsets + 4), offsets);
+
+  const std::vector<double> x_double(x.begin(), x.end());
+  const std::vector<size_t> size_offsets = {0, 5, 5, 12};
+  confseq::StreamCSParams cs_params;
+  cs_params.kind = confseq::StreamCSKind::CONJMIX_EMPBERN;
+  cs_params.v_opt = 5;
+  std::vector<double> expected_lower(12), expected_upper(12);
+  confseq::batch_confidence_sequences(x_double.data(), size_offsets.data(), 3,
+                                      cs_params, expected_lower.data(),
+                                      expected_upper.data());
+  EXPECT_EQ(result_values(*lower_chunk.children[0]), expected_lower);
+  EXPECT_EQ(result_values(*upper_chunk.children[0]), expected_upper);
+  lower_chunk.release(&lower_chunk);
+  upper_chunk.release(&upper_chunk);
+  lower_schema.release(&lower_schema);
+  upper_schema.release(&upper_schema);
+
+  params.kind = "nonexistent";
+  EXPECT_EQ(confseq_arrow_confidence_sequences(&streams, &params, &lower,
+                                               &upper),
+            CONFSEQ_INVALID_ARGUMENT);
+}
+
+TEST(CApiTest, ArrowQuantileABPValue) {
+  std::vector<int64_t> arm1(200), arm2(200);
+  for (int i = 0; i < 200; i++) {
+    arm1[i] = i;
+    arm2[i] = i + 60;
+  }
+  // arm1 split across two chunks.
+  ArrayView arm1_head(arm1.data(), nullptr, 0, 120, 0);
+  ArrayView arm1_tail(arm1.data(), nullptr, 120, 80, 0);
+  ArrayView arm2_view(arm2.data(), nullptr, 0, 200, 0);
+  const ArrowSchema schema = schema_view("l");
+  const ArrowArray* arm1_chunks[] = {&arm1_head.array, &arm1_tail.array};
+  const ArrowArray* arm2_chunks[] = {&arm2_view.array};
+  const confseq_arrow_column arm1_column = {&schema, arm1_chunks, 2};
+  const confseq_arrow_column arm2_column = {&schema, arm2_chunks, 1};
+  double p_value = 0;
+  ASSERT_EQ(confseq_arrow_quantile_ab_p_value(&arm1_column, &arm2_column, 0.5,
+                                              100, ALPHA_OPT, &p_value),
+            CONFSEQ_OK);
+  confseq::QuantileABTest expected(
+      0.5, 100, ALPHA_OPT,
+      std::make_shared<confseq::StaticOrderStatistics>(arm1.begin(),
+                                                       arm1.end()),
+      std::make_shared<confseq::StaticOrderStatistics>(arm2.begin(),
+                                                       arm2.end()));
+  EXPECT_DOUBLE_EQ(p_value, expected.p_value());
+  EXPECT_LT(p_value, 1);
+
+  const confseq_arrow_column empty = {&schema, arm1_chunks, 0};
+  EXPECT_EQ(confseq_arrow_quantile_ab_p_value(&empty, &arm2_column, 0.5, 100,
+                                              ALPHA_OPT, &p_value),
+            CONFSEQ_INVALID_ARGUMENT);
+}
+
+} // namespace
@@ -0,0 +1,57 @@
+import asyncio
+import threading
+
+import numpy as np
+from confseq import aio
+from confseq.batch import batch_cs
+from confseq.betting import betting_cs, thread_pool
+from confseq.capital_processes import get_num_threads
+from confseq.quantiles import quantile_ab_p_value
+
+
+def test_async_calls_match_sync_calls():
+    rng = np.random.default_rng(3)
+    x = rng.beta(2, 5, 200)
+    a_values = np.arange(1, 1001, dtype=float)
+
+    async def main():
+        return await asyncio.gather(
+            aio.betting_cs_async(x, breaks=100),
+            aio.batch_cs_async(x, offsets=[0, 100, 200]),
+            *[
+                aio.quantile_ab_p_value_async(a_values, a_values + shift, 0.5, 100)
+                for shift in (70, 85, 100)
+            ],
+        )
+
+    betting, batch, *p_values = asyncio.run(main())
+    assert np.array_equal(betting, betting_cs(x, breaks=100))
+    assert np.array_equal(batch, batch_cs(x, offsets=[0, 100, 200]))
+    for shift, p_value in zip((70, 85, 100), p_values):
+        assert p_value == quantile_ab_p_value(a_values, a_values + shift, 0.5, 100)
+
+
+def test_cancelled_queued_call_never_runs():
+    release = threading.Event()
+    ran = []
+
+    async def main():
+        # Occupy every worker, so the last call waits in the queue.
+        blockers = [aio.submit(release.wait) for _ in range(get_num_threads())]
+        queued = aio.submit(ran.append, 1)
+        queued.cancel()
+        # Lets the cancellation reach the executor before the workers free up.
+        await asyncio.sleep(0)
+        release.set()
+        await asyncio.gather(*blockers)
+        return queued
+
+    queued = asyncio.run(main())
+    assert queued.cancelled()
+    aio.executor().submit(lambda: None).result()
+    assert ran == []
+
+
+def test_executor_is_its_own_shared_pool():
+    assert aio.executor() is aio.executor()
+    assert aio.executor() is not thread_pool()
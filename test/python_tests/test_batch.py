@@ -0,0 +1,226 @@
+import numpy as np
+import pytest
+from confseq.batch import batch_cs, chunked_cs, read_bounds_file
+from confseq.boundaries import bernoulli_confidence_interval
+from confseq.capital_processes import (
+    RollupConfidenceSequences,
+    cs_first_exclusions,
+    intersected_cs,
+    reset_scratch_arena_stats,
+    scratch_arena_stats,
+)
+from confseq.betting import hedged_cs
+from confseq.conjmix_bounded import conjmix_empbern_cs, conjmix_hoeffding_cs
+from confseq.predmix import predmix_empbern_cs, predmix_hoeffding_cs
+
+
+@pytest.mark.parametrize("running_intersection", [False, True])
+def test_batch_cs_matches_single_streams(running_intersection):
+    rng = np.random.default_rng(12)
+    lengths = [50, 0, 1, 200, 7]
+    streams = [rng.beta(2, 5, n) for n in lengths]
+    padded = np.zeros((len(streams), max(lengths)))
+    for i, stream in enumerate(streams):
+        padded[i, 0 : len(stream)] = stream
+    cs_fns = {
+        "predmix_empbern": lambda x: predmix_empbern_cs(
+            x, alpha=0.1, running_intersection=running_intersection
+        ),
+        "predmix_hoeffding": lambda x: predmix_hoeffding_cs(
+            x, alpha=0.1, running_intersection=running_intersection
+        ),
+        "conjmix_hoeffding": lambda x: conjmix_hoeffding_cs(
+            x, t_opt=20, alpha=0.1, running_intersection=running_intersection
+        ),
+        "conjmix_empbern": lambda x: conjmix_empbern_cs(
+            x, v_opt=5, alpha=0.1, running_intersection=running_intersection
+        ),
+        "hedged": lambda x: hedged_cs(
+            x, alpha=0.1, breaks=100, running_intersection=running_intersection
+        ),
+    }
+    for cs, cs_fn in cs_fns.items():
+        l, u = batch_cs(
+            padded,
+            lengths=lengths,
+            cs=cs,
+            alpha=0.1,
+            t_opt=20,
+            v_opt=5,
+            breaks=100,
+            running_intersection=running_intersection,
+        )
+        flat_l, flat_u = batch_cs(
+            np.concatenate(streams),
+            offsets=np.append(0, np.cumsum(lengths)),
+            cs=cs,
+            alpha=0.1,
+            t_opt=20,
+            v_opt=5,
+            breaks=100,
+            running_intersection=running_intersection,
+        )
+        assert np.array_equal(flat_l, l[~np.isnan(l)])
+        assert np.array_equal(flat_u, u[~np.isnan(u)])
+        for i, stream in enumerate(streams):
+            if len(stream) == 0:
+                continue
+            expected_l, expected_u = cs_fn(stream)
+            assert np.allclose(l[i, 0 : len(stream)], expected_l), cs
+            assert np.allclose(u[i, 0 : len(stream)], expected_u), cs
+            assert np.all(np.isnan(l[i, len(stream) :]))
+
+
+def test_batch_cs_rejects_bad_arguments():
+    with pytest.raises(ValueError):
+        batch_cs(np.ones(3), offsets=[0, 2], cs="predmix_empbern")
+    with pytest.raises(ValueError):
+        batch_cs(np.ones(3), cs="conjmix")
+    with pytest.raises(ValueError):
+        batch_cs(np.full(3, 2.0), cs="hedged")
+
+
+def test_repeated_batches_reuse_scratch():
+    rng = np.random.default_rng(3)
+    streams = rng.beta(2, 5, (30, 100))
+    first = batch_cs(streams, cs="hedged", breaks=50, num_threads=1)
+    reset_scratch_arena_stats()
+    repeated = batch_cs(streams, cs="hedged", breaks=50, num_threads=1)
+    stats = scratch_arena_stats()
+    assert stats["heap_allocations"] == 0
+    assert stats["reserved_bytes"] > 0
+    assert np.array_equal(first[0], repeated[0])
+    assert np.array_equal(first[1], repeated[1])
+
+
+@pytest.mark.parametrize("running_intersection", [False, True])
+def test_cs_first_exclusions_match_dense_sequences(running_intersection):
+    rng = np.random.default_rng(13)
+    lengths = [500, 0, 3, 400]
+    values = rng.uniform(0, 0.6, sum(lengths))
+    offsets = np.append(0, np.cumsum(lengths))
+    null_means = np.array([0.5, 0.45, 0.4, 0.3])
+    for cs in ["predmix_empbern", "predmix_hoeffding", "conjmix_hoeffding"]:
+        l, u = batch_cs(
+            values,
+            offsets=offsets,
+            cs=cs,
+            t_opt=20,
+            running_intersection=running_intersection,
+        )
+        times, lower, upper = cs_first_exclusions(
+            values,
+            offsets,
+            null_means,
+            cs=cs,
+            t_opt=20,
+            running_intersection=running_intersection,
+        )
+        for k in range(len(lengths)):
+            stream_l = l[offsets[k] : offsets[k + 1]]
+            stream_u = u[offsets[k] : offsets[k + 1]]
+            excluded = np.flatnonzero(
+                (stream_l > null_means[k]) | (stream_u < null_means[k])
+            )
+            expected = excluded[0] + 1 if len(excluded) else 0
+            assert times[k] == expected, (cs, k)
+            if expected:
+                assert np.isclose(lower[k], stream_l[expected - 1])
+                assert np.isclose(upper[k], stream_u[expected - 1])
+        assert times[0] > 0 and times[3] == 0
+    scalar_times, _, _ = cs_first_exclusions(values, offsets, 0.5)
+    assert scalar_times[0] > 0
+    with pytest.raises(ValueError):
+        cs_first_exclusions(values, offsets, np.ones(2))
+
+
+def test_sinks_match_returned_bounds(tmp_path):
+    x = np.random.default_rng(14).beta(2, 5, 3000)
+    offsets = [0, 1200, 3000]
+    l, u = batch_cs(x, offsets=offsets, cs="conjmix_empbern", v_opt=50)
+    blocks = []
+    assert (
+        batch_cs(
+            x,
+            offsets=offsets,
+            cs="conjmix_empbern",
+            v_opt=50,
+            sink=lambda offset, lower, upper: blocks.append((offset, lower, upper)),
+            block_size=500,
+        )
+        is None
+    )
+    assert max(len(lower) for _, lower, _ in blocks) == 500
+    sink_l, sink_u = np.zeros(len(x)), np.zeros(len(x))
+    for offset, lower, upper in blocks:
+        sink_l[offset : offset + len(lower)] = lower
+        sink_u[offset : offset + len(upper)] = upper
+    assert np.allclose(sink_l, l) and np.allclose(sink_u, u)
+
+    path = tmp_path / "bounds.bin"
+    intersected_cs(x, sink=path)
+    file_l, file_u = read_bounds_file(path)
+    assert np.array_equal(file_l, intersected_cs(x)[0])
+    assert np.array_equal(file_u, intersected_cs(x)[1])
+
+
+def test_chunked_cs_matches_batch_cs_bit_for_bit():
+    x = np.random.default_rng(15).beta(2, 5, 2500)
+    # Chunks of uneven sizes, including an empty one, from a generator.
+    edges = [0, 1, 7, 7, 300, 1024, 2500]
+    for cs, kwargs in [
+        ("predmix_empbern", dict(running_intersection=True)),
+        ("conjmix_empbern", dict(v_opt=50, side="lower")),
+        ("hedged", dict(breaks=200)),
+    ]:
+        l, u = batch_cs(x, cs=cs, **kwargs)
+        chunks = (x[begin:end] for begin, end in zip(edges[:-1], edges[1:]))
+        pieces = list(chunked_cs(chunks, cs=cs, **kwargs))
+        assert [len(lower) for lower, _ in pieces] == list(np.diff(edges))
+        assert np.array_equal(np.concatenate([lower for lower, _ in pieces]), l)
+        assert np.array_equal(np.concatenate([upper for _, upper in pieces]), u)
+
+    with pytest.raises(ValueError):
+        list(chunked_cs([x[:10], [0.5, 1.5]], cs="hedged"))
+
+
+def test_rollups_match_per_bucket_cs():
+    rng = np.random.default_rng(16)
+    timestamps = np.cumsum(rng.integers(0, 40, 1500)) - 2000
+    x = rng.beta(2, 5, len(timestamps))
+    grains = [60, 3600, 86400]
+    for cs, values in [
+        ("bernoulli", (x < 0.3).astype(float)),
+        ("conjmix_hoeffding", x),
+        ("predmix_empbern", x),
+    ]:
+        rollups = RollupConfidenceSequences(grains, cs=cs, t_opt=50)
+        pieces = [rollups.update(timestamps[:700], values[:700])]
+        pieces.append(rollups.update(timestamps[700:], values[700:]))
+        pieces.append(rollups.flush())
+        grain, start, n, mean, lower, upper = (
+            np.concatenate(field) for field in zip(*pieces)
+        )
+        assert len(grain) == sum(len(np.unique(timestamps // g)) for g in grains)
+        for i in range(len(grain)):
+            bucket = values[timestamps // grain[i] == start[i] // grain[i]]
+            assert n[i] == len(bucket)
+            assert np.isclose(mean[i], bucket.mean())
+            if cs == "bernoulli":
+                expected = bernoulli_confidence_interval(
+                    bucket.sum(), len(bucket), 0.05, 50
+                )
+            elif cs == "conjmix_hoeffding":
+                l, u = conjmix_hoeffding_cs(bucket, t_opt=50)
+                expected = (l[-1], u[-1])
+            else:
+                l, u = predmix_empbern_cs(bucket)
+                expected = (l[-1], u[-1])
+            assert np.allclose((lower[i], upper[i]), expected)
+        if cs != "predmix_empbern":
+            assert rollups.num_boundary_evaluations < len(grain)
+
+    with pytest.raises(ValueError):
+        RollupConfidenceSequences([60, 90])
+    with pytest.raises(ValueError):
+        rollups.update([0], [0.5])
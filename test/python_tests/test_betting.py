@@ -1,7 +1,12 @@
 from math import isnan
+import subprocess
+import sys
+import threading
 import pytest
 import numpy as np
+from confseq import capital_processes, misc
 from confseq.betting import *
+from confseq.betting_strategies import lambda_aKelly, lambda_Kelly, lambda_LBOW
 from confseq.misc import superMG_crossing_fraction, expand_grid
 from scipy.stats import binomtest
 from itertools import permutations
@@ -72,6 +77,15 @@ def test_betting_mart_convex_comb(m):
     assert all(mart1 >= mart2)
 
 
+@pytest.mark.parametrize("N", [None, 1200])
+@pytest.mark.parametrize("convex_comb", [False, True])
+def test_betting_mart_log_space(N, convex_comb):
+    x = np.random.default_rng(5).beta(2, 3, 1000)
+    mart = betting_mart(x, 0.45, N=N, convex_comb=convex_comb)
+    log_mart = betting_mart(x, 0.45, N=N, convex_comb=convex_comb, log_space=True)
+    assert np.allclose(log_mart, np.log(mart), rtol=1e-9)
+
+
 @pytest.mark.random
 def test_betting_mart_WoR():
     N = 1000
@@ -155,6 +169,22 @@ def test_logical_cs():
     assert all(u == [1 - i / N for i in np.arange(1, N + 1)])
 
 
+@pytest.mark.parametrize("running_intersection", [False, True])
+def test_intersect_cs_matches_logical_cs(running_intersection):
+    N = 300
+    x = np.random.default_rng(8).binomial(1, 0.3, 200).astype(float)
+    l = np.random.default_rng(9).uniform(0, 0.5, 200)
+    u = l + 0.4
+    logical_l, logical_u = logical_cs(x, N)
+    expected_l, expected_u = np.maximum(l, logical_l), np.minimum(u, logical_u)
+    if running_intersection:
+        expected_l = np.maximum.accumulate(expected_l)
+        expected_u = np.minimum.accumulate(expected_u)
+    l, u = intersect_cs(x, l, u, N, running_intersection)
+    assert np.allclose(l, expected_l)
+    assert np.allclose(u, expected_u)
+
+
 def test_get_ci_seq():
     # Just test the CI at a given time
     ci_fn = lambda x: betting_ci(x, alpha=0.05)
@@ -166,3 +196,376 @@ def test_get_ci_seq():
         l, u = ci_fn(x[0 : times[i]])
         assert l_seq[i] == l
         assert u_seq[i] == u
+
+
+def test_parallel_matches_serial():
+    x = np.random.default_rng(10).beta(2, 5, 200)
+    mart_fn = lambda x, m: betting_mart(x, m, log_space=True)
+    l, u = cs_from_martingale(x, mart_fn, breaks=50, parallel=True, log_space=True)
+    expected_l, expected_u = cs_from_martingale(x, mart_fn, breaks=50, log_space=True)
+    assert np.array_equal(l, expected_l)
+    assert np.array_equal(u, expected_u)
+    assert thread_pool() is thread_pool()
+
+    ci_fn = lambda x: betting_ci(x, breaks=50)
+    times = [20, 100, 200]
+    assert np.array_equal(
+        get_ci_seq(x, ci_fn, times, parallel=True),
+        get_ci_seq(x, ci_fn, times),
+    )
+
+
+def test_thread_pool_created_once_across_threads():
+    pools = []
+    threads = [
+        threading.Thread(target=lambda: pools.append(misc.thread_pool("test")))
+        for _ in range(16)
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert all(pool is pools[0] for pool in pools)
+
+
+def test_replaced_thread_pool_stays_usable():
+    num_threads = capital_processes.get_num_threads()
+    old = thread_pool()
+    capital_processes.set_num_threads(num_threads + 1)
+    try:
+        assert thread_pool() is not old
+        assert list(old.map(abs, [-1, -2])) == [1, 2]
+    finally:
+        capital_processes.set_num_threads(num_threads)
+
+
+def test_nested_parallel_calls_do_not_deadlock():
+    x = np.random.default_rng(12).beta(2, 5, 200)
+    num_threads = capital_processes.get_num_threads()
+    capital_processes.set_num_threads(1)
+    try:
+        # Python bets run the inner grid on the same pool as the outer times
+        lambdas_fns = [lambda x, m: lambda_predmix_eb(x, alpha=0.05)]
+        ci_fn = lambda x: betting_ci(
+            x, breaks=20, lambdas_fns_positive=lambdas_fns, parallel=True
+        )
+        times = [50, 100, 200]
+        assert np.array_equal(
+            get_ci_seq(x, ci_fn, times, parallel=True),
+            get_ci_seq(x, ci_fn, times),
+        )
+    finally:
+        capital_processes.set_num_threads(num_threads)
+
+
+def test_adaptive_grid_matches_fine_grid():
+    x = np.random.default_rng(11).beta(2, 5, 500)
+    evaluated = []
+
+    def mart_fn(x, m):
+        evaluated.append(m)
+        return betting_mart(x, m, log_space=True)
+
+    l, u = cs_from_martingale(
+        x, mart_fn, breaks=100, log_space=True, resolution=1e-4, times=[250, 500]
+    )
+    fine_l, fine_u = betting_cs(x, breaks=10000)
+    assert len(evaluated) < 500
+    # Outer cell edges lie within the resolution of the boundary, as the
+    # fine grid's widened endpoints do
+    for time in [250, 500]:
+        assert abs(l[time - 1] - fine_l[time - 1]) < 2e-4
+        assert abs(u[time - 1] - fine_u[time - 1]) < 2e-4
+    coarse_l, coarse_u = cs_from_martingale(x, mart_fn, breaks=100, log_space=True)
+    assert np.all(l >= coarse_l - 1e-12) and np.all(u <= coarse_u + 1e-12)
+
+
+@pytest.mark.parametrize("N", [None, 800])
+def test_hedged_cs_matches_betting_cs(N):
+    x = np.random.default_rng(6).beta(2, 5, 500)
+    l, u = hedged_cs(x, N=N, breaks=200)
+    expected_l, expected_u = betting_cs(
+        x,
+        lambdas_fns_positive=[lambda x, m: lambda_predmix_eb(x, alpha=0.05)],
+        lambdas_fns_negative=[lambda_predmix_eb],
+        N=N,
+        breaks=200,
+        running_intersection=True,
+        theta=1 / 2,
+        trunc_scale=1 / 2,
+    )
+    assert np.array_equal(l, expected_l)
+    assert np.array_equal(u, expected_u)
+
+
+@pytest.mark.parametrize("side", ["lower", "upper"])
+def test_one_sided_hedged_cs(side):
+    x = np.random.default_rng(6).beta(2, 5, 500)
+    l, u = hedged_cs(x, breaks=200, side=side)
+    both_l, both_u = hedged_cs(x, breaks=200)
+    if side == "lower":
+        assert np.all(u == 1) and np.all(l >= both_l)
+    else:
+        assert np.all(l == 0) and np.all(u <= both_u)
+    expected_l, expected_u = betting_cs(
+        x,
+        lambdas_fns_positive=[lambda x, m: lambda_predmix_eb(x, alpha=0.05)],
+        lambdas_fns_negative=[lambda_predmix_eb],
+        breaks=200,
+        running_intersection=True,
+        side=side,
+    )
+    assert np.array_equal(l, expected_l)
+    assert np.array_equal(u, expected_u)
+
+
+def test_hedged_cs_bisection_matches_grid():
+    x = np.random.default_rng(7).beta(2, 5, 1000)
+    breaks = 1000
+    l_grid, u_grid = hedged_cs(x, breaks=breaks)
+    l, u = hedged_cs(x, tolerance=1e-5)
+    assert np.all(np.abs(l - l_grid) <= 1 / breaks + 1e-5)
+    assert np.all(np.abs(u - u_grid) <= 1 / breaks + 1e-5)
+
+
+@pytest.mark.parametrize("convex_comb", [False, True])
+def test_diversified_betting_mart_log_space(convex_comb):
+    x = np.random.default_rng(8).beta(1, 1, 1000)
+    lambdas_fns = [lambda x, m, c=c: np.repeat(c, len(x)) for c in [0.1, 0.5, 1]]
+    kwargs = dict(lambdas_fns_positive=lambdas_fns, convex_comb=convex_comb)
+    mart = diversified_betting_mart(x, 0.45, **kwargs)
+    log_mart = diversified_betting_mart(x, 0.45, log_space=True, **kwargs)
+    assert np.allclose(log_mart, np.log(mart), rtol=1e-9)
+
+
+def test_native_strategies_match_strategy_functions():
+    x = np.random.default_rng(9).beta(2, 3, 500)
+    m, N = 0.4, 1000
+    predmix = betting_strategy_bets(
+        x, m, BettingStrategy("predmix_eb", alpha=0.1, truncation=0.8)
+    )
+    assert np.allclose(predmix, lambda_predmix_eb(x, truncation=0.8, alpha=0.1))
+    aKelly = betting_strategy_bets(x, m, BettingStrategy("aKelly"), N=N)
+    assert np.allclose(aKelly, lambda_aKelly(x, m, N=N))
+    LBOW = betting_strategy_bets(x, m, BettingStrategy(BettingStrategyKind.LBOW))
+    assert np.allclose(LBOW, lambda_LBOW(x, m))
+    fixed = BettingStrategy("fixed_fraction", fraction=0.3)
+    assert np.allclose(
+        betting_strategy_bets(x, m, fixed, negative=True, N=N),
+        0.3 / (1 - mu_t(x, m, N)),
+    )
+    with pytest.raises(ValueError):
+        BettingStrategy("Kelly")
+
+
+def test_compute_modules_do_not_import_optional_dependencies():
+    modules = [
+        "confseq.aio",
+        "confseq.batch",
+        "confseq.betting",
+        "confseq.betting_strategies",
+        "confseq.boundaries",
+        "confseq.conjmix_bounded",
+        "confseq.misc",
+        "confseq.predmix",
+        "confseq.quantiles",
+    ]
+    code = "import sys\n"
+    code += "".join("import " + module + "\n" for module in modules)
+    code += "print(any(m.split('.')[0] in ('matplotlib', 'scipy', 'pandas')"
+    code += " for m in sys.modules))"
+    result = subprocess.run(
+        [sys.executable, "-c", code], capture_output=True, text=True, check=True
+    )
+    assert result.stdout.strip() == "False"
+
+
+def test_lambda_Kelly_solves_kelly_condition():
+    from scipy.optimize import root
+
+    x = np.random.default_rng(4).beta(2, 3, 200)
+    m = 0.4
+    lambdas = lambda_Kelly(x, m)
+    assert lambdas[0] == 0
+    for i in range(1, len(x)):
+        if np.max(x[0:i]) <= m:
+            assert lambdas[i] == -1 / (1 - m)
+        elif np.min(x[0:i]) >= m:
+            assert lambdas[i] == 1 / m
+        else:
+            expected = root(
+                lambda l: np.sum((x[0:i] - m) / (1 + l * (x[0:i] - m))),
+                x0=lambda_aKelly(x, m)[i],
+            )["x"][0]
+            assert np.isclose(lambdas[i], expected, rtol=1e-6)
+
+
+@pytest.mark.parametrize("N", [None, 800])
+def test_multi_alpha_betting_cs_matches_single(N):
+    x = np.random.default_rng(11).beta(2, 5, 300)
+    alphas = [0.01, 0.05, 0.1]
+    bets = BettingStrategy("aKelly")
+    l, u = betting_cs(x, bets, alpha=alphas, N=N, breaks=200)
+    assert l.shape == u.shape == (3, 300)
+    for k, alpha in enumerate(alphas):
+        expected_l, expected_u = betting_cs(x, bets, alpha=alpha, N=N, breaks=200)
+        assert np.array_equal(l[k], expected_l)
+        assert np.array_equal(u[k], expected_u)
+    assert np.all(l[0] <= l[2]) and np.all(u[0] >= u[2])
+
+    # Bets tuned to alpha must be fixed to share them across levels.
+    with pytest.raises(ValueError):
+        betting_cs(x, alpha=alphas, breaks=200)
+    l, u = betting_cs(x, alpha=alphas, breaks=200, bets_alpha=0.05)
+    expected_l, expected_u = betting_cs(x, alpha=0.05, breaks=200)
+    assert np.array_equal(l[1], expected_l)
+    assert np.array_equal(u[1], expected_u)
+
+
+@pytest.mark.parametrize("N", [None, 800])
+def test_pruned_betting_cs_within_running_intersection(N):
+    x = np.random.default_rng(12).beta(2, 5, 500)
+    l, u = betting_cs(x, N=N, breaks=200, prune_rejected=True)
+    range_l, range_u = betting_cs(x, N=N, breaks=200, running_intersection=True)
+    assert np.all(l >= range_l) and np.all(u <= range_u)
+    assert np.all(np.diff(l) >= 0) and np.all(np.diff(u) <= 0)
+    assert u[-1] - l[-1] < 0.2
+    with pytest.raises(ValueError):
+        betting_cs(x, lambda x, m: np.full(len(x), 0.5), prune_rejected=True)
+
+
+def test_first_rejection_cs_matches_pruned_betting_cs():
+    x = np.random.default_rng(13).beta(2, 5, 1000)
+    t = np.arange(1, len(x) + 1)
+    l, u = betting_cs(x, "aKelly", breaks=200, prune_rejected=True)
+    cs = betting_cs(x, "aKelly", breaks=200, first_rejections=True)
+    assert isinstance(cs, FirstRejectionCS) and len(cs.times) == 201
+    assert np.any(cs.times > 0) and np.any(cs.times == 0)
+    cs_l, cs_u = cs.bounds(t)
+    assert np.array_equal(cs_l, l) and np.array_equal(cs_u, u)
+    assert cs.bounds(500) == (l[499], u[499])
+
+    mart_fn = lambda x, m: diversified_betting_mart(x, m, ["aKelly"], log_space=True)
+    callable_cs = cs_from_martingale(
+        x, mart_fn, breaks=200, log_space=True, first_rejections=True
+    )
+    callable_l, callable_u = callable_cs.bounds(t)
+    assert np.allclose(callable_l, l, atol=1 / 200)
+    assert np.allclose(callable_u, u, atol=1 / 200)
+    with pytest.raises(ValueError):
+        betting_cs(x, N=2000, first_rejections=True)
+
+
+@pytest.mark.parametrize("N", [None, 800])
+def test_betting_cs_native_matches_callables(N):
+    x = np.random.default_rng(10).beta(2, 5, 300)
+    breaks = 200
+    l, u = betting_cs(x, N=N, breaks=breaks)
+    expected_l, expected_u = betting_cs(
+        x,
+        lambdas_fns_positive=lambda x, m: lambda_predmix_eb(x, alpha=0.05),
+        N=N,
+        breaks=breaks,
+    )
+    assert np.allclose(l, expected_l, atol=1 / breaks)
+    assert np.allclose(u, expected_u, atol=1 / breaks)
+
+    strategies = ["aKelly", BettingStrategy("predmix_eb", truncation=0.5)]
+    mart = diversified_betting_mart(x, 0.3, strategies, N=N, log_space=True)
+    expected_mart = diversified_betting_mart(
+        x,
+        0.3,
+        [
+            lambda x, m: lambda_aKelly(x, m, N=N),
+            lambda x, m: lambda_predmix_eb(x, truncation=0.5),
+        ],
+        N=N,
+        log_space=True,
+    )
+    assert np.allclose(mart, expected_mart)
+
+
+@pytest.mark.parametrize("N", [None, 900])
+def test_hedged_confidence_sequence_matches_hedged_cs(N):
+    x = np.random.default_rng(11).beta(2, 5, 600)
+    l, u = hedged_cs(x, alpha=0.1, N=N, breaks=200)
+    cs = HedgedConfidenceSequence(alpha=0.1, N=0 if N is None else N, breaks=200)
+    online = np.array([cs.update(batch) for batch in np.array_split(x, 60)])
+    assert cs.num_observations == len(x)
+    ends = np.cumsum([len(batch) for batch in np.array_split(x, 60)]) - 1
+    assert np.allclose(online[:, 0], l[ends], atol=1 / 200)
+    assert np.allclose(online[:, 1], u[ends], atol=1 / 200)
+    assert cs.interval == tuple(online[-1])
+    with pytest.raises(ValueError):
+        cs.update(1.5)
+    path = HedgedConfidenceSequence(alpha=0.1, N=0 if N is None else N, breaks=200)
+    path_l, path_u = path.update_path(x)
+    assert np.array_equal(path_l[ends], online[:, 0])
+    assert np.array_equal(path_u[ends], online[:, 1])
+
+
+def test_importance_weighted_betting_cs():
+    rng = np.random.default_rng(13)
+    n, max_weight = 3000, 4
+    y = rng.beta(2, 5, n)
+    # Weights of 0 or max_weight with mean 1, as from a uniform logging policy
+    # over four actions and a deterministic target policy.
+    weights = max_weight * (rng.integers(0, max_weight, n) == 0)
+    l, u = betting_cs(y, breaks=200, weights=weights, max_weight=max_weight)
+    assert l[-1] < 2 / 7 < u[-1]
+    pruned_l, pruned_u = betting_cs(
+        y, breaks=200, weights=weights, max_weight=max_weight, prune_rejected=True
+    )
+    assert pruned_l[-1] < 2 / 7 < pruned_u[-1]
+
+    cs = HedgedConfidenceSequence(breaks=200, max_weight=max_weight)
+    lower, upper = cs.update(y, weights=weights)
+    assert lower < 2 / 7 < upper
+    with pytest.raises(ValueError):
+        betting_cs(y, weights=weights)
+    with pytest.raises(ValueError):
+        betting_cs(y, weights=weights, max_weight=2)
+
+
+@pytest.mark.parametrize("N", [None, 400])
+def test_betting_ci_seq_native_matches_prefixes(N):
+    x = np.random.default_rng(12).beta(2, 5, 300)
+    times = [10, 100, 300]
+    for strategy, prefix_fn in [
+        ("predmix_eb", lambda n: BettingStrategy("predmix_eb")),
+        (
+            BettingStrategy("predmix_eb", fixed_horizon=True),
+            lambda n: BettingStrategy("predmix_eb", fixed_n=n),
+        ),
+    ]:
+        l, u = betting_ci_seq(
+            x, 0.05, times, lambdas_fns_positive=strategy, N=N, breaks=100
+        )
+        for i, time in enumerate(times):
+            expected_l, expected_u = betting_cs(
+                x[0:time],
+                lambdas_fns_positive=prefix_fn(time),
+                N=N,
+                breaks=100,
+                running_intersection=True,
+                trunc_scale=0.9,
+            )
+            assert l[i] == expected_l[-1]
+            assert u[i] == expected_u[-1]
+
+
+def test_betting_first_rejections_match_capital_processes():
+    rng = np.random.default_rng(14)
+    x = rng.uniform(0.2, 0.7, 1000)
+    lambdas = np.full(len(x), 0.8)
+    nulls = np.linspace(0, 1, 51)
+    times = capital_processes.betting_first_rejections(
+        x, nulls, lambdas, lambdas, 20
+    )
+    assert np.any(times > 0) and np.any(times == 0)
+    for null, time in zip(nulls, times):
+        capital = capital_processes.betting_capital_process(
+            x, null, lambdas, lambdas
+        )
+        rejected = np.flatnonzero(capital > 20)
+        assert time == (rejected[0] + 1 if len(rejected) else 0)
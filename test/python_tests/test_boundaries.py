@@ -0,0 +1,632 @@
+import pickle
+import pytest
+
+import numpy as np
+from confseq.boundaries import *
+
+
+def test_mixture_classes_match_functions():
+    v = np.arange(1, 1001)
+    s = np.sqrt(v)
+
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2)
+    assert np.allclose(
+        mixture.log_superMG(s, v), gamma_exponential_log_mixture(s, v, 100, 2)
+    )
+    assert np.allclose(
+        mixture.bound(v, 0.05), gamma_exponential_mixture_bound(v, 0.05, 100, 2)
+    )
+    assert np.allclose(mixture.bound_sequence(v, 0.05), mixture.bound(v, 0.05))
+
+    mixture = BetaBinomialMixture(v_opt=100, alpha_opt=0.05, g=0.2, h=0.8)
+    assert np.allclose(
+        mixture.bound(v, 0.05), beta_binomial_mixture_bound(v, 0.05, 100, 0.2, 0.8)
+    )
+
+    mixture = TwoSidedNormalMixture(v_opt=100)
+    boundary = MixtureBoundary(mixture)
+    assert np.allclose(
+        boundary(v, 0.05), normal_mixture_bound(v, 0.05, 100, is_one_sided=False)
+    )
+
+    bound = PolyStitchingBound(v_min=10, c=3)
+    assert np.allclose(bound(v, 0.05), poly_stitching_bound(v, 0.05, 10, 3))
+    alpha = np.linspace(0.01, 0.2, len(v))
+    assert np.allclose(bound(v, alpha), poly_stitching_bound(v, alpha, 10, 3))
+    assert np.allclose(
+        poly_stitching_bound(v, 0.05, np.array([10, 20]).reshape(2, 1), 3),
+        np.stack([bound(v, 0.05), PolyStitchingBound(v_min=20, c=3)(v, 0.05)]),
+    )
+    assert isinstance(poly_stitching_bound(100, 0.05, 10), float)
+
+
+def test_float32_bounds():
+    v = np.geomspace(1, 1e6, 1000, dtype=np.float32)
+    exact = normal_mixture_bound(v.astype(float), 0.05, 100, is_one_sided=False)
+    bound = normal_mixture_bound(v, 0.05, 100, is_one_sided=False)
+    assert bound.dtype == np.float32
+    assert np.allclose(bound, exact)
+
+    stitching = PolyStitchingBound(v_min=10, c=3)
+    assert stitching(v, 0.05).dtype == np.float32
+    assert np.allclose(stitching(v, 0.05), stitching(v.astype(float), 0.05))
+    assert np.allclose(poly_stitching_bound(v, 0.05, 10, 3), stitching(v, 0.05))
+
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=1)
+    table = TabulatedBoundary(mixture, alpha=0.05, v_min=1, v_max=1e6)
+    assert table(v).dtype == np.float32
+    assert all(table(v) >= table(v.astype(float)))
+
+
+def test_boundary_sequence():
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=1)
+    n = 10**9
+    sequence = BoundarySequence(mixture, 0.05, n, v_scale=0.25, chunk_size=100)
+    assert len(sequence) == n
+    assert sequence.num_cached_chunks == 0
+    assert np.isclose(sequence[0], mixture.bound(0.25, 0.05))
+    assert np.isclose(sequence[-1], mixture.bound(n / 4, 0.05))
+    assert sequence.num_cached_chunks == 2
+
+    t = np.arange(1000, 1300)
+    assert np.allclose(sequence[999:1299], mixture.bound(t / 4, 0.05))
+    assert np.allclose(sequence[999:1299:7], mixture.bound(t[::7] / 4, 0.05))
+    try:
+        sequence[n]
+        assert False
+    except IndexError:
+        pass
+
+    short = BoundarySequence(mixture, 0.05, 1000, chunk_size=10)
+    values = []
+    for value in short:
+        values.append(value)
+        assert short.num_cached_chunks <= 1
+    assert np.allclose(values, mixture.bound(np.arange(1, 1001), 0.05))
+
+
+def test_tabulated_boundary():
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=1)
+    table = TabulatedBoundary(mixture, alpha=0.05, v_min=1, v_max=1e4)
+    v = np.linspace(1, 1e4, 500)
+    exact = mixture.bound(v, 0.05)
+    assert all(table(v) >= exact)
+    assert np.allclose(table(v), exact, rtol=1e-3)
+
+    loaded = pickle.loads(pickle.dumps(table))
+    assert np.array_equal(loaded(v), table(v))
+
+
+def test_tabulated_beta_binomial_mixture():
+    mixture = BetaBinomialMixture(v_opt=100, alpha_opt=0.05, g=0.3, h=0.7)
+    table = TabulatedBetaBinomialMixture(mixture, v_min=1, v_max=1e4)
+    v = np.geomspace(1, 1e4, 200)
+    s = np.sqrt(v) * np.linspace(-3, 3, 200)
+    exact = mixture.log_superMG(s, v)
+    lower, upper = table.log_superMG_bounds(s, v)
+    assert all(lower <= exact) and all(exact <= upper)
+    assert np.array_equal(table.log_superMG(s, v), lower)
+    assert np.allclose(lower, exact, atol=0.1)
+    assert all(table.bound(v, 0.05) >= mixture.bound(v, 0.05))
+
+
+def test_boundary_cache():
+    enable_boundary_cache(capacity=10)
+    try:
+        first = gamma_exponential_mixture_bound(100, 0.05, 100, 2)
+        assert gamma_exponential_mixture_bound(100, 0.05, 100, 2) == first
+        stats = boundary_cache_stats()
+        assert stats["hits"] == 1
+        assert stats["misses"] == 1
+        assert stats["capacity"] == 10
+        gamma_exponential_mixture_bound(np.arange(1, 101), 0.05, 100, 2)
+        assert boundary_cache_stats()["size"] == 10
+        clear_boundary_cache()
+        assert boundary_cache_stats()["size"] == 0
+    finally:
+        disable_boundary_cache()
+
+
+def test_constants_bundle(tmp_path):
+    def evaluate():
+        return (
+            gamma_exponential_log_mixture(30, 100, 100, 2),
+            gamma_poisson_log_mixture(30, 100, 100, 2),
+            beta_binomial_log_mixture(10, 100, 100, 0.3, 0.7),
+        )
+
+    unload_constants_bundle()
+    computed = evaluate()
+    path = str(tmp_path / "constants.bin")
+    count = write_constants_bundle(path)
+    try:
+        assert load_constants_bundle(path) == count > 0
+        assert evaluate() == computed
+    finally:
+        unload_constants_bundle()
+    with pytest.raises(RuntimeError):
+        load_constants_bundle(str(tmp_path / "missing.bin"))
+
+
+def test_bernoulli_confidence_sequence():
+    sequence = BernoulliConfidenceSequence(alpha=0.05, t_opt=100)
+    successes = 0
+    for trials in range(1, 101):
+        successes += trials % 2
+        lower, upper = sequence.update(trials % 2, 1)
+        expected = bernoulli_confidence_interval(successes, trials, 0.05, 100)
+        assert np.allclose((lower, upper), expected, atol=1e-9)
+    assert sequence.num_trials == 100
+    assert sequence.interval == (lower, upper)
+
+
+def test_bernoulli_confidence_sequence_pickles():
+    sequence = BernoulliConfidenceSequence(alpha=0.05, t_opt=100)
+    sequence.update(7, 20)
+    restored = pickle.loads(pickle.dumps(sequence))
+    assert restored.interval == sequence.interval
+    assert restored.update(3, 10) == sequence.update(3, 10)
+
+
+def test_batched_bernoulli_confidence_interval():
+    successes = np.array([0, 5, 50, 500, 1000])
+    trials = np.array([10, 10, 100, 1000, 1000])
+    t_opt = np.array([10, 100, 100, 1000, 10])
+    lower, upper = bernoulli_confidence_interval(successes, trials, 0.05, t_opt)
+    for i in range(len(successes)):
+        expected = bernoulli_confidence_interval(
+            int(successes[i]), int(trials[i]), 0.05, int(t_opt[i])
+        )
+        assert (lower[i], upper[i]) == expected
+
+
+def test_status_reporting_batches():
+    mixture = GammaPoissonMixture(v_opt=100, alpha_opt=0.05, c=2)
+    v = np.array([100, -1, 1e300, 1000])
+    bound, status = mixture.bound_with_status(v, 0.05)
+    assert list(status) == [
+        EvaluationStatus.OK.value,
+        EvaluationStatus.INVALID_ARGUMENT.value,
+        EvaluationStatus.NUMERICAL_ERROR.value,
+        EvaluationStatus.OK.value,
+    ]
+    assert np.allclose(bound[[0, 3]], mixture.bound(v[[0, 3]], 0.05))
+    assert np.isnan(bound[[1, 2]]).all()
+
+    lower, upper, status = bernoulli_confidence_interval_with_status(
+        np.array([3, 5, 0]), np.array([10, 4, 20]), 0.05, 100
+    )
+    assert list(status) == [
+        EvaluationStatus.OK.value,
+        EvaluationStatus.INVALID_ARGUMENT.value,
+        EvaluationStatus.OK.value,
+    ]
+    assert (lower[0], upper[0]) == bernoulli_confidence_interval(3, 10, 0.05, 100)
+    assert np.isnan(lower[1]) and np.isnan(upper[1])
+
+
+def test_bernoulli_cs_table(tmp_path):
+    table = BernoulliCSTable(n_max=50, alpha=0.05, t_opt=20)
+    successes = np.arange(0, 51)
+    lower, upper = table(successes, 50)
+    expected_lower, expected_upper = bernoulli_confidence_interval(
+        successes, 50, 0.05, 20
+    )
+    assert np.allclose(lower, expected_lower, atol=1e-9)
+    assert np.allclose(upper, expected_upper, atol=1e-9)
+
+    path = str(tmp_path / "table.bin")
+    table.save(path)
+    mapped = BernoulliCSTable.map_file(path)
+    assert mapped.n_max == 50
+    assert mapped(10, 50) == table(10, 50)
+
+
+def test_tabulated_boundary_map_file(tmp_path):
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=1)
+    table = TabulatedBoundary(mixture, alpha=0.05, v_min=1, v_max=1e4)
+    path = str(tmp_path / "boundary.bin")
+    table.save(path)
+    mapped = TabulatedBoundary.map_file(path)
+    v = np.logspace(-1, 5, 50)
+    assert mapped.alpha == 0.05
+    assert np.array_equal(mapped(v), table(v))
+
+
+def test_fast_precision_is_conservative():
+    v = np.logspace(0, 4, 50)
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2)
+    exact = mixture.bound(v, 0.05)
+    mixture.precision = SolverPrecision.fast()
+    fast = mixture.bound(v, 0.05)
+    assert np.all(fast >= exact)
+    assert np.allclose(fast, exact, rtol=1e-5)
+
+    sequence = BernoulliConfidenceSequence(
+        0.05, 100, precision=SolverPrecision.fast()
+    )
+    lower, upper = sequence.update(30, 100)
+    expected_lower, expected_upper = bernoulli_confidence_interval(30, 100, 0.05, 100)
+    assert lower <= expected_lower + 1e-11 and upper >= expected_upper - 1e-11
+
+
+def test_reduced_precision_simplified_bounds():
+    v = np.logspace(0, 6, 50)
+    for precision in [SolverPrecision.balanced(), SolverPrecision.fast()]:
+        assert precision.special_functions != SpecialFunctionPrecision.FULL
+        exact = gamma_poisson_mixture_bound(v, 0.05, 100, 2)
+        bound = gamma_poisson_mixture_bound(v, 0.05, 100, 2, precision=precision)
+        assert np.all(bound >= exact)
+        assert np.allclose(bound, exact, rtol=1e-4)
+        exact = beta_binomial_mixture_bound(v, 0.05, 100, 0.2, 0.8)
+        bound = beta_binomial_mixture_bound(
+            v, 0.05, 100, 0.2, 0.8, precision=precision
+        )
+        assert np.all(bound >= exact)
+        assert np.allclose(bound, exact, rtol=1e-4)
+
+
+def test_solver_counters():
+    reset_solver_counters()
+    assert solver_counters()["solves"] == 0
+    GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2).bound(1000, 0.05)
+    bernoulli_confidence_interval(30, 100, 0.05, 100)
+    counters = solver_counters()
+    if not instrumentation_enabled:
+        assert all(count == 0 for count in counters.values())
+        return
+    assert counters["solves"] == 3
+    assert counters["halley_steps"] > 0
+    assert counters["special_function_calls"] > 0
+    assert 0 < counters["max_evaluations_per_solve"] <= counters[
+        "objective_evaluations"
+    ]
+
+
+def test_latency_histogram():
+    enable_latency_histogram()
+    try:
+        gamma_exponential_mixture_bound(np.logspace(1, 4, 20), 0.05, 100, 2)
+        bernoulli_confidence_interval(30, 100, 0.05, 100)
+        snapshot = latency_snapshot()
+        assert snapshot["gamma_exponential_mixture_bound"]["count"] == 20
+        assert snapshot["bernoulli_confidence_interval"]["count"] == 1
+        stats = snapshot["gamma_exponential_mixture_bound"]
+        assert 0 < stats["p50_ns"] <= stats["p99_ns"]
+        assert "bernoulli_confidence_interval" in dump_latency_histogram()
+        reset_latency_histogram()
+        assert latency_snapshot() == {}
+    finally:
+        disable_latency_histogram()
+    assert latency_snapshot() == {}
+
+
+def test_crossing_simulations():
+    data = SimulatedData.gaussian(0.5, 1)
+    mixture = OneSidedNormalMixture(v_opt=100, alpha_opt=0.05)
+    result = simulate_mixture_crossings(mixture, data, 0.1, 500, 1000, seed=3)
+    assert result.replicates == 1000
+    assert result.crossings == np.count_nonzero(result.crossing_times)
+    assert result.crossing_fraction <= 0.1 + 3 * result.standard_error
+    serial = simulate_mixture_crossings(
+        mixture, data, 0.1, 500, 1000, seed=3, num_threads=1
+    )
+    assert np.array_equal(serial.crossing_times, result.crossing_times)
+
+    bounded = simulate_boundary_crossings(
+        PolyStitchingBound(v_min=1), data, 500, 1000, alpha=0.1, two_sided=True
+    )
+    assert bounded.crossing_fraction <= 0.1 + 3 * bounded.standard_error
+    table = TabulatedBoundary(mixture, alpha=0.1, v_min=1, v_max=1000)
+    tabulated = simulate_boundary_crossings(table, data, 500, 1000, seed=3)
+    assert tabulated.crossings <= result.crossings
+
+
+def test_two_sample_mean_test():
+    rng = np.random.default_rng(8)
+    control = rng.uniform(0, 0.5, 300)
+    treatment = rng.uniform(0, 1, 280)
+    test = TwoSampleMeanTest(t_opt=100)
+    lower, upper = test.update(control=control[:100])
+    assert (lower, upper) == (-1, 1)
+    lower, upper = test.update(control=control[100:], treatment=treatment)
+    assert test.num_pairs == 280 and test.num_control == 300
+    successes = np.sum((treatment - control[:280] + 1) / 2)
+    expected = bernoulli_confidence_interval(successes, 280, 0.05, 100)
+    assert np.allclose((lower, upper), 2 * np.array(expected) - 1, atol=1e-8)
+    assert lower > 0 and test.p_value < 0.05
+
+    lower, upper, p_value = two_sample_mean_tests(
+        control,
+        [0, 100, 300],
+        treatment,
+        [0, 80, 280],
+        mixture="gamma_exponential",
+        v_opt=10,
+        c=2,
+    )
+    single = TwoSampleMeanTest(mixture="gamma_exponential", v_opt=10, c=2)
+    single.update(control[100:], treatment[80:])
+    assert (lower[1], upper[1]) == single.interval
+    assert p_value[1] == single.p_value
+
+    sparse = TwoSampleMeanTest(t_opt=100, readout_eta=2)
+    dense = TwoSampleMeanTest(t_opt=100)
+    for k in range(280):
+        sparse.update(control[k : k + 1], treatment[k : k + 1])
+        dense.update(control[k : k + 1], treatment[k : k + 1])
+    # The last readout was at 256 pairs.
+    assert sparse.p_value >= dense.p_value
+    assert np.allclose(sparse.readout(), dense.interval, atol=1e-8)
+
+
+def test_average_treatment_effect_cs():
+    rng = np.random.default_rng(11)
+    n = 400
+    propensity = rng.uniform(0.3, 0.7, n)
+    treatment = (rng.uniform(size=n) < propensity).astype(float)
+    y = np.clip(rng.uniform(0, 0.8, n) + 0.2 * treatment, 0, 1)
+    cs = AverageTreatmentEffectCS(v_opt=50, min_propensity=0.3)
+    first = cs.update(y[:150], treatment[:150], propensity[:150])
+    rest = cs.update(y[150:], treatment[150:], propensity[150:])
+    rows = {key: np.concatenate([first[key], rest[key]]) for key in first}
+    assert np.array_equal(rows["t"], np.arange(1, n + 1))
+
+    def lagged_arm_means(selector):
+        means = np.cumsum(y * selector) / np.maximum(1, np.cumsum(selector))
+        means = np.where(np.cumsum(selector) == 0, 0.5, means)
+        return np.concatenate([[0.5], means[:-1]])
+
+    y1_hat = lagged_arm_means(treatment == 1)
+    y0_hat = lagged_arm_means(treatment == 0)
+    residuals = (
+        (treatment - propensity)
+        / (propensity * (1 - propensity))
+        * (y - np.where(treatment == 1, y1_hat, y0_hat))
+    )
+    s = np.cumsum(y1_hat - y0_hat + residuals)
+    v = np.cumsum(residuals**2)
+    t = np.arange(1, n + 1)
+    radius = gamma_exponential_mixture_bound(v, 0.025, 50, 2 / 0.3, 0.025) / t
+    assert np.allclose(rows["point_estimate"], s / t)
+    assert np.allclose(
+        rows["upper_confidence_bound"], np.minimum(1, s / t + radius)
+    )
+    assert np.allclose(
+        rows["lower_confidence_bound"], np.maximum(-1, s / t - radius)
+    )
+    p_value = np.exp(-gamma_exponential_log_mixture(s, v, 50, 2 / 0.3, 0.025))
+    assert np.allclose(rows["p_value"], np.minimum(1, p_value))
+    assert cs.estimate["t"][0] == n
+
+    every_tenth = AverageTreatmentEffectCS(
+        v_opt=50, min_propensity=0.3, cadence=10
+    )
+    sparse = every_tenth.update(y, treatment, propensity)
+    assert np.array_equal(sparse["t"], t[9::10])
+    assert np.allclose(
+        sparse["upper_confidence_bound"], rows["upper_confidence_bound"][9::10]
+    )
+
+
+def test_p_values_match_log_mixtures():
+    v = np.arange(1.0, 2001.0)
+    s = 0.1 * v + 10 * np.sin(v / 50)
+    expected = np.minimum(1, np.exp(-normal_log_mixture(s, v, 100)))
+    assert np.allclose(normal_p_value(s, v, 100), expected)
+    assert np.allclose(
+        normal_p_value(s, v, 100, running_min=True), np.minimum.accumulate(expected)
+    )
+    assert np.allclose(
+        gamma_exponential_p_value(s, v, 100, 2),
+        np.minimum(1, np.exp(-gamma_exponential_log_mixture(s, v, 100, 2))),
+    )
+    assert np.allclose(
+        gamma_poisson_p_value(s, v, 100, 2, running_min=True),
+        np.minimum.accumulate(
+            np.minimum(1, np.exp(-gamma_poisson_log_mixture(s, v, 100, 2)))
+        ),
+    )
+    assert np.allclose(
+        beta_binomial_p_value(s, v, 100, 0.5, 0.5, is_one_sided=False),
+        np.minimum(
+            1,
+            np.exp(
+                -beta_binomial_log_mixture(
+                    s, v, 100, 0.5, 0.5, is_one_sided=False
+                )
+            ),
+        ),
+    )
+    mixture = TwoSidedNormalMixture(100)
+    assert np.allclose(
+        mixture.p_value(s, v),
+        np.minimum(1, np.exp(-normal_log_mixture(s, v, 100, is_one_sided=False))),
+    )
+    assert isinstance(normal_p_value(10.0, 100.0, 100), float)
+
+
+
+def test_mixture_first_crossings_match_running_minimum():
+    v = np.arange(1.0, 5001.0)
+    drifting = 0.05 * v + 30 * np.sin(v / 300)
+    flat = 30 * np.sin(v / 300)
+    mixture = GammaExponentialMixture(100, 0.05, 2)
+    times, p_values = mixture_first_crossings(
+        mixture,
+        np.concatenate([drifting, flat]),
+        np.concatenate([v, v]),
+        [0, len(v), len(v), 2 * len(v)],
+    )
+    running_min = mixture.p_value(drifting, v, running_min=True)
+    expected = np.argmax(running_min <= 0.05) + 1
+    assert times[0] == expected
+    assert p_values[0] == running_min[expected - 1]
+    assert times[1] == 0 and p_values[1] == 1
+    assert times[2] == 0
+    assert p_values[2] == mixture.p_value(flat, v, running_min=True)[-1]
+
+
+def test_gamma_exponential_mixture_batch_matches_mixtures():
+    v_opt = np.arange(10.0, 310.0)
+    c = 0.5 + (np.arange(len(v_opt)) % 7) / 2
+    v = 1.0 + (np.arange(len(v_opt)) * 37) % 5000
+    s = np.sqrt(v)
+    batch = GammaExponentialMixtureBatch(v_opt, 0.05, c)
+    assert len(batch) == len(v_opt)
+    log_superMG = batch.log_superMG(s, v)
+    bounds = batch.bound(v, 0.05)
+    for i in [0, 17, len(v_opt) - 1]:
+        mixture = GammaExponentialMixture(v_opt[i], 0.05, c[i])
+        assert log_superMG[i] == mixture.log_superMG(s[i], v[i])
+        assert bounds[i] == mixture.bound(v[i], 0.05)
+        assert batch.mixture(i).bound(v[i], 0.05) == bounds[i]
+
+
+def test_gamma_exponential_log_superMG_spaced():
+    mixture = GammaExponentialMixture(100, 0.05, 1)
+    s = 3 * np.sqrt(np.arange(1.0, 1001.0)) * np.sin(np.arange(1000) / 40)
+    v = 1 + np.arange(1000.0)
+    assert np.allclose(
+        mixture.log_superMG_spaced(s, 1, 1), mixture.log_superMG(s, v), rtol=1e-12
+    )
+
+def test_bound_multi_matches_bound():
+    v = np.array([10.0, 100.0, 1000.0])
+    alpha = np.array([0.2, 0.1, 0.05, 0.01])
+    for mixture in [
+        OneSidedNormalMixture(100),
+        TwoSidedNormalMixture(100),
+        GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2),
+        BetaBinomialMixture(v_opt=100, alpha_opt=0.05, g=0.2, h=0.8),
+    ]:
+        bounds = mixture.bound_multi(v, alpha)
+        assert bounds.shape == (3, 4)
+        assert np.allclose(bounds, mixture.bound(v[:, None], alpha[None, :]))
+
+
+def test_tune_mixture():
+    v = np.linspace(10, 10000, 500)
+    weights = np.exp(-np.log(v / 1000) ** 2) / v
+    mixtures = [TwoSidedNormalMixture(v_opt) for v_opt in [10, 1000, 1e5]]
+    best_index, losses, bounds = tune_mixture(mixtures, v, weights, alpha=0.05)
+    assert best_index == 1
+    assert bounds.shape == (3, 500)
+    for mixture, loss, row in zip(mixtures, losses, bounds):
+        assert np.allclose(row, mixture.bound(v, 0.05))
+        assert np.isclose(loss, np.sum(weights * row))
+    _, unweighted, _ = tune_mixture(mixtures, v)
+    assert np.allclose(unweighted, bounds.mean(axis=1))
+
+
+def test_e_bh_procedure():
+    n = 1000
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2)
+    s = np.where(np.arange(n) < 50, 150.0, 40 * np.sin(np.arange(n) * 1.1))
+    v = np.full(n, 500.0)
+    procedure = EBHProcedure(n, alpha=0.05)
+    assert procedure.num_rejections == 0
+    num_rejections = procedure.update_from_mixture(mixture, s, v)
+    assert num_rejections >= 50
+    assert procedure.update(mixture.log_superMG(s, v)) == num_rejections
+
+    log_e = np.sort(procedure.log_e_values)[::-1]
+    k = np.arange(1, n + 1)
+    passing = np.nonzero(log_e >= np.log(n / (0.05 * k)))[0]
+    assert num_rejections == passing[-1] + 1
+    assert procedure.rejections().sum() == num_rejections
+
+    procedure.update(np.zeros(3), indices=np.array([0, 1, 2]))
+    assert not procedure.rejections()[:3].any()
+
+
+def test_mixture_sufficient_statistics():
+    s_increments = np.sin(np.arange(1000) * 0.9) + 0.1
+    v_increments = np.full(1000, 0.5)
+    pooled = MixtureSufficientStatistics()
+    pooled.add(s_increments, v_increments)
+    merged = MixtureSufficientStatistics()
+    for shard in range(4):
+        stats = MixtureSufficientStatistics()
+        stats.add(s_increments[shard::4], v_increments[shard::4])
+        merged.merge(MixtureSufficientStatistics.from_bytes(stats.to_bytes()))
+    assert merged.num_observations == 1000
+    assert np.isclose(merged.s, pooled.s)
+    assert np.isclose(merged.v, pooled.v)
+
+    mixture = GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2)
+    assert np.isclose(merged.p_value(mixture), pooled.p_value(mixture))
+    assert len(merged.to_bytes()) == 40
+    restored = pickle.loads(pickle.dumps(merged))
+    assert restored.s == merged.s and restored.v == merged.v
+
+
+def test_keyed_stores_match_single_streams(tmp_path):
+    from confseq.capital_processes import ConjmixEmpBernAccumulator
+
+    rng = np.random.default_rng(11)
+    keys = rng.integers(0, 2**40, 8)[rng.integers(0, 8, 3000)]
+    x = (rng.uniform(size=keys.size) < 0.3).astype(float)
+
+    bernoulli = KeyedBernoulliCS(alpha=0.05, t_opt=100, n_max=200)
+    bernoulli.update(keys, x)
+    lower, upper = bernoulli.query(keys[:20])
+    for key, l, u in zip(keys[:20], lower, upper):
+        stream = x[keys == key]
+        expected = bernoulli_confidence_interval(stream.sum(), stream.size, 0.05, 100)
+        assert np.allclose((l, u), expected, atol=1e-9)
+    assert len(bernoulli) == np.unique(keys).size
+    assert bernoulli.interval(2**41) == (0, 1)
+    with pytest.raises(ValueError):
+        bernoulli.update(keys[:2], [1, 0.5])
+
+    conjmix = KeyedConjmixEmpBernCS(v_opt=10)
+    conjmix.update(keys, x)
+    for key in np.unique(keys):
+        accumulator = ConjmixEmpBernAccumulator(v_opt=10)
+        accumulator.update(x[keys == key])
+        l, u = conjmix.interval(key)
+        assert l <= accumulator.interval[0] + 1e-12
+        assert u >= accumulator.interval[1] - 1e-12
+        assert np.allclose((l, u), accumulator.interval, atol=1e-4)
+
+    path = str(tmp_path / "conjmix.bin")
+    conjmix.save(path)
+    pickled = pickle.loads(pickle.dumps(conjmix))
+    for restored in (KeyedConjmixEmpBernCS.load(path), pickled):
+        assert np.array_equal(restored.query(keys)[0], conjmix.query(keys)[0])
+
+
+def test_ufunc_out_and_where():
+    v = np.arange(1.0, 1001.0)
+    s = np.sqrt(v)
+    expected = normal_mixture_bound(v, 0.05, 100)
+
+    out = np.zeros_like(v)
+    assert normal_mixture_bound(v, 0.05, 100, out=out) is out
+    assert np.allclose(out, expected)
+
+    out = np.full_like(v, -1.0)
+    mask = v > 500
+    normal_mixture_bound(v, 0.05, 100, out=out, where=mask)
+    assert np.allclose(out[mask], expected[mask])
+    assert np.all(out[~mask] == -1)
+    assert np.all(np.isnan(normal_mixture_bound(v, 0.05, 100, where=False)))
+
+    # Scalar mixture parameters take the constructed-mixture overload, and
+    # arrays of them the elementwise one; both accept out.
+    log_mixture = np.empty_like(v)
+    gamma_exponential_log_mixture(s, v, 100, 2, out=log_mixture)
+    assert np.allclose(
+        log_mixture,
+        GammaExponentialMixture(v_opt=100, alpha_opt=0.05, c=2).log_superMG(s, v),
+    )
+    assert np.allclose(
+        gamma_exponential_log_mixture(s, v, np.full_like(v, 100), 2, out=out),
+        log_mixture,
+    )
+
+    with pytest.raises(TypeError):
+        normal_mixture_bound(v, 0.05, 100, out=np.zeros(len(v), dtype=np.int64))
+    with pytest.raises(ValueError):
+        normal_mixture_bound(v, 0.05, 100, out=np.zeros(len(v) + 1))
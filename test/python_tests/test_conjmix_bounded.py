@@ -24,3 +24,95 @@ def test_nested_cs():
 
     assert all([all(lower_CSs[i] <= lower_CSs[i]) for i in range(len(alphas) - 1)])
     assert all([all(upper_CSs[i] >= upper_CSs[i]) for i in range(len(alphas) - 1)])
+
+
+def test_conjmix_empbern_cs_matches_numpy_and_accumulator():
+    from confseq.boundaries import gamma_exponential_mixture_bound
+    from confseq.capital_processes import ConjmixEmpBernAccumulator
+
+    x = np.random.default_rng(3).beta(2, 5, 500)
+    t = np.arange(1, len(x) + 1)
+    mu_hat_t = np.cumsum(x) / t
+    mu_hat_tminus1 = np.append(1 / 2, mu_hat_t[0:-1])
+    V_t = np.cumsum(np.power(x - mu_hat_tminus1, 2))
+    bdry = (
+        gamma_exponential_mixture_bound(
+            V_t, alpha=0.05 / 2, v_opt=50, c=1, alpha_opt=0.05 / 2
+        )
+        / t
+    )
+    l, u = conjmix_empbern_cs(x, v_opt=50, alpha=0.05)
+    assert np.allclose(l, np.maximum(mu_hat_t - bdry, 0))
+    assert np.allclose(u, np.minimum(mu_hat_t + bdry, 1))
+
+    l, u = conjmix_empbern_cs(x, v_opt=50, alpha=0.05, running_intersection=True)
+    cs = ConjmixEmpBernAccumulator(v_opt=50, alpha=0.05, running_intersection=True)
+    for start, stop in [(0, 1), (1, 120), (120, 500)]:
+        assert cs.update(x[start:stop]) == (l[stop - 1], u[stop - 1])
+    assert cs.num_observations == len(x)
+
+
+def test_conjmix_empbern_readouts_match_dense_cs():
+    from confseq.boundaries import geometric_readout_times
+    from confseq.capital_processes import confidence_sequence_readouts
+
+    x = np.random.default_rng(5).beta(2, 5, 2000)
+    l, u = conjmix_empbern_cs(x, v_opt=50, alpha=0.05)
+    times, lower, upper = confidence_sequence_readouts(
+        x, eta=1.5, cs="conjmix_empbern", v_opt=50
+    )
+    assert list(times) == geometric_readout_times(len(x), 1.5)
+    assert times[-1] == len(x)
+    assert np.allclose(lower, l[times - 1], atol=1e-9)
+    assert np.allclose(upper, u[times - 1], atol=1e-9)
+
+    times, lower, upper = confidence_sequence_readouts(
+        x, times=[10, 500], cs="conjmix_empbern", v_opt=50
+    )
+    assert np.allclose(lower, l[[9, 499]], atol=1e-9)
+
+
+def test_intersected_cs_matches_separate_sequences():
+    from confseq.betting import hedged_cs
+    from confseq.capital_processes import intersected_cs
+    from confseq.predmix import predmix_empbern_cs
+
+    x = np.random.default_rng(6).beta(2, 5, 800)
+    alpha = 0.05 / 3
+    ls, us = zip(
+        predmix_empbern_cs(x, alpha=alpha),
+        conjmix_empbern_cs(x, v_opt=50, alpha=alpha),
+        hedged_cs(x, alpha=alpha, breaks=100),
+    )
+    lower, upper = intersected_cs(x, v_opt=50, breaks=100)
+    assert np.allclose(lower, np.max(ls, axis=0), atol=1e-9)
+    assert np.allclose(upper, np.min(us, axis=0), atol=1e-9)
+
+    lower, upper = intersected_cs(
+        x, v_opt=50, breaks=100, running_intersection=True
+    )
+    assert np.allclose(lower, np.maximum.accumulate(np.max(ls, axis=0)))
+    assert np.allclose(upper, np.minimum.accumulate(np.min(us, axis=0)))
+
+
+def test_conjmix_hoeffding_cs_matches_numpy_and_accumulator():
+    from confseq.boundaries import normal_mixture_bound
+    from confseq.capital_processes import ConjmixHoeffdingAccumulator
+
+    x = np.random.default_rng(4).uniform(size=400)
+    t = np.arange(1, len(x) + 1)
+    bdry = (
+        normal_mixture_bound(
+            t / 4, alpha=0.05, v_opt=100 / 4, alpha_opt=0.05, is_one_sided=False
+        )
+        / t
+    )
+    mu_hat_t = np.cumsum(x) / t
+    l, u = conjmix_hoeffding_cs(x, t_opt=100, alpha=0.05)
+    assert np.allclose(l, np.maximum(mu_hat_t - bdry, 0))
+    assert np.allclose(u, np.minimum(mu_hat_t + bdry, 1))
+
+    l, u = conjmix_hoeffding_cs(x, t_opt=100, running_intersection=True)
+    cs = ConjmixHoeffdingAccumulator(t_opt=100, running_intersection=True)
+    for start, stop in [(0, 1), (1, 250), (250, 400)]:
+        assert cs.update(x[start:stop]) == (l[stop - 1], u[stop - 1])
@@ -1,7 +1,16 @@
 import numpy as np
 import math
+import pickle
 from confseq.predmix import *
 import pytest
+from confseq.capital_processes import (
+    PredmixEmpBernAccumulator,
+    PredmixEmpBernWoRAccumulator,
+    PredmixHoeffdingAccumulator,
+    PredmixHoeffdingWoRAccumulator,
+    simulate_cs_miscoverage,
+)
+from confseq.boundaries import SimulatedData
 
 
 def test_lambda_predmix_eb():
@@ -77,6 +86,142 @@ def test_predmix_confidence_sequences():
     )
 
 
+@pytest.mark.parametrize("running_intersection", [False, True])
+def test_predmix_accumulators_match_batch(running_intersection):
+    x = np.random.default_rng(5).beta(2, 3, 300)
+    batch_fns = [
+        (
+            PredmixEmpBernAccumulator(
+                alpha=0.1, running_intersection=running_intersection
+            ),
+            predmix_empbern_cs(
+                x, alpha=0.1, running_intersection=running_intersection
+            ),
+        ),
+        (
+            PredmixHoeffdingAccumulator(
+                alpha=0.1, running_intersection=running_intersection
+            ),
+            predmix_hoeffding_cs(
+                x, alpha=0.1, running_intersection=running_intersection
+            ),
+        ),
+    ]
+    for cs, (l, u) in batch_fns:
+        assert cs.interval == (0, 1)
+        cs.update(x[0])
+        assert np.allclose(cs.interval, (l[0], u[0]))
+        for start, stop in [(1, 50), (50, 51), (51, 300)]:
+            lower, upper = cs.update(x[start:stop])
+            assert np.isclose(lower, l[stop - 1])
+            assert np.isclose(upper, u[stop - 1])
+        assert cs.num_observations == len(x)
+
+
+@pytest.mark.parametrize("side", ["lower", "upper"])
+def test_one_sided_predmix_cs(side):
+    x = np.random.default_rng(8).beta(2, 3, 300)
+    l, u = predmix_empbern_cs(x, alpha=0.05, side=side)
+    both_l, both_u = predmix_empbern_cs(x, alpha=0.1)
+    # One side at alpha is that side of the two-sided CS at 2 * alpha.
+    if side == "lower":
+        assert np.allclose(l, both_l) and np.all(u == 1)
+    else:
+        assert np.allclose(u, both_u) and np.all(l == 0)
+    cs = PredmixEmpBernAccumulator(alpha=0.05, side=side)
+    assert np.allclose(cs.update(x), (l[-1], u[-1]))
+    with pytest.raises(ValueError):
+        predmix_empbern_cs(x, side="neither")
+
+
+def numpy_predmix_cs_wor(x, N, alpha, lower_bd, upper_bd, empbern):
+    # The NumPy transcription predmix_empbern_cs_wor and
+    # predmix_hoeffding_cs_wor replaced.
+    c = upper_bd - lower_bd
+    t = np.arange(1, len(x) + 1)
+    S_tminus1 = np.append(0, np.cumsum(x)[0:-1])
+    Zstar = S_tminus1 / (N - t + 1)
+    Wstar = (t - 1) / (N - t + 1)
+    if empbern:
+        mu_hat_tminus1 = (1 / 2 + S_tminus1) / t
+        V_t = np.cumsum(1 / 4 + np.power(x - mu_hat_tminus1, 2)) * np.power(c / 2, -2)
+        V_tminus1 = np.append(np.power(c / 2, -2), V_t[0:-1])
+        lambdas = np.sqrt(
+            8 * np.log(2 / alpha) / (V_tminus1 * np.log(1 + t) * np.power(c, 2))
+        )
+        lambdas = np.minimum(1 / (2 * c), lambdas)
+        psi = (-np.log(1 - c * lambdas) - c * lambdas) / 4
+        numerator = np.cumsum(
+            np.power(c / 2, -2) * np.power(x - mu_hat_tminus1, 2) * psi
+        )
+    else:
+        lambdas = np.sqrt(8 * np.log(2 / alpha) / (t * np.log(1 + t) * c**2))
+        lambdas = np.minimum(1 / c, lambdas)
+        numerator = np.cumsum(np.power(lambdas, 2)) * c**2 / 8
+    denominator = np.cumsum(lambdas * (1 + Wstar))
+    weighted_mu_hat_t = np.cumsum(lambdas * (x + Zstar)) / denominator
+    margin = (numerator + np.log(2 / alpha)) / denominator
+    return (
+        np.maximum(weighted_mu_hat_t - margin, lower_bd),
+        np.minimum(weighted_mu_hat_t + margin, upper_bd),
+    )
+
+
+@pytest.mark.parametrize("empbern", [False, True])
+def test_predmix_cs_wor_native(empbern):
+    N = 400
+    x = np.random.default_rng(6).uniform(1, 3, 300)
+    cs_fn = predmix_empbern_cs_wor if empbern else predmix_hoeffding_cs_wor
+    l, u = cs_fn(x, N, alpha=0.1, lower_bd=1, upper_bd=3)
+    expected_l, expected_u = numpy_predmix_cs_wor(x, N, 0.1, 1, 3, empbern)
+    assert np.allclose(l, expected_l)
+    assert np.allclose(u, expected_u)
+
+    l, u = cs_fn(x, N, alpha=0.1, lower_bd=1, upper_bd=3, running_intersection=True)
+    accumulator = (
+        PredmixEmpBernWoRAccumulator if empbern else PredmixHoeffdingWoRAccumulator
+    )
+    cs = accumulator(N, alpha=0.1, lower_bd=1, upper_bd=3, running_intersection=True)
+    assert cs.interval == (1, 3)
+    for start, stop in [(0, 1), (1, 200), (200, 300)]:
+        assert cs.update(x[start:stop]) == (l[stop - 1], u[stop - 1])
+    with pytest.raises(ValueError):
+        cs.update(x[0:101])
+    assert cs.num_observations == 300
+
+    lambdas = np.full(len(x), 0.2)
+    l, u = cs_fn(x, N, lambdas=lambdas, lower_bd=1, upper_bd=3)
+    cs = accumulator(N, lower_bd=1, upper_bd=3)
+    assert cs.update(x, lambdas=lambdas) == (l[-1], u[-1])
+
+    with pytest.raises(ValueError):
+        cs_fn(x, N=100)
+
+
+def test_predmix_cs_wor_batch_over_populations():
+    from confseq.batch import batch_cs
+
+    rng = np.random.default_rng(7)
+    lengths = [30, 0, 5, 120]
+    sizes = [40, 10, 5, 500]
+    streams = [rng.uniform(size=n) for n in lengths]
+    for cs, cs_fn in [
+        ("predmix_empbern_wor", predmix_empbern_cs_wor),
+        ("predmix_hoeffding_wor", predmix_hoeffding_cs_wor),
+    ]:
+        l, u = batch_cs(
+            np.concatenate(streams),
+            offsets=np.append(0, np.cumsum(lengths)),
+            cs=cs,
+            population_sizes=sizes,
+        )
+        for i, stream in enumerate(streams):
+            begin = sum(lengths[0:i])
+            expected_l, expected_u = cs_fn(stream, sizes[i])
+            assert np.array_equal(l[begin : begin + len(stream)], expected_l)
+            assert np.array_equal(u[begin : begin + len(stream)], expected_u)
+
+
 @pytest.mark.random
 def test_predmix_cs_power():
     # Check that Hoeffding is tighter than empirical Bernstein for Bin(0.5) data
@@ -99,3 +244,38 @@ def test_predmix_cs_power():
     l_eb, u_eb = predmix_empbern_cs(x)
 
     assert (u_h - l_h)[n - 1] > (u_eb - l_eb)[n - 1]
+
+
+def test_accumulators_pickle():
+    x = np.random.default_rng(3).uniform(size=200)
+    for cs in (
+        PredmixEmpBernAccumulator(alpha=0.1, running_intersection=True),
+        PredmixHoeffdingAccumulator(alpha=0.1),
+        PredmixEmpBernWoRAccumulator(N=400, alpha=0.1),
+        PredmixHoeffdingWoRAccumulator(N=400, alpha=0.1),
+    ):
+        cs.update(x[:100])
+        restored = pickle.loads(pickle.dumps(cs))
+        assert restored.num_observations == 100
+        assert restored.update(x[100:]) == cs.update(x[100:])
+
+
+def test_simulate_cs_miscoverage():
+    data = SimulatedData.bernoulli(0.3)
+    result = simulate_cs_miscoverage(
+        data, horizon=200, replicates=500, cs="predmix_empbern", alpha=0.1
+    )
+    assert result.replicates == 500
+    assert result.crossing_fraction <= 0.1 + 3 * result.standard_error
+    again = simulate_cs_miscoverage(
+        data, 200, 500, cs="predmix_empbern", alpha=0.1, num_threads=1
+    )
+    assert np.array_equal(again.crossing_times, result.crossing_times)
+
+    population = np.random.default_rng(4).uniform(size=100)
+    with pytest.raises(ValueError):
+        simulate_cs_miscoverage(data, 100, 10, cs="predmix_hoeffding_wor")
+    wor = simulate_cs_miscoverage(
+        SimulatedData.permutation(population), 500, 200, cs="predmix_hoeffding_wor"
+    )
+    assert np.all(wor.crossing_times <= 100)
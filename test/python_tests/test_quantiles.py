@@ -0,0 +1,443 @@
+import math
+import pickle
+
+import numpy as np
+import pytest
+from confseq.quantiles import (
+    CDFConfidenceSequence,
+    DynamicOrderStatistics,
+    HistogramOrderStatistics,
+    MappedOrderStatistics,
+    MultiArmQuantileTest,
+    QuantileABTestConfig,
+    QuantileConfidenceSequence,
+    SequentialQuantileABTest,
+    SketchOrderStatistics,
+    batch_quantile_ab_p_values,
+    build_sorted_column,
+    double_stitching_band_matrix,
+    double_stitching_bound,
+    double_stitching_quantile_band,
+    double_stitching_quantile_band_matrix,
+    ecdf_confidence_band,
+    empirical_process_lil_bound,
+    empirical_process_lil_quantile_band_matrix,
+    quantile_ab_p_value,
+    quantile_ab_p_values,
+    quantile_ab_rejects,
+    quantile_ab_shifted_p_value,
+    quantile_difference_cs,
+)
+
+
+def test_quantile_band_matches_order_statistics():
+    values = np.random.default_rng(0).normal(size=1000)
+    sorted_values = np.sort(values)
+    p = np.array([0.001, 0.1, 0.5, 0.9, 0.999])
+    lower, upper = double_stitching_quantile_band(values, p, 0.05, 100)
+
+    t = len(values)
+    for i, p_i in enumerate(p):
+        lower_index = math.floor(
+            t * p_i - double_stitching_bound(1 - p_i, t, 0.05, 100) + 1
+        )
+        upper_index = math.ceil(t * p_i + double_stitching_bound(p_i, t, 0.05, 100))
+        expected_lower = -math.inf if lower_index < 1 else sorted_values[lower_index - 1]
+        expected_upper = math.inf if upper_index > t else sorted_values[upper_index - 1]
+        assert lower[i] == expected_lower
+        assert upper[i] == expected_upper
+
+
+def test_band_matrices_match_prefix_bands():
+    values = np.random.default_rng(2).normal(size=3000)
+    p = np.array([0.01, 0.5, 0.9, 0.999])
+    t = np.array([10, 100, 1000, 3000])
+    bounds = double_stitching_band_matrix(t.astype(float), p, 0.05, 100)
+    assert bounds.shape == (len(t), len(p))
+    lower, upper = double_stitching_quantile_band_matrix(values, t, p, 0.05, 100)
+    lil_lower, lil_upper = empirical_process_lil_quantile_band_matrix(
+        values, t, p, 0.05, 100
+    )
+    for i, t_i in enumerate(t):
+        assert np.allclose(bounds[i], double_stitching_bound(p, t_i, 0.05, 100))
+        expected = double_stitching_quantile_band(values[:t_i], p, 0.05, 100)
+        assert np.array_equal(lower[i], expected[0])
+        assert np.array_equal(upper[i], expected[1])
+        if t_i < 100:
+            assert np.all(lil_lower[i] == -math.inf)
+            assert np.all(lil_upper[i] == math.inf)
+            continue
+        sorted_prefix = np.sort(values[:t_i])
+        radius = t_i * empirical_process_lil_bound(t_i, 0.05, 100)
+        for j, p_j in enumerate(p):
+            lower_index = math.floor(t_i * p_j - radius + 1)
+            upper_index = math.ceil(t_i * p_j + radius)
+            assert lil_lower[i, j] == (
+                -math.inf if lower_index < 1 else sorted_prefix[lower_index - 1]
+            )
+            assert lil_upper[i, j] == (
+                math.inf if upper_index > t_i else sorted_prefix[upper_index - 1]
+            )
+    with pytest.raises(ValueError):
+        double_stitching_quantile_band_matrix(values, [100, 10], p, 0.05, 100)
+
+
+def test_ecdf_confidence_band():
+    values = np.random.default_rng(3).integers(0, 200, size=3000).astype(float)
+    radius = empirical_process_lil_bound(len(values), 0.05, 100)
+    x, lower, upper = ecdf_confidence_band(values, 0.05, 100)
+    assert np.array_equal(x, np.unique(values))
+    ecdf = np.searchsorted(np.sort(values), x, side="right") / len(values)
+    assert np.allclose(lower, np.maximum(ecdf - radius, 0))
+    assert np.allclose(upper, np.minimum(ecdf + radius, 1))
+
+    points = np.array([-1.0, 50.5, 500.0])
+    _, point_lower, point_upper = ecdf_confidence_band(values, 0.05, 100, x=points)
+    ecdf = np.searchsorted(np.sort(values), points, side="right") / len(values)
+    assert np.allclose(point_lower, np.maximum(ecdf - radius, 0))
+
+    sequence = CDFConfidenceSequence(0.05, 100)
+    sequence.add(values[:50])
+    _, early_lower, early_upper = sequence.band(points)
+    assert np.all(early_lower == 0) and np.all(early_upper == 1)
+    sequence.add(values[50:])
+    assert len(sequence) == len(values)
+    streamed = sequence.band()
+    assert np.array_equal(streamed[0], x)
+    assert np.array_equal(streamed[1], lower)
+    assert np.array_equal(streamed[2], upper)
+
+
+def test_float32_bounds():
+    p = np.linspace(0.01, 0.99, 99, dtype=np.float32)
+    band = double_stitching_bound(p, 1000, 0.05, 100)
+    assert band.dtype == np.float32
+    assert np.allclose(band, double_stitching_bound(p.astype(float), 1000, 0.05, 100))
+
+    t = np.geomspace(100, 1e6, 50).round().astype(np.float32)
+    lil = empirical_process_lil_bound(t, 0.05, 100)
+    assert lil.dtype == np.float32
+    assert np.allclose(lil, empirical_process_lil_bound(t.astype(float), 0.05, 100))
+
+
+def test_dynamic_order_statistics_match_arrays():
+    rng = np.random.default_rng(1)
+    a_values, b_values = rng.normal(size=2000), rng.normal(0.2, size=2000)
+    a_os, b_os = DynamicOrderStatistics(), DynamicOrderStatistics()
+    for start in range(0, 2000, 250):
+        a_os.insert(a_values[start : start + 250])
+        b_os.insert(b_values[start : start + 250])
+    assert len(a_os) == 2000
+    assert a_os.get_order_statistic(1000) == np.sort(a_values)[999]
+    assert quantile_ab_p_value(a_os, b_os, 0.5, 100) == quantile_ab_p_value(
+        a_values, b_values, 0.5, 100
+    )
+
+
+
+def test_histogram_order_statistics_match_arrays():
+    rng = np.random.default_rng(2)
+    a_values = rng.integers(0, 300, 5000).astype(float)
+    b_values = rng.integers(10, 310, 5000).astype(float)
+    distinct, counts = np.unique(a_values, return_counts=True)
+    a_os = HistogramOrderStatistics(distinct, counts)
+    b_os = HistogramOrderStatistics()
+    for value in b_values:
+        b_os.insert(value)
+    assert len(a_os) == 5000 and len(a_os.values) == len(distinct)
+    assert a_os.get_order_statistic(2500) == np.sort(a_values)[2499]
+    assert b_os.count_less(100) == np.sum(b_values < 100)
+    assert quantile_ab_p_value(a_os, b_os, 0.5, 100) == quantile_ab_p_value(
+        a_values, b_values, 0.5, 100
+    )
+    restored = pickle.loads(pickle.dumps(a_os))
+    assert np.array_equal(restored.counts, a_os.counts)
+    assert len(HistogramOrderStatistics(a_values)) == 5000
+
+
+def test_batch_counts_match_single_counts():
+    rng = np.random.default_rng(4)
+    values = rng.integers(0, 100, 3000).astype(float)
+    queries = rng.uniform(-5, 105, 500)
+    for os in (DynamicOrderStatistics(values), HistogramOrderStatistics(values)):
+        for q in (queries, np.sort(queries)):
+            assert np.array_equal(
+                os.count_less_batch(q), [os.count_less(x) for x in q]
+            )
+            assert np.array_equal(
+                os.count_less_or_equal_batch(q),
+                [os.count_less_or_equal(x) for x in q],
+            )
+
+
+def test_quantile_ab_p_value_weighted_and_tie_compressed_arms():
+    rng = np.random.default_rng(3)
+    a_values = rng.integers(0, 50, 3000)
+    b_values = rng.integers(5, 55, 3000)
+    expected = quantile_ab_p_value(a_values, b_values, 0.5, 100)
+    assert expected < 1
+    assert (
+        quantile_ab_p_value(a_values, b_values, 0.5, 100, compress_ties=True)
+        == expected
+    )
+    a_distinct, a_counts = np.unique(a_values, return_counts=True)
+    b_distinct, b_counts = np.unique(b_values, return_counts=True)
+    assert (
+        quantile_ab_p_value(
+            a_distinct, b_distinct, 0.5, 100, a_weights=a_counts, b_weights=b_counts
+        )
+        == expected
+    )
+    assert (
+        quantile_ab_p_value(a_distinct, b_values, 0.5, 100, a_weights=a_counts)
+        == expected
+    )
+    with pytest.raises(ValueError):
+        quantile_ab_p_value(a_values, b_values, 0.5, 100, a_weights=np.ones(3))
+
+def test_sketch_order_statistics_are_conservative():
+    a_values = np.arange(1, 100001, dtype=float)
+    b_values = a_values + 1500
+    a_os, b_os = SketchOrderStatistics(), SketchOrderStatistics()
+    a_os.insert(a_values)
+    b_os.insert(b_values)
+    assert len(a_os) == 100000
+    assert a_os.num_retained < 100000
+    assert abs(a_os.count_less(50000.5) - 50000) <= a_os.rank_error
+    exact = quantile_ab_p_value(a_values, b_values, 0.5, 100)
+    assert exact <= quantile_ab_p_value(a_os, b_os, 0.5, 100) < 0.5
+
+
+def test_sketch_order_statistics_merge_across_nodes():
+    a_values = np.arange(1, 100001, dtype=float)
+    b_values = a_values + 1500
+    a_os, b_os = SketchOrderStatistics(k=256), SketchOrderStatistics(k=256)
+    for shard in range(10):
+        for values, merged in [(a_values, a_os), (b_values, b_os)]:
+            part = SketchOrderStatistics(k=256)
+            part.insert(values[shard::10])
+            merged.merge(SketchOrderStatistics.from_bytes(part.to_bytes()))
+    assert len(a_os) == 100000
+    assert abs(a_os.count_less(50000.5) - 50000) <= a_os.rank_error
+    restored = pickle.loads(pickle.dumps(a_os))
+    assert restored.rank_error == a_os.rank_error
+    assert restored.get_order_statistic(50000) == a_os.get_order_statistic(50000)
+    exact = quantile_ab_p_value(a_values, b_values, 0.5, 100)
+    assert exact <= quantile_ab_p_value(a_os, b_os, 0.5, 100)
+
+
+def test_quantile_ab_p_value_assume_sorted():
+    a_values = np.arange(1, 1001, dtype=float)
+    b_values = np.arange(86, 1086, dtype=float)
+    expected = quantile_ab_p_value(a_values[::-1], b_values, 0.5, 100)
+    assert quantile_ab_p_value(
+        a_values, b_values, 0.5, 100, assume_sorted=True
+    ) == expected
+    try:
+        quantile_ab_p_value(a_values[::-1], b_values, 0.5, 100, assume_sorted=True)
+        assert False
+    except ValueError:
+        pass
+
+
+def test_quantile_ab_p_value_narrow_dtypes():
+    a_values = np.arange(1, 1001)
+    b_values = np.arange(86, 1086)
+    expected = quantile_ab_p_value(
+        a_values.astype(float), b_values.astype(float), 0.5, 100
+    )
+    for dtype in [np.float32, np.int32, np.int64, np.int16]:
+        for assume_sorted in [False, True]:
+            p_value = quantile_ab_p_value(
+                a_values.astype(dtype),
+                b_values.astype(dtype),
+                0.5,
+                100,
+                assume_sorted=assume_sorted,
+            )
+            assert np.isclose(p_value, expected, rtol=1e-12)
+
+
+def test_quantile_ab_rejects_matches_p_value():
+    a_values = np.arange(1, 1001, dtype=float)
+    for offset in [70, 85, 100]:
+        b_values = a_values + offset
+        p_value = quantile_ab_p_value(a_values, b_values, 0.5, 100)
+        for alpha in [0.01, 0.05, 0.1]:
+            assert quantile_ab_rejects(a_values, b_values, 0.5, 100, alpha) == (
+                p_value <= alpha
+            )
+
+
+def test_quantile_difference_cs_inverts_shifted_test():
+    a_values = np.arange(1, 1001, dtype=float) + 100
+    b_values = np.arange(1, 1001, dtype=float)
+    for delta in [-50.0, 0.0, 37.5, 100.0]:
+        assert quantile_ab_shifted_p_value(
+            a_values, b_values, 0.5, 100, delta
+        ) == quantile_ab_p_value(a_values, b_values + delta, 0.5, 100)
+    lower, upper = quantile_difference_cs(a_values, b_values, 0.5, 100, 0.05)
+    assert 0 < lower < 100 < upper < 200
+    for end in [lower, upper]:
+        p_value = quantile_ab_shifted_p_value(a_values, b_values, 0.5, 100, end)
+        assert p_value <= 0.05
+    assert quantile_difference_cs(
+        a_values, b_values, 0.5, 100, 0.05, compress_ties=True
+    ) == (lower, upper)
+    assert quantile_difference_cs(a_values[:3], b_values[:3], 0.5, 100, 0.05) == (
+        -math.inf,
+        math.inf,
+    )
+    with pytest.raises(ValueError):
+        quantile_difference_cs(a_values, b_values, 0.5, 100, 0)
+
+
+def test_sequential_quantile_ab_test_matches_from_scratch():
+    test = SequentialQuantileABTest(0.5, 100)
+    a_values = np.arange(1, 1001, dtype=float)
+    b_values = a_values + 100
+    running = 1
+    for start in range(0, 1000, 200):
+        test.add(1, a_values[start : start + 200])
+        test.add(2, b_values[start : start + 200])
+        expected = quantile_ab_p_value(
+            a_values[: start + 200], b_values[: start + 200], 0.5, 100
+        )
+        running = min(running, expected)
+        assert math.isclose(test.p_value(), expected, rel_tol=1e-6)
+        assert math.isclose(test.running_p_value(), running, rel_tol=1e-6)
+    assert test.arm_size(2) == 1000
+
+
+def test_quantile_ab_test_config_matches_p_value():
+    config = QuantileABTestConfig(0.9, 100)
+    assert (config.quantile_p, config.t_opt, config.alpha_opt) == (0.9, 100, 0.05)
+    a_values = np.arange(1, 1001, dtype=float)
+    b_values = a_values + 55
+    for end in range(200, 1001, 200):
+        expected = quantile_ab_p_value(a_values[:end], b_values[:end], 0.9, 100)
+        assert config.p_value(a_values[:end], b_values[:end]) == expected
+    a_os = DynamicOrderStatistics(a_values)
+    b_os = DynamicOrderStatistics(b_values)
+    assert config.p_value(a_os, b_os) == quantile_ab_p_value(a_os, b_os, 0.9, 100)
+
+
+def test_quantile_ab_p_values_match_single_quantiles():
+    a_values = np.arange(1, 1001, dtype=float)
+    b_values = a_values + 55
+    quantile_p = np.array([0.5, 0.9, 0.95, 0.99])
+    p_values = quantile_ab_p_values(a_values, b_values, quantile_p, 100)
+    for p, p_value in zip(quantile_p, p_values):
+        assert p_value == quantile_ab_p_value(a_values, b_values, p, 100)
+
+
+def test_batch_quantile_ab_p_values_match_single_pairs():
+    rng = np.random.default_rng(21)
+    sizes = [500, 5, 2000, 50]
+    a_arms = [rng.normal(size=n) for n in sizes]
+    b_arms = [rng.normal(size=n) + 0.5 * (i % 2) for i, n in enumerate(sizes)]
+    quantile_p = np.array([0.5, 0.9, 0.5, 0.9])
+    p_values = batch_quantile_ab_p_values(a_arms, b_arms, quantile_p, 100)
+    for a, b, p, p_value in zip(a_arms, b_arms, quantile_p, p_values):
+        assert p_value == quantile_ab_p_value(a, b, p, 100)
+
+    offsets = np.cumsum([0] + sizes)
+    flat = batch_quantile_ab_p_values(
+        np.concatenate(a_arms),
+        np.concatenate(b_arms),
+        quantile_p,
+        np.full(4, 100),
+        a_offsets=offsets,
+        b_offsets=offsets,
+    )
+    assert np.array_equal(flat, p_values)
+    assert batch_quantile_ab_p_values([[]], [[1.0]], 0.5, 100)[0] == 1
+    with pytest.raises(ValueError):
+        batch_quantile_ab_p_values(a_arms, b_arms[:2], 0.5, 100)
+
+
+def test_multi_arm_quantile_test_matches_pairwise():
+    rng = np.random.default_rng(22)
+    arms = [rng.normal(size=800), rng.normal(size=300), rng.normal(size=1200) + 0.3]
+    test = MultiArmQuantileTest(arms, 0.5, 100)
+    assert len(test) == 3
+    against = test.p_values_against(0)
+    assert against[0] == 1
+    for i in (1, 2):
+        assert against[i] == quantile_ab_p_value(arms[i], arms[0], 0.5, 100)
+    pairs = np.array([[0, 1], [0, 2], [1, 2]])
+    p_values = test.p_values(pairs)
+    for (i, j), p_value in zip(pairs, p_values):
+        assert p_value == test.p_value(i, j)
+        assert p_value == quantile_ab_p_value(arms[i], arms[j], 0.5, 100)
+    with pytest.raises(IndexError):
+        test.p_value(0, 3)
+
+
+def test_quantile_confidence_sequence_matches_band():
+    values = np.random.default_rng(2).exponential(size=2000)
+    sequence = QuantileConfidenceSequence(0.05, 100)
+    p = np.array([0.5, 0.9, 0.99])
+    for start in range(0, 2000, 500):
+        sequence.add(values[start : start + 500])
+        lower, upper = sequence.interval(p)
+        expected_lower, expected_upper = double_stitching_quantile_band(
+            values[: start + 500], p, 0.05, 100
+        )
+        assert np.array_equal(lower, expected_lower)
+        assert np.array_equal(upper, expected_upper)
+    assert len(sequence) == 2000
+    assert sequence.interval(0.5) == (lower[0], upper[0])
+
+
+def test_quantile_ab_p_value_large_unsorted_arms():
+    rng = np.random.default_rng(3)
+    a_values = rng.normal(size=200000)
+    b_values = rng.normal(0.05, size=150000)
+    expected = quantile_ab_p_value(
+        np.sort(a_values), np.sort(b_values), 0.5, 100, assume_sorted=True
+    )
+    assert quantile_ab_p_value(a_values, b_values, 0.5, 100) == expected
+
+
+def test_mapped_order_statistics_match_arrays(tmp_path):
+    rng = np.random.default_rng(4)
+    a_values = rng.normal(size=20000)
+    b_values = rng.normal(0.1, size=20000)
+    a_values.tofile(tmp_path / "values.bin")
+    build_sorted_column(
+        str(tmp_path / "values.bin"),
+        str(tmp_path / "column.bin"),
+        max_values_in_memory=3000,
+    )
+    mapped = MappedOrderStatistics.map_file(str(tmp_path / "column.bin"))
+    assert len(mapped) == len(a_values)
+    assert mapped.get_order_statistic(1) == a_values.min()
+    b_os = DynamicOrderStatistics(b_values)
+    assert math.isclose(
+        quantile_ab_p_value(mapped, b_os, 0.5, 1000),
+        quantile_ab_p_value(a_values, b_values, 0.5, 1000),
+        rel_tol=1e-12,
+    )
+
+
+def test_checkpoints_resume(tmp_path):
+    rng = np.random.default_rng(11)
+    test = SequentialQuantileABTest(0.5, 100)
+    test.add(1, rng.normal(size=500))
+    test.add(2, rng.normal(0.3, size=500))
+    test.p_value()
+    restored = pickle.loads(pickle.dumps(test))
+    more = rng.normal(size=200)
+    for t in (test, restored):
+        t.add(1, more)
+    assert restored.arm_size(1) == 700
+    assert restored.p_value() == test.p_value()
+
+    arm = DynamicOrderStatistics(rng.normal(size=1000))
+    assert len(pickle.loads(pickle.dumps(arm))) == 1000
+    arm.save(str(tmp_path / "arm.bin"))
+    mapped = MappedOrderStatistics.map_file(str(tmp_path / "arm.bin"))
+    assert [mapped.get_order_statistic(k) for k in (1, 500, 1000)] == [
+        arm.get_order_statistic(k) for k in (1, 500, 1000)
+    ]
@@ -1,5 +1,12 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
 #include <numeric>
+#include <sstream>
+#include <thread>
 
 #include "uniform_boundaries.h"
 
@@ -24,11 +31,43 @@ TEST(MixtureTest, TestTwoSidedNormalMixture) {
               30.35209, 1e-5);
 }
 
+TEST(MixtureTest, TwoSidedNormalFloat32Bound) {
+  const TwoSidedNormalMixture mixture(V_OPT, ALPHA_OPT);
+  std::vector<float> v;
+  for (int i = 0; i < 1000; i++) {
+    v.push_back(0.25 * i * i);
+  }
+  CounterRng rng(7, 0);
+  for (int i = 0; i < 20000; i++) {
+    v.push_back(std::exp(20 * rng.uniform()));
+  }
+  std::vector<float> out(v.size());
+  mixture.bound_sequence(v.data(), v.size(), log(1 / ALPHA), out.data());
+  for (size_t i = 0; i < v.size(); i++) {
+    const double exact = mixture.bound(v[i], log(1 / ALPHA));
+    // Rounded up, so the float bound stays conservative.
+    EXPECT_GE(out[i], exact) << v[i];
+    EXPECT_NEAR(out[i], exact, 1e-6 * exact) << v[i];
+  }
+}
+
 TEST(MixtureTest, TestOneSidedNormalMixture) {
   EXPECT_NEAR(normal_log_mixture(10, 100, V_OPT), -0.06502391, 1e-5);
   EXPECT_NEAR(normal_mixture_bound(100, ALPHA, V_OPT), 27.66071, 1e-5);
 }
 
+TEST(MixtureTest, TestLogNormalCdf) {
+  boost::math::normal_distribution<long double> normal;
+  for (double z = -60; z <= 10; z += 0.25) {
+    const double expected = log(boost::math::cdf(normal, (long double) z));
+    EXPECT_NEAR(log_normal_cdf(z), expected, 1e-13 * std::max(1.0, -expected))
+        << "z = " << z;
+  }
+  OneSidedNormalMixture mixture(V_OPT, ALPHA_OPT);
+  EXPECT_TRUE(std::isfinite(mixture.log_superMG(-1e3, 10)));
+  EXPECT_TRUE(std::isfinite(mixture.d_log_superMG_ds(-1e3, 10)));
+}
+
 TEST(MixtureTest, TestGammaExponentialMixture) {
   EXPECT_NEAR(gamma_exponential_log_mixture(10, 100, V_OPT, 2),
               -0.2490165, 1e-5);
@@ -51,6 +90,25 @@ TEST(MixtureTest, TestTwoSidedBetaBinomialMixture) {
       31.4308, 1e-5);
 }
 
+TEST(MixtureTest, TestLogIncompleteBeta) {
+  for (const double a : {0.01, 1.0, 30.0, 3000.0}) {
+    for (const double b : {0.01, 1.0, 30.0, 3000.0}) {
+      for (const double x : {1e-6, 0.2, 0.5, 0.9}) {
+        const long double la = a, lb = b;
+        const long double expected = log(boost::math::ibeta(la, lb,
+                                                            (long double) x))
+            + boost::math::lgamma(la) + boost::math::lgamma(lb)
+            - boost::math::lgamma(la + lb);
+        EXPECT_NEAR(log_incomplete_beta(a, b, x), expected,
+                    1e-11 * std::max(1.0L, std::abs(expected)))
+            << "a = " << a << ", b = " << b << ", x = " << x;
+      }
+    }
+  }
+  // far below the mean, where ibeta itself underflows
+  EXPECT_TRUE(std::isfinite(log_incomplete_beta(1e4, 10, 0.01)));
+}
+
 TEST(MixtureTest, TestOneSidedBetaBinomialMixture) {
   EXPECT_NEAR(beta_binomial_log_mixture(10, 100, V_OPT, 0.2, 0.8),
               -0.07134019, 1e-5);
@@ -61,6 +119,1353 @@ TEST(MixtureTest, TestOneSidedBetaBinomialMixture) {
       2 * 0.8, 1e-5);
 }
 
+void expect_derivatives_match(const MixtureSupermartingale& mixture,
+                              const double s, const double v) {
+  const double h = 1e-4;
+  const double up = mixture.log_superMG(s + h, v);
+  const double mid = mixture.log_superMG(s, v);
+  const double down = mixture.log_superMG(s - h, v);
+  EXPECT_NEAR(mixture.d_log_superMG_ds(s, v), (up - down) / (2 * h), 1e-6);
+  EXPECT_NEAR(mixture.d2_log_superMG_ds2(s, v), (up - 2 * mid + down) / (h * h),
+              1e-4);
+}
+
+TEST(MixtureTest, TestDerivatives) {
+  expect_derivatives_match(TwoSidedNormalMixture(V_OPT, ALPHA_OPT), 10, 100);
+  expect_derivatives_match(OneSidedNormalMixture(V_OPT, ALPHA_OPT), 10, 100);
+  expect_derivatives_match(OneSidedNormalMixture(V_OPT, ALPHA_OPT), 1, 10);
+  expect_derivatives_match(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2), 10,
+                           100);
+  expect_derivatives_match(GammaExponentialMixture(V_OPT, ALPHA_OPT, 0.5), 30,
+                           200);
+  expect_derivatives_match(
+      BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, false), 10, 100);
+  EXPECT_TRUE(std::isnan(
+      BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, true)
+      .d_log_superMG_ds(10, 100)));
+  EXPECT_TRUE(std::isnan(
+      GammaPoissonMixture(V_OPT, ALPHA_OPT, 2).d_log_superMG_ds(10, 100)));
+}
+
+TEST(MixtureTest, SidedBetaBinomialMixturesMatchRuntimeClass) {
+  const double v[] = {1, 10, 100, 1e4};
+  const double log_threshold = log(1 / ALPHA);
+  for (const bool is_one_sided : {true, false}) {
+    const BetaBinomialMixture mixture(V_OPT, ALPHA_OPT, 0.2, 0.8,
+                                      is_one_sided);
+    std::unique_ptr<MixtureSupermartingale> sided;
+    if (is_one_sided) {
+      sided.reset(new OneSidedBetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8));
+    } else {
+      sided.reset(new TwoSidedBetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8));
+    }
+    for (const double s : {-5.0, 0.0, 10.0}) {
+      EXPECT_EQ(sided->log_superMG(s, 100), mixture.log_superMG(s, 100));
+    }
+    double expected[4], actual[4];
+    mixture.bound_sequence(v, 4, log_threshold, expected);
+    sided->bound_sequence(v, 4, log_threshold, actual);
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(sided->bound(v[i], log_threshold),
+                mixture.bound(v[i], log_threshold));
+      EXPECT_EQ(actual[i], expected[i]);
+    }
+    EXPECT_EQ(std::isnan(sided->d_log_superMG_ds(10, 100)), is_one_sided);
+  }
+  expect_derivatives_match(
+      TwoSidedBetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8), 10, 100);
+}
+
+TEST(MixtureTest, TestHalleyMatchesBisection) {
+  const double log_threshold = log(1 / ALPHA);
+  for (double v : {1.0, 10.0, 100.0, 1e4, 1e6}) {
+    GammaExponentialMixture mixture(V_OPT, ALPHA_OPT, 2);
+    const double bound = mixture.bound(v, log_threshold);
+    EXPECT_NEAR(mixture.log_superMG(bound, v), log_threshold, 1e-8);
+    OneSidedNormalMixture normal(V_OPT, ALPHA_OPT);
+    const double normal_bound = normal.bound(v, log_threshold);
+    EXPECT_NEAR(normal.log_superMG(normal_bound, v), log_threshold, 1e-8);
+  }
+}
+
+TEST(MixtureTest, TestHalleyExhaustionStaysAboveRoot) {
+  // Halley's iteration stalls here without raising s_lower, and used to
+  // return the midpoint of its bracket, about half the bound.
+  BetaBinomialMixture mixture(1e5, 0.05, 0.5, 0.5, false);
+  const double v = 4300723.6588516962;
+  const double bound = mixture.bound(v, log(10));
+  EXPECT_GE(mixture.log_superMG(bound, v), log(10));
+  EXPECT_NEAR(mixture.log_superMG(bound, v), log(10), 1e-6);
+  EXPECT_NEAR(bound, 6710.8, 0.1);
+}
+
+void expect_valid_bracket(const MixtureSupermartingale& mixture) {
+  for (const double v : {1e-3, 1.0, 100.0, 1e5}) {
+    for (const double alpha : {0.05, 1e-10}) {
+      const double bracket = mixture.s_upper_bracket(v, log(1 / alpha));
+      ASSERT_LT(bracket, std::numeric_limits<double>::infinity());
+      EXPECT_GT(mixture.log_superMG(bracket, v), log(1 / alpha));
+    }
+  }
+}
+
+TEST(MixtureTest, TestUpperBrackets) {
+  expect_valid_bracket(TwoSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_valid_bracket(OneSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_valid_bracket(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2));
+  expect_valid_bracket(GammaPoissonMixture(V_OPT, ALPHA_OPT, 2));
+}
+
+void expect_batch_matches(const MixtureSupermartingale& mixture) {
+  const std::vector<double> s = {-1, 0, 0.5, 3, 10, 100};
+  const std::vector<double> v = {10, 1, 100, 0.1, 1e3, 1e4};
+  std::vector<double> out(s.size());
+  mixture.log_superMG(s.data(), v.data(), s.size(), out.data());
+  for (size_t i = 0; i < s.size(); i++) {
+    EXPECT_NEAR(out[i], mixture.log_superMG(s[i], v[i]),
+                1e-12 * std::max(1.0, std::abs(out[i])));
+  }
+}
+
+TEST(MixtureTest, TestBatchLogSuperMG) {
+  expect_batch_matches(TwoSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_batch_matches(OneSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_batch_matches(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2));
+}
+
+TEST(MixtureTest, TestVectorLogNormalCdf) {
+  std::vector<double> z;
+  for (double x = -40; x <= 40; x += 0.0173) {
+    z.push_back(x);
+  }
+  for (double x = 40; x <= 1e40; x *= 1.17) {
+    z.push_back(-x);
+  }
+  // The ends of the pieces of the rational approximations.
+  for (const double a : {0.5, 1.5, 2.5, 4.5}) {
+    for (const double x : {-a * sqrt(2.0), a * sqrt(2.0)}) {
+      z.push_back(x);
+      z.push_back(std::nextafter(x, 0.0));
+      z.push_back(std::nextafter(x, 2 * x));
+    }
+  }
+  // Outside the vector kernels' range, from the scalar function.
+  const std::vector<double> fallback = {
+      std::numeric_limits<double>::quiet_NaN(),
+      std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity(), 1e41, -1e41, -1e300};
+  z.insert(z.end(), fallback.begin(), fallback.end());
+  std::vector<double> out(z.size());
+  for (const int width : {1, 4, 8}) {
+    if (width > vector_width()) {
+      continue;
+    }
+    vector_kernels::log_normal_cdf(width, z.data(), z.size(), out.data());
+    for (size_t i = 0; i < z.size(); i++) {
+      const double exact = log_normal_cdf(z[i]);
+      if (std::isnan(exact) || std::isinf(exact) || std::abs(z[i]) > 1e40) {
+        EXPECT_TRUE(out[i] == exact || (std::isnan(out[i])
+                                        && std::isnan(exact)))
+            << "width " << width << ", z = " << z[i];
+      } else if (z[i] <= 0) {
+        EXPECT_NEAR(out[i], exact, 4e-15 * std::abs(exact))
+            << "width " << width << ", z = " << z[i];
+      } else {
+        // log_normal_cdf() itself is accurate to 2e-16 here only in
+        // absolute terms.
+        EXPECT_NEAR(out[i], exact, 1e-15)
+            << "width " << width << ", z = " << z[i];
+      }
+    }
+  }
+}
+
+template <class NormalMixture>
+void expect_vector_kernels_match(const NormalMixture& mixture) {
+  const double rho = mixture.rho();
+  std::vector<double> s, v;
+  for (double v_i = 1e-3; v_i <= 1e9; v_i *= 3.7) {
+    for (double sd = -60; sd <= 60; sd += 0.73) {
+      s.push_back(sd * std::sqrt(v_i + rho));
+      v.push_back(v_i);
+    }
+    s.push_back(-1e30);
+    v.push_back(v_i);
+  }
+  s.push_back(std::numeric_limits<double>::quiet_NaN());
+  v.push_back(1);
+  s.push_back(1);
+  v.push_back(std::numeric_limits<double>::infinity());
+  std::vector<double> out(s.size());
+  for (const int width : {1, 4, 8}) {
+    if (width > vector_width()) {
+      continue;
+    }
+    vector_kernels::normal_log_superMG(width, mixture, s.data(), v.data(),
+                                       s.size(), out.data());
+    for (size_t i = 0; i < s.size(); i++) {
+      const double exact = mixture.log_superMG(s[i], v[i]);
+      if (!std::isfinite(exact)) {
+        EXPECT_TRUE(out[i] == exact || (std::isnan(out[i])
+                                        && std::isnan(exact)))
+            << "width " << width << ", s = " << s[i] << ", v = " << v[i];
+        continue;
+      }
+      // Each term is within a few units in the last place of the largest.
+      const double scale = std::max(1.0, s[i] * s[i] / (v[i] + rho));
+      EXPECT_NEAR(out[i], exact, 1e-14 * scale)
+          << "width " << width << ", s = " << s[i] << ", v = " << v[i];
+    }
+  }
+}
+
+TEST(MixtureTest, TestVectorKernels) {
+  expect_vector_kernels_match(TwoSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_vector_kernels_match(OneSidedNormalMixture(V_OPT, ALPHA_OPT));
+}
+
+void expect_sequence_matches(const MixtureSupermartingale& mixture,
+                             const std::vector<double>& v) {
+  std::vector<double> out(v.size());
+  mixture.bound_sequence(v.data(), v.size(), log(1 / ALPHA), out.data());
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_NEAR(out[i], mixture.bound(v[i], log(1 / ALPHA)), 1e-7 * out[i]);
+  }
+}
+
+TEST(MixtureTest, TestBoundSequence) {
+  std::vector<double> increasing;
+  for (double v = 0.5; v < 1e5; v *= 1.3) {
+    increasing.push_back(v);
+    increasing.push_back(v);
+  }
+  std::vector<double> decreasing(increasing.rbegin(), increasing.rend());
+  std::vector<double> unsorted = {100, 3, 1e4, 1e4, 50, 1e3, 1};
+  for (const auto& v : {increasing, decreasing, unsorted}) {
+    expect_sequence_matches(OneSidedNormalMixture(V_OPT, ALPHA_OPT), v);
+    expect_sequence_matches(TwoSidedNormalMixture(V_OPT, ALPHA_OPT), v);
+    expect_sequence_matches(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2), v);
+    expect_sequence_matches(GammaPoissonMixture(V_OPT, ALPHA_OPT, 2), v);
+    expect_sequence_matches(
+        BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, true), v);
+    expect_sequence_matches(
+        BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, false), v);
+  }
+}
+
+TEST(MixtureTest, GammaExponentialSpacedMatchesLogSuperMG) {
+  const size_t n = 2000;
+  std::vector<double> s(n), out(n);
+  for (size_t i = 0; i < n; i++) {
+    s[i] = 3 * sqrt(i + 1.0) * std::sin(i / 40.0);
+  }
+  // Unit steps in (v + rho) / c^2, steps of 4 and a step with no recurrence.
+  for (const auto& c_and_step : std::vector<std::pair<double, double>>{
+           {1, 1}, {0.5, 0.25}, {0.5, 1}, {2, 3}}) {
+    const double c = c_and_step.first;
+    const double v_step = c_and_step.second;
+    const GammaExponentialMixture mixture(V_OPT, ALPHA_OPT, c);
+    mixture.log_superMG_spaced(s.data(), 1, v_step, n, out.data());
+    for (size_t i = 0; i < n; i++) {
+      const double v = 1 + i * v_step;
+      // Within rounding of the lgamma term, which grows like a log(a).
+      const double a = 1 + v / (c * c);
+      EXPECT_NEAR(out[i], mixture.log_superMG(s[i], v), 1e-14 * a * log(1 + a))
+          << c << " " << i;
+    }
+  }
+}
+
+TEST(MixtureTest, GammaExponentialBatchMatchesMixtures) {
+  const size_t size = 3000;
+  std::vector<double> v_opt(size), alpha_opt(size), c(size), s(size), v(size);
+  for (size_t i = 0; i < size; i++) {
+    v_opt[i] = 10 + i;
+    alpha_opt[i] = i % 2 ? 0.05 : 0.01;
+    c[i] = 0.5 + (i % 7) / 2.0;
+    v[i] = 1 + (i * 37) % 5000;
+    s[i] = (double(i % 11) - 3) * sqrt(v[i]);
+  }
+  GammaExponentialMixtureBatch batch(v_opt.data(), alpha_opt.data(), c.data(),
+                                     size);
+  ASSERT_EQ(batch.size(), size);
+  std::vector<double> log_superMG(size), bounds(size);
+  batch.log_superMG(s.data(), v.data(), log_superMG.data());
+  batch.bound(v.data(), log(1 / ALPHA), bounds.data(), 3);
+  for (size_t i = 0; i < size; i++) {
+    const GammaExponentialMixture mixture(v_opt[i], alpha_opt[i], c[i]);
+    EXPECT_EQ(log_superMG[i], mixture.log_superMG(s[i], v[i])) << i;
+    EXPECT_EQ(bounds[i], mixture.bound(v[i], log(1 / ALPHA))) << i;
+  }
+
+  SolverPrecision precision;
+  precision.special_functions = SpecialFunctionPrecision::FAST;
+  batch.set_precision(precision);
+  batch.log_superMG(s.data(), v.data(), log_superMG.data(), 1);
+  GammaExponentialMixture mixture(v_opt[5], alpha_opt[5], c[5]);
+  mixture.set_precision(precision);
+  EXPECT_EQ(log_superMG[5], mixture.log_superMG(s[5], v[5]));
+  EXPECT_EQ(batch.mixture(5).log_superMG(s[5], v[5]), log_superMG[5]);
+}
+
+TEST(MixtureTest, BatchBoundsReportStatus) {
+  const GammaPoissonMixture mixture(V_OPT, ALPHA_OPT, 2);
+  const std::vector<double> v = {100, -1, 1e300, 1000, 100};
+  const std::vector<double> alpha = {ALPHA, ALPHA, ALPHA, ALPHA, 1.5};
+  std::vector<double> out(v.size());
+  std::vector<EvaluationStatus> status(v.size());
+  mixture_bounds(mixture, v.data(), alpha.data(), v.size(), out.data(),
+                 status.data());
+  const std::vector<EvaluationStatus> expected = {
+      EvaluationStatus::OK, EvaluationStatus::INVALID_ARGUMENT,
+      EvaluationStatus::NUMERICAL_ERROR, EvaluationStatus::OK,
+      EvaluationStatus::INVALID_ARGUMENT};
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_EQ(status[i], expected[i]) << i;
+    if (expected[i] == EvaluationStatus::OK) {
+      EXPECT_DOUBLE_EQ(out[i], mixture.bound(v[i], log(1 / alpha[i])));
+    } else {
+      EXPECT_TRUE(std::isnan(out[i])) << i;
+    }
+  }
+}
+
+TEST(MixtureTest, TestMixtureBoundaryT) {
+  const GammaExponentialMixture mixture(V_OPT, ALPHA_OPT, 2);
+  MixtureBoundaryT<GammaExponentialMixture> boundary(mixture);
+  const MixtureSupermartingale& base = mixture;
+  for (const double v : {1.0, 100.0, 1e4}) {
+    EXPECT_DOUBLE_EQ(boundary(v, ALPHA), mixture.bound(v, log(1 / ALPHA)));
+    EXPECT_DOUBLE_EQ(find_mixture_bound(mixture, v, log(1 / ALPHA)),
+                     find_mixture_bound(base, v, log(1 / ALPHA)));
+  }
+}
+
+TEST(SolverPrecisionTest, FastBoundsAreConservative) {
+  TwoSidedNormalMixture normal(10, 0.05);
+  GammaExponentialMixture gamma_exponential(10, 0.05, 1);
+  BetaBinomialMixture beta_binomial(10, 0.05, 0.2, 0.8, false);
+  std::vector<MixtureSupermartingale*> mixtures = {
+      &normal, &gamma_exponential, &beta_binomial};
+  for (MixtureSupermartingale* mixture : mixtures) {
+    for (const double v : {1.0, 10.0, 1000.0}) {
+      mixture->set_precision(SolverPrecision::exact());
+      const double exact = mixture->bound(v, log(1 / 0.05));
+      mixture->set_precision(SolverPrecision::fast());
+      const double fast = mixture->bound(v, log(1 / 0.05));
+      EXPECT_GE(fast, exact) << v;
+      EXPECT_NEAR(fast, exact, 1e-5 * exact) << v;
+    }
+  }
+}
+
+TEST(SolverPrecisionTest, FastIntervalsContainExact) {
+  const SolverPrecision fast = SolverPrecision::fast();
+  BernoulliConfidenceSequence sequence(0.05, 100, 0.05, false, fast);
+  for (int n = 10; n <= 1000; n *= 10) {
+    const auto exact = bernoulli_confidence_interval(0.3 * n, n, 0.05, 100);
+    const auto bisected = bernoulli_confidence_interval(0.3 * n, n, 0.05, 100,
+                                                        0.05, fast);
+    const auto streamed = sequence.update(0.3 * n - sequence.num_successes(),
+                                          n - sequence.num_trials());
+    // The exact endpoints are themselves only accurate to about 1e-12.
+    for (const auto& interval : {bisected, streamed}) {
+      EXPECT_LE(interval.first, exact.first + 1e-11) << n;
+      EXPECT_GE(interval.second, exact.second - 1e-11) << n;
+      EXPECT_NEAR(interval.first, exact.first, 1e-5) << n;
+      EXPECT_NEAR(interval.second, exact.second, 1e-5) << n;
+    }
+  }
+  EmpiricalProcessLILBound exact_lil(0.05, 100, 0.85);
+  EmpiricalProcessLILBound fast_lil(0.05, 100, 0.85, fast);
+  EXPECT_GE(fast_lil(1000), exact_lil(1000));
+  EXPECT_NEAR(fast_lil(1000), exact_lil(1000), 1e-5 * exact_lil(1000));
+}
+
+TEST(SolverPrecisionTest, ReducedSpecialFunctionsAreConservative) {
+  GammaPoissonMixture gamma_poisson(100, 0.05, 0.1);
+  GammaExponentialMixture gamma_exponential(100, 0.05, 2);
+  BetaBinomialMixture beta_binomial(100, 0.05, 0.2, 0.8, true);
+  std::vector<MixtureSupermartingale*> mixtures = {
+      &gamma_poisson, &gamma_exponential, &beta_binomial};
+  for (const SolverPrecision& reduced :
+       {SolverPrecision::balanced(), SolverPrecision::fast()}) {
+    for (MixtureSupermartingale* mixture : mixtures) {
+      for (const double v : {1.0, 100.0, 1e4, 1e6}) {
+        for (const double alpha : {0.001, 0.05, 0.5}) {
+          mixture->set_precision(SolverPrecision::exact());
+          const double exact = mixture->bound(v, log(1 / alpha));
+          mixture->set_precision(reduced);
+          const double bound = mixture->bound(v, log(1 / alpha));
+          EXPECT_GE(bound, exact) << v << " " << alpha;
+          EXPECT_NEAR(bound, exact, 1e-3 * exact) << v << " " << alpha;
+        }
+      }
+    }
+  }
+
+  const SolverPrecision fast = SolverPrecision::fast();
+  const double exact = gamma_exponential_mixture_bound(1e4, 0.05, 100, 2);
+  const double bound =
+      gamma_exponential_mixture_bound(1e4, 0.05, 100, 2, 0.05, fast);
+  EXPECT_GE(bound, exact);
+  EXPECT_NEAR(bound, exact, 1e-4 * exact);
+  EXPECT_GE(beta_binomial_mixture_bound(1e4, 0.05, 100, 0.2, 0.8, 0.05, true,
+                                        fast),
+            beta_binomial_mixture_bound(1e4, 0.05, 100, 0.2, 0.8));
+}
+
+// Run with CPPFLAGS=-DCONFSEQ_INSTRUMENT to exercise the counting.
+TEST(SolverCountersTest, CountsSolverWork) {
+  reset_solver_counters();
+  const GammaExponentialMixture halley(100, 0.05, 1);
+  halley.bound(1000, log(1 / 0.05));
+  const SolverCounters after_halley = solver_counters();
+  const BetaBinomialMixture bisected(100, 0.05, 0.2, 0.8, true);
+  bisected.bound(1000, log(1 / 0.05));
+  bernoulli_confidence_interval(30, 100, 0.05, 100);
+  const SolverCounters counters = solver_counters();
+  if (!instrumentation_enabled()) {
+    EXPECT_EQ(0u, counters.solves);
+    EXPECT_EQ(0u, counters.objective_evaluations);
+    return;
+  }
+  EXPECT_EQ(1u, after_halley.solves);
+  EXPECT_GT(after_halley.halley_steps, 0u);
+  EXPECT_EQ(0u, after_halley.bisection_steps);
+  EXPECT_GE(after_halley.special_function_calls,
+            after_halley.objective_evaluations);
+  EXPECT_EQ(after_halley.objective_evaluations,
+            after_halley.max_evaluations_per_solve);
+  EXPECT_EQ(4u, counters.solves);
+  EXPECT_GT(counters.bisection_steps, 0u);
+  EXPECT_GT(counters.objective_evaluations,
+            after_halley.objective_evaluations);
+  EXPECT_LE(counters.max_evaluations_per_solve,
+            counters.objective_evaluations);
+  reset_solver_counters();
+  EXPECT_EQ(0u, solver_counters().solves);
+}
+
+TEST(SolveBudgetTest, TruncatedSolvesStayConservative) {
+  const GammaExponentialMixture halley(100, 0.05, 1);
+  const BetaBinomialMixture bisected(100, 0.05, 0.2, 0.8, true);
+  const double halley_exact = halley.bound(1000, log(20));
+  const double bisected_exact = bisected.bound(1000, log(20));
+  const std::pair<double, double> ci_exact =
+      bernoulli_confidence_interval(30, 100, 0.05, 100);
+  const double lil_exact = EmpiricalProcessLILBound(0.05, 10, 0.85)(1000);
+  bool all_truncated = true, none_truncated = true;
+  for (uint64_t budget = 1; budget <= 200; budget++) {
+    SolveBudget limits;
+    limits.max_evaluations = budget;
+    SolveBudgetScope scope(limits);
+    EXPECT_GE(halley.bound(1000, log(20)), halley_exact);
+    EXPECT_GE(bisected.bound(1000, log(20)), bisected_exact);
+    const std::pair<double, double> ci =
+        bernoulli_confidence_interval(30, 100, 0.05, 100);
+    EXPECT_LE(ci.first, ci_exact.first);
+    EXPECT_GE(ci.second, ci_exact.second);
+    EXPECT_GE(EmpiricalProcessLILBound(0.05, 10, 0.85)(1000), lil_exact);
+    EXPECT_LE(scope.evaluations(), budget * (scope.truncations() + 1));
+    all_truncated = all_truncated && scope.truncated();
+    none_truncated = none_truncated && !scope.truncated();
+  }
+  EXPECT_FALSE(all_truncated);
+  EXPECT_FALSE(none_truncated);
+
+  // A past deadline stops the search at once, and an unlimited scope does
+  // not change the result.
+  SolveBudget past;
+  past.deadline = std::chrono::steady_clock::now();
+  {
+    SolveBudgetScope scope(past);
+    EXPECT_EQ(halley.bound(1000, log(20)),
+              std::numeric_limits<double>::infinity());
+    EXPECT_EQ(bernoulli_confidence_interval(30, 100, 0.05, 100),
+              std::make_pair(0.0, 1.0));
+    {
+      SolveBudgetScope unlimited((SolveBudget()));
+      EXPECT_EQ(bisected.bound(1000, log(20)), bisected_exact);
+      EXPECT_FALSE(unlimited.truncated());
+    }
+    EXPECT_EQ(scope.truncations(), 3u);
+  }
+  EXPECT_EQ(solve_budget_truncations(), 0u);
+  EXPECT_FALSE(solve_budget_exhausted());
+}
+
+TEST(SolveBudgetTest, TruncatedResultsAreNotCached) {
+  enable_boundary_cache(100);
+  SolveBudget past;
+  past.deadline = std::chrono::steady_clock::now();
+  {
+    SolveBudgetScope scope(past);
+    EXPECT_EQ(bernoulli_confidence_interval(700, 1000, 0.05, 100),
+              std::make_pair(0.0, 1.0));
+  }
+  const std::pair<double, double> ci =
+      bernoulli_confidence_interval(700, 1000, 0.05, 100);
+  EXPECT_NEAR(ci.first, 0.651629, 1e-5);
+  EXPECT_EQ(boundary_cache_stats().misses, 2);
+  EXPECT_EQ(boundary_cache_stats().size, 1);
+  disable_boundary_cache();
+}
+
+TEST(IncompleteGammaApproximationTest, MaxError) {
+  // Boost.Math itself slows down and loses accuracy for much larger a.
+  double max_lower_error = 0, max_upper_error = 0;
+  int num_tabulated = 0;
+  for (double a = 4; a < 1e7; a *= 1.41) {
+    const double t = 1 / sqrt(a);
+    for (double w = -6; w <= 10; w += 0.173) {
+      const double lower = IncompleteGammaApproximation::lower()(t, w);
+      if (!std::isnan(lower)) {
+        num_tabulated++;
+        max_lower_error = std::max(
+            max_lower_error,
+            std::abs(lower - log(boost::math::gamma_p(a, a + w * sqrt(a)))));
+      }
+      const double upper = IncompleteGammaApproximation::upper()(t, w);
+      if (!std::isnan(upper)) {
+        max_upper_error = std::max(
+            max_upper_error,
+            std::abs(upper - log(boost::math::gamma_q(a + w * sqrt(a), a))));
+      }
+    }
+  }
+  EXPECT_LT(max_lower_error, IncompleteGammaApproximation::max_error());
+  EXPECT_LT(max_upper_error, IncompleteGammaApproximation::max_error());
+  EXPECT_GT(num_tabulated, 2000);
+
+  EXPECT_TRUE(std::isnan(IncompleteGammaApproximation::lower()(0.6, 0)));
+  EXPECT_TRUE(std::isnan(IncompleteGammaApproximation::lower()(0.1, 11)));
+  EXPECT_TRUE(std::isnan(IncompleteGammaApproximation::upper()(0.5, -2)));
+  // Outside the table, FAST falls back to Boost.Math.
+  for (const double a : {0.5, 2.0, 50.0, 1e4}) {
+    for (const double x : {0.9 * a, a, a + 3 * sqrt(a), a + 20 * sqrt(a)}) {
+      EXPECT_NEAR(log_gamma_p(a, x, SpecialFunctionPrecision::FAST),
+                  log_gamma_p(a, x), 1e-6 * (1 - log_gamma_p(a, x)))
+          << a << " " << x;
+      EXPECT_NEAR(log_gamma_q(x, a, SpecialFunctionPrecision::FAST),
+                  log_gamma_q(x, a), 1e-6 * (1 - log_gamma_q(x, a)))
+          << a << " " << x;
+    }
+  }
+}
+
+TEST(MixturePValuesTest, MatchesLogSuperMGWithRunningMinimum) {
+  const size_t n = 10000;
+  std::vector<double> s(n), v(n);
+  for (size_t i = 0; i < n; i++) {
+    v[i] = i + 1;
+    s[i] = 0.05 * (i + 1) + 30 * std::sin(i / 300.0);
+  }
+  const GammaExponentialMixture gamma_mixture(100, 0.05, 2);
+  const TwoSidedNormalMixture normal_mixture(100, 0.05);
+  for (const MixtureSupermartingale* mixture :
+           {static_cast<const MixtureSupermartingale*>(&gamma_mixture),
+            static_cast<const MixtureSupermartingale*>(&normal_mixture)}) {
+    std::vector<double> p_values(n), always_valid(n);
+    mixture_p_values(*mixture, s.data(), v.data(), n, false, p_values.data());
+    mixture_p_values(*mixture, s.data(), v.data(), n, true,
+                     always_valid.data());
+    double running_min = 1;
+    for (size_t i = 0; i < n; i++) {
+      const double expected =
+          std::min(1.0, exp(-mixture->log_superMG(s[i], v[i])));
+      EXPECT_NEAR(expected, p_values[i], 1e-12 * expected) << i;
+      running_min = std::min(running_min, p_values[i]);
+      EXPECT_EQ(running_min, always_valid[i]) << i;
+    }
+    EXPECT_LT(always_valid.back(), 1e-3);
+  }
+
+  const std::vector<double> with_nan = {
+      40, std::numeric_limits<double>::quiet_NaN(), 20};
+  const std::vector<double> nan_v = {100, 100, 100};
+  std::vector<double> out(3);
+  mixture_p_values(gamma_mixture, with_nan.data(), nan_v.data(), 3, true,
+                   out.data());
+  EXPECT_LT(out[0], 1);
+  EXPECT_TRUE(std::isnan(out[1]));
+  EXPECT_TRUE(std::isnan(out[2]));
+}
+
+TEST(MixturePValuesTest, FirstCrossingsMatchRunningMinimum) {
+  const size_t n = 10000;
+  std::vector<double> s(2 * n), v(2 * n);
+  for (size_t i = 0; i < n; i++) {
+    v[i] = v[n + i] = i + 1;
+    s[i] = 0.05 * (i + 1) + 30 * std::sin(i / 300.0);
+    s[n + i] = 30 * std::sin(i / 300.0);
+  }
+  const GammaExponentialMixture mixture(100, 0.05, 2);
+  std::vector<double> p_values(n);
+  mixture_p_values(mixture, s.data(), v.data(), n, true, p_values.data());
+  const size_t expected =
+      std::find_if(p_values.begin(), p_values.end(),
+                   [](const double p) { return p <= 0.05; })
+      - p_values.begin() + 1;
+  ASSERT_LT(expected, n);
+  const std::vector<size_t> offsets = {0, n, n, 2 * n};
+  std::vector<FirstCrossing> crossings(3);
+  mixture_first_crossings(mixture, s.data(), v.data(), offsets.data(), 3,
+                          0.05, crossings.data());
+  EXPECT_EQ(crossings[0].time, expected);
+  EXPECT_EQ(crossings[0].p_value, p_values[expected - 1]);
+  EXPECT_EQ(crossings[1].time, 0);
+  EXPECT_EQ(crossings[1].p_value, 1);
+  mixture_p_values(mixture, s.data() + n, v.data() + n, n, true,
+                   p_values.data());
+  EXPECT_GT(p_values.back(), 0.05);
+  EXPECT_EQ(crossings[2].time, 0);
+  EXPECT_EQ(crossings[2].p_value, p_values.back());
+}
+
+TEST(TuneMixtureTest, MatchesSeparateBoundsAndPicksSmallestLoss) {
+  const size_t num_v = 700;
+  std::vector<double> v(num_v), weights(num_v);
+  for (size_t i = 0; i < num_v; i++) {
+    v[i] = 10 * (i + 1);
+    // Stopping is likeliest near v = 1000; weight the radius bound / v.
+    weights[i] = exp(-std::pow(log(v[i] / 1000), 2)) / v[i];
+  }
+  const std::vector<double> v_opts = {10, 100, 1000, 10000, 1e5};
+  std::vector<TwoSidedNormalMixture> mixtures;
+  std::vector<const MixtureSupermartingale*> candidates;
+  for (const double v_opt : v_opts) {
+    mixtures.emplace_back(v_opt, 0.05);
+  }
+  for (const auto& mixture : mixtures) {
+    candidates.push_back(&mixture);
+  }
+  const MixtureTuningResult result =
+      tune_mixture(candidates, v.data(), weights.data(), num_v, 0.05);
+  ASSERT_EQ(v_opts.size(), result.losses.size());
+  ASSERT_EQ(v_opts.size() * num_v, result.bounds.size());
+  for (size_t k = 0; k < v_opts.size(); k++) {
+    double loss = 0;
+    for (size_t i = 0; i < num_v; i++) {
+      const double expected = mixtures[k].bound(v[i], log(1 / 0.05));
+      EXPECT_NEAR(expected, result.bounds[k * num_v + i], 1e-8 * expected)
+          << k << " " << i;
+      loss += weights[i] * expected;
+    }
+    EXPECT_NEAR(loss, result.losses[k], 1e-8 * loss) << k;
+  }
+  EXPECT_EQ(2u, result.best_index);
+
+  const MixtureTuningResult unweighted =
+      tune_mixture(candidates, v.data(), nullptr, num_v, 0.05, 1);
+  double mean = 0;
+  for (size_t i = 0; i < num_v; i++) {
+    mean += result.bounds[i] / num_v;
+  }
+  EXPECT_NEAR(mean, unweighted.losses[0], 1e-8 * mean);
+
+  const std::vector<double> nan_v = {std::numeric_limits<double>::quiet_NaN()};
+  EXPECT_EQ(candidates.size(),
+            tune_mixture(candidates, nan_v.data(), nullptr, 1, 0.05)
+                .best_index);
+  EXPECT_THROW(tune_mixture({}, v.data(), nullptr, num_v, 0.05),
+               std::invalid_argument);
+  EXPECT_THROW(tune_mixture(candidates, v.data(), nullptr, num_v, 1),
+               std::invalid_argument);
+}
+
+TEST(MixtureBoundMultiTest, MatchesSeparateBounds) {
+  const std::vector<double> v = {0.5, 10, 100, 1000, 1e5};
+  const std::vector<double> log_thresholds = {
+      log(1 / 0.05), log(1 / 0.2), log(1 / 0.01), log(1 / 0.1),
+      log(1 / 0.05)};
+  const TwoSidedNormalMixture two_sided(100, 0.05);
+  const OneSidedNormalMixture one_sided(100, 0.05);
+  const GammaExponentialMixture gamma_exponential(100, 0.05, 2);
+  const GammaPoissonMixture gamma_poisson(100, 0.05, 2);
+  const BetaBinomialMixture beta_binomial(100, 0.05, 0.2, 0.8, false);
+  for (const MixtureSupermartingale* mixture :
+           std::vector<const MixtureSupermartingale*>{
+               &two_sided, &one_sided, &gamma_exponential, &gamma_poisson,
+               &beta_binomial}) {
+    std::vector<double> out(v.size() * log_thresholds.size());
+    mixture->bound_multi(v.data(), v.size(), log_thresholds.data(),
+                         log_thresholds.size(), out.data());
+    for (size_t i = 0; i < v.size(); i++) {
+      for (size_t j = 0; j < log_thresholds.size(); j++) {
+        const double expected = mixture->bound(v[i], log_thresholds[j]);
+        EXPECT_NEAR(expected, out[i * log_thresholds.size() + j],
+                    1e-9 * expected) << i << " " << j;
+      }
+    }
+  }
+}
+
+void expect_valid_table(const MixtureSupermartingale& mixture) {
+  const TabulatedBoundary table(mixture, ALPHA, 1, 1e5, 200);
+  for (double v = 0.5; v < 3e5; v *= 1.037) {
+    const double exact = mixture.bound(v, log(1 / ALPHA));
+    EXPECT_GE(table(v), exact);
+    if (v >= 1 && v <= 1e5) {
+      EXPECT_LT(table(v), exact * 1.001);
+    }
+  }
+}
+
+TEST(TabulatedBoundaryTest, UpperEnvelope) {
+  expect_valid_table(OneSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_valid_table(TwoSidedNormalMixture(V_OPT, ALPHA_OPT));
+  expect_valid_table(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2));
+  expect_valid_table(GammaPoissonMixture(V_OPT, ALPHA_OPT, 2));
+  expect_valid_table(BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, true));
+  expect_valid_table(BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, false));
+}
+
+TEST(TabulatedBoundaryTest, SaveAndLoad) {
+  const TabulatedBoundary table(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2),
+                                ALPHA, 1, 1e5, 100);
+  std::stringstream buffer;
+  table.save(buffer);
+  const TabulatedBoundary loaded = TabulatedBoundary::load(buffer);
+  EXPECT_EQ(loaded.alpha(), ALPHA);
+  EXPECT_EQ(loaded.num_points(), 100);
+  for (double v : {0.5, 1.0, 17.0, 1e3, 1e5, 1e6}) {
+    EXPECT_EQ(loaded(v), table(v));
+  }
+
+  std::stringstream garbage("not a table");
+  EXPECT_THROW(TabulatedBoundary::load(garbage), std::runtime_error);
+}
+
+TEST(TabulatedBoundaryTest, MapFile) {
+  const TabulatedBoundary table(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2),
+                                ALPHA, 1, 1e5, 100);
+  const std::string path = "tabulated_boundary_test.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    table.save(out);
+  }
+  const TabulatedBoundary mapped = TabulatedBoundary::map_file(path);
+  std::remove(path.c_str());
+  EXPECT_EQ(mapped.alpha(), ALPHA);
+  EXPECT_EQ(mapped.num_points(), 100);
+  for (double v : {0.5, 1.0, 17.0, 1e3, 1e5, 1e6}) {
+    EXPECT_EQ(mapped(v), table(v));
+  }
+  EXPECT_THROW(TabulatedBoundary::map_file("no_such_table.bin"),
+               std::runtime_error);
+}
+
+TEST(TabulatedBoundaryTest, LoadsVersion1) {
+  const TabulatedBoundary table(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2),
+                                ALPHA, 1, 1e5, 100);
+  std::stringstream current;
+  table.save(current);
+  const std::string bytes = current.str();
+  // Version 1 had no padding after the version and no slopes.
+  std::string version_1 = bytes.substr(0, 12) + bytes.substr(16, 16 + 200 * 8);
+  version_1[8] = 1;
+  std::stringstream buffer(version_1);
+  const TabulatedBoundary loaded = TabulatedBoundary::load(buffer);
+  for (double v : {0.5, 1.0, 17.0, 1e3, 1e5, 1e6}) {
+    EXPECT_EQ(loaded(v), table(v));
+  }
+}
+
+TEST(TabulatedBoundaryTest, RejectsCorruptTables) {
+  const TabulatedBoundary table(GammaExponentialMixture(V_OPT, ALPHA_OPT, 2),
+                                ALPHA, 1, 1e5, 100);
+  std::stringstream saved;
+  table.save(saved);
+  const std::string bytes = saved.str();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double inf = std::numeric_limits<double>::infinity();
+  // Offsets of alpha, the grid, the values and the slopes.
+  const size_t alpha = 16, grid = 32, values = grid + 800,
+      slopes = grid + 1600;
+  const std::string path = "corrupt_tabulated_boundary_test.bin";
+  for (const auto& corruption : std::vector<std::pair<size_t, double>>{
+           {alpha, 2}, {grid, -1}, {grid, 0}, {grid + 5 * 8, 1},
+           {grid + 7 * 8, nan}, {grid + 99 * 8, inf}, {values + 3 * 8, inf},
+           {values + 50 * 8, nan}, {slopes + 2 * 8, nan}}) {
+    std::string corrupt = bytes;
+    memcpy(&corrupt[corruption.first], &corruption.second, sizeof(double));
+    {
+      std::ofstream out(path, std::ios::binary);
+      out << corrupt;
+    }
+    EXPECT_THROW(TabulatedBoundary::map_file(path), std::runtime_error)
+        << corruption.first;
+    // load() recomputes the slopes rather than reading them.
+    if (corruption.first < slopes) {
+      std::stringstream buffer(corrupt);
+      EXPECT_THROW(TabulatedBoundary::load(buffer), std::runtime_error)
+          << corruption.first;
+    }
+  }
+  std::remove(path.c_str());
+  // A header promising far more points than follow, without allocating for
+  // them.
+  std::string oversized = bytes;
+  const uint64_t max_points = uint64_t(1) << 40;
+  memcpy(&oversized[24], &max_points, sizeof(uint64_t));
+  std::stringstream buffer(oversized);
+  EXPECT_THROW(TabulatedBoundary::load(buffer), std::runtime_error);
+}
+
+TEST(TabulatedBoundaryTest, Float32IsConservative) {
+  const GammaExponentialMixture mixture(V_OPT, ALPHA_OPT, 2);
+  const TabulatedBoundary table(mixture, ALPHA, 1, 1e5, 100);
+  std::vector<float> v;
+  for (float x = 0.5; x < 2e5; x *= 1.07) {
+    v.push_back(x);
+  }
+  std::vector<float> out(v.size());
+  table.bound_sequence(v.data(), v.size(), out.data());
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_GE(out[i], table(v[i])) << v[i];
+    EXPECT_NEAR(out[i], table(v[i]), 1e-6 * table(v[i])) << v[i];
+  }
+}
+
+TEST(BoundarySequenceTest, MatchesEagerBounds) {
+  const GammaExponentialMixture mixture(V_OPT, ALPHA_OPT, 2);
+  BoundarySequence sequence(std::make_unique<GammaExponentialMixture>(mixture),
+                            ALPHA, 1000000, 0.25, 0, 100);
+  EXPECT_EQ(sequence.num_cached_chunks(), 0);
+  for (const size_t i : {0, 3, 99, 100, 54321, 999999}) {
+    const double exact = mixture.bound((i + 1) / 4.0, log(1 / ALPHA));
+    EXPECT_NEAR(sequence[i], exact, 1e-7 * exact) << i;
+  }
+  // 0, 3 and 99 share the first chunk.
+  EXPECT_EQ(sequence.num_cached_chunks(), 4);
+  EXPECT_THROW(sequence[1000000], std::out_of_range);
+
+  // A range across cached and uncached chunks caches nothing new.
+  std::vector<double> range(400);
+  sequence.values(50, 450, range.data());
+  EXPECT_EQ(sequence.num_cached_chunks(), 4);
+  for (size_t i = 0; i < range.size(); i++) {
+    EXPECT_EQ(range[i], sequence[50 + i]) << i;
+  }
+}
+
+TEST(BoundarySequenceTest, DiscardBefore) {
+  BoundarySequence sequence(
+      std::make_unique<TwoSidedNormalMixture>(V_OPT, ALPHA_OPT), ALPHA, 1000,
+      1, 10, 10);
+  for (size_t i = 0; i < sequence.size(); i++) {
+    const double value = sequence[i];
+    sequence.discard_before(i);
+    EXPECT_LE(sequence.num_cached_chunks(), 1);
+    EXPECT_DOUBLE_EQ(value, normal_mixture_bound(i + 11, ALPHA, V_OPT,
+                                                 ALPHA_OPT, false));
+  }
+  sequence.discard_before(sequence.size());
+  EXPECT_EQ(sequence.num_cached_chunks(), 0);
+  EXPECT_THROW(BoundarySequence(
+                   std::make_unique<TwoSidedNormalMixture>(V_OPT, ALPHA_OPT),
+                   ALPHA, 10, 1, -1),
+               std::invalid_argument);
+}
+
+void expect_valid_log_mixture_table(const BetaBinomialMixture& mixture) {
+  const TabulatedBetaBinomialMixture table(mixture, 1, 1e5);
+  const double g = mixture.g(), h = mixture.h();
+  for (double v = 0.5; v < 3e5; v *= 1.13) {
+    for (double z = -8; z <= 8; z += 0.37) {
+      const double s = std::max(-v / h, std::min(v / g, z * sqrt(v)));
+      const double exact = mixture.log_superMG(s, v);
+      const std::pair<double, double> bounds = table.log_superMG_bounds(s, v);
+      EXPECT_LE(bounds.first, exact) << s << " " << v;
+      EXPECT_GE(bounds.second, exact) << s << " " << v;
+      EXPECT_EQ(table.log_superMG(s, v), bounds.first);
+      if (v >= 1 && v <= 1e5 && std::abs(z) < 6) {
+        EXPECT_GT(bounds.first, exact - 0.1) << s << " " << v;
+      }
+    }
+  }
+  EXPECT_GE(table.bound(1e3, log(1 / ALPHA)),
+            mixture.bound(1e3, log(1 / ALPHA)));
+}
+
+TEST(TabulatedBetaBinomialMixtureTest, CertifiedBounds) {
+  expect_valid_log_mixture_table(
+      BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, true));
+  expect_valid_log_mixture_table(
+      BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.2, 0.8, false));
+  expect_valid_log_mixture_table(
+      BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.5, 0.5, false));
+  EXPECT_THROW(TabulatedBetaBinomialMixture(
+                   BetaBinomialMixture(V_OPT, ALPHA_OPT, 0.5, 0.5, false),
+                   1, 1e5, 2),
+               std::invalid_argument);
+}
+
+TEST(ConstantsBundleTest, MatchesComputedConstants) {
+  ConstantsBundleGrid grid;
+  grid.lil_alpha = {0.05};
+  grid.lil_A = {0.85};
+  grid.v_opt = {100};
+  grid.alpha_opt = {0.05};
+  grid.gamma_c = {2};
+  grid.beta_binomial_p = {0.3};
+  grid.t_opt = {50};
+  const ConstantsBundle bundle = ConstantsBundle::build(grid);
+  // One C, two leading constants, and four normalizers from two v_opt by two
+  // sidednesses.
+  EXPECT_EQ(7u, bundle.size());
+
+  const auto evaluate = []() {
+    return std::vector<double>{
+        EmpiricalProcessLILBound(0.05, 1, 0.85)(1000),
+        GammaExponentialMixture(100, 0.05, 2).log_superMG(30, 100),
+        GammaPoissonMixture(100, 0.05, 2).log_superMG(30, 100),
+        BetaBinomialMixture(100, 0.05, 0.3, 0.7, true).log_superMG(10, 100),
+        BetaBinomialMixture(50 * 0.3 * (1 - 0.3), 0.05, 0.3, 0.7, false)
+            .log_superMG(5, 40)};
+  };
+  const std::vector<double> computed = evaluate();
+
+  const std::string path = "constants_bundle_test.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    bundle.save(out);
+  }
+  const ConstantsBundle mapped = ConstantsBundle::map_file(path);
+  std::remove(path.c_str());
+  EXPECT_EQ(bundle.size(), mapped.size());
+  set_constants_bundle(std::make_shared<const ConstantsBundle>(mapped));
+  EXPECT_EQ(computed, evaluate());
+
+  // Constructors read the bundle rather than compute.
+  const double rho = OneSidedNormalMixture::best_rho(100, 0.05);
+  double constant;
+  ASSERT_TRUE(mapped.find(BundledConstant::GAMMA_EXPONENTIAL_LEADING_CONSTANT,
+                          {rho, 2, 0, 0}, constant));
+  std::vector<ConstantsBundle::Entry> shifted = {
+      {uint32_t(BundledConstant::GAMMA_EXPONENTIAL_LEADING_CONSTANT), 0,
+       {rho, 2, 0, 0}, constant + 1}};
+  set_constants_bundle(
+      std::make_shared<const ConstantsBundle>(std::move(shifted)));
+  EXPECT_EQ(computed[1] + 1,
+            GammaExponentialMixture(100, 0.05, 2).log_superMG(30, 100));
+  // Missing constants are computed.
+  EXPECT_EQ(computed[2],
+            GammaPoissonMixture(100, 0.05, 2).log_superMG(30, 100));
+  set_constants_bundle(nullptr);
+  EXPECT_EQ(computed, evaluate());
+
+  std::stringstream truncated;
+  bundle.save(truncated);
+  std::stringstream buffer(truncated.str().substr(0, 100));
+  EXPECT_THROW(ConstantsBundle::load(buffer), std::runtime_error);
+  // A corrupt entry count fails as truncated data, not bad_alloc.
+  std::string oversized = truncated.str();
+  const uint64_t num_entries = uint64_t(1) << 40;
+  oversized.replace(16, sizeof(num_entries),
+                    reinterpret_cast<const char*>(&num_entries),
+                    sizeof(num_entries));
+  std::stringstream oversized_buffer(oversized);
+  EXPECT_THROW(ConstantsBundle::load(oversized_buffer), std::runtime_error);
+  EXPECT_THROW(ConstantsBundle::map_file("no_such_bundle.bin"),
+               std::runtime_error);
+}
+
+TEST(BoundaryCacheTest, LeastRecentlyUsedEviction) {
+  BoundaryCache cache(2);
+  int calls = 0;
+  auto compute = [&calls]() {
+    calls++;
+    return std::make_pair(1.0 * calls, 0.0);
+  };
+  const BoundaryCacheKey a = {1}, b = {2}, c = {3};
+  EXPECT_EQ(cache.get_or_compute(a, compute).first, 1);
+  EXPECT_EQ(cache.get_or_compute(b, compute).first, 2);
+  EXPECT_EQ(cache.get_or_compute(a, compute).first, 1);
+  EXPECT_EQ(cache.get_or_compute(c, compute).first, 3);
+  // b was least recently used, so it was evicted
+  EXPECT_EQ(cache.get_or_compute(b, compute).first, 4);
+  EXPECT_EQ(cache.get_or_compute(c, compute).first, 3);
+  const BoundaryCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 4);
+  EXPECT_EQ(stats.size, 2);
+}
+
+TEST(BoundaryCacheTest, NaNKeysAreNotStored) {
+  BoundaryCache cache(2);
+  int calls = 0;
+  auto compute = [&calls]() {
+    calls++;
+    return std::make_pair(1.0 * calls, 0.0);
+  };
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const BoundaryCacheKey a = {1}, b = {2}, c = {3}, with_nan = {1, nan};
+  for (int i = 0; i < 100; i++) {
+    cache.get_or_compute(with_nan, compute);
+    cache.get_or_compute(i % 2 ? a : c, compute);
+    cache.get_or_compute(b, compute);
+  }
+  // Only b hits: a and c evict each other, and NaN keys always miss.
+  EXPECT_EQ(calls, 201);
+  const BoundaryCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 99);
+  EXPECT_EQ(stats.misses, 201);
+  EXPECT_EQ(stats.size, 2);
+  EXPECT_EQ(cache.get_or_compute(a, compute).first, 201);
+  EXPECT_EQ(cache.get_or_compute(b, compute).first, 3);
+}
+
+TEST(BoundaryCacheTest, ProcessWideCache) {
+  enable_boundary_cache(100);
+  const double bound = gamma_exponential_mixture_bound(100, ALPHA, V_OPT, 2);
+  EXPECT_NEAR(bound, 33.02017, 1e-5);
+  EXPECT_EQ(gamma_exponential_mixture_bound(100, ALPHA, V_OPT, 2), bound);
+  std::pair<double, double> ci =
+      bernoulli_confidence_interval(700, 1000, 0.05, 100);
+  ci = bernoulli_confidence_interval(700, 1000, 0.05, 100);
+  EXPECT_NEAR(ci.first, 0.651629, 1e-5);
+  MixtureBoundary boundary(
+      std::make_unique<GammaExponentialMixture>(V_OPT, ALPHA_OPT, 2));
+  EXPECT_EQ(boundary(100, ALPHA), bound);
+  EXPECT_EQ(boundary(100, ALPHA), bound);
+  const BoundaryCacheStats stats = boundary_cache_stats();
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.misses, 3);
+  disable_boundary_cache();
+  EXPECT_EQ(boundary_cache_stats().capacity, 0);
+}
+
+class RecordingTraceHook : public TraceHook {
+ public:
+  void begin(const TracedFunction function, const size_t input_size)
+      override {
+    begun.emplace_back(function, input_size);
+  }
+  void end(const TracedFunction function, const size_t input_size,
+           const uint64_t /*elapsed_ns*/) override {
+    ended.emplace_back(function, input_size);
+  }
+
+  std::vector<std::pair<TracedFunction, size_t>> begun, ended;
+};
+
+TEST(LatencyTracingTest, HookSeesEntryPoints) {
+  auto hook = std::make_shared<RecordingTraceHook>();
+  set_trace_hook(hook);
+  gamma_exponential_mixture_bound(100.5, ALPHA, V_OPT, 2);
+  bernoulli_confidence_interval(30, 100, 0.05, 100);
+  const std::vector<double> x(20, 0.5);
+  std::vector<double> lower(x.size()), upper(x.size());
+  predmix_hoeffding_cs(x.data(), x.size(), 0.05, false, lower.data(),
+                       upper.data());
+  set_trace_hook(nullptr);
+  gamma_exponential_mixture_bound(100, ALPHA, V_OPT, 2);
+  const std::vector<std::pair<TracedFunction, size_t>> expected = {
+      {TracedFunction::GAMMA_EXPONENTIAL_MIXTURE_BOUND, 100},
+      {TracedFunction::BERNOULLI_CONFIDENCE_INTERVAL, 100},
+      {TracedFunction::PREDMIX_HOEFFDING_CS, 20}};
+  EXPECT_EQ(hook->begun, expected);
+  EXPECT_EQ(hook->ended, expected);
+  EXPECT_EQ(std::string(traced_function_name(
+                TracedFunction::BATCH_CONFIDENCE_SEQUENCES)),
+            "batch_confidence_sequences");
+}
+
+TEST(LatencyTracingTest, HistogramBucketsAndQuantiles) {
+  const int num_buckets = LatencyHistogram::NUM_BUCKETS;
+  for (const uint64_t ns : {0ull, 31ull, 32ull, 1000ull, 123456789ull,
+                            (1ull << 53) + 1, (1ull << 62) + 3}) {
+    const int index = LatencyHistogram::bucket_index(ns);
+    ASSERT_LT(index, num_buckets) << ns;
+    EXPECT_LT(double(ns), LatencyHistogram::bucket_upper_edge(index)) << ns;
+    EXPECT_LE(LatencyHistogram::bucket_upper_edge(index),
+              double(ns) * (1 + 1.0 / LatencyHistogram::SUB_BUCKETS) + 1)
+        << ns;
+    if (index > 0) {
+      EXPECT_GE(double(ns), LatencyHistogram::bucket_upper_edge(index - 1))
+          << ns;
+    }
+  }
+
+  EXPECT_LT(LatencyHistogram::bucket_index(~0ull), num_buckets);
+
+  LatencyHistogram histogram;
+  const TracedFunction function = TracedFunction::HEDGED_CS;
+  for (uint64_t ns = 1; ns <= 1000; ns++) {
+    histogram.record(function, 1000 * ns);
+  }
+  const LatencySummary summary = histogram.summary(function);
+  EXPECT_EQ(summary.count, 1000);
+  EXPECT_NEAR(summary.mean_ns, 500500, 1e-6);
+  EXPECT_EQ(summary.max_ns, 1000000);
+  EXPECT_NEAR(summary.p50_ns, 500000, 500000 / 32.0);
+  EXPECT_NEAR(summary.p99_ns, 990000, 990000 / 32.0);
+  EXPECT_EQ(histogram.quantile(TracedFunction::HEDGED_CS, 1),
+            LatencyHistogram::bucket_upper_edge(
+                LatencyHistogram::bucket_index(1000000)));
+  std::stringstream dump;
+  histogram.dump(dump);
+  EXPECT_NE(dump.str().find("hedged_cs"), std::string::npos);
+  EXPECT_EQ(dump.str().find("conjmix_hoeffding_cs"), std::string::npos);
+  histogram.reset();
+  EXPECT_EQ(histogram.summary(function).count, 0);
+  EXPECT_EQ(histogram.quantile(function, 0.5), 0);
+}
+
+TEST(ParallelForTest, CoversRangeOnce) {
+  std::vector<int> counts(10000, 0);
+  parallel_for(counts.size(), [&counts](const size_t i) { counts[i]++; }, 4,
+               100);
+  EXPECT_EQ(std::count(counts.begin(), counts.end(), 1), 10000);
+
+  std::vector<double> v(5000), serial(v.size()), parallel(v.size());
+  std::iota(v.begin(), v.end(), 1.0);
+  for (size_t i = 0; i < v.size(); i++) {
+    serial[i] = gamma_exponential_mixture_bound(v[i], ALPHA, V_OPT, 2);
+  }
+  parallel_for(v.size(), [&](const size_t i) {
+    parallel[i] = gamma_exponential_mixture_bound(v[i], ALPHA, V_OPT, 2);
+  }, 4, 100);
+  EXPECT_EQ(serial, parallel);
+}
+
+TEST(ParallelForTest, RethrowsExceptions) {
+  EXPECT_THROW(parallel_for(1000, [](const size_t i) {
+    if (i == 900) {
+      throw std::runtime_error("failure");
+    }
+  }, 4, 10), std::runtime_error);
+}
+
+TEST(ParallelSortTest, MatchesStdSort) {
+  unsigned state = 99;
+  for (const size_t n : {0, 1, 1000, 100003}) {
+    std::vector<double> values(n);
+    for (double& value : values) {
+      state = state * 1103515245 + 12345;
+      value = double(state >> 8) - 5e6;
+    }
+    std::vector<double> expected = values;
+    std::sort(expected.begin(), expected.end());
+    for (const int num_threads : {1, 3, 8}) {
+      std::vector<double> sorted = values;
+      parallel_sort(sorted.begin(), sorted.end(), num_threads, 100);
+      EXPECT_EQ(sorted, expected) << n << " " << num_threads;
+    }
+  }
+
+  std::vector<double> a_values(50000), b_values(30000);
+  std::iota(a_values.rbegin(), a_values.rend(), 0.0);
+  std::iota(b_values.rbegin(), b_values.rend(), 10.0);
+  const auto arms = two_arm_order_statistics(
+      a_values.data(), a_values.data() + a_values.size(), b_values.data(),
+      b_values.data() + b_values.size(), false);
+  EXPECT_EQ(arms[0]->get_order_statistic(1), 0);
+  EXPECT_EQ(arms[1]->get_order_statistic(30000), 30009);
+  EXPECT_EQ(arms[1]->count_less(20), 10);
+}
+
+TEST(ThreadPoolTest, RunsNestedAndConcurrentJobs) {
+  const int default_threads = get_num_threads();
+  set_num_threads(4);
+  EXPECT_EQ(thread_pool().num_workers(), 3);
+  // Tasks that submit jobs of their own finish even with every worker busy.
+  std::vector<std::atomic<int>> counts(64 * 1000);
+  parallel_for(64, [&counts](const size_t outer) {
+    parallel_for(1000, [&counts, outer](const size_t inner) {
+      counts[outer * 1000 + inner]++;
+    }, 4, 10);
+  }, 4, 1);
+  for (const auto& count : counts) {
+    ASSERT_EQ(count, 1);
+  }
+
+  std::vector<std::thread> callers;
+  std::vector<double> sums(4);
+  for (size_t caller = 0; caller < sums.size(); caller++) {
+    callers.emplace_back([&sums, caller]() {
+      std::vector<double> values(20000);
+      parallel_for(values.size(), [&values, caller](const size_t i) {
+        values[i] = double(i * (caller + 1));
+      }, 0, 100);
+      sums[caller] = std::accumulate(values.begin(), values.end(), 0.0);
+    });
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  for (size_t caller = 0; caller < sums.size(); caller++) {
+    EXPECT_EQ(sums[caller], 19999.0 * 20000 / 2 * (caller + 1));
+  }
+
+  EXPECT_THROW(parallel_for(1000, [](const size_t i) {
+    if (i % 100 == 7) {
+      throw std::runtime_error("failure");
+    }
+  }, 4, 10), std::runtime_error);
+  // The pool is usable after a failed job.
+  std::atomic<int> total(0);
+  parallel_for(1000, [&total](const size_t) { total++; }, 4, 10);
+  EXPECT_EQ(total, 1000);
+  set_num_threads(default_threads);
+}
+
+TEST(ThreadPoolTest, ReadsThreadCountWhileSetting) {
+  const int default_threads = get_num_threads();
+  std::atomic<bool> done(false);
+  std::atomic<int> invalid_reads(0);
+  std::thread reader([&]() {
+    while (!done) {
+      const int num_threads = get_num_threads();
+      if (num_threads != default_threads && num_threads != 2
+          && num_threads != 3) {
+        invalid_reads++;
+      }
+    }
+  });
+  std::vector<std::thread> setters;
+  for (const int num_threads : {2, 3}) {
+    setters.emplace_back([num_threads]() {
+      for (int i = 0; i < 20; i++) {
+        set_num_threads(num_threads);
+      }
+    });
+  }
+  for (auto& setter : setters) {
+    setter.join();
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(invalid_reads, 0);
+  EXPECT_EQ(thread_pool().num_workers() + 1, get_num_threads());
+  set_num_threads(default_threads);
+}
+
+TEST(ThreadPoolTest, ParsesCPUListsAndReadsTopology) {
+  EXPECT_EQ(parse_cpu_list("0-3,8,10-11\n"),
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(parse_cpu_list(""), std::vector<int>());
+  EXPECT_THROW(parse_cpu_list("3-1"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("0,,2"), std::invalid_argument);
+  EXPECT_GE(numa_topology().num_nodes(), 1u);
+  EXPECT_EQ(thread_pool().num_nodes(), numa_topology().num_nodes());
+}
+
+TEST(ThreadPoolTest, NodeRangesRunEveryTaskOnce) {
+  // Both nodes list CPU 0, which every machine has.
+  NumaTopology topology;
+  topology.node_cpus = {{0}, {0}};
+  ThreadPool pool(3, topology);
+  EXPECT_EQ(pool.num_nodes(), 2u);
+  for (const size_t num_tasks : {1, 2, 7, 1000}) {
+    std::vector<std::atomic<int>> counts(num_tasks);
+    const std::function<void(size_t)> task = [&counts](const size_t k) {
+      counts[k]++;
+    };
+    pool.run(num_tasks, task, 3);
+    for (const auto& count : counts) {
+      ASSERT_EQ(count, 1) << num_tasks;
+    }
+  }
+  // Without helpers there is one range, which the caller runs in order.
+  std::vector<size_t> order;
+  pool.run(10, [&order](const size_t k) { order.push_back(k); }, 0);
+  EXPECT_EQ(order, std::vector<size_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  EXPECT_THROW(pool.run(100, [](const size_t k) {
+    if (k == 60) {
+      throw std::runtime_error("failure");
+    }
+  }, 3), std::runtime_error);
+}
+
+TEST(ScratchArenaTest, ScopesNestAndRewind) {
+  reset_scratch_arena_stats();
+  ScratchScope outer;
+  const double* ones = outer.allocate<double>(1000, 1.0);
+  int* first;
+  {
+    ScratchScope inner;
+    first = inner.allocate<int>(10);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(first) % 64);
+    // Larger than the arena's first block, so a second one is added.
+    EXPECT_NE(nullptr, inner.allocate<char>(1 << 20));
+  }
+  {
+    ScratchScope inner;
+    EXPECT_EQ(first, inner.allocate<int>(10));
+  }
+  EXPECT_EQ(1000.0, std::accumulate(ones, ones + 1000, 0.0));
+  EXPECT_GE(scratch_arena_stats().high_water_bytes, (1u << 20) + 8000);
+  EXPECT_GT(scratch_arena_stats().reserved_bytes, 1u << 20);
+}
+
+TEST(ScratchArenaTest, RepeatedBatchesAllocateNothing) {
+  std::vector<double> values;
+  std::vector<size_t> offsets = {0};
+  unsigned state = 5;
+  for (size_t stream = 0; stream < 20; stream++) {
+    for (size_t i = 0; i < 50 + 10 * stream; i++) {
+      state = state * 1103515245 + 12345;
+      values.push_back(((state >> 16) % 1000) / 1000.0);
+    }
+    offsets.push_back(values.size());
+  }
+  StreamCSParams params;
+  params.kind = StreamCSKind::HEDGED;
+  params.breaks = 50;
+  const std::vector<double> lambdas(values.size(), 0.5);
+  BettingOptions options;
+  options.log_space = true;
+  auto run = [&](std::vector<double>& lower, std::vector<double>& upper) {
+    batch_confidence_sequences(values.data(), offsets.data(),
+                               offsets.size() - 1, params, lower.data(),
+                               upper.data(), 1);
+    betting_grid_cs(values.data(), values.size(), 50, lambdas.data(),
+                    lambdas.data(), options, 20, true, lower.data(),
+                    upper.data(), 1);
+  };
+  std::vector<double> lower(values.size()), upper(values.size());
+  run(lower, upper);
+  reset_scratch_arena_stats();
+  std::vector<double> repeated_lower(values.size());
+  std::vector<double> repeated_upper(values.size());
+  run(repeated_lower, repeated_upper);
+  EXPECT_EQ(0u, scratch_arena_stats().heap_allocations);
+  EXPECT_GT(scratch_arena_stats().high_water_bytes, 0u);
+  EXPECT_EQ(lower, repeated_lower);
+  EXPECT_EQ(upper, repeated_upper);
+}
+
+TEST(CounterRngTest, MatchesPhiloxKnownAnswers) {
+  const std::array<uint32_t, 4> zero = CounterRng::philox({{0, 0, 0, 0}},
+                                                          {{0, 0}});
+  EXPECT_EQ(zero, (std::array<uint32_t, 4>{
+      {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}}));
+  const uint32_t ones = 0xffffffff;
+  const std::array<uint32_t, 4> all_ones = CounterRng::philox(
+      {{ones, ones, ones, ones}}, {{ones, ones}});
+  EXPECT_EQ(all_ones, (std::array<uint32_t, 4>{
+      {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}}));
+
+  CounterRng first(7, 3), again(7, 3), other(7, 4);
+  bool differs = false;
+  for (int i = 0; i < 100; i++) {
+    const uint64_t value = first();
+    EXPECT_EQ(value, again());
+    differs = differs || value != other();
+  }
+  EXPECT_TRUE(differs);
+  double sum = 0;
+  for (int i = 0; i < 10000; i++) {
+    const double u = first.uniform();
+    ASSERT_TRUE(0 < u && u < 1);
+    sum += u;
+  }
+  EXPECT_NEAR(sum / 10000, 0.5, 0.02);
+}
+
 TEST(PolyStitchingTest, BasicTest) {
   EXPECT_NEAR(poly_stitching_bound(100, ALPHA, 10, 3), 64.48755, 1e-5);
 }
@@ -69,17 +1474,242 @@ TEST(PolyStitchingTest, NegativeC) {
   EXPECT_NEAR(poly_stitching_bound(100, ALPHA, 10, -1), 28.99389, 1e-5);
 }
 
+TEST(PolyStitchingTest, BatchMatchesScalar) {
+  const PolyStitchingBound bound(10, 3, 1.4, 2.5);
+  // Including v below v_min, where the bound is flat.
+  std::vector<double> v, alpha;
+  for (int i = 0; i < 1000; i++) {
+    v.push_back(0.5 * i + 1);
+    alpha.push_back(0.001 + 0.0005 * i);
+  }
+  std::vector<double> sequence(v.size()), paired(v.size());
+  bound.bound_sequence(v.data(), v.size(), ALPHA, sequence.data());
+  bound.bounds(v.data(), alpha.data(), v.size(), paired.data());
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_DOUBLE_EQ(sequence[i], bound(v[i], ALPHA)) << i;
+    EXPECT_DOUBLE_EQ(paired[i], bound(v[i], alpha[i])) << i;
+  }
+  EXPECT_EQ(sequence[0], sequence[10]);
+}
+
+TEST(PolyStitchingTest, Float32MatchesDouble) {
+  const PolyStitchingBound bound(10, 3, 1.4, 2.5);
+  std::vector<float> v;
+  for (int i = 0; i < 1000; i++) {
+    v.push_back(0.5 * i * i + 1);
+  }
+  std::vector<float> out(v.size());
+  bound.bound_sequence(v.data(), v.size(), ALPHA, out.data());
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_GE(out[i], bound(v[i], ALPHA)) << i;
+    EXPECT_NEAR(out[i], bound(v[i], ALPHA), 1e-5 * bound(v[i], ALPHA)) << i;
+  }
+}
+
 TEST(EmpiricalProcessLILTest, TestBound) {
   EXPECT_NEAR(empirical_process_lil_bound(1000, .05, 100, 0.85),
               0.08204769, 1e-5);
 }
 
+TEST(EmpiricalProcessLILTest, TestMemoizedConstant) {
+  const double first = empirical_process_lil_bound(1000, .05, 100, 0.85);
+  EXPECT_EQ(empirical_process_lil_bound(1000, .05, 100, 0.85), first);
+  EXPECT_GT(empirical_process_lil_bound(1000, .01, 100, 0.85), first);
+  EXPECT_NEAR(empirical_process_lil_bound(1000, .05, 100, 0.85),
+              0.08204769, 1e-5);
+}
+
+TEST(EmpiricalProcessLILTest, Float32MatchesDouble) {
+  const EmpiricalProcessLILBound bound(.05, 100, 0.85);
+  std::vector<float> t = {1, 99, 100, 101, 1000, 1e4, 1e6, 1e9};
+  CounterRng rng(8, 0);
+  for (int i = 0; i < 20000; i++) {
+    t.push_back(100 * std::exp(18 * rng.uniform()));
+  }
+  std::vector<float> out(t.size());
+  bound.bound_sequence(t.data(), t.size(), out.data());
+  EXPECT_EQ(out[0], std::numeric_limits<float>::infinity());
+  EXPECT_EQ(out[1], std::numeric_limits<float>::infinity());
+  for (size_t i = 2; i < t.size(); i++) {
+    EXPECT_GE(out[i], bound(t[i])) << t[i];
+    EXPECT_NEAR(out[i], bound(t[i]), 1e-5 * bound(t[i])) << t[i];
+  }
+}
+
+TEST(EmpiricalProcessLILTest, ECDFBand) {
+  const EmpiricalProcessLILBound bound(.05, 100, 0.85);
+  std::vector<double> values;
+  unsigned state = 37;
+  for (int i = 0; i < 2000; i++) {
+    state = state * 1103515245 + 12345;
+    values.push_back((state >> 16) % 300);
+  }
+  CDFConfidenceSequence sequence(.05, 100);
+  sequence.add(values.begin(), values.begin() + 50);
+  EXPECT_EQ(sequence.interval(150), std::make_pair(0.0, 1.0));
+  sequence.add(values.begin() + 50, values.end());
+
+  const StaticOrderStatistics order_stats(values.begin(), values.end());
+  const double radius = bound(2000);
+  const std::vector<double> x = {-1, 0, 10.5, 150, 299, 1000};
+  std::vector<double> lower(x.size()), upper(x.size());
+  bound.ecdf_band(order_stats, x.data(), x.size(), lower.data(),
+                  upper.data());
+  for (size_t i = 0; i < x.size(); i++) {
+    const double cdf = std::count_if(values.begin(), values.end(),
+                                     [&](double v) { return v <= x[i]; })
+        / 2000.0;
+    EXPECT_DOUBLE_EQ(lower[i], std::max(0.0, cdf - radius)) << x[i];
+    EXPECT_DOUBLE_EQ(upper[i], std::min(1.0, cdf + radius)) << x[i];
+    EXPECT_EQ(sequence.interval(x[i]), std::make_pair(lower[i], upper[i]));
+  }
+
+  std::vector<double> distinct, distinct_lower, distinct_upper;
+  sequence.band(&distinct, &distinct_lower, &distinct_upper);
+  std::vector<double> sorted(values);
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  EXPECT_EQ(distinct, sorted);
+  std::vector<double> expected_lower(sorted.size()),
+      expected_upper(sorted.size());
+  bound.ecdf_band(order_stats, sorted.data(), sorted.size(),
+                  expected_lower.data(), expected_upper.data());
+  EXPECT_EQ(distinct_lower, expected_lower);
+  EXPECT_EQ(distinct_upper, expected_upper);
+  EXPECT_EQ(distinct_upper.back(), 1);
+}
+
 TEST(DoubleStitchingTest, TestBound) {
   EXPECT_NEAR(double_stitching_bound(0.5, 1000, 0.05, 100), 68.62803, 1e-5);
   EXPECT_NEAR(double_stitching_bound(0.9, 1000, 0.05, 100), 43.72119, 1e-5);
   EXPECT_NEAR(double_stitching_bound(0.1, 1000, 0.05, 100), 59.96521, 1e-5);
 }
 
+TEST(DoubleStitchingTest, TestBand) {
+  DoubleStitchingBound bound(100, 0.5, 1.4, 2);
+  const std::vector<double> p = {0.001, 0.1, 0.5, 0.9, 0.999};
+  std::vector<double> out(p.size());
+  bound.band(p.data(), p.size(), 1000, 0.05, out.data());
+  for (size_t i = 0; i < p.size(); i++) {
+    EXPECT_DOUBLE_EQ(out[i], bound(p[i], 1000, 0.05));
+  }
+
+  std::vector<double> values(1000);
+  std::iota(values.begin(), values.end(), 1.0);
+  StaticOrderStatistics order_stats(values.begin(), values.end());
+  std::vector<double> lower(p.size()), upper(p.size());
+  bound.quantile_band(order_stats, p.data(), p.size(), 0.05, lower.data(),
+                      upper.data());
+  EXPECT_EQ(lower[0], -std::numeric_limits<double>::infinity());
+  EXPECT_EQ(upper[4], std::numeric_limits<double>::infinity());
+  // values are 1..1000, so the kth order statistic equals k
+  EXPECT_EQ(lower[2], floor(500 - bound(0.5, 1000, 0.05) + 1));
+  EXPECT_EQ(upper[2], ceil(500 + bound(0.5, 1000, 0.05)));
+  EXPECT_EQ(upper[1], ceil(100 + bound(0.1, 1000, 0.05)));
+}
+
+TEST(DoubleStitchingTest, Float32Band) {
+  const DoubleStitchingBound bound(100, 0.5, 1.4, 2);
+  std::vector<float> p;
+  for (int i = 1; i < 1000; i++) {
+    p.push_back(i / 1000.0);
+  }
+  for (const double t : {10.0, 1000.0, 1e6}) {
+    std::vector<float> out(p.size());
+    bound.band(p.data(), p.size(), t, 0.05, out.data());
+    for (size_t i = 0; i < p.size(); i++) {
+      const double exact = bound(p[i], t, 0.05);
+      EXPECT_GE(out[i], exact) << p[i] << " " << t;
+      EXPECT_NEAR(out[i], exact, 1e-5 * exact) << p[i] << " " << t;
+    }
+  }
+}
+
+TEST(QuantileConfidenceSequenceTest, MatchesBandOnPrefixes) {
+  QuantileConfidenceSequence sequence(0.05, 100);
+  DoubleStitchingBound bound(100, 0.5, 1.4, 2);
+  EXPECT_EQ(sequence.interval(0.5).first,
+            -std::numeric_limits<double>::infinity());
+  const std::vector<double> p = {0.01, 0.5, 0.9, 0.99};
+  std::vector<double> values;
+  unsigned state = 4242;
+  for (int batch = 0; batch < 20; batch++) {
+    std::vector<double> batch_values(250);
+    for (double& value : batch_values) {
+      state = state * 1103515245 + 12345;
+      value = (state >> 8) % 100000;
+    }
+    sequence.add(batch_values.begin(), batch_values.end());
+    values.insert(values.end(), batch_values.begin(), batch_values.end());
+
+    StaticOrderStatistics order_stats(values.begin(), values.end());
+    std::vector<double> expected_lower(p.size()), expected_upper(p.size());
+    bound.quantile_band(order_stats, p.data(), p.size(), 0.05,
+                        expected_lower.data(), expected_upper.data());
+    std::vector<double> lower(p.size()), upper(p.size());
+    sequence.intervals(p.data(), p.size(), lower.data(), upper.data());
+    EXPECT_EQ(lower, expected_lower) << batch;
+    EXPECT_EQ(upper, expected_upper) << batch;
+    EXPECT_EQ(sequence.interval(0.5),
+              std::make_pair(expected_lower[1], expected_upper[1]));
+  }
+  EXPECT_EQ(sequence.size(), 5000);
+}
+
+TEST(QuantileBandMatrixTest, MatchesBandsOnPrefixes) {
+  const DoubleStitchingBound stitching(100, 0.5, 1.4, 2);
+  const EmpiricalProcessLILBound lil(0.05, 100, 0.85);
+  const std::vector<double> p = {0.001, 0.01, 0.5, 0.9, 0.999};
+  const std::vector<size_t> times = {0, 50, 100, 100, 1000, 4000};
+  std::vector<double> x;
+  unsigned state = 31;
+  for (size_t i = 0; i < times.back(); i++) {
+    state = state * 1103515245 + 12345;
+    x.push_back((state >> 8) % 100000);
+  }
+  const size_t size = times.size() * p.size();
+  std::vector<double> double_times(times.begin(), times.end());
+  std::vector<double> bounds(size);
+  stitching.band_matrix(double_times.data(), times.size(), p.data(),
+                        p.size(), 0.05, bounds.data(), 2);
+  std::vector<double> lower(size), upper(size), lil_lower(size),
+      lil_upper(size);
+  stitching.quantile_band_matrix(x.data(), times.data(), times.size(),
+                                 p.data(), p.size(), 0.05, lower.data(),
+                                 upper.data(), 2);
+  lil.quantile_band_matrix(x.data(), times.data(), times.size(), p.data(),
+                           p.size(), lil_lower.data(), lil_upper.data(), 2);
+  for (size_t i = 0; i < times.size(); i++) {
+    const double t = times[i];
+    const StaticOrderStatistics order_stats(x.begin(), x.begin() + times[i]);
+    std::vector<double> expected_lower(p.size()), expected_upper(p.size());
+    stitching.quantile_band(order_stats, p.data(), p.size(), 0.05,
+                            expected_lower.data(), expected_upper.data());
+    for (size_t j = 0; j < p.size(); j++) {
+      const size_t k = i * p.size() + j;
+      EXPECT_EQ(bounds[k], stitching(p[j], t, 0.05));
+      EXPECT_EQ(lower[k], expected_lower[j]) << t << " " << p[j];
+      EXPECT_EQ(upper[k], expected_upper[j]) << t << " " << p[j];
+      const double radius = t < 100 ? std::numeric_limits<double>::infinity()
+          : t * lil(t);
+      const double lower_index = floor(t * p[j] - radius + 1);
+      const double upper_index = ceil(t * p[j] + radius);
+      EXPECT_EQ(lil_lower[k], lower_index < 1
+                ? -std::numeric_limits<double>::infinity()
+                : order_stats.get_order_statistic(int(lower_index)));
+      EXPECT_EQ(lil_upper[k], upper_index > t
+                ? std::numeric_limits<double>::infinity()
+                : order_stats.get_order_statistic(int(upper_index)));
+    }
+  }
+  EXPECT_GT(lil_lower.back(), lil_lower[lil_lower.size() - 2]);
+  const std::vector<size_t> decreasing = {100, 50};
+  EXPECT_THROW(lil.quantile_band_matrix(x.data(), decreasing.data(), 2,
+                                        p.data(), p.size(), lil_lower.data(),
+                                        lil_upper.data()),
+               std::invalid_argument);
+}
+
 TEST(StaticOrderStatisticsTest, TestBasics) {
   std::array<int, 5> values = {1, 2, 3, 3, 5};
   StaticOrderStatistics os(values.begin(), values.end());
@@ -99,6 +1729,490 @@ TEST(StaticOrderStatisticsTest, TestBasics) {
   EXPECT_EQ(os.count_less_or_equal(10), 5);
 }
 
+TEST(StaticOrderStatisticsTest, NarrowValueTypes) {
+  const std::vector<int32_t> ints = {5, -3, 3, 1, 3, 2};
+  const std::vector<float> floats(ints.begin(), ints.end());
+  const StaticOrderStatistics expected(ints.begin(), ints.end());
+  const StaticOrderStatisticsT<int32_t> int_os(ints.begin(), ints.end());
+  const StaticOrderStatisticsT<float> float_os(floats.begin(), floats.end());
+  EXPECT_EQ(int_os.sorted_values(), nullptr);
+  EXPECT_NE(expected.sorted_values(), nullptr);
+  for (int k = 1; k <= 6; k++) {
+    EXPECT_EQ(int_os.get_order_statistic(k), expected.get_order_statistic(k));
+    EXPECT_EQ(float_os.get_order_statistic(k),
+              expected.get_order_statistic(k));
+  }
+  for (const double x : {-4.0, -3.0, 2.5, 3.0, 5.0, 6.0}) {
+    EXPECT_EQ(int_os.count_less(x), expected.count_less(x)) << x;
+    EXPECT_EQ(int_os.count_less_or_equal(x),
+              expected.count_less_or_equal(x)) << x;
+    EXPECT_EQ(float_os.count_less(x), expected.count_less(x)) << x;
+  }
+
+  std::vector<int32_t> a_values(1000), b_values(1000);
+  std::iota(a_values.begin(), a_values.end(), 1);
+  std::iota(b_values.begin(), b_values.end(), 86);
+  const std::vector<double> a_doubles(a_values.begin(), a_values.end());
+  const std::vector<double> b_doubles(b_values.begin(), b_values.end());
+  for (const bool assume_sorted : {false, true}) {
+    const auto int_arms = two_arm_order_statistics(
+        a_values.data(), a_values.data() + a_values.size(), b_values.data(),
+        b_values.data() + b_values.size(), assume_sorted);
+    const auto double_arms = two_arm_order_statistics(
+        a_doubles.data(), a_doubles.data() + a_doubles.size(),
+        b_doubles.data(), b_doubles.data() + b_doubles.size(),
+        assume_sorted);
+    QuantileABTest int_test(0.5, 100, 0.05, int_arms[0], int_arms[1]);
+    QuantileABTest double_test(0.5, 100, 0.05, double_arms[0],
+                               double_arms[1]);
+    EXPECT_NEAR(int_test.p_value(), double_test.p_value(), 1e-12);
+  }
+}
+
+TEST(SortedSearchIndexTest, MatchesStdBounds) {
+  CounterRng rng(11, 0);
+  // Sizes around block and tree boundaries, with heavy ties.
+  for (const size_t n : {0, 1, 15, 16, 17, 255, 256, 257, 1000, 4097}) {
+    std::vector<float> values(n);
+    for (float& value : values) {
+      value = rng() % 300;
+    }
+    std::sort(values.begin(), values.end());
+    const SortedSearchIndex index(values.data(), n);
+    for (double query = -2; query <= 302; query += 0.5) {
+      EXPECT_EQ(index.lower_bound(values.data(), n, query),
+                size_t(std::lower_bound(values.begin(), values.end(), query)
+                       - values.begin())) << n << " " << query;
+      EXPECT_EQ(index.upper_bound(values.data(), n, query),
+                size_t(std::upper_bound(values.begin(), values.end(), query)
+                       - values.begin())) << n << " " << query;
+    }
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_EQ(index.lower_bound(values.data(), n, nan), 0);
+    EXPECT_EQ(index.upper_bound(values.data(), n, nan), n);
+  }
+
+  std::vector<double> values(5000);
+  for (double& value : values) {
+    value = rng() % 700;
+  }
+  const StaticOrderStatistics os(values.begin(), values.end());
+  const StaticOrderStatistics compressed(values.begin(), values.end(), 1,
+                                         true);
+  std::sort(values.begin(), values.end());
+  for (double query = -1; query <= 701; query += 0.5) {
+    const int less = std::lower_bound(values.begin(), values.end(), query)
+        - values.begin();
+    const int less_or_equal =
+        std::upper_bound(values.begin(), values.end(), query) - values.begin();
+    EXPECT_EQ(os.count_less(query), less);
+    EXPECT_EQ(os.count_less_or_equal(query), less_or_equal);
+    EXPECT_EQ(compressed.count_less(query), less);
+    EXPECT_EQ(compressed.count_less_or_equal(query), less_or_equal);
+  }
+}
+
+TEST(OrderStatisticInterfaceTest, BatchCountsMatchSingleCounts) {
+  CounterRng rng(12, 0);
+  std::vector<double> values(3000);
+  for (double& value : values) {
+    value = rng() % 200;
+  }
+  std::vector<double> queries(700);
+  for (double& query : queries) {
+    query = rng.uniform() * 220 - 10;
+  }
+  std::vector<double> sorted_queries = queries;
+  std::sort(sorted_queries.begin(), sorted_queries.end());
+  // Repeats and queries past both ends.
+  sorted_queries.insert(sorted_queries.begin(), {-20, -20});
+  sorted_queries.insert(sorted_queries.end(), {199, 199, 500});
+
+  const std::vector<std::shared_ptr<OrderStatisticInterface>> arms = {
+      std::make_shared<StaticOrderStatistics>(values.begin(), values.end()),
+      std::make_shared<StaticOrderStatistics>(values.begin(), values.end(),
+                                              1, true),
+      std::make_shared<StaticOrderStatisticsT<float>>(values.begin(),
+                                                      values.end()),
+      std::make_shared<DynamicOrderStatistics>(values.begin(), values.end()),
+  };
+  for (const auto& arm : arms) {
+    for (const std::vector<double>* q : {&queries, &sorted_queries}) {
+      std::vector<int> less(q->size()), less_or_equal(q->size());
+      arm->count_less_batch(q->data(), q->size(), less.data());
+      arm->count_less_or_equal_batch(q->data(), q->size(),
+                                     less_or_equal.data(), 2);
+      for (size_t i = 0; i < q->size(); i++) {
+        EXPECT_EQ(less[i], arm->count_less((*q)[i])) << (*q)[i];
+        EXPECT_EQ(less_or_equal[i], arm->count_less_or_equal((*q)[i]))
+            << (*q)[i];
+      }
+    }
+  }
+}
+
+TEST(SortedOrderStatisticsViewTest, MatchesStatic) {
+  const std::array<double, 5> values = {1, 2, 3, 3, 5};
+  SortedOrderStatisticsView os(values.data(), values.data() + values.size());
+  StaticOrderStatistics expected(values.begin(), values.end());
+  EXPECT_EQ(os.size(), 5);
+  for (int k = 1; k <= 5; k++) {
+    EXPECT_EQ(os.get_order_statistic(k), expected.get_order_statistic(k));
+  }
+  for (const double x : {-1.0, 1.0, 3.0, 4.0, 5.0, 10.0}) {
+    EXPECT_EQ(os.count_less(x), expected.count_less(x)) << x;
+    EXPECT_EQ(os.count_less_or_equal(x), expected.count_less_or_equal(x)) << x;
+  }
+}
+
+TEST(MappedOrderStatisticsTest, ExternalSortMatchesStatic) {
+  std::vector<double> values(10007);
+  unsigned state = 4321;
+  for (double& value : values) {
+    state = state * 1103515245 + 12345;
+    value = double((state >> 16) % 3000) - 1000;
+  }
+  const std::string input_path = testing::TempDir() + "column_input.bin";
+  const std::string path = testing::TempDir() + "sorted_column.bin";
+  {
+    std::ofstream file(input_path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(values.data()),
+               values.size() * sizeof(double));
+  }
+  build_sorted_column(input_path, path, 1000);
+  EXPECT_FALSE(std::ifstream(path + ".run0").good());
+
+  const auto mapped = std::make_shared<MappedOrderStatistics>(
+      MappedOrderStatistics::map_file(path));
+  std::ifstream file(path, std::ios::binary);
+  const MappedOrderStatistics loaded = MappedOrderStatistics::load(file);
+  const auto expected = std::make_shared<StaticOrderStatistics>(
+      values.begin(), values.end());
+  ASSERT_EQ(mapped->size(), expected->size());
+  ASSERT_EQ(loaded.size(), expected->size());
+  EXPECT_TRUE(std::equal(mapped->sorted_values(),
+                         mapped->sorted_values() + mapped->size(),
+                         expected->sorted_values()));
+  for (int k = 1; k <= expected->size(); k += 101) {
+    EXPECT_EQ(loaded.get_order_statistic(k), expected->get_order_statistic(k));
+  }
+  for (const double x : {-2000.0, -1000.0, 0.5, 1000.0, 1999.0, 3000.0}) {
+    EXPECT_EQ(mapped->count_less(x), expected->count_less(x)) << x;
+    EXPECT_EQ(mapped->count_less_or_equal(x),
+              expected->count_less_or_equal(x)) << x;
+  }
+
+  std::vector<double> shifted = values;
+  for (double& value : shifted) {
+    value += 150;
+  }
+  const auto other = std::make_shared<StaticOrderStatistics>(
+      shifted.begin(), shifted.end());
+  QuantileABTest mapped_test(0.5, 100, 0.05, mapped, other);
+  QuantileABTest expected_test(0.5, 100, 0.05, expected, other);
+  EXPECT_EQ(mapped_test.p_value(), expected_test.p_value());
+
+  std::string oversized;
+  {
+    std::ifstream column(path, std::ios::binary);
+    oversized.assign(std::istreambuf_iterator<char>(column),
+                     std::istreambuf_iterator<char>());
+  }
+  const uint64_t num_values = std::numeric_limits<int>::max();
+  oversized.replace(16, sizeof(num_values),
+                    reinterpret_cast<const char*>(&num_values),
+                    sizeof(num_values));
+  std::stringstream oversized_column(oversized);
+  EXPECT_THROW(MappedOrderStatistics::load(oversized_column),
+               std::runtime_error);
+
+  {
+    std::ofstream truncated(input_path, std::ios::binary);
+    truncated << "abc";
+  }
+  EXPECT_THROW(build_sorted_column(input_path, path), std::runtime_error);
+  std::stringstream bad("not a column");
+  EXPECT_THROW(MappedOrderStatistics::load(bad), std::runtime_error);
+  std::remove(input_path.c_str());
+  std::remove(path.c_str());
+}
+
+TEST(DynamicOrderStatisticsTest, MatchesStatic) {
+  std::vector<double> values;
+  DynamicOrderStatistics os;
+  unsigned state = 12345;
+  for (int i = 0; i < 5000; i++) {
+    state = state * 1103515245 + 12345;
+    values.push_back((state >> 16) % 1000);
+    os.insert(values.back());
+    if (i % 997 == 0 || i == 4999) {
+      StaticOrderStatistics expected(values.begin(), values.end());
+      ASSERT_EQ(os.size(), expected.size());
+      for (int k = 1; k <= os.size(); k += 13) {
+        EXPECT_EQ(os.get_order_statistic(k), expected.get_order_statistic(k));
+      }
+      EXPECT_EQ(os.get_order_statistic(os.size()),
+                expected.get_order_statistic(expected.size()));
+      for (const double x : {-1.0, 0.0, 250.0, 250.5, 999.0, 1000.0}) {
+        EXPECT_EQ(os.count_less(x), expected.count_less(x)) << x;
+        EXPECT_EQ(os.count_less_or_equal(x), expected.count_less_or_equal(x))
+            << x;
+      }
+    }
+  }
+
+  // Bulk inserts merge into the existing blocks.
+  std::vector<double> more(20000);
+  std::iota(more.begin(), more.end(), -10000.5);
+  os.insert(more.begin(), more.end());
+  values.insert(values.end(), more.begin(), more.end());
+  StaticOrderStatistics expected(values.begin(), values.end());
+  ASSERT_EQ(os.size(), expected.size());
+  for (int k = 1; k <= os.size(); k += 101) {
+    EXPECT_EQ(os.get_order_statistic(k), expected.get_order_statistic(k));
+  }
+  EXPECT_EQ(os.count_less(500), expected.count_less(500));
+  EXPECT_EQ(os.count_less_or_equal(500), expected.count_less_or_equal(500));
+}
+
+TEST(DynamicOrderStatisticsTest, MatchesStaticInQuantileABTest) {
+  std::array<int, 1000> a_values;
+  std::iota(a_values.begin(), a_values.end(), 1);
+  auto a_os = std::make_shared<DynamicOrderStatistics>();
+  auto b_os = std::make_shared<DynamicOrderStatistics>();
+  for (const int value : a_values) {
+    a_os->insert(1001 - value);
+    b_os->insert(1086 - value);
+  }
+  QuantileABTest test(0.5, 100, 0.05, a_os, b_os);
+  EXPECT_NEAR(test.p_value(), 0.0838055, 1e-5);
+}
+
+TEST(DynamicOrderStatisticsTest, SaveLoadAndMap) {
+  DynamicOrderStatistics os;
+  for (int i = 0; i < 3000; i++) {
+    os.insert((i * 7919) % 3001 - 1500.5);
+  }
+  const std::string path = testing::TempDir() + "dynamic_order_stats.bin";
+  {
+    std::ofstream file(path, std::ios::binary);
+    os.save(file);
+  }
+  std::ifstream file(path, std::ios::binary);
+  DynamicOrderStatistics loaded = DynamicOrderStatistics::load(file);
+  const MappedOrderStatistics mapped = MappedOrderStatistics::map_file(path);
+  ASSERT_EQ(loaded.size(), os.size());
+  ASSERT_EQ(mapped.size(), os.size());
+  for (int k = 1; k <= os.size(); k += 37) {
+    EXPECT_EQ(loaded.get_order_statistic(k), os.get_order_statistic(k));
+    EXPECT_EQ(mapped.get_order_statistic(k), os.get_order_statistic(k));
+  }
+  // The loaded copy keeps growing like the original.
+  loaded.insert(0.25);
+  os.insert(0.25);
+  EXPECT_EQ(loaded.count_less(0.25), os.count_less(0.25));
+  EXPECT_EQ(loaded.count_less_or_equal(0.25), os.count_less_or_equal(0.25));
+  std::remove(path.c_str());
+}
+
+TEST(HistogramOrderStatisticsTest, MatchesStatic) {
+  std::vector<double> values, distinct;
+  std::vector<int64_t> counts;
+  HistogramOrderStatistics streamed;
+  unsigned state = 54321;
+  for (int i = 0; i < 5000; i++) {
+    state = state * 1103515245 + 12345;
+    values.push_back((state >> 16) % 300);
+    streamed.insert(values.back());
+    distinct.push_back(values.back());
+    counts.push_back(1);
+  }
+  // Repeated and zero counts in the columns.
+  distinct.push_back(-7);
+  counts.push_back(3);
+  distinct.push_back(1000);
+  counts.push_back(0);
+  values.insert(values.end(), 3, -7);
+  streamed.insert(-7, 3);
+  const HistogramOrderStatistics os(distinct.data(), counts.data(),
+                                    distinct.size());
+  const StaticOrderStatistics expected(values.begin(), values.end());
+  EXPECT_EQ(os.values().size(), 301);
+  for (const HistogramOrderStatistics* histogram :
+           {&os, static_cast<const HistogramOrderStatistics*>(&streamed)}) {
+    ASSERT_EQ(histogram->size(), expected.size());
+    for (int k = 1; k <= expected.size(); k++) {
+      ASSERT_EQ(histogram->get_order_statistic(k),
+                expected.get_order_statistic(k)) << k;
+    }
+    for (const double x : {-8.0, -7.0, 0.0, 150.0, 150.5, 299.0, 1000.0}) {
+      EXPECT_EQ(histogram->count_less(x), expected.count_less(x)) << x;
+      EXPECT_EQ(histogram->count_less_or_equal(x),
+                expected.count_less_or_equal(x)) << x;
+    }
+  }
+
+  auto a_os = std::make_shared<HistogramOrderStatistics>();
+  auto b_os = std::make_shared<HistogramOrderStatistics>();
+  for (int value = 1; value <= 1000; value++) {
+    a_os->insert(value / 10);
+    b_os->insert((value + 85) / 10);
+  }
+  EXPECT_EQ(a_os->values().size(), 101);
+  std::vector<double> a_values, b_values;
+  for (int k = 1; k <= 1000; k++) {
+    a_values.push_back(a_os->get_order_statistic(k));
+    b_values.push_back(b_os->get_order_statistic(k));
+  }
+  QuantileABTest test(0.5, 100, 0.05, a_os, b_os);
+  QuantileABTest static_test(
+      0.5, 100, 0.05,
+      std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                              a_values.end()),
+      std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                              b_values.end()));
+  EXPECT_EQ(test.p_value(), static_test.p_value());
+
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const int64_t one = 1, negative = -1;
+  EXPECT_THROW(HistogramOrderStatistics(&nan, &one, 1), std::invalid_argument);
+  EXPECT_THROW(streamed.insert(1, negative), std::invalid_argument);
+}
+
+TEST(SketchOrderStatisticsTest, CountsWithinRankError) {
+  std::vector<double> values;
+  SketchOrderStatistics os(64);
+  unsigned state = 54321;
+  for (int i = 0; i < 100000; i++) {
+    state = state * 1103515245 + 12345;
+    values.push_back((state >> 8) % 100000);
+  }
+  os.insert(values.begin(), values.end());
+  StaticOrderStatistics expected(values.begin(), values.end());
+  ASSERT_EQ(os.size(), expected.size());
+  EXPECT_LT(os.num_retained(), 64 * 12);
+  EXPECT_GT(os.rank_error(), 0);
+  EXPECT_LE(os.rank_error(), 2 * 100000 * log2(100000 / 64.0) / 64);
+  for (double x = -1; x <= 100000; x += 997) {
+    EXPECT_NEAR(os.count_less(x), expected.count_less(x), os.rank_error());
+    EXPECT_NEAR(os.count_less_or_equal(x), expected.count_less_or_equal(x),
+                os.rank_error());
+  }
+  for (int k = 1; k <= os.size(); k += 4999) {
+    const double x = os.get_order_statistic(k);
+    EXPECT_GE(expected.count_less_or_equal(x), k - os.rank_error());
+    EXPECT_LE(expected.count_less(x), k + os.rank_error());
+  }
+
+  SketchOrderStatistics small(64);
+  small.insert(values.begin(), values.begin() + 63);
+  EXPECT_EQ(small.rank_error(), 0);
+  StaticOrderStatistics small_expected(values.begin(), values.begin() + 63);
+  for (int k = 1; k <= 63; k++) {
+    EXPECT_EQ(small.get_order_statistic(k),
+              small_expected.get_order_statistic(k));
+  }
+}
+
+TEST(SketchOrderStatisticsTest, ConservativeInQuantileABTest) {
+  std::vector<double> a_values(100000), b_values(100000);
+  std::iota(a_values.begin(), a_values.end(), 1);
+  std::iota(b_values.begin(), b_values.end(), 1501);
+  auto exact_test = [&](const double quantile_p) {
+    QuantileABTest test(
+        quantile_p, 100, 0.05,
+        std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                a_values.end()),
+        std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    return test.p_value();
+  };
+  auto sketch_test = [&](const double quantile_p) {
+    QuantileABTest test(
+        quantile_p, 100, 0.05,
+        std::make_shared<SketchOrderStatistics>(a_values.begin(),
+                                                a_values.end()),
+        std::make_shared<SketchOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    return test.p_value();
+  };
+  for (const double quantile_p : {0.1, 0.5, 0.9}) {
+    const double exact = exact_test(quantile_p);
+    const double sketched = sketch_test(quantile_p);
+    EXPECT_GE(sketched, exact) << quantile_p;
+    EXPECT_LT(exact, 0.01) << quantile_p;
+    EXPECT_LT(sketched, 0.5) << quantile_p;
+  }
+}
+
+TEST(SketchOrderStatisticsTest, MergedShardsStayWithinRankError) {
+  std::vector<double> values;
+  unsigned state = 2468;
+  for (int i = 0; i < 100000; i++) {
+    state = state * 1103515245 + 12345;
+    values.push_back((state >> 8) % 100000);
+  }
+  // Shards of uneven sizes, as from separate ingestion nodes.
+  SketchOrderStatistics merged(64);
+  size_t begin = 0;
+  for (int shard = 0; begin < values.size(); shard++) {
+    const size_t end = std::min(values.size(), begin + 1000 * (shard + 1));
+    SketchOrderStatistics part(values.begin() + begin, values.begin() + end,
+                               64);
+    std::stringstream wire;
+    part.save(wire);
+    merged.merge(SketchOrderStatistics::load(wire));
+    begin = end;
+  }
+  StaticOrderStatistics expected(values.begin(), values.end());
+  ASSERT_EQ(expected.size(), merged.size());
+  EXPECT_LT(merged.num_retained(), 64 * 12);
+  EXPECT_GT(merged.rank_error(), 0);
+  for (double x = -1; x <= 100000; x += 997) {
+    EXPECT_NEAR(expected.count_less(x), merged.count_less(x),
+                merged.rank_error());
+    EXPECT_NEAR(expected.count_less_or_equal(x),
+                merged.count_less_or_equal(x), merged.rank_error());
+  }
+
+  std::stringstream wire;
+  merged.save(wire);
+  const SketchOrderStatistics loaded = SketchOrderStatistics::load(wire);
+  EXPECT_EQ(merged.size(), loaded.size());
+  EXPECT_EQ(merged.rank_error(), loaded.rank_error());
+  for (int k = 1; k <= merged.size(); k += 4999) {
+    EXPECT_EQ(merged.get_order_statistic(k), loaded.get_order_statistic(k));
+  }
+
+  std::string corrupt = wire.str();
+  // Sizes follow the 16-byte header and k.
+  corrupt[24] ^= 1;
+  std::istringstream corrupt_in(corrupt);
+  EXPECT_THROW(SketchOrderStatistics::load(corrupt_in), std::runtime_error);
+  SketchOrderStatistics other_k(32);
+  EXPECT_THROW(merged.merge(other_k), std::invalid_argument);
+
+  const auto a_sketch = std::make_shared<SketchOrderStatistics>(64);
+  const auto b_sketch = std::make_shared<SketchOrderStatistics>(64);
+  std::vector<double> a_values(20000), b_values(20000);
+  std::iota(a_values.begin(), a_values.end(), 1);
+  std::iota(b_values.begin(), b_values.end(), 1001);
+  for (int shard = 0; shard < 4; shard++) {
+    const auto a_begin = a_values.begin() + shard * 5000;
+    const auto b_begin = b_values.begin() + shard * 5000;
+    a_sketch->merge(SketchOrderStatistics(a_begin, a_begin + 5000, 64));
+    b_sketch->merge(SketchOrderStatistics(b_begin, b_begin + 5000, 64));
+  }
+  QuantileABTest exact(
+      0.5, 100, 0.05,
+      std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                              a_values.end()),
+      std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                              b_values.end()));
+  QuantileABTest sketched(0.5, 100, 0.05, a_sketch, b_sketch);
+  EXPECT_GE(sketched.p_value(), exact.p_value());
+}
+
 double get_ab_p_value(const double quantile_p, const int offset) {
   std::array<int, 1000> a_values;
   std::iota(a_values.begin(), a_values.end(), 1);
@@ -121,6 +2235,435 @@ TEST(QuantileABTest, TestPValue) {
   EXPECT_NEAR(get_ab_p_value(0.9, 55), 0.0340463, 1e-5);
 }
 
+TEST(QuantileABTest, MinimizersIgnoreHints) {
+  // A mixture no other test uses, so the minimizer is searched for here.
+  const double quantile_p = 0.3;
+  const int t_opt = 123, N = 2000;
+  std::vector<double> a_values(N), b_values(N);
+  std::iota(a_values.begin(), a_values.end(), 1);
+  std::iota(b_values.begin(), b_values.end(), 31);
+  auto a_os = std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                      a_values.end());
+  auto b_os = std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                      b_values.end());
+  const QuantileABTest test(quantile_p, t_opt, 0.05, a_os, b_os);
+  // Stale minimizers near the true one used to seed the first search.
+  QuantileABTest::Minimizers minimizers = {{0.301, 0.299}};
+  const double p_value = test.p_value(minimizers);
+
+  const BetaBinomialMixture mixture(t_opt * quantile_p * (1 - quantile_p),
+                                    0.05, quantile_p, 1 - quantile_p, false);
+  auto objective = [&](double a) {
+    return mixture.log_superMG((a - quantile_p) * N,
+                               quantile_p * (1 - quantile_p) * N);
+  };
+  const double expected = boost::math::tools::brent_find_minima(
+      objective, 0.3 - 0.015, 0.3 + 0.015, 20).first;
+  EXPECT_EQ(minimizers[0], expected);
+  EXPECT_EQ(minimizers[1], expected);
+  QuantileABTest::Minimizers other = {{0.9, 0.1}};
+  EXPECT_EQ(test.p_value(other), p_value);
+  EXPECT_EQ(other, minimizers);
+}
+
+TEST(QuantileABTest, SharedConfigMatchesOwnConfig) {
+  const auto config = std::make_shared<const QuantileABTestConfig>(0.9, 100,
+                                                                   0.05);
+  EXPECT_EQ(config->num_cached_minimizers(), 0u);
+  std::vector<double> a_values(1000), b_values(1000);
+  std::iota(a_values.begin(), a_values.end(), 1);
+  std::iota(b_values.begin(), b_values.end(), 56);
+  auto a_os = std::make_shared<DynamicOrderStatistics>();
+  auto b_os = std::make_shared<DynamicOrderStatistics>();
+  // Refreshes as the arms grow, at 250, 500, ... observations per arm.
+  for (int refresh = 1; refresh <= 4; refresh++) {
+    for (int i = 250 * (refresh - 1); i < 250 * refresh; i++) {
+      a_os->insert(a_values[i]);
+      b_os->insert(b_values[i]);
+    }
+    const QuantileABTest shared(config, a_os, b_os);
+    const QuantileABTest own(0.9, 100, 0.05, a_os, b_os);
+    EXPECT_EQ(shared.p_value(), own.p_value()) << refresh;
+    EXPECT_EQ(shared.config(), config);
+    // Both arms have the same size, so one minimizer per refresh.
+    EXPECT_EQ(config->num_cached_minimizers(), size_t(refresh));
+  }
+  EXPECT_NEAR(QuantileABTest(config, a_os, b_os).p_value(),
+              get_ab_p_value(0.9, 55), 1e-12);
+  EXPECT_THROW(QuantileABTestConfig(0.5, 1000, 0.05,
+                                    QuantileABTest::tabulate_mixture(
+                                        0.5, 100, 0.05, 5000)),
+               std::invalid_argument);
+}
+
+TEST(QuantileABTest, ThresholdAwareSearch) {
+  std::array<int, 1000> a_values;
+  std::iota(a_values.begin(), a_values.end(), 1);
+  for (const int offset : {70, 85, 100}) {
+    std::array<int, 1000> b_values;
+    std::iota(b_values.begin(), b_values.end(), offset + 1);
+    QuantileABTest test(
+        0.5, 100, 0.05,
+        std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                a_values.end()),
+        std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    const double p_value = test.p_value();
+    for (const double alpha : {0.001, 0.01, 0.05, 0.1, 0.9}) {
+      EXPECT_EQ(test.rejects(alpha), p_value <= alpha) << offset << alpha;
+      EXPECT_EQ(test.capped_p_value(alpha), p_value <= alpha ? p_value : 1)
+          << offset << " " << alpha;
+    }
+  }
+}
+
+TEST(QuantileABTest, BatchOverQuantiles) {
+  std::array<int, 1000> a_values, b_values;
+  std::iota(a_values.begin(), a_values.end(), 1);
+  std::iota(b_values.begin(), b_values.end(), 56);
+  auto a_os = std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                      a_values.end());
+  auto b_os = std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                      b_values.end());
+  const std::array<double, 4> quantile_p = {0.5, 0.9, 0.95, 0.99};
+  std::array<double, 4> p_values;
+  quantile_ab_p_values(a_os, b_os, quantile_p.data(), quantile_p.size(), 100,
+                       0.05, p_values.data());
+  for (size_t i = 0; i < quantile_p.size(); i++) {
+    QuantileABTest test(quantile_p[i], 100, 0.05, a_os, b_os);
+    EXPECT_EQ(p_values[i], test.p_value()) << quantile_p[i];
+  }
+  EXPECT_NEAR(p_values[1], get_ab_p_value(0.9, 55), 1e-12);
+}
+
+TEST(QuantileABTest, BatchOverPairs) {
+  // Pairs of very different sizes, shuffled, with one empty arm.
+  const std::vector<size_t> sizes = {500, 5, 2000, 50, 0, 1000};
+  std::vector<double> arm1_values, arm2_values;
+  std::vector<size_t> arm1_offsets = {0}, arm2_offsets = {0};
+  std::vector<double> quantile_p;
+  std::vector<int> t_opt;
+  unsigned state = 17;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    for (size_t j = 0; j < sizes[i]; j++) {
+      state = state * 1103515245 + 12345;
+      arm1_values.push_back(double((state >> 16) % 997));
+      arm2_values.push_back(double((state >> 8) % 997) + 200 * (i % 2));
+    }
+    arm2_values.push_back(5);
+    arm1_offsets.push_back(arm1_values.size());
+    arm2_offsets.push_back(arm2_values.size());
+    quantile_p.push_back(i % 2 ? 0.5 : 0.9);
+    t_opt.push_back(50 + 10 * int(i));
+  }
+  std::vector<double> p_values(sizes.size());
+  batch_quantile_ab_p_values(arm1_values.data(), arm1_offsets.data(),
+                             arm2_values.data(), arm2_offsets.data(),
+                             sizes.size(), quantile_p.data(), t_opt.data(),
+                             0.05, p_values.data(), 3);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (sizes[i] == 0) {
+      EXPECT_EQ(1, p_values[i]);
+      continue;
+    }
+    QuantileABTest test(
+        quantile_p[i], t_opt[i], 0.05,
+        std::make_shared<StaticOrderStatistics>(
+            &arm1_values[arm1_offsets[i]], &arm1_values[arm1_offsets[i + 1]]),
+        std::make_shared<StaticOrderStatistics>(
+            &arm2_values[arm2_offsets[i]], &arm2_values[arm2_offsets[i + 1]]));
+    EXPECT_EQ(test.p_value(), p_values[i]) << i;
+  }
+  EXPECT_LT(p_values[5], 0.05);
+}
+
+TEST(QuantileABTest, MultiArmMatchesPairwise) {
+  // A control and three treatments of different sizes and shifts, one
+  // empty.
+  const std::vector<size_t> sizes = {800, 300, 0, 1200};
+  std::vector<double> values;
+  std::vector<size_t> offsets = {0};
+  unsigned state = 23;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    for (size_t j = 0; j < sizes[i]; j++) {
+      state = state * 1103515245 + 12345;
+      values.push_back(double((state >> 16) % 1000) + 150 * (i == 3));
+    }
+    offsets.push_back(values.size());
+  }
+  const MultiArmQuantileTest test(0.5, 100, 0.05, values.data(),
+                                  offsets.data(), sizes.size());
+  ASSERT_EQ(sizes.size(), test.num_arms());
+  std::vector<double> against(sizes.size());
+  test.p_values_against(0, against.data());
+  EXPECT_EQ(1, against[0]);
+  EXPECT_EQ(1, against[2]);
+  for (const size_t i : {size_t(1), size_t(3)}) {
+    const QuantileABTest pairwise(0.5, 100, 0.05, test.arm(i), test.arm(0));
+    EXPECT_EQ(pairwise.p_value(), against[i]) << i;
+  }
+  EXPECT_LT(against[3], 0.05);
+  EXPECT_GT(against[1], 0.05);
+
+  const std::vector<size_t> arm1 = {0, 0, 1, 3}, arm2 = {1, 3, 3, 1};
+  std::vector<double> p_values(arm1.size());
+  test.p_values(arm1.data(), arm2.data(), arm1.size(), p_values.data());
+  for (size_t k = 0; k < arm1.size(); k++) {
+    const QuantileABTest pairwise(0.5, 100, 0.05, test.arm(arm1[k]),
+                                  test.arm(arm2[k]));
+    EXPECT_EQ(pairwise.p_value(), p_values[k]) << k;
+  }
+  EXPECT_THROW(test.p_value(0, 4), std::out_of_range);
+}
+
+TEST(QuantileABTest, MergeScanMatchesRankQueries) {
+  // Dynamic order statistics expose no contiguous storage, so they take the
+  // rank-query path, while static ones take the merge scan.
+  std::vector<double> a_values, b_values;
+  unsigned state = 777;
+  for (int i = 0; i < 3000; i++) {
+    state = state * 1103515245 + 12345;
+    a_values.push_back((state >> 16) % 500);
+    state = state * 1103515245 + 12345;
+    b_values.push_back((state >> 16) % 500 + 20 + (i % 7));
+  }
+  for (const double quantile_p : {0.1, 0.5, 0.9}) {
+    QuantileABTest merged(
+        quantile_p, 100, 0.05,
+        std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                a_values.end()),
+        std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    QuantileABTest queried(
+        quantile_p, 100, 0.05,
+        std::make_shared<DynamicOrderStatistics>(a_values.begin(),
+                                                 a_values.end()),
+        std::make_shared<DynamicOrderStatistics>(b_values.begin(),
+                                                 b_values.end()));
+    EXPECT_EQ(merged.p_value(), queried.p_value()) << quantile_p;
+    EXPECT_LT(merged.p_value(), 1) << quantile_p;
+  }
+}
+
+TEST(QuantileABTest, RunScanMatchesMergeScan) {
+  std::vector<double> a_values, b_values;
+  unsigned state = 778;
+  for (int i = 0; i < 3000; i++) {
+    state = state * 1103515245 + 12345;
+    a_values.push_back((state >> 16) % 50);
+    state = state * 1103515245 + 12345;
+    b_values.push_back((state >> 16) % 50 + 5 + (i % 3));
+  }
+  // The same b arm as (value, count) columns.
+  std::vector<double> b_distinct;
+  std::vector<int64_t> b_counts;
+  for (int value = 0; value < 60; value++) {
+    b_distinct.push_back(value);
+    b_counts.push_back(std::count(b_values.begin(), b_values.end(), value));
+  }
+  auto a_runs = std::make_shared<StaticOrderStatistics>(
+      a_values.begin(), a_values.end(), 0, true);
+  auto b_runs = std::make_shared<StaticOrderStatistics>(
+      b_distinct.data(), b_counts.data(), b_distinct.size());
+  ASSERT_TRUE(a_runs->compressed());
+  EXPECT_EQ(a_runs->sorted_values(), nullptr);
+  EXPECT_EQ(a_runs->sorted_runs().size, 50);
+  EXPECT_EQ(b_runs->size(), 3000);
+  const StaticOrderStatistics a_sorted(a_values.begin(), a_values.end());
+  for (int k = 1; k <= 3000; k++) {
+    ASSERT_EQ(a_runs->get_order_statistic(k), a_sorted.get_order_statistic(k));
+  }
+  for (const double x : {-1.0, 0.0, 10.0, 10.5, 49.0, 50.0}) {
+    EXPECT_EQ(a_runs->count_less(x), a_sorted.count_less(x)) << x;
+    EXPECT_EQ(a_runs->count_less_or_equal(x), a_sorted.count_less_or_equal(x));
+  }
+  for (const double quantile_p : {0.1, 0.5, 0.9}) {
+    QuantileABTest runs(quantile_p, 100, 0.05, a_runs, b_runs);
+    QuantileABTest merged(
+        quantile_p, 100, 0.05,
+        std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                a_values.end()),
+        std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    // Mixed arms take the rank-query path.
+    QuantileABTest mixed(
+        quantile_p, 100, 0.05, a_runs,
+        std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    EXPECT_EQ(runs.p_value(), merged.p_value()) << quantile_p;
+    EXPECT_EQ(mixed.p_value(), merged.p_value()) << quantile_p;
+    EXPECT_LT(runs.p_value(), 1) << quantile_p;
+  }
+  const int64_t negative = -1;
+  const double value = 1;
+  EXPECT_THROW(StaticOrderStatistics(&value, &negative, 1),
+               std::invalid_argument);
+}
+
+TEST(QuantileABTest, TabulatedMixtureIsConservative) {
+  std::vector<double> a_values, b_values;
+  unsigned state = 4242;
+  for (int i = 0; i < 5000; i++) {
+    state = state * 1103515245 + 12345;
+    a_values.push_back((state >> 16) % 1000);
+    state = state * 1103515245 + 12345;
+    b_values.push_back((state >> 16) % 1000 + 80);
+  }
+  auto a_os = std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                      a_values.end());
+  auto b_os = std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                      b_values.end());
+  for (const double quantile_p : {0.1, 0.5, 0.9}) {
+    const QuantileABTest exact(quantile_p, 1000, 0.05, a_os, b_os);
+    const QuantileABTest tabulated(
+        quantile_p, 1000, 0.05, a_os, b_os,
+        QuantileABTest::tabulate_mixture(quantile_p, 1000, 0.05, 5000));
+    const double exact_p = exact.p_value();
+    EXPECT_LT(exact_p, 0.05) << quantile_p;
+    EXPECT_GE(tabulated.p_value(), exact_p) << quantile_p;
+    EXPECT_LT(tabulated.p_value(), exact_p * 1.1) << quantile_p;
+  }
+  EXPECT_THROW(QuantileABTest(0.5, 1000, 0.05, a_os, b_os,
+                              QuantileABTest::tabulate_mixture(0.5, 100, 0.05,
+                                                               5000)),
+               std::invalid_argument);
+}
+
+TEST(QuantileABTest, ShiftMatchesShiftedArm) {
+  std::vector<double> a_values, b_values;
+  unsigned state = 779;
+  for (int i = 0; i < 2000; i++) {
+    state = state * 1103515245 + 12345;
+    a_values.push_back((state >> 16) % 60 + 10);
+    state = state * 1103515245 + 12345;
+    b_values.push_back((state >> 16) % 60);
+  }
+  // Integer values and dyadic shifts keep the shifted values exact, so the
+  // three scan paths must agree with a test on the materialized b + delta.
+  const auto make_arms = [](const std::vector<double>& values) {
+    return std::vector<std::shared_ptr<OrderStatisticInterface>>{
+        std::make_shared<StaticOrderStatistics>(values.begin(), values.end()),
+        std::make_shared<StaticOrderStatistics>(values.begin(), values.end(),
+                                                0, true),
+        std::make_shared<DynamicOrderStatistics>(values.begin(),
+                                                 values.end())};
+  };
+  const auto a_arms = make_arms(a_values);
+  const auto b_arms = make_arms(b_values);
+  for (const double delta : {-20.0, 0.0, 4.5, 10.0, 12.25, 30.0}) {
+    std::vector<double> shifted(b_values);
+    for (double& value : shifted) {
+      value += delta;
+    }
+    const auto shifted_arms = make_arms(shifted);
+    for (size_t i = 0; i < a_arms.size(); i++) {
+      QuantileABTest test(0.5, 100, 0.05, a_arms[i], b_arms[i]);
+      QuantileABTest expected(0.5, 100, 0.05, a_arms[i], shifted_arms[i]);
+      EXPECT_EQ(test.shifted_p_value(delta), expected.p_value())
+          << delta << " " << i;
+      EXPECT_EQ(test.shifted_rejects(delta, 0.05), expected.rejects(0.05))
+          << delta << " " << i;
+    }
+  }
+
+  QuantileABTest test(0.5, 100, 0.05, a_arms[0], b_arms[0]);
+  EXPECT_EQ(test.shifted_p_value(0), test.p_value());
+  const std::pair<double, double> cs = test.quantile_difference_cs(0.05);
+  // The true difference of medians is 10.
+  EXPECT_LT(cs.first, 10);
+  EXPECT_GT(cs.second, 10);
+  EXPECT_GT(cs.first, 0);
+  EXPECT_LT(cs.second, 20);
+  EXPECT_TRUE(test.shifted_rejects(cs.first, 0.05));
+  EXPECT_TRUE(test.shifted_rejects(cs.second, 0.05));
+  EXPECT_FALSE(test.shifted_rejects(cs.first + 1e-3, 0.05));
+  EXPECT_FALSE(test.shifted_rejects(cs.second - 1e-3, 0.05));
+  for (size_t i = 1; i < a_arms.size(); i++) {
+    const std::pair<double, double> other =
+        QuantileABTest(0.5, 100, 0.05, a_arms[i], b_arms[i])
+        .quantile_difference_cs(0.05);
+    EXPECT_EQ(other.first, cs.first) << i;
+    EXPECT_EQ(other.second, cs.second) << i;
+  }
+  const std::pair<double, double> wider = test.quantile_difference_cs(0.01);
+  EXPECT_LE(wider.first, cs.first);
+  EXPECT_GE(wider.second, cs.second);
+
+  // Too few observations never reject any shift.
+  auto tiny = std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                      a_values.begin() + 3);
+  const std::pair<double, double> unbounded =
+      QuantileABTest(0.5, 100, 0.05, tiny, tiny).quantile_difference_cs(0.05);
+  EXPECT_EQ(unbounded.first, -std::numeric_limits<double>::infinity());
+  EXPECT_EQ(unbounded.second, std::numeric_limits<double>::infinity());
+  EXPECT_THROW(test.quantile_difference_cs(0), std::invalid_argument);
+  EXPECT_THROW(test.quantile_difference_cs(0.05, 0), std::invalid_argument);
+}
+
+TEST(SequentialQuantileABTest, MatchesFromScratchTests) {
+  SequentialQuantileABTest sequential(0.5, 100);
+  SequentialQuantileABTest running_only(0.5, 100);
+  EXPECT_EQ(sequential.p_value(), 1);
+  std::vector<double> a_values, b_values;
+  double running = 1;
+  for (int batch = 0; batch < 10; batch++) {
+    std::vector<double> a_batch(100), b_batch(100);
+    for (int i = 0; i < 100; i++) {
+      a_batch[i] = 100 * batch + i + 1;
+      b_batch[i] = 100 * batch + i + 101;
+    }
+    a_values.insert(a_values.end(), a_batch.begin(), a_batch.end());
+    b_values.insert(b_values.end(), b_batch.begin(), b_batch.end());
+    sequential.add(1, a_batch.begin(), a_batch.end());
+    sequential.add(2, b_batch.begin(), b_batch.end());
+    running_only.add(1, a_batch.begin(), a_batch.end());
+    running_only.add(2, b_batch.begin(), b_batch.end());
+
+    QuantileABTest test(
+        0.5, 100, 0.05,
+        std::make_shared<StaticOrderStatistics>(a_values.begin(),
+                                                a_values.end()),
+        std::make_shared<StaticOrderStatistics>(b_values.begin(),
+                                                b_values.end()));
+    const double expected = test.p_value();
+    running = std::min(running, expected);
+    EXPECT_NEAR(sequential.p_value(), expected, 1e-6 * expected) << batch;
+    EXPECT_NEAR(sequential.running_p_value(), running, 1e-6 * running)
+        << batch;
+    EXPECT_NEAR(running_only.running_p_value(), running, 1e-6 * running)
+        << batch;
+  }
+  EXPECT_EQ(sequential.order_stats(1).size(), 1000);
+  EXPECT_LT(running, 0.01);
+}
+
+TEST(SequentialQuantileABTest, CheckpointResumes) {
+  SequentialQuantileABTest test(0.5, 100);
+  std::vector<double> a_batch(300), b_batch(300);
+  for (int i = 0; i < 300; i++) {
+    a_batch[i] = i;
+    b_batch[i] = i + 40;
+  }
+  test.add(1, a_batch.begin(), a_batch.end());
+  test.add(2, b_batch.begin(), b_batch.end());
+  test.running_p_value();
+  std::stringstream checkpoint;
+  test.save(checkpoint);
+  SequentialQuantileABTest restored = SequentialQuantileABTest::load(
+      checkpoint);
+  for (int i = 0; i < 300; i++) {
+    a_batch[i] += 300;
+    b_batch[i] += 300;
+  }
+  for (SequentialQuantileABTest* t : {&test, &restored}) {
+    t->add(1, a_batch.begin(), a_batch.end());
+    t->add(2, b_batch.begin(), b_batch.end());
+  }
+  EXPECT_EQ(restored.order_stats(2).size(), 600);
+  EXPECT_EQ(restored.p_value(), test.p_value());
+  EXPECT_EQ(restored.running_p_value(), test.running_p_value());
+}
+
 TEST(BernoulliConfidenceIntervalTest, TestCI) {
   std::pair<double, double> ci =
       bernoulli_confidence_interval(700, 1000, 0.05, 100);
@@ -171,4 +2714,2923 @@ TEST(BernoulliConfidenceIntervalTest, AllSuccesses) {
   EXPECT_NEAR(ci.second, 1.0, 1e-5);
 }
 
+TEST(BernoulliConfidenceIntervalTest, NewtonMatchesBisection) {
+  SolverPrecision conservative;
+  conservative.conservative = true;
+  for (const int n : {2, 10, 100, 1000, 100000}) {
+    for (const double k : {0.0, 1.0, n / 3.0, n - 1.0, double(n)}) {
+      // The beta-binomial mixture the closed-form objective reduces to.
+      auto objective = [&](const double p) {
+        const BetaBinomialMixture mixture(p * (1 - p) * 100, 0.05, p, 1 - p,
+                                          false);
+        return mixture.log_superMG((k / n - p) * n, p * (1 - p) * n)
+            - log(20);
+      };
+      auto bisected_root = [&](const double a, const double b,
+                               const double sign) {
+        const std::pair<double, double> bracket = boost::math::tools::bisect(
+            [&](const double p) {
+              return p <= 0 || p >= 1 ? sign * (p <= 0 ? 1 : -1)
+                  : objective(p);
+            },
+            a, b, boost::math::tools::eps_tolerance<double>(52));
+        return (bracket.first + bracket.second) / 2;
+      };
+      const double empirical_p = k / n;
+      const double expected_lower =
+          k > 0 ? bisected_root(0, empirical_p, 1) : 0;
+      const double expected_upper =
+          k < n ? bisected_root(empirical_p, 1, -1) : 1;
+
+      SolveBudgetScope scope((SolveBudget()));
+      std::pair<double, double> ci =
+          bernoulli_confidence_interval(k, n, 0.05, 100);
+      EXPECT_NEAR(ci.first, expected_lower, 1e-11) << k << " " << n;
+      EXPECT_NEAR(ci.second, expected_upper, 1e-11) << k << " " << n;
+      // Bisection to 40 bits took about 40 evaluations per endpoint.
+      EXPECT_LE(scope.evaluations(), 20u) << k << " " << n;
+
+      ci = bernoulli_confidence_interval(k, n, 0.05, 100, 0.05, conservative);
+      EXPECT_LE(ci.first, expected_lower + 1e-14) << k << " " << n;
+      EXPECT_GE(ci.second, expected_upper - 1e-14) << k << " " << n;
+    }
+  }
+}
+
+TEST(BernoulliConfidenceIntervalTest, BatchReportsStatus) {
+  const std::vector<double> successes = {3, 5, 2, 0};
+  const std::vector<int> trials = {10, 4, 0, 20};
+  std::vector<double> lower(successes.size()), upper(successes.size());
+  std::vector<EvaluationStatus> status(successes.size());
+  bernoulli_confidence_intervals(successes.data(), trials.data(),
+                                 successes.size(), ALPHA, 100, ALPHA_OPT,
+                                 lower.data(), upper.data(), status.data());
+  for (const size_t i : {0, 3}) {
+    EXPECT_EQ(status[i], EvaluationStatus::OK);
+    const std::pair<double, double> ci = bernoulli_confidence_interval(
+        successes[i], trials[i], ALPHA, 100, ALPHA_OPT);
+    EXPECT_DOUBLE_EQ(lower[i], ci.first);
+    EXPECT_DOUBLE_EQ(upper[i], ci.second);
+  }
+  for (const size_t i : {1, 2}) {
+    EXPECT_EQ(status[i], EvaluationStatus::INVALID_ARGUMENT);
+    EXPECT_TRUE(std::isnan(lower[i]) && std::isnan(upper[i]));
+  }
+
+  // Invalid shared parameters fail every element.
+  bernoulli_confidence_intervals(successes.data(), trials.data(),
+                                 successes.size(), 2, 100, ALPHA_OPT,
+                                 lower.data(), upper.data(), status.data());
+  for (const EvaluationStatus element_status : status) {
+    EXPECT_EQ(element_status, EvaluationStatus::INVALID_ARGUMENT);
+  }
+}
+
+TEST(BernoulliConfidenceSequenceTest, MatchesIntervals) {
+  BernoulliConfidenceSequence sequence(0.05, 100);
+  BernoulliConfidenceSequence intersected(0.05, 100, 0.05, true);
+  double successes = 0;
+  int trials = 0;
+  std::pair<double, double> previous = {0, 1};
+  for (int i = 1; i <= 300; i++) {
+    const double step_successes = (i % 3 == 0) ? 2 : 1;
+    const int step_trials = 3;
+    successes += step_successes;
+    trials += step_trials;
+    const auto interval = sequence.update(step_successes, step_trials);
+    const auto expected = bernoulli_confidence_interval(successes, trials,
+                                                        0.05, 100);
+    EXPECT_NEAR(interval.first, expected.first, 1e-9) << "step " << i;
+    EXPECT_NEAR(interval.second, expected.second, 1e-9) << "step " << i;
+
+    const auto running = intersected.update(step_successes, step_trials);
+    EXPECT_GE(running.first, previous.first);
+    EXPECT_LE(running.second, previous.second);
+    EXPECT_GE(running.first, interval.first);
+    EXPECT_LE(running.second, interval.second);
+    previous = running;
+  }
+  EXPECT_EQ(sequence.num_trials(), 900);
+  EXPECT_EQ(sequence.num_successes(), successes);
+}
+
+TEST(BernoulliConfidenceSequenceTest, ExtremeCounts) {
+  BernoulliConfidenceSequence sequence(0.05, 100);
+  EXPECT_EQ(sequence.interval(), std::make_pair(0.0, 1.0));
+  auto interval = sequence.update(0, 50);
+  EXPECT_EQ(interval.first, 0);
+  EXPECT_NEAR(interval.second,
+              bernoulli_confidence_interval(0, 50, 0.05, 100).second, 1e-9);
+  interval = sequence.update(100, 100);
+  EXPECT_NEAR(interval.first,
+              bernoulli_confidence_interval(100, 150, 0.05, 100).first, 1e-9);
+}
+
+TEST(BernoulliConfidenceSequenceTest, CheckpointResumes) {
+  BernoulliConfidenceSequence sequence(0.05, 100, 0.05, true);
+  sequence.update(3, 10);
+  sequence.update(12, 30);
+  std::stringstream checkpoint;
+  sequence.save(checkpoint);
+  BernoulliConfidenceSequence restored =
+      BernoulliConfidenceSequence::load(checkpoint);
+  EXPECT_EQ(restored.interval(), sequence.interval());
+  EXPECT_EQ(restored.num_trials(), 40);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(restored.update(i, 8), sequence.update(i, 8)) << i;
+  }
+
+  std::stringstream wrong_kind;
+  PredmixHoeffdingAccumulator().save(wrong_kind);
+  EXPECT_THROW(BernoulliConfidenceSequence::load(wrong_kind),
+               std::runtime_error);
+  std::stringstream truncated(checkpoint.str().substr(0, 40));
+  EXPECT_THROW(BernoulliConfidenceSequence::load(truncated),
+               std::runtime_error);
+}
+
+TEST(BernoulliCSTableTest, MatchesIntervals) {
+  BernoulliCSTable table(60, 0.05, 20);
+  for (int n = 0; n <= 60; n += 7) {
+    for (int k = 0; k <= n; k++) {
+      const auto expected = n == 0 ? std::make_pair(0.0, 1.0)
+          : bernoulli_confidence_interval(k, n, 0.05, 20);
+      const auto bounds = table(k, n);
+      EXPECT_NEAR(bounds.first, expected.first, 1e-9) << k << "/" << n;
+      EXPECT_NEAR(bounds.second, expected.second, 1e-9) << k << "/" << n;
+    }
+  }
+  EXPECT_TRUE(table.contains(60, 60));
+  EXPECT_FALSE(table.contains(0, 61));
+}
+
+TEST(BernoulliCSTableTest, SaveAndMap) {
+  BernoulliCSTable table(30, 0.05, 20);
+  std::stringstream buffer;
+  table.save(buffer);
+  const std::string path = testing::TempDir() + "bernoulli_cs_table.bin";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << buffer.str();
+  }
+  const BernoulliCSTable loaded = BernoulliCSTable::load(buffer);
+  const BernoulliCSTable mapped = BernoulliCSTable::map_file(path);
+  EXPECT_EQ(mapped.n_max(), 30);
+  EXPECT_EQ(mapped.t_opt(), 20);
+  for (int k = 0; k <= 30; k++) {
+    EXPECT_EQ(loaded(k, 30), table(k, 30));
+    EXPECT_EQ(mapped(k, 30), table(k, 30));
+  }
+  std::stringstream bad("not a table");
+  EXPECT_THROW(BernoulliCSTable::load(bad), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(BernoulliCSTableTest, RejectsOversizedHeader) {
+  BernoulliCSTable table(30, 0.05, 20);
+  std::stringstream buffer;
+  table.save(buffer);
+  std::string bytes = buffer.str();
+  // Either needs far more data than follows, without allocating for it.
+  const uint64_t huge_n_max = std::numeric_limits<int>::max() / 2;
+  std::string oversized = bytes;
+  memcpy(&oversized[40], &huge_n_max, sizeof(uint64_t));
+  std::stringstream oversized_buffer(oversized);
+  EXPECT_THROW(BernoulliCSTable::load(oversized_buffer), std::runtime_error);
+  std::stringstream truncated(bytes.substr(0, bytes.size() - 8));
+  EXPECT_THROW(BernoulliCSTable::load(truncated), std::runtime_error);
+}
+
+// Multi-pass transcription of betting.betting_mart without the kernel.
+std::vector<double> reference_betting_mart(
+    const std::vector<double>& x, const double m,
+    const std::vector<double>& lambdas, const BettingOptions& options) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const size_t n = x.size();
+  std::vector<double> mu(n, m), positive(n), negative(n), out(n);
+  double sum = 0;
+  for (size_t t = 0; t < n && options.N > 0; t++) {
+    mu[t] = (options.N * m - sum) / (options.N - t);
+    sum += x[t];
+  }
+  double positive_capital = 1, negative_capital = 1;
+  for (size_t t = 0; t < n; t++) {
+    const double c = options.trunc_scale;
+    const double lp = std::max(std::min(lambdas[t], c / mu[t]),
+                               -c / (1 - mu[t]));
+    const double ln = std::max(std::min(lambdas[t], c / (1 - mu[t])),
+                               -c / mu[t]);
+    positive_capital *= 1 + lp * (x[t] - mu[t]);
+    negative_capital *= 1 - ln * (x[t] - mu[t]);
+    positive[t] = std::isnan(positive_capital) ? 0 : positive_capital;
+    negative[t] = std::isnan(negative_capital) ? 0 : negative_capital;
+  }
+  for (size_t t = 0; t < n; t++) {
+    const double a = options.theta * positive[t];
+    const double b = (1 - options.theta) * negative[t];
+    out[t] = options.convex_comb ? a + b : std::max(a, b);
+    if (mu[t] < 0 || mu[t] > 1) {
+      out[t] = inf;
+    }
+  }
+  return out;
+}
+
+TEST(BettingCapitalProcessTest, MatchesReference) {
+  std::vector<double> x(500), lambdas(500);
+  unsigned state = 7;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+    lambdas[i] = 0.1 + 0.5 * double((state >> 8) % 100) / 100;
+  }
+  for (const double N : {0.0, 600.0}) {
+    for (const bool convex_comb : {false, true}) {
+      BettingOptions options;
+      options.N = N;
+      options.convex_comb = convex_comb;
+      options.theta = 0.3;
+      std::vector<double> capital(x.size()), log_capital(x.size());
+      betting_capital_process(x.data(), x.size(), 0.45, lambdas.data(),
+                              lambdas.data(), options, capital.data());
+      options.log_space = true;
+      betting_capital_process(x.data(), x.size(), 0.45, lambdas.data(),
+                              lambdas.data(), options, log_capital.data());
+      const std::vector<double> expected = reference_betting_mart(
+          x, 0.45, lambdas, options);
+      for (size_t t = 0; t < x.size(); t++) {
+        EXPECT_EQ(capital[t], expected[t]) << t;
+        EXPECT_NEAR(log_capital[t], log(expected[t]),
+                    1e-9 * std::max(1.0, std::abs(log(expected[t])))) << t;
+      }
+    }
+  }
+}
+
+TEST(BettingCapitalProcessTest, LogSpaceAvoidsOverflow) {
+  const std::vector<double> x(5000, 1.0), lambdas(5000, 1.0);
+  BettingOptions options;
+  options.theta = 1;
+  std::vector<double> capital(x.size()), log_capital(x.size());
+  betting_capital_process(x.data(), x.size(), 0.01, lambdas.data(),
+                          lambdas.data(), options, capital.data());
+  options.log_space = true;
+  betting_capital_process(x.data(), x.size(), 0.01, lambdas.data(),
+                          lambdas.data(), options, log_capital.data());
+  EXPECT_TRUE(std::isinf(capital.back()));
+  EXPECT_NEAR(log_capital.back(), 5000 * log(1.99), 1e-6);
+
+  // Tiny bets accumulate through log1p without cancellation.
+  const std::vector<double> tiny_bets(5000, 1e-12);
+  betting_capital_process(x.data(), x.size(), 0.5, tiny_bets.data(),
+                          tiny_bets.data(), options, log_capital.data());
+  EXPECT_NEAR(log_capital.back(), 5000 * 0.5e-12, 1e-20);
+
+  const std::vector<double> zeros(3, 0.0), infinite_bets(3, INFINITY);
+  options.m_trunc = false;
+  options.trunc_scale = 1;
+  options.log_space = false;
+  betting_capital_process(zeros.data(), 3, 0.5, infinite_bets.data(),
+                          infinite_bets.data(), options, capital.data());
+  EXPECT_EQ(capital[2], 0.5 * 0.5 * 0.5);
+
+  // Observations outside [0, 1] can drive capital negative.
+  const std::vector<double> outside(1, 5.0), bets(1, 1.0);
+  options.theta = 0;
+  EXPECT_THROW(betting_capital_process(outside.data(), 1, 0.5, bets.data(),
+                                       bets.data(), options, capital.data()),
+               std::invalid_argument);
+  options.log_space = true;
+  EXPECT_THROW(betting_capital_process(outside.data(), 1, 0.5, bets.data(),
+                                       bets.data(), options, capital.data()),
+               std::invalid_argument);
+}
+
+TEST(BettingCapitalProcessTest, ImportanceWeightsKeepCapitalNonnegative) {
+  // A weighted outcome at the weight bound, bet against by the negative
+  // process as hard as truncation allows.
+  const std::vector<double> x(1, 4.0), bets(1, 100.0);
+  std::vector<double> capital(1);
+  for (const bool m_trunc : {true, false}) {
+    BettingOptions options;
+    options.theta = 0;
+    options.trunc_scale = 1;
+    options.m_trunc = m_trunc;
+    EXPECT_THROW(betting_capital_process(x.data(), 1, 0.5, bets.data(),
+                                         bets.data(), options, capital.data()),
+                 std::invalid_argument);
+    options.max_weight = 4;
+    betting_capital_process(x.data(), 1, 0.5, bets.data(), bets.data(),
+                            options, capital.data());
+    // The bet is capped at 1 / (4 - 0.5) with m_trunc, and at 1 / 4
+    // otherwise.
+    EXPECT_NEAR(capital[0], m_trunc ? 0 : 1 - 3.5 / 4, 1e-12) << m_trunc;
+  }
+
+  // Weights of 0 or 4 with mean 1, on outcomes of mean 0.3.
+  const size_t n = 4000;
+  const double max_weight = 4;
+  std::vector<double> weighted(n);
+  unsigned state = 41;
+  for (size_t i = 0; i < n; i++) {
+    state = state * 1103515245 + 12345;
+    const double y = double((state >> 16) % 1000) / 999 * 0.6;
+    weighted[i] = (state >> 8) % 4 == 0 ? max_weight * y : 0;
+  }
+  const std::vector<BettingStrategy> strategies = {
+      BettingStrategy(weighted.data(), n, BettingStrategyParams())};
+  BettingOptions options;
+  options.log_space = true;
+  options.max_weight = max_weight;
+  std::vector<double> lower(n), upper(n);
+  diversified_betting_grid_cs(weighted.data(), n, 200, strategies, strategies,
+                              {1.0}, options, 20, true, lower.data(),
+                              upper.data());
+  EXPECT_LT(lower.back(), 0.3);
+  EXPECT_GT(upper.back(), 0.3);
+  EXPECT_LT(upper.back() - lower.back(), 0.3);
+
+  // The streaming form takes the same weighted outcomes.
+  HedgedConfidenceSequence cs(0.05, 0, 200, true, 0.5, 0.5, 0.5, 0.25, 1,
+                              max_weight);
+  const std::pair<double, double> interval = cs.update(weighted.data(), n);
+  EXPECT_LT(interval.first, 0.3);
+  EXPECT_GT(interval.second, 0.3);
+  const double outside = 4.5;
+  EXPECT_THROW(cs.update(&outside, 1), std::invalid_argument);
+}
+
+TEST(BettingCapitalProcessTest, GridMatchesPerMeanCapital) {
+  std::vector<double> x(300), lambdas(300);
+  unsigned state = 11;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5 + 0.2;
+    lambdas[i] = 0.8;
+  }
+  std::vector<double> grid;
+  for (int i = 0; i <= 50; i++) {
+    grid.push_back(i / 50.0);
+  }
+  BettingOptions options;
+  options.cap_negative_bets_at_m = true;
+  std::vector<int> expected_first(x.size(), -1), expected_last(x.size(), -1);
+  std::vector<double> capital(x.size());
+  for (size_t i = 0; i < grid.size(); i++) {
+    betting_capital_process(x.data(), x.size(), grid[i], lambdas.data(),
+                            lambdas.data(), options, capital.data());
+    for (size_t t = 0; t < x.size(); t++) {
+      if (capital[t] <= 20) {
+        if (expected_first[t] < 0) {
+          expected_first[t] = i;
+        }
+        expected_last[t] = i;
+      }
+    }
+  }
+  EXPECT_GT(expected_first.back(), 0);
+  EXPECT_LT(expected_last.back(), 50);
+  for (const int num_threads : {1, 3, 8}) {
+    std::vector<int> first(x.size()), last(x.size());
+    betting_grid_accepted_range(x.data(), x.size(), grid.data(), grid.size(),
+                                lambdas.data(), lambdas.data(), options, 20,
+                                first.data(), last.data(), num_threads);
+    EXPECT_EQ(first, expected_first) << num_threads;
+    EXPECT_EQ(last, expected_last) << num_threads;
+  }
+}
+
+TEST(BettingCapitalProcessTest, FirstRejectionsMatchCapitalProcess) {
+  std::vector<double> x(1000), lambdas(1000);
+  unsigned state = 11;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5 + 0.2;
+    lambdas[i] = 0.8;
+  }
+  std::vector<double> nulls;
+  for (int i = 0; i <= 50; i++) {
+    nulls.push_back(i / 50.0);
+  }
+  BettingOptions options;
+  options.cap_negative_bets_at_m = true;
+  std::vector<size_t> expected(nulls.size(), 0);
+  std::vector<double> capital(x.size());
+  for (size_t j = 0; j < nulls.size(); j++) {
+    betting_capital_process(x.data(), x.size(), nulls[j], lambdas.data(),
+                            lambdas.data(), options, capital.data());
+    for (size_t t = 0; t < x.size(); t++) {
+      if (capital[t] > 20) {
+        expected[j] = t + 1;
+        break;
+      }
+    }
+  }
+  // Means near the sample mean are never rejected; nearby ones are only
+  // rejected after the first block.
+  EXPECT_EQ(expected[23], 0);
+  EXPECT_GT(expected[0], 0);
+  EXPECT_GT(*std::max_element(expected.begin(), expected.end()), 256);
+  for (const int num_threads : {1, 3}) {
+    std::vector<size_t> times(nulls.size());
+    betting_first_rejections(x.data(), x.size(), nulls.data(), nulls.size(),
+                             lambdas.data(), lambdas.data(), options, 20,
+                             times.data(), num_threads);
+    EXPECT_EQ(times, expected) << num_threads;
+  }
+  options.log_space = true;
+  std::vector<size_t> times(nulls.size());
+  betting_first_rejections(x.data(), x.size(), nulls.data(), nulls.size(),
+                           lambdas.data(), lambdas.data(), options, 20,
+                           times.data());
+  EXPECT_EQ(times, expected);
+}
+
+TEST(BettingCapitalProcessTest, BisectionBracketsGridEndpoints) {
+  std::vector<double> x(2000), lambdas_positive(2000), lambdas_negative(2000);
+  unsigned state = 13;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.6 + 0.1;
+    lambdas_positive[i] = std::min(0.3 / sqrt(1.0 + i) * 10, 2.0);
+    lambdas_negative[i] = lambdas_positive[i];
+  }
+  BettingOptions options;
+  options.cap_negative_bets_at_m = true;
+  const double tolerance = 1e-4;
+  std::vector<double> lower(x.size()), upper(x.size());
+  betting_cs_bisection(x.data(), x.size(), lambdas_positive.data(),
+                       lambdas_negative.data(), options, 20, tolerance,
+                       lower.data(), upper.data());
+
+  std::vector<double> grid;
+  for (int i = 0; i <= 2000; i++) {
+    grid.push_back(i / 2000.0);
+  }
+  std::vector<int> first(x.size()), last(x.size());
+  betting_grid_accepted_range(x.data(), x.size(), grid.data(), grid.size(),
+                              lambdas_positive.data(), lambdas_negative.data(),
+                              options, 20, first.data(), last.data(), 1);
+  for (size_t t = 0; t < x.size(); t++) {
+    ASSERT_GE(first[t], 0);
+    // The bisection endpoints lie within one grid step and the tolerance of
+    // the grid's accepted range.
+    EXPECT_LE(lower[t], grid[first[t]]) << t;
+    EXPECT_GE(lower[t], grid[first[t]] - 1 / 2000.0 - tolerance) << t;
+    EXPECT_GE(upper[t], grid[last[t]]) << t;
+    EXPECT_LE(upper[t], grid[last[t]] + 1 / 2000.0 + tolerance) << t;
+  }
+  EXPECT_LT(upper.back() - lower.back(), 0.2);
+}
+
+TEST(BettingCapitalProcessTest, GridCSMatchesAcceptedRangeWoR) {
+  std::vector<double> x(400), lambdas(400);
+  unsigned state = 19;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 2);
+    lambdas[i] = 0.5;
+  }
+  const int breaks = 100;
+  const std::vector<double> grid = betting_grid(breaks);
+  BettingOptions options;
+  options.N = 450;
+  options.log_space = true;
+  std::vector<int> first(x.size()), last(x.size());
+  betting_grid_accepted_range(x.data(), x.size(), grid.data(), grid.size(),
+                              lambdas.data(), lambdas.data(), options, 20,
+                              first.data(), last.data(), 1);
+  for (const bool running_intersection : {false, true}) {
+    std::vector<double> lower(x.size()), upper(x.size());
+    betting_grid_cs(x.data(), x.size(), breaks, lambdas.data(),
+                    lambdas.data(), options, 20, running_intersection,
+                    lower.data(), upper.data(), 2);
+    // cs_from_accepted_range: widen, then intersect_cs.
+    std::vector<double> expected_lower(x.size()), expected_upper(x.size());
+    for (size_t t = 0; t < x.size(); t++) {
+      expected_lower[t] = std::max(
+          0.0, (first[t] >= 0 ? grid[first[t]] : 0) - 1.0 / breaks);
+      expected_upper[t] = std::min(
+          1.0, (last[t] >= 0 ? grid[last[t]] : 1) + 1.0 / breaks);
+    }
+    intersect_cs(x.data(), x.size(), options.N, running_intersection,
+                 expected_lower.data(), expected_upper.data());
+    double sum = 0;
+    for (size_t t = 0; t < x.size(); t++) {
+      sum += x[t];
+      EXPECT_GE(lower[t], sum / options.N) << t;
+      EXPECT_LE(upper[t], 1 - (t + 1 - sum) / options.N) << t;
+      if (running_intersection && t > 0) {
+        EXPECT_GE(lower[t], lower[t - 1]) << t;
+        EXPECT_LE(upper[t], upper[t - 1]) << t;
+      }
+    }
+    EXPECT_EQ(lower, expected_lower);
+    EXPECT_EQ(upper, expected_upper);
+    EXPECT_LT(upper.back() - lower.back(), 0.1);
+  }
+}
+
+TEST(BettingCapitalProcessTest, TiledGridMatchesRowWise) {
+  // Neither the length nor the grid fills whole blocks and tiles.
+  std::vector<double> x(1001), lambdas_positive(1001), lambdas_negative(1001);
+  unsigned state = 21;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+    lambdas_positive[i] = 0.3 + 0.4 * x[i];
+    lambdas_negative[i] = 0.5;
+  }
+  const std::vector<double> grid = betting_grid(61);
+  for (const bool log_space : {false, true}) {
+    BettingOptions options;
+    options.N = log_space ? 1200 : 0;
+    options.log_space = log_space;
+    const double threshold = 20;
+    std::vector<int> expected_first(x.size()), expected_last(x.size());
+    grid_accepted_range(
+        grid.size(), x.size(), log_space ? log(threshold) : threshold,
+        [&](const size_t i, double* capital) {
+          betting_capital_process(x.data(), x.size(), grid[i],
+                                  lambdas_positive.data(),
+                                  lambdas_negative.data(), options, capital);
+        },
+        expected_first.data(), expected_last.data(), 1);
+    for (const int num_threads : {1, 3, 7}) {
+      std::vector<int> first(x.size()), last(x.size());
+      betting_grid_accepted_range(x.data(), x.size(), grid.data(),
+                                  grid.size(), lambdas_positive.data(),
+                                  lambdas_negative.data(), options, threshold,
+                                  first.data(), last.data(), num_threads);
+      EXPECT_EQ(first, expected_first) << log_space << num_threads;
+      EXPECT_EQ(last, expected_last) << log_space << num_threads;
+    }
+  }
+}
+
+TEST(BettingCapitalProcessTest, PrunedGridCSMatchesCumulativeRejection) {
+  std::vector<double> x(1000), lambdas(1000, 0.5);
+  unsigned state = 20;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5 + 0.2;
+  }
+  const int breaks = 100;
+  const std::vector<double> grid = betting_grid(breaks);
+  for (const double N : {0.0, 1500.0}) {
+    BettingOptions options;
+    options.N = N;
+    options.log_space = true;
+    // A mean stays accepted until its capital first exceeds the threshold.
+    std::vector<int> rejected(grid.size(), int(x.size()));
+    std::vector<double> capital(x.size());
+    for (size_t j = 0; j < grid.size(); j++) {
+      betting_capital_process(x.data(), x.size(), grid[j], lambdas.data(),
+                              lambdas.data(), options, capital.data());
+      for (size_t t = 0; t < x.size(); t++) {
+        if (capital[t] > log(20)) {
+          rejected[j] = t;
+          break;
+        }
+      }
+    }
+    std::vector<double> expected_lower(x.size()), expected_upper(x.size());
+    double sum = 0;
+    for (size_t t = 0; t < x.size(); t++) {
+      sum += x[t];
+      int first = -1, last = -1;
+      for (size_t j = 0; j < grid.size(); j++) {
+        if (rejected[j] > int(t)) {
+          first = first < 0 ? j : first;
+          last = j;
+        }
+      }
+      const std::pair<double, double> interval =
+          grid_cs_interval(grid.data(), breaks, first, last, N, t, sum);
+      expected_lower[t] = t == 0 ? interval.first
+          : std::max(expected_lower[t - 1], interval.first);
+      expected_upper[t] = t == 0 ? interval.second
+          : std::min(expected_upper[t - 1], interval.second);
+    }
+    std::vector<double> range_lower(x.size()), range_upper(x.size());
+    betting_grid_cs(x.data(), x.size(), breaks, lambdas.data(),
+                    lambdas.data(), options, 20, true, range_lower.data(),
+                    range_upper.data(), 1);
+    for (const int num_threads : {1, 3}) {
+      std::vector<double> lower(x.size()), upper(x.size());
+      betting_pruned_grid_cs(x.data(), x.size(), breaks, lambdas.data(),
+                             lambdas.data(), options, 20, lower.data(),
+                             upper.data(), num_threads);
+      EXPECT_EQ(lower, expected_lower) << N;
+      EXPECT_EQ(upper, expected_upper) << N;
+      for (size_t t = 0; t < x.size(); t++) {
+        EXPECT_GE(lower[t], range_lower[t]) << t;
+        EXPECT_LE(upper[t], range_upper[t]) << t;
+      }
+      EXPECT_LT(upper.back() - lower.back(), 0.1) << N;
+    }
+
+    BettingStrategyParams params;
+    params.kind = BettingStrategyKind::AKELLY;
+    const std::vector<BettingStrategy> strategies(
+        1, BettingStrategy(x.data(), x.size(), params, N));
+    std::vector<double> lower(x.size()), upper(x.size());
+    diversified_betting_pruned_grid_cs(x.data(), x.size(), breaks, strategies,
+                                       strategies, {1.0}, options, 20,
+                                       lower.data(), upper.data(), 2);
+    diversified_betting_grid_cs(x.data(), x.size(), breaks, strategies,
+                                strategies, {1.0}, options, 20, true,
+                                range_lower.data(), range_upper.data(), 2);
+    for (size_t t = 0; t < x.size(); t++) {
+      EXPECT_GE(lower[t], range_lower[t]) << t;
+      EXPECT_LE(upper[t], range_upper[t]) << t;
+    }
+  }
+}
+
+TEST(BettingCapitalProcessTest, FirstRejectionTimesRecoverPrunedGridCS) {
+  std::vector<double> x(1000);
+  unsigned state = 21;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5 + 0.2;
+  }
+  const int breaks = 100;
+  const std::vector<double> grid = betting_grid(breaks);
+  BettingOptions options;
+  options.log_space = true;
+  BettingStrategyParams params;
+  params.kind = BettingStrategyKind::AKELLY;
+  const std::vector<BettingStrategy> strategies(
+      1, BettingStrategy(x.data(), x.size(), params));
+  std::vector<double> lower(x.size()), upper(x.size());
+  diversified_betting_pruned_grid_cs(x.data(), x.size(), breaks, strategies,
+                                     strategies, {1.0}, options, 20,
+                                     lower.data(), upper.data(), 1);
+  for (const int num_threads : {1, 3}) {
+    std::vector<size_t> times(grid.size());
+    diversified_betting_first_rejections(
+        x.data(), x.size(), grid.data(), grid.size(), strategies, strategies,
+        {1.0}, options, 20, times.data(), num_threads);
+    EXPECT_GT(*std::max_element(times.begin(), times.end()), 256);
+    for (size_t t = 0; t < x.size(); t++) {
+      const std::pair<double, double> interval = first_rejection_interval(
+          grid.data(), grid.size(), breaks, times.data(), t + 1);
+      EXPECT_EQ(interval.first, lower[t]) << t;
+      EXPECT_EQ(interval.second, upper[t]) << t;
+    }
+  }
+
+  // Once every mean is out, the interval is that of the last time any was
+  // in.
+  const std::vector<size_t> times = {2, 6, 7, 5, 3};
+  const std::vector<double> coarse = betting_grid(4);
+  auto interval = [&](const size_t t) {
+    return first_rejection_interval(coarse.data(), coarse.size(), 4,
+                                    times.data(), t);
+  };
+  EXPECT_EQ(interval(0), std::make_pair(0.0, 1.0));
+  EXPECT_EQ(interval(5), std::make_pair(0.0, 0.75));
+  EXPECT_EQ(interval(6), std::make_pair(0.25, 0.75));
+  EXPECT_EQ(interval(7), interval(6));
+  EXPECT_EQ(interval(100), interval(6));
+}
+
+TEST(BettingStrategyTest, MatchesStrategyFunctions) {
+  std::vector<double> x(400);
+  unsigned state = 17;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  const double m = 0.4, N = 1000;
+  BettingStrategyParams params;
+  const BettingStrategy predmix(x.data(), x.size(), params);
+  params.kind = BettingStrategyKind::AKELLY;
+  const BettingStrategy akelly(x.data(), x.size(), params, N);
+  params.kind = BettingStrategyKind::LBOW;
+  const BettingStrategy lbow(x.data(), x.size(), params);
+  params.kind = betting_strategy_kind("fixed_fraction");
+  params.fraction = 0.25;
+  const BettingStrategy fixed(x.data(), x.size(), params, N);
+  EXPECT_THROW(betting_strategy_kind("Kelly"), std::invalid_argument);
+
+  // Transcriptions of betting_strategies.py, recomputing each prefix.
+  for (size_t i = 0; i < x.size(); i++) {
+    const double t = i + 1;
+    double sum = 0, squares = 0, centered_at_m = 0;
+    for (size_t j = 0; j < i; j++) {
+      sum += x[j];
+      const double mean_j = (0.5 + sum) / (j + 2);
+      squares += (x[j] - mean_j) * (x[j] - mean_j);
+      centered_at_m += (x[j] - m) * (x[j] - m);
+    }
+    const double mean = (0.5 + sum) / t;
+    const double variance = (0.25 + squares) / t;
+    EXPECT_NEAR(predmix.bet(i, m, false),
+                sqrt(2 * log(20.0) / (t * log(1 + t) * variance)), 1e-12);
+
+    const double conditional_mean = (N * mean - sum) / (N - i);
+    const double mu = (N * m - sum) / (N - i);
+    const double kelly = std::max(
+        -1 / (1 - mu), std::min(1 / mu, (conditional_mean - mu)
+                                / (variance + pow(conditional_mean - mu, 2))));
+    EXPECT_NEAR(akelly.bet(i, m, false), kelly, 1e-12);
+
+    const double lbow_variance = (i == 0 ? 0.25 : centered_at_m) / (t + 1);
+    const double g = mean - m;
+    EXPECT_NEAR(lbow.bet(i, m, true),
+                g / ((g > 0 ? m : 1 - m) * std::abs(g) + lbow_variance + g * g),
+                1e-12);
+
+    EXPECT_NEAR(fixed.bet(i, m, false), 0.25 / mu, 1e-12);
+    EXPECT_NEAR(fixed.bet(i, m, true), 0.25 / (1 - mu), 1e-12);
+  }
+}
+
+TEST(BettingStrategyTest, DiversifiedGridMatchesPerMeanCapital) {
+  std::vector<double> x(300);
+  unsigned state = 19;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5 + 0.2;
+  }
+  BettingStrategyParams params;
+  params.kind = BettingStrategyKind::FIXED_FRACTION;
+  std::vector<BettingStrategy> strategies;
+  std::vector<double> weights;
+  for (const double fraction : {0.2, 0.4, 0.6}) {
+    params.fraction = fraction;
+    strategies.emplace_back(x.data(), x.size(), params);
+    weights.push_back(1 / 3.0);
+  }
+  BettingOptions options;
+  options.convex_comb = true;
+  options.trunc_scale = 1;
+
+  // A single strategy with unit weight is an ordinary capital process.
+  const std::vector<BettingStrategy> single(1, strategies[1]);
+  std::vector<double> bets_positive(x.size()), bets_negative(x.size());
+  for (size_t i = 0; i < x.size(); i++) {
+    bets_positive[i] = single[0].bet(i, 0.45, false);
+    bets_negative[i] = single[0].bet(i, 0.45, true);
+  }
+  std::vector<double> capital(x.size()), expected(x.size());
+  diversified_betting_capital_process(x.data(), x.size(), 0.45, single,
+                                      single, {1.0}, options, capital.data());
+  betting_capital_process(x.data(), x.size(), 0.45, bets_positive.data(),
+                          bets_negative.data(), options, expected.data());
+  for (size_t t = 0; t < x.size(); t++) {
+    EXPECT_NEAR(capital[t], expected[t], 1e-9 * expected[t]) << t;
+  }
+
+  std::vector<double> grid;
+  for (int i = 0; i <= 50; i++) {
+    grid.push_back(i / 50.0);
+  }
+  options.log_space = true;
+  std::vector<int> expected_first(x.size(), -1), expected_last(x.size(), -1);
+  for (size_t i = 0; i < grid.size(); i++) {
+    diversified_betting_capital_process(x.data(), x.size(), grid[i],
+                                        strategies, strategies, weights,
+                                        options, capital.data());
+    for (size_t t = 0; t < x.size(); t++) {
+      if (capital[t] <= log(20.0)) {
+        if (expected_first[t] < 0) {
+          expected_first[t] = i;
+        }
+        expected_last[t] = i;
+      }
+    }
+  }
+  EXPECT_GT(expected_first.back(), 0);
+  EXPECT_LT(expected_last.back(), 50);
+  for (const int num_threads : {1, 4}) {
+    std::vector<int> first(x.size()), last(x.size());
+    diversified_betting_grid_accepted_range(
+        x.data(), x.size(), grid.data(), grid.size(), strategies, strategies,
+        weights, options, 20, first.data(), last.data(), num_threads);
+    EXPECT_EQ(first, expected_first) << num_threads;
+    EXPECT_EQ(last, expected_last) << num_threads;
+  }
+}
+
+TEST(BettingStrategyTest, FusedMixtureMatchesCapitalProcesses) {
+  std::vector<double> x(400);
+  unsigned state = 23;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  const double m = 0.35, N = 700;
+  BettingStrategyParams params;
+  std::vector<BettingStrategy> strategies;
+  strategies.emplace_back(x.data(), x.size(), params, N);
+  params.kind = BettingStrategyKind::AKELLY;
+  strategies.emplace_back(x.data(), x.size(), params, N);
+  params.kind = BettingStrategyKind::FIXED_FRACTION;
+  strategies.emplace_back(x.data(), x.size(), params, N);
+  strategies.emplace_back(x.data(), x.size(), params, N);
+  const std::vector<double> weights = {0.5, 0.2, 0.3, 0};
+
+  for (const bool log_space : {false, true}) {
+    for (const bool convex_comb : {false, true}) {
+      BettingOptions options;
+      options.N = N;
+      options.convex_comb = convex_comb;
+      options.theta = 0.4;
+      options.log_space = log_space;
+      std::vector<double> capital(x.size());
+      diversified_betting_capital_process(x.data(), x.size(), m, strategies,
+                                          strategies, weights, options,
+                                          capital.data());
+
+      // Mixtures of separate positive and negative capital processes, as
+      // diversified_betting_mart takes them from betting_mart.
+      BettingOptions single = options;
+      single.log_space = false;
+      std::vector<double> mixed_positive(x.size(), 0);
+      std::vector<double> mixed_negative(x.size(), 0);
+      std::vector<double> bets_positive(x.size()), bets_negative(x.size());
+      std::vector<double> process(x.size());
+      for (size_t k = 0; k < strategies.size(); k++) {
+        for (size_t i = 0; i < x.size(); i++) {
+          bets_positive[i] = strategies[k].bet(i, m, false);
+          bets_negative[i] = strategies[k].bet(i, m, true);
+        }
+        for (const double theta : {1.0, 0.0}) {
+          single.theta = theta;
+          betting_capital_process(x.data(), x.size(), m, bets_positive.data(),
+                                  bets_negative.data(), single,
+                                  process.data());
+          std::vector<double>& mixed =
+              theta == 1 ? mixed_positive : mixed_negative;
+          for (size_t t = 0; t < x.size(); t++) {
+            mixed[t] += weights[k] * process[t];
+          }
+        }
+      }
+      for (size_t t = 0; t < x.size(); t++) {
+        const double a = 0.4 * mixed_positive[t];
+        const double b = 0.6 * mixed_negative[t];
+        const double expected = convex_comb ? a + b : std::max(a, b);
+        if (log_space) {
+          EXPECT_NEAR(capital[t], log(expected),
+                      1e-9 * std::max(1.0, std::abs(log(expected)))) << t;
+        } else {
+          EXPECT_NEAR(capital[t], expected, 1e-9 * expected) << t;
+        }
+      }
+    }
+  }
+}
+
+TEST(BettingStrategyTest, CISequenceMatchesPerHorizonIntervals) {
+  std::vector<double> x(300);
+  unsigned state = 31;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.6 + 0.2;
+  }
+  const std::vector<size_t> times = {1, 40, 41, 150, 300};
+  const int breaks = 100;
+  BettingOptions options;
+  options.log_space = true;
+  options.m_trunc = false;
+  options.trunc_scale = 1;
+  for (const bool fixed_horizon : {false, true}) {
+    for (const bool running_intersection : {false, true}) {
+      BettingStrategyParams params;
+      params.fixed_horizon = fixed_horizon;
+      const std::vector<BettingStrategy> strategies(
+          1, BettingStrategy(x.data(), x.size(), params));
+      EXPECT_EQ(strategies[0].horizon_dependent(), fixed_horizon);
+      std::vector<double> lower(times.size()), upper(times.size());
+      diversified_betting_ci_sequence(
+          x.data(), times.data(), times.size(), breaks, strategies,
+          strategies, {1.0}, options, 20, running_intersection, lower.data(),
+          upper.data(), 3);
+      for (size_t h = 0; h < times.size(); h++) {
+        BettingStrategyParams prefix_params = params;
+        prefix_params.fixed_n = fixed_horizon ? times[h] : 0;
+        const std::vector<BettingStrategy> prefix(
+            1, BettingStrategy(x.data(), times[h], prefix_params));
+        const std::pair<double, double> expected = diversified_betting_ci(
+            x.data(), times[h], breaks, prefix, prefix, {1.0}, options, 20,
+            running_intersection, 1);
+        EXPECT_EQ(lower[h], expected.first) << times[h];
+        EXPECT_EQ(upper[h], expected.second) << times[h];
+      }
+      EXPECT_LT(upper.back() - lower.back(), 0.3);
+    }
+  }
+}
+
+TEST(BettingStrategyTest, StreamingCIMatchesGridCS) {
+  std::vector<double> x(5000);
+  unsigned state = 37;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  const int breaks = 40;
+  BettingStrategyParams params;
+  params.kind = BettingStrategyKind::AKELLY;
+  for (const double N : {0.0, 7000.0}) {
+    const std::vector<BettingStrategy> strategies(
+        1, BettingStrategy(x.data(), x.size(), params, N));
+    BettingOptions options;
+    options.N = N;
+    options.log_space = true;
+    for (const bool running_intersection : {false, true}) {
+      std::vector<double> lower(x.size()), upper(x.size());
+      diversified_betting_grid_cs(x.data(), x.size(), breaks, strategies,
+                                  strategies, {1.0}, options, 20,
+                                  running_intersection, lower.data(),
+                                  upper.data(), 1);
+      for (const int num_threads : {1, 3}) {
+        const std::pair<double, double> interval = diversified_betting_ci(
+            x.data(), x.size(), breaks, strategies, strategies, {1.0},
+            options, 20, running_intersection, num_threads);
+        EXPECT_EQ(interval.first, lower.back()) << N << running_intersection;
+        EXPECT_EQ(interval.second, upper.back()) << N << running_intersection;
+      }
+    }
+  }
+}
+
+TEST(BettingStrategyTest, MultiThresholdGridCSMatchesSingle) {
+  std::vector<double> x(2000);
+  unsigned state = 38;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  const int breaks = 50;
+  BettingStrategyParams params;
+  params.kind = BettingStrategyKind::AKELLY;
+  const std::vector<BettingStrategy> strategies(
+      1, BettingStrategy(x.data(), x.size(), params));
+  const std::vector<double> thresholds = {10, 20, 100, 1000};
+  const size_t n = x.size();
+  for (const bool log_space : {false, true}) {
+    BettingOptions options;
+    options.log_space = log_space;
+    for (const bool running_intersection : {false, true}) {
+      std::vector<double> lower(thresholds.size() * n);
+      std::vector<double> upper(thresholds.size() * n);
+      diversified_betting_grid_cs(x.data(), n, breaks, strategies, strategies,
+                                  {1.0}, options, thresholds.data(),
+                                  thresholds.size(), running_intersection,
+                                  lower.data(), upper.data(), 3);
+      for (size_t k = 0; k < thresholds.size(); k++) {
+        std::vector<double> expected_lower(n), expected_upper(n);
+        diversified_betting_grid_cs(x.data(), n, breaks, strategies,
+                                    strategies, {1.0}, options, thresholds[k],
+                                    running_intersection,
+                                    expected_lower.data(),
+                                    expected_upper.data(), 1);
+        for (size_t t = 0; t < n; t++) {
+          ASSERT_EQ(lower[k * n + t], expected_lower[t]) << k << " " << t;
+          ASSERT_EQ(upper[k * n + t], expected_upper[t]) << k << " " << t;
+        }
+        if (k > 0) {
+          EXPECT_LE(lower[k * n + n - 1], lower[(k - 1) * n + n - 1]);
+          EXPECT_GE(upper[k * n + n - 1], upper[(k - 1) * n + n - 1]);
+        }
+      }
+    }
+  }
+}
+
+TEST(KellyBetsTest, SolvesKellyCondition) {
+  std::vector<double> x(300), discrete(300);
+  unsigned state = 23;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+    discrete[i] = double((state >> 16) % 5) / 4;
+  }
+  const double m = 0.45;
+  std::vector<double> bets(x.size());
+  kelly_bets(x.data(), x.size(), m, bets.data());
+  EXPECT_EQ(bets[0], 0);
+  for (size_t i = 1; i < x.size(); i++) {
+    const double max = *std::max_element(x.begin(), x.begin() + i);
+    const double min = *std::min_element(x.begin(), x.begin() + i);
+    if (max <= m) {
+      EXPECT_DOUBLE_EQ(bets[i], -1 / (1 - m));
+    } else if (min >= m) {
+      EXPECT_DOUBLE_EQ(bets[i], 1 / m);
+    } else {
+      double condition = 0, slope = 0;
+      for (size_t j = 0; j < i; j++) {
+        condition += (x[j] - m) / (1 + bets[i] * (x[j] - m));
+        slope += pow((x[j] - m) / (1 + bets[i] * (x[j] - m)), 2);
+      }
+      EXPECT_NEAR(condition / slope, 0, 1e-10) << i;
+    }
+  }
+
+  // Counted discrete residuals give the bets of the uncompressed sums.
+  KellyBets compressed(m), uncompressed(m, 0);
+  for (size_t i = 0; i < discrete.size(); i++) {
+    EXPECT_NEAR(compressed.bet(), uncompressed.bet(), 1e-9) << i;
+    compressed.add(discrete[i]);
+    uncompressed.add(discrete[i]);
+  }
+
+  KellyBets below(m);
+  below.add(0.1);
+  below.add(m);
+  EXPECT_DOUBLE_EQ(below.bet(), -1 / (1 - m));
+}
+
+TEST(HedgedConfidenceSequenceTest, MatchesBatchGrid) {
+  std::vector<double> x(600);
+  unsigned state = 29;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5 + 0.1;
+  }
+  const int breaks = 200;
+  for (const double N : {0.0, 900.0}) {
+    // hedged_cs: the grid search over predictable-mixture bets, widened by a
+    // grid step, intersected with the logical CS and with its own past.
+    BettingStrategyParams params;
+    params.alpha = 0.1;
+    std::vector<double> lambdas_positive(x.size()), lambdas_negative(x.size());
+    const BettingStrategy positive(x.data(), x.size(), params);
+    const BettingStrategy negative(x.data(), x.size(), BettingStrategyParams());
+    for (size_t i = 0; i < x.size(); i++) {
+      lambdas_positive[i] = positive.bet(i, 0, false);
+      lambdas_negative[i] = negative.bet(i, 0, true);
+    }
+    std::vector<double> grid;
+    for (int i = 0; i <= breaks; i++) {
+      grid.push_back(i * (1.0 / breaks));
+    }
+    BettingOptions options;
+    options.N = N;
+    options.cap_negative_bets_at_m = true;
+    options.log_space = true;
+    std::vector<int> first(x.size()), last(x.size());
+    betting_grid_accepted_range(x.data(), x.size(), grid.data(), grid.size(),
+                                lambdas_positive.data(),
+                                lambdas_negative.data(), options, 10,
+                                first.data(), last.data(), 1);
+    std::vector<double> lower(x.size()), upper(x.size());
+    double sum = 0, running_lower = 0, running_upper = 1;
+    for (size_t t = 0; t < x.size(); t++) {
+      sum += x[t];
+      double l = std::max(0.0, (first[t] >= 0 ? grid[first[t]] : 0)
+                                   - 1.0 / breaks);
+      double u = std::min(1.0, (last[t] >= 0 ? grid[last[t]] : 1)
+                                   + 1.0 / breaks);
+      if (N > 0) {
+        l = std::max(l, sum / N);
+        u = std::min(u, 1 - (t + 1 - sum) / N);
+      }
+      running_lower = std::max(running_lower, l);
+      running_upper = std::min(running_upper, u);
+      lower[t] = running_lower;
+      upper[t] = running_upper;
+    }
+    EXPECT_LT(upper.back() - lower.back(), 0.2);
+
+    for (const size_t batch : {size_t(1), size_t(7), x.size()}) {
+      HedgedConfidenceSequence cs(0.1, N, breaks);
+      for (size_t start = 0; start < x.size(); start += batch) {
+        const size_t size = std::min(batch, x.size() - start);
+        const std::pair<double, double> interval = cs.update(&x[start], size);
+        const size_t t = start + size - 1;
+        EXPECT_EQ(interval.first, lower[t]) << N << " " << batch << " " << t;
+        EXPECT_EQ(interval.second, upper[t]) << N << " " << batch << " " << t;
+      }
+      EXPECT_EQ(cs.num_observations(), x.size());
+    }
+
+    // Per-time intervals from the time-major sweep, in one call and split
+    // across calls.
+    for (const size_t batch : {size_t(13), x.size()}) {
+      HedgedConfidenceSequence cs(0.1, N, breaks);
+      std::vector<double> path_lower(x.size()), path_upper(x.size());
+      for (size_t start = 0; start < x.size(); start += batch) {
+        const size_t size = std::min(batch, x.size() - start);
+        cs.update(&x[start], size, &path_lower[start], &path_upper[start]);
+      }
+      EXPECT_EQ(path_lower, lower) << N << " " << batch;
+      EXPECT_EQ(path_upper, upper) << N << " " << batch;
+    }
+  }
+
+  HedgedConfidenceSequence cs(0.05, 3);
+  const double outside = 1.5, values[] = {0.5, 0.5, 0.5, 0.5};
+  EXPECT_THROW(cs.update(&outside, 1), std::invalid_argument);
+  EXPECT_THROW(cs.update(values, 4), std::invalid_argument);
+  EXPECT_EQ(cs.num_observations(), 0u);
+  cs.update(values, 3);
+  EXPECT_EQ(cs.interval(), std::make_pair(0.5, 0.5));
+}
+
+TEST(StreamCSTest, PredmixAndConjmixMatchTranscriptions) {
+  std::vector<double> x(500);
+  unsigned state = 31;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.6 + 0.2;
+  }
+  const double alpha = 0.1;
+  std::vector<double> lower(x.size()), upper(x.size());
+  predmix_empbern_cs(x.data(), x.size(), alpha, 0.5, 0, false, lower.data(),
+                     upper.data());
+  // predmix_empbern_cs with the numpy cumsums of predmix.py.
+  BettingStrategyParams params;
+  params.alpha = alpha / 2;
+  params.truncation = 0.5;
+  const BettingStrategy bets(x.data(), x.size(), params);
+  double sum = 0, psi = 0, lambdas = 0, weighted = 0;
+  for (size_t t = 0; t < x.size(); t++) {
+    const double lambda = bets.bet(t, 0, false);
+    const double previous_mean = t == 0 ? 0 : sum / t;
+    psi += pow(x[t] - previous_mean, 2) * (-log(1 - lambda) - lambda);
+    lambdas += lambda;
+    weighted += x[t] * lambda;
+    sum += x[t];
+    const double margin = (log(2 / alpha) + psi) / lambdas;
+    EXPECT_NEAR(lower[t], std::max(0.0, weighted / lambdas - margin), 1e-12);
+    EXPECT_NEAR(upper[t], std::min(1.0, weighted / lambdas + margin), 1e-12);
+  }
+  EXPECT_LT(upper.back() - lower.back(), 0.2);
+
+  conjmix_empbern_cs(x.data(), x.size(), 10, alpha, true, lower.data(),
+                     upper.data());
+  const GammaExponentialMixture mixture(10, alpha / 2, 1);
+  sum = 0;
+  double variance = 0, running_lower = 0, running_upper = 1;
+  for (size_t t = 0; t < x.size(); t++) {
+    const double previous_mean = t == 0 ? 0.5 : sum / t;
+    variance += pow(x[t] - previous_mean, 2);
+    sum += x[t];
+    const double boundary = mixture.bound(variance, log(2 / alpha)) / (t + 1);
+    running_lower = std::max(running_lower, sum / (t + 1) - boundary);
+    running_upper = std::min(running_upper, sum / (t + 1) + boundary);
+    EXPECT_NEAR(lower[t], running_lower, 1e-9) << t;
+    EXPECT_NEAR(upper[t], running_upper, 1e-9) << t;
+  }
+  EXPECT_EQ(stream_cs_kind("conjmix_empbern"), StreamCSKind::CONJMIX_EMPBERN);
+  EXPECT_THROW(stream_cs_kind("conjmix"), std::invalid_argument);
+}
+
+TEST(StreamCSTest, PredmixAccumulatorsMatchBatch) {
+  std::vector<double> x(400);
+  unsigned state = 37;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  const double alpha = 0.1;
+  std::vector<double> lower(x.size()), upper(x.size());
+  predmix_hoeffding_cs(x.data(), x.size(), alpha, false, lower.data(),
+                       upper.data());
+  // predmix_hoeffding_cs with the numpy cumsums of predmix.py.
+  double psi = 0, lambdas = 0, weighted = 0;
+  for (size_t t = 0; t < x.size(); t++) {
+    const double lambda = std::min(
+        1.0, sqrt(8 * log(2 / alpha) / ((t + 1) * log(t + 2.0))));
+    psi += lambda * lambda / 8;
+    lambdas += lambda;
+    weighted += x[t] * lambda;
+    const double margin = (psi + log(2 / alpha)) / lambdas;
+    EXPECT_NEAR(lower[t], std::max(0.0, weighted / lambdas - margin), 1e-12);
+    EXPECT_NEAR(upper[t], std::min(1.0, weighted / lambdas + margin), 1e-12);
+  }
+
+  for (const bool running_intersection : {false, true}) {
+    std::vector<double> eb_lower(x.size()), eb_upper(x.size());
+    predmix_empbern_cs(x.data(), x.size(), alpha, 0.5, 200,
+                       running_intersection, eb_lower.data(),
+                       eb_upper.data());
+    predmix_hoeffding_cs(x.data(), x.size(), alpha, running_intersection,
+                         lower.data(), upper.data());
+    PredmixEmpBernAccumulator eb(alpha, 0.5, running_intersection, 200);
+    PredmixHoeffdingAccumulator hoeffding(alpha, running_intersection);
+    EXPECT_EQ(eb.interval(), std::make_pair(0.0, 1.0));
+    // Uneven batches land on the same intervals as one observation at a time.
+    size_t t = 0;
+    for (const size_t batch : {1, 0, 7, 100, 292}) {
+      eb.update(x.data() + t, batch);
+      hoeffding.update(x.data() + t, batch);
+      t += batch;
+      if (t > 0) {
+        EXPECT_EQ(eb.interval(),
+                  std::make_pair(eb_lower[t - 1], eb_upper[t - 1]));
+        EXPECT_EQ(hoeffding.interval(),
+                  std::make_pair(lower[t - 1], upper[t - 1]));
+      }
+    }
+    EXPECT_EQ(eb.num_observations(), x.size());
+    EXPECT_EQ(hoeffding.num_observations(), x.size());
+  }
+}
+
+TEST(StreamCSTest, ConjmixAccumulatorMatchesBoundSequence) {
+  std::vector<double> x(600);
+  unsigned state = 43;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.5;
+  }
+  const double alpha = 0.05;
+  std::vector<double> variance(x.size()), bounds(x.size());
+  double sum = 0, v = 0;
+  for (size_t t = 0; t < x.size(); t++) {
+    const double previous_mean = t == 0 ? 0.5 : sum / t;
+    v += pow(x[t] - previous_mean, 2);
+    sum += x[t];
+    variance[t] = v;
+  }
+  const GammaExponentialMixture mixture(20, alpha / 2, 1);
+  mixture.bound_sequence(variance.data(), x.size(), log(2 / alpha),
+                         bounds.data());
+  std::vector<double> lower(x.size()), upper(x.size());
+  conjmix_empbern_cs(x.data(), x.size(), 20, alpha, false, lower.data(),
+                     upper.data());
+  ConjmixEmpBernAccumulator cs(20, alpha, true);
+  sum = 0;
+  double running_lower = 0, running_upper = 1;
+  for (size_t t = 0; t < x.size(); t++) {
+    sum += x[t];
+    const double mean = sum / (t + 1);
+    EXPECT_EQ(lower[t], std::max(0.0, mean - bounds[t] / (t + 1))) << t;
+    EXPECT_EQ(upper[t], std::min(1.0, mean + bounds[t] / (t + 1))) << t;
+    running_lower = std::max(running_lower, lower[t]);
+    running_upper = std::min(running_upper, upper[t]);
+    if (t % 50 == 49) {
+      EXPECT_EQ(cs.update(x.data() + t - 49, 50),
+                std::make_pair(running_lower, running_upper));
+    }
+  }
+  EXPECT_EQ(cs.num_observations(), x.size());
+}
+
+TEST(StreamCSTest, ConjmixHoeffdingMatchesNormalMixtureBound) {
+  std::vector<double> x(700);
+  unsigned state = 47;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  const double alpha = 0.05;
+  for (const bool running_intersection : {false, true}) {
+    std::vector<double> lower(x.size()), upper(x.size());
+    conjmix_hoeffding_cs(x.data(), x.size(), 300, alpha, running_intersection,
+                         lower.data(), upper.data());
+    ConjmixHoeffdingAccumulator cs(300, alpha, running_intersection);
+    double sum = 0, running_lower = 0, running_upper = 1;
+    for (size_t t = 0; t < x.size(); t++) {
+      sum += x[t];
+      const double mean = sum / (t + 1);
+      const double boundary = normal_mixture_bound((t + 1) / 4.0, alpha,
+                                                   300 / 4.0, alpha, false)
+          / (t + 1);
+      running_lower = std::max(mean - boundary, running_intersection
+                               ? running_lower : 0.0);
+      running_upper = std::min(mean + boundary, running_intersection
+                               ? running_upper : 1.0);
+      EXPECT_NEAR(lower[t], running_lower, 1e-12) << t;
+      EXPECT_NEAR(upper[t], running_upper, 1e-12) << t;
+      EXPECT_EQ(cs.update(x.data() + t, 1), std::make_pair(lower[t], upper[t]));
+    }
+  }
+  EXPECT_EQ(stream_cs_kind("conjmix_hoeffding"),
+            StreamCSKind::CONJMIX_HOEFFDING);
+}
+
+TEST(StreamCSTest, PredmixWoRMatchesTranscriptions) {
+  const double N = 500, alpha = 0.05, lower_bd = 0, upper_bd = 2;
+  const double c = upper_bd - lower_bd;
+  std::vector<double> x(400);
+  unsigned state = 53;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * c;
+  }
+  std::vector<double> eb_lower(x.size()), eb_upper(x.size());
+  predmix_empbern_cs_wor(x.data(), x.size(), N, alpha, lower_bd, upper_bd,
+                         false, eb_lower.data(), eb_upper.data());
+  std::vector<double> lower(x.size()), upper(x.size());
+  predmix_hoeffding_cs_wor(x.data(), x.size(), N, alpha, lower_bd, upper_bd,
+                           false, lower.data(), upper.data());
+  // The numpy cumsums of predmix.py.
+  double sum = 0, variance = 0, eb_psi = 0, eb_lambdas = 0, eb_weighted = 0,
+      psi = 0, lambdas = 0, weighted = 0;
+  for (size_t i = 0; i < x.size(); i++) {
+    const double t = i + 1;
+    const double previous_mean = (0.5 + sum) / t;
+    const double z = sum / (N - t + 1), w = (t - 1) / (N - t + 1);
+    const double previous_variance = i == 0 ? pow(c / 2, -2)
+        : variance * pow(c / 2, -2);
+    const double eb_lambda = std::min(
+        1 / (2 * c),
+        sqrt(8 * log(2 / alpha) / (previous_variance * log(1 + t) * c * c)));
+    variance += 0.25 + pow(x[i] - previous_mean, 2);
+    eb_psi += pow(c / 2, -2) * pow(x[i] - previous_mean, 2)
+        * (-log(1 - c * eb_lambda) - c * eb_lambda) / 4;
+    eb_lambdas += eb_lambda * (1 + w);
+    eb_weighted += eb_lambda * (x[i] + z);
+    const double eb_margin = (eb_psi + log(2 / alpha)) / eb_lambdas;
+    EXPECT_NEAR(eb_lower[i],
+                std::max(lower_bd, eb_weighted / eb_lambdas - eb_margin),
+                1e-12) << i;
+    EXPECT_NEAR(eb_upper[i],
+                std::min(upper_bd, eb_weighted / eb_lambdas + eb_margin),
+                1e-12) << i;
+
+    const double lambda = std::min(
+        1 / c, sqrt(8 * log(2 / alpha) / (t * log(1 + t) * c * c)));
+    psi += lambda * lambda;
+    lambdas += lambda * (1 + w);
+    weighted += lambda * (x[i] + z);
+    const double margin = (psi * c * c / 8 + log(2 / alpha)) / lambdas;
+    EXPECT_NEAR(lower[i], std::max(lower_bd, weighted / lambdas - margin),
+                1e-12) << i;
+    EXPECT_NEAR(upper[i], std::min(upper_bd, weighted / lambdas + margin),
+                1e-12) << i;
+    sum += x[i];
+  }
+  // Most of the population is sampled by now.
+  EXPECT_LT(eb_upper.back() - eb_lower.back(), 0.2);
+
+  std::vector<double> given_lambdas(x.size());
+  for (size_t i = 0; i < x.size(); i++) {
+    given_lambdas[i] = 0.1 + 0.2 * (i % 3);
+  }
+  for (const bool running_intersection : {false, true}) {
+    predmix_empbern_cs_wor(x.data(), x.size(), N, alpha, lower_bd, upper_bd,
+                           running_intersection, eb_lower.data(),
+                           eb_upper.data());
+    predmix_hoeffding_cs_wor(x.data(), x.size(), N, alpha, lower_bd, upper_bd,
+                             running_intersection, lower.data(),
+                             upper.data(), given_lambdas.data());
+    PredmixEmpBernWoRAccumulator eb(N, alpha, lower_bd, upper_bd,
+                                    running_intersection);
+    PredmixHoeffdingWoRAccumulator hoeffding(N, alpha, lower_bd, upper_bd,
+                                             running_intersection);
+    EXPECT_EQ(eb.interval(), std::make_pair(lower_bd, upper_bd));
+    size_t t = 0;
+    for (const size_t batch : {1, 0, 99, 300}) {
+      eb.update(x.data() + t, batch);
+      // Given bets are used as they are.
+      hoeffding.update(x.data() + t, batch, given_lambdas.data() + t);
+      t += batch;
+      if (t > 0) {
+        EXPECT_EQ(eb.interval(),
+                  std::make_pair(eb_lower[t - 1], eb_upper[t - 1]));
+        EXPECT_EQ(hoeffding.interval(),
+                  std::make_pair(lower[t - 1], upper[t - 1]));
+      }
+    }
+    EXPECT_THROW(eb.update(x.data(), 101), std::invalid_argument);
+    EXPECT_EQ(eb.num_observations(), x.size());
+    eb.update(x.data(), 100);
+    EXPECT_EQ(eb.num_observations(), N);
+  }
+}
+
+TEST(StreamCSTest, BatchMatchesSingleStreams) {
+  std::vector<size_t> offsets = {0};
+  std::vector<double> values;
+  unsigned state = 41;
+  for (const size_t length : {300, 0, 1, 57, 400, 2, 123}) {
+    for (size_t i = 0; i < length; i++) {
+      state = state * 1103515245 + 12345;
+      values.push_back(double((state >> 16) % 1000) / 999);
+    }
+    offsets.push_back(values.size());
+  }
+  const size_t num_streams = offsets.size() - 1;
+  std::vector<double> population_sizes;
+  for (size_t stream = 0; stream < num_streams; stream++) {
+    population_sizes.push_back(offsets[stream + 1] - offsets[stream] + 10);
+  }
+  for (const StreamCSKind kind : {StreamCSKind::PREDMIX_EMPBERN,
+                                  StreamCSKind::PREDMIX_HOEFFDING,
+                                  StreamCSKind::PREDMIX_EMPBERN_WOR,
+                                  StreamCSKind::PREDMIX_HOEFFDING_WOR,
+                                  StreamCSKind::CONJMIX_HOEFFDING,
+                                  StreamCSKind::CONJMIX_EMPBERN,
+                                  StreamCSKind::HEDGED}) {
+    StreamCSParams params;
+    params.kind = kind;
+    params.running_intersection = true;
+    params.breaks = 100;
+    if (kind == StreamCSKind::PREDMIX_EMPBERN_WOR
+        || kind == StreamCSKind::PREDMIX_HOEFFDING_WOR) {
+      params.population_sizes = population_sizes.data();
+    }
+    std::vector<double> expected_lower(values.size()),
+        expected_upper(values.size());
+    for (size_t stream = 0; stream < num_streams; stream++) {
+      StreamCSParams stream_params = params;
+      if (params.population_sizes != nullptr) {
+        stream_params.population_sizes += stream;
+      }
+      batch_confidence_sequences(values.data(), offsets.data() + stream, 1,
+                                 stream_params, expected_lower.data(),
+                                 expected_upper.data(), 1);
+    }
+    const size_t n = offsets[1];
+    std::vector<double> single_lower(n), single_upper(n);
+    if (kind == StreamCSKind::HEDGED) {
+      hedged_cs(values.data(), n, 0.05, 0, 100, true, 0.5, 0.5,
+                single_lower.data(), single_upper.data());
+      HedgedConfidenceSequence cs(0.05, 0, 100);
+      EXPECT_EQ(cs.update(values.data(), n),
+                std::make_pair(single_lower.back(), single_upper.back()));
+    } else if (kind == StreamCSKind::PREDMIX_EMPBERN) {
+      predmix_empbern_cs(values.data(), n, 0.05, 0.5, 0, true,
+                         single_lower.data(), single_upper.data());
+    } else if (kind == StreamCSKind::PREDMIX_HOEFFDING) {
+      predmix_hoeffding_cs(values.data(), n, 0.05, true, single_lower.data(),
+                           single_upper.data());
+    } else if (kind == StreamCSKind::PREDMIX_EMPBERN_WOR) {
+      predmix_empbern_cs_wor(values.data(), n, n + 10, 0.05, 0, 1, true,
+                             single_lower.data(), single_upper.data());
+    } else if (kind == StreamCSKind::PREDMIX_HOEFFDING_WOR) {
+      predmix_hoeffding_cs_wor(values.data(), n, n + 10, 0.05, 0, 1, true,
+                               single_lower.data(), single_upper.data());
+    } else if (kind == StreamCSKind::CONJMIX_HOEFFDING) {
+      conjmix_hoeffding_cs(values.data(), n, 1, 0.05, true,
+                           single_lower.data(), single_upper.data());
+    } else {
+      conjmix_empbern_cs(values.data(), n, 1, 0.05, true, single_lower.data(),
+                         single_upper.data());
+    }
+    EXPECT_EQ(std::vector<double>(expected_lower.begin(),
+                                  expected_lower.begin() + n),
+              single_lower);
+    for (const int num_threads : {1, 3}) {
+      std::vector<double> lower(values.size()), upper(values.size());
+      batch_confidence_sequences(values.data(), offsets.data(), num_streams,
+                                 params, lower.data(), upper.data(),
+                                 num_threads);
+      EXPECT_EQ(lower, expected_lower) << num_threads;
+      EXPECT_EQ(upper, expected_upper) << num_threads;
+    }
+  }
+}
+
+TEST(StreamCSTest, OneSidedSpendsAlphaOnOneBound) {
+  std::vector<double> x(500);
+  unsigned state = 43;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999 * 0.6;
+  }
+  const size_t n = x.size();
+  const size_t offsets[] = {0, n};
+  for (const StreamCSKind kind : {StreamCSKind::PREDMIX_EMPBERN,
+                                  StreamCSKind::CONJMIX_EMPBERN,
+                                  StreamCSKind::HEDGED}) {
+    StreamCSParams params;
+    params.kind = kind;
+    params.breaks = 1000;
+    params.running_intersection = true;
+    std::vector<double> lower(n), upper(n), one_lower(n), one_upper(n);
+    batch_confidence_sequences(x.data(), offsets, 1, params, lower.data(),
+                               upper.data());
+    params.side = CSSide::LOWER;
+    batch_confidence_sequences(x.data(), offsets, 1, params,
+                               one_lower.data(), one_upper.data());
+    for (size_t t = 0; t < n; t++) {
+      EXPECT_EQ(one_upper[t], 1) << t;
+      EXPECT_GE(one_lower[t], lower[t]) << t;
+    }
+    EXPECT_GT(one_lower.back(), lower.back());
+    params.side = CSSide::UPPER;
+    batch_confidence_sequences(x.data(), offsets, 1, params,
+                               one_lower.data(), one_upper.data());
+    for (size_t t = 0; t < n; t++) {
+      EXPECT_EQ(one_lower[t], 0) << t;
+      EXPECT_LE(one_upper[t], upper[t]) << t;
+    }
+    EXPECT_LT(one_upper.back(), upper.back());
+  }
+
+  // A one-sided bound at alpha is that of the two-sided CS at 2 alpha.
+  std::vector<double> lower(n), upper(n), one_lower(n), one_upper(n);
+  predmix_empbern_cs(x.data(), n, 0.1, 0.5, 0, false, lower.data(),
+                     upper.data());
+  predmix_empbern_cs(x.data(), n, 0.05, 0.5, 0, false, one_lower.data(),
+                     one_upper.data(), CSSide::UPPER);
+  EXPECT_EQ(one_upper, upper);
+  conjmix_empbern_cs(x.data(), n, 10, 0.1, false, lower.data(),
+                     upper.data());
+  conjmix_empbern_cs(x.data(), n, 10, 0.05, false, one_lower.data(),
+                     one_upper.data(), CSSide::LOWER);
+  EXPECT_EQ(one_lower, lower);
+  EXPECT_EQ(cs_side("upper"), CSSide::UPPER);
+  EXPECT_THROW(cs_side("two-sided"), std::invalid_argument);
+
+  // Checkpoints keep the side, and version 1 checkpoints load as two-sided.
+  PredmixEmpBernAccumulator cs(0.05, 0.5, false, 0, CSSide::LOWER);
+  cs.update(x.data(), 100);
+  std::stringstream buffer;
+  cs.save(buffer);
+  PredmixEmpBernAccumulator resumed = PredmixEmpBernAccumulator::load(buffer);
+  EXPECT_EQ(resumed.update(x.data() + 100, 100),
+            cs.update(x.data() + 100, 100));
+  EXPECT_EQ(resumed.interval().second, 1);
+  ConjmixEmpBernAccumulator conjmix(10, 0.05, false);
+  conjmix.update(x.data(), 100);
+  std::stringstream current;
+  conjmix.save(current);
+  std::string version_1 = current.str();
+  version_1.resize(version_1.size() - sizeof(uint64_t));
+  const uint32_t old_version = 1;
+  memcpy(&version_1[8], &old_version, sizeof(old_version));
+  std::stringstream old_buffer(version_1);
+  ConjmixEmpBernAccumulator loaded = ConjmixEmpBernAccumulator::load(
+      old_buffer);
+  EXPECT_EQ(loaded.update(x.data() + 100, 100),
+            conjmix.update(x.data() + 100, 100));
+}
+
+TEST(StreamCSTest, GeometricReadoutTimes) {
+  EXPECT_EQ(geometric_readout_times(100),
+            std::vector<size_t>({1, 2, 4, 8, 16, 32, 64, 100}));
+  EXPECT_EQ(geometric_readout_times(30, 1.5),
+            std::vector<size_t>({1, 2, 3, 4, 6, 8, 12, 18, 26, 30}));
+  EXPECT_EQ(geometric_readout_times(64, 2, 10),
+            std::vector<size_t>({10, 20, 40, 64}));
+  EXPECT_EQ(geometric_readout_times(1), std::vector<size_t>({1}));
+  EXPECT_TRUE(geometric_readout_times(0).empty());
+  EXPECT_THROW(geometric_readout_times(10, 1), std::invalid_argument);
+}
+
+TEST(StreamCSTest, ReadoutsMatchDenseSequences) {
+  const size_t n = 3000;
+  std::vector<double> x(n);
+  unsigned state = 17;
+  for (double& value : x) {
+    state = state * 1103515245 + 12345;
+    value = double((state >> 16) % 1000) / 999 * 0.6;
+  }
+  const std::vector<size_t> times = geometric_readout_times(n, 1.5);
+  for (const StreamCSKind kind : {StreamCSKind::PREDMIX_EMPBERN,
+                                  StreamCSKind::PREDMIX_HOEFFDING,
+                                  StreamCSKind::PREDMIX_EMPBERN_WOR,
+                                  StreamCSKind::CONJMIX_HOEFFDING,
+                                  StreamCSKind::CONJMIX_EMPBERN,
+                                  StreamCSKind::HEDGED}) {
+    for (const bool running_intersection : {false, true}) {
+      StreamCSParams params;
+      params.kind = kind;
+      params.running_intersection = running_intersection;
+      params.v_opt = 50;
+      params.N = kind == StreamCSKind::PREDMIX_EMPBERN_WOR ? 2 * n : 0;
+      params.breaks = 100;
+      const size_t offsets[] = {0, n};
+      std::vector<double> dense_lower(n), dense_upper(n);
+      batch_confidence_sequences(x.data(), offsets, 1, params,
+                                 dense_lower.data(), dense_upper.data());
+      std::vector<double> lower(times.size()), upper(times.size());
+      confidence_sequence_readouts(x.data(), times.data(), times.size(),
+                                   params, lower.data(), upper.data());
+      for (size_t i = 0; i < times.size(); i++) {
+        const size_t t = times[i] - 1;
+        if (kind == StreamCSKind::CONJMIX_EMPBERN && running_intersection) {
+          // Intersections over the readouts only, which are no narrower.
+          EXPECT_LE(lower[i], dense_lower[t] + 1e-9) << times[i];
+          EXPECT_GE(upper[i], dense_upper[t] - 1e-9) << times[i];
+        } else if (kind == StreamCSKind::CONJMIX_EMPBERN) {
+          EXPECT_NEAR(lower[i], dense_lower[t], 1e-9) << times[i];
+          EXPECT_NEAR(upper[i], dense_upper[t], 1e-9) << times[i];
+        } else {
+          EXPECT_EQ(lower[i], dense_lower[t]) << int(kind) << " " << times[i];
+          EXPECT_EQ(upper[i], dense_upper[t]) << int(kind) << " " << times[i];
+        }
+      }
+    }
+  }
+  const size_t bad_times[] = {1, 5, 5};
+  double lower[3], upper[3];
+  EXPECT_THROW(confidence_sequence_readouts(x.data(), bad_times, 3,
+                                            StreamCSParams(), lower, upper),
+               std::invalid_argument);
+}
+
+TEST(StreamCSTest, FirstExclusionsMatchDenseSequences) {
+  std::vector<double> values;
+  unsigned state = 23;
+  for (size_t i = 0; i < 3000; i++) {
+    state = state * 1103515245 + 12345;
+    values.push_back(double((state >> 16) % 1000) / 999 * 0.6);
+  }
+  const std::vector<size_t> offsets = {0, 2000, 2000, 2003, 3000};
+  const size_t num_streams = offsets.size() - 1;
+  // The last null, the sampling mean, is never excluded.
+  const std::vector<double> null_means = {0.5, 0.45, 0.4, 0.3};
+  for (const StreamCSKind kind : {StreamCSKind::PREDMIX_EMPBERN,
+                                  StreamCSKind::PREDMIX_HOEFFDING,
+                                  StreamCSKind::PREDMIX_EMPBERN_WOR,
+                                  StreamCSKind::CONJMIX_HOEFFDING,
+                                  StreamCSKind::CONJMIX_EMPBERN,
+                                  StreamCSKind::HEDGED}) {
+    for (const bool running_intersection : {false, true}) {
+      StreamCSParams params;
+      params.kind = kind;
+      params.running_intersection = running_intersection;
+      params.v_opt = 50;
+      params.N = kind == StreamCSKind::PREDMIX_EMPBERN_WOR ? 6000 : 0;
+      params.breaks = 100;
+      std::vector<double> lower(values.size()), upper(values.size());
+      batch_confidence_sequences(values.data(), offsets.data(), num_streams,
+                                 params, lower.data(), upper.data());
+      std::vector<FirstCrossing> crossings(num_streams);
+      cs_first_exclusions(values.data(), offsets.data(), num_streams, params,
+                          0, null_means.data(), crossings.data());
+      for (size_t stream = 0; stream < num_streams; stream++) {
+        FirstCrossing expected;
+        for (size_t t = offsets[stream]; t < offsets[stream + 1]; t++) {
+          expected.lower = lower[t];
+          expected.upper = upper[t];
+          if (lower[t] > null_means[stream]
+              || upper[t] < null_means[stream]) {
+            expected.time = t + 1 - offsets[stream];
+            break;
+          }
+        }
+        const FirstCrossing& crossing = crossings[stream];
+        EXPECT_EQ(crossing.time, expected.time)
+            << int(kind) << " " << running_intersection << " " << stream;
+        EXPECT_NEAR(crossing.lower, expected.lower, 1e-9) << int(kind);
+        EXPECT_NEAR(crossing.upper, expected.upper, 1e-9) << int(kind);
+      }
+      EXPECT_GT(crossings[0].time, 0) << int(kind);
+      EXPECT_EQ(crossings[3].time, 0) << int(kind);
+    }
+  }
+}
+
+TEST(StreamCSTest, IntersectionMatchesSeparateSequences) {
+  std::vector<double> x;
+  unsigned state = 29;
+  for (size_t i = 0; i < 1500; i++) {
+    state = state * 1103515245 + 12345;
+    x.push_back(double((state >> 16) % 1000) / 999 * 0.7);
+  }
+  const size_t n = x.size();
+  std::vector<StreamCSParams> methods(3);
+  methods[0].kind = StreamCSKind::PREDMIX_EMPBERN;
+  methods[1].kind = StreamCSKind::CONJMIX_EMPBERN;
+  methods[1].v_opt = 50;
+  methods[2].kind = StreamCSKind::HEDGED;
+  methods[2].breaks = 100;
+  for (StreamCSParams& params : methods) {
+    params.alpha = 0.05 / 3;
+  }
+  const size_t offsets[] = {0, n};
+  for (const bool running_intersection : {false, true}) {
+    std::vector<double> expected_lower(n, 0), expected_upper(n, 1);
+    for (StreamCSParams params : methods) {
+      params.running_intersection = running_intersection;
+      std::vector<double> lower(n), upper(n);
+      batch_confidence_sequences(x.data(), offsets, 1, params, lower.data(),
+                                 upper.data());
+      for (size_t t = 0; t < n; t++) {
+        expected_lower[t] = std::max(expected_lower[t], lower[t]);
+        expected_upper[t] = std::min(expected_upper[t], upper[t]);
+      }
+    }
+    std::vector<double> lower(n), upper(n);
+    intersected_cs(x.data(), n, methods.data(), methods.size(),
+                   running_intersection, lower.data(), upper.data());
+    for (size_t t = 0; t < n; t++) {
+      EXPECT_NEAR(lower[t], expected_lower[t], 1e-12) << t;
+      EXPECT_NEAR(upper[t], expected_upper[t], 1e-12) << t;
+      if (running_intersection && t > 0) {
+        EXPECT_GE(lower[t], lower[t - 1]);
+        EXPECT_LE(upper[t], upper[t - 1]);
+      }
+    }
+
+    // Streamed in uneven batches, with and without per-time bounds.
+    IntersectedConfidenceSequence cs(methods.data(), methods.size(),
+                                     running_intersection);
+    cs.update(x.data(), 700);
+    EXPECT_NEAR(cs.interval().first, lower[699], 1e-12);
+    std::vector<double> tail_lower(n - 700), tail_upper(n - 700);
+    const std::pair<double, double> interval =
+        cs.update(x.data() + 700, n - 700, tail_lower.data(),
+                  tail_upper.data());
+    EXPECT_EQ(cs.num_observations(), n);
+    EXPECT_NEAR(interval.first, lower[n - 1], 1e-12);
+    EXPECT_NEAR(interval.second, upper[n - 1], 1e-12);
+    EXPECT_NEAR(tail_upper[100], upper[800], 1e-12);
+  }
+
+  // A rejected batch leaves every method unchanged.
+  IntersectedConfidenceSequence cs(methods.data(), methods.size());
+  cs.update(x.data(), 10);
+  const double bad[] = {0.5, 1.5};
+  EXPECT_THROW(cs.update(bad, 2), std::invalid_argument);
+  EXPECT_EQ(cs.num_observations(), 10u);
+  std::vector<double> lower(n), upper(n);
+  intersected_cs(x.data(), 11, methods.data(), methods.size(), false,
+                 lower.data(), upper.data());
+  EXPECT_NEAR(cs.update(x.data() + 10, 1).first, lower[10], 1e-12);
+  EXPECT_THROW(IntersectedConfidenceSequence(methods.data(), 0),
+               std::invalid_argument);
+}
+
+TEST(StreamCSTest, ChunkedUpdatesMatchBatchBitForBit) {
+  CounterRng rng(13, 0);
+  const size_t n = 2000;
+  std::vector<double> x(n);
+  for (double& value : x) {
+    value = rng.uniform() * 0.6;
+  }
+  const StreamCSKind kinds[] = {
+      StreamCSKind::PREDMIX_EMPBERN, StreamCSKind::PREDMIX_HOEFFDING,
+      StreamCSKind::PREDMIX_EMPBERN_WOR, StreamCSKind::PREDMIX_HOEFFDING_WOR,
+      StreamCSKind::CONJMIX_HOEFFDING, StreamCSKind::CONJMIX_EMPBERN,
+      StreamCSKind::HEDGED};
+  const size_t offsets[] = {0, n};
+  for (const StreamCSKind kind : kinds) {
+    for (const bool running_intersection : {false, true}) {
+      StreamCSParams params;
+      params.kind = kind;
+      params.running_intersection = running_intersection;
+      params.N = 4000;
+      params.t_opt = 500;
+      params.v_opt = 50;
+      params.breaks = 100;
+      std::vector<double> lower(n), upper(n);
+      batch_confidence_sequences(x.data(), offsets, 1, params, lower.data(),
+                                 upper.data());
+      // Chunks of 1, 4, 13, ... observations, so that chunk boundaries fall
+      // both inside and across the blocks of the update.
+      IntersectedConfidenceSequence cs(&params, 1);
+      std::vector<double> chunked_lower(n), chunked_upper(n);
+      for (size_t begin = 0, size = 1; begin < n; size = 3 * size + 1) {
+        const size_t count = std::min(size, n - begin);
+        cs.update(x.data() + begin, count, chunked_lower.data() + begin,
+                  chunked_upper.data() + begin);
+        begin += count;
+      }
+      for (size_t t = 0; t < n; t++) {
+        ASSERT_EQ(memcmp(&chunked_lower[t], &lower[t], sizeof(double)), 0)
+            << int(kind) << " " << t;
+        ASSERT_EQ(memcmp(&chunked_upper[t], &upper[t], sizeof(double)), 0)
+            << int(kind) << " " << t;
+      }
+      EXPECT_EQ(cs.interval(), std::make_pair(lower[n - 1], upper[n - 1]));
+    }
+  }
+}
+
+TEST(StreamCSTest, SinksMatchArrays) {
+  std::vector<double> x;
+  unsigned state = 31;
+  for (size_t i = 0; i < 3000; i++) {
+    state = state * 1103515245 + 12345;
+    x.push_back(double((state >> 16) % 1000) / 999);
+  }
+  const size_t n = x.size();
+  const size_t offsets[] = {0, 1000, 1000, 2500, n};
+  for (const StreamCSKind kind : {StreamCSKind::PREDMIX_EMPBERN,
+                                  StreamCSKind::CONJMIX_EMPBERN,
+                                  StreamCSKind::HEDGED}) {
+    StreamCSParams params;
+    params.kind = kind;
+    params.v_opt = 50;
+    params.breaks = 100;
+    params.running_intersection = true;
+    std::vector<double> lower(n), upper(n);
+    batch_confidence_sequences(x.data(), offsets, 4, params, lower.data(),
+                               upper.data());
+
+    // Blocks of 300 rows split streams unevenly and arrive from two threads.
+    std::vector<double> sink_lower(n, -1), sink_upper(n, -1);
+    size_t max_block = 0;
+    CallbackBoundsSink sink([&](const size_t offset, const double* l,
+                                const double* u, const size_t count) {
+      std::copy(l, l + count, sink_lower.begin() + offset);
+      std::copy(u, u + count, sink_upper.begin() + offset);
+      max_block = std::max(max_block, count);
+    });
+    batch_confidence_sequences(x.data(), offsets, 4, params, sink, 2, 300);
+    EXPECT_EQ(max_block, 300u);
+    for (size_t t = 0; t < n; t++) {
+      EXPECT_NEAR(sink_lower[t], lower[t], 1e-12) << t;
+      EXPECT_NEAR(sink_upper[t], upper[t], 1e-12) << t;
+    }
+  }
+
+  StreamCSParams params;
+  const std::string path = testing::TempDir() + "bounds_sink.bin";
+  std::vector<double> lower(n), upper(n);
+  intersected_cs(x.data(), n, &params, 1, false, lower.data(), upper.data());
+  {
+    BoundsFileSink sink(path, n);
+    intersected_cs(x.data(), n, &params, 1, false, sink, 512);
+    const double row[] = {0};
+    EXPECT_THROW(sink.write(n, row, row, 1), std::invalid_argument);
+  }
+  std::ifstream in(path, std::ios::binary);
+  char header[bounds_file_format::HEADER_SIZE];
+  in.read(header, sizeof(header));
+  EXPECT_EQ(memcmp(header, bounds_file_format::MAGIC, 8), 0);
+  uint64_t num_rows;
+  memcpy(&num_rows, header + 16, sizeof(num_rows));
+  EXPECT_EQ(num_rows, n);
+  std::vector<double> rows(2 * n);
+  in.read(reinterpret_cast<char*>(rows.data()), rows.size() * sizeof(double));
+  ASSERT_TRUE(bool(in));
+  for (size_t t = 0; t < n; t++) {
+    EXPECT_EQ(rows[2 * t], lower[t]) << t;
+    EXPECT_EQ(rows[2 * t + 1], upper[t]) << t;
+  }
+  EXPECT_THROW(BoundsFileSink("no_such_dir/bounds.bin", 1),
+               std::runtime_error);
+  std::remove(path.c_str());
+}
+
+// Feeds x to cs in two halves, checkpointing in between, and checks that the
+// restored accumulator tracks the original exactly.
+template <class Accumulator>
+void expect_checkpoint_resumes(Accumulator cs, const std::vector<double>& x) {
+  const size_t half = x.size() / 2;
+  cs.update(x.data(), half);
+  std::stringstream checkpoint;
+  cs.save(checkpoint);
+  Accumulator restored = Accumulator::load(checkpoint);
+  EXPECT_EQ(restored.interval(), cs.interval());
+  EXPECT_EQ(restored.num_observations(), half);
+  for (size_t t = half; t < x.size(); t++) {
+    EXPECT_EQ(restored.update(x.data() + t, 1), cs.update(x.data() + t, 1))
+        << t;
+  }
+}
+
+TEST(StreamCSTest, CheckpointsResume) {
+  std::vector<double> x(300);
+  unsigned state = 59;
+  for (size_t i = 0; i < x.size(); i++) {
+    state = state * 1103515245 + 12345;
+    x[i] = double((state >> 16) % 1000) / 999;
+  }
+  for (const bool running_intersection : {false, true}) {
+    expect_checkpoint_resumes(
+        PredmixEmpBernAccumulator(0.1, 0.5, running_intersection, 200), x);
+    expect_checkpoint_resumes(
+        PredmixHoeffdingAccumulator(0.1, running_intersection), x);
+    expect_checkpoint_resumes(
+        PredmixEmpBernWoRAccumulator(500, 0.1, 0, 1, running_intersection),
+        x);
+    expect_checkpoint_resumes(
+        PredmixHoeffdingWoRAccumulator(500, 0.1, 0, 1, running_intersection),
+        x);
+    expect_checkpoint_resumes(
+        ConjmixEmpBernAccumulator(50, 0.1, running_intersection), x);
+    expect_checkpoint_resumes(
+        ConjmixHoeffdingAccumulator(50, 0.1, running_intersection), x);
+  }
+}
+
+TEST(ConcurrentIngestionTest, ShardedSumsMergeAllThreads) {
+  ShardedSums<2> counts(3);
+  EXPECT_EQ(3u, counts.num_shards());
+  const int num_threads = 8;
+  const int adds_per_thread = 20000;
+  std::atomic<bool> stop(false);
+  // A reader taking sums concurrently sees whole adds only.
+  std::array<double, 2> taken{};
+  std::thread reader([&counts, &stop, &taken]() {
+    while (!stop.load()) {
+      const std::array<double, 2> sums = counts.take();
+      ASSERT_EQ(2 * sums[0], sums[1]);
+      taken[0] += sums[0];
+      taken[1] += sums[1];
+    }
+  });
+  std::vector<std::thread> writers;
+  for (int thread = 0; thread < num_threads; thread++) {
+    writers.emplace_back([&counts]() {
+      for (int i = 0; i < adds_per_thread; i++) {
+        counts.add({{1, 2}});
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  stop = true;
+  reader.join();
+  const std::array<double, 2> rest = counts.total();
+  EXPECT_EQ(double(num_threads) * adds_per_thread, taken[0] + rest[0]);
+  EXPECT_EQ(2.0 * num_threads * adds_per_thread, taken[1] + rest[1]);
+  EXPECT_EQ(rest, counts.take());
+  EXPECT_EQ((std::array<double, 2>{}), counts.total());
+
+  // Counts merged from several threads give the sequential interval.
+  ShardedSums<2> bernoulli;
+  std::vector<std::thread> producers;
+  for (int thread = 0; thread < 4; thread++) {
+    producers.emplace_back([&bernoulli, thread]() {
+      for (int i = 0; i < 250; i++) {
+        bernoulli.add({{double((i + thread) % 3 == 0), 1}});
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  const std::array<double, 2> totals = bernoulli.take();
+  BernoulliConfidenceSequence merged(0.05, 100), sequential(0.05, 100);
+  merged.update(totals[0], int(totals[1]));
+  int successes = 0;
+  for (int thread = 0; thread < 4; thread++) {
+    for (int i = 0; i < 250; i++) {
+      successes += (i + thread) % 3 == 0;
+    }
+  }
+  sequential.update(successes, 1000);
+  EXPECT_EQ(sequential.interval(), merged.interval());
+}
+
+TEST(ConcurrentIngestionTest, ShardedObservationsKeepPerThreadOrder) {
+  ShardedObservations observations;
+  const int num_threads = 6;
+  const int per_thread = 5000;
+  std::vector<std::thread> producers;
+  for (int thread = 0; thread < num_threads; thread++) {
+    producers.emplace_back([&observations, thread]() {
+      for (int i = 0; i < per_thread; i++) {
+        // Encodes the thread and a per-thread sequence number.
+        observations.add(thread + i / double(per_thread));
+      }
+    });
+  }
+  std::vector<double> drained;
+  size_t num_drained = 0;
+  for (int round = 0; round < 5; round++) {
+    num_drained += observations.drain(drained);
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  num_drained += observations.drain(drained);
+  ASSERT_EQ(size_t(num_threads * per_thread), num_drained);
+  ASSERT_EQ(num_drained, drained.size());
+  std::vector<double> last(num_threads, -1);
+  for (const double x : drained) {
+    const int thread = int(x);
+    EXPECT_GT(x, last[thread]);
+    last[thread] = x;
+  }
+  EXPECT_EQ(0u, observations.drain(drained));
+
+  // Observations in [0, 1] feed an order-dependent accumulator.
+  std::vector<double> x(drained.size());
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = drained[i] / num_threads;
+  }
+  PredmixEmpBernAccumulator accumulator;
+  accumulator.update(x.data(), x.size());
+  EXPECT_EQ(x.size(), accumulator.num_observations());
+}
+
+TEST(ConcurrentIngestionTest, PipelineMatchesDirectUpdates) {
+  const size_t num_streams = 5, per_stream = 3000;
+  std::vector<std::vector<double>> x(num_streams);
+  unsigned state = 41;
+  for (auto& values : x) {
+    for (size_t i = 0; i < per_stream; i++) {
+      state = state * 1103515245 + 12345;
+      values.push_back(double((state >> 16) % 1000) / 999 * 0.6 + 0.2);
+    }
+  }
+  IngestionPipelineOptions options;
+  options.queue_capacity = 256;
+  options.max_batch = 64;
+  options.flush_interval = std::chrono::microseconds(200);
+  options.num_workers = 2;
+  std::vector<HedgedConfidenceSequence> streams(
+      num_streams, HedgedConfidenceSequence(0.05, 0, 50));
+  IngestionPipeline<HedgedConfidenceSequence> pipeline(streams, options);
+  ASSERT_EQ(num_streams, pipeline.num_streams());
+
+  std::atomic<bool> done(false);
+  std::thread reader([&]() {
+    std::vector<size_t> seen(num_streams, 0);
+    while (!done) {
+      for (size_t j = 0; j < num_streams; j++) {
+        const StreamSnapshot snapshot = pipeline.snapshot(j);
+        EXPECT_GE(snapshot.num_observations, seen[j]);
+        EXPECT_LE(snapshot.lower, snapshot.upper);
+        seen[j] = snapshot.num_observations;
+      }
+    }
+  });
+  // One producer per stream, in irregular batches of 1 to 7 events.
+  std::vector<std::thread> producers;
+  for (size_t j = 0; j < num_streams; j++) {
+    producers.emplace_back([&, j]() {
+      for (size_t i = 0; i < per_stream;) {
+        const size_t n = std::min(1 + i % 7, per_stream - i);
+        pipeline.push(j, &x[j][i], n);
+        i += n;
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  pipeline.flush();
+  done = true;
+  reader.join();
+  for (size_t j = 0; j < num_streams; j++) {
+    HedgedConfidenceSequence direct(0.05, 0, 50);
+    const std::pair<double, double> interval =
+        direct.update(x[j].data(), x[j].size());
+    const StreamSnapshot snapshot = pipeline.snapshot(j);
+    EXPECT_EQ(per_stream, snapshot.num_observations);
+    EXPECT_EQ(0u, snapshot.num_rejected);
+    EXPECT_EQ(interval.first, snapshot.lower) << j;
+    EXPECT_EQ(interval.second, snapshot.upper) << j;
+  }
+
+  // A rejected batch leaves its stream unchanged.
+  options.max_batch = 1;
+  std::vector<HedgedConfidenceSequence> one(
+      1, HedgedConfidenceSequence(0.05, 0, 50));
+  IngestionPipeline<HedgedConfidenceSequence> rejecting(one, options);
+  rejecting.push(0, 0.5);
+  rejecting.push(0, 1.5);
+  rejecting.push(0, 0.5);
+  rejecting.flush();
+  EXPECT_EQ(2u, rejecting.snapshot(0).num_observations);
+  EXPECT_EQ(1u, rejecting.snapshot(0).num_rejected);
+  EXPECT_THROW(rejecting.push(1, 0.5), std::out_of_range);
+  EXPECT_THROW(rejecting.snapshot(1), std::out_of_range);
+}
+
+TEST(MixtureSufficientStatisticsTest, MergedShardsMatchPooledData) {
+  const size_t n = 1000;
+  std::vector<double> s_increments(n), v_increments(n);
+  for (size_t i = 0; i < n; i++) {
+    s_increments[i] = std::sin(i * 0.9) + 0.1;
+    v_increments[i] = 0.5 + 0.25 * std::cos(i * 0.3);
+  }
+  MixtureSufficientStatistics pooled;
+  pooled.add(s_increments.data(), v_increments.data(), n);
+  std::vector<MixtureSufficientStatistics> shards(4);
+  for (size_t i = 0; i < n; i++) {
+    shards[i % 4].add(s_increments[i], v_increments[i]);
+  }
+  MixtureSufficientStatistics merged;
+  for (const auto& shard : shards) {
+    merged.merge(shard);
+  }
+  EXPECT_NEAR(pooled.s(), merged.s(), 1e-10);
+  EXPECT_NEAR(pooled.v(), merged.v(), 1e-10);
+  EXPECT_EQ(n, merged.num_observations());
+
+  const GammaExponentialMixture mixture(100, 0.05, 2);
+  EXPECT_NEAR(pooled.p_value(mixture), merged.p_value(mixture), 1e-10);
+  EXPECT_EQ(std::min(1.0, exp(-mixture.log_superMG(merged.s(), merged.v()))),
+            merged.p_value(mixture));
+  const MixtureBoundary boundary(
+      std::unique_ptr<MixtureSupermartingale>(
+          new TwoSidedNormalMixture(100, 0.05)));
+  EXPECT_EQ(boundary(merged.v(), 0.05), merged.bound(boundary, 0.05));
+
+  std::stringstream wire;
+  merged.save(wire);
+  EXPECT_EQ(40u, wire.str().size());
+  const MixtureSufficientStatistics loaded =
+      MixtureSufficientStatistics::load(wire);
+  EXPECT_EQ(merged.s(), loaded.s());
+  EXPECT_EQ(merged.v(), loaded.v());
+  EXPECT_EQ(merged.num_observations(), loaded.num_observations());
+
+  std::istringstream truncated(wire.str().substr(0, 30));
+  EXPECT_THROW(MixtureSufficientStatistics::load(truncated),
+               std::runtime_error);
+  std::stringstream other_kind;
+  BernoulliConfidenceSequence(0.05, 100).save(other_kind);
+  EXPECT_THROW(MixtureSufficientStatistics::load(other_kind),
+               std::runtime_error);
+  EXPECT_THROW(MixtureSufficientStatistics(0, -1, 0), std::invalid_argument);
+  EXPECT_THROW(merged.add(0, -1), std::invalid_argument);
+}
+
+TEST(KeyedStateTableTest, MatchesMap) {
+  KeyedStateTable<uint64_t> table;
+  std::map<uint64_t, uint64_t> expected;
+  CounterRng rng(3, 0);
+  for (int i = 0; i < 5000; i++) {
+    // Repeats small keys, and includes key 0, which marks empty slots.
+    const uint64_t key = i % 3 == 0 ? rng() % 100 : rng();
+    table.find_or_insert(key) += i;
+    expected[key] += i;
+  }
+  EXPECT_EQ(table.size(), expected.size());
+  size_t visited = 0;
+  table.for_each([&](const uint64_t key, const uint64_t value) {
+    EXPECT_EQ(value, expected.at(key)) << key;
+    visited++;
+  });
+  EXPECT_EQ(visited, expected.size());
+  for (const auto& entry : expected) {
+    ASSERT_NE(table.find(entry.first), nullptr) << entry.first;
+    EXPECT_EQ(*table.find(entry.first), entry.second);
+  }
+  EXPECT_EQ(table.find(uint64_t(1) << 63), nullptr);
+  EXPECT_GE(table.memory_bytes(), table.size() * 16 * 4 / 3);
+}
+
+TEST(KeyedBernoulliCSTest, MatchesIntervals) {
+  // Counts past n_max fall back to bernoulli_confidence_interval.
+  KeyedBernoulliCS cs(0.05, 20, 0.05, 30);
+  const std::vector<uint64_t> key_values = {0, 7, 8, uint64_t(-1), 1 << 20};
+  std::map<uint64_t, std::pair<int, int>> counts;
+  CounterRng rng(5, 0);
+  std::vector<uint64_t> keys;
+  std::vector<double> x;
+  for (int i = 0; i < 200; i++) {
+    keys.push_back(key_values[i % key_values.size()]);
+    x.push_back(rng.uniform() < 0.3 ? 1 : 0);
+    counts[keys.back()].first += x.back();
+    counts[keys.back()].second++;
+  }
+  cs.update(keys.data(), x.data(), keys.size());
+  EXPECT_EQ(cs.size(), key_values.size());
+  std::vector<uint64_t> queries(key_values);
+  queries.push_back(9);
+  std::vector<double> lower(queries.size()), upper(queries.size());
+  cs.query(queries.data(), queries.size(), lower.data(), upper.data());
+  for (size_t i = 0; i < key_values.size(); i++) {
+    const std::pair<int, int> count = counts[key_values[i]];
+    const auto expected = bernoulli_confidence_interval(
+        count.first, count.second, 0.05, 20);
+    EXPECT_NEAR(lower[i], expected.first, 1e-9) << key_values[i];
+    EXPECT_NEAR(upper[i], expected.second, 1e-9) << key_values[i];
+    EXPECT_EQ(cs.interval(key_values[i]), std::make_pair(lower[i], upper[i]));
+    EXPECT_EQ(cs.num_observations(key_values[i]), size_t(count.second));
+  }
+  EXPECT_EQ(lower.back(), 0);
+  EXPECT_EQ(upper.back(), 1);
+
+  const double bad[] = {1, 0.5};
+  EXPECT_THROW(cs.update(keys.data(), bad, 2), std::invalid_argument);
+  EXPECT_EQ(cs.num_observations(keys[0]), size_t(counts[keys[0]].second));
+
+  std::stringstream checkpoint;
+  cs.save(checkpoint);
+  const KeyedBernoulliCS restored = KeyedBernoulliCS::load(checkpoint);
+  EXPECT_EQ(restored.size(), cs.size());
+  for (const uint64_t key : queries) {
+    EXPECT_EQ(restored.interval(key), cs.interval(key)) << key;
+  }
+  std::stringstream truncated(checkpoint.str().substr(0, 80));
+  EXPECT_THROW(KeyedBernoulliCS::load(truncated), std::runtime_error);
+}
+
+TEST(KeyedConjmixEmpBernCSTest, MatchesAccumulators) {
+  for (const CSSide side : {CSSide::BOTH, CSSide::LOWER}) {
+    KeyedConjmixEmpBernCS cs(10, 0.05, side);
+    std::vector<ConjmixEmpBernAccumulator> accumulators(
+        20, ConjmixEmpBernAccumulator(10, 0.05, false, side));
+    CounterRng rng(7, 0);
+    std::vector<uint64_t> keys(5000);
+    std::vector<double> x(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      keys[i] = rng() % accumulators.size();
+      x[i] = keys[i] % 2 == 0 ? rng.uniform() : rng.uniform() * 0.2;
+      accumulators[keys[i]].update(&x[i], 1);
+    }
+    cs.update(keys.data(), x.data(), keys.size());
+    for (uint64_t key = 0; key < accumulators.size(); key++) {
+      const auto expected = accumulators[key].interval();
+      const auto interval = cs.interval(key);
+      // The table is an upper envelope, so intervals are never narrower.
+      EXPECT_LE(interval.first, expected.first + 1e-12) << key;
+      EXPECT_GE(interval.second, expected.second - 1e-12) << key;
+      EXPECT_NEAR(interval.first, expected.first, 1e-4) << key;
+      EXPECT_NEAR(interval.second, expected.second, 1e-4) << key;
+      EXPECT_EQ(cs.num_observations(key),
+                accumulators[key].num_observations());
+    }
+    EXPECT_EQ(cs.interval(1000), std::make_pair(0.0, 1.0));
+    const double bad = 1.5;
+    EXPECT_THROW(cs.update(keys.data(), &bad, 1), std::invalid_argument);
+
+    std::stringstream checkpoint;
+    cs.save(checkpoint);
+    const KeyedConjmixEmpBernCS restored =
+        KeyedConjmixEmpBernCS::load(checkpoint);
+    std::vector<double> lower(keys.size()), upper(keys.size());
+    restored.query(keys.data(), keys.size(), lower.data(), upper.data());
+    for (size_t i = 0; i < keys.size(); i += 97) {
+      EXPECT_EQ(std::make_pair(lower[i], upper[i]), cs.interval(keys[i]));
+    }
+  }
+}
+
+TEST(RollupConfidenceSequencesTest, MatchesPerBucketIntervals) {
+  const std::vector<int64_t> grains = {60, 600, 3600};
+  CounterRng rng(11, 0);
+  std::vector<int64_t> timestamps;
+  std::vector<double> x;
+  // Starts below zero, so buckets round down across it.
+  for (int64_t time = -5000; timestamps.size() < 800;) {
+    // Long gaps leave coarse buckets with a single fine one.
+    time += rng() % 50 == 0 ? 3000 : rng() % 40;
+    timestamps.push_back(time);
+    x.push_back(rng.uniform());
+  }
+  for (const RollupCSKind kind : {RollupCSKind::BERNOULLI,
+                                  RollupCSKind::CONJMIX_HOEFFDING,
+                                  RollupCSKind::PREDMIX_EMPBERN}) {
+    RollupCSParams params;
+    params.kind = kind;
+    params.t_opt = 50;
+    std::vector<double> values(x);
+    if (kind == RollupCSKind::BERNOULLI) {
+      for (double& value : values) {
+        value = value < 0.3 ? 1 : 0;
+      }
+    }
+    std::map<std::pair<int64_t, int64_t>, std::vector<double>> buckets;
+    for (size_t i = 0; i < values.size(); i++) {
+      for (const int64_t grain : grains) {
+        const int64_t start = int64_t(std::floor(double(timestamps[i]) / grain))
+            * grain;
+        buckets[{grain, start}].push_back(values[i]);
+      }
+    }
+
+    RollupConfidenceSequences rollups(params, grains);
+    std::vector<RollupReadout> readouts;
+    for (size_t begin = 0; begin < values.size();) {
+      const size_t count = std::min<size_t>(rng() % 100, values.size() - begin);
+      const size_t size = readouts.size();
+      const size_t appended = rollups.update(timestamps.data() + begin,
+                                             values.data() + begin, count,
+                                             readouts);
+      EXPECT_EQ(appended, readouts.size() - size);
+      begin += count;
+    }
+    rollups.flush(readouts);
+    ASSERT_EQ(readouts.size(), buckets.size());
+    std::set<std::pair<size_t, size_t>> counts;
+    std::map<int64_t, int64_t> last_starts;
+    for (const RollupReadout& readout : readouts) {
+      const auto found = buckets.find({readout.grain, readout.start});
+      ASSERT_NE(found, buckets.end());
+      const std::vector<double>& bucket = found->second;
+      ASSERT_EQ(readout.num_observations, bucket.size());
+      const double sum = std::accumulate(bucket.begin(), bucket.end(), 0.0);
+      EXPECT_NEAR(readout.mean, sum / bucket.size(), 1e-12);
+      if (last_starts.count(readout.grain) > 0) {
+        EXPECT_GT(readout.start, last_starts[readout.grain]);
+      }
+      last_starts[readout.grain] = readout.start;
+      std::pair<double, double> expected;
+      if (kind == RollupCSKind::BERNOULLI) {
+        expected = bernoulli_confidence_interval(sum, bucket.size(), 0.05, 50);
+        counts.insert({size_t(sum), bucket.size()});
+      } else if (kind == RollupCSKind::CONJMIX_HOEFFDING) {
+        ConjmixHoeffdingAccumulator cs(50);
+        expected = cs.update(bucket.data(), bucket.size());
+        counts.insert({0, bucket.size()});
+      } else {
+        PredmixEmpBernAccumulator cs;
+        expected = cs.update(bucket.data(), bucket.size());
+      }
+      // Merged sums may round differently from consecutive ones.
+      EXPECT_NEAR(readout.lower, expected.first, 1e-12) << readout.start;
+      EXPECT_NEAR(readout.upper, expected.second, 1e-12) << readout.start;
+      if (kind != RollupCSKind::CONJMIX_HOEFFDING) {
+        EXPECT_EQ(std::make_pair(readout.lower, readout.upper), expected);
+      }
+    }
+    if (kind == RollupCSKind::PREDMIX_EMPBERN) {
+      EXPECT_EQ(rollups.num_boundary_evaluations(), readouts.size());
+    } else {
+      // Each distinct count is evaluated once across grains.
+      EXPECT_EQ(rollups.num_boundary_evaluations(), counts.size());
+      EXPECT_LT(counts.size(), readouts.size());
+    }
+    EXPECT_EQ(rollups.flush(readouts), 0);
+  }
+}
+
+TEST(RollupConfidenceSequencesTest, RejectsInvalidInput) {
+  const RollupCSParams params;
+  EXPECT_THROW(RollupConfidenceSequences(params, {}), std::invalid_argument);
+  EXPECT_THROW(RollupConfidenceSequences(params, {0}), std::invalid_argument);
+  EXPECT_THROW(RollupConfidenceSequences(params, {60, 90}),
+               std::invalid_argument);
+  EXPECT_THROW(rollup_cs_kind("hedged"), std::invalid_argument);
+  EXPECT_EQ(rollup_cs_kind("conjmix_hoeffding"),
+            RollupCSKind::CONJMIX_HOEFFDING);
+
+  RollupConfidenceSequences rollups(params, {10, 100});
+  std::vector<RollupReadout> readouts;
+  const int64_t timestamps[] = {5, 20, 15};
+  const double x[] = {1, 0, 1};
+  EXPECT_EQ(rollups.update(timestamps, x, 2, readouts), 1);
+  EXPECT_THROW(rollups.update(timestamps + 2, x + 2, 1, readouts),
+               std::invalid_argument);
+  EXPECT_THROW(rollups.update(timestamps, x, 3, readouts),
+               std::invalid_argument);
+  const double half = 0.5;
+  EXPECT_THROW(rollups.update(timestamps + 1, &half, 1, readouts),
+               std::invalid_argument);
+  EXPECT_EQ(rollups.flush(readouts), 2);
+  EXPECT_EQ(readouts.back().grain, 100);
+  EXPECT_EQ(readouts.back().num_observations, size_t(2));
+  EXPECT_EQ(readouts.back().mean, 0.5);
+}
+
+TEST(CrossingSimulationTest, PermutationDrawsEachValueOnce) {
+  std::vector<double> population(50);
+  std::iota(population.begin(), population.end(), 0);
+  const SimulatedData data =
+      SimulatedData::permutation(population.data(), population.size());
+  EXPECT_EQ(data.max_length(), 50u);
+  EXPECT_DOUBLE_EQ(data.mean(), 24.5);
+  SimulatedStream stream(data, 1, 2);
+  std::vector<double> drawn;
+  for (int i = 0; i < 50; i++) {
+    drawn.push_back(stream.next());
+  }
+  EXPECT_NE(drawn, population);
+  std::sort(drawn.begin(), drawn.end());
+  EXPECT_EQ(drawn, population);
+  EXPECT_THROW(SimulatedData::bernoulli(1.5), std::invalid_argument);
+}
+
+TEST(CrossingSimulationTest, MixtureCrossingsAreReproducibleAndValid) {
+  const OneSidedNormalMixture mixture(100, 0.05);
+  const SimulatedData data = SimulatedData::gaussian(0.3, 1);
+  const double alpha = 0.1;
+  const CrossingSimulationResult serial = simulate_mixture_crossings(
+      mixture, data, alpha, data.variance(), 500, 2000, 11, 1);
+  const CrossingSimulationResult threaded = simulate_mixture_crossings(
+      mixture, data, alpha, data.variance(), 500, 2000, 11, 4);
+  EXPECT_EQ(serial.crossing_times, threaded.crossing_times);
+  EXPECT_EQ(serial.replicates, 2000u);
+  EXPECT_GT(serial.crossings, 0u);
+  EXPECT_LE(serial.crossing_fraction(), alpha + 3 * serial.standard_error());
+
+  // The boundary is crossed exactly when the supermartingale is.
+  const MixtureBoundaryT<OneSidedNormalMixture> boundary(mixture);
+  const CrossingSimulationResult bounded = simulate_boundary_crossings(
+      [&boundary, alpha](const double v) { return boundary(v, alpha); },
+      data, data.variance(), 500, 2000, false, 11);
+  EXPECT_NEAR(double(bounded.crossings), double(serial.crossings), 2);
+
+  // Each crossing time is the first at which the supermartingale crosses.
+  const CrossingSimulationResult loose = simulate_mixture_crossings(
+      mixture, data, 0.9, 1, 100, 20, 11);
+  EXPECT_GT(loose.crossings, 0u);
+  for (size_t r = 0; r < loose.replicates; r++) {
+    SimulatedStream stream(data, 11, r);
+    double s = 0;
+    size_t first_crossing = 0;
+    for (size_t t = 1; t <= 100 && first_crossing == 0; t++) {
+      s += stream.next() - data.mean();
+      if (mixture.log_superMG(s, t) > log(1 / 0.9)) {
+        first_crossing = t;
+      }
+    }
+    EXPECT_EQ(loose.crossing_times[r], first_crossing) << r;
+  }
+}
+
+TEST(CrossingSimulationTest, ConfidenceSequenceMiscoverage) {
+  const SimulatedData data = SimulatedData::bernoulli(0.3);
+  StreamCSParams params;
+  params.kind = StreamCSKind::PREDMIX_HOEFFDING;
+  params.alpha = 0.1;
+  const CrossingSimulationResult result =
+      simulate_cs_miscoverage(params, data, 300, 1000, 5);
+  EXPECT_LE(result.crossing_fraction(),
+            params.alpha + 3 * result.standard_error());
+
+  // A monitor of any native confidence sequence through the template gives
+  // the same streams.
+  const CrossingSimulationResult bernoulli = simulate_crossings(
+      data, 100, 200, 5, [&data]() {
+        return [&data, sequence = BernoulliConfidenceSequence(0.1, 100)](
+            const double x) mutable {
+          const std::pair<double, double> interval = sequence.update(x, 1);
+          return interval.first > data.mean() || interval.second < data.mean();
+        };
+      });
+  EXPECT_LE(bernoulli.crossing_fraction(),
+            params.alpha + 3 * bernoulli.standard_error());
+
+  std::vector<double> population(200);
+  for (size_t i = 0; i < population.size(); i++) {
+    population[i] = (i % 10) / 9.0;
+  }
+  params.kind = StreamCSKind::PREDMIX_HOEFFDING_WOR;
+  EXPECT_THROW(simulate_cs_miscoverage(params, data, 300, 10),
+               std::invalid_argument);
+  const CrossingSimulationResult wor = simulate_cs_miscoverage(
+      params, SimulatedData::permutation(population.data(), population.size()),
+      1000, 500, 5);
+  EXPECT_LE(wor.crossing_fraction(), params.alpha + 3 * wor.standard_error());
+}
+
+// Control and treatment outcomes in [0, 1] with means 0.25 and 0.5.
+void two_sample_outcomes(std::vector<double>& control,
+                         std::vector<double>& treatment, const size_t n,
+                         unsigned state) {
+  control.resize(n);
+  treatment.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    state = state * 1103515245 + 12345;
+    control[i] = double((state >> 16) % 1000) / 999 * 0.5;
+    state = state * 1103515245 + 12345;
+    treatment[i] = double((state >> 16) % 1000) / 999;
+  }
+}
+
+TEST(TwoSampleMeanTestTest, BetaBinomialMatchesBernoulliInterval) {
+  std::vector<double> control, treatment;
+  two_sample_outcomes(control, treatment, 300, 4);
+  TwoSampleMeanTestParams params;
+  params.t_opt = 100;
+  TwoSampleMeanTest test(params);
+  EXPECT_EQ(test.interval(), std::make_pair(-1.0, 1.0));
+  EXPECT_TRUE(std::isnan(test.estimate()));
+
+  double successes = 0;
+  for (size_t k = 0; k < control.size(); k++) {
+    // Control arrives a step ahead of treatment.
+    test.update(&control[k], 1, nullptr, 0);
+    EXPECT_EQ(test.num_pairs(), k);
+    const std::pair<double, double> interval =
+        test.update(nullptr, 0, &treatment[k], 1);
+    const double difference = treatment[k] - control[k];
+    successes += (difference + 1) / 2;
+    const std::pair<double, double> expected = bernoulli_confidence_interval(
+        successes, k + 1, params.alpha, params.t_opt);
+    EXPECT_NEAR(interval.first, 2 * expected.first - 1, 1e-8) << k;
+    EXPECT_NEAR(interval.second, 2 * expected.second - 1, 1e-8) << k;
+    // The p-value is below alpha when the null is outside the interval.
+    if (interval.first > 1e-6) {
+      EXPECT_LT(test.p_value(), params.alpha) << k;
+    }
+  }
+  EXPECT_EQ(test.num_control(), 300u);
+  EXPECT_EQ(test.num_treatment(), 300u);
+  EXPECT_NEAR(test.estimate(), 0.25, 0.05);
+  EXPECT_GT(test.interval().first, 0);
+  EXPECT_LT(test.p_value(), params.alpha);
+
+  // Observations outside the range leave the state unchanged.
+  const double outside = 1.5;
+  EXPECT_THROW(test.update(&outside, 1, nullptr, 0), std::invalid_argument);
+  EXPECT_EQ(test.num_control(), 300u);
+  params.null_difference = 1;
+  EXPECT_THROW(TwoSampleMeanTest{params}, std::invalid_argument);
+  EXPECT_THROW(two_sample_mixture("normal"), std::invalid_argument);
+}
+
+TEST(TwoSampleMeanTestTest, GammaExponentialMatchesDirectComputation) {
+  std::vector<double> control, treatment;
+  two_sample_outcomes(control, treatment, 200, 9);
+  TwoSampleMeanTestParams params;
+  params.mixture = TwoSampleMixture::GAMMA_EXPONENTIAL;
+  params.v_opt = 10;
+  params.c = 2;
+  TwoSampleMeanTest test(params);
+  EXPECT_TRUE(std::isinf(test.interval().second));
+  // Uneven batches, with treatment ahead.
+  test.update(control.data(), 50, treatment.data(), 120);
+  EXPECT_EQ(test.num_pairs(), 50u);
+  EXPECT_EQ(test.num_treatment(), 120u);
+  test.update(control.data() + 50, 150, treatment.data() + 120, 80);
+
+  const GammaExponentialMixture mixture(10, 0.05 / 2, 2);
+  double sum = 0, variance = 0, p_value = 1;
+  for (size_t k = 0; k < control.size(); k++) {
+    const double difference = treatment[k] - control[k];
+    const double prediction = k == 0 ? 0 : sum / k;
+    variance += (difference - prediction) * (difference - prediction);
+    sum += difference;
+    p_value = std::min(
+        p_value,
+        std::min(1.0, 2 * exp(-mixture.log_superMG(std::abs(sum), variance))));
+  }
+  const double radius = mixture.bound(variance, log(2 / 0.05)) / 200;
+  EXPECT_NEAR(test.interval().first, sum / 200 - radius, 1e-8);
+  EXPECT_NEAR(test.interval().second, sum / 200 + radius, 1e-8);
+  EXPECT_DOUBLE_EQ(test.p_value(), p_value);
+}
+
+TEST(TwoSampleMeanTestTest, BatchMatchesSingleTests) {
+  std::vector<double> control, treatment;
+  std::vector<size_t> control_offsets = {0}, treatment_offsets = {0};
+  for (size_t e = 0; e < 6; e++) {
+    std::vector<double> x, y;
+    two_sample_outcomes(x, y, 20 + 30 * e, e);
+    y.resize(y.size() - e);
+    control.insert(control.end(), x.begin(), x.end());
+    treatment.insert(treatment.end(), y.begin(), y.end());
+    control_offsets.push_back(control.size());
+    treatment_offsets.push_back(treatment.size());
+  }
+  for (const TwoSampleMixture mixture : {TwoSampleMixture::BETA_BINOMIAL,
+                                          TwoSampleMixture::GAMMA_EXPONENTIAL}) {
+    TwoSampleMeanTestParams params;
+    params.mixture = mixture;
+    params.running_intersection = true;
+    std::vector<double> lower(6), upper(6), p_value(6);
+    two_sample_mean_tests(params, control.data(), control_offsets.data(),
+                          treatment.data(), treatment_offsets.data(), 6,
+                          lower.data(), upper.data(), p_value.data());
+    for (size_t e = 0; e < 6; e++) {
+      TwoSampleMeanTest test(params);
+      for (size_t i = control_offsets[e]; i < control_offsets[e + 1]; i++) {
+        test.update(&control[i], 1, nullptr, 0);
+      }
+      test.update(nullptr, 0, treatment.data() + treatment_offsets[e],
+                  treatment_offsets[e + 1] - treatment_offsets[e]);
+      EXPECT_EQ(std::make_pair(lower[e], upper[e]), test.interval()) << e;
+      EXPECT_EQ(p_value[e], test.p_value()) << e;
+    }
+  }
+}
+
+TEST(TwoSampleMeanTestTest, GeometricReadouts) {
+  std::vector<double> control, treatment;
+  two_sample_outcomes(control, treatment, 1000, 4);
+  for (const TwoSampleMixture mixture : {TwoSampleMixture::BETA_BINOMIAL,
+                                          TwoSampleMixture::GAMMA_EXPONENTIAL}) {
+    TwoSampleMeanTestParams params;
+    params.mixture = mixture;
+    params.c = 2;
+    TwoSampleMeanTest dense(params);
+    params.readout_eta = 2;
+    TwoSampleMeanTest sparse(params);
+    std::pair<double, double> readout_interval = sparse.interval();
+    for (size_t k = 0; k < 999; k++) {
+      dense.update(&control[k], 1, &treatment[k], 1);
+      const std::pair<double, double> interval =
+          sparse.update(&control[k], 1, &treatment[k], 1);
+      const size_t pairs = k + 1;
+      if ((pairs & (pairs - 1)) == 0) {
+        // A readout at each power of two.
+        EXPECT_NEAR(interval.first, dense.interval().first, 1e-8) << pairs;
+        EXPECT_NEAR(interval.second, dense.interval().second, 1e-8) << pairs;
+        readout_interval = interval;
+      } else {
+        EXPECT_EQ(interval, readout_interval) << pairs;
+      }
+      // A running minimum over fewer times.
+      EXPECT_GE(sparse.p_value(), dense.p_value() - 1e-12) << pairs;
+    }
+    EXPECT_EQ(sparse.num_pairs(), 999u);
+    EXPECT_EQ(sparse.estimate(), dense.estimate());
+    const std::pair<double, double> final_interval = sparse.readout();
+    EXPECT_NEAR(final_interval.first, dense.interval().first, 1e-8);
+    EXPECT_NEAR(final_interval.second, dense.interval().second, 1e-8);
+    EXPECT_EQ(sparse.readout(), final_interval);
+
+    // two_sample_mean_tests reads out at the end of each experiment.
+    const size_t offsets[] = {0, 999};
+    double lower, upper, p_value;
+    two_sample_mean_tests(params, control.data(), offsets, treatment.data(),
+                          offsets, 1, &lower, &upper, &p_value);
+    EXPECT_EQ(std::make_pair(lower, upper), final_interval);
+    EXPECT_EQ(p_value, sparse.p_value());
+  }
+  TwoSampleMeanTestParams params;
+  params.readout_eta = 0.5;
+  EXPECT_THROW(TwoSampleMeanTest test(params), std::invalid_argument);
+}
+
+TEST(AverageTreatmentEffectTest, MatchesDemoData) {
+  std::ifstream file("../demo/ate_data.csv");
+  ASSERT_TRUE(file.good());
+  std::string line;
+  std::getline(file, line);
+  std::vector<double> y, treatment;
+  std::vector<AverageTreatmentEffectEstimate> expected;
+  while (std::getline(file, line)) {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream fields(line);
+    std::string row_name;
+    double t, outcome, treated;
+    AverageTreatmentEffectEstimate row;
+    fields >> row_name >> t >> outcome >> treated >> row.point_estimate
+        >> row.upper_confidence_bound >> row.lower_confidence_bound
+        >> row.p_value;
+    row.t = size_t(t);
+    y.push_back(outcome);
+    treatment.push_back(treated);
+    expected.push_back(row);
+  }
+  ASSERT_EQ(1000, y.size());
+
+  // The demo's predictions: the lagged mean of each arm, counting an empty
+  // arm as one unit with outcome 0 after the first unit.
+  const size_t n = y.size();
+  std::vector<double> y1_hat(n, 0.5), y0_hat(n, 0.5), propensity(n, 0.5);
+  double treated_sum = 0, control_sum = 0, num_treated = 0, num_control = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i > 0) {
+      y1_hat[i] = treated_sum / std::max(1.0, num_treated);
+      y0_hat[i] = control_sum / std::max(1.0, num_control);
+    }
+    (treatment[i] == 1 ? treated_sum : control_sum) += y[i];
+    (treatment[i] == 1 ? num_treated : num_control) += 1;
+  }
+  AverageTreatmentEffectParams params;
+  params.v_opt = 50 * 0.2 * 0.8 * 4;
+  AverageTreatmentEffectCS cs(params);
+  std::vector<AverageTreatmentEffectEstimate> rows(n);
+  size_t num_rows = 0;
+  for (size_t i = 0; i < n; i += 7) {
+    const size_t batch = std::min<size_t>(7, n - i);
+    EXPECT_EQ(batch, cs.num_rows(batch));
+    num_rows += cs.update(&y[i], &treatment[i], &propensity[i], batch,
+                          &rows[num_rows], &y1_hat[i], &y0_hat[i]);
+  }
+  ASSERT_EQ(n, num_rows);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(expected[i].t, rows[i].t);
+    EXPECT_NEAR(expected[i].point_estimate, rows[i].point_estimate, 1e-9) << i;
+    EXPECT_NEAR(expected[i].upper_confidence_bound,
+                rows[i].upper_confidence_bound, 1e-9) << i;
+    EXPECT_NEAR(expected[i].lower_confidence_bound,
+                rows[i].lower_confidence_bound, 1e-9) << i;
+    EXPECT_NEAR(expected[i].p_value, rows[i].p_value, 1e-9) << i;
+  }
+}
+
+TEST(AverageTreatmentEffectTest, CadenceEmitsEveryKthRow) {
+  const size_t n = 500;
+  std::vector<double> y(n), treatment(n), propensity(n);
+  for (size_t i = 0; i < n; i++) {
+    propensity[i] = 0.2 + 0.6 * ((i * 37) % 11) / 10.0;
+    treatment[i] = ((i * 53) % 100) / 100.0 < propensity[i] ? 1 : 0;
+    y[i] = treatment[i] == 1 ? ((i * 7) % 10) / 9.0 : ((i * 3) % 10) / 18.0;
+  }
+  AverageTreatmentEffectParams params;
+  params.min_propensity = 0.2;
+  AverageTreatmentEffectCS every_unit(params);
+  std::vector<AverageTreatmentEffectEstimate> all_rows(n);
+  ASSERT_EQ(n, every_unit.update(y.data(), treatment.data(),
+                                 propensity.data(), n, all_rows.data()));
+
+  params.cadence = 10;
+  AverageTreatmentEffectCS cs(params);
+  std::vector<AverageTreatmentEffectEstimate> rows;
+  for (size_t i = 0, batch = 1; i < n; i += batch, batch = batch % 23 + 4) {
+    batch = std::min(batch, n - i);
+    std::vector<AverageTreatmentEffectEstimate> out(cs.num_rows(batch));
+    EXPECT_EQ(out.size(), cs.update(&y[i], &treatment[i], &propensity[i],
+                                    batch, out.data()));
+    rows.insert(rows.end(), out.begin(), out.end());
+  }
+  ASSERT_EQ(n / 10, rows.size());
+  for (size_t r = 0; r < rows.size(); r++) {
+    const AverageTreatmentEffectEstimate& expected = all_rows[10 * r + 9];
+    EXPECT_EQ(expected.t, rows[r].t);
+    EXPECT_DOUBLE_EQ(expected.point_estimate, rows[r].point_estimate);
+    EXPECT_NEAR(expected.upper_confidence_bound,
+                rows[r].upper_confidence_bound, 1e-8) << r;
+    EXPECT_NEAR(expected.lower_confidence_bound,
+                rows[r].lower_confidence_bound, 1e-8) << r;
+    EXPECT_DOUBLE_EQ(expected.p_value, rows[r].p_value);
+  }
+  EXPECT_LT(rows.back().lower_confidence_bound, rows.back().point_estimate);
+  EXPECT_GT(rows.back().upper_confidence_bound, rows.back().point_estimate);
+  const AverageTreatmentEffectEstimate last = cs.estimate();
+  EXPECT_EQ(n, last.t);
+  EXPECT_NEAR(all_rows.back().upper_confidence_bound,
+              last.upper_confidence_bound, 1e-8);
+
+  const double bad_propensity = 0.1;
+  EXPECT_THROW(cs.update(y.data(), treatment.data(), &bad_propensity, 1,
+                         rows.data()),
+               std::invalid_argument);
+  EXPECT_EQ(n, cs.t());
+  EXPECT_DOUBLE_EQ(every_unit.sum(), cs.sum());
+  AverageTreatmentEffectParams empty_support;
+  empty_support.lower_bd = empty_support.upper_bd;
+  EXPECT_THROW(AverageTreatmentEffectCS cs(empty_support),
+               std::invalid_argument);
+}
+
+TEST(AverageTreatmentEffectTest, ReducedPrecisionIsConservative) {
+  const size_t n = 300;
+  std::vector<double> y(n), treatment(n), propensity(n, 0.5);
+  for (size_t i = 0; i < n; i++) {
+    treatment[i] = (i * 7) % 3 == 0 ? 1 : 0;
+    y[i] = ((i * 11) % 8) / 7.0;
+  }
+  AverageTreatmentEffectParams params;
+  AverageTreatmentEffectCS exact(params);
+  params.precision = SolverPrecision::balanced();
+  AverageTreatmentEffectCS balanced(params);
+  std::vector<AverageTreatmentEffectEstimate> exact_rows(n), balanced_rows(n);
+  exact.update(y.data(), treatment.data(), propensity.data(), n,
+               exact_rows.data());
+  balanced.update(y.data(), treatment.data(), propensity.data(), n,
+                  balanced_rows.data());
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_GE(balanced_rows[i].upper_confidence_bound,
+              exact_rows[i].upper_confidence_bound) << i;
+    EXPECT_LE(balanced_rows[i].lower_confidence_bound,
+              exact_rows[i].lower_confidence_bound) << i;
+    EXPECT_NEAR(exact_rows[i].upper_confidence_bound,
+                balanced_rows[i].upper_confidence_bound, 1e-3) << i;
+  }
+}
+
+// Number of e-BH rejections by sorting the e-values.
+size_t sorted_e_bh_rejections(std::vector<double> log_e_values,
+                              const double alpha) {
+  const size_t n = log_e_values.size();
+  std::sort(log_e_values.begin(), log_e_values.end(),
+            [](const double a, const double b) { return a > b; });
+  size_t rejections = 0;
+  for (size_t k = 1; k <= n; k++) {
+    if (log_e_values[k - 1] >= log(n / (alpha * k))) {
+      rejections = k;
+    }
+  }
+  return rejections;
+}
+
+TEST(EBHProcedureTest, MatchesSortedProcedureUnderUpdates) {
+  const size_t n = 1000;
+  const double alpha = 0.1;
+  EBHProcedure procedure(n, alpha);
+  EXPECT_EQ(0u, procedure.num_rejections());
+
+  std::vector<double> log_e_values(n);
+  for (size_t i = 0; i < n; i++) {
+    log_e_values[i] = 12 * std::pow(std::sin(i * 0.7), 8) - 1;
+  }
+  log_e_values[3] = std::numeric_limits<double>::quiet_NaN();
+  log_e_values[4] = std::numeric_limits<double>::infinity();
+  procedure.update_all(log_e_values.data());
+  std::vector<double> sortable = log_e_values;
+  sortable[3] = -std::numeric_limits<double>::infinity();
+  size_t expected = sorted_e_bh_rejections(sortable, alpha);
+  EXPECT_GT(expected, 10u);
+  EXPECT_LT(expected, n / 2);
+  EXPECT_EQ(expected, procedure.num_rejections());
+
+  // A run of updates, each to a few tests, raising e-values on average.
+  for (size_t round = 0; round < 50; round++) {
+    std::vector<size_t> indices;
+    std::vector<double> values;
+    for (size_t j = 0; j < 7; j++) {
+      const size_t i = (round * 131 + j * 37) % n;
+      indices.push_back(i);
+      values.push_back(sortable[i] + 3 * std::sin(round + j * 1.3) + 0.5);
+      sortable[i] = values.back();
+    }
+    procedure.update(indices.data(), values.data(), indices.size());
+    expected = sorted_e_bh_rejections(sortable, alpha);
+    ASSERT_EQ(expected, procedure.num_rejections()) << round;
+  }
+  std::vector<double> sorted = sortable;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const double a, const double b) { return a > b; });
+  const double cutoff = sorted[expected - 1];
+  std::unique_ptr<bool[]> rejected(new bool[n]);
+  procedure.rejections(rejected.get());
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(sortable[i] >= cutoff, rejected[i]) << i;
+    EXPECT_EQ(rejected[i], procedure.rejected(i)) << i;
+  }
+  EXPECT_EQ(sortable[10], procedure.log_e_value(10));
+
+  const size_t bad_index = n;
+  const double value = 0;
+  EXPECT_THROW(procedure.update(&bad_index, &value, 1),
+               std::invalid_argument);
+  EXPECT_THROW(EBHProcedure(0, 0.1), std::invalid_argument);
+  EXPECT_THROW(EBHProcedure(10, 0), std::invalid_argument);
+}
+
+TEST(EBHProcedureTest, UpdatesFromMixture) {
+  const size_t n = 5000;
+  const GammaExponentialMixture mixture(100, 0.05, 2);
+  std::vector<double> s(n), v(n, 500), log_e_values(n);
+  for (size_t i = 0; i < n; i++) {
+    // The first 100 tests drift upward; the rest are noise.
+    s[i] = i < 100 ? 150 : 40 * std::sin(i * 1.1);
+  }
+  mixture.log_superMG(s.data(), v.data(), n, log_e_values.data());
+
+  EBHProcedure from_mixture(n, 0.05), from_values(n, 0.05);
+  from_mixture.update_from_mixture(mixture, nullptr, s.data(), v.data(), n);
+  from_values.update_all(log_e_values.data());
+  EXPECT_EQ(from_values.num_rejections(), from_mixture.num_rejections());
+  EXPECT_GE(from_mixture.num_rejections(), 100u);
+  EXPECT_LT(from_mixture.num_rejections(), 150u);
+
+  const std::vector<size_t> indices = {0, 1, 2};
+  const std::vector<double> null_s = {0, 0, 0}, null_v = {500, 500, 500};
+  from_mixture.update_from_mixture(mixture, indices.data(), null_s.data(),
+                                   null_v.data(), 3);
+  std::vector<double> null_log_e_values(3);
+  mixture.log_superMG(null_s.data(), null_v.data(), 3,
+                      null_log_e_values.data());
+  from_values.update(indices.data(), null_log_e_values.data(), 3);
+  EXPECT_FALSE(from_mixture.rejected(0));
+  EXPECT_EQ(from_values.num_rejections(), from_mixture.num_rejections());
+  EXPECT_LT(from_mixture.num_rejections(), 100u);
+}
+
+TEST(RefreshSchedulerTest, RefreshesNearThresholdFirst) {
+  const size_t n = 200;
+  const GammaExponentialMixture mixture(100, 0.05, 2);
+  // Test i has drift i / n, so higher indices approach rejection sooner.
+  const auto s_at = [n](const size_t i, const double v) {
+    return v * i / n;
+  };
+  double v_now = 100;
+  const auto refresh = [&](const size_t test) {
+    return std::make_pair(mixture.log_superMG(s_at(test, v_now), v_now),
+                          v_now);
+  };
+  RefreshScheduler scheduler(n, 0.05);
+  EXPECT_EQ(n, scheduler.run(refresh));
+  EXPECT_EQ(0u, scheduler.run(refresh));
+
+  v_now = 200;
+  for (size_t i = 0; i < n; i++) {
+    scheduler.observe(i, v_now);
+  }
+  std::vector<size_t> order;
+  const auto recording_refresh = [&](const size_t test) {
+    order.push_back(test);
+    return refresh(test);
+  };
+  size_t already_rejected = 0;
+  for (size_t i = 0; i < n; i++) {
+    already_rejected += scheduler.rejected(i);
+    EXPECT_TRUE(scheduler.stale(i));
+  }
+  EXPECT_GT(already_rejected, 0u);
+  EXPECT_EQ(n - already_rejected, scheduler.run(recording_refresh));
+  for (size_t j = 1; j < order.size(); j++) {
+    EXPECT_GT(order[j - 1], order[j]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    // Only tests that had already rejected are left at the earlier time.
+    if (scheduler.stale(i)) {
+      EXPECT_TRUE(scheduler.rejected(i));
+      EXPECT_EQ(100, scheduler.refreshed_v(i));
+    } else {
+      EXPECT_EQ(mixture.log_superMG(s_at(i, v_now), v_now),
+                scheduler.log_superMG(i));
+    }
+  }
+}
+
+TEST(RefreshSchedulerTest, DeferredTestsKeepTheirReadouts) {
+  RefreshScheduler scheduler(3, 0.05);
+  scheduler.record_refresh(0, 1, 10);
+  scheduler.record_refresh(1, 2.5, 10);
+  scheduler.record_refresh(2, 4, 10);
+  for (size_t i = 0; i < 3; i++) {
+    scheduler.observe(i, 20);
+  }
+  EXPECT_TRUE(scheduler.rejected(2));
+  EXPECT_EQ(-std::numeric_limits<double>::infinity(), scheduler.priority(2));
+  EXPECT_GT(scheduler.priority(1), scheduler.priority(0));
+
+  // A passed deadline refreshes nothing and leaves the readouts in place.
+  int calls = 0;
+  const auto refresh = [&](size_t) {
+    calls++;
+    return std::make_pair(0.0, 20.0);
+  };
+  EXPECT_EQ(0u, scheduler.run(refresh, std::chrono::steady_clock::now()));
+  EXPECT_EQ(0, calls);
+  EXPECT_TRUE(scheduler.stale(0));
+  EXPECT_EQ(2.5, scheduler.log_superMG(1));
+  EXPECT_EQ(10, scheduler.refreshed_v(1));
+  EXPECT_THROW(scheduler.observe(3, 1), std::invalid_argument);
+  EXPECT_THROW(RefreshScheduler(0, 0.05), std::invalid_argument);
+}
+
 } // namespace